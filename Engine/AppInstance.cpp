@@ -24,9 +24,14 @@
 
 #include "AppInstance.h"
 
+#include <algorithm> // min, max
 #include <fstream>
 #include <list>
+#include <set>
+#include <vector>
 #include <cassert>
+#include <climits> // INT_MIN
+#include <cstdlib> // abs
 #include <stdexcept>
 #include <sstream> // stringstream
 
@@ -58,10 +63,12 @@ CLANG_DIAG_ON(unknown-pragmas)
 #include "Global/QtCompat.h" // removeFileExtension
 
 #include "Engine/CLArgs.h"
+#include "Engine/Cache.h"
 #include "Engine/CreateNodeArgs.h"
 #include "Engine/FileDownloader.h"
 #include "Engine/GroupOutput.h"
 #include "Engine/DiskCacheNode.h"
+#include "Engine/EffectInstance.h"
 #include "Engine/Node.h"
 #include "Engine/OutputSchedulerThread.h"
 #include "Engine/Plugin.h"
@@ -255,6 +262,9 @@ public:
 
     void executeCommandLinePythonCommands(const CLArgs& args);
 
+    void importCommandLineCachePacks(const CLArgs& args);
+
+    void exportCommandLineCachePack(const CLArgs& args);
 
     void checkNumberOfNonFloatingPanes();
 
@@ -494,6 +504,73 @@ AppInstancePrivate::executeCommandLinePythonCommands(const CLArgs& args)
     }
 }
 
+void
+AppInstancePrivate::importCommandLineCachePacks(const CLArgs& args)
+{
+    const std::list<QString>& packs = args.getImportCachePackFilePaths();
+
+    for (std::list<QString>::const_iterator it = packs.begin(); it != packs.end(); ++it) {
+        std::size_t nTiles = appPTR->getCache()->importPack( it->toStdString() );
+        std::cout << tr("Imported %1 image tiles from the cache pack %2").arg( (qulonglong)nTiles ).arg(*it).toStdString() << std::endl;
+    }
+}
+
+void
+AppInstancePrivate::exportCommandLineCachePack(const CLArgs& args)
+{
+    const QString& packFilePath = args.getExportCachePackFilePath();
+    if ( packFilePath.isEmpty() ) {
+        return;
+    }
+
+    std::list<std::pair<int, std::pair<int, int> > > frameRanges = args.getExportCachePackFrameRanges();
+    if ( frameRanges.empty() ) {
+        frameRanges = args.getFrameRanges();
+    }
+    if ( frameRanges.empty() ) {
+        TimeValue first, last;
+        _currentProject->getFrameRange(&first, &last);
+        frameRanges.push_back( std::make_pair( INT_MIN, std::make_pair( (int)first, (int)last ) ) );
+    }
+
+    std::vector<RangeD> cacheFrameRanges;
+    for (std::list<std::pair<int, std::pair<int, int> > >::const_iterator it = frameRanges.begin(); it != frameRanges.end(); ++it) {
+        RangeD range;
+        range.min = std::min(it->second.first, it->second.second);
+        range.max = std::max(it->second.first, it->second.second);
+        cacheFrameRanges.push_back(range);
+    }
+
+    // The images of a node are cached with the hash of the node at their frame and view
+    std::set<U64> nodeFrameViewHashes;
+    const int nViews = _currentProject->getProjectViewsCount();
+    const QStringList& nodeNames = args.getExportCachePackNodes();
+    Q_FOREACH(const QString &nodeName, nodeNames) {
+        NodePtr node = _publicInterface->getNodeByFullySpecifiedName( nodeName.toStdString() );
+        if (!node) {
+            throw std::invalid_argument( tr("%1 does not belong to the project file. Please enter a valid node script-name to export to the cache pack.").arg(nodeName).toStdString() );
+        }
+        EffectInstancePtr effect = node->getEffectInstance();
+        for (std::list<std::pair<int, std::pair<int, int> > >::const_iterator it = frameRanges.begin(); it != frameRanges.end(); ++it) {
+            const int frameStep = (it->first == INT_MIN || it->first == 0) ? 1 : std::abs(it->first);
+            const int firstFrame = std::min(it->second.first, it->second.second);
+            const int lastFrame = std::max(it->second.first, it->second.second);
+            for (int frame = firstFrame; frame <= lastFrame; frame += frameStep) {
+                for (int view = 0; view < nViews; ++view) {
+                    HashableObject::ComputeHashArgs hashArgs;
+                    hashArgs.hashType = HashableObject::eComputeHashTypeTimeViewVariant;
+                    hashArgs.time = TimeValue(frame);
+                    hashArgs.view = ViewIdx(view);
+                    nodeFrameViewHashes.insert( effect->computeHash(hashArgs) );
+                }
+            }
+        }
+    }
+
+    std::size_t nTiles = appPTR->getCache()->exportPack(packFilePath.toStdString(), nodeFrameViewHashes, cacheFrameRanges);
+    std::cout << tr("Exported %1 image tiles to the cache pack %2").arg( (qulonglong)nTiles ).arg(packFilePath).toStdString() << std::endl;
+} // exportCommandLineCachePack
+
 void
 AppInstance::executeCommandLinePythonCommands(const CLArgs& args)
 {
@@ -555,6 +632,9 @@ AppInstance::loadInternal(const CLArgs& cl,
 
         std::list<RenderQueue::RenderWork> writersWork;
 
+        // Import the cache packs before loading the project: the renders may then use the imported images
+        _imp->importCommandLineCachePacks(cl);
+
 
         if ( info.suffix() == QString::fromUtf8(NATRON_PROJECT_FILE_EXT) ) {
             ///Load the project
@@ -612,6 +692,9 @@ AppInstance::loadInternal(const CLArgs& cl,
         if ( !writersWork.empty() ) {
             _imp->renderQueue->renderNonBlocking(writersWork);
         }
+
+        // In background mode the renders are finished: export the images they cached
+        _imp->exportCommandLineCachePack(cl);
     } else if (appPTR->getAppType() == AppManager::eAppTypeInterpreter) {
         QFileInfo info( cl.getScriptFilename() );
         if ( info.exists() ) {
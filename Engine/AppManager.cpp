@@ -32,6 +32,7 @@
 #include <stdexcept>
 #include <cstring> // for std::memcpy
 #include <sstream> // stringstream
+#include <iostream>
 
 #if defined(Q_OS_LINUX)
 #include <sys/signal.h>
@@ -94,6 +95,7 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 #include "Engine/ExistenceCheckThread.h"
 #include "Engine/FileSystemModel.h" // FileSystemModel::initDriveLettersToNetworkShareNamesMapping
 #include "Engine/FStreamsSupport.h"
+#include "Engine/Hash64.h"
 #include "Engine/GroupInput.h"
 #include "Engine/GroupOutput.h"
 #include "Engine/JoinViewsNode.h"
@@ -506,6 +508,11 @@ AppManager::loadFromArgs(const CLArgs& cl)
     QThreadPool::setGlobalInstance(new ThreadPool);
 #endif
 
+    // Must be set before any hash is computed
+    if ( qgetenv(NATRON_CRC64_HASH_ENV_VAR) == "1" ) {
+        Hash64::setCrc64CompatibilityModeEnabled(true);
+    }
+
     // set fontconfig path on all platforms
     if ( qgetenv("FONTCONFIG_PATH").isNull() ) {
         // set FONTCONFIG_PATH to Natron/Resources/etc/fonts (required by plugins using fontconfig)
@@ -612,9 +619,16 @@ AppManager::~AppManager()
 
     _imp->_backgroundIPC.reset();
 
+    if (_imp->printCacheStatsOnExit) {
+        CacheStatsReport report;
+        _imp->cache->getStats(&report);
+        report.print(std::cout);
+    }
+
     // Ensure the cache is synced on disk when exiting.
     _imp->cache->flushCacheOnDisk(false /*async*/);
 
+    _imp->cacheMemoryGovernor->quitThread();
     _imp->storageDeleteThread->quitThread();
 
 
@@ -876,8 +890,15 @@ AppManager::loadInternal(const CLArgs& cl)
     }
 
     // Create cache once we loaded the cache directory path wanted by the user
-    _imp->cache = Cache::create();
+    _imp->cache = Cache::create( _imp->_settings->getCacheTileSizePo2(),
+                                 cl.isRAMCacheEnabled() ? eCacheBackendAnonymousMemory : eCacheBackendMappedFiles );
+    _imp->cache->setMaximumCacheSize( eStorageModeRAM, _imp->_settings->getMaximumRAMCacheSize() );
+    _imp->cache->setMaximumCacheSize( eStorageModeDisk, _imp->_settings->getMaximumDiskCacheSize() );
+    _imp->cache->setEvictionPolicy( _imp->_settings->getCacheEvictionPolicy() );
+    _imp->cache->setCompressedTierMaximumSize( _imp->_settings->getMaximumCompressedCacheSize() );
     _imp->storageDeleteThread.reset(new StorageDeleterThread);
+    _imp->cacheMemoryGovernor.reset( new CacheMemoryGovernor(_imp->cache) );
+    refreshCacheMemoryGovernor();
 
     _imp->declareSettingsToPython();
 
@@ -1105,6 +1126,8 @@ AppManager::loadInternalAfterInitGui(const CLArgs& cl)
         _imp->initProcessInputChannel( cl.getIPCPipeName() );
     }
 
+    _imp->printCacheStatsOnExit = cl.areCacheStatsEnabled();
+
 
     if ( cl.isInterpreterMode() ) {
         _imp->_appType = eAppTypeInterpreter;
@@ -2470,6 +2493,45 @@ AppManager::getCache() const
     return _imp->cache;
 }
 
+void
+AppManager::refreshCacheMemoryGovernor()
+{
+    if (!_imp->cache || !_imp->cacheMemoryGovernor) {
+        return;
+    }
+    if ( !_imp->_settings->isAdaptiveCacheSizeEnabled() ) {
+        _imp->cacheMemoryGovernor->quitThread();
+        _imp->cache->setMemoryBudget(0);
+        return;
+    }
+    _imp->cacheMemoryGovernor->setBudgetRange( _imp->_settings->getMinimumAdaptiveCacheSize(), _imp->_settings->getMaximumRAMCacheSize() );
+    if ( !_imp->cacheMemoryGovernor->isRunning() ) {
+        _imp->cacheMemoryGovernor->start();
+    }
+}
+
+bool
+AppManager::recordFirstRenderedFrame()
+{
+    QMutexLocker k(&_imp->timeToFirstRenderedFrameMutex);
+    if (_imp->timeToFirstRenderedFrame >= 0.) {
+        return false;
+    }
+    _imp->timeToFirstRenderedFrame = _imp->startupTimer.getTimeSinceCreation();
+    return true;
+}
+
+bool
+AppManager::getTimeToFirstRenderedFrame(double* seconds) const
+{
+    QMutexLocker k(&_imp->timeToFirstRenderedFrameMutex);
+    if (_imp->timeToFirstRenderedFrame < 0.) {
+        return false;
+    }
+    *seconds = _imp->timeToFirstRenderedFrame;
+    return true;
+}
+
 void
 AppManager::deleteCacheEntriesInSeparateThread(const std::list<ImageStorageBasePtr> & entriesToDelete)
 {
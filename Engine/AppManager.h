@@ -182,6 +182,24 @@ public:
 
     CachePtr getCache() const;
 
+    /**
+     * @brief To be called when a frame is rendered: the first call records the time elapsed since the AppManager was created.
+     * Returns true if this call recorded it, i.e: if this is the first rendered frame.
+     **/
+    bool recordFirstRenderedFrame();
+
+    /**
+     * @brief Returns false if no frame was rendered yet, otherwise the time in seconds between the creation of the AppManager
+     * and the first rendered frame. This is the start-up time to the first rendered frame, including the time to open the cache.
+     **/
+    bool getTimeToFirstRenderedFrame(double* seconds) const;
+
+    /**
+     * @brief Starts or stops the thread adapting the cache size to the memory pressure of the system
+     * and updates its budget range, according to the settings.
+     **/
+    void refreshCacheMemoryGovernor();
+
     void deleteCacheEntriesInSeparateThread(const std::list<ImageStorageBasePtr> & entriesToDelete);
 
 
@@ -86,6 +86,10 @@ AppManagerPrivate::AppManagerPrivate()
     , multiThreadSuite(new MultiThread())
     , _knobFactory( new KnobFactory() )
     , cache()
+    , printCacheStatsOnExit(false)
+    , startupTimer()
+    , timeToFirstRenderedFrameMutex()
+    , timeToFirstRenderedFrame(-1.)
     , _backgroundIPC()
     , _loaded(false)
     , _binaryPath()
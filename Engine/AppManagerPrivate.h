@@ -50,11 +50,13 @@ CLANG_DIAG_ON(uninitialized)
 
 #include "Engine/AppManager.h"
 #include "Engine/Cache.h"
+#include "Engine/CacheMemoryGovernor.h"
 #include "Engine/StorageDeleterThread.h"
 #include "Engine/Image.h"
 #include "Engine/GPUContextPool.h"
 #include "Engine/GenericSchedulerThreadWatcher.h"
 #include "Engine/TLSHolder.h"
+#include "Engine/Timer.h"
 
 // include breakpad after Engine, because it includes /usr/include/AssertMacros.h on OS X which defines a check(x) macro, which conflicts with boost
 #ifdef NATRON_USE_BREAKPAD
@@ -113,8 +115,17 @@ public:
 
     CachePtr cache; //< Main application cache
 
+    bool printCacheStatsOnExit; //< true if the cache statistics must be printed when the AppManager is destroyed (--cache-stats)
+
+    TimeLapse startupTimer; //< started when the AppManager is created, used to report the time to the first rendered frame
+
+    mutable QMutex timeToFirstRenderedFrameMutex; //< protects timeToFirstRenderedFrame
+    double timeToFirstRenderedFrame; //< time in seconds between the creation of the AppManager and the first rendered frame, -1 until a frame is rendered
+
     boost::scoped_ptr<StorageDeleterThread> storageDeleteThread; // thread used to kill cache entries without blocking a render thread
 
+    boost::scoped_ptr<CacheMemoryGovernor> cacheMemoryGovernor; // thread adapting the cache size to the memory pressure, if enabled in the settings
+
     boost::scoped_ptr<ProcessInputChannel> _backgroundIPC; //< object used to communicate with the main app
 
     //if this app is background, see the ProcessInputChannel def
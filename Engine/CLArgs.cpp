@@ -65,6 +65,12 @@ public:
     std::list<std::pair<int, std::pair<int, int> > > frameRanges;
     bool rangeSet;
     bool enableRenderStats;
+    bool enableCacheStats;
+    bool useRAMCache;
+    std::list<QString> importCachePacks;
+    QString exportCachePack;
+    QStringList exportCachePackNodes;
+    std::list<std::pair<int, std::pair<int, int> > > exportCachePackFrameRanges;
     bool isEmpty;
     mutable QString imageFilename;
     QString breakpadPipeFilePath;
@@ -91,6 +97,12 @@ public:
         , frameRanges()
         , rangeSet(false)
         , enableRenderStats(false)
+        , enableCacheStats(false)
+        , useRAMCache(false)
+        , importCachePacks()
+        , exportCachePack()
+        , exportCachePackNodes()
+        , exportCachePackFrameRanges()
         , isEmpty(true)
         , imageFilename()
         , breakpadPipeFilePath()
@@ -226,6 +238,12 @@ CLArgs::operator=(const CLArgs& other)
     _imp->frameRanges = other._imp->frameRanges;
     _imp->rangeSet = other._imp->rangeSet;
     _imp->enableRenderStats = other._imp->enableRenderStats;
+    _imp->enableCacheStats = other._imp->enableCacheStats;
+    _imp->useRAMCache = other._imp->useRAMCache;
+    _imp->importCachePacks = other._imp->importCachePacks;
+    _imp->exportCachePack = other._imp->exportCachePack;
+    _imp->exportCachePackNodes = other._imp->exportCachePackNodes;
+    _imp->exportCachePackFrameRanges = other._imp->exportCachePackFrameRanges;
     _imp->isEmpty = other._imp->isEmpty;
     _imp->imageFilename = other._imp->imageFilename;
     _imp->exportDocsPath = other._imp->exportDocsPath;
@@ -333,7 +351,32 @@ CLArgs::printUsage(const std::string& programName)
         "     breakdown contains informations about each nodes, render times etc...\n"
         "     This option is useful for debugging purposes or to control that a render\n"
         "     is working correctly.\n"
-        "     **Please note** that it does not work when writing video files."
+        "     **Please note** that it does not work when writing video files.\n"
+        "  --cache-stats\n"
+        "     Print the cache statistics of the process on the standard output before\n"
+        "     exiting: hits, misses, waits on entries computed by other threads,\n"
+        "     insertions, evictions and lock contention, with their latencies, in\n"
+        "     total and for each plug-in.\n"
+        "  --ram-cache\n"
+        "     Keep the cache in the memory of the process, using huge pages when the\n"
+        "     system allows it, instead of memory-mapped files in the cache directory.\n"
+        "     Nothing is written to disk and the cache is neither shared with other\n"
+        "     Natron processes nor kept after exiting. This is useful for renders on a\n"
+        "     farm where each process renders its own frames. The cache size is bounded\n"
+        "     by the maximum RAM cache size preference.\n"
+        "  --import-cache-pack <pack file path>\n"
+        "     Insert the image tiles of a cache pack written with --export-cache-pack\n"
+        "     in the cache before loading the project. The pack is read sequentially\n"
+        "     in a single pass, which is faster than loading the tiles one by one\n"
+        "     from a network filesystem. This option may be used multiple times.\n"
+        "  --export-cache-pack <pack file path> <node script names> [<frameRange>]\n"
+        "     After the renders, write the cached image tiles of the given nodes to\n"
+        "     a single pack file, that other processes can import with\n"
+        "     --import-cache-pack. Node script names are separated by commas.\n"
+        "     The frame range has the same format as for the -w option. If not\n"
+        "     specified, the frame range of the render is used, or else the frame\n"
+        "     range of the project. The pack can only be imported by a cache with\n"
+        "     the same tile size.\n\n"
         "Sample uses:\n"
         "  %1 /Users/Me/MyNatronProjects/MyProject.ntp\n"
         "  %1 -b -w MyWriter /Users/Me/MyNatronProjects/MyProject.ntp\n"
@@ -499,6 +542,42 @@ CLArgs::areRenderStatsEnabled() const
     return _imp->enableRenderStats;
 }
 
+bool
+CLArgs::areCacheStatsEnabled() const
+{
+    return _imp->enableCacheStats;
+}
+
+bool
+CLArgs::isRAMCacheEnabled() const
+{
+    return _imp->useRAMCache;
+}
+
+const std::list<QString>&
+CLArgs::getImportCachePackFilePaths() const
+{
+    return _imp->importCachePacks;
+}
+
+const QString&
+CLArgs::getExportCachePackFilePath() const
+{
+    return _imp->exportCachePack;
+}
+
+const QStringList&
+CLArgs::getExportCachePackNodes() const
+{
+    return _imp->exportCachePackNodes;
+}
+
+const std::list<std::pair<int, std::pair<int, int> > >&
+CLArgs::getExportCachePackFrameRanges() const
+{
+    return _imp->exportCachePackFrameRanges;
+}
+
 bool
 CLArgs::isPythonScript() const
 {
@@ -772,6 +851,73 @@ CLArgsPrivate::parse()
         }
     }
 
+    {
+        QStringList::iterator it = hasToken( QString::fromUtf8("cache-stats"), QString() );
+        if ( it != args.end() ) {
+            enableCacheStats = true;
+            args.erase(it);
+        }
+    }
+
+    {
+        QStringList::iterator it = hasToken( QString::fromUtf8("ram-cache"), QString() );
+        if ( it != args.end() ) {
+            useRAMCache = true;
+            args.erase(it);
+        }
+    }
+
+    for (;;) {
+        QStringList::iterator it = hasToken( QString::fromUtf8("import-cache-pack"), QString() );
+        if ( it == args.end() ) {
+            break;
+        }
+        it = args.erase(it);
+        if ( it == args.end() ) {
+            std::cout << tr("You must specify the cache pack file path after --import-cache-pack").toStdString() << std::endl;
+            error = 1;
+
+            return;
+        }
+        QString packFilePath = *it;
+#ifdef __NATRON_UNIX__
+        packFilePath = AppManager::qt_tildeExpansion(packFilePath);
+#endif
+        importCachePacks.push_back(packFilePath);
+        args.erase(it);
+    }
+
+    {
+        QStringList::iterator it = hasToken( QString::fromUtf8("export-cache-pack"), QString() );
+        if ( it != args.end() ) {
+            it = args.erase(it);
+            if ( it == args.end() ) {
+                std::cout << tr("You must specify the cache pack file path after --export-cache-pack").toStdString() << std::endl;
+                error = 1;
+
+                return;
+            }
+            exportCachePack = *it;
+#ifdef __NATRON_UNIX__
+            exportCachePack = AppManager::qt_tildeExpansion(exportCachePack);
+#endif
+            it = args.erase(it);
+            if ( ( it == args.end() ) || it->startsWith( QChar::fromLatin1('-') ) ) {
+                std::cout << tr("You must specify the script-names of the nodes to export after the cache pack file path").toStdString() << std::endl;
+                error = 1;
+
+                return;
+            }
+            exportCachePackNodes = it->split( QChar::fromLatin1(','), QString::SkipEmptyParts );
+            it = args.erase(it);
+
+            // The frame range is optional: parse it before the frame range of the render
+            if ( ( it != args.end() ) && tryParseMultipleFrameRanges(*it, exportCachePackFrameRanges) ) {
+                args.erase(it);
+            }
+        }
+    }
+
     {
         QStringList::iterator it = hasToken( QString::fromUtf8(NATRON_BREAKPAD_PROCESS_PID), QString() );
         if ( it != args.end() ) {
@@ -134,6 +134,31 @@ public:
 
     bool areRenderStatsEnabled() const;
 
+    bool areCacheStatsEnabled() const;
+
+    bool isRAMCacheEnabled() const;
+
+    /*
+     * @brief The cache packs to import in the cache before loading the project, see Cache::importPack
+     */
+    const std::list<QString>& getImportCachePackFilePaths() const;
+
+    /*
+     * @brief The cache pack to export after the renders, see Cache::exportPack. Empty if none.
+     */
+    const QString& getExportCachePackFilePath() const;
+
+    /*
+     * @brief The script-names of the nodes whose images are exported to the cache pack
+     */
+    const QStringList& getExportCachePackNodes() const;
+
+    /*
+     * @brief The frame ranges of the images exported to the cache pack, in the same format as getFrameRanges().
+     * If empty, the frame ranges of the render are used.
+     */
+    const std::list<std::pair<int, std::pair<int, int> > >& getExportCachePackFrameRanges() const;
+
     const QString& getBreakpadProcessExecutableFilePath() const;
 
     qint64 getBreakpadProcessPID() const;
@@ -24,20 +24,28 @@
 
 #include "Cache.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstring> // memcpy
+#include <new> // bad_alloc
 #include <stdexcept>
 #include <set>
 #include <list>
+#include <map>
 
 #include <QMutex>
 #include <QDir>
 #include <QWaitCondition>
 #include <QDebug>
+#include <QtCore/QAtomicInt>
+#include <QtConcurrentMap> // QtCore on Qt4, QtConcurrent on Qt5
 
 GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_OFF
 GCC_DIAG_OFF(unused-parameter)
+#include <boost/bind.hpp>
 #include <boost/unordered_set.hpp>
 #include <boost/format.hpp>
+#include <boost/interprocess/containers/map.hpp>
 #include <boost/interprocess/containers/vector.hpp>
 #include <boost/interprocess/sync/interprocess_mutex.hpp> // regular mutex
 #include <boost/interprocess/sync/scoped_lock.hpp> // scoped lock a regular mutex
@@ -59,14 +67,21 @@ GCC_DIAG_ON(unused-parameter)
 #include "Global/QtCompat.h"
 
 #include "Engine/AppManager.h"
+#include "Engine/CacheEvictionPolicy.h"
+#include "Engine/CacheFreeTilesBitmap.h"
+#include "Engine/CacheTileCodec.h"
 #include "Engine/StorageDeleterThread.h"
 #include "Engine/FStreamsSupport.h"
+#include "Engine/Hash64.h"
 #include "Engine/MemoryFile.h"
 #include "Engine/MemoryInfo.h"
+#include "Engine/ProcessLocalCache.h"
+#include "Engine/RAMBufferPool.h"
 #include "Engine/Settings.h"
 #include "Engine/StandardPaths.h"
 #include "Engine/RamBuffer.h"
 #include "Engine/ThreadPool.h"
+#include "Engine/Timer.h"
 
 
 // The number of buckets. This must be a power of 16 since the buckets will be identified by a digit of a hash
@@ -76,14 +91,35 @@ GCC_DIAG_ON(unused-parameter)
 
 
 // Each cache file on disk that is created by MMAP will have a multiple of the tile size.
-// Each time the cache file has to grow, it will be resized to contain 1000 more tiles
-#define NATRON_CACHE_FILE_GROW_N_TILES 1024
+// Each time the cache file has to grow, it will be resized by a multiple of 4MiB, that is 1024 tiles
+// of the default size. This is a multiple of all supported tile sizes.
+#define NATRON_CACHE_FILE_GROW_N_BYTES 4194304
 
 // Grow the bucket ToC shared memory by 500Kb at once
 #define NATRON_CACHE_BUCKET_TOC_FILE_GROW_N_BYTES 524288
 
-// Used to prevent loading older caches when we change the serialization scheme
-#define NATRON_CACHE_SERIALIZATION_VERSION 5
+// The maximum number of small entries (e.g: action results) kept in the process-local cache
+#define NATRON_CACHE_PROCESS_LOCAL_MAX_ENTRIES 16384
+
+// The maximum size of the idle RAM image buffers kept by the RAMBufferPool. When the cache has a memory budget,
+// the pool may hold at most 1/NATRON_CACHE_RAM_BUFFER_POOL_BUDGET_DIVISOR of it.
+#define NATRON_CACHE_RAM_BUFFER_POOL_MAX_BYTES ( (std::size_t)512 * 1024 * 1024 )
+#define NATRON_CACHE_RAM_BUFFER_POOL_BUDGET_DIVISOR 8
+
+// Used to prevent loading older caches when we change the serialization scheme.
+// It is part of the cache directory name, see CachePrivate::getCacheDirectoryName
+#define NATRON_CACHE_SERIALIZATION_VERSION 10
+
+// Appended to the serialization version in the cache directory name when the keys are computed in CRC64
+// compatibility mode (see Hash64): both kinds of keys are never mixed in the same buckets
+#define NATRON_CACHE_CRC64_KEYS_VERSION_SUFFIX "crc64"
+
+// Identifies the pack files written by Cache::exportPack and the version of their layout
+#define NATRON_CACHE_PACK_MAGIC "NTRNPACK"
+#define NATRON_CACHE_PACK_VERSION 1
+
+// The tiles of a pack are inserted in the cache by batches of this many tiles
+#define NATRON_CACHE_PACK_IMPORT_BATCH_SIZE 256
 
 #define CACHE_TRACE_ENTRY_LOCK
 #define CACHE_TRACE_ENTRY_ACCESS
@@ -99,12 +135,119 @@ NATRON_NAMESPACE_ENTER;
 
 
 // Typedef our interprocess types
-typedef bip::allocator<std::size_t, ExternalSegmentType::segment_manager> Size_t_Allocator_ExternalSegment;
+typedef bip::allocator<U64, ExternalSegmentType::segment_manager> U64_Allocator_ExternalSegment;
+
+
+
+// The free tiles of a bucket
+typedef CacheFreeTilesBitmap<U64_Allocator_ExternalSegment> FreeTilesBitmap_ExternalSegment;
+
+// The entries of a bucket ordered by eviction priority, for the cost-aware eviction policy
+typedef bip::allocator<CacheEvictionKey, ExternalSegmentType::segment_manager> CacheEvictionKey_Allocator_ExternalSegment;
+typedef bip::set<CacheEvictionKey, std::less<CacheEvictionKey>, CacheEvictionKey_Allocator_ExternalSegment> set_CacheEvictionKey_ExternalSegment;
+
+/**
+ * @brief Where an evicted tile is in the compressed tiles file of its bucket.
+ **/
+struct CompressedTileLocation
+{
+    // Offset of the CompressedTileHeader of the tile in the file
+    U64 offset;
+
+    // The number of bytes following the header
+    U64 dataSize;
+
+    CompressedTileLocation()
+    : offset(0)
+    , dataSize(0)
+    {
+
+    }
+};
+
+/**
+ * @brief Precedes the data of each tile in the compressed tiles file, to check that the file matches the ToC.
+ **/
+struct CompressedTileHeader
+{
+    U64 hash;
+
+    U32 dataSize;
+
+    // The element size the data was compressed with by CacheTileCodec, 0 if it is the raw tile
+    U32 elementSize;
+};
+
+// The compressed tiles of a bucket, by hash
+typedef std::pair<const U64, CompressedTileLocation> CompressedTileLocationPair;
+typedef bip::allocator<CompressedTileLocationPair, ExternalSegmentType::segment_manager> CompressedTileLocation_Allocator_ExternalSegment;
+typedef bip::map<U64, CompressedTileLocation, std::less<U64>, CompressedTileLocation_Allocator_ExternalSegment> map_CompressedTileLocation_ExternalSegment;
+
+/**
+ * @brief Returns the memory taken in a ToC segment by an allocation of nBytes: the memory algorithm
+ * adds its own header to each allocation and rounds it up to its alignment.
+ **/
+static std::size_t
+getSegmentAllocationSize(std::size_t nBytes)
+{
+    typedef ExternalSegmentType::segment_manager::memory_algorithm MemoryAlgorithm;
+    const std::size_t size = nBytes + MemoryAlgorithm::PayloadPerAllocation;
+    return (size + MemoryAlgorithm::Alignment - 1) / MemoryAlgorithm::Alignment * MemoryAlgorithm::Alignment;
+}
+
+/**
+ * @brief Returns the memory taken in a ToC segment by a node of a bip::set or bip::map of ValueType.
+ * A red-black tree node holds its parent, left and right pointers and its color before the value:
+ * the color is counted as a pointer, although it is usually stored in the low bits of the parent pointer.
+ **/
+template <typename ValueType>
+static std::size_t
+getTreeNodeAllocationSize()
+{
+    return getSegmentAllocationSize( 4 * sizeof(ExternalSegmentType::segment_manager::void_pointer) + sizeof(ValueType) );
+}
+
+/**
+ * @brief The header of a pack file written by Cache::exportPack. It is followed by nTiles CachePackTileRecord.
+ **/
+struct CachePackHeader
+{
+    char magic[8];
+
+    U32 version;
+
+    // Always 1 when written: a pack is only valid on machines with the same byte order
+    U32 byteOrderMark;
 
+    // The size of the tiles in the pack: it must be the tile size of the importing cache
+    U64 tileSizeBytes;
 
+    U64 nTiles;
+};
 
-// The unordered set of free tiles indices in a bucket
-typedef bip::set<std::size_t, std::equal_to<std::size_t>, Size_t_Allocator_ExternalSegment> set_size_t_ExternalSegment;
+/**
+ * @brief Describes a tile in a pack file. It is followed by layerChannelSize characters of the layer/channel name,
+ * pluginIDSize characters of the plug-in ID and the tileSizeBytes bytes of the tile.
+ * Records are not aligned in the file: read them with memcpy.
+ **/
+struct CachePackTileRecord
+{
+    // The hash of the ImageTileKey, to check that the key is rebuilt identically by the importing process
+    U64 hash;
+    U64 nodeFrameViewHash;
+    double time;
+    double proxyScaleX;
+    double proxyScaleY;
+    double computeCost;
+    int view;
+    U32 mipMapLevel;
+    int bitdepth;
+    int tileX;
+    int tileY;
+    U32 draftMode;
+    U32 layerChannelSize;
+    U32 pluginIDSize;
+};
 
 typedef bip::sharable_lock<bip::interprocess_upgradable_mutex> ReadLock;
 typedef bip::upgradable_lock<bip::interprocess_upgradable_mutex> UpgradableLock;
@@ -124,10 +267,15 @@ struct LRUListNode
     bip::offset_ptr<LRUListNode> prev, next;
     U64 hash;
 
+    // The priority of the entry for the cost-aware eviction policy, see getCacheEntryEvictionPriority.
+    // This is also the key of the entry in the bucket evictionQueue
+    double evictionPriority;
+
     LRUListNode()
     : prev(0)
     , next(0)
     , hash(0)
+    , evictionPriority(0)
     {
 
     }
@@ -142,12 +290,12 @@ void disconnectLinkedListNode(const bip::offset_ptr<LRUListNode>& node)
     if (node->prev) {
         node->prev->next = node->next;
     }
-    node->prev = 0;
 
     // Make the next item predecessor point to this item predecessor
     if (node->next) {
         node->next->prev = node->prev;
     }
+    node->prev = 0;
     node->next = 0;
 }
 
@@ -185,6 +333,12 @@ struct MemorySegmentEntryHeader
     // The size of the memorySegmentPortion, in bytes. This is stored in the main cache memory segment.
     std::size_t size;
 
+    // The time in seconds it took to compute the entry, used by the cost-aware eviction policy
+    double computeCost;
+
+    // The size in bytes of a sample of the tile, see CacheEntryBase::getTileElementSize
+    int tileElementSize;
+
     // Hold an iterator pointing to this entry
     //
     // From http://www.sgi.com/tech/stl/List.html :
@@ -222,6 +376,8 @@ struct MemorySegmentEntryHeader
     MemorySegmentEntryHeader(const void_allocator& allocator)
     : tileCacheIndex(-1)
     , size(0)
+    , computeCost(0)
+    , tileElementSize(1)
     , lruIterator(0)
     , lock()
     , status(eEntryStatusNull)
@@ -249,7 +405,7 @@ struct CacheBucket
     {
 
         // Indices of the chunks of memory available in the tileAligned memory-mapped file.
-        set_size_t_ExternalSegment freeTiles;
+        FreeTilesBitmap_ExternalSegment freeTiles;
 
         // Protects the LRU list. This is separate to the bucketLock because even if we just access
         // the cache in read mode (in the get() function) we still need to update the LRU list, thus
@@ -259,12 +415,44 @@ struct CacheBucket
         // Pointers in shared memory to the lru list from node and back node
         bip::offset_ptr<LRUListNode> lruListFront, lruListBack;
 
+        // All entries of the LRU list ordered by their eviction priority: the first one
+        // is evicted first by the cost-aware eviction policy.
+        // Protected by lruListMutex
+        set_CacheEvictionKey_ExternalSegment evictionQueue;
+
+        // The eviction priority of the last evicted entry (the "L" value of GreedyDual-Size).
+        // Protected by lruListMutex
+        double evictionClock;
 
-        IPCData(const Size_t_Allocator_ExternalSegment& freeTilesAllocator)
+        // The evicted tiles kept in the compressed tiles file and their location in the file.
+        // Protected by the tocData.segmentMutex
+        map_CompressedTileLocation_ExternalSegment compressedTiles;
+
+        // The size of the used portion of the compressed tiles file: tiles are appended at this offset.
+        // Protected by the tocData.segmentMutex
+        U64 compressedTilesFileSize;
+
+        // Incremented each time the compressed tiles file starts over from the beginning. The file is read and written
+        // without the tocData.segmentMutex: a tile read or written whilst the generation changed may have been overwritten.
+        // Protected by the tocData.segmentMutex
+        U64 compressedTilesGeneration;
+
+        // The number of tiles being written to the space they reserved in the compressed tiles file.
+        // The file does not start over until they are done: if a process dies whilst writing, the compressed tier
+        // of the bucket stops accepting tiles once full, until the bucket is wiped. Protected by the tocData.segmentMutex
+        U32 nPendingCompressedWrites;
+
+        IPCData(const U64_Allocator_ExternalSegment& freeTilesAllocator)
         : freeTiles(freeTilesAllocator)
         , lruListMutex()
         , lruListFront(0)
         , lruListBack(0)
+        , evictionQueue( CacheEvictionKey_Allocator_ExternalSegment( freeTilesAllocator.get_segment_manager() ) )
+        , evictionClock(0)
+        , compressedTiles( std::less<U64>(), CompressedTileLocation_Allocator_ExternalSegment( freeTilesAllocator.get_segment_manager() ) )
+        , compressedTilesFileSize(0)
+        , compressedTilesGeneration(0)
+        , nPendingCompressedWrites(0)
         {
 
         }
@@ -291,23 +479,121 @@ struct CacheBucket
     // Pointer to the IPC data that live in tocFile memory mapped file
     IPCData *ipc;
 
+    // Path of the append-only file holding the evicted tiles of the compressed tier, see IPCData::compressedTiles.
+    // Empty with the eCacheBackendAnonymousMemory backend, which has no compressed tier.
+    std::string compressedTilesFilePath;
+
+    // Unbuffered handles on the compressed tiles file, opened on first use and kept open by this process.
+    // Protected by compressedTilesFileMutex, which is never taken with the tocData.segmentMutex.
+    FStreamsSupport::ofstream compressedTilesOutput;
+    FStreamsSupport::ifstream compressedTilesInput;
+    QMutex compressedTilesFileMutex;
+
     // Weak pointer to the cache
     CacheWPtr cache;
 
     // The index of this bucket in the cache
     int bucketIndex;
 
+    // The size of a tile in tileAlignedFile, same as CachePrivate::tileSizeBytes
+    std::size_t tileSizeBytes;
+
+    // Statistics of the operations made by this process on the bucket: lives in process memory
+    CacheStatsRecorder stats;
+
+    // Set with release semantics once this process opened and checked the ToC and tile files.
+    // Buckets are opened on first access, see CachePrivate::getBucket, or in the background after Cache::create.
+    mutable QAtomicInt opened;
+
+    // Serializes the opening of the bucket files by the threads of this process
+    QMutex openedMutex;
+
     CacheBucket()
     : tileAlignedFile()
     , tocFile()
     , tocFileManager()
     , ipc(0)
+    , compressedTilesFilePath()
+    , compressedTilesOutput()
+    , compressedTilesInput()
+    , compressedTilesFileMutex()
     , cache()
     , bucketIndex(-1)
+    , tileSizeBytes(0)
+    , stats()
+    , opened(0)
+    , openedMutex()
     {
 
     }
 
+    /**
+     * @brief Returns true if the bucket files are opened in this process. The load has acquire semantics
+     * so that the files can be used without taking the openedMutex if it returns true.
+     **/
+    bool isOpened() const
+    {
+#if QT_VERSION < 0x050000
+        return opened.fetchAndAddAcquire(0) != 0;
+#else
+        return opened.loadAcquire() != 0;
+#endif
+    }
+
+    /**
+     * @brief Opens the given bucket of the cache if it is still alive. Called in parallel for all buckets
+     * on the global thread pool by Cache::create. Returns false if the bucket could not be opened.
+     **/
+    static bool openInBackground(const CacheWPtr& cache, int bucketIndex);
+
+    /**
+     * @brief Returns false if the ToC and the tile file are inconsistent, e.g: because they were truncated or a process
+     * crashed whilst writing them. This walks the LRU list and checks that each entry is referenced by its node
+     * and that its tile is allocated.
+     * The tocData.segmentMutex and tileData.segmentMutex are assumed to be taken for write lock.
+     **/
+    bool checkIntegrity();
+
+
+    /**
+     * @brief Copies the given tile of the tile aligned file to data. Returns false if the tile could not be read.
+     * The tocData.segmentMutex is assumed to be taken for write lock. This function takes the tileData.segmentMutex.
+     **/
+    bool copyTile(int tileCacheIndex, std::vector<char>* data);
+
+    /**
+     * @brief Compresses a tile returned by copyTile, appends it to the compressed tiles file and records its location.
+     * If the file would grow above maxFileSize, the compressed tier of the bucket is emptied first: the file
+     * is append-only and is not compacted.
+     * The compression and the write are done without holding the tocData.segmentMutex: it is only taken to reserve
+     * space in the file and then to record the location of the tile.
+     * Returns false if the tile could not be written. The size of the written data is set in writtenSize.
+     * This function takes the tocData.segmentMutex: the caller must not hold it.
+     **/
+    bool writeCompressedTile(U64 hash, const std::vector<char>& tileData, int elementSize, std::size_t maxFileSize, std::size_t* writtenSize);
+
+    /**
+     * @brief If the tile with the given hash is in the compressed tier, removes it from the tier and decompresses it
+     * to tileData, which must be tileSizeBytes long. Returns false if it is not in the tier or cannot be read.
+     * This function takes the tocData.segmentMutex but does not hold it whilst reading the file.
+     **/
+    bool readCompressedTile(U64 hash, char* tileData);
+
+private:
+
+    /**
+     * @brief Writes a record at the given offset of the compressed tiles file, using the process handle.
+     * Takes the compressedTilesFileMutex.
+     **/
+    bool writeCompressedTileRecord(U64 offset, const CompressedTileHeader& header, const std::vector<char>& data);
+
+    /**
+     * @brief Reads the record at the given location of the compressed tiles file, using the process handle.
+     * Takes the compressedTilesFileMutex.
+     **/
+    bool readCompressedTileRecord(const CompressedTileLocation& location, CompressedTileHeader* header, std::vector<char>* data);
+
+public:
 
     /**
      * @brief Deallocates the cacheEntry from the ToC memory mapped file.
@@ -368,7 +654,7 @@ struct CacheBucket
      * @param minFreeSize Indicates that the file should have at least this amount of free bytes.
      * If not, this function will call growTileFile.
      * If the file is empty and minFreeSize is 0, the file will at least be grown to a size of
-     * NATRON_TILE_SIZE_BYTES * NATRON_CACHE_FILE_GROW_N_TILES
+     * NATRON_CACHE_FILE_GROW_N_BYTES
      **/
     void ensureTileMappingValid(WriteLock& lock, std::size_t minFreeSize);
 
@@ -416,6 +702,13 @@ struct CacheEntryLockerPrivate
     // A string version of the hash, uniquely identifying the MemorySegmentEntry in the memory mapped file
     std::string hashStr;
 
+    // Measures the time taken to compute the entry, from the look-up to insertInCache
+    TimeLapse computeTimer;
+
+    // If not negative, the compute cost recorded for the entry instead of the time measured by computeTimer:
+    // entries imported from a pack were computed by another process
+    double importedComputeCost;
+
     CacheEntryLockerPrivate(CacheEntryLocker* publicInterface, const CachePtr& cache, const CacheEntryBasePtr& entry)
     : _publicInterface(publicInterface)
     , cache(cache)
@@ -424,12 +717,36 @@ struct CacheEntryLockerPrivate
     , cacheEntryLock()
     , status(CacheEntryLocker::eCacheEntryStatusMustCompute)
     , hashStr()
+    , computeTimer()
+    , importedComputeCost(-1)
     {
 
         U64 hash = entry->getHashKey();
         hashStr = CacheEntryKeyBase::hashToString(hash);
     }
 
+    CacheBucket& getBucket() const;
+
+    int getPluginStatsIndex() const;
+
+    /**
+     * @brief Records a look-up in the bucket statistics according to the status. This also restarts the computeTimer
+     * so that the look-up is not accounted in the compute cost.
+     **/
+    void recordLookup();
+
+    /**
+     * @brief Called when the entry was not found in the cache and this locker must compute it: if the entry is a tile
+     * that was evicted to the compressed tier, decompress it and insert it back in the cache instead.
+     **/
+    void readFromCompressedTier();
+
+    /**
+     * @brief Creates the entry in the ToC with a pending status and takes its lock, so that this locker computes it
+     * and other lookers wait for it. The tocData.segmentMutex of the bucket must be taken in write mode and the entry
+     * must not exist in the ToC.
+     **/
+    void createPendingEntryImpl();
 
 };
 
@@ -461,12 +778,34 @@ struct CachePrivate
     // only protects against threads.
     QMutex maximumSizesMutex;
 
+    // The maximum size of the compressed tier: evicted tiles are compressed and appended to a file of each bucket
+    // of at most maximumCompressedTierSize / NATRON_CACHE_BUCKETS_COUNT bytes. 0 disables the tier.
+    // Like the other maximum sizes, this is local to the process and protected by maximumSizesMutex.
+    std::size_t maximumCompressedTierSize;
+
+    // When not 0, the RAM used by the process for the cache must remain under this budget, see Cache::setMemoryBudget.
+    // This is set by the CacheMemoryGovernor according to the memory pressure of the system.
+    // Local to the process and protected by maximumSizesMutex.
+    std::size_t memoryBudget;
+
+    // How entries are evicted by this process. Like the maximum sizes, this is local to the process.
+    // Protected by evictionPolicyMutex
+    CacheEvictionPolicyEnum evictionPolicy;
+    mutable QMutex evictionPolicyMutex;
+
     // Each bucket handle entries with the 2 first hexadecimal numbers of the hash
     // This allows to hopefully dispatch threads and processes in 256 different buckets so that they are less likely
     // to take the same lock.
     // Each bucket is interprocess safe by itself.
     CacheBucket buckets[NATRON_CACHE_BUCKETS_COUNT];
 
+    // Process-local copy of the small entries that are looked-up very often, to avoid taking the interprocess
+    // locks of the buckets and deserializing from the memory segment. This is thread-safe.
+    ProcessLocalCache processLocalCache;
+
+    // Recycles the buffers of the RAM images of this process. This is thread-safe.
+    RAMBufferPoolPtr ramBufferPool;
+
     struct IPCData
     {
 
@@ -694,11 +1033,30 @@ struct CachePrivate
     // The IPC data object created in globalMemorySegment shared memory
     IPCData* ipc;
 
+    // Where the entries are stored. Set once in Cache::create
+    CacheBackendEnum backend;
+
+    // With eCacheBackendAnonymousMemory, the IPC data lives in process memory instead of the globalMemorySegment
+    // and ipc points to it. There is then no file lock, semaphore or shared memory.
+    boost::scoped_ptr<IPCData> processLocalIPC;
+
     // Path of the directory that should contain the cache directory itself.
     // This is controled by a Natron setting. By default it points to a standard system dependent
     // location.
     std::string directoryContainingCachePath;
 
+    // The size of a 8 bit tile is pow(2, tileSizePo2) pixels in each dimension.
+    // Set once in Cache::create
+    int tileSizePo2;
+
+    // The size in bytes of a tile, whatever its bitdepth
+    std::size_t tileSizeBytes;
+
+    // Statistics of the locks that do not belong to a bucket, such as the sizeLock.
+    // The buckets also record the statistics of each plug-in in it.
+    // Lives in process memory.
+    CacheStatsRecorder globalStats;
+
 
     CachePrivate(Cache* publicInterface)
     : _publicInterface(publicInterface)
@@ -706,7 +1064,13 @@ struct CachePrivate
     , maximumInMemorySize((std::size_t)4 * 1024 * 1024 * 1024) // 4GB in RAM max by default
     , maximumGLTextureSize(0) // This is updated once we get GPU infos
     , maximumSizesMutex()
+    , maximumCompressedTierSize(0)
+    , memoryBudget(0)
+    , evictionPolicy(eCacheEvictionPolicyLRU)
+    , evictionPolicyMutex()
     , buckets()
+    , processLocalCache(NATRON_CACHE_PROCESS_LOCAL_MAX_ENTRIES)
+    , ramBufferPool( new RAMBufferPool(NATRON_CACHE_RAM_BUFFER_POOL_MAX_BYTES) )
     , globalMemorySegment()
     , globalMemorySegmentFileLock()
     , nSHMInvalidSem()
@@ -715,9 +1079,16 @@ struct CachePrivate
     , nThreadsTimedOutFailed(0)
     , nThreadsTimedOutFailedCond()
     , ipc(0)
+    , backend(eCacheBackendMappedFiles)
+    , processLocalIPC()
     , directoryContainingCachePath()
+    , tileSizePo2(NATRON_8BIT_TILE_SIZE_PO2)
+    , tileSizeBytes(0)
+    , globalStats()
     {
-
+        for (int i = 0; i < NATRON_CACHE_BUCKETS_COUNT; ++i) {
+            buckets[i].stats.setPluginStatsRecorder(&globalStats);
+        }
 
     }
 
@@ -727,23 +1098,100 @@ struct CachePrivate
 
     void initializeCacheDirPath();
 
+    void initializeTileSize(int tileSizePo2);
+
+    /**
+     * @brief Returns the name of the cache directory. It contains the serialization version, marked if the keys
+     * are computed in CRC64 compatibility mode, and the tile size so that caches that cannot be read by this
+     * process are left untouched.
+     **/
+    std::string getCacheDirectoryName() const;
+
     void ensureCacheDirectoryExists();
 
     void incrementCacheSize(long long size, StorageModeEnum storage);
 
+    /**
+     * @brief Returns the maximum size of the entries of the backend, without the memory budget:
+     * the maximum disk size for the mapped files, the maximum RAM size for the anonymous memory.
+     * The maximumSizesMutex must be locked.
+     **/
+    std::size_t getMaximumEntriesSize() const;
+
+    /**
+     * @brief Returns the size of the images allocated in RAM (eStorageModeRAM) by all processes sharing the cache.
+     **/
+    std::size_t getRAMImagesSize();
+
+    /**
+     * @brief Removes the entry with the given hash from the cache and from the compressed tier.
+     * Returns the number of bytes that were freed. The bucket of the entry must not be locked.
+     **/
+    std::size_t removeEntryForHash(U64 hash);
+
+    /**
+     * @brief Removes the entries derived from the image tile with the given hash, i.e: its mipmaps,
+     * which must not outlive the tile. Returns the number of bytes that were freed.
+     * The derived entries may be in any bucket: no bucket may be locked by the caller.
+     **/
+    std::size_t removeTileDerivedEntries(U64 tileHash);
+
     QString getBucketAbsoluteDirPath(int bucketIndex) const;
 
     std::string getSharedMemoryName() const;
 
     std::size_t getSharedMemorySize() const;
 
+    /**
+     * @brief Creates the file lock, the semaphores and the globalMemorySegment shared with other processes,
+     * and sets ipc. Only used by the eCacheBackendMappedFiles backend.
+     **/
+    void createSharedMemory();
+
+    /**
+     * @brief Returns the bucket at the given index. The first call in this process opens and checks the
+     * bucket files, which may throw an exception if they cannot be created.
+     **/
+    CacheBucket& getBucket(int bucketIndex);
+
+    /**
+     * @brief Opens the ToC and tile files of the bucket and checks their integrity.
+     * A bucket that fails the check is wiped on its own, the other buckets are left untouched.
+     **/
+    void openBucket(int bucketIndex);
+
+    /**
+     * @brief Opens the ToC and tile files of the bucket and ensures their mapping is valid.
+     * If wipe is true, the files are removed first and re-created empty.
+     * The tocData.segmentMutex and tileData.segmentMutex of the bucket are assumed to be taken for write lock.
+     **/
+    void openBucketFiles(int bucketIndex, bool wipe, WriteLock& tocWriteLock, WriteLock& tileWriteLock);
+
     void ensureSharedMemoryIntegrity();
 
+    /**
+     * @brief Returns the statistics recorder of the bucket owning the given mutex. If bucketIndex is -1,
+     * the bucket is deduced from the address of the mutex if it is one of the IPCData::bucketsData mutexes.
+     **/
+    CacheStatsRecorder& getLockStatsRecorder(const void* mutex, int bucketIndex);
+
 };
 
+/**
+ * @brief Takes the given interprocess lock. Locks that could not be taken right away are accounted in the statistics of
+ * the given bucket, unless recordContention is false: this is used for the cache entry locks on which threads
+ * wait for another thread to compute the entry, which is accounted as a pending wait instead.
+ **/
 template <typename LOCK>
-void createLock(CachePrivate* imp, boost::scoped_ptr<LOCK>& lock, typename LOCK::mutex_type* mutex)
+void createLock(CachePrivate* imp, boost::scoped_ptr<LOCK>& lock, typename LOCK::mutex_type* mutex, int bucketIndex = -1, bool recordContention = true)
 {
+    // Most of the time the lock is free: only the locks that could not be taken right away are timed
+    lock.reset(new LOCK(*mutex, bip::try_to_lock));
+    if (lock->owns()) {
+        return;
+    }
+    TimeLapse waitTimer;
+
     // Take the lock. After lockTimeOutMS milliseconds, if the locks is not taken, we check the integrity of the
     // shared memory segment and retry the lock.
     // Another process could have taken the lock and crashed, leaving the shared memory in a bad state.
@@ -760,6 +1208,68 @@ void createLock(CachePrivate* imp, boost::scoped_ptr<LOCK>& lock, typename LOCK:
             break;
         }
     }
+    if (recordContention) {
+        imp->getLockStatsRecorder(mutex, bucketIndex).addContendedLock( waitTimer.getTimeElapsedReset() );
+    }
+}
+
+CacheStatsRecorder&
+CachePrivate::getLockStatsRecorder(const void* mutex, int bucketIndex)
+{
+    if ( (bucketIndex == -1) && ipc ) {
+        const char* bucketsDataBegin = reinterpret_cast<const char*>(ipc->bucketsData);
+        const char* mutexAddress = reinterpret_cast<const char*>(mutex);
+        if ( (mutexAddress >= bucketsDataBegin) && ( mutexAddress < bucketsDataBegin + sizeof(ipc->bucketsData) ) ) {
+            bucketIndex = (mutexAddress - bucketsDataBegin) / sizeof(ipc->bucketsData[0]);
+        }
+    }
+    if (bucketIndex == -1) {
+        return globalStats;
+    }
+    return buckets[bucketIndex].stats;
+}
+
+CacheBucket&
+CacheEntryLockerPrivate::getBucket() const
+{
+    if (bucket) {
+        return *bucket;
+    }
+    return cache->_imp->getBucket( Cache::getBucketCacheBucketIndex( processLocalEntry->getHashKey() ) );
+}
+
+int
+CacheEntryLockerPrivate::getPluginStatsIndex() const
+{
+    CacheEntryKeyBasePtr key = processLocalEntry->getKey();
+    if (!key) {
+        return 0;
+    }
+    return key->getHolderPluginStatsIndex();
+}
+
+void
+CacheEntryLockerPrivate::recordLookup()
+{
+    getBucket().stats.addLookup( getPluginStatsIndex(), status == CacheEntryLocker::eCacheEntryStatusCached, computeTimer.getTimeElapsedReset() );
+}
+
+void
+CacheEntryLockerPrivate::readFromCompressedTier()
+{
+    assert(status == CacheEntryLocker::eCacheEntryStatusMustCompute);
+    if ( !processLocalEntry->isStorageTiled() || (cache->getCompressedTierMaximumSize() == 0) ) {
+        return;
+    }
+
+    TimeLapse readTimer;
+    std::vector<char> tileData(bucket->tileSizeBytes);
+    bool found = bucket->readCompressedTile(processLocalEntry->getHashKey(), &tileData[0]) && processLocalEntry->fromTileData(&tileData[0]);
+    bucket->stats.addCompressedLookup( getPluginStatsIndex(), found, readTimer.getTimeElapsedReset() );
+    if (found) {
+        // This sets the status to eCacheEntryStatusCached and releases the entry lock
+        _publicInterface->insertInCache();
+    }
 }
 
 CacheEntryLocker::CacheEntryLocker(const CachePtr& cache, const CacheEntryBasePtr& entry)
@@ -776,7 +1286,23 @@ CacheEntryLocker::create(const CachePtr& cache, const CacheEntryBasePtr& entry)
         throw std::invalid_argument("CacheEntryLocker::create: no entry");
     }
     CacheEntryLockerPtr ret(new CacheEntryLocker(cache, entry));
+
+    // Small entries are first looked-up in the process-local cache which does not require any interprocess lock
+    bool processLocalCacheable = entry->isProcessLocalCacheable();
+    if ( processLocalCacheable && cache->_imp->processLocalCache.get(entry) ) {
+#ifdef CACHE_TRACE_ENTRY_ACCESS
+        qDebug() << ret->_imp->hashStr.c_str() << ": entry cached in process";
+#endif
+        ret->_imp->status = eCacheEntryStatusCached;
+        ret->_imp->recordLookup();
+        return ret;
+    }
+
     ret->lookupAndSetStatus(false /*takeEntryLock*/);
+    ret->_imp->recordLookup();
+    if (processLocalCacheable && ret->_imp->status == eCacheEntryStatusCached) {
+        cache->_imp->processLocalCache.insert(entry);
+    }
     return ret;
 }
 
@@ -801,7 +1327,12 @@ static void ensureMappingValidInternal(WriteLock& lock,
                                        const MemoryFilePtr& memoryMappedFile,
                                        CachePrivate::IPCData::SharedMemorySegmentData* segment)
 {
-    memoryMappedFile->close();
+    // An anonymous mapping only exists in this process: it cannot be re-opened, and is always up to date
+    // since only this process grows it.
+    const bool isAnonymous = memoryMappedFile->isAnonymous();
+    if (!isAnonymous) {
+        memoryMappedFile->close();
+    }
     std::string filePath = memoryMappedFile->path();
 
     // Decrement nProcessWithMappingValid and notify the thread that is resizing
@@ -815,7 +1346,9 @@ static void ensureMappingValidInternal(WriteLock& lock,
         segment->mappingInvalidCond.wait(lock);
     }
 
-    memoryMappedFile->open(filePath, MemoryFile::eFileOpenModeOpenOrCreate);
+    if (!isAnonymous) {
+        memoryMappedFile->open(filePath, MemoryFile::eFileOpenModeOpenOrCreate);
+    }
     ++segment->nProcessWithMappingValid;
 } // ensureMappingValidInternal
 
@@ -834,7 +1367,7 @@ static void reOpenToCData(CacheBucket* bucket, bool create)
     }
 
     // The ipc data pointer must be re-fetched
-    Size_t_Allocator_ExternalSegment freeTilesAllocator(bucket->tocFileManager->get_segment_manager());
+    U64_Allocator_ExternalSegment freeTilesAllocator(bucket->tocFileManager->get_segment_manager());
     bucket->ipc = bucket->tocFileManager->find_or_construct<CacheBucket::IPCData>("BucketData")(freeTilesAllocator);
 }
 
@@ -875,27 +1408,21 @@ CacheBucket::ensureToCFileMappingValid(WriteLock& lock, std::size_t minFreeSize)
 
 } // ensureToCFileMappingValid
 
-static void flushTileMapping(const MemoryFilePtr& tileAlignedFile, const set_size_t_ExternalSegment& freeTiles)
+static void flushTileMapping(const MemoryFilePtr& tileAlignedFile, const FreeTilesBitmap_ExternalSegment& freeTiles, std::size_t tileSizeBytes)
 {
 
     // Save only allocated tiles portion
-    assert(tileAlignedFile->size() % NATRON_TILE_SIZE_BYTES == 0);
-    std::size_t nTiles = tileAlignedFile->size() / NATRON_TILE_SIZE_BYTES;
-
-    std::vector<bool> allocatedTiles(nTiles, true);
-
-    // Mark all free tiles as not allocated
-    for (set_size_t_ExternalSegment::const_iterator it = freeTiles.begin(); it != freeTiles.end(); ++it) {
-        allocatedTiles[*it] = false;
-    }
-
-    for (std::size_t i = 0; i < allocatedTiles.size(); ++i) {
-        std::size_t dataOffset = i * NATRON_TILE_SIZE_BYTES;
-        if (allocatedTiles[i]) {
-            tileAlignedFile->flush(MemoryFile::eFlushTypeSync, tileAlignedFile->data() + dataOffset, NATRON_TILE_SIZE_BYTES);
-        } else {
-            tileAlignedFile->flush(MemoryFile::eFlushTypeInvalidate, tileAlignedFile->data() + dataOffset, NATRON_TILE_SIZE_BYTES);
-        }
+    assert(tileAlignedFile->size() % tileSizeBytes == 0);
+    std::size_t nTiles = std::min(tileAlignedFile->size() / tileSizeBytes, freeTiles.getTilesCount());
+
+    // Flush consecutive tiles in the same state at once
+    std::size_t i = 0;
+    while (i < nTiles) {
+        bool isFree;
+        std::size_t runLength = std::min(freeTiles.getRunLength(i, &isFree), nTiles - i);
+        char* runData = tileAlignedFile->data() + i * tileSizeBytes;
+        tileAlignedFile->flush(isFree ? MemoryFile::eFlushTypeInvalidate : MemoryFile::eFlushTypeSync, runData, runLength * tileSizeBytes);
+        i += runLength;
     }
 } // flushTileMapping
 
@@ -906,9 +1433,9 @@ CacheBucket::ensureTileMappingValid(WriteLock& lock, std::size_t minFreeSize)
     CachePtr c = cache.lock();
     if (!c->_imp->ipc->bucketsData[bucketIndex].tileData.mappingValid) {
         // The number of memory free requested must be a multiple of the tile size.
-        assert(minFreeSize == 0 || minFreeSize % NATRON_TILE_SIZE_BYTES == 0);
+        assert(minFreeSize == 0 || minFreeSize % tileSizeBytes == 0);
 
-        flushTileMapping(tileAlignedFile, ipc->freeTiles);
+        flushTileMapping(tileAlignedFile, ipc->freeTiles, tileSizeBytes);
     }
 
 #ifdef CACHE_TRACE_FILE_MAPPING
@@ -922,7 +1449,7 @@ CacheBucket::ensureTileMappingValid(WriteLock& lock, std::size_t minFreeSize)
         growTileFile(lock, minFreeSize);
     } else {
 
-        std::size_t freeMem = ipc->freeTiles.size() * NATRON_TILE_SIZE_BYTES;
+        std::size_t freeMem = ipc->freeTiles.getFreeTilesCount() * tileSizeBytes;
 
         // Check that there's enough memory, if not grow the file
         if (freeMem < minFreeSize) {
@@ -930,7 +1457,7 @@ CacheBucket::ensureTileMappingValid(WriteLock& lock, std::size_t minFreeSize)
             growTileFile(lock, minbytesToGrow);
         }
     }
-    assert(ipc->freeTiles.size() * NATRON_TILE_SIZE_BYTES >= minFreeSize);
+    assert(ipc->freeTiles.getFreeTilesCount() * tileSizeBytes >= minFreeSize);
 
 } // ensureTileMappingValid
 
@@ -941,6 +1468,8 @@ CacheBucket::growToCFile(WriteLock& lock, std::size_t bytesToAdd)
 
     CachePtr c = cache.lock();
 
+    TimeLapse growTimer;
+
     c->_imp->ipc->bucketsData[bucketIndex].tocData.mappingValid = false;
 
     --c->_imp->ipc->bucketsData[bucketIndex].tocData.nProcessWithMappingValid;
@@ -971,6 +1500,8 @@ CacheBucket::growToCFile(WriteLock& lock, std::size_t bytesToAdd)
 
     c->_imp->ipc->bucketsData[bucketIndex].tocData.mappingInvalidCond.notify_all();
 
+    stats.addFileGrowth( growTimer.getTimeElapsedReset() );
+
 } // growToCFile
 
 void
@@ -981,6 +1512,8 @@ CacheBucket::growTileFile(WriteLock& lock, std::size_t bytesToAdd)
 
     CachePtr c = cache.lock();
 
+    TimeLapse growTimer;
+
     c->_imp->ipc->bucketsData[bucketIndex].tileData.mappingValid = false;
 
     --c->_imp->ipc->bucketsData[bucketIndex].tileData.nProcessWithMappingValid;
@@ -991,15 +1524,15 @@ CacheBucket::growTileFile(WriteLock& lock, std::size_t bytesToAdd)
 
     {
         // Update free tiles
-        flushTileMapping(tileAlignedFile, ipc->freeTiles);
+        flushTileMapping(tileAlignedFile, ipc->freeTiles, tileSizeBytes);
 
         {
             // Resize the file
             std::size_t curSize = tileAlignedFile->size();
             // The current size must be a multiple of the tile size
-            assert(curSize % NATRON_TILE_SIZE_BYTES == 0);
+            assert(curSize % tileSizeBytes == 0);
 
-            const std::size_t minTilesToAllocSize = NATRON_CACHE_FILE_GROW_N_TILES * NATRON_TILE_SIZE_BYTES;
+            const std::size_t minTilesToAllocSize = NATRON_CACHE_FILE_GROW_N_BYTES;
 
             std::size_t newSize = curSize + bytesToAdd;
             // Round to the nearest next multiple of minTilesToAllocSize
@@ -1011,13 +1544,12 @@ CacheBucket::growTileFile(WriteLock& lock, std::size_t bytesToAdd)
 #endif
 
 
-            int nTilesSoFar = curSize / NATRON_TILE_SIZE_BYTES;
-            int newNTiles = newSize / NATRON_TILE_SIZE_BYTES;
+            std::size_t newNTiles = newSize / tileSizeBytes;
 
-            // Insert the new available tiles in the freeTiles set
-            for (int i = nTilesSoFar; i < newNTiles; ++i) {
-                ipc->freeTiles.insert((std::size_t)i);
-            }
+            // Mark the new tiles available. If the ToC was re-created, the tiles already in the file
+            // are not referenced by any entry: they are free as well.
+            assert(ipc->freeTiles.getTilesCount() <= curSize / tileSizeBytes);
+            ipc->freeTiles.grow(newNTiles - ipc->freeTiles.getTilesCount());
         }
     }
 
@@ -1028,6 +1560,7 @@ CacheBucket::growTileFile(WriteLock& lock, std::size_t bytesToAdd)
 
     c->_imp->ipc->bucketsData[bucketIndex].tileData.mappingInvalidCond.notify_all();
 
+    stats.addFileGrowth( growTimer.getTimeElapsedReset() );
 
 } // growTileFile
 
@@ -1106,7 +1639,7 @@ CacheBucket::readFromSharedMemoryEntryImpl(MemorySegmentEntryHeader* cacheEntry,
             }
 
 
-            tileDataPtr = tileAlignedFile->data() + cacheEntry->tileCacheIndex * NATRON_TILE_SIZE_BYTES;
+            tileDataPtr = tileAlignedFile->data() + cacheEntry->tileCacheIndex * tileSizeBytes;
         }
 
 
@@ -1121,17 +1654,34 @@ CacheBucket::readFromSharedMemoryEntryImpl(MemorySegmentEntryHeader* cacheEntry,
         // Take the LRU list mutex
         {
             boost::scoped_ptr<bip::scoped_lock<bip::interprocess_mutex> > lruWriteLock;
-            createLock<bip::scoped_lock<bip::interprocess_mutex> >(c->_imp.get(), lruWriteLock, &ipc->lruListMutex);
+            createLock<bip::scoped_lock<bip::interprocess_mutex> >(c->_imp.get(), lruWriteLock, &ipc->lruListMutex, bucketIndex);
 
             assert(ipc->lruListBack && !ipc->lruListBack->next);
             if (ipc->lruListBack != cacheEntry->lruIterator) {
 
+                if (ipc->lruListFront == cacheEntry->lruIterator) {
+                    ipc->lruListFront = cacheEntry->lruIterator->next;
+                }
                 disconnectLinkedListNode(cacheEntry->lruIterator);
 
                 // And push_back to the tail of the list...
                 insertLinkedListNode(cacheEntry->lruIterator, ipc->lruListBack, bip::offset_ptr<LRUListNode>(0));
                 ipc->lruListBack = cacheEntry->lruIterator;
             }
+
+            // A hit restores the priority of the entry relatively to the current clock.
+            // The clock only moves when a process evicts with the cost-aware policy: until then the priority
+            // is unchanged and the node of the eviction queue is left in place.
+            std::size_t entrySize = cacheEntry->size;
+            if (cacheEntry->tileCacheIndex != -1) {
+                entrySize += tileSizeBytes;
+            }
+            double evictionPriority = getCacheEntryEvictionPriority(ipc->evictionClock, cacheEntry->computeCost, entrySize);
+            if (evictionPriority != cacheEntry->lruIterator->evictionPriority) {
+                ipc->evictionQueue.erase( CacheEvictionKey(cacheEntry->lruIterator->evictionPriority, cacheEntry->lruIterator->hash) );
+                cacheEntry->lruIterator->evictionPriority = evictionPriority;
+                ipc->evictionQueue.insert( CacheEvictionKey(cacheEntry->lruIterator->evictionPriority, cacheEntry->lruIterator->hash) );
+            }
         } // lruWriteLock
 
     } catch (...) {
@@ -1173,15 +1723,15 @@ CacheBucket::deallocateCacheEntryImpl(MemorySegmentEntryHeader* cacheEntry,
             ensureTileMappingValid(*writeLock, 0);
 
             // Invalidate this portion of the memory mapped file
-            std::size_t dataOffset = cacheEntry->tileCacheIndex * NATRON_TILE_SIZE_BYTES;
-            tileAlignedFile->flush(MemoryFile::eFlushTypeInvalidate, tileAlignedFile->data() + dataOffset, NATRON_TILE_SIZE_BYTES);
+            std::size_t dataOffset = cacheEntry->tileCacheIndex * tileSizeBytes;
+            tileAlignedFile->flush(MemoryFile::eFlushTypeInvalidate, tileAlignedFile->data() + dataOffset, tileSizeBytes);
         }
         
 
         // Make this tile free again
-        std::pair<set_size_t_ExternalSegment::iterator, bool>  insertOk = ipc->freeTiles.insert(cacheEntry->tileCacheIndex);
-        assert(insertOk.second);
-        (void)insertOk;
+        bool freeOk = ipc->freeTiles.freeTile(cacheEntry->tileCacheIndex);
+        assert(freeOk);
+        (void)freeOk;
         cacheEntry->tileCacheIndex = -1;
     }
 
@@ -1191,7 +1741,7 @@ CacheBucket::deallocateCacheEntryImpl(MemorySegmentEntryHeader* cacheEntry,
         {
             // Take the lock of the LRU list.
             boost::scoped_ptr<bip::scoped_lock<bip::interprocess_mutex> > lruWriteLock;
-            createLock<bip::scoped_lock<bip::interprocess_mutex> >(c->_imp.get(), lruWriteLock, &ipc->lruListMutex);
+            createLock<bip::scoped_lock<bip::interprocess_mutex> >(c->_imp.get(), lruWriteLock, &ipc->lruListMutex, bucketIndex);
 
             // Ensure the back and front pointers do not point to this entry
             if (cacheEntry->lruIterator == ipc->lruListBack) {
@@ -1203,6 +1753,7 @@ CacheBucket::deallocateCacheEntryImpl(MemorySegmentEntryHeader* cacheEntry,
 
             // Remove this entry's node from the list
             disconnectLinkedListNode(cacheEntry->lruIterator);
+            ipc->evictionQueue.erase( CacheEvictionKey(cacheEntry->lruIterator->evictionPriority, cacheEntry->lruIterator->hash) );
 
             tocFileManager->deallocate(cacheEntry->lruIterator.get());
         }
@@ -1225,40 +1776,291 @@ CacheBucket::deallocateCacheEntryImpl(MemorySegmentEntryHeader* cacheEntry,
     tocFileManager->destroy<MemorySegmentEntryHeader>(hashStr.c_str());
 } // deallocateCacheEntryImpl
 
-
-void
-CacheEntryLocker::lookupAndSetStatus(bool takeEntryLock)
+bool
+CacheBucket::copyTile(int tileCacheIndex,
+                      std::vector<char>* data)
 {
+    // Private - the tocData.segmentMutex is assumed to be taken for write lock
+    CachePtr c = cache.lock();
+    try {
+        boost::scoped_ptr<ReadLock> tileReadLock;
+        boost::scoped_ptr<WriteLock> tileWriteLock;
+        createLock<ReadLock>(c->_imp.get(), tileReadLock, &c->_imp->ipc->bucketsData[bucketIndex].tileData.segmentMutex);
+        if ( !isTileFileMappingValid() ) {
+            tileReadLock.reset();
+            createLock<WriteLock>(c->_imp.get(), tileWriteLock, &c->_imp->ipc->bucketsData[bucketIndex].tileData.segmentMutex);
+            ensureTileMappingValid(*tileWriteLock, 0);
+        }
 
-    // Get the bucket corresponding to the hash. This will dispatch threads in (hopefully) different
-    // buckets
-    if (!_imp->bucket) {
-        U64 hash = _imp->processLocalEntry->getHashKey();
-        _imp->bucket = &_imp->cache->_imp->buckets[Cache::getBucketCacheBucketIndex(hash)];
+        const char* tileDataPtr = tileAlignedFile->data() + tileCacheIndex * tileSizeBytes;
+        data->assign(tileDataPtr, tileDataPtr + tileSizeBytes);
+    } catch (const std::exception& e) {
+        qDebug() << "Failed to copy tile of cache bucket" << bucketIndex << ":" << e.what();
+        return false;
     }
+    return true;
+} // copyTile
 
-    {
-        // Take the read lock: many threads/processes can try read at the same time
-        boost::scoped_ptr<ReadLock> readLock;
-        createLock<ReadLock>(_imp->cache->_imp.get(), readLock, &_imp->cache->_imp->ipc->bucketsData[_imp->bucket->bucketIndex].tocData.segmentMutex);
-
-        boost::scoped_ptr<WriteLock> writeLock;
-        // Every time we take the lock, we must ensure the memory mapping is ok
-        if (!_imp->bucket->isToCFileMappingValid()) {
-            // Remove the read lock, and take a write lock.
-            // This could allow other threads to run in-between, but we don't care since nothing happen.
-            readLock.reset();
-
-            createLock<WriteLock>(_imp->cache->_imp.get(), writeLock, &_imp->cache->_imp->ipc->bucketsData[_imp->bucket->bucketIndex].tocData.segmentMutex);
+bool
+CacheBucket::writeCompressedTileRecord(U64 offset,
+                                       const CompressedTileHeader& header,
+                                       const std::vector<char>& data)
+{
+    QMutexLocker k(&compressedTilesFileMutex);
+    if ( !compressedTilesOutput.is_open() ) {
+        // Create the file if needed without truncating it: another process may be using it
+        {
+            FStreamsSupport::ofstream createFile;
+            FStreamsSupport::open(&createFile, compressedTilesFilePath, std::ios_base::out | std::ios_base::app | std::ios_base::binary);
+        }
+        compressedTilesOutput.clear();
+        compressedTilesOutput.rdbuf()->pubsetbuf(0, 0);
+        FStreamsSupport::open(&compressedTilesOutput, compressedTilesFilePath, std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+        if ( !compressedTilesOutput.is_open() ) {
+            return false;
+        }
+    }
+    compressedTilesOutput.clear();
+    compressedTilesOutput.seekp(offset);
+    compressedTilesOutput.write( reinterpret_cast<const char*>(&header), sizeof(header) );
+    compressedTilesOutput.write( &data[0], data.size() );
+    compressedTilesOutput.flush();
+    if (!compressedTilesOutput) {
+        // Re-open the file next time
+        compressedTilesOutput.close();
+        return false;
+    }
+    return true;
+} // writeCompressedTileRecord
 
-            _imp->bucket->ensureToCFileMappingValid(*writeLock, 0);
+bool
+CacheBucket::readCompressedTileRecord(const CompressedTileLocation& location,
+                                      CompressedTileHeader* header,
+                                      std::vector<char>* data)
+{
+    QMutexLocker k(&compressedTilesFileMutex);
+    if ( !compressedTilesInput.is_open() ) {
+        compressedTilesInput.clear();
+        compressedTilesInput.rdbuf()->pubsetbuf(0, 0);
+        FStreamsSupport::open(&compressedTilesInput, compressedTilesFilePath, std::ios_base::in | std::ios_base::binary);
+        if ( !compressedTilesInput.is_open() ) {
+            return false;
         }
+    }
+    compressedTilesInput.clear();
+    compressedTilesInput.seekg(location.offset);
+    compressedTilesInput.read( reinterpret_cast<char*>(header), sizeof(*header) );
+    if ( !compressedTilesInput || (header->dataSize != location.dataSize) ) {
+        return false;
+    }
+    data->resize(location.dataSize);
+    compressedTilesInput.read( &(*data)[0], data->size() );
+    return (bool)compressedTilesInput;
+} // readCompressedTileRecord
 
-        // Look-up the cache
-        MemorySegmentEntryHeader* cacheEntry = _imp->bucket->tryCacheLookupImpl(_imp->hashStr);
+bool
+CacheBucket::writeCompressedTile(U64 hash,
+                                 const std::vector<char>& tileData,
+                                 int elementSize,
+                                 std::size_t maxFileSize,
+                                 std::size_t* writtenSize)
+{
+    if ( compressedTilesFilePath.empty() || tileData.empty() ) {
+        return false;
+    }
 
-        // Flag set to true if readFromSharedMemoryEntry failed
-        bool deserializeFailed = false;
+    // Compress without any lock
+    std::vector<char> compressedData;
+    bool isCompressed = CacheTileCodec::compress(&tileData[0], tileData.size(), elementSize, &compressedData);
+
+    // If it does not compress, keep it anyway: reading it back is still faster than computing it
+    const std::vector<char>& data = isCompressed ? compressedData : tileData;
+    std::size_t recordSize = sizeof(CompressedTileHeader) + data.size();
+    if (recordSize > maxFileSize) {
+        return false;
+    }
+
+    CachePtr c = cache.lock();
+    CompressedTileLocation location;
+    location.dataSize = data.size();
+    U64 generation = 0;
+    try {
+        // Reserve space in the file
+        boost::scoped_ptr<WriteLock> writeLock;
+        createLock<WriteLock>(c->_imp.get(), writeLock, &c->_imp->ipc->bucketsData[bucketIndex].tocData.segmentMutex);
+        ensureToCFileMappingValid(*writeLock, 0);
+
+        // The file is never compacted: start over when it is full, once the tiles being written are done
+        if (ipc->compressedTilesFileSize + recordSize > maxFileSize) {
+            if (ipc->nPendingCompressedWrites > 0) {
+                return false;
+            }
+            ipc->compressedTiles.clear();
+            ipc->compressedTilesFileSize = 0;
+            ++ipc->compressedTilesGeneration;
+        }
+        location.offset = ipc->compressedTilesFileSize;
+        ipc->compressedTilesFileSize += recordSize;
+        ++ipc->nPendingCompressedWrites;
+        generation = ipc->compressedTilesGeneration;
+    } catch (const std::exception& e) {
+        qDebug() << "Failed to reserve compressed tile of cache bucket" << bucketIndex << ":" << e.what();
+        return false;
+    }
+
+    // Concurrency resumes!
+
+    CompressedTileHeader header;
+    header.hash = hash;
+    header.dataSize = (U32)data.size();
+    header.elementSize = isCompressed ? (U32)elementSize : 0;
+    bool written = writeCompressedTileRecord(location.offset, header, data);
+
+    try {
+        // Record the location of the tile
+        boost::scoped_ptr<WriteLock> writeLock;
+        createLock<WriteLock>(c->_imp.get(), writeLock, &c->_imp->ipc->bucketsData[bucketIndex].tocData.segmentMutex);
+        ensureToCFileMappingValid(*writeLock, 0);
+        assert(ipc->nPendingCompressedWrites > 0);
+        --ipc->nPendingCompressedWrites;
+        if ( !written || (generation != ipc->compressedTilesGeneration) ) {
+            return false;
+        }
+
+        // Ensure the ToC can hold a new node of the compressedTiles map. This may remap the ToC.
+        const std::size_t locationNodeSize = getTreeNodeAllocationSize<CompressedTileLocationPair>();
+        if (tocFileManager->get_free_memory() < locationNodeSize) {
+            ensureToCFileMappingValid(*writeLock, locationNodeSize);
+        }
+        ipc->compressedTiles[hash] = location;
+    } catch (const std::exception& e) {
+        qDebug() << "Failed to write compressed tile of cache bucket" << bucketIndex << ":" << e.what();
+        return false;
+    }
+    *writtenSize = data.size();
+    return true;
+} // writeCompressedTile
+
+bool
+CacheBucket::readCompressedTile(U64 hash,
+                                char* tileData)
+{
+    if ( compressedTilesFilePath.empty() ) {
+        return false;
+    }
+
+    CachePtr c = cache.lock();
+    CompressedTileLocation location;
+    U64 generation = 0;
+    try {
+        {
+            // Most look-ups miss the compressed tier too: check with a read lock first
+            boost::scoped_ptr<ReadLock> readLock;
+            boost::scoped_ptr<WriteLock> writeLock;
+            createLock<ReadLock>(c->_imp.get(), readLock, &c->_imp->ipc->bucketsData[bucketIndex].tocData.segmentMutex);
+            if ( !isToCFileMappingValid() ) {
+                readLock.reset();
+                createLock<WriteLock>(c->_imp.get(), writeLock, &c->_imp->ipc->bucketsData[bucketIndex].tocData.segmentMutex);
+                ensureToCFileMappingValid(*writeLock, 0);
+            }
+            if ( ipc->compressedTiles.find(hash) == ipc->compressedTiles.end() ) {
+                return false;
+            }
+        }
+
+        // Take the write lock to remove the tile from the tier: it goes back to the cache and is compressed again
+        // if evicted again.
+        boost::scoped_ptr<WriteLock> writeLock;
+        createLock<WriteLock>(c->_imp.get(), writeLock, &c->_imp->ipc->bucketsData[bucketIndex].tocData.segmentMutex);
+        if ( !isToCFileMappingValid() ) {
+            ensureToCFileMappingValid(*writeLock, 0);
+        }
+
+        map_CompressedTileLocation_ExternalSegment::iterator found = ipc->compressedTiles.find(hash);
+        if ( found == ipc->compressedTiles.end() ) {
+            return false;
+        }
+        location = found->second;
+        ipc->compressedTiles.erase(found);
+        generation = ipc->compressedTilesGeneration;
+    } catch (const std::exception& e) {
+        qDebug() << "Failed to read compressed tile of cache bucket" << bucketIndex << ":" << e.what();
+        return false;
+    }
+
+    // Concurrency resumes!
+
+    if ( (location.dataSize == 0) || (location.dataSize > tileSizeBytes) ) {
+        return false;
+    }
+    std::vector<char> data;
+    CompressedTileHeader header;
+    if ( !readCompressedTileRecord(location, &header, &data) || (header.hash != hash) ) {
+        return false;
+    }
+
+    try {
+        // If the file started over whilst reading, the record may have been overwritten by another tile
+        boost::scoped_ptr<ReadLock> readLock;
+        boost::scoped_ptr<WriteLock> writeLock;
+        createLock<ReadLock>(c->_imp.get(), readLock, &c->_imp->ipc->bucketsData[bucketIndex].tocData.segmentMutex);
+        if ( !isToCFileMappingValid() ) {
+            readLock.reset();
+            createLock<WriteLock>(c->_imp.get(), writeLock, &c->_imp->ipc->bucketsData[bucketIndex].tocData.segmentMutex);
+            ensureToCFileMappingValid(*writeLock, 0);
+        }
+        if (generation != ipc->compressedTilesGeneration) {
+            return false;
+        }
+    } catch (const std::exception& e) {
+        qDebug() << "Failed to read compressed tile of cache bucket" << bucketIndex << ":" << e.what();
+        return false;
+    }
+
+    if (header.elementSize != 0) {
+        return CacheTileCodec::decompress(&data[0], data.size(), (int)header.elementSize, tileData, tileSizeBytes);
+    }
+    if (data.size() != tileSizeBytes) {
+        return false;
+    }
+    memcpy(tileData, &data[0], tileSizeBytes);
+    return true;
+} // readCompressedTile
+
+
+void
+CacheEntryLocker::lookupAndSetStatus(bool takeEntryLock)
+{
+
+    // Get the bucket corresponding to the hash. This will dispatch threads in (hopefully) different
+    // buckets
+    if (!_imp->bucket) {
+        U64 hash = _imp->processLocalEntry->getHashKey();
+        _imp->bucket = &_imp->cache->_imp->getBucket( Cache::getBucketCacheBucketIndex(hash) );
+    }
+
+    {
+        // Take the read lock: many threads/processes can try read at the same time
+        boost::scoped_ptr<ReadLock> readLock;
+        createLock<ReadLock>(_imp->cache->_imp.get(), readLock, &_imp->cache->_imp->ipc->bucketsData[_imp->bucket->bucketIndex].tocData.segmentMutex);
+
+        boost::scoped_ptr<WriteLock> writeLock;
+        // Every time we take the lock, we must ensure the memory mapping is ok
+        if (!_imp->bucket->isToCFileMappingValid()) {
+            // Remove the read lock, and take a write lock.
+            // This could allow other threads to run in-between, but we don't care since nothing happen.
+            readLock.reset();
+
+            createLock<WriteLock>(_imp->cache->_imp.get(), writeLock, &_imp->cache->_imp->ipc->bucketsData[_imp->bucket->bucketIndex].tocData.segmentMutex);
+
+            _imp->bucket->ensureToCFileMappingValid(*writeLock, 0);
+        }
+
+        // Look-up the cache
+        MemorySegmentEntryHeader* cacheEntry = _imp->bucket->tryCacheLookupImpl(_imp->hashStr);
+
+        // Flag set to true if readFromSharedMemoryEntry failed
+        bool deserializeFailed = false;
 
         if (cacheEntry) {
 
@@ -1272,7 +2074,7 @@ CacheEntryLocker::lookupAndSetStatus(bool takeEntryLock)
                 qDebug() << _imp->hashStr.c_str() << ": Taking entry lock because of a call to waitForPendingEntry()";
 #endif
                 assert(!_imp->cacheEntryLock);
-                createLock<bip::scoped_lock<bip::interprocess_mutex> >(_imp->cache->_imp.get(), _imp->cacheEntryLock, &cacheEntry->lock);
+                createLock<bip::scoped_lock<bip::interprocess_mutex> >(_imp->cache->_imp.get(), _imp->cacheEntryLock, &cacheEntry->lock, _imp->bucket->bucketIndex, false /*recordContention*/);
             }
 
             // Deserialize the entry and update the status
@@ -1342,7 +2144,7 @@ CacheEntryLocker::lookupAndSetStatus(bool takeEntryLock)
 #ifdef CACHE_TRACE_ENTRY_LOCK
                 qDebug() << _imp->hashStr.c_str() << ": Taking entry lock after a call to waitForPendingEntry()";
 #endif
-                createLock<bip::scoped_lock<bip::interprocess_mutex> >(_imp->cache->_imp.get(), _imp->cacheEntryLock, &cacheEntry->lock);
+                createLock<bip::scoped_lock<bip::interprocess_mutex> >(_imp->cache->_imp.get(), _imp->cacheEntryLock, &cacheEntry->lock, _imp->bucket->bucketIndex, false /*recordContention*/);
             }
 
             deserializeFailed = !_imp->bucket->readFromSharedMemoryEntryImpl(cacheEntry, _imp->processLocalEntry, _imp->hashStr, &_imp->status);
@@ -1396,37 +2198,43 @@ CacheEntryLocker::lookupAndSetStatus(bool takeEntryLock)
 
             assert(!cacheEntry);
 
+            _imp->createPendingEntryImpl();
+            
+        } // writeLock
+    } // upgradableLock
+    // Concurrency resumes here!
+
+    // Other threads wait on the entry lock whilst the tile is read back from the compressed tier
+    _imp->readFromCompressedTier();
 
+} // lookupAndSetStatus
 
-            // Create the MemorySegmentEntry if it does not exist
-            void_allocator allocator(_imp->bucket->tocFileManager->get_segment_manager());
+void
+CacheEntryLockerPrivate::createPendingEntryImpl()
+{
+    // Create the MemorySegmentEntry
+    void_allocator allocator(bucket->tocFileManager->get_segment_manager());
 #ifdef CACHE_TRACE_ENTRY_ACCESS
-            qDebug() << _imp->hashStr.c_str() << ": construct entry";
+    qDebug() << hashStr.c_str() << ": construct entry";
 #endif
-            cacheEntry = _imp->bucket->tocFileManager->construct<MemorySegmentEntryHeader>(_imp->hashStr.c_str())(allocator);
-            cacheEntry->pluginID.append(_imp->processLocalEntry->getKey()->getHolderPluginID().c_str());
+    MemorySegmentEntryHeader* cacheEntry = bucket->tocFileManager->construct<MemorySegmentEntryHeader>(hashStr.c_str())(allocator);
+    cacheEntry->pluginID.append(processLocalEntry->getKey()->getHolderPluginID().c_str());
 
-            // Lock the statusMutex: this will lock-out other threads interested in this entry.
-            // This mutex is unlocked in deallocateCacheEntryImpl() or in insertInCache()
-            // We must get the lock since we are the first thread to create it and we own the write lock on the segmentMutex
-            assert(!_imp->cacheEntryLock);
+    // Lock the statusMutex: this will lock-out other threads interested in this entry.
+    // This mutex is unlocked in deallocateCacheEntryImpl() or in insertInCache()
+    // We must get the lock since we are the first thread to create it and we own the write lock on the segmentMutex
+    assert(!cacheEntryLock);
 #ifdef CACHE_TRACE_ENTRY_LOCK
-            qDebug() << _imp->hashStr.c_str() << ": Taking entry lock because the entry did not exist yet";
+    qDebug() << hashStr.c_str() << ": Taking entry lock because the entry did not exist yet";
 #endif
-            createLock<bip::scoped_lock<bip::interprocess_mutex> >(_imp->cache->_imp.get(), _imp->cacheEntryLock, &cacheEntry->lock);
+    createLock<bip::scoped_lock<bip::interprocess_mutex> >(cache->_imp.get(), cacheEntryLock, &cacheEntry->lock, bucket->bucketIndex, false /*recordContention*/);
 
-            assert(cacheEntry->status == MemorySegmentEntryHeader::eEntryStatusNull);
+    assert(cacheEntry->status == MemorySegmentEntryHeader::eEntryStatusNull);
 
-            // Set the status of the entry to pending because we (this thread) are going to compute it.
-            // Other fields of the entry will be set once it is done computed in insertInCache()
-            cacheEntry->status = MemorySegmentEntryHeader::eEntryStatusPending;
-
-            
-        } // writeLock
-    } // upgradableLock
-    // Concurrency resumes here!
-
-} // lookupAndSetStatus
+    // Set the status of the entry to pending because we (this locker) are going to compute it.
+    // Other fields of the entry will be set once it is done computed in insertInCache()
+    cacheEntry->status = MemorySegmentEntryHeader::eEntryStatusPending;
+} // createPendingEntryImpl
 
 CacheEntryBasePtr
 CacheEntryLocker::getProcessLocalEntry() const
@@ -1440,28 +2248,98 @@ CacheEntryLocker::getStatus() const
     return _imp->status;
 }
 
-void
-CacheEntryLocker::insertInCache()
+/**
+ * @brief Inserts in the bucket the entries computed by the given lockers. They must all be in the
+ * eCacheEntryStatusMustCompute status and belong to this bucket.
+ * The bucket locks are taken once for all entries and the ToC and tile files are grown at once
+ * so that they can hold all entries.
+ * The status of each locker is set to eCacheEntryStatusCached on success.
+ **/
+static void
+insertEntriesInBucket(CachePrivate* cacheImp,
+                      CacheBucket* bucket,
+                      const std::vector<CacheEntryLockerPrivate*>& lockers)
 {
-    // The entry should only be computed and inserted in the cache if the status
-    // of the object was eCacheEntryStatusMustCompute
-    assert(_imp->status == eCacheEntryStatusMustCompute);
+    if (lockers.empty()) {
+        return;
+    }
 
-    {
-        // Take write lock on the bucket
-        boost::scoped_ptr<WriteLock> writeLock;
-        createLock<WriteLock>(_imp->cache->_imp.get(), writeLock, &_imp->cache->_imp->ipc->bucketsData[_imp->bucket->bucketIndex].tocData.segmentMutex);
+    TimeLapse insertTimer;
+
+    // Compute the memory needed by all entries in the ToC and the number of tiles needed
+    std::vector<std::size_t> entriesSize( lockers.size() );
+    std::size_t tocSize = 0;
+    std::size_t nTiles = 0;
+    for (std::size_t i = 0; i < lockers.size(); ++i) {
+        assert(lockers[i]->status == CacheEntryLocker::eCacheEntryStatusMustCompute);
+        assert(lockers[i]->bucket == bucket);
+        entriesSize[i] = lockers[i]->processLocalEntry->getMetadataSize();
+        tocSize += entriesSize[i];
+
+        // The LRU list node and the node of the evictionQueue set
+        tocSize += getSegmentAllocationSize( sizeof(LRUListNode) ) + getTreeNodeAllocationSize<CacheEvictionKey>();
+        if ( lockers[i]->processLocalEntry->isStorageTiled() ) {
+            ++nTiles;
+        }
+    }
 
-        // Ensure the memory mapping is ok. We grow the file so it contains at least the size needed by the entry
-        // plus some metadatas required management algorithm store its own memory housekeeping data.
-        const std::size_t entrySize = _imp->processLocalEntry->getMetadataSize();
-        if (!_imp->bucket->isToCFileMappingValid()) {
-            _imp->bucket->ensureToCFileMappingValid(*writeLock, entrySize);
+    // Take write lock on the bucket
+    boost::scoped_ptr<WriteLock> writeLock;
+    createLock<WriteLock>(cacheImp, writeLock, &cacheImp->ipc->bucketsData[bucket->bucketIndex].tocData.segmentMutex);
+
+    // Ensure the memory mapping is ok. We grow the file so it contains at least the size needed by the entries
+    // plus some metadatas required management algorithm store its own memory housekeeping data.
+    if ( !bucket->isToCFileMappingValid() || (bucket->tocFileManager->get_free_memory() < tocSize) ) {
+        bucket->ensureToCFileMappingValid(*writeLock, tocSize);
+    }
+
+    // If the tile file has to grow, the free tiles bitmap, which lives in the ToC, grows with it.
+    // Its words are re-allocated in one block, ensure the ToC can hold it.
+    if ( (nTiles > 0) && (bucket->ipc->freeTiles.getFreeTilesCount() < nTiles) ) {
+        std::size_t maxTilesToAdd = nTiles + NATRON_CACHE_FILE_GROW_N_BYTES / bucket->tileSizeBytes;
+        tocSize += bucket->ipc->freeTiles.getMemorySizeAfterGrowth(maxTilesToAdd);
+        if (bucket->tocFileManager->get_free_memory() < tocSize) {
+            bucket->ensureToCFileMappingValid(*writeLock, tocSize);
         }
-        
+    }
+
+    // If some entries require tile aligned data storage, ensure there are enough free tiles for all of them
+    boost::scoped_ptr<ReadLock> tileReadLock;
+    boost::scoped_ptr<WriteLock> tileWriteLock;
+    if (nTiles > 0) {
+        // First try to check if the tile aligned mapping is valid with a readlock
+        bool tileMappingValid;
+        {
+            createLock<ReadLock>(cacheImp, tileReadLock, &cacheImp->ipc->bucketsData[bucket->bucketIndex].tileData.segmentMutex);
+
+            tileMappingValid = bucket->isTileFileMappingValid();
+            if (tileMappingValid) {
+                // Check that there are enough free tiles
+                tileMappingValid = bucket->ipc->freeTiles.getFreeTilesCount() >= nTiles;
+            }
+        }
+
+        // Not enough free tiles or mapping invalid, remap and grow if necessary.
+        if (!tileMappingValid) {
+            // If the tile mapping is invalid, take a write lock on the tile mapping and ensure it is valid
+            tileReadLock.reset();
+            createLock<WriteLock>(cacheImp, tileWriteLock, &cacheImp->ipc->bucketsData[bucket->bucketIndex].tileData.segmentMutex);
+
+            bucket->ensureTileMappingValid(*tileWriteLock, nTiles * bucket->tileSizeBytes);
+        }
+        assert(bucket->ipc->freeTiles.getFreeTilesCount() >= nTiles);
+    }
+
+    // Lock the LRU list mutex once for all entries
+    boost::scoped_ptr<bip::scoped_lock<bip::interprocess_mutex> > lruWriteLock;
+    createLock<bip::scoped_lock<bip::interprocess_mutex> >(cacheImp, lruWriteLock, &bucket->ipc->lruListMutex, bucket->bucketIndex);
+
+    for (std::size_t i = 0; i < lockers.size(); ++i) {
+
+        CacheEntryLockerPrivate* locker = lockers[i];
 
         // Fetch the entry. It must be here!
-        MemorySegmentEntryHeader* cacheEntry = _imp->bucket->tryCacheLookupImpl(_imp->hashStr);
+        MemorySegmentEntryHeader* cacheEntry = bucket->tryCacheLookupImpl(locker->hashStr);
         assert(cacheEntry);
         if (!cacheEntry) {
             throw std::logic_error("CacheEntryLocker::insertInCache");
@@ -1480,109 +2358,104 @@ CacheEntryLocker::insertInCache()
         try {
 
             // Allocate memory for the entry metadatas
-            cacheEntry->size = entrySize;
-
+            cacheEntry->size = entriesSize[i];
 
             // Serialize the meta-datas in the memory segment
             // If the entry also requires tile aligned data storage, allocate a tile now
-            {
-                boost::scoped_ptr<ReadLock> tileReadLock;
-                boost::scoped_ptr<WriteLock> tileWriteLock;
-                char* tileDataPtr = 0;
-                if (_imp->processLocalEntry->isStorageTiled()) {
-                    // First try to check if the tile aligned mapping is valid with a readlock
-                    bool tileMappingValid;
-
-                    {
-                        createLock<ReadLock>(_imp->cache->_imp.get(), tileReadLock, &_imp->cache->_imp->ipc->bucketsData[_imp->bucket->bucketIndex].tileData.segmentMutex);
-
-                        tileMappingValid = _imp->bucket->isTileFileMappingValid();
-                        if (tileMappingValid) {
-                            // Check that there's at least one free tile
-                            tileMappingValid = _imp->bucket->ipc->freeTiles.size() > 0;
-                        }
-                    }
-
-                    // No free tiles or mapping invalid, remap and grow if necessary.
-                    if (!tileMappingValid) {
-                        // If the tile mapping is invalid, take a write lock on the tile mapping and ensure it is valid
-                        tileReadLock.reset();
-                        createLock<WriteLock>(_imp->cache->_imp.get(), tileWriteLock, &_imp->cache->_imp->ipc->bucketsData[_imp->bucket->bucketIndex].tileData.segmentMutex);
-
+            char* tileDataPtr = 0;
+            if ( locker->processLocalEntry->isStorageTiled() ) {
+                std::size_t freeTileIndex;
+                if ( !bucket->ipc->freeTiles.allocateTile(&freeTileIndex) ) {
+                    assert(false);
+                    throw std::bad_alloc();
+                }
+                tileDataPtr = bucket->tileAlignedFile->data() + freeTileIndex * bucket->tileSizeBytes;
 
-                        _imp->bucket->ensureTileMappingValid(*tileWriteLock, NATRON_TILE_SIZE_BYTES);
-                    }
-                    assert(_imp->bucket->ipc->freeTiles.size() > 0);
-                    int freeTileIndex;
-                    {
-                        set_size_t_ExternalSegment::iterator freeTileIt = _imp->bucket->ipc->freeTiles.begin();
-                        freeTileIndex = *freeTileIt;
-                        _imp->bucket->ipc->freeTiles.erase(freeTileIt);
-                    }
-                    tileDataPtr = _imp->bucket->tileAlignedFile->data() + freeTileIndex * NATRON_TILE_SIZE_BYTES;
+                // Set the tile index on the entry so we can free it afterwards.
+                cacheEntry->tileCacheIndex = (int)freeTileIndex;
+                cacheEntry->tileElementSize = locker->processLocalEntry->getTileElementSize();
+            }
 
-                    // Set the tile index on the entry so we can free it afterwards.
-                    cacheEntry->tileCacheIndex = freeTileIndex;
-                } // tileWriteLock
+            locker->processLocalEntry->toMemorySegment(bucket->tocFileManager.get(), locker->hashStr + "Data", &cacheEntry->entryDataPointerList, tileDataPtr);
 
+            // Record the time it took to compute the entry
+            cacheEntry->computeCost = locker->computeTimer.getTimeElapsedReset();
+            if (locker->importedComputeCost >= 0) {
+                cacheEntry->computeCost = locker->importedComputeCost;
+            }
+            std::size_t entrySize = cacheEntry->size;
+            if (cacheEntry->tileCacheIndex != -1) {
+                entrySize += bucket->tileSizeBytes;
+            }
 
-                _imp->processLocalEntry->toMemorySegment(_imp->bucket->tocFileManager.get(), _imp->hashStr + "Data", &cacheEntry->entryDataPointerList, tileDataPtr);
+            // Insert the hash in the LRU linked list
+            cacheEntry->lruIterator = static_cast<LRUListNode*>(bucket->tocFileManager->allocate(sizeof(LRUListNode)));
+            cacheEntry->lruIterator->prev = 0;
+            cacheEntry->lruIterator->next = 0;
+            cacheEntry->lruIterator->hash = locker->processLocalEntry->getHashKey();
+            cacheEntry->lruIterator->evictionPriority = getCacheEntryEvictionPriority(bucket->ipc->evictionClock, cacheEntry->computeCost, entrySize);
+            bucket->ipc->evictionQueue.insert( CacheEvictionKey(cacheEntry->lruIterator->evictionPriority, cacheEntry->lruIterator->hash) );
+
+            if (!bucket->ipc->lruListBack) {
+                assert(!bucket->ipc->lruListFront);
+                // The list is empty, initialize to this node
+                bucket->ipc->lruListFront = cacheEntry->lruIterator;
+                bucket->ipc->lruListBack = cacheEntry->lruIterator;
+                assert(!bucket->ipc->lruListFront->prev && !bucket->ipc->lruListFront->next);
+                assert(!bucket->ipc->lruListBack->prev && !bucket->ipc->lruListBack->next);
+            } else {
+                // Append to the tail of the list
+                assert(bucket->ipc->lruListFront && bucket->ipc->lruListBack);
 
+                insertLinkedListNode(cacheEntry->lruIterator, bucket->ipc->lruListBack, bip::offset_ptr<LRUListNode>(0));
+                // Update back node
+                bucket->ipc->lruListBack = cacheEntry->lruIterator;
 
             }
-
-
-            // Insert the hash in the LRU linked list
-            // Lock the LRU list mutex
-            {
-                boost::scoped_ptr<bip::scoped_lock<bip::interprocess_mutex> > lruWriteLock;
-                createLock<bip::scoped_lock<bip::interprocess_mutex> >(_imp->cache->_imp.get(), lruWriteLock, &_imp->bucket->ipc->lruListMutex);
-
-
-                cacheEntry->lruIterator = static_cast<LRUListNode*>(_imp->bucket->tocFileManager->allocate(sizeof(LRUListNode)));
-                cacheEntry->lruIterator->prev = 0;
-                cacheEntry->lruIterator->next = 0;
-                cacheEntry->lruIterator->hash = _imp->processLocalEntry->getHashKey();
-
-                if (!_imp->bucket->ipc->lruListBack) {
-                    assert(!_imp->bucket->ipc->lruListFront);
-                    // The list is empty, initialize to this node
-                    _imp->bucket->ipc->lruListFront = cacheEntry->lruIterator;
-                    _imp->bucket->ipc->lruListBack = cacheEntry->lruIterator;
-                    assert(!_imp->bucket->ipc->lruListFront->prev && !_imp->bucket->ipc->lruListFront->next);
-                    assert(!_imp->bucket->ipc->lruListBack->prev && !_imp->bucket->ipc->lruListBack->next);
-                } else {
-                    // Append to the tail of the list
-                    assert(_imp->bucket->ipc->lruListFront && _imp->bucket->ipc->lruListBack);
-
-                    insertLinkedListNode(cacheEntry->lruIterator, _imp->bucket->ipc->lruListBack, bip::offset_ptr<LRUListNode>(0));
-                    // Update back node
-                    _imp->bucket->ipc->lruListBack = cacheEntry->lruIterator;
-                    
-                }
-            } // lruWriteLock
             cacheEntry->status = MemorySegmentEntryHeader::eEntryStatusReady;
 
-            _imp->status = eCacheEntryStatusCached;
+            locker->status = CacheEntryLocker::eCacheEntryStatusCached;
 
             // Notify other threads we are done with this entry by releasing the lock.
             // This will wake up threads waiting in lookupAndSetStatus
-            assert(_imp->cacheEntryLock);
+            assert(locker->cacheEntryLock);
 #ifdef CACHE_TRACE_ENTRY_LOCK
-            qDebug() << _imp->hashStr.c_str() << ": Releasing entry lock after a call to insertInCache";
+            qDebug() << locker->hashStr.c_str() << ": Releasing entry lock after a call to insertInCache";
 #endif
-            _imp->cacheEntryLock.reset();
+            locker->cacheEntryLock.reset();
 
         } catch (...) {
 
             // Set the status to eCacheEntryStatusMustCompute so that the destructor deallocates the entry.
-            _imp->status = eCacheEntryStatusMustCompute;
+            locker->status = CacheEntryLocker::eCacheEntryStatusMustCompute;
+        }
+    } // for each entry
+
+    // The locks are shared by all entries, split the time evenly
+    double insertTimePerEntry = insertTimer.getTimeElapsedReset() / lockers.size();
+    for (std::size_t i = 0; i < lockers.size(); ++i) {
+        if (lockers[i]->status == CacheEntryLocker::eCacheEntryStatusCached) {
+            bucket->stats.addInsertion(lockers[i]->getPluginStatsIndex(), insertTimePerEntry);
         }
+    }
 
+} // insertEntriesInBucket
 
-    } // writeLock
+void
+CacheEntryLocker::insertInCache()
+{
+    // The entry should only be computed and inserted in the cache if the status
+    // of the object was eCacheEntryStatusMustCompute
+    assert(_imp->status == eCacheEntryStatusMustCompute);
+
+    std::vector<CacheEntryLockerPrivate*> lockers(1, _imp.get());
+    insertEntriesInBucket(_imp->cache->_imp.get(), _imp->bucket, lockers);
 
     // Concurrency resumes!
+
+    if ( _imp->status == eCacheEntryStatusCached && _imp->processLocalEntry->isProcessLocalCacheable() ) {
+        _imp->cache->_imp->processLocalCache.insert(_imp->processLocalEntry);
+    }
     
 } // insertInCache
 
@@ -1593,8 +2466,8 @@ CacheEntryLocker::waitForPendingEntry()
     assert(_imp->status == eCacheEntryStatusComputationPending);
     assert(_imp->processLocalEntry);
 
-    // If this thread is a threadpool thread, it may wait for a while that results gets available.
-    // Release the thread to the thread pool so that it may use this thread for other runnables
+    // If this thread is a threadpool thread (or a worker of MultiThread::launchThreads), it may wait for a while
+    // that results gets available. Release the thread to the thread pool so that it may use this CPU for other runnables
     // and reserve it back when done waiting.
     bool hasReleasedThread = false;
     if (isRunningInThreadPoolThread()) {
@@ -1602,6 +2475,8 @@ CacheEntryLocker::waitForPendingEntry()
         hasReleasedThread = true;
     }
 
+    TimeLapse waitTimer;
+
     do {
 
         // Look up the cache, but first take the lock on the MemorySegmentEntry
@@ -1613,10 +2488,20 @@ CacheEntryLocker::waitForPendingEntry()
 
     // Concurrency resumes!
 
+    _imp->bucket->stats.addPendingWait( _imp->getPluginStatsIndex(), waitTimer.getTimeElapsedReset() );
+
+    if (_imp->status == eCacheEntryStatusMustCompute) {
+        // Do not account the time spent waiting in the compute cost
+        _imp->computeTimer.reset();
+    }
+
     if (hasReleasedThread) {
         QThreadPool::globalInstance()->reserveThread();
     }
-    
+
+    if ( _imp->status == eCacheEntryStatusCached && _imp->processLocalEntry->isProcessLocalCacheable() ) {
+        _imp->cache->_imp->processLocalCache.insert(_imp->processLocalEntry);
+    }
     
     return _imp->status;
 } // waitForPendingEntry
@@ -1672,7 +2557,7 @@ CachePrivate::getSharedMemoryName() const
 {
 
     std::stringstream ss;
-    ss << NATRON_APPLICATION_NAME << NATRON_CACHE_DIRECTORY_NAME  << "SHM";
+    ss << NATRON_APPLICATION_NAME << getCacheDirectoryName()  << "SHM";
     return ss.str();
 
 }
@@ -1689,21 +2574,222 @@ CachePrivate::getSharedMemorySize() const
 }
 
 CachePtr
-Cache::create()
+Cache::create(int tileSizePo2, CacheBackendEnum backend)
 {
     CachePtr ret(new Cache);
 
+    ret->_imp->backend = backend;
+    ret->_imp->initializeTileSize(tileSizePo2);
     ret->_imp->initializeCacheDirPath();
-    ret->_imp->ensureCacheDirectoryExists();
 
+    if (backend == eCacheBackendAnonymousMemory) {
+        // Nothing is shared with other processes: the IPC data is in process memory and no lock can be
+        // left taken by a crashed process.
+        ret->_imp->processLocalIPC.reset(new CachePrivate::IPCData);
+        ret->_imp->ipc = ret->_imp->processLocalIPC.get();
+    } else {
+        ret->_imp->ensureCacheDirectoryExists();
+        ret->_imp->createSharedMemory();
+    }
+
+    for (int i = 0; i < NATRON_CACHE_BUCKETS_COUNT; ++i) {
+
+        // Hold a weak pointer to the cache on the bucket
+        ret->_imp->buckets[i].cache = ret;
+        ret->_imp->buckets[i].bucketIndex = i;
+        ret->_imp->buckets[i].tileSizeBytes = ret->_imp->tileSizeBytes;
+    }
+
+    // Mapping and checking the files of all buckets takes a while with a large cache: open them in parallel
+    // in the background so that the first render can start right away.
+    // A bucket accessed before is opened by the thread accessing it, see CachePrivate::getBucket.
+    QList<int> bucketIndices;
+    for (int i = 0; i < NATRON_CACHE_BUCKETS_COUNT; ++i) {
+        bucketIndices.push_back(i);
+    }
+    QtConcurrent::mapped( bucketIndices, boost::bind(&CacheBucket::openInBackground, CacheWPtr(ret), _1) );
+
+    return ret;
+} // create
+
+CacheBackendEnum
+Cache::getBackend() const
+{
+    return _imp->backend;
+}
+
+bool
+CacheBucket::openInBackground(const CacheWPtr& cache,
+                              int bucketIndex)
+{
+    // The cache may have been destroyed before the task started
+    CachePtr c = cache.lock();
+    if (!c) {
+        return false;
+    }
+    try {
+        c->_imp->getBucket(bucketIndex);
+    } catch (const std::exception& e) {
+        // The thread accessing the bucket will try again and report the error
+        qDebug() << "Failed to open cache bucket" << bucketIndex << ":" << e.what();
+        return false;
+    }
+    return true;
+}
+
+CacheBucket&
+CachePrivate::getBucket(int bucketIndex)
+{
+    CacheBucket& bucket = buckets[bucketIndex];
+    if ( !bucket.isOpened() ) {
+        QMutexLocker k(&bucket.openedMutex);
+        if ( !bucket.isOpened() ) {
+            openBucket(bucketIndex);
+            bucket.opened.fetchAndStoreRelease(1);
+        }
+    }
+    return bucket;
+}
+
+void
+CachePrivate::openBucket(int bucketIndex)
+{
+    // The tile file needs the ToC to be valid: take both locks, in the same order as the other functions
+    boost::scoped_ptr<WriteLock> tocWriteLock, tileWriteLock;
+    createLock<WriteLock>(this, tocWriteLock, &ipc->bucketsData[bucketIndex].tocData.segmentMutex, bucketIndex);
+    createLock<WriteLock>(this, tileWriteLock, &ipc->bucketsData[bucketIndex].tileData.segmentMutex, bucketIndex);
+
+    bool isValid;
+    try {
+        openBucketFiles(bucketIndex, false /*wipe*/, *tocWriteLock, *tileWriteLock);
+        isValid = buckets[bucketIndex].checkIntegrity();
+    } catch (const std::exception& e) {
+        qDebug() << "Failed to open cache bucket" << bucketIndex << ":" << e.what();
+        isValid = false;
+    }
+
+    if (!isValid) {
+        // Only this bucket is lost
+        qDebug() << "Cache bucket" << bucketIndex << "is corrupted, clearing it";
+        openBucketFiles(bucketIndex, true /*wipe*/, *tocWriteLock, *tileWriteLock);
+    }
+} // openBucket
+
+/**
+ * @brief Opens a file of a bucket, see CachePrivate::openBucketFiles
+ **/
+static void
+openBucketFile(MemoryFilePtr& file,
+               CacheBackendEnum backend,
+               const std::string& filePath,
+               bool useHugePages,
+               bool wipe)
+{
+    if (!file) {
+        file.reset(new MemoryFile);
+    } else if (wipe) {
+        // Other processes keep the removed file mapped until they re-open it in ensureMappingValidInternal
+        file->remove();
+    }
+    if (backend == eCacheBackendAnonymousMemory) {
+        file->openAnonymous(useHugePages);
+    } else {
+        file->open(filePath, wipe ? MemoryFile::eFileOpenModeOpenTruncateOrCreate : MemoryFile::eFileOpenModeOpenOrCreate);
+    }
+}
 
+void
+CachePrivate::openBucketFiles(int bucketIndex,
+                              bool wipe,
+                              WriteLock& tocWriteLock,
+                              WriteLock& tileWriteLock)
+{
+    CacheBucket& bucket = buckets[bucketIndex];
+
+    // Get the bucket directory path. It ends with a separator.
+    // The files are not created in shared memory but are memory mapped instead to be persistent when the OS shutdown.
+    std::string bucketDirPath;
+    if (backend == eCacheBackendMappedFiles) {
+        bucketDirPath = getBucketAbsoluteDirPath(bucketIndex).toStdString();
+    }
+
+    // The ToC controls the table of content of the bucket.
+    openBucketFile(bucket.tocFile, backend, bucketDirPath + "Index", false /*useHugePages*/, wipe);
+
+    // Ensure the mapping is valid. This will grow the file the first time.
+    bucket.ensureToCFileMappingValid(tocWriteLock, 0);
+
+    // The tile file grows by NATRON_CACHE_FILE_GROW_N_BYTES, a multiple of the usual huge page size
+    openBucketFile(bucket.tileAlignedFile, backend, bucketDirPath + "TileCache", true /*useHugePages*/, wipe);
+
+    bucket.ensureTileMappingValid(tileWriteLock, 0);
+
+    // The compressed tiles file is created on the first eviction. When wiping, the new ToC has an empty
+    // compressedTiles map: the file is overwritten from the beginning by the next evictions.
+    if (backend == eCacheBackendMappedFiles) {
+        bucket.compressedTilesFilePath = bucketDirPath + "CompressedTiles";
+    }
+} // openBucketFiles
+
+bool
+CacheBucket::checkIntegrity()
+{
+    // Private - the tocData.segmentMutex and tileData.segmentMutex are assumed to be taken for write lock
+    if ( !ipc || (tileAlignedFile->size() % tileSizeBytes != 0) ) {
+        return false;
+    }
+
+    // The bitmap may cover less tiles than the file if the ToC was re-created, never more
+    const FreeTilesBitmap_ExternalSegment& freeTiles = ipc->freeTiles;
+    if ( (freeTiles.getTilesCount() > tileAlignedFile->size() / tileSizeBytes) || (freeTiles.getFreeTilesCount() > freeTiles.getTilesCount()) ) {
+        return false;
+    }
+
+    // The compressed tiles must lie in the used portion of their file
+    for (map_CompressedTileLocation_ExternalSegment::const_iterator it = ipc->compressedTiles.begin(); it != ipc->compressedTiles.end(); ++it) {
+        if (it->second.offset + sizeof(CompressedTileHeader) + it->second.dataSize > ipc->compressedTilesFileSize) {
+            return false;
+        }
+    }
+
+    // Walk the LRU list: each node must lie in the ToC mapping, be linked both ways and be referenced by its entry.
+    // The number of nodes is bounded to detect cycles.
+    const char* tocBegin = tocFile->data();
+    const char* tocEnd = tocBegin + tocFile->size();
+    const std::size_t maxNodes = tocFile->size() / sizeof(LRUListNode);
+    std::size_t nNodes = 0;
+    LRUListNode* prev = 0;
+    for (LRUListNode* node = ipc->lruListFront.get(); node; node = node->next.get()) {
+        const char* nodeBytes = reinterpret_cast<const char*>(node);
+        if ( (nodeBytes < tocBegin) || (nodeBytes + sizeof(LRUListNode) > tocEnd) || (node->prev.get() != prev) || (++nNodes > maxNodes) ) {
+            return false;
+        }
+        std::string hashStr = CacheEntryKeyBase::hashToString(node->hash);
+        MemorySegmentEntryHeader* cacheEntry = tocFileManager->find<MemorySegmentEntryHeader>(hashStr.c_str()).first;
+        if ( !cacheEntry || (cacheEntry->lruIterator.get() != node) ) {
+            return false;
+        }
+        if (cacheEntry->tileCacheIndex != -1) {
+            if ( (cacheEntry->tileCacheIndex < 0) || ( (std::size_t)cacheEntry->tileCacheIndex >= freeTiles.getTilesCount() ) ||
+                 freeTiles.isTileFree(cacheEntry->tileCacheIndex) ) {
+                return false;
+            }
+        }
+        prev = node;
+    }
+    return prev == ipc->lruListBack.get();
+} // checkIntegrity
+
+void
+CachePrivate::createSharedMemory()
+{
     // Create the file lock and semaphores
     {
 
         std::string cacheDir;
         {
             std::stringstream ss;
-            ss << ret->_imp->directoryContainingCachePath << "/" << NATRON_CACHE_DIRECTORY_NAME << "/";
+            ss << directoryContainingCachePath << "/" << getCacheDirectoryName() << "/";
             cacheDir = ss.str();
         }
         std::string fileLockFile = cacheDir + "Lock";
@@ -1719,7 +2805,7 @@ Cache::create()
             }
 
             try {
-                ret->_imp->globalMemorySegmentFileLock.reset(new bip::file_lock(fileLockFile.c_str()));
+                globalMemorySegmentFileLock.reset(new bip::file_lock(fileLockFile.c_str()));
             } catch (...) {
                 assert(false);
                 throw std::runtime_error("Failed to initialize shared memory file lock, exiting.");
@@ -1728,16 +2814,16 @@ Cache::create()
         std::string semBaseName;
         {
             std::stringstream ss;
-            ss << NATRON_APPLICATION_NAME << NATRON_CACHE_DIRECTORY_NAME;
+            ss << NATRON_APPLICATION_NAME << getCacheDirectoryName();
             semBaseName = ss.str();
         }
         try {
-            ret->_imp->nSHMValidSem.reset(new bip::named_semaphore(bip::open_or_create,
-                                                                   std::string(semBaseName + "nSHMValidSem").c_str(),
-                                                                   0));
-            ret->_imp->nSHMInvalidSem.reset(new bip::named_semaphore(bip::open_or_create,
-                                                                     std::string(semBaseName + "nSHMInvalidSem").c_str(),
-                                                                     0));
+            nSHMValidSem.reset(new bip::named_semaphore(bip::open_or_create,
+                                                        std::string(semBaseName + "nSHMValidSem").c_str(),
+                                                        0));
+            nSHMInvalidSem.reset(new bip::named_semaphore(bip::open_or_create,
+                                                          std::string(semBaseName + "nSHMInvalidSem").c_str(),
+                                                          0));
         } catch (...) {
             assert(false);
             throw std::runtime_error("Failed to initialize named semaphores, exiting.");
@@ -1748,19 +2834,19 @@ Cache::create()
     //      - If it succeeds, that means no other process is active: We remove the globalMemorySegment shared memory segment
     //        and create a new one, to ensure no lock was left in a bad state. Then we release the file lock
     //      - If it fails, another process is still actively using the globalMemorySegment shared memory: it must still be valid
-    bool gotFileLock = ret->_imp->globalMemorySegmentFileLock->try_lock();
+    bool gotFileLock = globalMemorySegmentFileLock->try_lock();
 
     // Create the main memory segment containing the CachePrivate::IPCData
     {
 
-        std::size_t desiredSize = ret->_imp->getSharedMemorySize();
-        std::string sharedMemoryName = ret->_imp->getSharedMemoryName();
+        std::size_t desiredSize = getSharedMemorySize();
+        std::string sharedMemoryName = getSharedMemoryName();
         try {
             if (gotFileLock) {
                 bip::shared_memory_object::remove(sharedMemoryName.c_str());
             }
-            ret->_imp->globalMemorySegment.reset(new bip::managed_shared_memory(bip::open_or_create, sharedMemoryName.c_str(), desiredSize));
-            ret->_imp->ipc = ret->_imp->globalMemorySegment->find_or_construct<CachePrivate::IPCData>("CacheData")();
+            globalMemorySegment.reset(new bip::managed_shared_memory(bip::open_or_create, sharedMemoryName.c_str(), desiredSize));
+            ipc = globalMemorySegment->find_or_construct<CachePrivate::IPCData>("CacheData")();
         } catch (...) {
             assert(false);
             bip::shared_memory_object::remove(sharedMemoryName.c_str());
@@ -1770,64 +2856,12 @@ Cache::create()
     }
 
     if (gotFileLock) {
-        ret->_imp->globalMemorySegmentFileLock->unlock();
+        globalMemorySegmentFileLock->unlock();
     }
 
     // Indicate that we use the shared memory by taking the file lock in read mode.
-    ret->_imp->globalMemorySegmentFileLock->try_lock_sharable();
-    
-    // Open each bucket individual memory segment.
-    // They are not created in shared memory but in a memory mapped file instead
-    // to be persistent when the OS shutdown.
-    // Each segment controls the table of content of the bucket.
-
-    for (int i = 0; i < NATRON_CACHE_BUCKETS_COUNT; ++i) {
-
-        // Hold a weak pointer to the cache on the bucket
-        ret->_imp->buckets[i].cache = ret;
-        ret->_imp->buckets[i].bucketIndex = i;
-
-        // Get the bucket directory path. It ends with a separator.
-        QString bucketDirPath = ret->_imp->getBucketAbsoluteDirPath(i);
-
-        // Open the cache ToC shared memory segment
-        {
-            std::string tocFilePath = bucketDirPath.toStdString() + "Index";
-            ret->_imp->buckets[i].tocFile.reset(new MemoryFile);
-
-            // Take the ToC mapping mutex to ensure that the ToC file is valid
-            boost::scoped_ptr<WriteLock> writeLock;
-            createLock<WriteLock>(ret->_imp.get(), writeLock, &ret->_imp->ipc->bucketsData[i].tocData.segmentMutex);
-
-
-            ret->_imp->buckets[i].tocFile->open(tocFilePath, MemoryFile::eFileOpenModeOpenOrCreate);
-
-            // Ensure the mapping is valid. This will grow the file the first time.
-            ret->_imp->buckets[i].ensureToCFileMappingValid(*writeLock, 0);
-        }
-
-        // Open the memory-mapped file used for tiled entries data storage.
-        {
-            std::string tileCacheFilePath = bucketDirPath.toStdString() + "TileCache";
-
-            ret->_imp->buckets[i].tileAlignedFile.reset(new MemoryFile);
-
-            // Take the ToC mapping mutex and register this process amongst the valid mapping
-            boost::scoped_ptr<WriteLock> writeLock;
-            createLock<WriteLock>(ret->_imp.get(), writeLock, &ret->_imp->ipc->bucketsData[i].tileData.segmentMutex);
-
-            ret->_imp->buckets[i].tileAlignedFile->open(tileCacheFilePath, MemoryFile::eFileOpenModeOpenOrCreate);
-
-            // Ensure the mapping is valid. This will grow the file the first time.
-            ret->_imp->buckets[i].ensureTileMappingValid(*writeLock, 0);
-
-        }
-
-    } // for each bucket
-
-
-    return ret;
-} // create
+    globalMemorySegmentFileLock->try_lock_sharable();
+} // createSharedMemory
 
 
 void
@@ -1837,6 +2871,12 @@ CachePrivate::ensureSharedMemoryIntegrity()
     // If a process crashes whilst the segmentMutex is taken, the file lock is ensured to be released but the
     // segmentMutex will remain taken, deadlocking any other process.
 
+    // Without shared memory, a lock can only be held by a thread of this process which cannot crash
+    // without taking the process down: keep waiting.
+    if (backend == eCacheBackendAnonymousMemory) {
+        return;
+    }
+
     // Multiple threads in this process can time-out, however we just need to remap the shared memory once.
     QMutexLocker processLocalLocker(&nThreadsTimedOutFailedMutex);
     ++nThreadsTimedOutFailed;
@@ -2000,6 +3040,123 @@ Cache::getMaximumCacheSize(StorageModeEnum storage) const
     }
 }
 
+void
+Cache::setCompressedTierMaximumSize(std::size_t size)
+{
+    QMutexLocker k(&_imp->maximumSizesMutex);
+    _imp->maximumCompressedTierSize = size;
+}
+
+std::size_t
+Cache::getCompressedTierMaximumSize() const
+{
+    if (_imp->backend == eCacheBackendAnonymousMemory) {
+        // There is no file to write to
+        return 0;
+    }
+    QMutexLocker k(&_imp->maximumSizesMutex);
+    return _imp->maximumCompressedTierSize;
+}
+
+void
+Cache::setMemoryBudget(std::size_t size)
+{
+    std::size_t curBudget;
+    {
+        QMutexLocker k(&_imp->maximumSizesMutex);
+        curBudget = _imp->memoryBudget;
+        _imp->memoryBudget = size;
+    }
+
+    // The idle buffers of the pool count towards the RAM used by the process
+    std::size_t poolMaxBytes = NATRON_CACHE_RAM_BUFFER_POOL_MAX_BYTES;
+    if (size != 0) {
+        poolMaxBytes = std::min(poolMaxBytes, size / NATRON_CACHE_RAM_BUFFER_POOL_BUDGET_DIVISOR);
+    }
+    _imp->ramBufferPool->setMaximumBytes(poolMaxBytes);
+
+    // Clear exceeding entries if we are shrinking the cache.
+    if ( (size != 0) && ( (curBudget == 0) || (size < curBudget) ) ) {
+        evictLRUEntries(0);
+    }
+}
+
+std::size_t
+Cache::getMemoryBudget() const
+{
+    QMutexLocker k(&_imp->maximumSizesMutex);
+    return _imp->memoryBudget;
+}
+
+std::size_t
+CachePrivate::getMaximumEntriesSize() const
+{
+    if (backend == eCacheBackendMappedFiles) {
+        return maximumDiskSize;
+    }
+
+    // The entries of the anonymous backend live in RAM: they are bounded by the maximum RAM cache size
+    // (see setMaximumCacheSize(eStorageModeRAM, ...)), 0 meaning all the RAM of the system.
+    std::size_t maxRAMSize = maximumGLTextureSize;
+    if (maxRAMSize == 0) {
+        maxRAMSize = (std::size_t)getSystemTotalRAM_conditionnally();
+    }
+    return maxRAMSize;
+}
+
+std::size_t
+Cache::getEffectiveMaximumCacheSize() const
+{
+    std::size_t maxSize, budget;
+    {
+        QMutexLocker k(&_imp->maximumSizesMutex);
+        maxSize = _imp->getMaximumEntriesSize();
+        budget = _imp->memoryBudget;
+    }
+    if ( (budget == 0) || (_imp->backend == eCacheBackendMappedFiles) ) {
+        return maxSize;
+    }
+
+    // The entries share the budget with the images in RAM, which cannot be evicted
+    std::size_t imagesSize = _imp->getRAMImagesSize();
+    std::size_t entriesBudget = budget > imagesSize ? budget - imagesSize : 0;
+    if (entriesBudget == 0) {
+        // No room left for the entries: evict them all. 0 would mean no limit.
+        entriesBudget = 1;
+    }
+    if (maxSize == 0) {
+        return entriesBudget;
+    }
+    return std::min(entriesBudget, maxSize);
+}
+
+std::size_t
+Cache::getRAMResidentSize() const
+{
+    std::size_t ret = _imp->getRAMImagesSize();
+    if (_imp->backend == eCacheBackendAnonymousMemory) {
+        ret += getCurrentSize(eStorageModeDisk);
+    }
+    RAMBufferPoolStats poolStats;
+    _imp->ramBufferPool->getStats(&poolStats);
+    ret += poolStats.bytesHeld;
+    return ret;
+}
+
+void
+Cache::setEvictionPolicy(CacheEvictionPolicyEnum policy)
+{
+    QMutexLocker k(&_imp->evictionPolicyMutex);
+    _imp->evictionPolicy = policy;
+}
+
+CacheEvictionPolicyEnum
+Cache::getEvictionPolicy() const
+{
+    QMutexLocker k(&_imp->evictionPolicyMutex);
+    return _imp->evictionPolicy;
+}
+
 std::size_t
 Cache::getCurrentSize(StorageModeEnum storage) const
 {
@@ -2060,6 +3217,16 @@ static void createIfNotExistBucketDirs(const QDir& d)
 
 }
 
+std::size_t
+CachePrivate::getRAMImagesSize()
+{
+    boost::scoped_ptr<bip::sharable_lock<bip::interprocess_sharable_mutex> > locker;
+    createLock<bip::sharable_lock<bip::interprocess_sharable_mutex> >(this, locker, &ipc->sizeLock);
+
+    // incrementCacheSize counts eStorageModeRAM in memorySize
+    return ipc->memorySize;
+}
+
 void
 CachePrivate::incrementCacheSize(long long size, StorageModeEnum storage)
 {
@@ -2106,6 +3273,28 @@ CachePrivate::initializeCacheDirPath()
     }
 } // initializeCacheDirPath
 
+void
+CachePrivate::initializeTileSize(int tileSizePo2In)
+{
+    tileSizePo2 = std::max( NATRON_8BIT_TILE_SIZE_PO2_MIN, std::min(tileSizePo2In, NATRON_8BIT_TILE_SIZE_PO2_MAX) );
+    std::size_t tileSizePx = (std::size_t)1 << tileSizePo2;
+    tileSizeBytes = tileSizePx * tileSizePx;
+    assert(NATRON_CACHE_FILE_GROW_N_BYTES % tileSizeBytes == 0);
+}
+
+std::string
+CachePrivate::getCacheDirectoryName() const
+{
+    // e.g: Cache_v6_4096, or Cache_v6crc64_4096 in CRC64 compatibility mode
+    std::stringstream ss;
+    ss << NATRON_CACHE_DIRECTORY_NAME << "_v" << NATRON_CACHE_SERIALIZATION_VERSION;
+    if ( Hash64::isCrc64CompatibilityModeEnabled() ) {
+        ss << NATRON_CACHE_CRC64_KEYS_VERSION_SUFFIX;
+    }
+    ss << "_" << tileSizeBytes;
+    return ss.str();
+}
+
 void
 CachePrivate::ensureCacheDirectoryExists()
 {
@@ -2118,7 +3307,7 @@ CachePrivate::ensureCacheDirectoryExists()
 
     QDir d(userDirectoryCache);
     if (d.exists()) {
-        QString cacheDirName = QString::fromUtf8(NATRON_CACHE_DIRECTORY_NAME);
+        QString cacheDirName = QString::fromUtf8( getCacheDirectoryName().c_str() );
         if (!d.exists(cacheDirName)) {
             d.mkdir(cacheDirName);
         }
@@ -2135,27 +3324,28 @@ Cache::getCacheDirectoryPath() const
     QString cacheFolderName;
     cacheFolderName = QString::fromUtf8(_imp->directoryContainingCachePath.c_str());
     StrUtils::ensureLastPathSeparator(cacheFolderName);
-    cacheFolderName.append( QString::fromUtf8(NATRON_CACHE_DIRECTORY_NAME) );
+    cacheFolderName.append( QString::fromUtf8( _imp->getCacheDirectoryName().c_str() ) );
     return cacheFolderName.toStdString();
 } // getCacheDirectoryPath
 
 
 void
-Cache::getTileSizePx(ImageBitDepthEnum bitdepth, int *tx, int *ty)
+Cache::getTileSizePx(ImageBitDepthEnum bitdepth, int *tx, int *ty) const
 {
+    const int tileSizePx = 1 << _imp->tileSizePo2;
     switch (bitdepth) {
         case eImageBitDepthByte:
-            *tx = NATRON_TILE_SIZE_X_8_BIT;
-            *ty = NATRON_TILE_SIZE_Y_8_BIT;
+            *tx = tileSizePx;
+            *ty = tileSizePx;
             break;
         case eImageBitDepthShort:
         case eImageBitDepthHalf:
-            *tx = NATRON_TILE_SIZE_X_16_BIT;
-            *ty = NATRON_TILE_SIZE_Y_16_BIT;
+            *tx = tileSizePx;
+            *ty = tileSizePx / 2;
             break;
         case eImageBitDepthFloat:
-            *tx = NATRON_TILE_SIZE_X_32_BIT;
-            *ty = NATRON_TILE_SIZE_Y_32_BIT;
+            *tx = tileSizePx / 2;
+            *ty = tileSizePx / 2;
             break;
         case eImageBitDepthNone:
             *tx = *ty = 0;
@@ -2163,13 +3353,19 @@ Cache::getTileSizePx(ImageBitDepthEnum bitdepth, int *tx, int *ty)
     }
 }
 
+std::size_t
+Cache::getTileSizeBytes() const
+{
+    return _imp->tileSizeBytes;
+}
+
 QString
 CachePrivate::getBucketAbsoluteDirPath(int bucketIndex) const
 {
     QString bucketDirPath;
     bucketDirPath = QString::fromUtf8(directoryContainingCachePath.c_str());
     StrUtils::ensureLastPathSeparator(bucketDirPath);
-    bucketDirPath += QString::fromUtf8(NATRON_CACHE_DIRECTORY_NAME);
+    bucketDirPath += QString::fromUtf8( getCacheDirectoryName().c_str() );
     StrUtils::ensureLastPathSeparator(bucketDirPath);
     bucketDirPath += QString::fromUtf8(getBucketDirName(bucketIndex).c_str());
     StrUtils::ensureLastPathSeparator(bucketDirPath);
@@ -2183,6 +3379,434 @@ Cache::get(const CacheEntryBasePtr& entry) const
     return CacheEntryLocker::create(thisShared, entry);
 } // get
 
+void
+Cache::getBatch(const std::vector<CacheEntryBasePtr>& entries, std::vector<CacheEntryLockerPtr>* lockers) const
+{
+    CachePtr thisShared = boost::const_pointer_cast<Cache>(shared_from_this());
+
+    lockers->resize( entries.size() );
+
+    // Indices of the entries to look-up in each bucket
+    std::map<int, std::vector<std::size_t> > entriesPerBucket;
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+        assert(entries[i]);
+        if (!entries[i]) {
+            throw std::invalid_argument("Cache::getBatch: no entry");
+        }
+        CacheEntryLockerPtr locker(new CacheEntryLocker(thisShared, entries[i]));
+        (*lockers)[i] = locker;
+
+        if ( entries[i]->isProcessLocalCacheable() && _imp->processLocalCache.get(entries[i]) ) {
+            locker->_imp->status = CacheEntryLocker::eCacheEntryStatusCached;
+            locker->_imp->recordLookup();
+            continue;
+        }
+
+        int bucketIndex = Cache::getBucketCacheBucketIndex( entries[i]->getHashKey() );
+        locker->_imp->bucket = &_imp->getBucket(bucketIndex);
+        entriesPerBucket[bucketIndex].push_back(i);
+    }
+
+    for (std::map<int, std::vector<std::size_t> >::const_iterator it = entriesPerBucket.begin(); it != entriesPerBucket.end(); ++it) {
+
+        CacheBucket& bucket = _imp->getBucket(it->first);
+
+        // Entries that were not found or could not be read
+        std::vector<std::size_t> entriesToLookup;
+        {
+            // Take the read lock once for all entries of the bucket
+            boost::scoped_ptr<ReadLock> readLock;
+            createLock<ReadLock>(_imp.get(), readLock, &_imp->ipc->bucketsData[it->first].tocData.segmentMutex);
+
+            boost::scoped_ptr<WriteLock> writeLock;
+            // Every time we take the lock, we must ensure the memory mapping is ok
+            if ( !bucket.isToCFileMappingValid() ) {
+                readLock.reset();
+                createLock<WriteLock>(_imp.get(), writeLock, &_imp->ipc->bucketsData[it->first].tocData.segmentMutex);
+                bucket.ensureToCFileMappingValid(*writeLock, 0);
+            }
+
+            for (std::size_t i = 0; i < it->second.size(); ++i) {
+                CacheEntryLockerPrivate* locker = (*lockers)[it->second[i]]->_imp.get();
+                MemorySegmentEntryHeader* cacheEntry = bucket.tryCacheLookupImpl(locker->hashStr);
+                if ( !cacheEntry || !bucket.readFromSharedMemoryEntryImpl(cacheEntry, locker->processLocalEntry, locker->hashStr, &locker->status) ||
+                     (locker->status == CacheEntryLocker::eCacheEntryStatusMustCompute) ) {
+                    locker->status = CacheEntryLocker::eCacheEntryStatusMustCompute;
+                    entriesToLookup.push_back(it->second[i]);
+                }
+            }
+        } // readLock
+
+        // Mark all the entries that are not cached pending under a single write lock
+        std::vector<std::size_t> entriesToCompute;
+        if ( !entriesToLookup.empty() ) {
+            boost::scoped_ptr<WriteLock> writeLock;
+            createLock<WriteLock>(_imp.get(), writeLock, &_imp->ipc->bucketsData[it->first].tocData.segmentMutex);
+
+            // Every time we take the lock, we must ensure the memory mapping is ok
+            if ( !bucket.isToCFileMappingValid() ) {
+                bucket.ensureToCFileMappingValid(*writeLock, 0);
+            }
+
+            for (std::size_t i = 0; i < entriesToLookup.size(); ++i) {
+                CacheEntryLockerPrivate* locker = (*lockers)[entriesToLookup[i]]->_imp.get();
+
+                // Look-up again: another thread may have inserted the entry or started computing it in-between the two locks
+                MemorySegmentEntryHeader* cacheEntry = bucket.tryCacheLookupImpl(locker->hashStr);
+                if (cacheEntry) {
+                    if ( bucket.readFromSharedMemoryEntryImpl(cacheEntry, locker->processLocalEntry, locker->hashStr, &locker->status) &&
+                         (locker->status != CacheEntryLocker::eCacheEntryStatusMustCompute) ) {
+                        continue;
+                    }
+                    // The entry could not be read, deallocate it
+                    bucket.deallocateCacheEntryImpl(cacheEntry, locker, locker->hashStr, false /*releaseLock*/);
+                }
+                locker->status = CacheEntryLocker::eCacheEntryStatusMustCompute;
+                locker->createPendingEntryImpl();
+                entriesToCompute.push_back(entriesToLookup[i]);
+            }
+        } // writeLock
+
+        // Other threads wait on the entry lock whilst the tiles are read back from the compressed tier
+        for (std::size_t i = 0; i < entriesToCompute.size(); ++i) {
+            (*lockers)[entriesToCompute[i]]->_imp->readFromCompressedTier();
+        }
+
+        for (std::size_t i = 0; i < it->second.size(); ++i) {
+            (*lockers)[it->second[i]]->_imp->recordLookup();
+        }
+    }
+
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+        if ( (*lockers)[i]->_imp->status == CacheEntryLocker::eCacheEntryStatusCached && entries[i]->isProcessLocalCacheable() ) {
+            _imp->processLocalCache.insert(entries[i]);
+        }
+    }
+} // getBatch
+
+void
+Cache::insertBatch(const std::vector<CacheEntryLockerPtr>& lockers)
+{
+    // Group the lockers by bucket
+    std::map<int, std::vector<CacheEntryLockerPrivate*> > lockersPerBucket;
+    for (std::size_t i = 0; i < lockers.size(); ++i) {
+        if ( !lockers[i] || (lockers[i]->_imp->status != CacheEntryLocker::eCacheEntryStatusMustCompute) ) {
+            continue;
+        }
+        assert(lockers[i]->_imp->bucket);
+        lockersPerBucket[lockers[i]->_imp->bucket->bucketIndex].push_back( lockers[i]->_imp.get() );
+    }
+
+    for (std::map<int, std::vector<CacheEntryLockerPrivate*> >::const_iterator it = lockersPerBucket.begin(); it != lockersPerBucket.end(); ++it) {
+        insertEntriesInBucket(_imp.get(), &_imp->getBucket(it->first), it->second);
+    }
+
+    // Concurrency resumes!
+
+    for (std::map<int, std::vector<CacheEntryLockerPrivate*> >::const_iterator it = lockersPerBucket.begin(); it != lockersPerBucket.end(); ++it) {
+        for (std::size_t i = 0; i < it->second.size(); ++i) {
+            CacheEntryLockerPrivate* locker = it->second[i];
+            if ( locker->status == CacheEntryLocker::eCacheEntryStatusCached && locker->processLocalEntry->isProcessLocalCacheable() ) {
+                _imp->processLocalCache.insert(locker->processLocalEntry);
+            }
+        }
+    }
+} // insertBatch
+
+/**
+ * @brief A tile copied from the cache by Cache::exportPack, to be written to the pack file
+ **/
+struct CachePackExportedTile
+{
+    CachePackTileRecord record;
+    std::string layerChannel, pluginID;
+    std::vector<char> tileData;
+};
+
+static bool
+isTimeInFrameRanges(double time,
+                    const std::vector<RangeD>& frameRanges)
+{
+    if ( frameRanges.empty() ) {
+        return true;
+    }
+    for (std::size_t i = 0; i < frameRanges.size(); ++i) {
+        if ( (time >= frameRanges[i].min) && (time <= frameRanges[i].max) ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::size_t
+Cache::exportPack(const std::string& filePath,
+                  const std::set<U64>& nodeFrameViewHashes,
+                  const std::vector<RangeD>& frameRanges) const
+{
+    FStreamsSupport::ofstream ofile;
+    FStreamsSupport::open(&ofile, filePath, std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+    if ( !ofile.is_open() ) {
+        throw std::runtime_error("Cannot open " + filePath + " for writing");
+    }
+
+    CachePackHeader header;
+    memcpy(header.magic, NATRON_CACHE_PACK_MAGIC, sizeof(header.magic));
+    header.version = NATRON_CACHE_PACK_VERSION;
+    header.byteOrderMark = 1;
+    header.tileSizeBytes = _imp->tileSizeBytes;
+    header.nTiles = 0;
+
+    // The number of tiles is written again once known
+    ofile.write( reinterpret_cast<const char*>(&header), sizeof(header) );
+
+    for (int bucket_i = 0; bucket_i < NATRON_CACHE_BUCKETS_COUNT; ++bucket_i) {
+        CacheBucket& bucket = _imp->getBucket(bucket_i);
+
+        // The tiles of the bucket are copied under the locks and written once they are released,
+        // so that the bucket is not blocked by the pack file I/O.
+        std::list<CachePackExportedTile> exportedTiles;
+        {
+            boost::scoped_ptr<ReadLock> readLock;
+            boost::scoped_ptr<WriteLock> writeLock;
+            createLock<ReadLock>(_imp.get(), readLock, &_imp->ipc->bucketsData[bucket_i].tocData.segmentMutex);
+
+            // First take a read lock and check if the mapping is valid. Otherwise take a write lock
+            if ( !bucket.isToCFileMappingValid() ) {
+                readLock.reset();
+                createLock<WriteLock>(_imp.get(), writeLock, &_imp->ipc->bucketsData[bucket_i].tocData.segmentMutex);
+
+                bucket.ensureToCFileMappingValid(*writeLock, 0);
+            }
+
+            boost::scoped_ptr<ReadLock> tileReadLock;
+            boost::scoped_ptr<WriteLock> tileWriteLock;
+            createLock<ReadLock>(_imp.get(), tileReadLock, &_imp->ipc->bucketsData[bucket_i].tileData.segmentMutex);
+            if ( !bucket.isTileFileMappingValid() ) {
+                tileReadLock.reset();
+                createLock<WriteLock>(_imp.get(), tileWriteLock, &_imp->ipc->bucketsData[bucket_i].tileData.segmentMutex);
+                bucket.ensureTileMappingValid(*tileWriteLock, 0);
+            }
+
+            // Readers relink the LRU list nodes under the same read lock: collect the hashes under the LRU list mutex
+            std::vector<U64> entriesHash;
+            {
+                boost::scoped_ptr<bip::scoped_lock<bip::interprocess_mutex> > lruLock;
+                createLock<bip::scoped_lock<bip::interprocess_mutex> >(_imp.get(), lruLock, &bucket.ipc->lruListMutex, bucket_i);
+                for (bip::offset_ptr<LRUListNode> it = bucket.ipc->lruListFront; it; it = it->next) {
+                    entriesHash.push_back(it->hash);
+                }
+            }
+
+            for (std::size_t entry_i = 0; entry_i < entriesHash.size(); ++entry_i) {
+                std::string hashStr = CacheEntryKeyBase::hashToString(entriesHash[entry_i]);
+                MemorySegmentEntryHeader* cacheEntry = bucket.tryCacheLookupImpl(hashStr);
+                if ( !cacheEntry || (cacheEntry->status != MemorySegmentEntryHeader::eEntryStatusReady) || (cacheEntry->tileCacheIndex == -1) ) {
+                    continue;
+                }
+
+                // Only image tiles are exported: this throws for any other kind of key
+                ImageTileKey key;
+                try {
+                    key.fromMemorySegment(bucket.tocFileManager.get(), hashStr + "Data");
+                } catch (...) {
+                    continue;
+                }
+                if ( !nodeFrameViewHashes.empty() && ( nodeFrameViewHashes.find( key.getNodeTimeInvariantHashKey() ) == nodeFrameViewHashes.end() ) ) {
+                    continue;
+                }
+                if ( !isTimeInFrameRanges(key.getTime(), frameRanges) ) {
+                    continue;
+                }
+
+                std::string layerChannel = key.getLayerChannel();
+                std::string pluginID(cacheEntry->pluginID.c_str());
+                RenderScale proxyScale = key.getProxyScale();
+
+                exportedTiles.push_back( CachePackExportedTile() );
+                CachePackExportedTile& exported = exportedTiles.back();
+                exported.layerChannel = layerChannel;
+                exported.pluginID = pluginID;
+
+                CachePackTileRecord& record = exported.record;
+                record.hash = entriesHash[entry_i];
+                record.nodeFrameViewHash = key.getNodeTimeInvariantHashKey();
+                record.time = key.getTime();
+                record.proxyScaleX = proxyScale.x;
+                record.proxyScaleY = proxyScale.y;
+                record.computeCost = cacheEntry->computeCost;
+                record.view = key.getView();
+                record.mipMapLevel = key.getMipMapLevel();
+                record.bitdepth = (int)key.getBitDepth();
+                record.tileX = key.getTileX();
+                record.tileY = key.getTileY();
+                record.draftMode = key.isDraftMode() ? 1 : 0;
+                record.layerChannelSize = (U32)layerChannel.size();
+                record.pluginIDSize = (U32)pluginID.size();
+
+                const char* tileData = bucket.tileAlignedFile->data() + cacheEntry->tileCacheIndex * _imp->tileSizeBytes;
+                exported.tileData.assign(tileData, tileData + _imp->tileSizeBytes);
+            }
+        } // locks
+
+        for (std::list<CachePackExportedTile>::const_iterator it = exportedTiles.begin(); it != exportedTiles.end(); ++it) {
+            ofile.write( reinterpret_cast<const char*>(&it->record), sizeof(it->record) );
+            ofile.write( it->layerChannel.c_str(), it->layerChannel.size() );
+            ofile.write( it->pluginID.c_str(), it->pluginID.size() );
+            ofile.write( &it->tileData[0], it->tileData.size() );
+            if (!ofile) {
+                throw std::runtime_error("Failed to write " + filePath);
+            }
+            ++header.nTiles;
+        }
+    } // for each bucket
+
+    ofile.seekp(0);
+    ofile.write( reinterpret_cast<const char*>(&header), sizeof(header) );
+    ofile.flush();
+    if (!ofile) {
+        throw std::runtime_error("Failed to write " + filePath);
+    }
+    return header.nTiles;
+} // exportPack
+
+/**
+ * @brief A tile read from a pack file by Cache::importPack. The tile data stays in the memory mapped pack
+ * until it is copied to the cache by toMemorySegment.
+ **/
+class CachePackTileEntry
+: public CacheEntryBase
+{
+public:
+
+    CachePackTileEntry(const CachePtr& cache,
+                       const char* tileData)
+    : CacheEntryBase(cache)
+    , _tileData(tileData)
+    {
+
+    }
+
+    virtual ~CachePackTileEntry()
+    {
+
+    }
+
+    virtual bool isStorageTiled() const OVERRIDE FINAL
+    {
+        return true;
+    }
+
+    virtual void toMemorySegment(ExternalSegmentType* segment, const std::string& objectNamesPrefix, ExternalSegmentTypeHandleList* objectPointers, void* tileDataPtr) const OVERRIDE FINAL
+    {
+        memcpy( tileDataPtr, _tileData, getCache()->getTileSizeBytes() );
+        CacheEntryBase::toMemorySegment(segment, objectNamesPrefix, objectPointers, tileDataPtr);
+    }
+
+private:
+
+    const char* _tileData;
+};
+
+std::size_t
+Cache::importPack(const std::string& filePath)
+{
+    MemoryFile packFile;
+    packFile.open(filePath, MemoryFile::eFileOpenModeOpenReadOnly);
+
+    const char* data = packFile.data();
+    const std::size_t size = packFile.size();
+
+    CachePackHeader header;
+    if ( !data || (size < sizeof(header)) ) {
+        throw std::runtime_error(filePath + " is not a cache pack");
+    }
+    memcpy( &header, data, sizeof(header) );
+    if ( (memcmp(header.magic, NATRON_CACHE_PACK_MAGIC, sizeof(header.magic)) != 0) || (header.byteOrderMark != 1) ) {
+        throw std::runtime_error(filePath + " is not a cache pack");
+    }
+    if (header.version != NATRON_CACHE_PACK_VERSION) {
+        throw std::runtime_error(filePath + " was written by an incompatible version of " NATRON_APPLICATION_NAME);
+    }
+    if (header.tileSizeBytes != _imp->tileSizeBytes) {
+        throw std::runtime_error(filePath + " was exported from a cache with a different tile size");
+    }
+
+    CachePtr thisShared = shared_from_this();
+    std::size_t nInserted = 0;
+    std::size_t offset = sizeof(header);
+    U64 tile_i = 0;
+    while (tile_i < header.nTiles) {
+
+        // Read a batch of tiles
+        std::vector<CacheEntryBasePtr> entries;
+        std::vector<double> computeCosts;
+        for (; tile_i < header.nTiles && entries.size() < NATRON_CACHE_PACK_IMPORT_BATCH_SIZE; ++tile_i) {
+            CachePackTileRecord record;
+            if (size - offset < sizeof(record)) {
+                throw std::runtime_error(filePath + " is truncated");
+            }
+            memcpy( &record, data + offset, sizeof(record) );
+            offset += sizeof(record);
+
+            const std::size_t recordDataSize = (std::size_t)record.layerChannelSize + record.pluginIDSize + _imp->tileSizeBytes;
+            if (size - offset < recordDataSize) {
+                throw std::runtime_error(filePath + " is truncated");
+            }
+            std::string layerChannel(data + offset, record.layerChannelSize);
+            offset += record.layerChannelSize;
+            std::string pluginID(data + offset, record.pluginIDSize);
+            offset += record.pluginIDSize;
+            const char* tileData = data + offset;
+            offset += _imp->tileSizeBytes;
+
+            RenderScale proxyScale;
+            proxyScale.x = record.proxyScaleX;
+            proxyScale.y = record.proxyScaleY;
+            ImageTileKeyPtr key( new ImageTileKey(record.nodeFrameViewHash,
+                                                  TimeValue(record.time),
+                                                  ViewIdx(record.view),
+                                                  layerChannel,
+                                                  proxyScale,
+                                                  record.mipMapLevel,
+                                                  record.draftMode != 0,
+                                                  (ImageBitDepthEnum)record.bitdepth,
+                                                  record.tileX,
+                                                  record.tileY) );
+            key->setHolderPluginID(pluginID);
+            if (key->getHash() != record.hash) {
+                continue;
+            }
+
+            CacheEntryBasePtr entry( new CachePackTileEntry(thisShared, tileData) );
+            entry->setKey(key);
+            entries.push_back(entry);
+            computeCosts.push_back(record.computeCost);
+        }
+
+        // Insert the tiles that are not cached yet
+        std::vector<CacheEntryLockerPtr> lockers;
+        getBatch(entries, &lockers);
+
+        std::vector<CacheEntryLockerPtr> toInsert;
+        for (std::size_t i = 0; i < lockers.size(); ++i) {
+            // Tiles already cached, or being computed by another thread, are left as is
+            if (lockers[i]->getStatus() == CacheEntryLocker::eCacheEntryStatusMustCompute) {
+                lockers[i]->_imp->importedComputeCost = computeCosts[i];
+                toInsert.push_back(lockers[i]);
+            }
+        }
+        insertBatch(toInsert);
+
+        for (std::size_t i = 0; i < toInsert.size(); ++i) {
+            if (toInsert[i]->getStatus() == CacheEntryLocker::eCacheEntryStatusCached) {
+                ++nInserted;
+            }
+        }
+    } // while there are tiles to read
+
+    return nInserted;
+} // importPack
+
 bool
 Cache::hasCacheEntryForHash(U64 hash) const
 {
@@ -2190,7 +3814,7 @@ Cache::hasCacheEntryForHash(U64 hash) const
     std::string hashStr = CacheEntryKeyBase::hashToString(hash);
 
     int bucketIndex = Cache::getBucketCacheBucketIndex(hash);
-    CacheBucket& bucket = _imp->buckets[bucketIndex];
+    CacheBucket& bucket = _imp->getBucket(bucketIndex);
 
     boost::scoped_ptr<ReadLock> readLock;
     boost::scoped_ptr<WriteLock> writeLock;
@@ -2238,18 +3862,32 @@ Cache::removeEntry(const CacheEntryBasePtr& entry)
         return;
     }
 
-
     U64 hash = entry->getHashKey();
+    _imp->removeEntryForHash(hash);
+
+    // The mipmaps of a tile are removed with it
+    if ( entry->isStorageTiled() ) {
+        _imp->removeTileDerivedEntries(hash);
+    }
+
+} // removeEntry
+
+std::size_t
+CachePrivate::removeEntryForHash(U64 hash)
+{
     int bucketIndex = Cache::getBucketCacheBucketIndex(hash);
     std::string hashStr = CacheEntryKeyBase::hashToString(hash);
 
-    CacheBucket& bucket = _imp->buckets[bucketIndex];
+    processLocalCache.remove(hash);
 
+    CacheBucket& bucket = getBucket(bucketIndex);
+
+    std::size_t freedSize = 0;
 
     // Take the bucket lock in write mode
     {
         boost::scoped_ptr<WriteLock> writeLock;
-        createLock<WriteLock>(_imp.get(), writeLock, &_imp->ipc->bucketsData[bucketIndex].tocData.segmentMutex);
+        createLock<WriteLock>(this, writeLock, &ipc->bucketsData[bucketIndex].tocData.segmentMutex);
 
         // Ensure the file mapping is OK
         bucket.ensureToCFileMappingValid(*writeLock, 0);
@@ -2258,50 +3896,108 @@ Cache::removeEntry(const CacheEntryBasePtr& entry)
         {
             MemorySegmentEntryHeader* cacheEntry = bucket.tryCacheLookupImpl(hashStr);
             if (cacheEntry) {
+                freedSize = cacheEntry->size;
+                if (cacheEntry->tileCacheIndex != -1) {
+                    freedSize += tileSizeBytes;
+                }
                 bucket.deallocateCacheEntryImpl(cacheEntry, 0, hashStr, false /*releaseLock*/);
             }
         }
+
+        // The entry must not come back from the compressed tier either
+        bucket.ipc->compressedTiles.erase(hash);
     }
+    return freedSize;
+} // removeEntryForHash
 
-} // removeEntry
+std::size_t
+CachePrivate::removeTileDerivedEntries(U64 tileHash)
+{
+    return removeEntryForHash( ImageTileMipMapsKey::getTileMipMapsHash(tileHash) );
+}
 
 
 void
 Cache::clear()
 {
-
+    _imp->processLocalCache.clear();
+    _imp->ramBufferPool->clear();
 
     for (int bucket_i = 0; bucket_i < NATRON_CACHE_BUCKETS_COUNT; ++bucket_i) {
-        CacheBucket& bucket = _imp->buckets[bucket_i];
 
-        // Close and re-create the memory mapped files
-        {
-            boost::scoped_ptr<WriteLock> writeLock;
-            createLock<WriteLock>(_imp.get(), writeLock, &_imp->ipc->bucketsData[bucket_i].tocData.segmentMutex);
+        // Make sure the bucket files are opened before re-creating them
+        _imp->getBucket(bucket_i);
 
-            std::string tocFilePath = bucket.tocFile->path();
-            bucket.tocFile->remove();
-            bucket.tocFile->open(tocFilePath, MemoryFile::eFileOpenModeOpenTruncateOrCreate);
-            bucket.ensureTileMappingValid(*writeLock, 0);
-        }
-        {
-            boost::scoped_ptr<WriteLock> writeLock;
-            createLock<WriteLock>(_imp.get(), writeLock, &_imp->ipc->bucketsData[bucket_i].tileData.segmentMutex);
+        boost::scoped_ptr<WriteLock> tocWriteLock, tileWriteLock;
+        createLock<WriteLock>(_imp.get(), tocWriteLock, &_imp->ipc->bucketsData[bucket_i].tocData.segmentMutex, bucket_i);
+        createLock<WriteLock>(_imp.get(), tileWriteLock, &_imp->ipc->bucketsData[bucket_i].tileData.segmentMutex, bucket_i);
 
-            std::string tileFilePath = bucket.tileAlignedFile->path();
-            bucket.tileAlignedFile->remove();
-            bucket.tileAlignedFile->open(tileFilePath, MemoryFile::eFileOpenModeOpenTruncateOrCreate);
-            bucket.ensureTileMappingValid(*writeLock, 0);
-        }
+        // Close and re-create the memory mapped files
+        _imp->openBucketFiles(bucket_i, true /*wipe*/, *tocWriteLock, *tileWriteLock);
 
     } // for each bucket
 
 } // clear()
 
+void
+Cache::getProcessLocalCacheStats(ProcessLocalCacheStats* stats) const
+{
+    _imp->processLocalCache.getStats(stats);
+}
+
+void
+Cache::setProcessLocalCacheMaximumEntries(std::size_t maxEntries)
+{
+    _imp->processLocalCache.setMaximumEntries(maxEntries);
+}
+
+const RAMBufferPoolPtr&
+Cache::getRAMBufferPool() const
+{
+    return _imp->ramBufferPool;
+}
+
+void
+Cache::getStats(CacheStatsReport* report) const
+{
+    *report = CacheStatsReport();
+    report->perBucket.resize(NATRON_CACHE_BUCKETS_COUNT);
+    for (int bucket_i = 0; bucket_i < NATRON_CACHE_BUCKETS_COUNT; ++bucket_i) {
+        _imp->buckets[bucket_i].stats.appendStats(&report->perBucket[bucket_i], 0);
+        report->total.merge(report->perBucket[bucket_i]);
+    }
+    // The per plug-in statistics of the buckets are recorded in the globalStats
+    _imp->globalStats.appendStats(&report->total, &report->perPlugin);
+
+    RAMBufferPoolStats poolStats;
+    _imp->ramBufferPool->getStats(&poolStats);
+    report->total.nBufferPoolReuses += poolStats.nReuses;
+    report->total.nBufferPoolAllocations += poolStats.nAllocations;
+    report->total.bufferPoolBytesReused += poolStats.bytesReused;
+}
+
+void
+Cache::reportSparseImageTiles(std::size_t nTiles,
+                              std::size_t nAllocatedTiles,
+                              std::size_t bytesSaved)
+{
+    _imp->globalStats.addSparseImage(nTiles, nAllocatedTiles, bytesSaved);
+}
+
+void
+Cache::resetStats()
+{
+    for (int bucket_i = 0; bucket_i < NATRON_CACHE_BUCKETS_COUNT; ++bucket_i) {
+        _imp->buckets[bucket_i].stats.reset();
+    }
+    _imp->globalStats.reset();
+    _imp->ramBufferPool->resetStats();
+}
+
 void
 Cache::evictLRUEntries(std::size_t nBytesToFree)
 {
-    std::size_t maxSize = getMaximumCacheSize(eStorageModeDisk);
+    std::size_t maxSize = getEffectiveMaximumCacheSize();
 
     // If max size == 0 then there's no limit.
     if (maxSize == 0) {
@@ -2318,15 +4014,28 @@ Cache::evictLRUEntries(std::size_t nBytesToFree)
 
     bool mustEvictEntries = curSize > maxSize;
 
+    CacheEvictionPolicyEnum policy = getEvictionPolicy();
+
+    std::size_t maxCompressedTierSize = getCompressedTierMaximumSize();
+
     while (mustEvictEntries) {
         
         bool foundBucketThatCanEvict = false;
 
         // Check each bucket
         for (int bucket_i = 0; bucket_i < NATRON_CACHE_BUCKETS_COUNT; ++bucket_i) {
-            CacheBucket& bucket = _imp->buckets[bucket_i];
+            CacheBucket& bucket = _imp->getBucket(bucket_i);
 
+            // The hash of the tile evicted from this bucket, if any: its mipmaps are evicted with it once the bucket is unlocked
+            U64 evictedTileHash = 0;
+
+            // A copy of the evicted tile to keep in the compressed tier, and its plug-in
+            std::vector<char> evictedTileData;
+            int evictedTileElementSize = 1;
+            int pluginIndex = 0;
             {
+                TimeLapse evictTimer;
+
                 // Lock for writing
                 boost::scoped_ptr<WriteLock> writeLock;
                 createLock<WriteLock>(_imp.get(), writeLock, &_imp->ipc->bucketsData[bucket_i].tocData.segmentMutex);
@@ -2338,11 +4047,20 @@ Cache::evictLRUEntries(std::size_t nBytesToFree)
                 {
                     // Lock the LRU list
                     boost::scoped_ptr<bip::scoped_lock<bip::interprocess_mutex> > lruWriteLock;
-                    createLock<bip::scoped_lock<bip::interprocess_mutex> >(_imp.get(), lruWriteLock, &bucket.ipc->lruListMutex);
-
-                    // The least recently used entry is the one at the front of the linked list
-                    if (bucket.ipc->lruListFront) {
-                        entryHash = bucket.ipc->lruListFront->hash;
+                    createLock<bip::scoped_lock<bip::interprocess_mutex> >(_imp.get(), lruWriteLock, &bucket.ipc->lruListMutex, bucket_i);
+
+                    if (policy == eCacheEvictionPolicyCostAware) {
+                        // The entry with the lowest priority is the cheapest to recompute per byte, aged by the clock
+                        if ( !bucket.ipc->evictionQueue.empty() ) {
+                            const CacheEvictionKey& candidate = *bucket.ipc->evictionQueue.begin();
+                            entryHash = candidate.hash;
+                            bucket.ipc->evictionClock = std::max(bucket.ipc->evictionClock, candidate.priority);
+                        }
+                    } else {
+                        // The least recently used entry is the one at the front of the linked list
+                        if (bucket.ipc->lruListFront) {
+                            entryHash = bucket.ipc->lruListFront->hash;
+                        }
                     }
                 }
                 if (!entryHash) {
@@ -2359,14 +4077,38 @@ Cache::evictLRUEntries(std::size_t nBytesToFree)
 
                         // Also decrease the size if this entry held a tile
                         if (cacheEntry->tileCacheIndex != -1) {
-                            curSize -= NATRON_TILE_SIZE_BYTES;
+                            curSize -= _imp->tileSizeBytes;
+                            evictedTileHash = entryHash;
+                        }
+                        pluginIndex = CacheStatsRecorder::getPluginIndex( cacheEntry->pluginID.c_str() );
+
+                        // Keep a compressed copy of the tile: decompressing it is usually faster than computing it again.
+                        // Only copy it here: it is compressed and written once the bucket is unlocked.
+                        if ( (maxCompressedTierSize > 0) && (cacheEntry->tileCacheIndex != -1) &&
+                             bucket.copyTile(cacheEntry->tileCacheIndex, &evictedTileData) ) {
+                            evictedTileElementSize = cacheEntry->tileElementSize;
                         }
+
                         bucket.deallocateCacheEntryImpl(cacheEntry, 0, hashStr, false /*releaseLock*/);
+                        bucket.stats.addEviction( pluginIndex, evictTimer.getTimeElapsedReset() );
                     }
                 }
 
             }
 
+            if ( !evictedTileData.empty() ) {
+                TimeLapse compressTimer;
+                std::size_t compressedSize = 0;
+                if ( bucket.writeCompressedTile(evictedTileHash, evictedTileData, evictedTileElementSize, maxCompressedTierSize / NATRON_CACHE_BUCKETS_COUNT, &compressedSize) ) {
+                    bucket.stats.addCompressedWrite( pluginIndex, _imp->tileSizeBytes, compressedSize, compressTimer.getTimeElapsedReset() );
+                }
+            }
+
+            if (evictedTileHash) {
+                std::size_t freedSize = _imp->removeTileDerivedEntries(evictedTileHash);
+                curSize -= std::min(curSize, freedSize);
+            }
+
             foundBucketThatCanEvict = true;
             
         } // for each bucket
@@ -2388,7 +4130,7 @@ Cache::getMemoryStats(std::map<std::string, CacheReportInfo>* infos) const
 {
 
     for (int bucket_i = 0; bucket_i < NATRON_CACHE_BUCKETS_COUNT; ++bucket_i) {
-        CacheBucket& bucket = _imp->buckets[bucket_i];
+        CacheBucket& bucket = _imp->getBucket(bucket_i);
 
         boost::scoped_ptr<ReadLock> readLock;
         boost::scoped_ptr<WriteLock> writeLock;
@@ -2416,7 +4158,7 @@ Cache::getMemoryStats(std::map<std::string, CacheReportInfo>* infos) const
                     ++entryData.nEntries;
                     entryData.nBytes += cacheEntry->size;
                     if (cacheEntry->tileCacheIndex != -1) {
-                        entryData.nBytes += NATRON_TILE_SIZE_BYTES;
+                        entryData.nBytes += _imp->tileSizeBytes;
                     }
                     
                 }
@@ -2431,9 +4173,18 @@ Cache::getMemoryStats(std::map<std::string, CacheReportInfo>* infos) const
 void
 Cache::flushCacheOnDisk(bool async)
 {
+    if (_imp->backend == eCacheBackendAnonymousMemory) {
+        // Nothing is on disk
+        return;
+    }
     for (int bucket_i = 0; bucket_i < NATRON_CACHE_BUCKETS_COUNT; ++bucket_i) {
         CacheBucket& bucket = _imp->buckets[bucket_i];
 
+        // Buckets that were never opened by this process have nothing to flush
+        if ( !bucket.isOpened() ) {
+            continue;
+        }
+
         {
             boost::scoped_ptr<ReadLock> readLock;
             boost::scoped_ptr<WriteLock> writeLock;
@@ -2464,7 +4215,7 @@ Cache::flushCacheOnDisk(bool async)
                  // This function will flush for us.
                 bucket.ensureTileMappingValid(*writeLock, 0);
             } else {
-                flushTileMapping(bucket.tileAlignedFile, bucket.ipc->freeTiles);
+                flushTileMapping(bucket.tileAlignedFile, bucket.ipc->freeTiles, bucket.tileSizeBytes);
             }
         }
 
@@ -33,6 +33,7 @@
 #include <functional>
 #include <list>
 #include <set>
+#include <string>
 #include <cstddef>
 #include <utility>
 #include <algorithm> // min, max
@@ -45,28 +46,23 @@
 #endif
 
 #include "Engine/CacheEntryBase.h"
+#include "Engine/CacheStats.h"
+#include "Engine/ProcessLocalCache.h"
 
 #include "Engine/EngineFwd.h"
 
 // Each 8 bit tile will have pow(2, tileSizePo2) pixels in each dimension.
 // 16 bit tiles will have one side halved
 // 32 bit tiles will have both dimension halved (so tile size for 32bit is actually pow(2, tileSizePo2-1)
+// A tile thus takes pow(2, tileSizePo2) * pow(2, tileSizePo2) bytes, whatever its bitdepth.
 //
-// default is tileSizePo2=6, thus a 8 bit tile will be 64x64 pixels
+// The tile size is chosen when the cache is created, see Cache::create.
+// default is tileSizePo2=6, thus a 8 bit tile will be 64x64 pixels (4 KiB)
 #define NATRON_8BIT_TILE_SIZE_PO2 6
 
-// tileByteSize = std::pow(2, NATRON_8BIT_TILE_SIZE_PO2);
-// tileByteSize *= tileByteSize;
-#define NATRON_TILE_SIZE_BYTES 4096
-
-#define NATRON_TILE_SIZE_X_8_BIT 64
-#define NATRON_TILE_SIZE_Y_8_BIT 64
-
-#define NATRON_TILE_SIZE_X_16_BIT 64
-#define NATRON_TILE_SIZE_Y_16_BIT 32
-
-#define NATRON_TILE_SIZE_X_32_BIT 32
-#define NATRON_TILE_SIZE_Y_32_BIT 32
+// Range of the tile size: from 64x64 (4 KiB) to 1024x1024 (1 MiB) 8 bit tiles
+#define NATRON_8BIT_TILE_SIZE_PO2_MIN 6
+#define NATRON_8BIT_TILE_SIZE_PO2_MAX 10
 
 // The name of the directory containing all buckets on disk
 #define NATRON_CACHE_DIRECTORY_NAME "Cache"
@@ -180,6 +176,7 @@ class Cache
     friend class ImageStorageBase;
 
     friend class CacheEntryLocker;
+    friend struct CacheEntryLockerPrivate;
     friend struct CacheBucket;
     
 private:
@@ -191,8 +188,25 @@ public:
     /**
      * @brief Create a new instance of a cache. There should be a single Cache across the application as it
      * better keeps track of allocated resources.
+     * @param tileSizePo2 The size of a 8 bit tile is pow(2, tileSizePo2) pixels in each dimension, clamped
+     * to [NATRON_8BIT_TILE_SIZE_PO2_MIN, NATRON_8BIT_TILE_SIZE_PO2_MAX].
+     * The tile size is part of the cache directory name: caches created with different tile sizes
+     * do not share their files. So is the CRC64 compatibility mode of Hash64, which must be set before
+     * calling this function: entries keyed with CRC64 hashes are only found by processes using that mode.
+     * @param backend Where the entries are stored. With eCacheBackendAnonymousMemory, no file, shared memory
+     * or interprocess semaphore is created: the cache is private to this process, which avoids all disk I/O
+     * for single-process renders (e.g: render farms). The cache size is then bounded by the maximum size of
+     * eStorageModeRAM (all the RAM of the system if 0) instead of the maximum size of eStorageModeDisk.
+     * This function returns before the bucket files are opened: they are opened and checked in parallel on the
+     * global thread pool, or by the first thread accessing them. A corrupted bucket is cleared on its own.
      **/
-    static CachePtr create();
+    static CachePtr create(int tileSizePo2 = NATRON_8BIT_TILE_SIZE_PO2,
+                           CacheBackendEnum backend = eCacheBackendMappedFiles);
+
+    /**
+     * @brief Returns the backend passed to create()
+     **/
+    CacheBackendEnum getBackend() const;
     
     virtual ~Cache();
 
@@ -204,7 +218,12 @@ public:
     /**
      * @brief Returns the tile size (of one dimension) in pixels for the given bitdepth/
      **/
-    static void getTileSizePx(ImageBitDepthEnum bitdepth, int *tx, int *ty);
+    void getTileSizePx(ImageBitDepthEnum bitdepth, int *tx, int *ty) const;
+
+    /**
+     * @brief Returns the size in bytes of a tile, which is the same for all bitdepths.
+     **/
+    std::size_t getTileSizeBytes() const;
 
     /**
      * @brief Set the maximum cache size available for the given storage.
@@ -217,6 +236,49 @@ public:
      **/
     std::size_t getMaximumCacheSize(StorageModeEnum storage) const;
 
+    /**
+     * @brief Set the maximum size on disk of the compressed tier, 0 (the default) disables it.
+     * When the tier is enabled, the tiles evicted by evictLRUEntries are compressed losslessly and appended to
+     * a file of their bucket. A look-up that misses a tile that is in the compressed tier decompresses it and
+     * inserts it back in the cache instead of returning eCacheEntryStatusMustCompute.
+     * Each bucket file may take up to size / 256 bytes: when full, the compressed tier of the bucket is emptied.
+     * Like the other maximum sizes, this is local to the process. The eCacheBackendAnonymousMemory backend
+     * has no compressed tier.
+     **/
+    void setCompressedTierMaximumSize(std::size_t size);
+    std::size_t getCompressedTierMaximumSize() const;
+
+    /**
+     * @brief Set a budget for the memory the cache keeps in RAM (see getRAMResidentSize()), 0 (the default) means
+     * no budget. It bounds the buffers recycled by the RAM buffer pool and, with eCacheBackendAnonymousMemory,
+     * the entries: they may take what the images in RAM leave of the budget. Shrinking the budget evicts the exceeding entries.
+     * The entries of eCacheBackendMappedFiles are only bounded by the maximum size of eStorageModeDisk.
+     * This is set by the CacheMemoryGovernor when the cache size adapts to the memory pressure of the system.
+     * Like the maximum sizes, this is local to the process.
+     **/
+    void setMemoryBudget(std::size_t size);
+    std::size_t getMemoryBudget() const;
+
+    /**
+     * @brief Returns the size evictLRUEntries keeps the entries under: the maximum size of eStorageModeDisk
+     * (eStorageModeRAM with eCacheBackendAnonymousMemory, bounded by the memory budget), 0 if there is no limit.
+     **/
+    std::size_t getEffectiveMaximumCacheSize() const;
+
+    /**
+     * @brief Returns the memory used in RAM that the memory budget applies to: the images
+     * of eStorageModeRAM, the buffers held by the RAM buffer pool and, with eCacheBackendAnonymousMemory, the entries.
+     **/
+    std::size_t getRAMResidentSize() const;
+
+    /**
+     * @brief Set how evictLRUEntries chooses the entries to evict. This only affects the evictions made by this process.
+     * The cost-aware policy uses the time it took to compute each entry, measured between the look-up that
+     * returned eCacheEntryStatusMustCompute and CacheEntryLocker::insertInCache().
+     **/
+    void setEvictionPolicy(CacheEvictionPolicyEnum policy);
+    CacheEvictionPolicyEnum getEvictionPolicy() const;
+
     /**
      * @breif Returns the actual size taken in memory for the given storagE.
      **/
@@ -239,6 +301,48 @@ public:
      **/
     CacheEntryLockerPtr get(const CacheEntryBasePtr& entry) const;
 
+    /**
+     * @brief Same as get() for many entries at once: lockers is resized to the number of entries and
+     * each locker corresponds to the entry at the same index.
+     * Entries are grouped by bucket so that each bucket is locked once to find the cached entries.
+     * Entries that are not cached yet go through the same look-up as get().
+     **/
+    void getBatch(const std::vector<CacheEntryBasePtr>& entries, std::vector<CacheEntryLockerPtr>* lockers) const;
+
+    /**
+     * @brief Same as calling CacheEntryLocker::insertInCache() on each locker with the
+     * eCacheEntryStatusMustCompute status, other lockers are ignored.
+     * Entries are grouped by bucket so that each bucket is locked once and its memory mapped files are
+     * grown at once for all its entries.
+     **/
+    void insertBatch(const std::vector<CacheEntryLockerPtr>& lockers);
+
+    /**
+     * @brief Writes the image tiles of the cache to a single pack file that other processes, possibly on other
+     * machines, can load in their own cache with importPack. This avoids creating one file per entry on a network
+     * filesystem. The pack holds the key, the plug-in ID and the compute cost of each tile: it does not depend on
+     * the cache directory or the bucket files it was exported from, only on the tile size.
+     * @param nodeFrameViewHashes If not empty, only the tiles of images whose node frame/view hash
+     * (see ImageTileKey::getNodeTimeInvariantHashKey) is in the set are exported.
+     * @param frameRanges If not empty, only the tiles of images at a time within one of the ranges
+     * (bounds included) are exported.
+     * Only image tiles are exported: the other entries are the results of actions, which are cheap to recompute.
+     * Returns the number of tiles exported. Throws a std::runtime_error if the file cannot be written.
+     **/
+    std::size_t exportPack(const std::string& filePath,
+                           const std::set<U64>& nodeFrameViewHashes,
+                           const std::vector<RangeD>& frameRanges) const;
+
+    /**
+     * @brief Inserts in the cache the tiles of a pack written by exportPack. The pack is memory mapped read-only
+     * and read sequentially, the tiles are inserted by batches with insertBatch.
+     * Tiles that are already cached or being computed are skipped, as are the tiles whose key does not hash to the
+     * hash recorded in the pack, e.g: if the pack was exported by a version of Natron with a different hash function.
+     * Returns the number of tiles inserted. Throws a std::runtime_error if the file cannot be read, is not a pack
+     * or was exported with a different tile size.
+     **/
+    std::size_t importPack(const std::string& filePath);
+
     /**
      * @brief Returns whether a cache entry exists for the given hash.
      * This is significantly faster than the get() function but does not return the entry.
@@ -247,6 +351,9 @@ public:
 
     /**
      * @brief Clears the cache of its last recently used entries so at least nBytesToFree are available for the given storage.
+     * Each pass evicts one entry from each bucket: with the LRU policy, the front of its LRU list. With the cost-aware policy (GreedyDual-Size),
+     * the entry with the lowest priority in its whole eviction queue, regardless of how recently it was used: the priority grows with the time
+     * the entry took to compute, decreases with its size and is recomputed from the priority of the last evicted entry when the entry is accessed.
      * This should be called before allocating any buffer in the application to ensure we do not hit the swap.
      *
      * This function is not blocking and it is not guaranteed that the memory is available when returning. 
@@ -277,6 +384,41 @@ public:
      **/
     void getMemoryStats(std::map<std::string, CacheReportInfo>* infos) const;
 
+    /**
+     * @brief Returns the hit/miss counters of the process-local cache that sits in front of the shared cache
+     * for small entries, see ProcessLocalCache.
+     * Each hit is a look-up that did not have to go through the interprocess locks.
+     **/
+    void getProcessLocalCacheStats(ProcessLocalCacheStats* stats) const;
+
+    /**
+     * @brief Set the maximum number of entries of the process-local cache. 0 disables it.
+     **/
+    void setProcessLocalCacheMaximumEntries(std::size_t maxEntries);
+
+    /**
+     * @brief Returns the pool recycling the buffers of the RAM images of this process. The idle buffers it holds
+     * are bounded by the memory budget of the cache and freed by clear().
+     **/
+    const RAMBufferPoolPtr& getRAMBufferPool() const;
+
+    /**
+     * @brief Returns the counters and latency histograms of the cache operations made by this process,
+     * in total, for each bucket and for each plug-in.
+     **/
+    void getStats(CacheStatsReport* report) const;
+
+    /**
+     * @brief Called when a sparse image is destroyed to account in the statistics for the memory of the tiles
+     * that were never written to and thus never allocated.
+     **/
+    void reportSparseImageTiles(std::size_t nTiles, std::size_t nAllocatedTiles, std::size_t bytesSaved);
+
+    /**
+     * @brief Resets all the statistics returned by getStats
+     **/
+    void resetStats();
+
     /**
      * @brief Return a number 0 <= N <= 255 from the 2 first hexadecimal digits (8-bit) of the hash
      **/
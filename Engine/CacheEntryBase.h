@@ -121,16 +121,53 @@ public:
     ViewIdx getView() const;
 
     /**
-     * @brief Returns whether the data storage of this entry is exactly the size of NATRON_TILE_SIZE_BYTES or not.
+     * @brief Returns whether the data storage of this entry is exactly the size of a tile (Cache::getTileSizeBytes()) or not.
      * In this case, Natron optimizes the storage of the entry in a tile aligned memory mapped file.
      * If true the toMemorySegment and fromMemorySegment function will have their tileDataPtr set to 
-     * a non null value. The implementation should then copy from/to the data exactly NATRON_TILE_SIZE_BYTES bytes.
+     * a non null value. The implementation should then copy from/to the data exactly Cache::getTileSizeBytes() bytes.
      **/
     virtual bool isStorageTiled() const
     {
         return false;
     }
 
+    /**
+     * @brief For tiled entries, returns the size in bytes of a sample of the tile data, e.g: 2 for 16-bit images.
+     * The compressed tier of the cache groups the bytes of equal significance of the samples before compressing a tile.
+     **/
+    virtual int getTileElementSize() const
+    {
+        return 1;
+    }
+
+    /**
+     * @brief Returns whether this entry may also be kept in the ProcessLocalCache in front of the shared memory segment.
+     * This should only be the case for small entries that are looked-up very often, such as the results of actions.
+     * Derived classes returning true must implement copyFromProcessLocalEntry.
+     **/
+    virtual bool isProcessLocalCacheable() const
+    {
+        return false;
+    }
+
+    /**
+     * @brief Copy the results held by other, an entry with the same hash found in the ProcessLocalCache, to this entry.
+     * Returns false if other is not of the same type, in which case the entry is looked-up in the shared memory segment.
+     **/
+    virtual bool copyFromProcessLocalEntry(const CacheEntryBase& /*other*/)
+    {
+        return false;
+    }
+
+    /**
+     * @brief Returns the entry the ProcessLocalCache keeps when this entry is inserted. By default this entry is kept:
+     * derived classes whose results are shared with the caller, who could modify them afterwards, must return a deep copy.
+     **/
+    virtual CacheEntryBasePtr createProcessLocalEntry()
+    {
+        return shared_from_this();
+    }
+
     /**
      * @brief Write this key to the process shared memory segment.
      * Each object written to the memory segment must have its handle appended 
@@ -153,6 +190,17 @@ public:
      **/
     virtual void fromMemorySegment(ExternalSegmentType* segment, const std::string& objectNamesPrefix, const void* tileDataPtr);
 
+    /**
+     * @brief For tiled entries, reads only the tile data, which was kept by the cache outside of the memory segment
+     * (e.g: in the compressed tier). The key is not read: it is the key this entry was looked-up with.
+     * The implementation should copy exactly Cache::getTileSizeBytes() bytes from tileDataPtr.
+     * Returns false if the entry cannot be restored from its tile data alone, in which case it is computed.
+     **/
+    virtual bool fromTileData(const void* /*tileDataPtr*/)
+    {
+        return false;
+    }
+
 private:
 
     boost::scoped_ptr<CacheEntryBasePrivate> _imp;
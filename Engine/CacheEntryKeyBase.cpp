@@ -26,7 +26,9 @@
 #include "CacheEntryKeyBase.h"
 
 #include <QMutex>
+#include <QAtomicInt>
 
+#include "Engine/CacheStats.h"
 #include "Engine/Hash64.h"
 
 namespace bip = boost::interprocess;
@@ -37,12 +39,17 @@ struct CacheEntryKeyBasePrivate
 {
     mutable QMutex lock;
     std::string pluginID;
+
+    // Index of pluginID in the CacheStatsRecorder, read without the lock
+    QAtomicInt pluginStatsIndex;
+
     mutable U64 hash;
     mutable bool hashComputed;
 
     CacheEntryKeyBasePrivate()
     : lock()
     , pluginID()
+    , pluginStatsIndex(0)
     , hash(0)
     , hashComputed(false)
     {
@@ -59,6 +66,7 @@ CacheEntryKeyBase::CacheEntryKeyBase(const std::string& pluginID)
 : _imp(new CacheEntryKeyBasePrivate)
 {
     _imp->pluginID = pluginID;
+    _imp->pluginStatsIndex.fetchAndStoreRelaxed( CacheStatsRecorder::getPluginIndex(pluginID) );
 }
 
 
@@ -105,6 +113,13 @@ void
 CacheEntryKeyBase::setHolderPluginID(const std::string& holderID) {
     QMutexLocker k(&_imp->lock);
     _imp->pluginID = holderID;
+    _imp->pluginStatsIndex.fetchAndStoreRelaxed( CacheStatsRecorder::getPluginIndex(holderID) );
+}
+
+int
+CacheEntryKeyBase::getHolderPluginStatsIndex() const
+{
+    return _imp->pluginStatsIndex.fetchAndAddRelaxed(0);
 }
 
 std::size_t
@@ -385,8 +400,68 @@ ImageTileKey::fromMemorySegment(ExternalSegmentType* segment, const std::string&
     _imp->data.mipMapLevel = data->mipMapLevel;
     _imp->data.draftMode = data->draftMode;
     _imp->data.bitdepth = data->bitdepth;
-    _imp->layerChannel.append(layersChannels->c_str());
+    _imp->layerChannel = layersChannels->c_str();
+
+    CacheEntryKeyBase::fromMemorySegment(segment, objectNamesPrefix);
+}
+
+
+ImageTileMipMapsKey::ImageTileMipMapsKey(U64 tileHash, const std::string& pluginID)
+: CacheEntryKeyBase(pluginID)
+, _tileHash(tileHash)
+{
 
+}
+
+ImageTileMipMapsKey::~ImageTileMipMapsKey()
+{
+
+}
+
+U64
+ImageTileMipMapsKey::getTileHash() const
+{
+    return _tileHash;
+}
+
+U64
+ImageTileMipMapsKey::getTileMipMapsHash(U64 tileHash)
+{
+    ImageTileMipMapsKey key(tileHash, std::string());
+    return key.getHash();
+}
+
+int
+ImageTileMipMapsKey::getUniqueID() const
+{
+    return kCacheKeyUniqueIDImageTileMipMaps;
+}
+
+void
+ImageTileMipMapsKey::appendToHash(Hash64* hash) const
+{
+    hash->append(_tileHash);
+}
+
+std::size_t
+ImageTileMipMapsKey::getMetadataSize() const
+{
+    std::size_t ret = CacheEntryKeyBase::getMetadataSize();
+    ret += sizeof(_tileHash);
+    return ret;
+}
+
+void
+ImageTileMipMapsKey::toMemorySegment(ExternalSegmentType* segment, const std::string& objectNamesPrefix, ExternalSegmentTypeHandleList* objectPointers) const
+{
+    objectPointers->push_back(writeNamedSharedObject(_tileHash, objectNamesPrefix + "TileHash", segment));
+    CacheEntryKeyBase::toMemorySegment(segment, objectNamesPrefix, objectPointers);
+}
+
+void
+ImageTileMipMapsKey::fromMemorySegment(ExternalSegmentType* segment, const std::string& objectNamesPrefix)
+{
+    readNamedSharedObject(objectNamesPrefix + "TileHash", segment, &_tileHash);
     CacheEntryKeyBase::fromMemorySegment(segment, objectNamesPrefix);
 }
 
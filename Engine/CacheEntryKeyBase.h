@@ -53,6 +53,7 @@ NATRON_NAMESPACE_ENTER;
 #define kCacheKeyUniqueIDGetComponentsResults 6
 #define kCacheKeyUniqueIDGetFrameRangeResults 7
 #define kCacheKeyUniqueIDExpressionResult 8
+#define kCacheKeyUniqueIDImageTileMipMaps 9
 
 
 
@@ -112,6 +113,12 @@ public:
     std::string getHolderPluginID() const;
     void setHolderPluginID(const std::string& holderID);
 
+    /**
+     * @brief Returns the index of the holder plug-in ID returned by CacheStatsRecorder::getPluginIndex().
+     * This does not take any lock.
+     **/
+    int getHolderPluginStatsIndex() const;
+
     /**
      * @brief Returns the key time
      **/
@@ -215,6 +222,45 @@ ImageTileKeyPtr toImageTileKey(const CacheEntryKeyBasePtr& key)
     return boost::dynamic_pointer_cast<ImageTileKey>(key);
 }
 
+/**
+ * @brief The key of the mipmaps derived from an image tile at mipmap level 0 (see CacheImageTileMipMaps).
+ * It only depends on the hash of the key of the tile, so that the cache can find the mipmaps
+ * of a tile, and remove them with it, from the hash of the tile alone.
+ **/
+class ImageTileMipMapsKey
+: public CacheEntryKeyBase
+{
+public:
+
+    ImageTileMipMapsKey(U64 tileHash, const std::string& pluginID);
+
+    virtual ~ImageTileMipMapsKey();
+
+    /**
+     * @brief Returns the hash of the key of the tile at mipmap level 0 the mipmaps are derived from.
+     **/
+    U64 getTileHash() const;
+
+    /**
+     * @brief Returns the hash of the key of the mipmaps derived from the tile with the given hash.
+     **/
+    static U64 getTileMipMapsHash(U64 tileHash);
+
+    virtual std::size_t getMetadataSize() const OVERRIDE FINAL;
+
+    virtual void toMemorySegment(ExternalSegmentType* segment, const std::string& objectNamesPrefix,  ExternalSegmentTypeHandleList* objectPointers) const OVERRIDE FINAL;
+
+    virtual void fromMemorySegment(ExternalSegmentType* segment, const std::string& objectNamesPrefix) OVERRIDE FINAL;
+
+    virtual int getUniqueID() const OVERRIDE FINAL;
+
+private:
+
+    virtual void appendToHash(Hash64* hash) const OVERRIDE FINAL;
+
+    U64 _tileHash;
+};
+
 NATRON_NAMESPACE_EXIT;
 
 #endif // Engine_CacheEntryKeyBase_h
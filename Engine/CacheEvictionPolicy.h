@@ -0,0 +1,90 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2017 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef Engine_CacheEvictionPolicy_h
+#define Engine_CacheEvictionPolicy_h
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <algorithm>
+#include <cstddef> // std::size_t
+
+#include "Global/GlobalDefines.h"
+
+NATRON_NAMESPACE_ENTER;
+
+/**
+ * @brief Returns the priority of a cache entry for the cost-aware eviction policy (GreedyDual-Size):
+ * entries with the lowest priority are evicted first.
+ * @param clock The priority of the last entry evicted from the bucket. It only grows, so that entries
+ * that are expensive to compute but no longer accessed eventually get evicted.
+ * @param computeCost The time in seconds it took to compute the entry
+ * @param nBytes The memory taken by the entry in the cache
+ **/
+inline double
+getCacheEntryEvictionPriority(double clock,
+                              double computeCost,
+                              std::size_t nBytes)
+{
+    // In seconds per MiB
+    return clock + computeCost * (1024. * 1024.) / std::max( nBytes, (std::size_t)1 );
+}
+
+/**
+ * @brief Orders the entries of a cache bucket for the cost-aware eviction policy: the first entry
+ * of a set of CacheEvictionKey is the one to evict.
+ **/
+struct CacheEvictionKey
+{
+    double priority;
+    U64 hash;
+
+    CacheEvictionKey()
+    : priority(0)
+    , hash(0)
+    {
+
+    }
+
+    CacheEvictionKey(double priority,
+                     U64 hash)
+    : priority(priority)
+    , hash(hash)
+    {
+
+    }
+
+    bool operator<(const CacheEvictionKey& other) const
+    {
+        if (priority != other.priority) {
+            return priority < other.priority;
+        }
+
+        return hash < other.hash;
+    }
+};
+
+NATRON_NAMESPACE_EXIT;
+
+#endif // Engine_CacheEvictionPolicy_h
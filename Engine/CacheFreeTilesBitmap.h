@@ -0,0 +1,213 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2017 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef Engine_CacheFreeTilesBitmap_h
+#define Engine_CacheFreeTilesBitmap_h
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef> // std::size_t
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/container/vector.hpp>
+#endif
+
+#include "Global/GlobalDefines.h"
+
+#define NATRON_CACHE_FREE_TILES_BITMAP_WORD_BITS 64
+
+NATRON_NAMESPACE_ENTER;
+
+/**
+ * @brief Returns the index of the lowest bit set in the given word, which must not be 0.
+ **/
+inline int
+findFirstBitSet(U64 word)
+{
+    assert(word != 0);
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(word);
+#else
+    int ret = 0;
+    while ( !(word & 1) ) {
+        word >>= 1;
+        ++ret;
+    }
+    return ret;
+#endif
+}
+
+/**
+ * @brief The set of free tiles of the tile aligned memory-mapped file of a cache bucket: one bit per tile,
+ * set if the tile is free.
+ * Allocating a tile returns the free tile with the lowest index, by looking for the first non-zero word
+ * from a hint that is never above the first word with a free tile.
+ * The Allocator is a U64 allocator: the bitmap may live in interprocess shared memory, in which case the caller
+ * is responsible for the locking.
+ **/
+template <typename Allocator>
+class CacheFreeTilesBitmap
+{
+public:
+
+    typedef boost::container::vector<U64, Allocator> WordsVector;
+
+    CacheFreeTilesBitmap(const Allocator& allocator)
+    : _words(allocator)
+    , _nTiles(0)
+    , _nFreeTiles(0)
+    , _firstFreeWordHint(0)
+    {
+
+    }
+
+    std::size_t getTilesCount() const
+    {
+        return _nTiles;
+    }
+
+    std::size_t getFreeTilesCount() const
+    {
+        return _nFreeTiles;
+    }
+
+    bool isTileFree(std::size_t tileIndex) const
+    {
+        assert(tileIndex < _nTiles);
+        return (_words[tileIndex / NATRON_CACHE_FREE_TILES_BITMAP_WORD_BITS] >> (tileIndex % NATRON_CACHE_FREE_TILES_BITMAP_WORD_BITS)) & 1;
+    }
+
+    /**
+     * @brief Returns the number of bytes the words of the bitmap take after growing by nTilesToAdd tiles.
+     * The allocator must be able to allocate this memory in one block for grow() to succeed.
+     **/
+    std::size_t getMemorySizeAfterGrowth(std::size_t nTilesToAdd) const
+    {
+        return getWordsCount(_nTiles + nTilesToAdd) * sizeof(U64);
+    }
+
+    /**
+     * @brief Adds nTilesToAdd free tiles after the existing ones.
+     **/
+    void grow(std::size_t nTilesToAdd)
+    {
+        std::size_t newNTiles = _nTiles + nTilesToAdd;
+        _words.resize(getWordsCount(newNTiles), 0);
+        for (std::size_t i = _nTiles; i < newNTiles; ++i) {
+            _words[i / NATRON_CACHE_FREE_TILES_BITMAP_WORD_BITS] |= (U64)1 << (i % NATRON_CACHE_FREE_TILES_BITMAP_WORD_BITS);
+        }
+        _firstFreeWordHint = std::min(_firstFreeWordHint, _nTiles / NATRON_CACHE_FREE_TILES_BITMAP_WORD_BITS);
+        _nFreeTiles += nTilesToAdd;
+        _nTiles = newNTiles;
+    }
+
+    /**
+     * @brief Marks the free tile with the lowest index as allocated and returns its index in tileIndex.
+     * Returns false if there is no free tile.
+     **/
+    bool allocateTile(std::size_t* tileIndex)
+    {
+        if (_nFreeTiles == 0) {
+            return false;
+        }
+        std::size_t nWords = _words.size();
+        std::size_t wordIndex = _firstFreeWordHint;
+        while (wordIndex < nWords && _words[wordIndex] == 0) {
+            ++wordIndex;
+        }
+        assert(wordIndex < nWords);
+        if (wordIndex >= nWords) {
+            return false;
+        }
+        int bit = findFirstBitSet(_words[wordIndex]);
+        _words[wordIndex] &= ~( (U64)1 << bit );
+        _firstFreeWordHint = wordIndex;
+        --_nFreeTiles;
+        *tileIndex = wordIndex * NATRON_CACHE_FREE_TILES_BITMAP_WORD_BITS + bit;
+        return true;
+    }
+
+    /**
+     * @brief Marks the given tile as free. Returns false if it was already free.
+     **/
+    bool freeTile(std::size_t tileIndex)
+    {
+        assert(tileIndex < _nTiles);
+        std::size_t wordIndex = tileIndex / NATRON_CACHE_FREE_TILES_BITMAP_WORD_BITS;
+        U64 mask = (U64)1 << (tileIndex % NATRON_CACHE_FREE_TILES_BITMAP_WORD_BITS);
+        if (_words[wordIndex] & mask) {
+            return false;
+        }
+        _words[wordIndex] |= mask;
+        _firstFreeWordHint = std::min(_firstFreeWordHint, wordIndex);
+        ++_nFreeTiles;
+        return true;
+    }
+
+    /**
+     * @brief Returns the number of consecutive tiles starting at firstTile that are all free or all allocated,
+     * and in isFree whether they are free. Whole words are skipped at once.
+     **/
+    std::size_t getRunLength(std::size_t firstTile, bool* isFree) const
+    {
+        assert(firstTile < _nTiles);
+        *isFree = isTileFree(firstTile);
+        const U64 sameStateWord = *isFree ? ~(U64)0 : 0;
+        std::size_t i = firstTile + 1;
+        while (i < _nTiles) {
+            if ( (i % NATRON_CACHE_FREE_TILES_BITMAP_WORD_BITS == 0) && (_words[i / NATRON_CACHE_FREE_TILES_BITMAP_WORD_BITS] == sameStateWord) ) {
+                i += NATRON_CACHE_FREE_TILES_BITMAP_WORD_BITS;
+                continue;
+            }
+            if (isTileFree(i) != *isFree) {
+                break;
+            }
+            ++i;
+        }
+        return std::min(i, _nTiles) - firstTile;
+    }
+
+private:
+
+    static std::size_t getWordsCount(std::size_t nTiles)
+    {
+        return (nTiles + NATRON_CACHE_FREE_TILES_BITMAP_WORD_BITS - 1) / NATRON_CACHE_FREE_TILES_BITMAP_WORD_BITS;
+    }
+
+    // Bit i of word j is set if the tile j * 64 + i is free. Bits past the last tile are never set.
+    WordsVector _words;
+
+    std::size_t _nTiles;
+
+    std::size_t _nFreeTiles;
+
+    // No word before this one has a free tile
+    std::size_t _firstFreeWordHint;
+};
+
+NATRON_NAMESPACE_EXIT;
+
+#endif // Engine_CacheFreeTilesBitmap_h
@@ -0,0 +1,366 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2017 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "CacheMemoryGovernor.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include <QtCore/QDateTime>
+#include <QtCore/QMutex>
+#include <QtCore/QWaitCondition>
+
+#include "Engine/AppManager.h"
+#include "Engine/Cache.h"
+#include "Engine/MemoryInfo.h"
+
+// How often the memory state is read
+#define NATRON_CACHE_MEMORY_GOVERNOR_INTERVAL_MS 1000
+
+// The part of the physical memory that is left to the system and the other processes
+#define NATRON_CACHE_MEMORY_GOVERNOR_RESERVE_RATIO 0.1
+
+// Above this percentage of time stalled waiting for memory, the system is considered under pressure
+#define NATRON_CACHE_MEMORY_GOVERNOR_STALL_THRESHOLD 10.
+
+// Under pressure, the budget is at most this ratio of the previous budget
+#define NATRON_CACHE_MEMORY_GOVERNOR_SHRINK_RATIO 0.75
+
+// The budget does not change for less than this ratio of the maximum budget, nor less than the minimum step
+#define NATRON_CACHE_MEMORY_GOVERNOR_STEP_RATIO 0.05
+#define NATRON_CACHE_MEMORY_GOVERNOR_MIN_STEP ((std::size_t)64 * 1024 * 1024)
+
+NATRON_NAMESPACE_ENTER;
+
+static bool
+readFile(const std::string& filePath,
+         std::string* content)
+{
+    // Files in /proc have a size of 0: read until the end of the stream
+    std::ifstream ifile( filePath.c_str() );
+    if ( !ifile.is_open() ) {
+        return false;
+    }
+    std::stringstream ss;
+    ss << ifile.rdbuf();
+    *content = ss.str();
+    return !content->empty();
+}
+
+SystemMemoryPressureSource::SystemMemoryPressureSource(const std::string& memInfoFilePath,
+                                                       const std::string& pressureFilePath)
+    : MemoryPressureSourceI()
+    , _memInfoFilePath(memInfoFilePath)
+    , _pressureFilePath(pressureFilePath)
+{
+}
+
+SystemMemoryPressureSource::~SystemMemoryPressureSource()
+{
+}
+
+bool
+SystemMemoryPressureSource::getMemoryPressure(MemoryPressureInfo* info)
+{
+    *info = MemoryPressureInfo();
+
+    std::string content;
+    if ( !readFile(_memInfoFilePath, &content) || !parseMemInfo(content, &info->totalRAM, &info->availableRAM) ) {
+        info->totalRAM = getSystemTotalRAM();
+        info->availableRAM = getAmountFreePhysicalRAM();
+    }
+    if ( readFile(_pressureFilePath, &content) ) {
+        parsePressure(content, &info->someStallPercent, &info->fullStallPercent);
+    }
+
+    return info->totalRAM > 0;
+}
+
+bool
+SystemMemoryPressureSource::parseMemInfo(const std::string& content,
+                                         U64* totalRAM,
+                                         U64* availableRAM)
+{
+    // Each line is of the form "MemTotal:       16318712 kB"
+    U64 memTotal = 0, memAvailable = 0, memFree = 0, buffers = 0, cached = 0;
+    bool hasTotal = false, hasAvailable = false, hasFree = false;
+
+    std::istringstream ss(content);
+    std::string line;
+    while ( std::getline(ss, line) ) {
+        std::size_t colon = line.find(':');
+        if (colon == std::string::npos) {
+            continue;
+        }
+        std::string name = line.substr(0, colon);
+        U64 valueKb = std::strtoull(line.c_str() + colon + 1, 0, 10);
+        if (name == "MemTotal") {
+            memTotal = valueKb;
+            hasTotal = true;
+        } else if (name == "MemAvailable") {
+            memAvailable = valueKb;
+            hasAvailable = true;
+        } else if (name == "MemFree") {
+            memFree = valueKb;
+            hasFree = true;
+        } else if (name == "Buffers") {
+            buffers = valueKb;
+        } else if (name == "Cached") {
+            cached = valueKb;
+        }
+    }
+    if ( !hasTotal || (!hasAvailable && !hasFree) ) {
+        return false;
+    }
+    if (!hasAvailable) {
+        memAvailable = memFree + buffers + cached;
+    }
+    *totalRAM = memTotal * 1024;
+    *availableRAM = std::min(memAvailable, memTotal) * 1024;
+
+    return true;
+} // parseMemInfo
+
+bool
+SystemMemoryPressureSource::parsePressure(const std::string& content,
+                                          double* someStallPercent,
+                                          double* fullStallPercent)
+{
+    // Each line is of the form "some avg10=0.00 avg60=0.00 avg300=0.00 total=0"
+    bool hasSome = false;
+
+    *someStallPercent = -1;
+    *fullStallPercent = -1;
+
+    std::istringstream ss(content);
+    std::string line;
+    while ( std::getline(ss, line) ) {
+        std::istringstream lineStream(line);
+        std::string kind, field;
+        lineStream >> kind;
+        double* value = 0;
+        if (kind == "some") {
+            value = someStallPercent;
+        } else if (kind == "full") {
+            value = fullStallPercent;
+        } else {
+            continue;
+        }
+        while (lineStream >> field) {
+            if (field.compare(0, 6, "avg10=") == 0) {
+                *value = std::strtod(field.c_str() + 6, 0);
+                if (value == someStallPercent) {
+                    hasSome = true;
+                }
+                break;
+            }
+        }
+    }
+
+    return hasSome;
+}
+
+struct CacheMemoryGovernorPrivate
+{
+    CacheWPtr cache;
+    MemoryPressureSourcePtr source;
+
+    // Protects minBudget, maxBudget and budget
+    mutable QMutex budgetMutex;
+    std::size_t minBudget, maxBudget;
+    std::size_t budget;
+
+    QMutex mustQuitMutex;
+    QWaitCondition mustQuitCond;
+    bool mustQuit;
+
+    CacheMemoryGovernorPrivate(const CachePtr& cache,
+                               const MemoryPressureSourcePtr& source)
+    : cache(cache)
+    , source(source)
+    , budgetMutex()
+    , minBudget(0)
+    , maxBudget(0)
+    , budget(0)
+    , mustQuitMutex()
+    , mustQuitCond()
+    , mustQuit(false)
+    {
+        if (!this->source) {
+            this->source.reset(new SystemMemoryPressureSource);
+        }
+    }
+};
+
+CacheMemoryGovernor::CacheMemoryGovernor(const CachePtr& cache,
+                                         const MemoryPressureSourcePtr& source)
+    : QThread()
+    , _imp( new CacheMemoryGovernorPrivate(cache, source) )
+{
+    setObjectName( QString::fromUtf8("CacheMemoryGovernor") );
+}
+
+CacheMemoryGovernor::~CacheMemoryGovernor()
+{
+}
+
+void
+CacheMemoryGovernor::setBudgetRange(std::size_t minBudget,
+                                    std::size_t maxBudget)
+{
+    QMutexLocker k(&_imp->budgetMutex);
+    _imp->minBudget = minBudget;
+    _imp->maxBudget = maxBudget;
+}
+
+std::size_t
+CacheMemoryGovernor::getBudget() const
+{
+    QMutexLocker k(&_imp->budgetMutex);
+    return _imp->budget;
+}
+
+std::size_t
+CacheMemoryGovernor::computeBudget(const MemoryPressureInfo& info,
+                                   std::size_t currentBudget,
+                                   std::size_t cacheSize,
+                                   std::size_t minBudget,
+                                   std::size_t maxBudget)
+{
+    if (maxBudget == 0) {
+        maxBudget = info.totalRAM;
+    }
+    // A budget of 0 would mean no budget to the cache
+    minBudget = std::max( std::min(minBudget, maxBudget), (std::size_t)1 );
+
+    std::size_t reserve = (std::size_t)(info.totalRAM * NATRON_CACHE_MEMORY_GOVERNOR_RESERVE_RATIO);
+    bool underPressure = info.availableRAM < reserve || info.someStallPercent >= NATRON_CACHE_MEMORY_GOVERNOR_STALL_THRESHOLD;
+
+    // The cache may grow by what is available above the reserve, or must shrink by what is missing
+    std::size_t target;
+    if (info.availableRAM >= reserve) {
+        target = cacheSize + (std::size_t)(info.availableRAM - reserve);
+    } else {
+        std::size_t missing = (std::size_t)(reserve - info.availableRAM);
+        target = cacheSize > missing ? cacheSize - missing : 0;
+    }
+    if ( underPressure && (currentBudget != 0) ) {
+        target = std::min( target, (std::size_t)(currentBudget * NATRON_CACHE_MEMORY_GOVERNOR_SHRINK_RATIO) );
+    }
+    target = std::max( minBudget, std::min(target, maxBudget) );
+
+    if ( !underPressure && (currentBudget != 0) && (currentBudget >= minBudget) && (currentBudget <= maxBudget) ) {
+        std::size_t step = std::max( (std::size_t)(maxBudget * NATRON_CACHE_MEMORY_GOVERNOR_STEP_RATIO), NATRON_CACHE_MEMORY_GOVERNOR_MIN_STEP );
+        std::size_t delta = target > currentBudget ? target - currentBudget : currentBudget - target;
+        if (delta < step) {
+            return currentBudget;
+        }
+    }
+
+    return target;
+} // computeBudget
+
+std::size_t
+CacheMemoryGovernor::computeNextBudget(std::size_t cacheSize)
+{
+    MemoryPressureInfo info;
+    bool gotInfo = _imp->source->getMemoryPressure(&info);
+
+    QMutexLocker k(&_imp->budgetMutex);
+    if (gotInfo) {
+        _imp->budget = computeBudget(info, _imp->budget, cacheSize, _imp->minBudget, _imp->maxBudget);
+    }
+    return _imp->budget;
+}
+
+void
+CacheMemoryGovernor::update()
+{
+    CachePtr cache = _imp->cache.lock();
+    if (!cache) {
+        return;
+    }
+
+    std::size_t cacheSize = cache->getRAMResidentSize();
+    std::size_t previousBudget = cache->getMemoryBudget();
+    std::size_t budget = computeNextBudget(cacheSize);
+    if ( (budget == 0) || (budget == previousBudget) ) {
+        // Entries may have been inserted above the budget since the last update
+        if ( (budget != 0) && (cacheSize > budget) ) {
+            cache->evictLRUEntries(0);
+        }
+        return;
+    }
+
+    // This evicts the exceeding entries if the budget shrinks
+    cache->setMemoryBudget(budget);
+
+    if (appPTR) {
+        QString message;
+        if (previousBudget == 0) {
+            message = tr("Cache memory budget set to %1").arg( printAsRAM(budget) );
+        } else {
+            message = tr("Cache memory budget changed from %1 to %2").arg( printAsRAM(previousBudget) ).arg( printAsRAM(budget) );
+        }
+        message += QLatin1String(" (") + tr("cache size: %1").arg( printAsRAM(cacheSize) ) + QLatin1Char(')');
+        appPTR->writeToErrorLog_mt_safe(tr("Cache Memory Governor"), QDateTime::currentDateTime(), message);
+    }
+} // update
+
+void
+CacheMemoryGovernor::quitThread()
+{
+    if ( !isRunning() ) {
+        return;
+    }
+    {
+        QMutexLocker k(&_imp->mustQuitMutex);
+        _imp->mustQuit = true;
+        _imp->mustQuitCond.wakeOne();
+    }
+    wait();
+
+    QMutexLocker k(&_imp->mustQuitMutex);
+    _imp->mustQuit = false;
+}
+
+void
+CacheMemoryGovernor::run()
+{
+    for (;;) {
+        update();
+
+        QMutexLocker k(&_imp->mustQuitMutex);
+        if (!_imp->mustQuit) {
+            _imp->mustQuitCond.wait(&_imp->mustQuitMutex, NATRON_CACHE_MEMORY_GOVERNOR_INTERVAL_MS);
+        }
+        if (_imp->mustQuit) {
+            return;
+        }
+    }
+}
+
+NATRON_NAMESPACE_EXIT;
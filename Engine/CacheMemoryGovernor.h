@@ -0,0 +1,194 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2017 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef Engine_CacheMemoryGovernor_h
+#define Engine_CacheMemoryGovernor_h
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cstddef> // std::size_t
+#include <string>
+
+#include <QtCore/QThread>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#endif
+
+#include "Global/GlobalDefines.h"
+
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER;
+
+/**
+ * @brief A snapshot of the memory of the system
+ **/
+struct MemoryPressureInfo
+{
+    // Physical memory in bytes
+    U64 totalRAM;
+
+    // Memory in bytes that can be allocated without swapping: this includes the reclaimable file pages
+    U64 availableRAM;
+
+    // The percentage of the last 10 seconds during which at least one task (some) or all non-idle tasks (full)
+    // were stalled waiting for memory, -1 if unknown
+    double someStallPercent;
+    double fullStallPercent;
+
+    MemoryPressureInfo()
+    : totalRAM(0)
+    , availableRAM(0)
+    , someStallPercent(-1)
+    , fullStallPercent(-1)
+    {
+    }
+};
+
+/**
+ * @brief Interface of the objects the CacheMemoryGovernor reads the memory state from
+ **/
+class MemoryPressureSourceI
+{
+public:
+
+    MemoryPressureSourceI() {}
+
+    virtual ~MemoryPressureSourceI() {}
+
+    /**
+     * @brief Fills info with the current state of the memory. Returns false if it could not be determined.
+     **/
+    virtual bool getMemoryPressure(MemoryPressureInfo* info) = 0;
+};
+
+typedef boost::shared_ptr<MemoryPressureSourceI> MemoryPressureSourcePtr;
+
+/**
+ * @brief Reads the memory state of the system from /proc/meminfo and the Pressure Stall Information
+ * of Linux (/proc/pressure/memory, Linux 4.20 and later).
+ * When these files are not available (other systems, old kernels), the functions of MemoryInfo.h are used
+ * and the stall is unknown.
+ **/
+class SystemMemoryPressureSource
+    : public MemoryPressureSourceI
+{
+public:
+
+    SystemMemoryPressureSource(const std::string& memInfoFilePath = std::string("/proc/meminfo"),
+                               const std::string& pressureFilePath = std::string("/proc/pressure/memory"));
+
+    virtual ~SystemMemoryPressureSource();
+
+    virtual bool getMemoryPressure(MemoryPressureInfo* info) OVERRIDE FINAL;
+
+    /**
+     * @brief Parses the content of /proc/meminfo. Returns false if the total or available memory is missing.
+     * Kernels older than 3.14 do not have MemAvailable: it is estimated from MemFree, Buffers and Cached.
+     **/
+    static bool parseMemInfo(const std::string& content, U64* totalRAM, U64* availableRAM);
+
+    /**
+     * @brief Parses the content of /proc/pressure/memory. The avg10 values of the "some" and "full" lines
+     * are returned. Returns false if the "some" line is missing.
+     **/
+    static bool parsePressure(const std::string& content, double* someStallPercent, double* fullStallPercent);
+
+private:
+
+    std::string _memInfoFilePath, _pressureFilePath;
+};
+
+/**
+ * @brief A thread that periodically adapts the memory budget of the cache (see Cache::setMemoryBudget) to the
+ * memory pressure of the system, between a minimum and a maximum.
+ * The cache grows while the system has free memory and shrinks when another process needs it, which avoids
+ * both leaving RAM unused on shared machines and getting killed by the system when another job spikes.
+ * When the budget shrinks, the exceeding entries are evicted right away. Budget changes are logged.
+ **/
+struct CacheMemoryGovernorPrivate;
+class CacheMemoryGovernor
+    : public QThread
+{
+public:
+
+    /**
+     * @brief If source is NULL, a SystemMemoryPressureSource is used.
+     **/
+    CacheMemoryGovernor(const CachePtr& cache,
+                        const MemoryPressureSourcePtr& source = MemoryPressureSourcePtr());
+
+    virtual ~CacheMemoryGovernor();
+
+    /**
+     * @brief Set the bounds of the budget. A maximum of 0 means the total physical memory.
+     **/
+    void setBudgetRange(std::size_t minBudget, std::size_t maxBudget);
+
+    /**
+     * @brief Returns the last budget computed, 0 if none was computed yet.
+     **/
+    std::size_t getBudget() const;
+
+    /**
+     * @brief Reads the memory state from the source and returns the new budget for a cache of cacheSize bytes.
+     * The result is remembered as the current budget for the next call. Returns the current budget if the memory
+     * state could not be read.
+     **/
+    std::size_t computeNextBudget(std::size_t cacheSize);
+
+    /**
+     * @brief The budget policy: 10% of the physical memory is left to the system and the other processes and the
+     * cache may take what remains available. Under pressure (the available memory is below that reserve or tasks were
+     * stalled waiting for memory for at least 10% of the time) the budget shrinks by at least a quarter.
+     * The budget only changes if it moves by more than 5% of maxBudget (and at least 64MiB) to avoid evicting
+     * and refilling the cache on every small fluctuation, except under pressure.
+     * The result is clamped to [minBudget, maxBudget].
+     **/
+    static std::size_t computeBudget(const MemoryPressureInfo& info,
+                                     std::size_t currentBudget,
+                                     std::size_t cacheSize,
+                                     std::size_t minBudget,
+                                     std::size_t maxBudget);
+
+    /**
+     * @brief Computes the next budget and applies it to the cache. If the budget changed, the change is logged.
+     * This is what the thread does periodically.
+     **/
+    void update();
+
+    void quitThread();
+
+private:
+
+    virtual void run() OVERRIDE FINAL;
+
+    boost::scoped_ptr<CacheMemoryGovernorPrivate> _imp;
+};
+
+NATRON_NAMESPACE_EXIT;
+
+#endif // Engine_CacheMemoryGovernor_h
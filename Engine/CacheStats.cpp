@@ -0,0 +1,691 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2017 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "CacheStats.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iomanip>
+
+#include <QtCore/QReadWriteLock>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/atomic.hpp>
+#endif
+
+NATRON_NAMESPACE_ENTER;
+
+CacheLatencyHistogram::CacheLatencyHistogram()
+: nSamples(0)
+, totalSeconds(0)
+, maxSeconds(0)
+{
+    std::fill(counts, counts + NATRON_CACHE_LATENCY_HISTOGRAM_BUCKETS_COUNT, 0);
+}
+
+int
+CacheLatencyHistogram::getBucketIndex(double seconds)
+{
+    // Find the first bucket whose upper bound is above the sample
+    int bucketIndex = 0;
+    double micros = seconds * 1e6;
+    while ( (bucketIndex < NATRON_CACHE_LATENCY_HISTOGRAM_BUCKETS_COUNT - 1) && (micros >= (double)( (U64)1 << bucketIndex ) ) ) {
+        ++bucketIndex;
+    }
+    return bucketIndex;
+}
+
+void
+CacheLatencyHistogram::addSample(double seconds)
+{
+    seconds = std::max(0., seconds);
+    ++counts[getBucketIndex(seconds)];
+    ++nSamples;
+    totalSeconds += seconds;
+    maxSeconds = std::max(maxSeconds, seconds);
+}
+
+void
+CacheLatencyHistogram::merge(const CacheLatencyHistogram& other)
+{
+    for (int i = 0; i < NATRON_CACHE_LATENCY_HISTOGRAM_BUCKETS_COUNT; ++i) {
+        counts[i] += other.counts[i];
+    }
+    nSamples += other.nSamples;
+    totalSeconds += other.totalSeconds;
+    maxSeconds = std::max(maxSeconds, other.maxSeconds);
+}
+
+double
+CacheLatencyHistogram::getMeanSeconds() const
+{
+    return nSamples == 0 ? 0. : totalSeconds / nSamples;
+}
+
+double
+CacheLatencyHistogram::getBucketUpperBoundSeconds(int bucketIndex)
+{
+    return (double)( (U64)1 << bucketIndex ) * 1e-6;
+}
+
+double
+CacheLatencyHistogram::getPercentileSeconds(double percentile) const
+{
+    if (nSamples == 0) {
+        return 0.;
+    }
+    percentile = std::max( 0., std::min(1., percentile) );
+    U64 rank = (U64)std::ceil(percentile * nSamples);
+    U64 nSamplesSoFar = 0;
+    for (int i = 0; i < NATRON_CACHE_LATENCY_HISTOGRAM_BUCKETS_COUNT - 1; ++i) {
+        nSamplesSoFar += counts[i];
+        if ( (nSamplesSoFar >= rank) && (nSamplesSoFar > 0) ) {
+            // The bucket bound may exceed the slowest sample
+            return std::min( getBucketUpperBoundSeconds(i), maxSeconds );
+        }
+    }
+    return maxSeconds;
+}
+
+CacheStats::CacheStats()
+: nHits(0)
+, nMisses(0)
+, nPendingWaits(0)
+, nInsertions(0)
+, nEvictions(0)
+, nContendedLocks(0)
+, nFileGrowths(0)
+, nCompressedHits(0)
+, nCompressedMisses(0)
+, nCompressedWrites(0)
+, compressedInputBytes(0)
+, compressedOutputBytes(0)
+, nSparseTiles(0)
+, nSparseTilesAllocated(0)
+, sparseBytesSaved(0)
+, nBufferPoolReuses(0)
+, nBufferPoolAllocations(0)
+, bufferPoolBytesReused(0)
+, getLatency()
+, insertLatency()
+, evictLatency()
+, waitLatency()
+, lockLatency()
+, fileGrowthLatency()
+, compressLatency()
+, decompressLatency()
+{
+
+}
+
+void
+CacheStats::merge(const CacheStats& other)
+{
+    nHits += other.nHits;
+    nMisses += other.nMisses;
+    nPendingWaits += other.nPendingWaits;
+    nInsertions += other.nInsertions;
+    nEvictions += other.nEvictions;
+    nContendedLocks += other.nContendedLocks;
+    nFileGrowths += other.nFileGrowths;
+    nCompressedHits += other.nCompressedHits;
+    nCompressedMisses += other.nCompressedMisses;
+    nCompressedWrites += other.nCompressedWrites;
+    compressedInputBytes += other.compressedInputBytes;
+    compressedOutputBytes += other.compressedOutputBytes;
+    nSparseTiles += other.nSparseTiles;
+    nSparseTilesAllocated += other.nSparseTilesAllocated;
+    sparseBytesSaved += other.sparseBytesSaved;
+    nBufferPoolReuses += other.nBufferPoolReuses;
+    nBufferPoolAllocations += other.nBufferPoolAllocations;
+    bufferPoolBytesReused += other.bufferPoolBytesReused;
+    getLatency.merge(other.getLatency);
+    insertLatency.merge(other.insertLatency);
+    evictLatency.merge(other.evictLatency);
+    waitLatency.merge(other.waitLatency);
+    lockLatency.merge(other.lockLatency);
+    fileGrowthLatency.merge(other.fileGrowthLatency);
+    compressLatency.merge(other.compressLatency);
+    decompressLatency.merge(other.decompressLatency);
+}
+
+double
+CacheStats::getHitRatio() const
+{
+    U64 nLookups = nHits + nMisses;
+    return nLookups == 0 ? 0. : nHits / (double)nLookups;
+}
+
+double
+CacheStats::getCompressionRatio() const
+{
+    return compressedOutputBytes == 0 ? 0. : compressedInputBytes / (double)compressedOutputBytes;
+}
+
+static void
+printLatency(std::ostream& stream,
+             const char* name,
+             const CacheLatencyHistogram& histogram)
+{
+    if (histogram.nSamples == 0) {
+        return;
+    }
+    stream << "    " << std::left << std::setw(12) << name << std::right
+           << " n=" << histogram.nSamples
+           << " mean=" << histogram.getMeanSeconds() * 1e6 << "us"
+           << " p50<=" << histogram.getPercentileSeconds(0.5) * 1e6 << "us"
+           << " p99<=" << histogram.getPercentileSeconds(0.99) * 1e6 << "us"
+           << " max=" << histogram.maxSeconds * 1e6 << "us"
+           << " total=" << histogram.totalSeconds << "s\n";
+}
+
+static void
+printStats(std::ostream& stream,
+           const std::string& title,
+           const CacheStats& stats)
+{
+    stream << title << ":\n";
+    stream << "    hits=" << stats.nHits
+           << " misses=" << stats.nMisses
+           << " hitRatio=" << stats.getHitRatio()
+           << " waits=" << stats.nPendingWaits
+           << " insertions=" << stats.nInsertions
+           << " evictions=" << stats.nEvictions
+           << " contendedLocks=" << stats.nContendedLocks
+           << " fileGrowths=" << stats.nFileGrowths << "\n";
+    if ( (stats.nCompressedHits > 0) || (stats.nCompressedMisses > 0) || (stats.nCompressedWrites > 0) ) {
+        stream << "    compressedHits=" << stats.nCompressedHits
+               << " compressedMisses=" << stats.nCompressedMisses
+               << " compressedWrites=" << stats.nCompressedWrites
+               << " compressionRatio=" << stats.getCompressionRatio() << "\n";
+    }
+    if (stats.nSparseTiles > 0) {
+        stream << "    sparseTiles=" << stats.nSparseTiles
+               << " sparseTilesAllocated=" << stats.nSparseTilesAllocated
+               << " sparseBytesSaved=" << stats.sparseBytesSaved << "\n";
+    }
+    if ( (stats.nBufferPoolReuses > 0) || (stats.nBufferPoolAllocations > 0) ) {
+        stream << "    bufferPoolReuses=" << stats.nBufferPoolReuses
+               << " bufferPoolAllocations=" << stats.nBufferPoolAllocations
+               << " bufferPoolBytesReused=" << stats.bufferPoolBytesReused << "\n";
+    }
+    printLatency(stream, "get", stats.getLatency);
+    printLatency(stream, "insert", stats.insertLatency);
+    printLatency(stream, "evict", stats.evictLatency);
+    printLatency(stream, "wait", stats.waitLatency);
+    printLatency(stream, "lock", stats.lockLatency);
+    printLatency(stream, "fileGrowth", stats.fileGrowthLatency);
+    printLatency(stream, "compress", stats.compressLatency);
+    printLatency(stream, "decompress", stats.decompressLatency);
+}
+
+void
+CacheStatsReport::print(std::ostream& stream) const
+{
+    std::streamsize precision = stream.precision(3);
+    std::ios_base::fmtflags flags = stream.setf(std::ios_base::fixed, std::ios_base::floatfield);
+
+    printStats(stream, "Cache total", total);
+
+    // The most contended buckets reveal a poor distribution of the hashes
+    int mostContendedBucket = -1;
+    for (std::size_t i = 0; i < perBucket.size(); ++i) {
+        if ( perBucket[i].nContendedLocks > 0 &&
+             ( (mostContendedBucket == -1) || (perBucket[i].nContendedLocks > perBucket[mostContendedBucket].nContendedLocks) ) ) {
+            mostContendedBucket = (int)i;
+        }
+    }
+    if (mostContendedBucket != -1) {
+        stream << "Most contended bucket: " << mostContendedBucket << " (" << perBucket[mostContendedBucket].nContendedLocks << " contended locks)\n";
+    }
+
+    for (std::map<std::string, CacheStats>::const_iterator it = perPlugin.begin(); it != perPlugin.end(); ++it) {
+        printStats(stream, it->first.empty() ? std::string("<no plug-in>") : it->first, it->second);
+    }
+
+    stream.precision(precision);
+    stream.flags(flags);
+}
+
+typedef boost::atomic<U64> AtomicU64;
+
+static void
+addRelaxed(AtomicU64& counter,
+           U64 value)
+{
+    counter.fetch_add(value, boost::memory_order_relaxed);
+}
+
+static U64
+loadRelaxed(const AtomicU64& counter)
+{
+    return counter.load(boost::memory_order_relaxed);
+}
+
+/**
+ * @brief Lock-free version of CacheLatencyHistogram. Durations are counted in nanoseconds.
+ **/
+struct AtomicLatencyHistogram
+{
+    AtomicU64 counts[NATRON_CACHE_LATENCY_HISTOGRAM_BUCKETS_COUNT];
+    AtomicU64 nSamples;
+    AtomicU64 totalNanos, maxNanos;
+
+    AtomicLatencyHistogram()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        for (int i = 0; i < NATRON_CACHE_LATENCY_HISTOGRAM_BUCKETS_COUNT; ++i) {
+            counts[i].store(0, boost::memory_order_relaxed);
+        }
+        nSamples.store(0, boost::memory_order_relaxed);
+        totalNanos.store(0, boost::memory_order_relaxed);
+        maxNanos.store(0, boost::memory_order_relaxed);
+    }
+
+    void addSample(double seconds)
+    {
+        seconds = std::max(0., seconds);
+        U64 nanos = (U64)(seconds * 1e9);
+        addRelaxed(counts[CacheLatencyHistogram::getBucketIndex(seconds)], 1);
+        addRelaxed(nSamples, 1);
+        addRelaxed(totalNanos, nanos);
+        U64 curMax = loadRelaxed(maxNanos);
+        while ( (nanos > curMax) && !maxNanos.compare_exchange_weak(curMax, nanos, boost::memory_order_relaxed) ) {
+        }
+    }
+
+    void appendTo(CacheLatencyHistogram* histogram) const
+    {
+        CacheLatencyHistogram tmp;
+        for (int i = 0; i < NATRON_CACHE_LATENCY_HISTOGRAM_BUCKETS_COUNT; ++i) {
+            tmp.counts[i] = loadRelaxed(counts[i]);
+        }
+        tmp.nSamples = loadRelaxed(nSamples);
+        tmp.totalSeconds = loadRelaxed(totalNanos) * 1e-9;
+        tmp.maxSeconds = loadRelaxed(maxNanos) * 1e-9;
+        histogram->merge(tmp);
+    }
+};
+
+/**
+ * @brief Lock-free version of the CacheStats fields filled by the CacheStatsRecorder.
+ **/
+struct AtomicCacheStats
+{
+    AtomicU64 nHits, nMisses, nPendingWaits, nInsertions, nEvictions, nContendedLocks, nFileGrowths;
+    AtomicU64 nCompressedHits, nCompressedMisses, nCompressedWrites, compressedInputBytes, compressedOutputBytes;
+    AtomicU64 nSparseTiles, nSparseTilesAllocated, sparseBytesSaved;
+    AtomicLatencyHistogram getLatency, insertLatency, evictLatency, waitLatency, lockLatency, fileGrowthLatency;
+    AtomicLatencyHistogram compressLatency, decompressLatency;
+
+    AtomicCacheStats()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        AtomicU64* counters[] = {
+            &nHits, &nMisses, &nPendingWaits, &nInsertions, &nEvictions, &nContendedLocks, &nFileGrowths,
+            &nCompressedHits, &nCompressedMisses, &nCompressedWrites, &compressedInputBytes, &compressedOutputBytes,
+            &nSparseTiles, &nSparseTilesAllocated, &sparseBytesSaved
+        };
+        for (std::size_t i = 0; i < sizeof(counters) / sizeof(counters[0]); ++i) {
+            counters[i]->store(0, boost::memory_order_relaxed);
+        }
+        getLatency.reset();
+        insertLatency.reset();
+        evictLatency.reset();
+        waitLatency.reset();
+        lockLatency.reset();
+        fileGrowthLatency.reset();
+        compressLatency.reset();
+        decompressLatency.reset();
+    }
+
+    void appendTo(CacheStats* stats) const
+    {
+        CacheStats tmp;
+        tmp.nHits = loadRelaxed(nHits);
+        tmp.nMisses = loadRelaxed(nMisses);
+        tmp.nPendingWaits = loadRelaxed(nPendingWaits);
+        tmp.nInsertions = loadRelaxed(nInsertions);
+        tmp.nEvictions = loadRelaxed(nEvictions);
+        tmp.nContendedLocks = loadRelaxed(nContendedLocks);
+        tmp.nFileGrowths = loadRelaxed(nFileGrowths);
+        tmp.nCompressedHits = loadRelaxed(nCompressedHits);
+        tmp.nCompressedMisses = loadRelaxed(nCompressedMisses);
+        tmp.nCompressedWrites = loadRelaxed(nCompressedWrites);
+        tmp.compressedInputBytes = loadRelaxed(compressedInputBytes);
+        tmp.compressedOutputBytes = loadRelaxed(compressedOutputBytes);
+        tmp.nSparseTiles = loadRelaxed(nSparseTiles);
+        tmp.nSparseTilesAllocated = loadRelaxed(nSparseTilesAllocated);
+        tmp.sparseBytesSaved = loadRelaxed(sparseBytesSaved);
+        getLatency.appendTo(&tmp.getLatency);
+        insertLatency.appendTo(&tmp.insertLatency);
+        evictLatency.appendTo(&tmp.evictLatency);
+        waitLatency.appendTo(&tmp.waitLatency);
+        lockLatency.appendTo(&tmp.lockLatency);
+        fileGrowthLatency.appendTo(&tmp.fileGrowthLatency);
+        compressLatency.appendTo(&tmp.compressLatency);
+        decompressLatency.appendTo(&tmp.decompressLatency);
+        stats->merge(tmp);
+    }
+};
+
+/**
+ * @brief The plug-in IDs interned by CacheStatsRecorder::getPluginIndex, shared by all recorders.
+ **/
+struct CacheStatsPluginIDs
+{
+    // Protects all fields below
+    QReadWriteLock lock;
+
+    std::map<std::string, int> indices;
+
+    std::vector<std::string> pluginIDs;
+
+    CacheStatsPluginIDs()
+    : lock()
+    , indices()
+    , pluginIDs()
+    {
+        indices[std::string()] = 0;
+        pluginIDs.push_back( std::string() );
+    }
+};
+
+static CacheStatsPluginIDs internedPluginIDs;
+
+/**
+ * @brief The statistics of each plug-in index, allocated the first time the plug-in is recorded.
+ **/
+struct CacheStatsPluginTable
+{
+    boost::atomic<AtomicCacheStats*> stats[NATRON_CACHE_STATS_MAX_PLUGINS];
+
+    CacheStatsPluginTable()
+    {
+        for (int i = 0; i < NATRON_CACHE_STATS_MAX_PLUGINS; ++i) {
+            stats[i].store(0, boost::memory_order_relaxed);
+        }
+    }
+
+    ~CacheStatsPluginTable()
+    {
+        for (int i = 0; i < NATRON_CACHE_STATS_MAX_PLUGINS; ++i) {
+            delete stats[i].load(boost::memory_order_relaxed);
+        }
+    }
+};
+
+/**
+ * @brief Returns the object stored in the given pointer, allocating it if it is null.
+ * If several threads allocate it concurrently, only one of them publishes it.
+ **/
+template <typename T>
+static T*
+getOrCreate(boost::atomic<T*>& ptr)
+{
+    T* ret = ptr.load(boost::memory_order_acquire);
+    if (ret) {
+        return ret;
+    }
+    T* newObj = new T;
+    if ( ptr.compare_exchange_strong(ret, newObj, boost::memory_order_acq_rel, boost::memory_order_acquire) ) {
+        return newObj;
+    }
+    delete newObj;
+    return ret;
+}
+
+struct CacheStatsRecorderPrivate
+{
+    AtomicCacheStats stats;
+
+    // Allocated the first time a plug-in is recorded. Unused if pluginRecorder is set.
+    boost::atomic<CacheStatsPluginTable*> perPlugin;
+
+    // If set, samples of plug-ins are recorded in its table instead of perPlugin
+    CacheStatsRecorderPrivate* pluginRecorder;
+
+    CacheStatsRecorderPrivate()
+    : stats()
+    , perPlugin()
+    , pluginRecorder(0)
+    {
+        perPlugin.store(0, boost::memory_order_relaxed);
+    }
+
+    ~CacheStatsRecorderPrivate()
+    {
+        delete perPlugin.load(boost::memory_order_relaxed);
+    }
+
+    AtomicCacheStats* getPluginStats(int pluginIndex)
+    {
+        if (pluginRecorder) {
+            return pluginRecorder->getPluginStats(pluginIndex);
+        }
+        if ( (pluginIndex < 0) || (pluginIndex >= NATRON_CACHE_STATS_MAX_PLUGINS) ) {
+            pluginIndex = 0;
+        }
+        return getOrCreate(getOrCreate(perPlugin)->stats[pluginIndex]);
+    }
+};
+
+CacheStatsRecorder::CacheStatsRecorder()
+: _imp(new CacheStatsRecorderPrivate)
+{
+
+}
+
+CacheStatsRecorder::~CacheStatsRecorder()
+{
+
+}
+
+int
+CacheStatsRecorder::getPluginIndex(const std::string& pluginID)
+{
+    CacheStatsPluginIDs& ids = internedPluginIDs;
+    {
+        QReadLocker k(&ids.lock);
+        std::map<std::string, int>::const_iterator found = ids.indices.find(pluginID);
+        if ( found != ids.indices.end() ) {
+            return found->second;
+        }
+    }
+    QWriteLocker k(&ids.lock);
+    std::map<std::string, int>::const_iterator found = ids.indices.find(pluginID);
+    if ( found != ids.indices.end() ) {
+        return found->second;
+    }
+    if ( (int)ids.pluginIDs.size() >= NATRON_CACHE_STATS_MAX_PLUGINS ) {
+        return 0;
+    }
+    int index = (int)ids.pluginIDs.size();
+    ids.pluginIDs.push_back(pluginID);
+    ids.indices[pluginID] = index;
+    return index;
+}
+
+std::string
+CacheStatsRecorder::getPluginID(int pluginIndex)
+{
+    CacheStatsPluginIDs& ids = internedPluginIDs;
+    QReadLocker k(&ids.lock);
+    if ( (pluginIndex < 0) || ( pluginIndex >= (int)ids.pluginIDs.size() ) ) {
+        return std::string();
+    }
+    return ids.pluginIDs[pluginIndex];
+}
+
+void
+CacheStatsRecorder::setPluginStatsRecorder(CacheStatsRecorder* recorder)
+{
+    assert(recorder != this);
+    _imp->pluginRecorder = recorder ? recorder->_imp.get() : 0;
+}
+
+void
+CacheStatsRecorder::addLookup(int pluginIndex,
+                              bool hit,
+                              double seconds)
+{
+    AtomicCacheStats* stats[2] = { &_imp->stats, _imp->getPluginStats(pluginIndex) };
+    for (int i = 0; i < 2; ++i) {
+        addRelaxed(hit ? stats[i]->nHits : stats[i]->nMisses, 1);
+        stats[i]->getLatency.addSample(seconds);
+    }
+}
+
+void
+CacheStatsRecorder::addPendingWait(int pluginIndex,
+                                   double seconds)
+{
+    AtomicCacheStats* stats[2] = { &_imp->stats, _imp->getPluginStats(pluginIndex) };
+    for (int i = 0; i < 2; ++i) {
+        addRelaxed(stats[i]->nPendingWaits, 1);
+        stats[i]->waitLatency.addSample(seconds);
+    }
+}
+
+void
+CacheStatsRecorder::addInsertion(int pluginIndex,
+                                 double seconds)
+{
+    AtomicCacheStats* stats[2] = { &_imp->stats, _imp->getPluginStats(pluginIndex) };
+    for (int i = 0; i < 2; ++i) {
+        addRelaxed(stats[i]->nInsertions, 1);
+        stats[i]->insertLatency.addSample(seconds);
+    }
+}
+
+void
+CacheStatsRecorder::addEviction(int pluginIndex,
+                                double seconds)
+{
+    AtomicCacheStats* stats[2] = { &_imp->stats, _imp->getPluginStats(pluginIndex) };
+    for (int i = 0; i < 2; ++i) {
+        addRelaxed(stats[i]->nEvictions, 1);
+        stats[i]->evictLatency.addSample(seconds);
+    }
+}
+
+void
+CacheStatsRecorder::addContendedLock(double seconds)
+{
+    addRelaxed(_imp->stats.nContendedLocks, 1);
+    _imp->stats.lockLatency.addSample(seconds);
+}
+
+void
+CacheStatsRecorder::addFileGrowth(double seconds)
+{
+    addRelaxed(_imp->stats.nFileGrowths, 1);
+    _imp->stats.fileGrowthLatency.addSample(seconds);
+}
+
+void
+CacheStatsRecorder::addCompressedLookup(int pluginIndex,
+                                        bool hit,
+                                        double seconds)
+{
+    AtomicCacheStats* stats[2] = { &_imp->stats, _imp->getPluginStats(pluginIndex) };
+    for (int i = 0; i < 2; ++i) {
+        if (hit) {
+            addRelaxed(stats[i]->nCompressedHits, 1);
+            stats[i]->decompressLatency.addSample(seconds);
+        } else {
+            addRelaxed(stats[i]->nCompressedMisses, 1);
+        }
+    }
+}
+
+void
+CacheStatsRecorder::addCompressedWrite(int pluginIndex,
+                                       std::size_t inputBytes,
+                                       std::size_t outputBytes,
+                                       double seconds)
+{
+    AtomicCacheStats* stats[2] = { &_imp->stats, _imp->getPluginStats(pluginIndex) };
+    for (int i = 0; i < 2; ++i) {
+        addRelaxed(stats[i]->nCompressedWrites, 1);
+        addRelaxed(stats[i]->compressedInputBytes, inputBytes);
+        addRelaxed(stats[i]->compressedOutputBytes, outputBytes);
+        stats[i]->compressLatency.addSample(seconds);
+    }
+}
+
+void
+CacheStatsRecorder::addSparseImage(std::size_t nTiles,
+                                   std::size_t nAllocatedTiles,
+                                   std::size_t bytesSaved)
+{
+    addRelaxed(_imp->stats.nSparseTiles, nTiles);
+    addRelaxed(_imp->stats.nSparseTilesAllocated, nAllocatedTiles);
+    addRelaxed(_imp->stats.sparseBytesSaved, bytesSaved);
+}
+
+void
+CacheStatsRecorder::appendStats(CacheStats* stats,
+                                std::map<std::string, CacheStats>* perPlugin) const
+{
+    if (stats) {
+        _imp->stats.appendTo(stats);
+    }
+    const CacheStatsPluginTable* table = _imp->perPlugin.load(boost::memory_order_acquire);
+    if (perPlugin && table) {
+        for (int i = 0; i < NATRON_CACHE_STATS_MAX_PLUGINS; ++i) {
+            const AtomicCacheStats* pluginStats = table->stats[i].load(boost::memory_order_acquire);
+            if (pluginStats) {
+                pluginStats->appendTo( &(*perPlugin)[getPluginID(i)] );
+            }
+        }
+    }
+}
+
+void
+CacheStatsRecorder::reset()
+{
+    _imp->stats.reset();
+    CacheStatsPluginTable* table = _imp->perPlugin.load(boost::memory_order_acquire);
+    if (!table) {
+        return;
+    }
+    for (int i = 0; i < NATRON_CACHE_STATS_MAX_PLUGINS; ++i) {
+        AtomicCacheStats* pluginStats = table->stats[i].load(boost::memory_order_acquire);
+        if (pluginStats) {
+            pluginStats->reset();
+        }
+    }
+}
+
+NATRON_NAMESPACE_EXIT;
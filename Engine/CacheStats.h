@@ -0,0 +1,236 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2017 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef Engine_CacheStats_h
+#define Engine_CacheStats_h
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/scoped_ptr.hpp>
+#endif
+
+#include "Global/GlobalDefines.h"
+
+#include "Engine/EngineFwd.h"
+
+// Bucket 0 counts samples under 1 microsecond, bucket i counts samples in [2^(i-1), 2^i[ microseconds.
+// The last bucket counts everything above 2^22 microseconds (~4 seconds).
+#define NATRON_CACHE_LATENCY_HISTOGRAM_BUCKETS_COUNT 24
+
+// Maximum number of distinct plug-ins whose cache statistics are recorded separately
+#define NATRON_CACHE_STATS_MAX_PLUGINS 1024
+
+NATRON_NAMESPACE_ENTER;
+
+/**
+ * @brief A histogram of the latencies of a cache operation, with buckets of exponentially growing size.
+ **/
+struct CacheLatencyHistogram
+{
+    U64 counts[NATRON_CACHE_LATENCY_HISTOGRAM_BUCKETS_COUNT];
+
+    U64 nSamples;
+
+    double totalSeconds, maxSeconds;
+
+    CacheLatencyHistogram();
+
+    void addSample(double seconds);
+
+    void merge(const CacheLatencyHistogram& other);
+
+    /**
+     * @brief Returns the index of the histogram bucket counting the given sample.
+     **/
+    static int getBucketIndex(double seconds);
+
+    double getMeanSeconds() const;
+
+    /**
+     * @brief Returns the upper bound of the histogram bucket containing the given percentile (in [0, 1])
+     * of the samples. This is an over-estimation by at most a factor 2.
+     **/
+    double getPercentileSeconds(double percentile) const;
+
+    /**
+     * @brief Returns the upper bound in seconds of the given histogram bucket.
+     **/
+    static double getBucketUpperBoundSeconds(int bucketIndex);
+};
+
+struct CacheStats
+{
+    // Number of look-ups that found an entry ready to be read, including in the process-local cache
+    U64 nHits;
+
+    // Number of look-ups that did not find an entry, or found an entry that is being computed
+    U64 nMisses;
+
+    // Number of calls to CacheEntryLocker::waitForPendingEntry
+    U64 nPendingWaits;
+
+    // Number of entries inserted in the cache
+    U64 nInsertions;
+
+    // Number of entries evicted because the cache was full
+    U64 nEvictions;
+
+    // Number of interprocess locks that could not be taken right away
+    U64 nContendedLocks;
+
+    // Number of times a ToC or tile file had to be grown
+    U64 nFileGrowths;
+
+    // Number of tiles not found in the cache that were decompressed from the compressed tier instead of being computed.
+    // They are also counted in nHits.
+    U64 nCompressedHits;
+
+    // Number of tiles not found in the cache nor in the compressed tier
+    U64 nCompressedMisses;
+
+    // Number of evicted tiles written to the compressed tier
+    U64 nCompressedWrites;
+
+    // Size of the tiles written to the compressed tier, before and after compression
+    U64 compressedInputBytes, compressedOutputBytes;
+
+    // Number of channel tiles of sparse images, and how many of them were allocated because they were written to.
+    // sparseBytesSaved is the memory of the tiles that were never allocated.
+    U64 nSparseTiles, nSparseTilesAllocated, sparseBytesSaved;
+
+    // Number of RAM image buffers that were recycled by the RAMBufferPool, that it had to allocate, and the size
+    // of the recycled buffers
+    U64 nBufferPoolReuses, nBufferPoolAllocations, bufferPoolBytesReused;
+
+    CacheLatencyHistogram getLatency, insertLatency, evictLatency, waitLatency, lockLatency, fileGrowthLatency;
+
+    // Time taken to compress and write a tile to the compressed tier, and to read and decompress it
+    CacheLatencyHistogram compressLatency, decompressLatency;
+
+    CacheStats();
+
+    void merge(const CacheStats& other);
+
+    double getHitRatio() const;
+
+    /**
+     * @brief Returns the size of the tiles written to the compressed tier divided by their compressed size.
+     **/
+    double getCompressionRatio() const;
+};
+
+struct CacheStatsReport
+{
+    // Sum of all buckets
+    CacheStats total;
+
+    // Statistics of each bucket of the cache
+    std::vector<CacheStats> perBucket;
+
+    // Statistics of the entries of each plug-in. Lock contention and file growth are not
+    // associated to a plug-in and are only accounted for in the total and per bucket.
+    std::map<std::string, CacheStats> perPlugin;
+
+    /**
+     * @brief Prints a human readable summary of the report. Buckets are not detailed.
+     **/
+    void print(std::ostream& stream) const;
+};
+
+/**
+ * @brief Accumulates the statistics of a cache bucket in process memory. These are not shared
+ * with other processes using the same cache.
+ * Recording a sample only updates atomic counters: it takes no lock and does not allocate, except
+ * the first time a plug-in is recorded. Plug-ins are identified by their index returned by getPluginIndex().
+ * This class is thread-safe.
+ **/
+struct CacheStatsRecorderPrivate;
+class CacheStatsRecorder
+{
+public:
+
+    CacheStatsRecorder();
+
+    ~CacheStatsRecorder();
+
+    /**
+     * @brief Returns the index identifying the given plug-in ID in the recorders. Index 0 is the empty
+     * plug-in ID. Past NATRON_CACHE_STATS_MAX_PLUGINS distinct IDs, this returns 0.
+     * This takes a lock: call it once per cache entry key, not on every sample.
+     **/
+    static int getPluginIndex(const std::string& pluginID);
+
+    /**
+     * @brief Returns the plug-in ID of an index returned by getPluginIndex().
+     **/
+    static std::string getPluginID(int pluginIndex);
+
+    /**
+     * @brief Samples of plug-ins recorded by this recorder are also recorded in the per plug-in statistics of the given
+     * recorder instead of its own. This lets the cache keep a single per plug-in table instead of one per bucket.
+     * This must be called before recording any sample.
+     **/
+    void setPluginStatsRecorder(CacheStatsRecorder* recorder);
+
+    void addLookup(int pluginIndex, bool hit, double seconds);
+
+    void addPendingWait(int pluginIndex, double seconds);
+
+    void addInsertion(int pluginIndex, double seconds);
+
+    void addEviction(int pluginIndex, double seconds);
+
+    void addContendedLock(double seconds);
+
+    void addFileGrowth(double seconds);
+
+    void addCompressedLookup(int pluginIndex, bool hit, double seconds);
+
+    void addCompressedWrite(int pluginIndex, std::size_t inputBytes, std::size_t outputBytes, double seconds);
+
+    void addSparseImage(std::size_t nTiles, std::size_t nAllocatedTiles, std::size_t bytesSaved);
+
+    /**
+     * @brief Merges the recorded statistics into the given objects. The per plug-in statistics are the ones
+     * recorded in this recorder's own table, including the samples forwarded by other recorders (see setPluginStatsRecorder).
+     * Samples recorded concurrently may be partially accounted for.
+     **/
+    void appendStats(CacheStats* stats, std::map<std::string, CacheStats>* perPlugin) const;
+
+    void reset();
+
+private:
+
+    boost::scoped_ptr<CacheStatsRecorderPrivate> _imp;
+};
+
+NATRON_NAMESPACE_EXIT;
+
+#endif // Engine_CacheStats_h
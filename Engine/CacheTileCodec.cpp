@@ -0,0 +1,321 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2017 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "CacheTileCodec.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring> // memcpy
+
+// Matches are at least this long: shorter ones would not save anything over literals
+#define CACHE_TILE_CODEC_MIN_MATCH 4
+
+// Matches are encoded with a 16-bit offset
+#define CACHE_TILE_CODEC_MAX_OFFSET 65535
+
+// The hash table of the compressor has 2^CACHE_TILE_CODEC_HASH_LOG entries
+#define CACHE_TILE_CODEC_HASH_LOG 14
+
+NATRON_NAMESPACE_ENTER;
+
+namespace CacheTileCodec {
+
+/*
+ * The compressed stream is a sequence of:
+ * - A token byte: the high 4 bits are the number of literals, the low 4 bits are the match length minus
+ *   CACHE_TILE_CODEC_MIN_MATCH. A value of 15 means the length continues on the next bytes: each byte is added
+ *   to the length, until a byte lower than 255.
+ * - The literal length continuation bytes, then the literals.
+ * - The match offset on 2 bytes, little endian, then the match length continuation bytes.
+ * The last sequence only has literals: the stream ends after them.
+ */
+
+static unsigned int
+read32(const unsigned char* p)
+{
+    unsigned int ret;
+    memcpy(&ret, p, sizeof(ret));
+    return ret;
+}
+
+static unsigned int
+hashSequence(unsigned int sequence)
+{
+    return (sequence * 2654435761U) >> (32 - CACHE_TILE_CODEC_HASH_LOG);
+}
+
+static void
+shuffleBytes(const unsigned char* src,
+             std::size_t size,
+             int elementSize,
+             unsigned char* dst)
+{
+    std::size_t nElements = size / elementSize;
+    for (int plane = 0; plane < elementSize; ++plane) {
+        const unsigned char* srcPix = src + plane;
+        unsigned char* dstPix = dst + plane * nElements;
+        for (std::size_t i = 0; i < nElements; ++i, srcPix += elementSize) {
+            dstPix[i] = *srcPix;
+        }
+    }
+
+    // Bytes that do not make a whole element are left as is at the end
+    std::size_t nShuffledBytes = nElements * elementSize;
+    memcpy(dst + nShuffledBytes, src + nShuffledBytes, size - nShuffledBytes);
+}
+
+static void
+unshuffleBytes(const unsigned char* src,
+               std::size_t size,
+               int elementSize,
+               unsigned char* dst)
+{
+    std::size_t nElements = size / elementSize;
+    for (int plane = 0; plane < elementSize; ++plane) {
+        const unsigned char* srcPix = src + plane * nElements;
+        unsigned char* dstPix = dst + plane;
+        for (std::size_t i = 0; i < nElements; ++i, dstPix += elementSize) {
+            *dstPix = srcPix[i];
+        }
+    }
+    std::size_t nShuffledBytes = nElements * elementSize;
+    memcpy(dst + nShuffledBytes, src + nShuffledBytes, size - nShuffledBytes);
+}
+
+static unsigned char*
+writeLengthContinuation(unsigned char* op,
+                        std::size_t length)
+{
+    // length is what remains above the 15 stored in the token
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = (unsigned char)length;
+    return op;
+}
+
+/**
+ * @brief Writes a sequence to op and returns the new output position, or 0 if it would go past opEnd.
+ * If matchLength is 0, this is the last sequence and only literals are written.
+ **/
+static unsigned char*
+writeSequence(unsigned char* op,
+              const unsigned char* opEnd,
+              const unsigned char* literals,
+              std::size_t nLiterals,
+              std::size_t offset,
+              std::size_t matchLength)
+{
+    // The worst case size of the sequence: token, lengths, literals and offset
+    std::size_t maxSize = 1 + nLiterals / 255 + 1 + nLiterals + 2 + matchLength / 255 + 1;
+    if ( (std::size_t)(opEnd - op) < maxSize ) {
+        return 0;
+    }
+
+    unsigned char* token = op++;
+    if (nLiterals >= 15) {
+        *token = 15 << 4;
+        op = writeLengthContinuation(op, nLiterals - 15);
+    } else {
+        *token = (unsigned char)(nLiterals << 4);
+    }
+    memcpy(op, literals, nLiterals);
+    op += nLiterals;
+
+    if (matchLength == 0) {
+        return op;
+    }
+
+    *op++ = (unsigned char)(offset & 0xff);
+    *op++ = (unsigned char)(offset >> 8);
+    std::size_t matchCode = matchLength - CACHE_TILE_CODEC_MIN_MATCH;
+    if (matchCode >= 15) {
+        *token |= 15;
+        op = writeLengthContinuation(op, matchCode - 15);
+    } else {
+        *token |= (unsigned char)matchCode;
+    }
+    return op;
+}
+
+bool
+compress(const char* src,
+         std::size_t size,
+         int elementSize,
+         std::vector<char>* dst)
+{
+    assert(elementSize > 0);
+    std::vector<unsigned char> shuffled(size);
+    if (size > 0) {
+        shuffleBytes(reinterpret_cast<const unsigned char*>(src), size, elementSize, &shuffled[0]);
+    }
+    const unsigned char* in = size > 0 ? &shuffled[0] : 0;
+
+    // Anything not smaller than the input is useless
+    dst->resize(size);
+    if (size == 0) {
+        return false;
+    }
+    unsigned char* opBegin = reinterpret_cast<unsigned char*>(&(*dst)[0]);
+    unsigned char* op = opBegin;
+    const unsigned char* opEnd = opBegin + size;
+
+    // Position + 1 of the last occurrence of each hashed sequence, 0 if none
+    std::vector<std::size_t> hashTable(1 << CACHE_TILE_CODEC_HASH_LOG, 0);
+
+    std::size_t ip = 0, anchor = 0;
+    while (ip + CACHE_TILE_CODEC_MIN_MATCH <= size) {
+        unsigned int sequence = read32(in + ip);
+        std::size_t& entry = hashTable[hashSequence(sequence)];
+        std::size_t candidate = entry;
+        entry = ip + 1;
+
+        if ( (candidate == 0) || (ip - (candidate - 1) > CACHE_TILE_CODEC_MAX_OFFSET) || (read32(in + candidate - 1) != sequence) ) {
+            // Skip faster in data that does not compress
+            ip += 1 + ( (ip - anchor) >> 6 );
+            continue;
+        }
+
+        std::size_t matchPos = candidate - 1;
+        std::size_t matchLength = CACHE_TILE_CODEC_MIN_MATCH;
+        while ( (ip + matchLength < size) && (in[matchPos + matchLength] == in[ip + matchLength]) ) {
+            ++matchLength;
+        }
+
+        op = writeSequence(op, opEnd, in + anchor, ip - anchor, ip - matchPos, matchLength);
+        if (!op) {
+            return false;
+        }
+        ip += matchLength;
+        anchor = ip;
+    }
+
+    op = writeSequence(op, opEnd, in + anchor, size - anchor, 0, 0);
+    if ( !op || (op == opEnd) ) {
+        return false;
+    }
+    dst->resize(op - opBegin);
+    return true;
+} // compress
+
+/**
+ * @brief Reads the continuation of a length whose token nibble was 15. Returns false if the stream ends before.
+ **/
+static bool
+readLengthContinuation(const unsigned char* src,
+                       std::size_t srcSize,
+                       std::size_t* sp,
+                       std::size_t* length)
+{
+    unsigned char byte;
+    do {
+        if (*sp >= srcSize) {
+            return false;
+        }
+        byte = src[(*sp)++];
+        *length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+bool
+decompress(const char* src,
+           std::size_t srcSize,
+           int elementSize,
+           char* dst,
+           std::size_t dstSize)
+{
+    if (elementSize <= 0) {
+        return false;
+    }
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(src);
+    std::vector<unsigned char> shuffled(dstSize);
+    unsigned char* out = dstSize > 0 ? &shuffled[0] : 0;
+
+    std::size_t sp = 0, dp = 0;
+    for (;;) {
+        if (sp >= srcSize) {
+            return false;
+        }
+        unsigned char token = in[sp++];
+
+        std::size_t nLiterals = token >> 4;
+        if ( (nLiterals == 15) && !readLengthContinuation(in, srcSize, &sp, &nLiterals) ) {
+            return false;
+        }
+        if ( (nLiterals > srcSize - sp) || (nLiterals > dstSize - dp) ) {
+            return false;
+        }
+        memcpy(out + dp, in + sp, nLiterals);
+        sp += nLiterals;
+        dp += nLiterals;
+
+        if (sp == srcSize) {
+            // Last sequence
+            break;
+        }
+
+        if (srcSize - sp < 2) {
+            return false;
+        }
+        std::size_t offset = in[sp] | (in[sp + 1] << 8);
+        sp += 2;
+        if ( (offset == 0) || (offset > dp) ) {
+            return false;
+        }
+
+        std::size_t matchLength = token & 15;
+        if ( (matchLength == 15) && !readLengthContinuation(in, srcSize, &sp, &matchLength) ) {
+            return false;
+        }
+        matchLength += CACHE_TILE_CODEC_MIN_MATCH;
+        if (matchLength > dstSize - dp) {
+            return false;
+        }
+
+        const unsigned char* match = out + dp - offset;
+        if (offset >= matchLength) {
+            memcpy(out + dp, match, matchLength);
+        } else {
+            // The match overlaps the bytes it produces, e.g: a run of the same byte
+            for (std::size_t i = 0; i < matchLength; ++i) {
+                out[dp + i] = match[i];
+            }
+        }
+        dp += matchLength;
+    }
+
+    if (dp != dstSize) {
+        return false;
+    }
+    if (dstSize > 0) {
+        unshuffleBytes(out, dstSize, elementSize, reinterpret_cast<unsigned char*>(dst));
+    }
+    return true;
+} // decompress
+
+} // namespace CacheTileCodec
+
+NATRON_NAMESPACE_EXIT;
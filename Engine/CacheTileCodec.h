@@ -0,0 +1,63 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2017 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef Engine_CacheTileCodec_h
+#define Engine_CacheTileCodec_h
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cstddef> // std::size_t
+#include <vector>
+
+NATRON_NAMESPACE_ENTER;
+
+/**
+ * @brief The lossless codec of the tiles written to the compressed tier of the cache.
+ * The bytes of the tile are first shuffled by plane: all the first bytes of each element, then all the
+ * second bytes, etc... so that the bytes of equal significance of neighbouring samples are contiguous.
+ * The element size is the size of a sample of the tile: 4 for float images, 2 for 16-bit images, 1 for 8-bit images.
+ * The shuffled bytes are then compressed with a byte-oriented LZ77 coder in the spirit of LZ4:
+ * fast to decode, and cheap enough to compress to be done on eviction.
+ **/
+namespace CacheTileCodec {
+
+/**
+ * @brief Compresses size bytes from src, made of samples of elementSize bytes, to dst, which is resized to the compressed size.
+ * Returns false if the data does not compress, i.e: the compressed size would not be smaller than size.
+ * In this case the content of dst is undefined and the caller should store the raw bytes.
+ **/
+bool compress(const char* src, std::size_t size, int elementSize, std::vector<char>* dst);
+
+/**
+ * @brief Decompresses srcSize bytes produced by compress() to exactly dstSize bytes in dst.
+ * elementSize must be the one passed to compress().
+ * Returns false if the compressed data is corrupted or does not decompress to exactly dstSize bytes.
+ **/
+bool decompress(const char* src, std::size_t srcSize, int elementSize, char* dst, std::size_t dstSize);
+
+} // namespace CacheTileCodec
+
+NATRON_NAMESPACE_EXIT;
+
+#endif // Engine_CacheTileCodec_h
@@ -232,7 +232,8 @@ Curve::setPeriodic(bool periodic)
 {
     QMutexLocker k(&_imp->_lock);
     _imp->isPeriodic = periodic;
-    _imp->keyFrames.clear();
+    _imp->clearKeyFrames();
+    onCurveChanged();
 }
 
 bool
@@ -252,7 +253,8 @@ Curve::clearKeyFrames()
 {
     QMutexLocker l(&_imp->_lock);
 
-    _imp->keyFrames.clear();
+    _imp->clearKeyFrames();
+    onCurveChanged();
 }
 
 bool
@@ -267,10 +269,11 @@ void
 Curve::clone(const Curve & other)
 {
     KeyFrameSet otherKeys = other.getKeyFrames_mt_safe();
+    KeyFrameSet newKeys;
+    std::transform( otherKeys.begin(), otherKeys.end(), std::inserter( newKeys, newKeys.begin() ), KeyFrameCloner() );
     QMutexLocker l(&_imp->_lock);
 
-    _imp->keyFrames.clear();
-    std::transform( otherKeys.begin(), otherKeys.end(), std::inserter( _imp->keyFrames, _imp->keyFrames.begin() ), KeyFrameCloner() );
+    _imp->setKeyFrames(newKeys);
     onCurveChanged();
 }
 
@@ -279,8 +282,10 @@ Curve::cloneIndexRange(const Curve& other, int firstKeyIdx, int nKeys)
 {
     KeyFrameSet otherKeys = other.getKeyFrames_mt_safe();
     QMutexLocker l(&_imp->_lock);
-    _imp->keyFrames.clear();
+    _imp->clearKeyFrames();
     if (firstKeyIdx >= (int)otherKeys.size()) {
+        onCurveChanged();
+
         return;
     }
     KeyFrameSet::iterator start = otherKeys.begin();
@@ -293,7 +298,9 @@ Curve::cloneIndexRange(const Curve& other, int firstKeyIdx, int nKeys)
         end = start;
         std::advance(end, nKeys);
     }
-    std::transform( start, end, std::inserter( _imp->keyFrames, _imp->keyFrames.begin() ), KeyFrameCloner() );
+    KeyFrameSet newKeys;
+    std::transform( start, end, std::inserter( newKeys, newKeys.begin() ), KeyFrameCloner() );
+    _imp->setKeyFrames(newKeys);
     onCurveChanged();
 
 }
@@ -314,7 +321,7 @@ Curve::cloneAndCheckIfChanged(const Curve& other, double offset, const RangeD* r
 
     KeyFrameSet tmpSet = _imp->keyFrames;
     KeyFrameSet::iterator oit = tmpSet.begin();
-    _imp->keyFrames.clear();
+    _imp->clearKeyFrames();
     for (KeyFrameSet::iterator it = otherKeys.begin(); it != otherKeys.end(); ++it) {
         TimeValue time = it->getTime();
         if ( range && ( (time < range->min) || (time > range->max) ) ) {
@@ -329,12 +336,14 @@ Curve::cloneAndCheckIfChanged(const Curve& other, double offset, const RangeD* r
         if (!hasChanged && oit != tmpSet.end() && *oit != *it) {
             hasChanged = true;
         }
-        _imp->keyFrames.insert(k);
+        _imp->insertKeyFrame(k);
 
         if (oit != tmpSet.end()) {
             ++oit;
         }
     }
+    onCurveChanged();
+
     return hasChanged;
 }
 
@@ -349,7 +358,7 @@ Curve::clone(const Curve & other,
     bool copyRange = range != NULL /*&& (range->min != 0 || range->max != 0)*/;
     QMutexLocker l(&_imp->_lock);
 
-    _imp->keyFrames.clear();
+    _imp->clearKeyFrames();
     for (KeyFrameSet::iterator it = otherKeys.begin(); it != otherKeys.end(); ++it) {
         TimeValue time = it->getTime();
         if ( copyRange && ( (time < range->min) || (time > range->max) ) ) {
@@ -359,7 +368,7 @@ Curve::clone(const Curve & other,
         if (offset != 0) {
             k.setTime(TimeValue(time + offset));
         }
-        _imp->keyFrames.insert(k);
+        _imp->insertKeyFrame(k);
     }
     onCurveChanged();
 }
@@ -394,21 +403,21 @@ Curve::computeKeyFramesDiff(const KeyFrameSet& keysA,
 double
 Curve::getMinimumTimeCovered() const
 {
-    QMutexLocker l(&_imp->_lock);
+    CurveSnapshotPtr snapshot = _imp->getSnapshot();
 
-    assert( !_imp->keyFrames.empty() );
+    assert( !snapshot->keyFrames.empty() );
 
-    return ( *_imp->keyFrames.begin() ).getTime();
+    return snapshot->keyFrames.front().getTime();
 }
 
 double
 Curve::getMaximumTimeCovered() const
 {
-    QMutexLocker l(&_imp->_lock);
+    CurveSnapshotPtr snapshot = _imp->getSnapshot();
 
-    assert( !_imp->keyFrames.empty() );
+    assert( !snapshot->keyFrames.empty() );
 
-    return ( *_imp->keyFrames.rbegin() ).getTime();
+    return snapshot->keyFrames.back().getTime();
 }
 
 bool
@@ -445,12 +454,10 @@ Curve::setOrAddKeyframe(KeyFrame key)
         if (it.first->getValue() != key.getValue() || it.first->getTime() == key.getTime()) {
             ret = eValueChangedReturnCodeKeyframeModified;
         }
-        _imp->keyFrames.erase(it.first);
-        it = addKeyFrameNoUpdate(key);
+        // addKeyFrameNoUpdate already replaced the existing keyframe
     } else {
         ret = eValueChangedReturnCodeKeyframeAdded;
     }
-    assert(it.second);
     it.first = evaluateCurveChanged(eCurveChangedReasonKeyframeChanged, it.first);
 
     return ret;
@@ -461,28 +468,19 @@ std::pair<KeyFrameSet::iterator, bool> Curve::addKeyFrameNoUpdate(const KeyFrame
 {
     // PRIVATE - should not lock
     if (_imp->type != eCurveTypeParametric) { //< if keyframes are clamped to integers
-        std::pair<KeyFrameSet::iterator, bool> newKey = _imp->keyFrames.insert(cp);
-        // keyframe at this time exists, erase and insert again
-        bool addedKey = true;
-        if (!newKey.second) {
-            _imp->keyFrames.erase(newKey.first);
-            newKey = _imp->keyFrames.insert(cp);
-            assert(newKey.second);
-            addedKey = false;
-        }
-
-        return std::make_pair(newKey.first, addedKey);
+        // keyframe at this time exists, replace it
+        return _imp->insertOrReplaceKeyFrame(cp);
     } else {
         bool addedKey = true;
         double paramEps = NATRON_CURVE_X_SPACING_EPSILON;
         for (KeyFrameSet::iterator it = _imp->keyFrames.begin(); it != _imp->keyFrames.end(); ++it) {
             if (std::abs( it->getTime() - cp.getTime() ) < paramEps) {
-                _imp->keyFrames.erase(it);
+                _imp->eraseKeyFrame(it);
                 addedKey = false;
                 break;
             }
         }
-        std::pair<KeyFrameSet::iterator, bool> newKey = _imp->keyFrames.insert(cp);
+        std::pair<KeyFrameSet::iterator, bool> newKey = _imp->insertKeyFrame(cp);
         newKey.second = addedKey;
 
         return newKey;
@@ -554,7 +552,7 @@ Curve::removeKeyFrame(KeyFrameSet::const_iterator it)
                            nextKey.getInterpolation() != eKeyframeTypeNone);
     }
 
-    _imp->keyFrames.erase(it);
+    _imp->eraseKeyFrame(it);
 
     if (mustRefreshPrev) {
         refreshDerivatives( eCurveChangedReasonDerivativesChanged, find( prevKey.getTime(), _imp->keyFrames.end()) );
@@ -605,7 +603,7 @@ Curve::removeKeyFramesBeforeTime(TimeValue time,
         }
         newSet.insert(*it);
     }
-    _imp->keyFrames = newSet;
+    _imp->setKeyFrames(newSet);
     if ( !_imp->keyFrames.empty() ) {
         refreshDerivatives( Curve::eCurveChangedReasonKeyframeChanged, _imp->keyFrames.begin() );
     }
@@ -628,7 +626,7 @@ Curve::removeKeyFramesAfterTime(TimeValue time,
         }
         newSet.insert(*it);
     }
-    _imp->keyFrames = newSet;
+    _imp->setKeyFrames(newSet);
     if ( !_imp->keyFrames.empty() ) {
         KeyFrameSet::iterator last = _imp->keyFrames.end();
         --last;
@@ -642,11 +640,11 @@ Curve::getKeyFrameWithIndex(int index,
                             KeyFrame* k) const
 {
     assert(k);
-    QMutexLocker l(&_imp->_lock);
-    if ( (index < 0) || ( (int)_imp->keyFrames.size() <= index ) ) {
+    CurveSnapshotPtr snapshot = _imp->getSnapshot();
+    if ( (index < 0) || ( (int)snapshot->keyFrames.size() <= index ) ) {
         return false;
     }
-    *k = *atIndex(index);
+    *k = snapshot->keyFrames[index];
 
     return true;
 }
@@ -656,21 +654,22 @@ Curve::getNearestKeyFrameWithTime(TimeValue time,
                                   KeyFrame* k) const
 {
     assert(k);
-    QMutexLocker l(&_imp->_lock);
-    if ( _imp->keyFrames.empty() ) {
+    CurveSnapshotPtr snapshot = _imp->getSnapshot();
+    const KeyFrameVector& keyFrames = snapshot->keyFrames;
+    if ( keyFrames.empty() ) {
         return false;
     }
-    if (_imp->keyFrames.size() == 1) {
-        *k = *_imp->keyFrames.begin();
+    if (keyFrames.size() == 1) {
+        *k = keyFrames.front();
 
         return true;
     }
 
     KeyFrame kt(time, 0.); // virtual keyframe at t for comparison
-    KeyFrameSet::const_iterator lower = _imp->keyFrames.lower_bound(kt);
-    if ( lower == _imp->keyFrames.end() ) {
+    KeyFrameVector::const_iterator lower = std::lower_bound( keyFrames.begin(), keyFrames.end(), kt, KeyFrame_compare_time() );
+    if ( lower == keyFrames.end() ) {
         // all elements are before, take the last one
-        *k = *_imp->keyFrames.rbegin();
+        *k = keyFrames.back();
 
         return true;
     }
@@ -680,8 +679,8 @@ Curve::getNearestKeyFrameWithTime(TimeValue time,
 
         return true;
     }
-    KeyFrameSet::const_iterator upper = _imp->keyFrames.upper_bound(kt);
-    if ( upper == _imp->keyFrames.end() ) {
+    KeyFrameVector::const_iterator upper = std::upper_bound( keyFrames.begin(), keyFrames.end(), kt, KeyFrame_compare_time() );
+    if ( upper == keyFrames.end() ) {
         // no element after this one, return the lower bound
         *k = *lower;
 
@@ -706,41 +705,19 @@ Curve::getPreviousKeyframeTime(TimeValue time,
                                KeyFrame* k) const
 {
     assert(k);
-    QMutexLocker l(&_imp->_lock);
-    if ( _imp->keyFrames.empty() ) {
-        return false;
-    }
-    KeyFrameSet::const_iterator upper = _imp->keyFrames.end();
-    for (KeyFrameSet::const_iterator it = _imp->keyFrames.begin(); it != _imp->keyFrames.end(); ++it) {
-        if (it->getTime() > time) {
-            upper = it;
-            break;
-        } else if (it->getTime() == time) {
-            if ( it == _imp->keyFrames.begin() ) {
-                return false;
-            } else {
-                --it;
-                *k = *it;
-
-                return true;
-            }
-        }
-    }
-    if ( upper == _imp->keyFrames.end() ) {
-        *k = *_imp->keyFrames.rbegin();
+    CurveSnapshotPtr snapshot = _imp->getSnapshot();
+    const KeyFrameVector& keyFrames = snapshot->keyFrames;
 
-        return true;
-    } else if ( upper == _imp->keyFrames.begin() ) {
+    // the last keyframe with a time strictly lower than the given time
+    KeyFrameVector::const_iterator lower = std::lower_bound( keyFrames.begin(), keyFrames.end(), KeyFrame(time, 0.), KeyFrame_compare_time() );
+    if ( lower == keyFrames.begin() ) {
         return false;
-    } else {
-        ///If we reach here the previous keyframe is exactly the previous to upper because we already checked
-        ///in the for loop that the previous key wasn't equal to the given time
-        --upper;
-        assert(upper->getTime() < time);
-        *k = *upper;
-
-        return true;
     }
+    --lower;
+    assert(lower->getTime() < time);
+    *k = *lower;
+
+    return true;
 }
 
 bool
@@ -748,48 +725,31 @@ Curve::getNextKeyframeTime(TimeValue time,
                            KeyFrame* k) const
 {
     assert(k);
-    QMutexLocker l(&_imp->_lock);
-    if ( _imp->keyFrames.empty() ) {
+    CurveSnapshotPtr snapshot = _imp->getSnapshot();
+    const KeyFrameVector& keyFrames = snapshot->keyFrames;
+
+    // the first keyframe with a time strictly greater than the given time
+    KeyFrameVector::const_iterator upper = std::upper_bound( keyFrames.begin(), keyFrames.end(), KeyFrame(time, 0.), KeyFrame_compare_time() );
+    if ( upper == keyFrames.end() ) {
         return false;
     }
-    KeyFrameSet::const_iterator upper = _imp->keyFrames.end();
-    for (KeyFrameSet::const_iterator it = _imp->keyFrames.begin(); it != _imp->keyFrames.end(); ++it) {
-        if (it->getTime() > time) {
-            upper = it;
-            break;
-        }
-    }
-    if ( upper == _imp->keyFrames.end() ) {
-        return false;
-    } else {
-        *k = *upper;
+    *k = *upper;
 
-        return true;
-    }
+    return true;
 }
 
 int
 Curve::getNKeyFramesInRange(double first,
                             double last) const
 {
-    int ret = 0;
-    QMutexLocker k(&_imp->_lock);
-    KeyFrameSet::const_iterator upper = _imp->keyFrames.end();
+    CurveSnapshotPtr snapshot = _imp->getSnapshot();
+    const KeyFrameVector& keyFrames = snapshot->keyFrames;
 
-    for (KeyFrameSet::const_iterator it = _imp->keyFrames.begin(); it != _imp->keyFrames.end(); ++it) {
-        if (it->getTime() >= first) {
-            upper = it;
-            break;
-        }
-    }
-    for (; upper != _imp->keyFrames.end(); ++upper) {
-        if (upper->getTime() >= last) {
-            break;
-        }
-        ++ret;
-    }
+    // keyframes in [first, last)
+    KeyFrameVector::const_iterator lower = std::lower_bound( keyFrames.begin(), keyFrames.end(), KeyFrame(first, 0.), KeyFrame_compare_time() );
+    KeyFrameVector::const_iterator upper = std::lower_bound( lower, keyFrames.end(), KeyFrame(last, 0.), KeyFrame_compare_time() );
 
-    return ret;
+    return (int)std::distance(lower, upper);
 }
 
 bool
@@ -797,10 +757,11 @@ Curve::getKeyFrameWithTime(TimeValue time,
                            KeyFrame* k) const
 {
     assert(k);
-    QMutexLocker l(&_imp->_lock);
-    KeyFrameSet::const_iterator it = find(time, _imp->keyFrames.end());
+    CurveSnapshotPtr snapshot = _imp->getSnapshot();
+    const KeyFrameVector& keyFrames = snapshot->keyFrames;
+    KeyFrameVector::const_iterator it = std::lower_bound( keyFrames.begin(), keyFrames.end(), KeyFrame(time, 0.), KeyFrame_compare_time() );
 
-    if ( it == _imp->keyFrames.end() ) {
+    if ( ( it == keyFrames.end() ) || (it->getTime() != time) ) {
         return false;
     }
 
@@ -812,12 +773,12 @@ Curve::getKeyFrameWithTime(TimeValue time,
 /// compute interpolation parameters from keyframes and an iterator
 /// to the next keyframe (the first with time > t)
 static void
-interParams(const KeyFrameSet &keyFrames,
+interParams(const KeyFrameVector &keyFrames,
             bool isPeriodic,
             double xMin,
             double xMax,
             TimeValue *t,
-            KeyFrameSet::const_iterator itup,
+            KeyFrameVector::const_iterator itup,
             TimeValue *tcur,
             double *vcur,
             double *vcurDerivRight,
@@ -843,7 +804,7 @@ interParams(const KeyFrameSet &keyFrames,
             }
             assert(*t >= minKeyFrameX && *t <= minKeyFrameX + period);
         }
-        itup = keyFrames.upper_bound(KeyFrame(*t, 0.));
+        itup = std::upper_bound( keyFrames.begin(), keyFrames.end(), KeyFrame(*t, 0.), KeyFrame_compare_time() );
     }
     if ( itup == keyFrames.begin() ) {
         // We are in the case where all keys have a greater time
@@ -853,7 +814,7 @@ interParams(const KeyFrameSet &keyFrames,
             *vnext = itup->getValue();
             *vnextDerivLeft = itup->getLeftDerivative();
             *interpNext = itup->getInterpolation();
-            KeyFrameSet::const_reverse_iterator last =  keyFrames.rbegin();
+            KeyFrameVector::const_reverse_iterator last =  keyFrames.rbegin();
             *tcur = TimeValue(last->getTime() - period);
             *vcur = last->getValue();
             *vcurDerivRight = last->getRightDerivative();
@@ -874,8 +835,8 @@ interParams(const KeyFrameSet &keyFrames,
         // We are in the case where no key has a greater time
         // If periodic, we are in-between the last keyframe and xMax
         if (isPeriodic) {
-            KeyFrameSet::const_iterator next = keyFrames.begin();
-            KeyFrameSet::const_reverse_iterator prev = keyFrames.rbegin();
+            KeyFrameVector::const_iterator next = keyFrames.begin();
+            KeyFrameVector::const_reverse_iterator prev = keyFrames.rbegin();
             *tcur = prev->getTime();
             *vcur = prev->getValue();
             *vcurDerivRight = prev->getRightDerivative();
@@ -886,7 +847,7 @@ interParams(const KeyFrameSet &keyFrames,
             *interpNext = next->getInterpolation();
         } else {
 
-            KeyFrameSet::const_reverse_iterator itlast = keyFrames.rbegin();
+            KeyFrameVector::const_reverse_iterator itlast = keyFrames.rbegin();
             *tcur = itlast->getTime();
             *vcur = itlast->getValue();
             *vcurDerivRight = itlast->getRightDerivative();
@@ -900,7 +861,7 @@ interParams(const KeyFrameSet &keyFrames,
     } else {
         // between two keyframes
         // get the last keyframe with time <= t
-        KeyFrameSet::const_iterator itcur = itup;
+        KeyFrameVector::const_iterator itcur = itup;
         --itcur;
         assert(itcur->getTime() <= *t);
         *tcur = itcur->getTime();
@@ -914,13 +875,19 @@ interParams(const KeyFrameSet &keyFrames,
     }
 }
 
-double
-Curve::getValueAt(TimeValue t,
-                  bool doClamp) const
+/// evaluate the curve snapshot at t, searching the next keyframe from searchStart.
+/// The iterator to the next keyframe is returned in itupOut so that it can be used as the
+/// search start of a greater time.
+static double
+getSnapshotValueAt(const CurveSnapshot& snapshot,
+                   TimeValue t,
+                   bool doClamp,
+                   KeyFrameVector::const_iterator searchStart,
+                   KeyFrameVector::const_iterator* itupOut)
 {
-    QMutexLocker l(&_imp->_lock);
+    const KeyFrameVector& keyFrames = snapshot.keyFrames;
 
-    if ( _imp->keyFrames.empty() ) {
+    if ( keyFrames.empty() ) {
         //throw std::runtime_error("Curve has no control points!");
 
         // A curve with no control points is considered to be 0
@@ -928,62 +895,48 @@ Curve::getValueAt(TimeValue t,
         return 0.;
 
         // There is no special case for a curve with one (1) keyframe: the result is a linear curve before and after the keyframe.
-    //} else if (_imp->keyFrames.size() == 1) {
-    //    return _imp->keyFrames.begin()->getValue();
     }
 
-    double v;
-#ifdef NATRON_CURVE_USE_CACHE
-    std::map<double, double>::const_iterator foundCached = _imp->resultCache.find(t);
-    if ( foundCached != _imp->resultCache.end() ) {
-        v = foundCached->second;
-    } else
-#endif
-    {
-        // even when there is only one keyframe, there may be tangents!
-        //if (_imp->keyFrames.size() == 1) {
-        //    //if there's only 1 keyframe, don't bother interpolating
-        //    return (*_imp->keyFrames.begin()).getValue();
-        //}
-        TimeValue tcur, tnext;
-        double vcurDerivRight, vnextDerivLeft, vcur, vnext;
-        KeyframeTypeEnum interp, interpNext;
-        KeyFrame k(t, 0.);
-        // find the first keyframe with time greater than t
-        KeyFrameSet::const_iterator itup;
-        itup = _imp->keyFrames.upper_bound(k);
-        interParams(_imp->keyFrames,
-                    _imp->isPeriodic,
-                    _imp->xMin,
-                    _imp->xMax,
-                    &t,
-                    itup,
-                    &tcur,
-                    &vcur,
-                    &vcurDerivRight,
-                    &interp,
-                    &tnext,
-                    &vnext,
-                    &vnextDerivLeft,
-                    &interpNext);
+    // even when there is only one keyframe, there may be tangents!
+    TimeValue tcur, tnext;
+    double vcurDerivRight, vnextDerivLeft, vcur, vnext;
+    KeyframeTypeEnum interp, interpNext;
+    // find the first keyframe with time greater than t
+    KeyFrameVector::const_iterator itup = std::upper_bound( searchStart, keyFrames.end(), KeyFrame(t, 0.), KeyFrame_compare_time() );
+    *itupOut = itup;
+    interParams(keyFrames,
+                snapshot.isPeriodic,
+                snapshot.xMin,
+                snapshot.xMax,
+                &t,
+                itup,
+                &tcur,
+                &vcur,
+                &vcurDerivRight,
+                &interp,
+                &tnext,
+                &vnext,
+                &vnextDerivLeft,
+                &interpNext);
 
-        v = Interpolation::interpolate(tcur, vcur,
-                                       vcurDerivRight,
-                                       vnextDerivLeft,
-                                       tnext, vnext,
-                                       t,
-                                       interp,
-                                       interpNext);
-#ifdef NATRON_CURVE_USE_CACHE
-        _imp->resultCache[t] = v;
-#endif
-    }
+    double v = Interpolation::interpolate(tcur, vcur,
+                                          vcurDerivRight,
+                                          vnextDerivLeft,
+                                          tnext, vnext,
+                                          t,
+                                          interp,
+                                          interpNext);
 
     if ( doClamp ) {
-        v = clampValueToCurveYRange(v);
+        // clamp to min/max if the owner of the curve is a Double or Int knob.
+        if (v > snapshot.yMax) {
+            v = snapshot.yMax;
+        } else if (v < snapshot.yMin) {
+            v = snapshot.yMin;
+        }
     }
 
-    switch (_imp->type) {
+    switch (snapshot.type) {
     case Curve::eCurveTypeString:
     case Curve::eCurveTypeInt:
 
@@ -995,34 +948,69 @@ Curve::getValueAt(TimeValue t,
 
         return v;
     }
+} // getSnapshotValueAt
+
+double
+Curve::getValueAt(TimeValue t,
+                  bool doClamp) const
+{
+    // Does not lock: the snapshot is immutable
+    CurveSnapshotPtr snapshot = _imp->getSnapshot();
+    KeyFrameVector::const_iterator itup;
+
+    return getSnapshotValueAt(*snapshot, t, doClamp, snapshot->keyFrames.begin(), &itup);
 } // getValueAt
 
+void
+Curve::getValuesAt(const TimeValue* times,
+                   double* values,
+                   int count,
+                   bool doClamp) const
+{
+    if (count <= 0) {
+        return;
+    }
+    assert(times && values);
+
+    // All values are computed from the same snapshot, even if the curve is modified concurrently
+    CurveSnapshotPtr snapshot = _imp->getSnapshot();
+    const KeyFrameVector& keyFrames = snapshot->keyFrames;
+
+    // When times are increasing, which is the common case, the search for the next keyframe
+    // starts from the one found for the previous time
+    KeyFrameVector::const_iterator itup = keyFrames.begin();
+    for (int i = 0; i < count; ++i) {
+        KeyFrameVector::const_iterator searchStart = keyFrames.begin();
+        if ( (i > 0) && !snapshot->isPeriodic && (times[i] >= times[i - 1]) ) {
+            searchStart = itup;
+        }
+        values[i] = getSnapshotValueAt(*snapshot, times[i], doClamp, searchStart, &itup);
+    }
+} // getValuesAt
+
 double
 Curve::getDerivativeAt(TimeValue t) const
 {
-    QMutexLocker l(&_imp->_lock);
+    CurveSnapshotPtr snapshot = _imp->getSnapshot();
+    const KeyFrameVector& keyFrames = snapshot->keyFrames;
 
-    if ( _imp->keyFrames.empty() ) {
+    if ( keyFrames.empty() ) {
         throw std::runtime_error("Curve has no control points!");
     }
-    assert(_imp->type == Curve::eCurveTypeDouble); // only real-valued curves can be derived
+    assert(snapshot->type == Curve::eCurveTypeDouble); // only real-valued curves can be derived
 
     // even when there is only one keyframe, there may be tangents!
-    //if (_imp->keyFrames.size() == 1) {
-    //    //if there's only 1 keyframe, don't bother interpolating
-    //    return (*_imp->keyFrames.begin()).getValue();
-    //}
     TimeValue tcur, tnext;
     double vcurDerivRight, vnextDerivLeft, vcur, vnext;
     KeyframeTypeEnum interp, interpNext;
     KeyFrame k(t, 0.);
     // find the first keyframe with time greater than t
-    KeyFrameSet::const_iterator itup;
-    itup = _imp->keyFrames.upper_bound(k);
-    interParams(_imp->keyFrames,
-                _imp->isPeriodic,
-                _imp->xMin,
-                _imp->xMax,
+    KeyFrameVector::const_iterator itup;
+    itup = std::upper_bound( keyFrames.begin(), keyFrames.end(), k, KeyFrame_compare_time() );
+    interParams(keyFrames,
+                snapshot->isPeriodic,
+                snapshot->xMin,
+                snapshot->xMax,
                 &t,
                 itup,
                 &tcur,
@@ -1036,13 +1024,13 @@ Curve::getDerivativeAt(TimeValue t) const
 
     double d;
 
-    if ( _imp->yMin != -std::numeric_limits<double>::infinity() || _imp->yMax != std::numeric_limits<double>::infinity()) {
+    if ( snapshot->yMin != -std::numeric_limits<double>::infinity() || snapshot->yMax != std::numeric_limits<double>::infinity()) {
         d = Interpolation::derive_clamp(tcur, vcur,
                                         vcurDerivRight,
                                         vnextDerivLeft,
                                         tnext, vnext,
                                         t,
-                                        _imp->yMin, _imp->yMax,
+                                        snapshot->yMin, snapshot->yMax,
                                         interp,
                                         interpNext);
     } else {
@@ -1062,7 +1050,8 @@ double
 Curve::getIntegrateFromTo(TimeValue t1,
                           TimeValue t2) const
 {
-    QMutexLocker l(&_imp->_lock);
+    CurveSnapshotPtr snapshot = _imp->getSnapshot();
+    const KeyFrameVector& keyFrames = snapshot->keyFrames;
     bool opposite = false;
 
     // the following assumes that t2 > t1. If it's not the case, swap them and return the opposite.
@@ -1071,27 +1060,23 @@ Curve::getIntegrateFromTo(TimeValue t1,
         std::swap(t1, t2);
     }
 
-    if ( _imp->keyFrames.empty() ) {
+    if ( keyFrames.empty() ) {
         throw std::runtime_error("Curve has no control points!");
     }
-    assert(_imp->type == Curve::eCurveTypeDouble); // only real-valued curves can be derived
+    assert(snapshot->type == Curve::eCurveTypeDouble); // only real-valued curves can be derived
 
     // even when there is only one keyframe, there may be tangents!
-    //if (_imp->keyFrames.size() == 1) {
-    //    //if there's only 1 keyframe, don't bother interpolating
-    //    return (*_imp->keyFrames.begin()).getValue();
-    //}
     TimeValue tcur, tnext;
     double vcurDerivRight, vnextDerivLeft, vcur, vnext;
     KeyframeTypeEnum interp, interpNext;
     KeyFrame k(t1, 0.);
     // find the first keyframe with time strictly greater than t1
-    KeyFrameSet::const_iterator itup;
-    itup = _imp->keyFrames.upper_bound(k);
-    interParams(_imp->keyFrames,
-                _imp->isPeriodic,
-                _imp->xMin,
-                _imp->xMax,
+    KeyFrameVector::const_iterator itup;
+    itup = std::upper_bound( keyFrames.begin(), keyFrames.end(), k, KeyFrame_compare_time() );
+    interParams(keyFrames,
+                snapshot->isPeriodic,
+                snapshot->xMin,
+                snapshot->xMax,
                 &t1,
                 itup,
                 &tcur,
@@ -1104,17 +1089,18 @@ Curve::getIntegrateFromTo(TimeValue t1,
                 &interpNext);
 
     double sum = 0.;
+    const bool isClamped = snapshot->yMin != -std::numeric_limits<double>::infinity() || snapshot->yMax != std::numeric_limits<double>::infinity();
 
     // while there are still keyframes after the current time, add to the total sum and advance
-    while (itup != _imp->keyFrames.end() && itup->getTime() < t2) {
+    while (itup != keyFrames.end() && itup->getTime() < t2) {
         // add integral from t1 to itup->getTime() to sum
-        if ( _imp->yMin != -std::numeric_limits<double>::infinity() || _imp->yMax != std::numeric_limits<double>::infinity()) {
+        if (isClamped) {
             sum += Interpolation::integrate_clamp(tcur, vcur,
                                                   vcurDerivRight,
                                                   vnextDerivLeft,
                                                   tnext, vnext,
                                                   TimeValue(t1), itup->getTime(),
-                                                  _imp->yMin, _imp->yMax,
+                                                  snapshot->yMin, snapshot->yMax,
                                                   interp,
                                                   interpNext);
         } else {
@@ -1129,10 +1115,10 @@ Curve::getIntegrateFromTo(TimeValue t1,
         // advance
         t1 = itup->getTime();
         ++itup;
-        interParams(_imp->keyFrames,
-                    _imp->isPeriodic,
-                    _imp->xMin,
-                    _imp->xMax,
+        interParams(keyFrames,
+                    snapshot->isPeriodic,
+                    snapshot->xMin,
+                    snapshot->xMax,
                     &t1,
                     itup,
                     &tcur,
@@ -1145,15 +1131,15 @@ Curve::getIntegrateFromTo(TimeValue t1,
                     &interpNext);
     }
 
-    assert( itup == _imp->keyFrames.end() || t2 <= itup->getTime() );
+    assert( itup == keyFrames.end() || t2 <= itup->getTime() );
     // add integral from t1 to t2 to sum
-    if ( _imp->yMin != -std::numeric_limits<double>::infinity() || _imp->yMax != std::numeric_limits<double>::infinity()) {
+    if (isClamped) {
         sum += Interpolation::integrate_clamp(tcur, vcur,
                                               vcurDerivRight,
                                               vnextDerivLeft,
                                               tnext, vnext,
                                               TimeValue(t1), TimeValue(t2),
-                                              _imp->yMin, _imp->yMax,
+                                              snapshot->yMin, snapshot->yMax,
                                               interp,
                                               interpNext);
     } else {
@@ -1182,27 +1168,11 @@ Curve::YRange Curve::getCurveYRange() const
     return YRange(_imp->yMin, _imp->yMax);
 }
 
-double
-Curve::clampValueToCurveYRange(double v) const
-{
-    // PRIVATE - should not lock
-    ////clamp to min/max if the owner of the curve is a Double or Int knob.
-    if (v > _imp->yMax) {
-        return _imp->yMax;
-    } else if (v < _imp->yMin) {
-        return _imp->yMin;
-    }
-
-    return v;
-}
-
 bool
 Curve::isAnimated() const
 {
-    QMutexLocker l(&_imp->_lock);
-
     // even when there is only one keyframe, there may be tangents!
-    return _imp->keyFrames.size() > 0;
+    return !_imp->getSnapshot()->keyFrames.empty();
 }
 
 void
@@ -1213,6 +1183,7 @@ Curve::setXRange(double a,
 
     _imp->xMin = a;
     _imp->xMax = b;
+    onCurveChanged();
 }
 
 std::pair<double, double> Curve::getXRange() const
@@ -1225,9 +1196,7 @@ std::pair<double, double> Curve::getXRange() const
 int
 Curve::getKeyFramesCount() const
 {
-    QMutexLocker l(&_imp->_lock);
-
-    return (int)_imp->keyFrames.size();
+    return (int)_imp->getSnapshot()->keyFrames.size();
 }
 
 KeyFrameSet
@@ -1249,7 +1218,10 @@ Curve::setKeyFrameValueAndTimeNoUpdate(double value,
     // nothing special has to be done, since the derivatives are with respect to t
     newKey.setTime(time);
     newKey.setValue(value);
-    _imp->keyFrames.erase(k);
+    if (time != k->getTime()) {
+        _imp->eraseKeyFrame(k);
+    }
+    // Otherwise the keyframe is replaced in place
 
     return addKeyFrameNoUpdate(newKey).first;
 }
@@ -1450,7 +1422,7 @@ Curve::transformKeyframesValueAndTime(const std::list<double>& times,
     } // keysRemovedOut
     
     // Now move finalSet to the member keyframes
-    _imp->keyFrames.clear();
+    _imp->clearKeyFrames();
     for (KeyFrameSet::const_iterator it = finalSet.begin();
          it != finalSet.end();
          ++it) {
@@ -1464,6 +1436,8 @@ Curve::transformKeyframesValueAndTime(const std::list<double>& times,
         ret.first = evaluateCurveChanged(eCurveChangedReasonKeyframeChanged, ret.first);
         
     }
+    onCurveChanged();
+
     return true;
 } // transformKeyframesValueAndTime
 
@@ -1748,15 +1722,8 @@ Curve::refreshDerivatives(Curve::CurveChangedReasonEnum reason,
     newKey.setLeftDerivative(vcurDerivLeft);
     newKey.setRightDerivative(vcurDerivRight);
 
-    std::pair<KeyFrameSet::iterator, bool> newKeyIt = _imp->keyFrames.insert(newKey);
-
-    // keyframe at this time exists, erase and insert again
-    if (!newKeyIt.second) {
-        _imp->keyFrames.erase(newKeyIt.first);
-        newKeyIt = _imp->keyFrames.insert(newKey);
-        assert(newKeyIt.second);
-    }
-    key = newKeyIt.first;
+    // keyframe at this time exists, replace it
+    key = _imp->insertOrReplaceKeyFrame(newKey).first;
 
     if (reason != eCurveChangedReasonDerivativesChanged) {
         key = evaluateCurveChanged(eCurveChangedReasonDerivativesChanged, key);
@@ -1855,18 +1822,14 @@ Curve::atIndex(int index) const
 int
 Curve::keyFrameIndex(TimeValue time) const
 {
-    QMutexLocker l(&_imp->_lock);
-    int i = 0;
-    double paramEps;
-
-    paramEps = NATRON_CURVE_X_SPACING_EPSILON;
+    CurveSnapshotPtr snapshot = _imp->getSnapshot();
+    const KeyFrameVector& keyFrames = snapshot->keyFrames;
+    double paramEps = NATRON_CURVE_X_SPACING_EPSILON;
 
-    for (KeyFrameSet::const_iterator it = _imp->keyFrames.begin();
-         it != _imp->keyFrames.end() && (it->getTime() < time + paramEps);
-         ++it, ++i) {
-        if (std::abs(it->getTime() - time) < paramEps) {
-            return i;
-        }
+    // the first keyframe with a time strictly greater than time - paramEps
+    KeyFrameVector::const_iterator it = std::upper_bound( keyFrames.begin(), keyFrames.end(), KeyFrame(time - paramEps, 0.), KeyFrame_compare_time() );
+    if ( ( it != keyFrames.end() ) && (std::abs(it->getTime() - time) < paramEps) ) {
+        return (int)std::distance(keyFrames.begin(), it);
     }
 
     return -1;
@@ -1935,14 +1898,14 @@ Curve::setYRange(double yMin,
 
     _imp->yMin = yMin;
     _imp->yMax = yMax;
+    onCurveChanged();
 }
 
 void
 Curve::onCurveChanged()
 {
-#ifdef NATRON_CURVE_USE_CACHE
-    _imp->resultCache.clear();
-#endif
+    // PRIVATE - should not lock
+    _imp->publishSnapshot();
 }
 
 void
@@ -1953,7 +1916,7 @@ Curve::fromSerialization(const SERIALIZATION_NAMESPACE::SerializationObjectBase&
         return;
     }
     QMutexLocker l(&_imp->_lock);
-    _imp->keyFrames.clear();
+    _imp->clearKeyFrames();
     for (std::list<SERIALIZATION_NAMESPACE::KeyFrameSerialization>::const_iterator it = s->keys.begin(); it != s->keys.end(); ++it) {
         KeyFrame k;
         k.setTime(TimeValue(it->time));
@@ -2064,9 +2027,9 @@ void
 Curve::setKeyframesInternal(const KeyFrameSet& keys, bool refreshDerivatives)
 {
     if (!refreshDerivatives) {
-        _imp->keyFrames = keys;
+        _imp->setKeyFrames(keys);
     } else {
-        _imp->keyFrames.clear();
+        _imp->clearKeyFrames();
 
         // Now recompute auto tangents
         for (KeyFrameSet::iterator it = keys.begin(); it != keys.end(); ++it) {
@@ -131,6 +131,7 @@ struct KeyFrame_compare_time
 
 
 typedef std::set<KeyFrame, KeyFrame_compare_time> KeyFrameSet;
+typedef std::vector<KeyFrame> KeyFrameVector;
 
 
 struct CurvePrivate;
@@ -289,6 +290,13 @@ public:
      */
     double getValueAt(TimeValue t, bool clamp = true) const WARN_UNUSED_RETURN;
 
+    /**
+     * @brief Same as getValueAt for count times at once: values[i] is the value at times[i].
+     * All values are computed from the same state of the curve. This is faster than calling getValueAt
+     * for each time, in particular when the times are increasing.
+     **/
+    void getValuesAt(const TimeValue* times, double* values, int count, bool clamp = true) const;
+
     double getDerivativeAt(TimeValue t) const WARN_UNUSED_RETURN;
 
     double getIntegrateFromTo(TimeValue t1, TimeValue t2) const WARN_UNUSED_RETURN;
@@ -584,8 +592,6 @@ private:
 
     void removeKeyFrame(KeyFrameSet::const_iterator it);
 
-    double clampValueToCurveYRange(double v) const WARN_UNUSED_RETURN;
-
     void setKeyframesInternal(const KeyFrameSet& keys, bool refreshDerivatives);
 
     ///returns an iterator to the new keyframe in the keyframe set and
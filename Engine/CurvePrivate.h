@@ -27,6 +27,9 @@
 
 #include "Global/Macros.h"
 
+#include <vector>
+#include <algorithm>
+
 #if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
 #include <boost/shared_ptr.hpp>
 #endif
@@ -43,17 +46,40 @@
 
 NATRON_NAMESPACE_ENTER;
 
-//#define NATRON_CURVE_USE_CACHE
+/**
+ * @brief An immutable copy of the keyframes, stored contiguously, and of the parameters needed to evaluate the curve.
+ * It is shared by all readers so that they never have to take the curve lock: when the curve is modified
+ * the snapshot is patched along with the keyframes and published again. It is patched in place if no reader
+ * holds it anymore, otherwise a copy is patched and readers still holding the previous snapshot keep using it
+ * until they release it.
+ **/
+struct CurveSnapshot
+{
+    std::vector<KeyFrame> keyFrames;
+    Curve::CurveTypeEnum type;
+    double xMin, xMax;
+    double yMin, yMax;
+    bool isPeriodic;
+
+    CurveSnapshot()
+    : keyFrames()
+    , type(Curve::eCurveTypeDouble)
+    , xMin(0)
+    , xMax(0)
+    , yMin(0)
+    , yMax(0)
+    , isPeriodic(false)
+    {
+    }
+};
 
+typedef boost::shared_ptr<const CurveSnapshot> CurveSnapshotPtr;
 
 struct CurvePrivate
 {
+    // The keyframes being edited, protected by _lock
     KeyFrameSet keyFrames;
 
-#ifdef NATRON_CURVE_USE_CACHE
-    std::map<double, double> resultCache; //< a cache for interpolations
-#endif
-
     Curve::CurveTypeEnum type;
     double xMin, xMax;
     double yMin, yMax;
@@ -62,11 +88,16 @@ struct CurvePrivate
     bool isPeriodic;
     bool canMoveY;
 
+    // The snapshot of the curve used by readers. It must only be accessed with boost::atomic_load/atomic_store/atomic_exchange.
+    // It is NULL while a writer patches it, or if it must be built again from the keyframes.
+    mutable CurveSnapshotPtr snapshot;
+
+    // The snapshot taken back from the readers by a writer and patched along with keyFrames, protected by _lock.
+    // No reader holds it until it is published again.
+    mutable boost::shared_ptr<CurveSnapshot> editedSnapshot;
+
     CurvePrivate()
     : keyFrames()
-#ifdef NATRON_CURVE_USE_CACHE
-    , resultCache()
-#endif
     , type(Curve::eCurveTypeDouble)
     , xMin(-std::numeric_limits<double>::infinity())
     , xMax(std::numeric_limits<double>::infinity())
@@ -77,6 +108,8 @@ struct CurvePrivate
     , _lock(QMutex::Recursive)
     , isPeriodic(false)
     , canMoveY(true)
+    , snapshot()
+    , editedSnapshot()
     {
     }
 
@@ -98,9 +131,173 @@ struct CurvePrivate
         displayMax = other.displayMax;
         isPeriodic = other.isPeriodic;
         canMoveY = other.canMoveY;
+        editedSnapshot.reset();
+        boost::atomic_store( &snapshot, CurveSnapshotPtr() );
     }
 
-    
+    /**
+     * @brief Returns the current snapshot of the curve, building it if needed.
+     * This only takes the lock if the snapshot is being patched or was never built.
+     **/
+    CurveSnapshotPtr getSnapshot() const
+    {
+        CurveSnapshotPtr ret = boost::atomic_load(&snapshot);
+        if (ret) {
+            return ret;
+        }
+
+        QMutexLocker k(&_lock);
+        // Another thread may have built it while we were waiting for the lock
+        ret = boost::atomic_load(&snapshot);
+        if (ret) {
+            return ret;
+        }
+        if (!editedSnapshot) {
+            // Nothing to patch, build it from the keyframes
+            editedSnapshot.reset(new CurveSnapshot);
+            editedSnapshot->keyFrames.assign( keyFrames.begin(), keyFrames.end() );
+        }
+
+        return storeEditedSnapshot();
+    }
+
+    /**
+     * @brief Inserts a keyframe in keyFrames and in the edited snapshot. Must be called with _lock held.
+     **/
+    std::pair<KeyFrameSet::iterator, bool> insertKeyFrame(const KeyFrame& k)
+    {
+        std::pair<KeyFrameSet::iterator, bool> ret = keyFrames.insert(k);
+        if ( ret.second && editSnapshot() ) {
+            KeyFrameVector& keys = editedSnapshot->keyFrames;
+            keys.insert(std::lower_bound( keys.begin(), keys.end(), k, KeyFrame_compare_time() ), k);
+        }
+
+        return ret;
+    }
+
+    /**
+     * @brief Same as insertKeyFrame() but replaces the keyframe at the same time if any: it is then patched in place in
+     * the edited snapshot. Returns the keyframe and whether it was added. Must be called with _lock held.
+     **/
+    std::pair<KeyFrameSet::iterator, bool> insertOrReplaceKeyFrame(const KeyFrame& k)
+    {
+        std::pair<KeyFrameSet::iterator, bool> ret = keyFrames.insert(k);
+        if (!ret.second) {
+            // Keys of a std::set are immutable, insert it again at the same position
+            KeyFrameSet::iterator next = ret.first;
+            ++next;
+            keyFrames.erase(ret.first);
+            ret.first = keyFrames.insert(next, k);
+        }
+        if ( editSnapshot() ) {
+            KeyFrameVector& keys = editedSnapshot->keyFrames;
+            KeyFrameVector::iterator found = std::lower_bound( keys.begin(), keys.end(), k, KeyFrame_compare_time() );
+            if (ret.second) {
+                keys.insert(found, k);
+            } else {
+                assert( found != keys.end() && found->getTime() == k.getTime() );
+                *found = k;
+            }
+        }
+
+        return ret;
+    }
+
+    /**
+     * @brief Removes a keyframe from keyFrames and from the edited snapshot. Must be called with _lock held.
+     **/
+    void eraseKeyFrame(KeyFrameSet::const_iterator it)
+    {
+        if ( editSnapshot() ) {
+            KeyFrameVector& keys = editedSnapshot->keyFrames;
+            KeyFrameVector::iterator found = std::lower_bound( keys.begin(), keys.end(), *it, KeyFrame_compare_time() );
+            assert( found != keys.end() && found->getTime() == it->getTime() );
+            keys.erase(found);
+        }
+        keyFrames.erase(it);
+    }
+
+    /**
+     * @brief Replaces all keyframes in keyFrames and in the edited snapshot. Must be called with _lock held.
+     **/
+    void setKeyFrames(const KeyFrameSet& keys)
+    {
+        keyFrames = keys;
+        if ( editSnapshot() ) {
+            editedSnapshot->keyFrames.assign( keyFrames.begin(), keyFrames.end() );
+        }
+    }
+
+    void clearKeyFrames()
+    {
+        keyFrames.clear();
+        if ( editSnapshot() ) {
+            editedSnapshot->keyFrames.clear();
+        }
+    }
+
+    /**
+     * @brief Publishes the snapshot patched since the last call, with the current parameters.
+     * Must be called with _lock held after any modification of the keyframes or of the parameters in the snapshot.
+     **/
+    void publishSnapshot()
+    {
+        if (!editedSnapshot) {
+            CurveSnapshotPtr published = boost::atomic_load(&snapshot);
+            if ( !published || ( (published->type == type) && (published->xMin == xMin) && (published->xMax == xMax) &&
+                                 (published->yMin == yMin) && (published->yMax == yMax) && (published->isPeriodic == isPeriodic) ) ) {
+                // Either it is up to date or the next reader builds it
+                return;
+            }
+            if ( !editSnapshot() ) {
+                return;
+            }
+        }
+        (void)storeEditedSnapshot();
+    }
+
+private:
+
+    /**
+     * @brief Takes the snapshot back from the readers so that it can be patched, with _lock held.
+     * It is patched in place if no reader holds it anymore, otherwise a copy is patched.
+     * Returns false if there is no snapshot: the next reader builds it from the keyframes.
+     **/
+    bool editSnapshot()
+    {
+        if (editedSnapshot) {
+            return true;
+        }
+        CurveSnapshotPtr published = boost::atomic_exchange( &snapshot, CurveSnapshotPtr() );
+        if (!published) {
+            return false;
+        }
+        if ( published.unique() ) {
+            // Readers only get the snapshot with atomic_load which is serialized with the exchange above:
+            // no other thread can hold it now
+            editedSnapshot = boost::const_pointer_cast<CurveSnapshot>(published);
+        } else {
+            editedSnapshot.reset( new CurveSnapshot(*published) );
+        }
+
+        return true;
+    }
+
+    CurveSnapshotPtr storeEditedSnapshot() const
+    {
+        assert(editedSnapshot);
+        editedSnapshot->type = type;
+        editedSnapshot->xMin = xMin;
+        editedSnapshot->xMax = xMax;
+        editedSnapshot->yMin = yMin;
+        editedSnapshot->yMax = yMax;
+        editedSnapshot->isPeriodic = isPeriodic;
+        CurveSnapshotPtr ret = editedSnapshot;
+        editedSnapshot.reset();
+        boost::atomic_store(&snapshot, ret);
+
+        return ret;
+    }
 };
 
 NATRON_NAMESPACE_EXIT;
@@ -887,33 +887,46 @@ EffectInstance::getImagePlanes(const GetImageInArgs& inArgs, GetImageOutArgs* ou
             mustConvertImage = true;
         }
 
+        // True if only the layer of the image differs: its tiles may then be shared instead of copied
+        const bool onlyLayerDiffers = mustConvertImage &&
+                                      preferredStorage == storage &&
+                                      imageLayout == thisEffectSupportedImageLayout &&
+                                      thisBitDepth == it->second->getBitDepth();
+
         ImagePtr convertedImage = it->second;
         if (mustConvertImage) {
 
-            Image::InitStorageArgs initArgs;
-            {
-                initArgs.bounds = pixelRoI;
-                initArgs.proxyScale = it->second->getProxyScale();
-                initArgs.mipMapLevel = it->second->getMipMapLevel();
-                initArgs.layer = preferredLayer;
-                initArgs.bitdepth = thisBitDepth;
-                initArgs.bufferFormat = thisEffectSupportedImageLayout;
-                initArgs.storage = preferredStorage;
-                initArgs.renderArgs = inArgs.renderArgs;
-                initArgs.glContext = inArgs.renderArgs->getParentRender()->getGPUOpenGLContext();
-            }
-            
-            convertedImage = Image::create(initArgs);
-
             Image::CopyPixelsArgs copyArgs;
             {
-                copyArgs.roi = initArgs.bounds;
+                copyArgs.roi = pixelRoI;
                 copyArgs.conversionChannel = channelForMask;
                 copyArgs.srcColorspace = getApp()->getDefaultColorSpaceForBitDepth(it->second->getBitDepth());
                 copyArgs.dstColorspace = getApp()->getDefaultColorSpaceForBitDepth(thisBitDepth);
                 copyArgs.monoConversion = Image::eMonoToPackedConversionCopyToChannelAndFillOthers;
             }
-            convertedImage->copyPixels(*it->second, copyArgs);
+
+            convertedImage.reset();
+            if (onlyLayerDiffers) {
+                convertedImage = Image::createCopyOnWriteView(it->second, preferredLayer, copyArgs, inArgs.renderArgs);
+            }
+
+            if (!convertedImage) {
+                Image::InitStorageArgs initArgs;
+                {
+                    initArgs.bounds = pixelRoI;
+                    initArgs.proxyScale = it->second->getProxyScale();
+                    initArgs.mipMapLevel = it->second->getMipMapLevel();
+                    initArgs.layer = preferredLayer;
+                    initArgs.bitdepth = thisBitDepth;
+                    initArgs.bufferFormat = thisEffectSupportedImageLayout;
+                    initArgs.storage = preferredStorage;
+                    initArgs.renderArgs = inArgs.renderArgs;
+                    initArgs.glContext = inArgs.renderArgs->getParentRender()->getGPUOpenGLContext();
+                }
+
+                convertedImage = Image::create(initArgs);
+                convertedImage->copyPixels(*it->second, copyArgs);
+            }
 
         } // mustConvertImage
 
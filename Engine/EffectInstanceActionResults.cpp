@@ -135,6 +135,17 @@ GetRegionOfDefinitionResults::fromMemorySegment(ExternalSegmentType* segment, co
     CacheEntryBase::fromMemorySegment(segment, objectNamesPrefix, tileDataPtr);
 } // fromMemorySegment
 
+bool
+GetRegionOfDefinitionResults::copyFromProcessLocalEntry(const CacheEntryBase& other)
+{
+    const GetRegionOfDefinitionResults* otherResults = dynamic_cast<const GetRegionOfDefinitionResults*>(&other);
+    if (!otherResults) {
+        return false;
+    }
+    _rod = otherResults->_rod;
+    return true;
+} // copyFromProcessLocalEntry
+
 IsIdentityResults::IsIdentityResults()
 : CacheEntryBase(appPTR->getCache())
 , _data()
@@ -194,6 +205,17 @@ IsIdentityResults::fromMemorySegment(ExternalSegmentType* segment, const std::st
     CacheEntryBase::fromMemorySegment(segment, objectNamesPrefix, tileDataPtr);
 } // fromMemorySegment
 
+bool
+IsIdentityResults::copyFromProcessLocalEntry(const CacheEntryBase& other)
+{
+    const IsIdentityResults* otherResults = dynamic_cast<const IsIdentityResults*>(&other);
+    if (!otherResults) {
+        return false;
+    }
+    _data = otherResults->_data;
+    return true;
+} // copyFromProcessLocalEntry
+
 GetFramesNeededResults::GetFramesNeededResults()
 : CacheEntryBase(appPTR->getCache())
 , _framesNeeded()
@@ -312,6 +334,17 @@ GetFramesNeededResults::fromMemorySegment(ExternalSegmentType* segment, const st
     }
 } // fromMemorySegment
 
+bool
+GetFramesNeededResults::copyFromProcessLocalEntry(const CacheEntryBase& other)
+{
+    const GetFramesNeededResults* otherResults = dynamic_cast<const GetFramesNeededResults*>(&other);
+    if (!otherResults) {
+        return false;
+    }
+    _framesNeeded = otherResults->_framesNeeded;
+    return true;
+} // copyFromProcessLocalEntry
+
 
 
 GetFrameRangeResults::GetFrameRangeResults()
@@ -366,6 +399,17 @@ GetFrameRangeResults::fromMemorySegment(ExternalSegmentType* segment, const std:
     CacheEntryBase::fromMemorySegment(segment, objectNamesPrefix, tileDataPtr);
 } // fromMemorySegment
 
+bool
+GetFrameRangeResults::copyFromProcessLocalEntry(const CacheEntryBase& other)
+{
+    const GetFrameRangeResults* otherResults = dynamic_cast<const GetFrameRangeResults*>(&other);
+    if (!otherResults) {
+        return false;
+    }
+    _range = otherResults->_range;
+    return true;
+} // copyFromProcessLocalEntry
+
 
 
 GetTimeInvariantMetaDatasResults::GetTimeInvariantMetaDatasResults()
@@ -423,6 +467,33 @@ GetTimeInvariantMetaDatasResults::fromMemorySegment(ExternalSegmentType* segment
     CacheEntryBase::fromMemorySegment(segment, objectNamesPrefix, tileDataPtr);
 } // fromMemorySegment
 
+bool
+GetTimeInvariantMetaDatasResults::copyFromProcessLocalEntry(const CacheEntryBase& other)
+{
+    const GetTimeInvariantMetaDatasResults* otherResults = dynamic_cast<const GetTimeInvariantMetaDatasResults*>(&other);
+    if (!otherResults) {
+        return false;
+    }
+    // The cached meta-datas are shared by all threads: copy them to the meta-datas of this entry
+    assert(_metadatas && otherResults->_metadatas);
+    _metadatas->copyFrom(*otherResults->_metadatas);
+    return true;
+} // copyFromProcessLocalEntry
+
+CacheEntryBasePtr
+GetTimeInvariantMetaDatasResults::createProcessLocalEntry()
+{
+    // The caller keeps a pointer to the meta-datas of this entry and may modify them:
+    // the process-local cache keeps its own copy
+    GetTimeInvariantMetaDatasResultsPtr ret(new GetTimeInvariantMetaDatasResults());
+    ret->setKey( getKey() );
+    assert(_metadatas);
+    NodeMetadataPtr metadatas(new NodeMetadata);
+    metadatas->copyFrom(*_metadatas);
+    ret->setMetadatasResults(metadatas);
+    return ret;
+} // createProcessLocalEntry
+
 
 
 GetComponentsResults::GetComponentsResults()
@@ -653,5 +724,19 @@ GetComponentsResults::fromMemorySegment(ExternalSegmentType* segment, const std:
     CacheEntryBase::fromMemorySegment(segment, objectNamesPrefix, tileDataPtr);
 } // fromMemorySegment
 
+bool
+GetComponentsResults::copyFromProcessLocalEntry(const CacheEntryBase& other)
+{
+    const GetComponentsResults* otherResults = dynamic_cast<const GetComponentsResults*>(&other);
+    if (!otherResults) {
+        return false;
+    }
+    _neededInputLayers = otherResults->_neededInputLayers;
+    _producedLayers = otherResults->_producedLayers;
+    _passThroughPlanes = otherResults->_passThroughPlanes;
+    _data = otherResults->_data;
+    return true;
+} // copyFromProcessLocalEntry
+
 
 NATRON_NAMESPACE_EXIT;
@@ -148,6 +148,13 @@ public:
 
     virtual void fromMemorySegment(ExternalSegmentType* segment, const std::string& objectNamesPrefix, const void* tileDataPtr) OVERRIDE FINAL;
 
+    virtual bool isProcessLocalCacheable() const OVERRIDE FINAL
+    {
+        return true;
+    }
+
+    virtual bool copyFromProcessLocalEntry(const CacheEntryBase& other) OVERRIDE FINAL;
+
 
 private:
 
@@ -219,6 +226,13 @@ public:
 
     virtual void fromMemorySegment(ExternalSegmentType* segment, const std::string& objectNamesPrefix, const void* tileDataPtr) OVERRIDE FINAL;
 
+    virtual bool isProcessLocalCacheable() const OVERRIDE FINAL
+    {
+        return true;
+    }
+
+    virtual bool copyFromProcessLocalEntry(const CacheEntryBase& other) OVERRIDE FINAL;
+
 private:
 
     struct ShmData
@@ -296,6 +310,13 @@ public:
 
     virtual void fromMemorySegment(ExternalSegmentType* segment, const std::string& objectNamesPrefix, const void* tileDataPtr) OVERRIDE FINAL;
 
+    virtual bool isProcessLocalCacheable() const OVERRIDE FINAL
+    {
+        return true;
+    }
+
+    virtual bool copyFromProcessLocalEntry(const CacheEntryBase& other) OVERRIDE FINAL;
+
 private:
 
     FramesNeededMap _framesNeeded;
@@ -359,6 +380,13 @@ public:
 
     virtual void fromMemorySegment(ExternalSegmentType* segment, const std::string& objectNamesPrefix, const void* tileDataPtr) OVERRIDE FINAL;
 
+    virtual bool isProcessLocalCacheable() const OVERRIDE FINAL
+    {
+        return true;
+    }
+
+    virtual bool copyFromProcessLocalEntry(const CacheEntryBase& other) OVERRIDE FINAL;
+
 private:
 
     RangeD _range;
@@ -422,6 +450,15 @@ public:
 
     virtual void fromMemorySegment(ExternalSegmentType* segment, const std::string& objectNamesPrefix, const void* tileDataPtr) OVERRIDE FINAL;
 
+    virtual bool isProcessLocalCacheable() const OVERRIDE FINAL
+    {
+        return true;
+    }
+
+    virtual bool copyFromProcessLocalEntry(const CacheEntryBase& other) OVERRIDE FINAL;
+
+    virtual CacheEntryBasePtr createProcessLocalEntry() OVERRIDE FINAL;
+
 private:
 
     NodeMetadataPtr _metadatas;
@@ -503,6 +540,13 @@ public:
     virtual void toMemorySegment(ExternalSegmentType* segment, const std::string& objectNamesPrefix, ExternalSegmentTypeHandleList* objectPointers, void* tileDataPtr) const OVERRIDE FINAL;
 
     virtual void fromMemorySegment(ExternalSegmentType* segment, const std::string& objectNamesPrefix, const void* tileDataPtr) OVERRIDE FINAL;
+
+    virtual bool isProcessLocalCacheable() const OVERRIDE FINAL
+    {
+        return true;
+    }
+
+    virtual bool copyFromProcessLocalEntry(const CacheEntryBase& other) OVERRIDE FINAL;
     
 private:
 
@@ -2300,7 +2300,9 @@ EffectInstance::getDefaultMetadata(const TreeRenderNodeArgsPtr& render, NodeMeta
         if (input) {
             //Update deepest bitdepth and most components only if the infos are relevant, i.e: only if the clip is connected
             hasSetCompsAndDepth = true;
-            if ( getSizeOfForBitDepth(deepestBitDepth) < getSizeOfForBitDepth(rawDepth) ) {
+            // Half and short have the same size but half has a greater range
+            if ( ( getSizeOfForBitDepth(deepestBitDepth) < getSizeOfForBitDepth(rawDepth) ) ||
+                 ( (deepestBitDepth == eImageBitDepthShort) && (rawDepth == eImageBitDepthHalf) ) ) {
                 deepestBitDepth = rawDepth;
             }
 
@@ -383,7 +383,7 @@ static void setupGLForRender(const ImagePtr& image,
         assert(image->getBufferFormat() == eImageBufferLayoutRGBAPackedFullRect);
 
         Image::Tile tile;
-        bool ok = image->getTileAt(0, &tile);
+        bool ok = image->getTileAt(0, &tile, false /*readOnly*/);
         assert(ok);
         (void)ok;
         Image::CPUTileData tileData;
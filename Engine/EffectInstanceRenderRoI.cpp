@@ -361,21 +361,32 @@ EffectInstance::Implementation::handleIdentityEffect(const EffectInstance::Rende
             // We must convert the plane if needed to match the components
             assert(requestedComponents.size() == 1 && results->outputPlanes.size() == 1);
             ImagePtr toConvert = results->outputPlanes.begin()->second;
-            Image::InitStorageArgs initArgs;
-            initArgs.bounds = toConvert->getBounds();
-            initArgs.bitdepth = toConvert->getBitDepth();
-            initArgs.layer = requestedComponents.front();
-            initArgs.storage = toConvert->getStorageMode();
-            initArgs.bufferFormat = toConvert->getBufferFormat();
-            initArgs.renderArgs = args.renderArgs;
-            ImagePtr converted = Image::create(initArgs);
 
             Image::CopyPixelsArgs cpyArgs;
-            cpyArgs.roi = initArgs.bounds;
+            cpyArgs.roi = toConvert->getBounds();
             cpyArgs.monoConversion = Image::eMonoToPackedConversionCopyToChannelAndFillOthers;
             cpyArgs.alphaHandling = Image::eAlphaChannelHandlingFillFromChannel;
             cpyArgs.conversionChannel = 3;
-            converted->copyPixels(*toConvert, cpyArgs);
+
+            ImagePtr converted;
+            if (toConvert->getLayer() == requestedComponents.front()) {
+                // Nothing to convert
+                converted = toConvert;
+            } else {
+                // Share the tiles of the upstream image: they are only copied if written to
+                converted = Image::createCopyOnWriteView(toConvert, requestedComponents.front(), cpyArgs, args.renderArgs);
+            }
+            if (!converted) {
+                Image::InitStorageArgs initArgs;
+                initArgs.bounds = toConvert->getBounds();
+                initArgs.bitdepth = toConvert->getBitDepth();
+                initArgs.layer = requestedComponents.front();
+                initArgs.storage = toConvert->getStorageMode();
+                initArgs.bufferFormat = toConvert->getBufferFormat();
+                initArgs.renderArgs = args.renderArgs;
+                converted = Image::create(initArgs);
+                converted->copyPixels(*toConvert, cpyArgs);
+            }
 
             // Insert in the output planes the converted image
             results->outputPlanes.clear();
@@ -751,6 +762,8 @@ EffectInstance::Implementation::checkPlanesToRenderAndComputeRectanglesToRender(
                 }
                 tmpImgInitArgs.bitdepth = outputBitDepth;
                 tmpImgInitArgs.layer = it->first;
+                // Tiles outside of what the plug-in renders are only filled: don't allocate them
+                tmpImgInitArgs.sparse = true;
 
             }
             it->second.tmpImage = Image::create(tmpImgInitArgs);
@@ -880,6 +893,8 @@ EffectInstance::Implementation::fetchOrCreateOutputPlanes(const RenderRoIArgs &
             initArgs.bufferFormat = cacheBufferLayout;
             initArgs.bitdepth = outputBitDepth;
             initArgs.layer = *it;
+            // Only the tiles that are written to are allocated, this is ignored if the layout is not mono-channel tiled
+            initArgs.sparse = true;
         }
         
         PlaneToRender &plane = planesToRender->planes[*it];
@@ -1237,7 +1252,7 @@ EffectInstance::renderRoI(const RenderRoIArgs & args, RenderRoIResults* results)
         if (cacheAccess != eCacheAccessModeNone) {
             ImageBitDepthEnum outputBitDepth = getBitDepth(args.renderArgs, -1);
             int tileWidth, tileHeight;
-            Cache::getTileSizePx(outputBitDepth, &tileWidth, &tileHeight);
+            appPTR->getCache()->getTileSizePx(outputBitDepth, &tileWidth, &tileHeight);
 
             RectI tiledRoundedRoI = renderMappedRoI;
 
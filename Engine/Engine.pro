@@ -84,6 +84,9 @@ SOURCES += \
     Cache.cpp \
     CacheEntryBase.cpp \
     CacheEntryKeyBase.cpp \
+    CacheMemoryGovernor.cpp \
+    CacheStats.cpp \
+    CacheTileCodec.cpp \
     CLArgs.cpp \
     CoonsRegularization.cpp \
     ColorParser.cpp \
@@ -103,6 +106,7 @@ SOURCES += \
     FileDownloader.cpp \
     FileSystemModel.cpp \
     FitCurve.cpp \
+    ForkJoinPool.cpp \
     Format.cpp \
     FStreamsSupport.cpp \
     GenericSchedulerThread.cpp \
@@ -116,6 +120,7 @@ SOURCES += \
     HostOverlaySupport.cpp \
     Image.cpp \
     ImageConvert.cpp \
+    ImageConvertSIMD.cpp \
     ImagePlaneDesc.cpp  \
     ImageCopyChannels.cpp \
     ImageFill.cpp \
@@ -133,6 +138,7 @@ SOURCES += \
     KnobTypes.cpp \
     KnobItemsTable.cpp \
     KnobItemsTableUndoCommand.cpp \
+    KnobNativeExpression.cpp \
     LibraryBinary.cpp \
     Log.cpp \
     Lut.cpp \
@@ -175,6 +181,7 @@ SOURCES += \
     PluginMemory.cpp \
     PrecompNode.cpp \
     ProcessHandler.cpp \
+    ProcessLocalCache.cpp \
     Project.cpp \
     ProjectPrivate.cpp \
     PropertiesHolder.cpp \
@@ -188,6 +195,7 @@ SOURCES += \
     PyRoto.cpp \
     PySideCompat.cpp \
     PyTracker.cpp \
+    RAMBufferPool.cpp \
     ReadNode.cpp \
     RenderValuesCache.cpp \
     RectD.cpp \
@@ -316,6 +324,11 @@ HEADERS += \
     Cache.h \
     CacheEntryBase.h \
     CacheEntryKeyBase.h \
+    CacheEvictionPolicy.h \
+    CacheFreeTilesBitmap.h \
+    CacheMemoryGovernor.h \
+    CacheStats.h \
+    CacheTileCodec.h \
     CoonsRegularization.h \
     ChoiceOption.h \
     Color.h \
@@ -339,6 +352,7 @@ HEADERS += \
     FileDownloader.h \
     FileSystemModel.h \
     FitCurve.h \
+    ForkJoinPool.h \
     Format.h \
     FStreamsSupport.h \
     fstream_mingw.h \
@@ -348,11 +362,13 @@ HEADERS += \
     GPUContextPool.h \
     GroupInput.h \
     GroupOutput.h \
+    Half.h \
     HashableObject.h \
     Hash64.h \
     HistogramCPU.h \
     HostOverlaySupport.h \
     Image.h \
+    ImageConvertSIMD.h \
     ImagePrivate.h \
     ImagePlaneDesc.h \
     Interpolation.h \
@@ -371,6 +387,7 @@ HEADERS += \
     KnobTypes.h \
     KnobItemsTable.h \
     KnobItemsTableUndoCommand.h \
+    KnobNativeExpression.h \
     LibraryBinary.h \
     Log.h \
     LogEntry.h \
@@ -414,6 +431,7 @@ HEADERS += \
     PluginMemory.h \
     PrecompNode.h \
     ProcessHandler.h \
+    ProcessLocalCache.h \
     Project.h \
     ProjectPrivate.h \
     PropertiesHolder.h \
@@ -428,6 +446,7 @@ HEADERS += \
     PyTracker.h \
     Pyside_Engine_Python.h \
     PyPanelI.h \
+    RAMBufferPool.h \
     RamBuffer.h \
     ReadNode.h \
     RectD.h \
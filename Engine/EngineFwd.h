@@ -188,6 +188,7 @@ class HostOverlayKnobsPosition;
 class HostOverlayKnobsTransform;
 class Image;
 class ImageTileKey;
+class ImageTileMipMapsKey;
 class ImagePlaneDesc;
 class IsIdentityKey;
 class IsIdentityResults;
@@ -210,6 +211,7 @@ class KnobHolder;
 class KnobI;
 class KnobInt;
 class KnobLayers;
+class KnobNativeExpression;
 class KnobPage;
 class KnobParametric;
 class KnobPath;
@@ -226,6 +228,7 @@ class LogEntry;
 class MemoryFile;
 class ImageStorageBase;
 class CacheImageTileStorage;
+class CacheImageTileMipMaps;
 class MultiThread;
 class NamedKnobHolder;
 class Node;
@@ -261,6 +264,7 @@ class ProcessInputChannel;
 class Project;
 class ProjectBeingLoadedInfo;
 class PyPanelI;
+class RAMBufferPool;
 class RAMImageStorage;
 class ReadNode;
 class RectD;
@@ -372,6 +376,7 @@ typedef boost::shared_ptr<IsIdentityKey> IsIdentityKeyPtr;
 typedef boost::shared_ptr<IsIdentityResults> IsIdentityResultsPtr;
 typedef boost::shared_ptr<const Image> ImageConstPtr;
 typedef boost::shared_ptr<ImageTileKey> ImageTileKeyPtr;
+typedef boost::shared_ptr<ImageTileMipMapsKey> ImageTileMipMapsKeyPtr;
 typedef boost::shared_ptr<JoinViewsNode> JoinViewsNodePtr;
 typedef boost::shared_ptr<KnobBool> KnobBoolPtr;
 typedef boost::shared_ptr<KnobButton> KnobButtonPtr;
@@ -389,6 +394,7 @@ typedef boost::shared_ptr<const KnobHolder> KnobHolderConstPtr;
 typedef boost::shared_ptr<KnobI> KnobIPtr;
 typedef boost::shared_ptr<KnobDimViewBase> KnobDimViewBasePtr;
 typedef boost::shared_ptr<KnobLayers> KnobLayersPtr;
+typedef boost::shared_ptr<KnobNativeExpression> KnobNativeExpressionPtr;
 typedef boost::shared_ptr<KnobI const> KnobIConstPtr;
 typedef boost::shared_ptr<KnobPath> KnobPathPtr;
 typedef boost::shared_ptr<KnobPage> KnobPagePtr;
@@ -407,6 +413,7 @@ typedef boost::shared_ptr<NamedKnobHolder> NamedKnobHolderPtr;
 typedef boost::shared_ptr<NoOpBase> NoOpBasePtr;
 typedef boost::shared_ptr<ImageStorageBase> ImageStorageBasePtr;
 typedef boost::shared_ptr<CacheImageTileStorage> CacheImageTileStoragePtr;
+typedef boost::shared_ptr<CacheImageTileMipMaps> CacheImageTileMipMapsPtr;
 typedef boost::shared_ptr<MemoryFile> MemoryFilePtr;
 typedef boost::shared_ptr<Node> NodePtr;
 typedef boost::shared_ptr<Node const> NodeConstPtr;
@@ -426,6 +433,7 @@ typedef boost::shared_ptr<Project> ProjectPtr;
 typedef boost::shared_ptr<Plugin> PluginPtr;
 typedef boost::shared_ptr<PluginGroupNode> PluginGroupNodePtr;
 typedef boost::shared_ptr<PluginMemory> PluginMemoryPtr;
+typedef boost::shared_ptr<RAMBufferPool> RAMBufferPoolPtr;
 typedef boost::shared_ptr<RAMImageStorage> RAMImageStoragePtr;
 typedef boost::shared_ptr<ReadNode> ReadNodePtr;
 typedef boost::shared_ptr<RenderEngine> RenderEnginePtr;
@@ -0,0 +1,382 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2017 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "ForkJoinPool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <list>
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+#include <QtCore/QWaitCondition>
+
+#include "Engine/ThreadPool.h"
+
+NATRON_NAMESPACE_ENTER;
+
+/**
+ * @brief The tasks of a call to run(). It lives on the stack of the caller.
+ **/
+struct ForkJoinJob
+{
+    ForkJoinPool::TaskFunction func;
+    unsigned int nTasks;
+    void* customArg;
+
+    // The index of the next task to take
+    QAtomicInt nextTask;
+
+    // The number of workers that took this job and may be running one of its tasks.
+    // The caller may only return once it is 0. Protected by the pool lock.
+    int nWorkers;
+
+    // Whether the caller waits for nWorkers to drop to 0. Protected by the pool lock.
+    bool callerWaiting;
+
+    // The list of jobs that may have tasks left. Protected by the pool lock.
+    ForkJoinJob* previous;
+    ForkJoinJob* next;
+    bool queued;
+
+    ForkJoinJob(ForkJoinPool::TaskFunction func,
+                unsigned int nTasks,
+                void* customArg)
+    : func(func)
+    , nTasks(nTasks)
+    , customArg(customArg)
+    , nextTask(0)
+    , nWorkers(0)
+    , callerWaiting(false)
+    , previous(0)
+    , next(0)
+    , queued(false)
+    {
+
+    }
+
+    /**
+     * @brief Runs the tasks of the job that nobody took yet
+     **/
+    void runTasks()
+    {
+        for (;;) {
+            const int task_i = nextTask.fetchAndAddRelaxed(1);
+            if ( task_i >= (int)nTasks ) {
+                return;
+            }
+            func(task_i, nTasks, customArg);
+        }
+    }
+
+    bool hasTasksLeft() const
+    {
+        return const_cast<QAtomicInt&>(nextTask).fetchAndAddRelaxed(0) < (int)nTasks;
+    }
+};
+
+class ForkJoinWorkerThread
+: public QThread
+, public AbortableThread
+{
+public:
+
+    ForkJoinWorkerThread(ForkJoinPoolPrivate* imp)
+    : QThread()
+    , AbortableThread(this)
+    , stopped(false)
+    , _imp(imp)
+    {
+        setThreadName("Multi-thread suite");
+    }
+
+    // Nested renders check this to run part of the work themselves instead of waiting for the global thread pool
+    virtual bool isThreadPoolThread() const OVERRIDE FINAL { return true; }
+
+    // Set when the worker returned because the pool shrank. Protected by the pool lock.
+    bool stopped;
+
+private:
+
+    virtual void run() OVERRIDE FINAL;
+
+    ForkJoinPoolPrivate* _imp;
+};
+
+struct ForkJoinPoolPrivate
+{
+    // Protects all the fields below and the fields of the jobs documented as such
+    QMutex lock;
+
+    // Wakes the workers when a job is queued or when the pool is destroyed
+    QWaitCondition workCond;
+
+    // Wakes the callers when the last worker of their job is done
+    QWaitCondition doneCond;
+
+    // The jobs that may have tasks left, the most recent first: nested jobs are taken before the job that spawned them,
+    // whose tasks are waiting for them.
+    ForkJoinJob* firstJob;
+
+    int nIdleWorkers;
+    bool mustQuit;
+
+    // The number of workers asked for, see setNumWorkers()
+    int nWorkers;
+
+    // The number of workers that must stop as soon as they are done with their current task, to shrink the pool
+    int nWorkersToStop;
+
+    // The running workers, and the ones that stopped but were not deleted yet
+    std::list<ForkJoinWorkerThread*> workers;
+
+    // The number of workers running a task. Read without the lock by getNumActiveWorkers()
+    QAtomicInt nActiveWorkers;
+
+    ForkJoinPoolPrivate()
+    : lock()
+    , workCond()
+    , doneCond()
+    , firstJob(0)
+    , nIdleWorkers(0)
+    , mustQuit(false)
+    , nWorkers(0)
+    , nWorkersToStop(0)
+    , workers()
+    , nActiveWorkers(0)
+    {
+
+    }
+
+    void queueJob(ForkJoinJob* job)
+    {
+        assert(!job->queued);
+        job->previous = 0;
+        job->next = firstJob;
+        if (firstJob) {
+            firstJob->previous = job;
+        }
+        firstJob = job;
+        job->queued = true;
+    }
+
+    void unqueueJob(ForkJoinJob* job)
+    {
+        if (!job->queued) {
+            return;
+        }
+        if (job->previous) {
+            job->previous->next = job->next;
+        } else {
+            firstJob = job->next;
+        }
+        if (job->next) {
+            job->next->previous = job->previous;
+        }
+        job->previous = job->next = 0;
+        job->queued = false;
+    }
+
+    /**
+     * @brief Returns the most recent job with tasks left, or NULL. Jobs without tasks left are removed from the queue.
+     * The job is counted in nWorkers: releaseJob() must be called once done with it.
+     * Must be called with the lock held.
+     **/
+    ForkJoinJob* takeJob()
+    {
+        while (firstJob) {
+            ForkJoinJob* job = firstJob;
+            if ( job->hasTasksLeft() ) {
+                ++job->nWorkers;
+                nActiveWorkers.fetchAndAddRelaxed(1);
+                return job;
+            }
+            unqueueJob(job);
+        }
+        return 0;
+    }
+
+    /**
+     * @brief Must be called with the lock held. The job must not be used afterwards: its caller may have returned.
+     **/
+    void releaseJob(ForkJoinJob* job)
+    {
+        assert(job->nWorkers > 0);
+        --job->nWorkers;
+        nActiveWorkers.fetchAndAddRelaxed(-1);
+        if ( (job->nWorkers == 0) && job->callerWaiting ) {
+            doneCond.wakeAll();
+        }
+    }
+
+    /**
+     * @brief Deletes the workers that stopped. Must be called with the lock held.
+     **/
+    void deleteStoppedWorkers()
+    {
+        for (std::list<ForkJoinWorkerThread*>::iterator it = workers.begin(); it != workers.end();) {
+            if ( !(*it)->stopped ) {
+                ++it;
+                continue;
+            }
+            // The worker released the lock for good: it is about to return from run()
+            (*it)->wait();
+            delete *it;
+            it = workers.erase(it);
+        }
+    }
+
+    void runWorker(ForkJoinWorkerThread* worker)
+    {
+        QMutexLocker k(&lock);
+        while (!mustQuit) {
+            if (nWorkersToStop > 0) {
+                --nWorkersToStop;
+                worker->stopped = true;
+                return;
+            }
+            ForkJoinJob* job = takeJob();
+            if (!job) {
+                ++nIdleWorkers;
+                workCond.wait(&lock);
+                --nIdleWorkers;
+                continue;
+            }
+            k.unlock();
+            job->runTasks();
+            k.relock();
+            releaseJob(job);
+        }
+    }
+};
+
+void
+ForkJoinWorkerThread::run()
+{
+    _imp->runWorker(this);
+}
+
+ForkJoinPool::ForkJoinPool(unsigned int nWorkers)
+: _imp( new ForkJoinPoolPrivate() )
+{
+    setNumWorkers(nWorkers);
+}
+
+ForkJoinPool::~ForkJoinPool()
+{
+    {
+        QMutexLocker k(&_imp->lock);
+        _imp->mustQuit = true;
+        _imp->workCond.wakeAll();
+    }
+    for (std::list<ForkJoinWorkerThread*>::iterator it = _imp->workers.begin(); it != _imp->workers.end(); ++it) {
+        (*it)->wait();
+        delete *it;
+    }
+}
+
+void
+ForkJoinPool::setNumWorkers(unsigned int nWorkers)
+{
+    QMutexLocker k(&_imp->lock);
+    _imp->deleteStoppedWorkers();
+
+    int nNewWorkers = (int)nWorkers - _imp->nWorkers;
+    _imp->nWorkers = (int)nWorkers;
+    if (nNewWorkers < 0) {
+        // Workers stop once done with their current task
+        _imp->nWorkersToStop -= nNewWorkers;
+        _imp->workCond.wakeAll();
+        return;
+    }
+
+    // Keep the workers that were asked to stop and did not yet
+    const int nKeptWorkers = std::min(nNewWorkers, _imp->nWorkersToStop);
+    _imp->nWorkersToStop -= nKeptWorkers;
+    nNewWorkers -= nKeptWorkers;
+    for (int i = 0; i < nNewWorkers; ++i) {
+        ForkJoinWorkerThread* worker = new ForkJoinWorkerThread( _imp.get() );
+        _imp->workers.push_back(worker);
+        worker->start();
+    }
+}
+
+unsigned int
+ForkJoinPool::getNumWorkers() const
+{
+    QMutexLocker k(&_imp->lock);
+    return (unsigned int)_imp->nWorkers;
+}
+
+unsigned int
+ForkJoinPool::getNumActiveWorkers() const
+{
+    return (unsigned int)std::max(0, _imp->nActiveWorkers.fetchAndAddRelaxed(0));
+}
+
+void
+ForkJoinPool::run(TaskFunction func,
+                  unsigned int nTasks,
+                  void* customArg)
+{
+    if (nTasks <= 1) {
+        for (unsigned int i = 0; i < nTasks; ++i) {
+            func(i, nTasks, customArg);
+        }
+        return;
+    }
+
+    ForkJoinJob job(func, nTasks, customArg);
+    {
+        QMutexLocker k(&_imp->lock);
+        if (_imp->nWorkers == 0) {
+            k.unlock();
+            job.runTasks();
+            return;
+        }
+        _imp->queueJob(&job);
+
+        // The calling thread takes one of the tasks
+        const int nWorkersWanted = std::min( _imp->nIdleWorkers, (int)nTasks - 1 );
+        for (int i = 0; i < nWorkersWanted; ++i) {
+            _imp->workCond.wakeOne();
+        }
+    }
+
+    // Help instead of waiting
+    job.runTasks();
+
+    // Wait for the workers still running a task of the job.
+    // The caller does not run the tasks of other jobs meanwhile: the OpenFX thread-local data of this thread
+    // is that of the action it is running, and running a task spawned by another thread would replace it.
+    QMutexLocker k(&_imp->lock);
+    _imp->unqueueJob(&job);
+    job.callerWaiting = true;
+    while (job.nWorkers > 0) {
+        _imp->doneCond.wait(&_imp->lock);
+    }
+} // run
+
+NATRON_NAMESPACE_EXIT;
@@ -0,0 +1,92 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2017 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef Engine_ForkJoinPool_h
+#define Engine_ForkJoinPool_h
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/scoped_ptr.hpp>
+#endif
+
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER;
+
+/**
+ * @brief A pool of threads dedicated to running the tasks of MultiThread::launchThreads.
+ * run() spreads the tasks of a call over the idle workers and the calling thread, and returns when all are done.
+ * The calling thread does not just wait: it runs the tasks that no worker took yet, so a call never waits for a worker
+ * to be available and calls may be nested (a task may call run() again) even if all workers are busy.
+ * A call does not allocate memory: the job lives on the stack of the caller and the workers
+ * take its tasks from a shared counter.
+ * The workers are AbortableThread for which isThreadPoolThread() returns true.
+ * This class is thread-safe.
+ **/
+struct ForkJoinPoolPrivate;
+class ForkJoinPool
+{
+public:
+
+    /**
+     * @brief The function called for each task. It must not throw.
+     **/
+    typedef void (*TaskFunction)(unsigned int taskIndex, unsigned int nTasks, void* customArg);
+
+    /**
+     * @brief Starts nWorkers threads. With 0 workers, run() calls all tasks in the calling thread.
+     **/
+    ForkJoinPool(unsigned int nWorkers);
+
+    /**
+     * @brief Waits for the workers to finish their current task and stops them.
+     **/
+    ~ForkJoinPool();
+
+    /**
+     * @brief Changes the number of workers. When shrinking, the extra workers stop once done with their current task.
+     **/
+    void setNumWorkers(unsigned int nWorkers);
+
+    unsigned int getNumWorkers() const;
+
+    /**
+     * @brief Returns the number of workers currently running a task. This does not take any lock.
+     **/
+    unsigned int getNumActiveWorkers() const;
+
+    /**
+     * @brief Calls func(i, nTasks, customArg) for each i in [0, nTasks) and returns when they all returned.
+     **/
+    void run(TaskFunction func, unsigned int nTasks, void* customArg);
+
+private:
+
+    boost::scoped_ptr<ForkJoinPoolPrivate> _imp;
+};
+
+NATRON_NAMESPACE_EXIT;
+
+#endif // Engine_ForkJoinPool_h
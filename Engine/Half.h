@@ -0,0 +1,172 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2017 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_HALF_H
+#define NATRON_ENGINE_HALF_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cstring> // memcpy
+
+NATRON_NAMESPACE_ENTER;
+
+/**
+ * @brief A 16-bit floating point number (IEEE 754 binary16), the type of the samples of eImageBitDepthHalf images.
+ * It has the same layout as the "half" type of OpenEXR.
+ *
+ * A Half converts implicitly to and from float so that the templated pixel processing functions may be
+ * instantiated with it like with float (with a maximum value of 1): all arithmetic is done in single precision.
+ * Conversions from float round to the nearest even value, as the F16C instructions used by ImageConvertSIMD do.
+ **/
+class Half
+{
+public:
+
+    Half()
+    : _bits(0)
+    {
+    }
+
+    Half(float value)
+    : _bits( floatToHalfBits(value) )
+    {
+    }
+
+    operator float() const
+    {
+        return halfBitsToFloat(_bits);
+    }
+
+    unsigned short getBits() const
+    {
+        return _bits;
+    }
+
+    static Half fromBits(unsigned short bits)
+    {
+        Half ret;
+        ret._bits = bits;
+        return ret;
+    }
+
+    /**
+     * @brief Converts a float to the bits of the closest half, rounding to the nearest even value.
+     * Values greater than the largest half (65504) become infinite. NaNs remain NaNs.
+     **/
+    static unsigned short floatToHalfBits(float value)
+    {
+        unsigned int x;
+        std::memcpy(&x, &value, sizeof(float));
+
+        const unsigned int sign = (x >> 16) & 0x8000;
+        const unsigned int absx = x & 0x7fffffff;
+
+        if (absx >= 0x7f800000) {
+            if (absx > 0x7f800000) {
+                // NaN: make it quiet and keep the upper bits of the payload
+                return (unsigned short)( sign | 0x7e00 | ( (absx >> 13) & 0x3ff ) );
+            }
+            // Infinity
+            return (unsigned short)(sign | 0x7c00);
+        }
+        if (absx >= 0x47800000) {
+            // 2^16 and above overflow to infinity
+            return (unsigned short)(sign | 0x7c00);
+        }
+        if (absx >= 0x38800000) {
+            // Normalized half: re-bias the exponent from 127 to 15 and round the 13 dropped mantissa bits.
+            // A carry propagates to the exponent, which may give infinity: this is the expected rounding.
+            unsigned int h = (absx - 0x38000000) >> 13;
+            const unsigned int rem = absx & 0x1fff;
+            if ( (rem > 0x1000) || ( (rem == 0x1000) && (h & 1) ) ) {
+                ++h;
+            }
+
+            return (unsigned short)(sign | h);
+        }
+        if (absx < 0x33000000) {
+            // Below half of the smallest denormal (2^-24): rounds to zero
+            return (unsigned short)sign;
+        }
+
+        // Denormalized half: the value in units of 2^-24 is the mantissa (with its implicit bit) shifted right
+        const unsigned int exponent = absx >> 23;
+        const unsigned int mantissa = (absx & 0x7fffff) | 0x800000;
+        const unsigned int shift = 126 - exponent;
+        unsigned int h = mantissa >> shift;
+        const unsigned int rem = mantissa & ( (1u << shift) - 1 );
+        const unsigned int halfway = 1u << (shift - 1);
+        if ( (rem > halfway) || ( (rem == halfway) && (h & 1) ) ) {
+            ++h;
+        }
+
+        return (unsigned short)(sign | h);
+    }
+
+    /**
+     * @brief Converts the bits of a half to a float. This is exact, except that signaling NaNs become quiet NaNs.
+     **/
+    static float halfBitsToFloat(unsigned short bits)
+    {
+        const unsigned int sign = (unsigned int)(bits & 0x8000) << 16;
+        unsigned int exponent = (bits >> 10) & 0x1f;
+        unsigned int mantissa = bits & 0x3ff;
+        unsigned int x;
+
+        if (exponent == 0) {
+            if (mantissa == 0) {
+                x = sign;
+            } else {
+                // Denormalized half: normalize it
+                exponent = 113;
+                while ( !(mantissa & 0x400) ) {
+                    mantissa <<= 1;
+                    --exponent;
+                }
+                mantissa &= 0x3ff;
+                x = sign | (exponent << 23) | (mantissa << 13);
+            }
+        } else if (exponent == 0x1f) {
+            x = sign | 0x7f800000 | (mantissa << 13);
+            if (mantissa) {
+                x |= 0x400000;
+            }
+        } else {
+            x = sign | ( (exponent + 112) << 23 ) | (mantissa << 13);
+        }
+
+        float ret;
+        std::memcpy(&ret, &x, sizeof(float));
+
+        return ret;
+    }
+
+private:
+
+    unsigned short _bits;
+};
+
+NATRON_NAMESPACE_EXIT;
+
+#endif // NATRON_ENGINE_HALF_H
@@ -38,20 +38,45 @@
 
 NATRON_NAMESPACE_ENTER;
 
+bool Hash64::_crc64CompatibilityMode = false;
+
+void
+Hash64::setCrc64CompatibilityModeEnabled(bool enabled)
+{
+    _crc64CompatibilityMode = enabled;
+}
+
+bool
+Hash64::isCrc64CompatibilityModeEnabled()
+{
+    return _crc64CompatibilityMode;
+}
+
 void
 Hash64::computeHash()
 {
     if (hashValid) {
         return;
     }
-    if ( node_values.empty() ) {
+    if (nValues == 0) {
         return;
     }
 
-    const unsigned char* data = reinterpret_cast<const unsigned char*>( &node_values.front() );
-    boost::crc_optimal<64, 0x42F0E1EBA9EA3693ULL, 0, 0, false, false> crc_64;
-    crc_64 = std::for_each( data, data + node_values.size() * sizeof(node_values[0]), crc_64 );
-    hash = crc_64();
+    if (crc64Compatible) {
+        const unsigned char* data = reinterpret_cast<const unsigned char*>( &node_values.front() );
+        boost::crc_optimal<64, 0x42F0E1EBA9EA3693ULL, 0, 0, false, false> crc_64;
+        crc_64 = std::for_each( data, data + node_values.size() * sizeof(node_values[0]), crc_64 );
+        hash = crc_64();
+    } else {
+        // Fold in the length so that trailing zero words change the hash, then avalanche
+        U64 h = state + nValues * sizeof(U64);
+        h ^= h >> 33;
+        h *= kPrime2;
+        h ^= h >> 29;
+        h *= kPrime3;
+        h ^= h >> 32;
+        hash = h;
+    }
     hashValid = true;
 }
 
@@ -59,6 +84,8 @@ void
 Hash64::reset()
 {
     node_values.clear();
+    state = kStreamSeed;
+    nValues = 0;
     hash = 0;
     hashValid = false;
 }
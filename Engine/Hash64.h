@@ -44,13 +44,23 @@ NATRON_NAMESPACE_ENTER;
     - the hash values for the  tree upstream
  */
 
+/**
+ * @brief By default each appended 64-bit word is mixed straight into the hash state (xxHash64 round and avalanche),
+ * so that appending never allocates and computeHash() is O(1).
+ * In CRC64 compatibility mode, the words are instead buffered and the hash is the CRC64 of the buffer,
+ * which is what older versions computed. The cache then uses a directory of its own (see Cache::create)
+ * so that the entries keyed this way are found again by the processes using this mode.
+ **/
 class Hash64
 {
 public:
     Hash64()
     : hash(0)
+    , state(kStreamSeed)
+    , nValues(0)
     , node_values()
     , hashValid(false)
+    , crc64Compatible(_crc64CompatibilityMode)
     {
     }
 
@@ -65,7 +75,7 @@ public:
 
     bool isEmpty() const
     {
-        return node_values.empty();
+        return nValues == 0;
     }
 
     void computeHash();
@@ -93,10 +103,26 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
     template<typename T>
     void append(T value)
     {
-        node_values.push_back( toU64(value) );
+        U64 word = toU64(value);
+        if (crc64Compatible) {
+            node_values.push_back(word);
+        } else {
+            state ^= mixWord(word);
+            state = rotateLeft(state, 27) * kPrime1 + kPrime4;
+        }
+        ++nValues;
         hashValid = false;
     }
 
+    /**
+     * @brief When enabled, hashes created afterwards use the CRC64 of the appended words, as older versions did.
+     * This is process-wide and should be set at startup, before any hash is computed: hashes computed
+     * in different modes may not be compared.
+     **/
+    static void setCrc64CompatibilityModeEnabled(bool enabled);
+
+    static bool isCrc64CompatibilityModeEnabled();
+
     static void appendQString(const QString & str, Hash64* hash);
 
     static void appendCurve(const CurvePtr& curve, Hash64* hash);
@@ -112,6 +138,23 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
     }
 
 private:
+
+    static const U64 kPrime1 = 11400714785074694791ULL;
+    static const U64 kPrime2 = 14029467366897019727ULL;
+    static const U64 kPrime3 = 1609587929392839161ULL;
+    static const U64 kPrime4 = 9650029242287828579ULL;
+    static const U64 kStreamSeed = 2870177450012600261ULL; // PRIME64_5 of xxHash64
+
+    static U64 rotateLeft(U64 x, int r)
+    {
+        return (x << r) | (x >> (64 - r));
+    }
+
+    static U64 mixWord(U64 word)
+    {
+        return rotateLeft(word * kPrime2, 31) * kPrime1;
+    }
+
     template<typename T>
     struct alias_cast_t
     {
@@ -128,8 +171,19 @@ private:
     };
 
     U64 hash;
+
+    // Streaming state, unused in CRC64 compatibility mode
+    U64 state;
+
+    // Number of words appended since the last reset
+    U64 nValues;
+
+    // Only used in CRC64 compatibility mode
     std::vector<U64> node_values;
     bool hashValid;
+    bool crc64Compatible;
+
+    static bool _crc64CompatibilityMode;
 };
 
 
@@ -54,16 +54,142 @@ Image::create(const InitStorageArgs& args)
     return ret;
 }
 
+ImagePtr
+Image::createCopyOnWriteView(const ImagePtr& source,
+                             const ImagePlaneDesc& layer,
+                             const CopyPixelsArgs& conversionArgs,
+                             const TreeRenderNodeArgsPtr& renderArgs)
+{
+    if ( !source || source->_imp->tiles.empty() ) {
+        return ImagePtr();
+    }
+
+    // OpenGL textures cannot be shared between images
+    const StorageModeEnum storage = source->getStorageMode();
+    if ( (storage != eStorageModeRAM) && (storage != eStorageModeDisk) ) {
+        return ImagePtr();
+    }
+
+    const int srcNComps = source->_imp->layer.getNumComponents();
+    const int dstNComps = layer.getNumComponents();
+    int srcChannels[4];
+    float fillValues[4];
+    if ( !ImagePrivate::getCopyChannelsMapping(srcNComps, dstNComps, conversionArgs, srcChannels, fillValues) ) {
+        return ImagePtr();
+    }
+
+    // Channels of packed and coplanar buffers cannot be moved around without a copy: only mono-channel tiled
+    // images are remapped, the others are shared as is
+    const bool isTiled = source->_imp->bufferFormat == eImageBufferLayoutMonoChannelTiled;
+    if (!isTiled && srcNComps != dstNComps) {
+        return ImagePtr();
+    }
+
+    ImagePtr ret(new Image);
+    ImagePrivate& dst = *ret->_imp;
+
+    QMutexLocker k(&source->_imp->copyOnWriteMutex);
+    const ImagePrivate& src = *source->_imp;
+
+    // Tiles that are still being rendered must not be shared: their buffer is going to be inserted in the cache.
+    for (std::size_t i = 0; i < src.tiles.size(); ++i) {
+        for (std::size_t c = 0; c < src.tiles[i].perChannelTile.size(); ++c) {
+            const CacheEntryLockerPtr& locker = src.tiles[i].perChannelTile[c].entryLocker;
+            if ( locker && (locker->getStatus() != CacheEntryLocker::eCacheEntryStatusCached) ) {
+                return ImagePtr();
+            }
+        }
+    }
+
+    dst.bounds = src.bounds;
+    dst.layer = layer;
+    dst.proxyScale = src.proxyScale;
+    dst.mipMapLevel = src.mipMapLevel;
+    dst.cachePolicy = eCacheAccessModeNone;
+    dst.bufferFormat = src.bufferFormat;
+    dst.tileSizeX = src.tileSizeX;
+    dst.tileSizeY = src.tileSizeY;
+    dst.sparse = src.sparse;
+    dst.renderArgs = renderArgs;
+    dst.tiles.resize( src.tiles.size() );
+    dst.copyOnWriteTiles.resize(src.tiles.size(), false);
+
+    CachePtr cache = appPTR->getCache();
+    const ImageBitDepthEnum bitdepth = source->getBitDepth();
+
+    for (std::size_t i = 0; i < src.tiles.size(); ++i) {
+        const Image::Tile& srcTile = src.tiles[i];
+        Image::Tile& dstTile = dst.tiles[i];
+        dstTile.tileBounds = srcTile.tileBounds;
+
+        if (!isTiled) {
+            dstTile.perChannelTile.resize( srcTile.perChannelTile.size() );
+            for (std::size_t c = 0; c < srcTile.perChannelTile.size(); ++c) {
+                dstTile.perChannelTile[c].buffer = srcTile.perChannelTile[c].buffer;
+                dstTile.perChannelTile[c].channelIndex = srcTile.perChannelTile[c].channelIndex;
+            }
+            dst.copyOnWriteTiles[i] = true;
+            continue;
+        }
+
+        dstTile.perChannelTile.resize(dstNComps);
+        for (int c = 0; c < dstNComps; ++c) {
+            Image::MonoChannelTile& channelTile = dstTile.perChannelTile[c];
+            channelTile.channelIndex = c;
+
+            for (std::size_t srcC = 0; srcC < srcTile.perChannelTile.size(); ++srcC) {
+                if ( (srcChannels[c] != -1) && (srcTile.perChannelTile[srcC].channelIndex == srcChannels[c]) ) {
+                    channelTile.buffer = srcTile.perChannelTile[srcC].buffer;
+                    break;
+                }
+            }
+            if (channelTile.buffer) {
+                dst.copyOnWriteTiles[i] = true;
+                continue;
+            }
+
+            // A constant channel, or a channel that was not created in the source image: it is only allocated if written to.
+            channelTile.buffer = ImagePrivate::createSparseTileStorage(cache, storage, bitdepth, dstTile.tileBounds, srcChannels[c] == -1 ? fillValues[c] : 0.f);
+            CacheImageTileStoragePtr isMMAPBuffer = srcTile.perChannelTile.empty() ? CacheImageTileStoragePtr() : toCacheImageTileStorage(srcTile.perChannelTile[0].buffer);
+            if (isMMAPBuffer) {
+                // The bounds of a cache tile are deduced from its key
+                toCacheImageTileStorage(channelTile.buffer)->setKey( isMMAPBuffer->getKey() );
+            }
+            dst.sparse = true;
+        }
+    } // for each tile
+
+    // The source image must also copy the shared tiles before writing to them
+    source->_imp->copyOnWriteTiles.resize(src.tiles.size(), false);
+    for (std::size_t i = 0; i < dst.copyOnWriteTiles.size(); ++i) {
+        if (dst.copyOnWriteTiles[i]) {
+            source->_imp->copyOnWriteTiles[i] = true;
+        }
+    }
+
+    return ret;
+} // createCopyOnWriteView
+
 Image::~Image()
 {
 
     pushTilesToCacheIfNotAborted();
+
+    if (_imp->sparse) {
+        _imp->reportSparseTilesStats();
+    }
     
     // If this image is the last image holding a pointer to memory buffers, ensure these buffers
-    // gets deallocated in a specific thread and not a render thread
+    // gets deallocated in a specific thread and not a render thread.
+    // Buffers allocated from the RAMBufferPool are just given back to the pool of this thread, which is
+    // cheap and lets the next render of this thread reuse them.
     std::list<ImageStorageBasePtr> toDeleteInDeleterThread;
     for (std::size_t i = 0; i < _imp->tiles.size(); ++i) {
         for (std::size_t c = 0;  c < _imp->tiles[i].perChannelTile.size(); ++c) {
+            RAMImageStoragePtr isRAMBuffer = toRAMImageStorage(_imp->tiles[i].perChannelTile[c].buffer);
+            if (isRAMBuffer && isRAMBuffer->isAllocatedFromPool()) {
+                continue;
+            }
             toDeleteInDeleterThread.push_back(_imp->tiles[i].perChannelTile[c].buffer);
         }
     }
@@ -131,6 +257,7 @@ Image::InitStorageArgs::InitStorageArgs()
 , glContext()
 , textureTarget(GL_TEXTURE_2D)
 , externalBuffer()
+, sparse(false)
 {
     // By default make all channels
     components[0] = components[1] = components[2] = components[3] = 1;
@@ -196,6 +323,23 @@ ImagePrivate::initFromExternalBuffer(const Image::InitStorageArgs& args)
 
 } // initFromExternalBuffer
 
+/**
+ * @brief A channel of a tile to look-up in the cache, see Image::initializeStorage
+ **/
+struct TileCacheLookup
+{
+    int tileIndex, channelTileIndex;
+
+    // Number of channels of the tile
+    int nChannels;
+
+    // Coordinates of the tile
+    int tx, ty;
+
+    std::string channelName;
+    CacheImageTileStoragePtr cachedBuffer;
+};
+
 void
 Image::initializeStorage(const Image::InitStorageArgs& args)
 {
@@ -258,9 +402,10 @@ Image::initializeStorage(const Image::InitStorageArgs& args)
     switch (args.bufferFormat) {
         case eImageBufferLayoutMonoChannelTiled: {
             // The size of a tile depends on the bitdepth
-            Cache::getTileSizePx(args.bitdepth, &tileSizeX, &tileSizeY);
-            nTilesHeight = std::ceil(_imp->bounds.height() / tileSizeY) * tileSizeY;
-            nTilesWidth = std::ceil(_imp->bounds.width() / tileSizeX) * tileSizeX;
+            cache->getTileSizePx(args.bitdepth, &tileSizeX, &tileSizeY);
+            // Edge tiles may be smaller than the tile size
+            nTilesHeight = (_imp->bounds.height() + tileSizeY - 1) / tileSizeY;
+            nTilesWidth = (_imp->bounds.width() + tileSizeX - 1) / tileSizeX;
         }   break;
         case eImageBufferLayoutRGBACoplanarFullRect:
         case eImageBufferLayoutRGBAPackedFullRect:
@@ -273,6 +418,12 @@ Image::initializeStorage(const Image::InitStorageArgs& args)
     int nTiles = nTilesWidth * nTilesHeight;
     assert(nTiles > 0);
 
+    _imp->tileSizeX = tileSizeX;
+    _imp->tileSizeY = tileSizeY;
+
+    // Only mono-channel tiles may be allocated lazily: full rect images have a single tile anyway
+    _imp->sparse = args.sparse && args.bufferFormat == eImageBufferLayoutMonoChannelTiled && !args.externalBuffer;
+
     _imp->tiles.resize(nTiles);
 
     if (args.externalBuffer) {
@@ -280,6 +431,9 @@ Image::initializeStorage(const Image::InitStorageArgs& args)
         return;
     } // args.externalBuffer
 
+    // The tiles to look-up in the cache
+    std::vector<TileCacheLookup> tileLookups;
+
     // Initialize each tile
     int tx = 0, ty = 0;
     for (int tile_i = 0; tile_i < nTiles; ++tile_i) {
@@ -394,10 +548,15 @@ Image::initializeStorage(const Image::InitStorageArgs& args)
                         break;
                 }
                 assert(allocArgs && thisChannelTile.buffer);
-                
-                // Allocate the memory for the tile.
-                // This may throw a std::bad_alloc
-                thisChannelTile.buffer->allocateMemory(*allocArgs);
+
+                if (_imp->sparse && _imp->cachePolicy == eCacheAccessModeNone) {
+                    // The memory is allocated the first time the tile is written to.
+                    thisChannelTile.buffer->setLazyAllocation(allocArgs, 0.f);
+                } else {
+                    // Allocate the memory for the tile: the cache needs it to read the tile.
+                    // This may throw a std::bad_alloc
+                    thisChannelTile.buffer->allocateMemory(*allocArgs);
+                }
             } // allocArgs
 
             // If the entry wants to be cached but we don't want to read from the cache
@@ -425,99 +584,19 @@ Image::initializeStorage(const Image::InitStorageArgs& args)
                 }
             }
 
-            // Look in the cache
+            // Look in the cache: the first key of each tile is looked-up once all tiles are initialized
             if (_imp->cachePolicy == eCacheAccessModeReadWrite || _imp->cachePolicy == eCacheAccessModeWriteOnly) {
+                assert(cachedBuffer);
 
-                // First look for a tile at the proxy + mipmap scale, if not found look for a tile at proxy scale and downscale it.
-                // This is the default cache lookup scale: for OpenGL textures, always assume them at full proxy scale
-                // since downscaling is handled by OpenGL itself
-                int nMipMapLookups;
-                unsigned firstLookupLevel;
-                if (args.storage != eStorageModeRAM && args.storage != eStorageModeDisk) {
-                    nMipMapLookups = 1;
-                    firstLookupLevel = 0;
-                } else {
-                    nMipMapLookups = (args.mipMapLevel != 0) ? 2 : 1;
-                    firstLookupLevel = args.mipMapLevel;
-                }
-
-                bool isCached = false;
-                for (int mipmap_i = 0; mipmap_i < nMipMapLookups; ++mipmap_i) {
-
-                    const unsigned int lookupLevel = mipmap_i == 0 ? firstLookupLevel : 0;
-                    
-                    // Only look for a draft tile in the cache if the image allows draft
-                    const int nDraftLookups = args.isDraft ? 2 : 1;
-
-                    for (int draft_i = 0; draft_i < nDraftLookups; ++draft_i) {
-
-                        const bool useDraft = (const bool)draft_i;
-
-                        ImageTileKeyPtr keyToReadCache(new ImageTileKey(args.nodeTimeInvariantHash,
-                                                                        args.time,
-                                                                        args.view,
-                                                                        channelName,
-                                                                        args.proxyScale,
-                                                                        lookupLevel,
-                                                                        useDraft,
-                                                                        args.bitdepth,
-                                                                        tx,
-                                                                        ty));
-
-                        assert(cachedBuffer);
-                        cachedBuffer->setKey(keyToReadCache);
-
-                        // Store the entry locker pointer
-                        thisChannelTile.entryLocker = cache->get(cachedBuffer);
-
-                        if (thisChannelTile.entryLocker->getStatus() == CacheEntryLocker::eCacheEntryStatusCached) {
-                            isCached = true;
-                            // We found a cache entry, don't continue to look for a tile computed in draft mode.
-                            break;
-                        }
-                    } // for each draft mode to check
-                    if (isCached) {
-
-                        if (args.storage == eStorageModeRAM || args.storage == eStorageModeDisk) {
-                            // If the image fetched is at a upper scale, we must downscale
-                            if (lookupLevel != firstLookupLevel) {
-                                assert(firstLookupLevel > lookupLevel);
-
-                                const unsigned int downscaleLevels = firstLookupLevel - lookupLevel;
-
-                                // Make a new view of this tile with a format that downscaleMipMap understands
-                                // The copy will not actually copy the pixels, just the buffer memory pointer
-                                ImagePtr fullScaleImage;
-                                {
-                                    InitStorageArgs tmpArgs;
-                                    tmpArgs.bounds = tile.tileBounds;
-                                    tmpArgs.renderArgs = _imp->renderArgs;
-                                    tmpArgs.bufferFormat = eImageBufferLayoutRGBAPackedFullRect;
-                                    tmpArgs.layer = channelIndices.size() > 1 ? ImagePlaneDesc::getAlphaComponents() : _imp->layer;
-                                    tmpArgs.bitdepth = args.bitdepth;
-                                    tmpArgs.proxyScale = args.proxyScale;
-                                    tmpArgs.mipMapLevel = args.mipMapLevel;
-                                    tmpArgs.externalBuffer = thisChannelTile.buffer;
-                                    tmpArgs.nodeTimeInvariantHash = args.nodeTimeInvariantHash;
-                                    tmpArgs.time = args.time;
-                                    tmpArgs.view = args.view;
-                                    fullScaleImage = Image::create(args);
-                                }
-
-                                ImagePtr downscaledImage = fullScaleImage->downscaleMipMap(tile.tileBounds, downscaleLevels);
-
-                                assert(downscaledImage->_imp->tiles.size() == 1);
-                                assert(downscaledImage->_imp->tiles[0].perChannelTile.size() == 1);
-
-                                // Since we downscaled a single tile of the same size and same number of components and same bitdepth
-                                // as this tile, we can just copy the pointer
-                                thisChannelTile.buffer = downscaledImage->_imp->tiles[0].perChannelTile[0].buffer;
-
-                            } // must downscale
-                        }
-                        break;
-                    } // isCached
-                } // for each mip map lvel to check
+                TileCacheLookup lookup;
+                lookup.tileIndex = tile_i;
+                lookup.channelTileIndex = (int)c;
+                lookup.nChannels = (int)channelIndices.size();
+                lookup.tx = tx;
+                lookup.ty = ty;
+                lookup.channelName = channelName;
+                lookup.cachedBuffer = cachedBuffer;
+                tileLookups.push_back(lookup);
             } // useCache
 
         } // for each channel
@@ -531,6 +610,161 @@ Image::initializeStorage(const Image::InitStorageArgs& args)
         }
     } // for each tile
 
+    if ( tileLookups.empty() ) {
+        return;
+    }
+
+    // First look for a tile at the proxy + mipmap scale, if not found look for a tile at proxy scale and downscale it.
+    // This is the default cache lookup scale: for OpenGL textures, always assume them at full proxy scale
+    // since downscaling is handled by OpenGL itself
+    int nMipMapLookups;
+    unsigned firstLookupLevel;
+    if (args.storage != eStorageModeRAM && args.storage != eStorageModeDisk) {
+        nMipMapLookups = 1;
+        firstLookupLevel = 0;
+    } else {
+        nMipMapLookups = (args.mipMapLevel != 0) ? 2 : 1;
+        firstLookupLevel = args.mipMapLevel;
+    }
+
+    // Most tiles are found with their first key: look them all up at once so that each bucket of the cache is locked
+    // once for all the tiles it holds
+    std::vector<CacheEntryLockerPtr> firstLookupLockers;
+    {
+        std::vector<CacheEntryBasePtr> firstLookupEntries( tileLookups.size() );
+        for (std::size_t lookup_i = 0; lookup_i < tileLookups.size(); ++lookup_i) {
+            const TileCacheLookup& lookup = tileLookups[lookup_i];
+            ImageTileKeyPtr keyToReadCache(new ImageTileKey(args.nodeTimeInvariantHash,
+                                                            args.time,
+                                                            args.view,
+                                                            lookup.channelName,
+                                                            args.proxyScale,
+                                                            firstLookupLevel,
+                                                            false /*draft*/,
+                                                            args.bitdepth,
+                                                            lookup.tx,
+                                                            lookup.ty));
+            lookup.cachedBuffer->setKey(keyToReadCache);
+            firstLookupEntries[lookup_i] = lookup.cachedBuffer;
+        }
+        cache->getBatch(firstLookupEntries, &firstLookupLockers);
+    }
+
+    for (std::size_t lookup_i = 0; lookup_i < tileLookups.size(); ++lookup_i) {
+        const TileCacheLookup& lookup = tileLookups[lookup_i];
+        Image::Tile& tile = _imp->tiles[lookup.tileIndex];
+        MonoChannelTile& thisChannelTile = tile.perChannelTile[lookup.channelTileIndex];
+        const CacheImageTileStoragePtr& cachedBuffer = lookup.cachedBuffer;
+
+        bool isCached = false;
+        for (int mipmap_i = 0; mipmap_i < nMipMapLookups; ++mipmap_i) {
+
+            const unsigned int lookupLevel = mipmap_i == 0 ? firstLookupLevel : 0;
+            
+            // Only look for a draft tile in the cache if the image allows draft
+            const int nDraftLookups = args.isDraft ? 2 : 1;
+
+            for (int draft_i = 0; draft_i < nDraftLookups; ++draft_i) {
+
+                // Store the entry locker pointer
+                if ( (mipmap_i == 0) && (draft_i == 0) ) {
+                    // This key was looked-up with the other tiles of the image
+                    thisChannelTile.entryLocker = firstLookupLockers[lookup_i];
+                } else {
+                    const bool useDraft = (const bool)draft_i;
+
+                    ImageTileKeyPtr keyToReadCache(new ImageTileKey(args.nodeTimeInvariantHash,
+                                                                    args.time,
+                                                                    args.view,
+                                                                    lookup.channelName,
+                                                                    args.proxyScale,
+                                                                    lookupLevel,
+                                                                    useDraft,
+                                                                    args.bitdepth,
+                                                                    lookup.tx,
+                                                                    lookup.ty));
+
+                    assert(cachedBuffer);
+                    cachedBuffer->setKey(keyToReadCache);
+                    thisChannelTile.entryLocker = cache->get(cachedBuffer);
+                }
+
+                if (thisChannelTile.entryLocker->getStatus() == CacheEntryLocker::eCacheEntryStatusCached) {
+                    isCached = true;
+                    // We found a cache entry, don't continue to look for a tile computed in draft mode.
+                    break;
+                }
+            } // for each draft mode to check
+            if (isCached) {
+
+                if (args.storage == eStorageModeRAM || args.storage == eStorageModeDisk) {
+                    // If the image fetched is at a upper scale, we must downscale
+                    if (lookupLevel != firstLookupLevel) {
+                        assert(firstLookupLevel > lookupLevel);
+
+                        const unsigned int downscaleLevels = firstLookupLevel - lookupLevel;
+
+                        // The mipmaps of the tile are kept in the cache with it: only the first request downscales it
+                        ImageStorageBasePtr mipmapBuffer;
+                        CacheImageTileMipMapsPtr mipmaps = ImagePrivate::getTileMipMaps(cachedBuffer);
+                        if (mipmaps) {
+                            const RectI cachedTileBounds = cachedBuffer->getBounds();
+                            mipmapBuffer = ImagePrivate::createBufferFromTileMipMaps(*mipmaps,
+                                                                                     downscaleLevels,
+                                                                                     cachedTileBounds.x1,
+                                                                                     cachedTileBounds.y1,
+                                                                                     tile.tileBounds.downscalePowerOfTwoSmallestEnclosing(downscaleLevels));
+                        }
+
+                        if (mipmapBuffer) {
+                            thisChannelTile.buffer = mipmapBuffer;
+                        } else {
+                            // The tile is smaller than the requested level: downscale it
+                            // Make a new view of this tile with a format that downscaleMipMap understands
+                            // The copy will not actually copy the pixels, just the buffer memory pointer
+                            ImagePtr fullScaleImage;
+                            {
+                                InitStorageArgs tmpArgs;
+                                tmpArgs.bounds = tile.tileBounds;
+                                tmpArgs.renderArgs = _imp->renderArgs;
+                                tmpArgs.bufferFormat = eImageBufferLayoutRGBAPackedFullRect;
+                                tmpArgs.layer = lookup.nChannels > 1 ? ImagePlaneDesc::getAlphaComponents() : _imp->layer;
+                                tmpArgs.bitdepth = args.bitdepth;
+                                tmpArgs.proxyScale = args.proxyScale;
+                                tmpArgs.mipMapLevel = args.mipMapLevel;
+                                tmpArgs.externalBuffer = thisChannelTile.buffer;
+                                tmpArgs.nodeTimeInvariantHash = args.nodeTimeInvariantHash;
+                                tmpArgs.time = args.time;
+                                tmpArgs.view = args.view;
+                                fullScaleImage = Image::create(args);
+                            }
+
+                            ImagePtr downscaledImage = fullScaleImage->downscaleMipMap(tile.tileBounds, downscaleLevels);
+
+                            assert(downscaledImage->_imp->tiles.size() == 1);
+                            assert(downscaledImage->_imp->tiles[0].perChannelTile.size() == 1);
+
+                            // Since we downscaled a single tile of the same size and same number of components and same bitdepth
+                            // as this tile, we can just copy the pointer
+                            thisChannelTile.buffer = downscaledImage->_imp->tiles[0].perChannelTile[0].buffer;
+                        }
+
+                    } // must downscale
+                }
+                break;
+            } // isCached
+        } // for each mip map lvel to check
+
+        if (!isCached && _imp->sparse) {
+            // The tile must be computed: release the memory until it is written to.
+            assert(cachedBuffer);
+            boost::shared_ptr<AllocateMemoryArgs> allocArgs(new AllocateMemoryArgs());
+            allocArgs->bitDepth = args.bitdepth;
+            cachedBuffer->deallocateMemory();
+            cachedBuffer->setLazyAllocation(allocArgs, 0.f);
+        }
+    } // for each tile to look-up
+
 } // initializeStorage
 
 Image::CopyPixelsArgs::CopyPixelsArgs()
@@ -613,6 +847,9 @@ Image::copyPixels(const Image& other, const CopyPixelsArgs& args)
 
     } // !args.forceCopyEvenIfBuffersHaveSameLayout
 
+    // The tiles that are written to must not be shared with another image
+    _imp->detachCopyOnWriteTiles(roi);
+
     ImagePtr tmpImage = ImagePrivate::checkIfCopyToTempImageIsNeeded(other, *this, roi);
 
     const Image* fromImage = tmpImage? tmpImage.get() : &other;
@@ -736,11 +973,14 @@ Image::getCPUTileData(const Tile& tile, ImageBufferLayoutEnum layout, CPUTileDat
     data->nComps = 0;
     data->bitDepth = eImageBitDepthNone;
 
+    // The caller may write to the data: allocate the tile if it belongs to a sparse image
+    ImagePrivate::ensureTileAllocated(tile);
+
     for (std::size_t i = 0; i < tile.perChannelTile.size(); ++i) {
         RAMImageStoragePtr fromIsRAMBuffer = toRAMImageStorage(tile.perChannelTile[i].buffer);
         CacheImageTileStoragePtr fromIsMMAPBuffer = toCacheImageTileStorage(tile.perChannelTile[i].buffer);
 
-        if (!fromIsMMAPBuffer || !fromIsRAMBuffer) {
+        if (!fromIsMMAPBuffer && !fromIsRAMBuffer) {
             continue;
         }
         if (i == 0) {
@@ -838,12 +1078,21 @@ Image::getRestToRender(bool *hasPendingResults) const
 } // getRestToRender
 
 bool
-Image::getTileAt(int tileIndex, Image::Tile* tile) const
+Image::getTileAt(int tileIndex, Image::Tile* tile, bool readOnly) const
 {
-    if (!tile || tileIndex < 0 || tileIndex > (int)_imp->tiles.size()) {
+    if (!tile || tileIndex < 0 || tileIndex >= (int)_imp->tiles.size()) {
         return false;
     }
-    *tile = _imp->tiles[tileIndex];
+    {
+        QMutexLocker k(&_imp->copyOnWriteMutex);
+        if (!readOnly) {
+            _imp->detachCopyOnWriteTile(tileIndex);
+        }
+        *tile = _imp->tiles[tileIndex];
+    }
+    if (_imp->sparse) {
+        ImagePrivate::ensureTileAllocated(*tile);
+    }
     return true;
 }
 
@@ -941,12 +1190,40 @@ Image::fill(const RectI & roi,
 
 
 
+    // The tiles that are written to must not be shared with another image
+    _imp->detachCopyOnWriteTiles(roi);
+
+    const float channelValues[4] = {r, g, b, a};
+    const bool isSingleChannel = _imp->layer.getNumComponents() == 1;
+
     for (std::size_t tile_i = 0; tile_i < _imp->tiles.size(); ++tile_i) {
 
-        Image::CPUTileData tileData;
-        getCPUTileData(_imp->tiles[tile_i], &tileData);
+        const Image::Tile& tile = _imp->tiles[tile_i];
         RectI tileRoI;
-        roi.intersect(tileData.tileBounds, &tileRoI);
+        if (!roi.intersect(tile.tileBounds, &tileRoI)) {
+            continue;
+        }
+
+        // A tile of a sparse image that was not allocated yet and that is entirely filled
+        // only needs to remember the fill value.
+        if (_imp->sparse && tileRoI == tile.tileBounds) {
+            float tileValues[4];
+            if (ImagePrivate::isTileUnallocated(tile, tileValues)) {
+                bool allSet = true;
+                for (std::size_t c = 0; c < tile.perChannelTile.size(); ++c) {
+                    const int channelIndex = tile.perChannelTile[c].channelIndex;
+                    assert(channelIndex >= 0 && channelIndex < 4);
+                    const float value = isSingleChannel ? a : channelValues[channelIndex];
+                    allSet &= tile.perChannelTile[c].buffer->setLazyFillValue(value);
+                }
+                if (allSet) {
+                    continue;
+                }
+            }
+        }
+
+        Image::CPUTileData tileData;
+        getCPUTileData(tile, &tileData);
 
         RGBAColourF color = {r, g, b, a};
 
@@ -978,6 +1255,10 @@ Image::ensureBounds(const RectI& roi)
         return;
     }
 
+    if (_imp->sparse && _imp->extendSparseTiles(roi)) {
+        return;
+    }
+
     ImagePtr tmpImage;
     {
         Image::InitStorageArgs initArgs;
@@ -989,6 +1270,7 @@ Image::ensureBounds(const RectI& roi)
         initArgs.storage = getStorageMode();
         initArgs.mipMapLevel = getMipMapLevel();
         initArgs.proxyScale = getProxyScale();
+        initArgs.sparse = _imp->sparse;
         GLImageStoragePtr isGlEntry = getGLImageStorage();
         if (isGlEntry) {
             initArgs.textureTarget = isGlEntry->getGLTextureTarget();
@@ -1020,6 +1302,9 @@ Image::getChannelPointers(const void* ptrs[4],
         case eImageBitDepthShort:
             getChannelPointers<unsigned short>((const unsigned short**)ptrs, x, y, bounds, nComps, (unsigned short**)outPtrs, pixelStride);
             break;
+        case eImageBitDepthHalf:
+            getChannelPointers<Half>((const Half**)ptrs, x, y, bounds, nComps, (Half**)outPtrs, pixelStride);
+            break;
         case eImageBitDepthFloat:
             getChannelPointers<float>((const float**)ptrs, x, y, bounds, nComps, (float**)outPtrs, pixelStride);
             break;
@@ -1205,21 +1490,41 @@ Image::downscaleMipMap(const RectI & roi, unsigned int downscaleLevels) const
 bool
 Image::checkForNaNs(const RectI& roi)
 {
-    if (getBitDepth() != eImageBitDepthFloat) {
+    if (getBitDepth() != eImageBitDepthFloat && getBitDepth() != eImageBitDepthHalf) {
         return false;
     }
     if (getStorageMode() == eStorageModeGLTex) {
         return false;
     }
 
+    // NaNs are fixed in place
+    _imp->detachCopyOnWriteTiles(roi);
+
     bool hasNan = false;
 
     for (std::size_t i = 0; i < _imp->tiles.size(); ++i) {
+        RectI tileRoi;
+        if (!roi.intersect(_imp->tiles[i].tileBounds, &tileRoi)) {
+            continue;
+        }
+
+        // A tile that was never allocated holds a constant: only check it
+        float tileValues[4];
+        if (_imp->sparse && tileRoi == _imp->tiles[i].tileBounds && ImagePrivate::isTileUnallocated(_imp->tiles[i], tileValues)) {
+            const Image::Tile& tile = _imp->tiles[i];
+            for (std::size_t c = 0; c < tile.perChannelTile.size(); ++c) {
+                const int channelIndex = tile.perChannelTile[c].channelIndex;
+                if (tileValues[channelIndex] != tileValues[channelIndex]) { // check for NaN
+                    tile.perChannelTile[c].buffer->setLazyFillValue(1.f);
+                    hasNan = true;
+                }
+            }
+            continue;
+        }
+
         Image::CPUTileData tileData;
         getCPUTileData(_imp->tiles[i], &tileData);
 
-        RectI tileRoi;
-        roi.intersect(tileData.tileBounds, &tileRoi);
         hasNan |= _imp->checkForNaNs(tileData.ptrs, tileData.nComps, tileData.bitDepth, tileData.tileBounds, tileRoi);
     }
     return hasNan;
@@ -1317,15 +1622,19 @@ Image::applyMaskMix(const RectI& roi,
         assert(maskImgData.nComps == 1);
     }
 
+    _imp->detachCopyOnWriteTiles(roi);
+
 
     for (std::size_t tile_i = 0; tile_i < _imp->tiles.size(); ++tile_i) {
 
+        RectI tileRoI;
+        if (!roi.intersect(_imp->tiles[tile_i].tileBounds, &tileRoI)) {
+            continue;
+        }
+
         Image::CPUTileData dstImgData;
         getCPUTileData(_imp->tiles[tile_i], &dstImgData);
 
-        RectI tileRoI;
-        roi.intersect(dstImgData.tileBounds, &tileRoI);
-
         MaskMixProcessor processor(_imp->renderArgs);
         processor.setValues(srcImgData, maskImgData, dstImgData, mix, maskInvert);
         processor.setRenderWindow(tileRoI);
@@ -1425,15 +1734,18 @@ Image::copyUnProcessedChannels(const RectI& roi,
         getCPUTileData(originalImg->_imp->tiles[0], &srcImgData);
     }
 
+    _imp->detachCopyOnWriteTiles(roi);
 
     for (std::size_t tile_i = 0; tile_i < _imp->tiles.size(); ++tile_i) {
 
+        RectI tileRoI;
+        if (!roi.intersect(_imp->tiles[tile_i].tileBounds, &tileRoI)) {
+            continue;
+        }
+
         Image::CPUTileData dstImgData;
         getCPUTileData(_imp->tiles[tile_i], &dstImgData);
 
-        RectI tileRoI;
-        roi.intersect(dstImgData.tileBounds, &tileRoI);
-
         CopyUnProcessedProcessor processor(_imp->renderArgs);
         processor.setValues(srcImgData, dstImgData, processChannels);
         processor.setRenderWindow(tileRoI);
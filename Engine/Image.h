@@ -39,6 +39,7 @@
 
 #include "Global/GLIncludes.h"
 #include "Engine/Cache.h" // CacheEntryLockerPtr - put it in EngineFwd.h?
+#include "Engine/Half.h"
 #include "Engine/ImagePlaneDesc.h"
 #include "Engine/RectI.h"
 #include "Engine/TimeValue.h"
@@ -216,6 +217,16 @@ public:
         // Default - NULL
         ImageStorageBasePtr externalBuffer;
 
+        // If true, the memory of each tile is only allocated the first time it is written to, i.e: when it is
+        // returned by getTileAt() or getCPUTileData(), or when pixels are copied or filled in it.
+        // Until then, a tile reads as a constant, 0 by default: filling a whole tile only changes this constant.
+        // This is useful when the bounds of the image are much larger than what is actually rendered.
+        // Only images with the eImageBufferLayoutMonoChannelTiled layout may be sparse, this is ignored otherwise.
+        // Tiles found in the cache are allocated. Tiles inserted in the cache are allocated first, with their constant.
+        //
+        // Default - false
+        bool sparse;
+
         InitStorageArgs();
     };
 
@@ -401,6 +412,25 @@ public:
      **/
     void copyPixels(const Image& other, const CopyPixelsArgs& args);
 
+    /**
+     * @brief Make an image of the given layer that shares the tiles of the source image instead of copying them:
+     * this is what copyPixels() with the given arguments would produce in an image of the same bounds,
+     * bitdepth, storage and buffer layout as the source image (the roi of the arguments is ignored).
+     * The tiles that are shared are copied by either image the first time it writes to them.
+     * Channels are only remapped for eImageBufferLayoutMonoChannelTiled images, where each channel has its own
+     * buffer: channels of the view may then come from any channel of the source, and channels that are a constant
+     * are only allocated if written to. The channels of the other layouts share a single buffer: their tiles are
+     * shared as is, which is only possible if the layer has the same number of components as the source.
+     * Returns NULL if the conversion cannot be done without a copy (e.g: a bitdepth or color-space conversion,
+     * a different number of components in a packed or coplanar buffer, OpenGL textures or tiles still being rendered):
+     * the caller should then copy the pixels.
+     * The view is never cached.
+     **/
+    static ImagePtr createCopyOnWriteView(const ImagePtr& source,
+                                          const ImagePlaneDesc& layer,
+                                          const CopyPixelsArgs& conversionArgs,
+                                          const TreeRenderNodeArgsPtr& renderArgs);
+
     /*
      Compute the rectangles (A,B,C,D) where to set the image to 0
 
@@ -450,7 +480,7 @@ public:
                                           int* pixelStride)
     {
         const int dataSizeOf = sizeof(PIX);
-        memset(outPtrs, 0, dataSizeOf * 4);
+        memset(outPtrs, 0, sizeof(PIX*) * 4);
         {
             // If co-planar and number of components greater than 1, then ptrs[1] should be set,
             // In this case the pixel stride is always 1.
@@ -556,6 +586,7 @@ public:
 
     /**
      * @brief For a tile with CPU (RAM or MMAP) storage, returns the buffer data.
+     * If the tile belongs to a sparse image and was not allocated yet, it is allocated.
      **/
     void getCPUTileData(const Tile& tile, CPUTileData* data) const;
 
@@ -564,8 +595,11 @@ public:
     /**
      * @brief Returns the tile at the given tileIndex.
      * An untiled image has a single tile at index 0.
+     * If the image is sparse, the tile is allocated since the caller may write to it.
+     * Callers that write to the tile must pass readOnly = false: a tile shared with another
+     * image (see createCopyOnWriteView()) is then copied first.
      **/
-    bool getTileAt(int tileIndex, Tile* tile) const;
+    bool getTileAt(int tileIndex, Tile* tile, bool readOnly = true) const;
 
     /**
      * @brief Returns the number of tiles
@@ -624,6 +658,8 @@ public:
      * If it does not, a temporary image is created to the union of
      * the existing bounds and the passed RoI. 
      * Data is copied over to the temporary image and then swaped with this image.
+     * A sparse image is instead extended by whole tiles: the existing tiles are kept
+     * and the new ones are not allocated.
      * In output of this function, the image bounds contain at least the RoI.
      **/
     void ensureBounds(const RectI& roi);
@@ -727,6 +763,10 @@ template<>
 inline unsigned short
 Image::clampIfInt(float v) { return (unsigned short)clamp<float>(v, 0, 65535); }
 
+template<>
+inline Half
+Image::clampIfInt(float v) { return Half(v); }
+
 template<>
 inline float
 Image::clampIfInt(float v) { return v; }
@@ -27,16 +27,19 @@
 #include <algorithm> // min, max
 #include <cassert>
 #include <stdexcept>
+#include <vector>
 
 #if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
 GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_OFF
 #include <boost/math/special_functions/fpclassify.hpp>
 GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
+#include <boost/type_traits/is_same.hpp>
 #endif
 
 #include <QtCore/QDebug>
 
 #include "Engine/AppManager.h"
+#include "Engine/ImageConvertSIMD.h"
 #include "Engine/Lut.h"
 
 NATRON_NAMESPACE_ENTER;
@@ -108,6 +111,55 @@ Image::convertPixelDepth(float pix)
     return pix;
 }
 
+template <>
+float
+Image::convertPixelDepth(Half pix)
+{
+    return pix;
+}
+
+template <>
+Half
+Image::convertPixelDepth(float pix)
+{
+    return Half(pix);
+}
+
+template <>
+Half
+Image::convertPixelDepth(Half pix)
+{
+    return pix;
+}
+
+template <>
+unsigned char
+Image::convertPixelDepth(Half pix)
+{
+    return (unsigned char)Color::floatToInt<256>(pix);
+}
+
+template <>
+unsigned short
+Image::convertPixelDepth(Half pix)
+{
+    return (unsigned short)Color::floatToInt<65536>(pix);
+}
+
+template <>
+Half
+Image::convertPixelDepth(unsigned char pix)
+{
+    return Half( Color::intToFloat<256>(pix) );
+}
+
+template <>
+Half
+Image::convertPixelDepth(unsigned short pix)
+{
+    return Half( Color::intToFloat<65536>(pix) );
+}
+
 static const Color::Lut*
 lutFromColorspace(ViewerColorSpaceEnum cs)
 {
@@ -132,6 +184,21 @@ lutFromColorspace(ViewerColorSpaceEnum cs)
     return lut;
 }
 
+// Half and float images both have a maximum value of 1, so the bit depth is deduced from the sample type
+template <typename PIX>
+static ImageBitDepthEnum
+bitDepthFromPixelType()
+{
+    switch ( sizeof(PIX) ) {
+    case 1:
+        return eImageBitDepthByte;
+    case 2:
+        return boost::is_same<PIX, Half>::value ? eImageBitDepthHalf : eImageBitDepthShort;
+    default:
+        return eImageBitDepthFloat;
+    }
+}
+
 ///Fast version when components are the same
 template <typename SRCPIX, int srcMaxValue, typename DSTPIX, int dstMaxValue>
 static void
@@ -154,17 +221,28 @@ convertToFormatInternal_sameComps(const RectI & renderWindow,
     const Color::Lut* const srcLut = (srcLut_ == dstLut_) ? 0 : srcLut_;
     const Color::Lut* const dstLut = (srcLut_ == dstLut_) ? 0 : dstLut_;
 
-    int srcDataSizeOf = sizeof(SRCPIX);
+    // Without colorspace conversion each sample is converted independently (there is no error diffusion),
+    // so scan-lines can be processed in a single run with memcpy or a vectorized kernel when both buffers have the same layout.
+    const bool srcIsPacked = nComp == 1 || !srcBufPtrs[1];
+    const bool dstIsPacked = nComp == 1 || !dstBufPtrs[1];
+    const bool useMemcpy = boost::is_same<SRCPIX, DSTPIX>::value;
+    ImageConvertSIMD::ConvertSamplesFunc convertSamplesFunc = 0;
+    if (!srcLut && !dstLut && !useMemcpy) {
+        convertSamplesFunc = ImageConvertSIMD::getConvertSamplesFunction( bitDepthFromPixelType<SRCPIX>(), bitDepthFromPixelType<DSTPIX>() );
+    }
+    const bool useFastPath = !srcLut && !dstLut && srcIsPacked == dstIsPacked && (useMemcpy || convertSamplesFunc);
 
+    // In packed RGBA mode or single channel coplanar a single run is needed per scan-line, otherwise one per channel
+    const int nRuns = srcIsPacked ? 1 : nComp;
+    const std::size_t nSamplesPerRun = srcIsPacked ? renderWindow.width() * nComp : renderWindow.width();
 
-    for (int y = 0; y < renderWindow.height(); ++y) {
+    for (int y = renderWindow.y1; y < renderWindow.y2; ++y) {
 
         if (renderArgs && renderArgs->isRenderAborted()) {
             return;
         }
 
-        if (srcMaxValue == dstMaxValue && !srcLut && !dstLut) {
-            // Use memcpy when possible
+        if (useFastPath) {
 
             const SRCPIX* srcPixelPtrs[4];
             int srcPixelStride;
@@ -174,16 +252,14 @@ convertToFormatInternal_sameComps(const RectI & renderWindow,
             int dstPixelStride;
             Image::getChannelPointers<DSTPIX>((const DSTPIX**)dstBufPtrs, renderWindow.x1, y, dstBounds, nComp, (DSTPIX**)dstPixelPtrs, &dstPixelStride);
 
-            std::size_t nBytesToCopy = renderWindow.width() * nComp * srcDataSizeOf;
-            if (nComp == 1 || !srcPixelPtrs[1]) {
-                // In packed RGBA mode or single channel coplanar a single call to memcpy is needed per scan-line
-                memcpy(dstPixelPtrs[0], srcPixelPtrs[0], nBytesToCopy);
-            } else {
-                // Ok we are in coplanar mode, copy each channel individually
-                for (int c = 0; c < 4; ++c) {
-                    if (srcPixelPtrs[c] && dstPixelPtrs[c]) {
-                        memcpy(dstPixelPtrs[c], srcPixelPtrs[c], nBytesToCopy);
-                    }
+            for (int c = 0; c < nRuns; ++c) {
+                if (!srcPixelPtrs[c] || !dstPixelPtrs[c]) {
+                    continue;
+                }
+                if (useMemcpy) {
+                    memcpy( (void*)dstPixelPtrs[c], srcPixelPtrs[c], nSamplesPerRun * sizeof(SRCPIX) );
+                } else {
+                    convertSamplesFunc(srcPixelPtrs[c], dstPixelPtrs[c], nSamplesPerRun);
                 }
             }
         } else {
@@ -201,9 +277,9 @@ convertToFormatInternal_sameComps(const RectI & renderWindow,
 
             const SRCPIX* srcPixelStart[4];
             DSTPIX* dstPixelStart[4];
-            memcpy(srcPixelStart, srcPixelPtrs, sizeof(SRCPIX) * 4);
-            memcpy(dstPixelStart, dstPixelPtrs, sizeof(DSTPIX) * 4);
-            
+            memcpy(srcPixelStart, srcPixelPtrs, sizeof(srcPixelStart));
+            memcpy(dstPixelStart, dstPixelPtrs, sizeof(dstPixelStart));
+
 
             for (int backward = 0; backward < 2; ++backward) {
                 int x = backward ? start - 1 : start;
@@ -251,7 +327,7 @@ convertToFormatInternal_sameComps(const RectI & renderWindow,
                                                                 Color::floatToInt<0xff01>(pixFloat) );
                                 pix = error[k] >> 8;
                             } else if (dstMaxValue == 65535) {
-                                pix = dstLut ? dstLut->toColorSpaceUint16FromLinearFloatFast(pixFloat) :
+                                pix = dstLut ? (DSTPIX)dstLut->toColorSpaceUint16FromLinearFloatFast(pixFloat) :
                                 Image::convertPixelDepth<float, DSTPIX>(pixFloat);
                             } else {
                                 if (dstLut) {
@@ -298,10 +374,98 @@ convertToFormatInternal_sameComps(const RectI & renderWindow,
                     }
                 }
             } // backward
-        } // !useMemcpy
+        } // !useFastPath
     } // for all lines
 } // convertToFormatInternal_sameComps
 
+///Fast version for packed RGBA <-> RGB <-> XY conversions without colorspace conversion.
+///Returns false if the conversion must go through convertToFormatInternalForColorSpace instead.
+template <typename SRCPIX, int srcMaxValue, typename DSTPIX, int dstMaxValue, int srcNComps, int dstNComps>
+static bool
+convertToFormatInternalForComps_packed(const RectI & renderWindow,
+                                       int conversionChannel,
+                                       Image::AlphaChannelHandlingEnum alphaHandling,
+                                       const void* srcBufPtrs[4],
+                                       const RectI& srcBounds,
+                                       void* dstBufPtrs[4],
+                                       const RectI& dstBounds,
+                                       const TreeRenderNodeArgsPtr& renderArgs)
+{
+    // 8-bit outputs use error diffusion, which must go through the scan-line loop
+    if ( (dstMaxValue == 255) || srcBufPtrs[1] || dstBufPtrs[1] ) {
+        return false;
+    }
+
+    // Without error diffusion each sample is converted independently: the samples of a scan-line
+    // are first converted to the destination depth, then the components are shuffled.
+    const bool sameDepth = boost::is_same<SRCPIX, DSTPIX>::value;
+    ImageConvertSIMD::ConvertSamplesFunc convertSamplesFunc = 0;
+    if (!sameDepth) {
+        convertSamplesFunc = ImageConvertSIMD::getConvertSamplesFunction( bitDepthFromPixelType<SRCPIX>(), bitDepthFromPixelType<DSTPIX>() );
+        if (!convertSamplesFunc) {
+            return false;
+        }
+    }
+
+    const bool fillFromChannel = dstNComps == 4 && srcNComps != 4 && alphaHandling == Image::eAlphaChannelHandlingFillFromChannel;
+    assert(!fillFromChannel || (conversionChannel >= 0 && conversionChannel < srcNComps));
+    const DSTPIX alphaValue = alphaHandling == Image::eAlphaChannelHandlingCreateFill0 ? (DSTPIX)0 : (DSTPIX)dstMaxValue;
+    ImageConvertSIMD::ConvertComponentsFunc convertComponentsFunc = 0;
+    if (!fillFromChannel) {
+        convertComponentsFunc = ImageConvertSIMD::getConvertComponentsFunction(bitDepthFromPixelType<DSTPIX>(), srcNComps, dstNComps);
+    }
+
+    const int width = renderWindow.width();
+    std::vector<DSTPIX> convertedRow;
+    if (!sameDepth) {
+        convertedRow.resize(width * srcNComps);
+    }
+
+    for (int y = renderWindow.y1; y < renderWindow.y2; ++y) {
+
+        if (renderArgs && renderArgs->isRenderAborted()) {
+            return true;
+        }
+
+        const SRCPIX* srcPixelPtrs[4];
+        int srcPixelStride;
+        Image::getChannelPointers<SRCPIX, srcNComps>((const SRCPIX**)srcBufPtrs, renderWindow.x1, y, srcBounds, (SRCPIX**)srcPixelPtrs, &srcPixelStride);
+
+        DSTPIX* dstPixelPtrs[4];
+        int dstPixelStride;
+        Image::getChannelPointers<DSTPIX, dstNComps>((const DSTPIX**)dstBufPtrs, renderWindow.x1, y, dstBounds, (DSTPIX**)dstPixelPtrs, &dstPixelStride);
+
+        if (!srcPixelPtrs[0] || !dstPixelPtrs[0]) {
+            continue;
+        }
+
+        const DSTPIX* src;
+        if (sameDepth) {
+            src = (const DSTPIX*)srcPixelPtrs[0];
+        } else {
+            convertSamplesFunc(srcPixelPtrs[0], &convertedRow[0], convertedRow.size());
+            src = &convertedRow[0];
+        }
+        DSTPIX* dst = dstPixelPtrs[0];
+
+        if (convertComponentsFunc) {
+            convertComponentsFunc(src, dst, width, &alphaValue);
+            continue;
+        }
+
+        for (int x = 0; x < width; ++x, src += srcNComps, dst += dstNComps) {
+            for (int k = 0; k < 3 && k < dstNComps; ++k) {
+                dst[k] = k < srcNComps ? src[k] : (DSTPIX)0;
+            }
+            if (dstNComps == 4) {
+                dst[3] = fillFromChannel ? src[conversionChannel] : alphaValue;
+            }
+        }
+    }
+
+    return true;
+} // convertToFormatInternalForComps_packed
+
 template <typename SRCPIX, int srcMaxValue, typename DSTPIX, int dstMaxValue, int srcNComps, int dstNComps, bool requiresUnpremult, bool useColorspaces>
 void
 static convertToFormatInternalForColorSpace(const RectI & renderWindow,
@@ -321,6 +485,12 @@ static convertToFormatInternalForColorSpace(const RectI & renderWindow,
     const Color::Lut* const srcLut = useColorspaces ? lutFromColorspace( (ViewerColorSpaceEnum)srcColorSpace ) : 0;
     const Color::Lut* const dstLut = useColorspaces ? lutFromColorspace( (ViewerColorSpaceEnum)dstColorSpace ) : 0;
 
+    // Unpremultiplication only applies along with a colorspace conversion
+    if ( !srcLut && !dstLut &&
+         convertToFormatInternalForComps_packed<SRCPIX, srcMaxValue, DSTPIX, dstMaxValue, srcNComps, dstNComps>(renderWindow, conversionChannel, alphaHandling, srcBufPtrs, srcBounds, dstBufPtrs, dstBounds, renderArgs) ) {
+        return;
+    }
+
     for (int y = renderWindow.y1; y < renderWindow.y2; ++y) {
         // Start of the line for error diffusion
         // coverity[dont_call]
@@ -429,7 +599,7 @@ static convertToFormatInternalForColorSpace(const RectI & renderWindow,
                                                             Color::floatToInt<0xff01>(pixFloat) );
                             pix = error[k] >> 8;
                         } else if (dstMaxValue == 65535) {
-                            pix = dstLut ? dstLut->toColorSpaceUint16FromLinearFloatFast(pixFloat) :
+                            pix = dstLut ? (DSTPIX)dstLut->toColorSpaceUint16FromLinearFloatFast(pixFloat) :
                             Image::convertPixelDepth<float, DSTPIX>(pixFloat);
                         } else {
                             if (dstLut) {
@@ -734,13 +904,13 @@ convertToFormatInternalForSrcComps(const RectI & renderWindow,
             }
         }   break;
         case 2:
-            convertToFormatInternal<SRCPIX, srcMaxValue, DSTPIX, dstMaxValue, srcNComps, 1>(renderWindow, srcColorSpace, dstColorSpace, requiresUnpremult, conversionChannel, alphaHandling, srcBufPtrs, srcBounds, dstBufPtrs, dstBounds, renderArgs);
+            convertToFormatInternal<SRCPIX, srcMaxValue, DSTPIX, dstMaxValue, srcNComps, 2>(renderWindow, srcColorSpace, dstColorSpace, requiresUnpremult, conversionChannel, alphaHandling, srcBufPtrs, srcBounds, dstBufPtrs, dstBounds, renderArgs);
             break;
         case 3:
-            convertToFormatInternal<SRCPIX, srcMaxValue, DSTPIX, dstMaxValue, srcNComps, 2>(renderWindow, srcColorSpace, dstColorSpace, requiresUnpremult, conversionChannel, alphaHandling, srcBufPtrs, srcBounds, dstBufPtrs, dstBounds, renderArgs);
+            convertToFormatInternal<SRCPIX, srcMaxValue, DSTPIX, dstMaxValue, srcNComps, 3>(renderWindow, srcColorSpace, dstColorSpace, requiresUnpremult, conversionChannel, alphaHandling, srcBufPtrs, srcBounds, dstBufPtrs, dstBounds, renderArgs);
             break;
         case 4:
-            convertToFormatInternal<SRCPIX, srcMaxValue, DSTPIX, dstMaxValue, srcNComps, 3>(renderWindow, srcColorSpace, dstColorSpace, requiresUnpremult, conversionChannel, alphaHandling, srcBufPtrs, srcBounds, dstBufPtrs, dstBounds, renderArgs);
+            convertToFormatInternal<SRCPIX, srcMaxValue, DSTPIX, dstMaxValue, srcNComps, 4>(renderWindow, srcColorSpace, dstColorSpace, requiresUnpremult, conversionChannel, alphaHandling, srcBufPtrs, srcBounds, dstBufPtrs, dstBounds, renderArgs);
             break;
         default:
             assert(false);
@@ -790,13 +960,13 @@ convertToFormatInternalForDstDepth(const RectI & renderWindow,
     switch (srcNComps) {
 
         case 2:
-            convertToFormatInternalForSrcComps<SRCPIX, srcMaxValue, DSTPIX, dstMaxValue, 1>(renderWindow, srcColorSpace, dstColorSpace, requiresUnpremult, conversionChannel, alphaHandling, srcBufPtrs, srcBounds, dstBufPtrs, dstNComps, dstBounds, renderArgs);
+            convertToFormatInternalForSrcComps<SRCPIX, srcMaxValue, DSTPIX, dstMaxValue, 2>(renderWindow, srcColorSpace, dstColorSpace, requiresUnpremult, conversionChannel, alphaHandling, srcBufPtrs, srcBounds, dstBufPtrs, dstNComps, dstBounds, renderArgs);
             break;
         case 3:
-            convertToFormatInternalForSrcComps<SRCPIX, srcMaxValue, DSTPIX, dstMaxValue, 2>(renderWindow, srcColorSpace, dstColorSpace, requiresUnpremult, conversionChannel, alphaHandling, srcBufPtrs, srcBounds, dstBufPtrs, dstNComps, dstBounds, renderArgs);
+            convertToFormatInternalForSrcComps<SRCPIX, srcMaxValue, DSTPIX, dstMaxValue, 3>(renderWindow, srcColorSpace, dstColorSpace, requiresUnpremult, conversionChannel, alphaHandling, srcBufPtrs, srcBounds, dstBufPtrs, dstNComps, dstBounds, renderArgs);
             break;
         case 4:
-            convertToFormatInternalForSrcComps<SRCPIX, srcMaxValue, DSTPIX, dstMaxValue, 3>(renderWindow, srcColorSpace, dstColorSpace, requiresUnpremult, conversionChannel, alphaHandling, srcBufPtrs, srcBounds, dstBufPtrs, dstNComps, dstBounds, renderArgs);
+            convertToFormatInternalForSrcComps<SRCPIX, srcMaxValue, DSTPIX, dstMaxValue, 4>(renderWindow, srcColorSpace, dstColorSpace, requiresUnpremult, conversionChannel, alphaHandling, srcBufPtrs, srcBounds, dstBufPtrs, dstNComps, dstBounds, renderArgs);
             break;
         default:
             assert(false);
@@ -831,6 +1001,7 @@ convertToFormatInternalForSrcDepth(const RectI & renderWindow,
             convertToFormatInternalForDstDepth<SRCPIX, srcMaxValue, unsigned short, 65535>(renderWindow, srcColorSpace, dstColorSpace, requiresUnpremult, conversionChannel, alphaHandling, monoConversion, srcBufPtrs, srcNComps, srcBounds, dstBufPtrs, dstNComps, dstBounds, renderArgs);
             break;
         case eImageBitDepthHalf:
+            convertToFormatInternalForDstDepth<SRCPIX, srcMaxValue, Half, 1>(renderWindow, srcColorSpace, dstColorSpace, requiresUnpremult, conversionChannel, alphaHandling, monoConversion, srcBufPtrs, srcNComps, srcBounds, dstBufPtrs, dstNComps, dstBounds, renderArgs);
             break;
         case eImageBitDepthFloat:
             convertToFormatInternalForDstDepth<SRCPIX, srcMaxValue, float, 1>(renderWindow, srcColorSpace, dstColorSpace, requiresUnpremult, conversionChannel, alphaHandling, monoConversion, srcBufPtrs, srcNComps, srcBounds, dstBufPtrs, dstNComps, dstBounds, renderArgs);
@@ -870,6 +1041,7 @@ ImagePrivate::convertCPUImage(const RectI & renderWindow,
             convertToFormatInternalForSrcDepth<unsigned short, 65535>(renderWindow, srcColorSpace, dstColorSpace, requiresUnpremult, conversionChannel, alphaHandling, monoConversion, srcBufPtrs, srcNComps, srcBounds, dstBufPtrs, dstNComps, dstBitDepth, dstBounds, renderArgs);
             break;
         case eImageBitDepthHalf:
+            convertToFormatInternalForSrcDepth<Half, 1>(renderWindow, srcColorSpace, dstColorSpace, requiresUnpremult, conversionChannel, alphaHandling, monoConversion, srcBufPtrs, srcNComps, srcBounds, dstBufPtrs, dstNComps, dstBitDepth, dstBounds, renderArgs);
             break;
         case eImageBitDepthFloat:
             convertToFormatInternalForSrcDepth<float, 1>(renderWindow, srcColorSpace, dstColorSpace, requiresUnpremult, conversionChannel, alphaHandling, monoConversion, srcBufPtrs, srcNComps, srcBounds, dstBufPtrs, dstNComps, dstBitDepth, dstBounds, renderArgs);
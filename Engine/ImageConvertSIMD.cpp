@@ -0,0 +1,784 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2017 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "ImageConvertSIMD.h"
+
+#include "Engine/Half.h"
+
+// SSE2 is part of the x86-64 baseline, so it can be used without runtime check
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NATRON_IMAGECONVERT_SSE2
+#include <emmintrin.h>
+#endif
+
+// AVX2 kernels are compiled with a per-function target attribute and only called if the CPU supports them
+#if defined(NATRON_IMAGECONVERT_SSE2) && ( defined(__clang__) || (defined(__GNUC__) && ( ( __GNUC__ * 100) + __GNUC_MINOR__) >= 409) || (defined(_MSC_VER) && _MSC_VER >= 1800) )
+#define NATRON_IMAGECONVERT_AVX2
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define NATRON_TARGET_AVX2
+#else
+#define NATRON_TARGET_AVX2 __attribute__( ( target("avx2") ) )
+#endif
+// The half-float conversion kernels need the F16C instructions, which come with AVX
+#define NATRON_IMAGECONVERT_F16C
+#if defined(_MSC_VER)
+#define NATRON_TARGET_F16C
+#else
+#define NATRON_TARGET_F16C __attribute__( ( target("avx,f16c") ) )
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#endif
+#endif
+#endif
+
+NATRON_NAMESPACE_ENTER;
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+// Scalar conversions used for the samples at the end of a run that do not fill a whole vector.
+// They must give exactly the same results as Image::convertPixelDepth.
+
+inline float
+uint8ToFloat(unsigned char pix)
+{
+    return pix / 255.f;
+}
+
+inline float
+uint16ToFloat(unsigned short pix)
+{
+    return pix / 65535.f;
+}
+
+template <int numvals>
+inline int
+floatToUInt(float value)
+{
+    if (value <= 0) {
+        return 0;
+    } else if (value >= 1.) {
+        return numvals - 1;
+    }
+
+    return value * (numvals - 1) + 0.5;
+}
+
+inline unsigned short
+uint8ToUInt16(unsigned char pix)
+{
+    return (unsigned short)( (pix << 8) + pix );
+}
+
+inline unsigned char
+uint16ToUInt8(unsigned short pix)
+{
+    return (unsigned char)( ( (pix + 128UL) - ( (pix + 128UL) >> 8 ) ) >> 8 );
+}
+
+#ifdef NATRON_IMAGECONVERT_SSE2
+
+/*
+ * Converts 4 floats to integers in [0, numvals - 1] the same way floatToUInt does:
+ * the product is computed in single precision, but the rounding offset is added in double precision
+ * before truncation, as in the scalar code.
+ * NaNs are mapped to 0.
+ */
+inline __m128i
+floatToUInt_SSE2(__m128 v,
+                 __m128 maxValue,
+                 __m128i maxValueInt)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.f);
+    const __m128d half = _mm_set1_pd(0.5);
+
+    __m128 scaled = _mm_mul_ps(v, maxValue);
+    __m128i lo = _mm_cvttpd_epi32( _mm_add_pd(_mm_cvtps_pd(scaled), half) );
+    __m128i hi = _mm_cvttpd_epi32( _mm_add_pd(_mm_cvtps_pd( _mm_movehl_ps(scaled, scaled) ), half) );
+    __m128i result = _mm_unpacklo_epi64(lo, hi);
+
+    // Comparisons with a NaN are false, hence NaNs fall in neither mask
+    __m128 inRange = _mm_and_ps( _mm_cmpgt_ps(v, zero), _mm_cmplt_ps(v, one) );
+    __m128 aboveRange = _mm_cmpge_ps(v, one);
+    result = _mm_and_si128( result, _mm_castps_si128(inRange) );
+    result = _mm_or_si128( result, _mm_and_si128(_mm_castps_si128(aboveRange), maxValueInt) );
+
+    return result;
+}
+
+// Packs 8 integers in [0, 65535] to unsigned shorts. SSE2 only has a signed saturating pack, so bias the values first.
+inline __m128i
+packUInt32ToUInt16_SSE2(__m128i a,
+                        __m128i b)
+{
+    const __m128i bias32 = _mm_set1_epi32(0x8000);
+    const __m128i bias16 = _mm_set1_epi16( (short)0x8000 );
+    __m128i packed = _mm_packs_epi32( _mm_sub_epi32(a, bias32), _mm_sub_epi32(b, bias32) );
+
+    return _mm_add_epi16(packed, bias16);
+}
+
+// Packs 16 integers in [0, 255] to unsigned chars
+inline __m128i
+packUInt32ToUInt8_SSE2(__m128i a,
+                       __m128i b,
+                       __m128i c,
+                       __m128i d)
+{
+    return _mm_packus_epi16( _mm_packs_epi32(a, b), _mm_packs_epi32(c, d) );
+}
+
+// Same as uint16ToUInt8 on 4 integers
+inline __m128i
+uint16ToUInt8_SSE2(__m128i v)
+{
+    const __m128i offset = _mm_set1_epi32(128);
+    __m128i x = _mm_add_epi32(v, offset);
+
+    return _mm_srli_epi32(_mm_sub_epi32( x, _mm_srli_epi32(x, 8) ), 8);
+}
+
+void
+convertUInt8ToFloat_SSE2(const void* srcPtr,
+                         void* dstPtr,
+                         std::size_t count)
+{
+    const unsigned char* src = (const unsigned char*)srcPtr;
+    float* dst = (float*)dstPtr;
+    const __m128 maxValue = _mm_set1_ps(255.f);
+    const __m128i zero = _mm_setzero_si128();
+    std::size_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        __m128i v = _mm_loadu_si128( (const __m128i*)(src + i) );
+        __m128i lo = _mm_unpacklo_epi8(v, zero);
+        __m128i hi = _mm_unpackhi_epi8(v, zero);
+        _mm_storeu_ps( dst + i, _mm_div_ps(_mm_cvtepi32_ps( _mm_unpacklo_epi16(lo, zero) ), maxValue) );
+        _mm_storeu_ps( dst + i + 4, _mm_div_ps(_mm_cvtepi32_ps( _mm_unpackhi_epi16(lo, zero) ), maxValue) );
+        _mm_storeu_ps( dst + i + 8, _mm_div_ps(_mm_cvtepi32_ps( _mm_unpacklo_epi16(hi, zero) ), maxValue) );
+        _mm_storeu_ps( dst + i + 12, _mm_div_ps(_mm_cvtepi32_ps( _mm_unpackhi_epi16(hi, zero) ), maxValue) );
+    }
+    for (; i < count; ++i) {
+        dst[i] = uint8ToFloat(src[i]);
+    }
+}
+
+void
+convertUInt16ToFloat_SSE2(const void* srcPtr,
+                          void* dstPtr,
+                          std::size_t count)
+{
+    const unsigned short* src = (const unsigned short*)srcPtr;
+    float* dst = (float*)dstPtr;
+    const __m128 maxValue = _mm_set1_ps(65535.f);
+    const __m128i zero = _mm_setzero_si128();
+    std::size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128( (const __m128i*)(src + i) );
+        _mm_storeu_ps( dst + i, _mm_div_ps(_mm_cvtepi32_ps( _mm_unpacklo_epi16(v, zero) ), maxValue) );
+        _mm_storeu_ps( dst + i + 4, _mm_div_ps(_mm_cvtepi32_ps( _mm_unpackhi_epi16(v, zero) ), maxValue) );
+    }
+    for (; i < count; ++i) {
+        dst[i] = uint16ToFloat(src[i]);
+    }
+}
+
+void
+convertFloatToUInt8_SSE2(const void* srcPtr,
+                         void* dstPtr,
+                         std::size_t count)
+{
+    const float* src = (const float*)srcPtr;
+    unsigned char* dst = (unsigned char*)dstPtr;
+    const __m128 maxValue = _mm_set1_ps(255.f);
+    const __m128i maxValueInt = _mm_set1_epi32(255);
+    std::size_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        __m128i a = floatToUInt_SSE2(_mm_loadu_ps(src + i), maxValue, maxValueInt);
+        __m128i b = floatToUInt_SSE2(_mm_loadu_ps(src + i + 4), maxValue, maxValueInt);
+        __m128i c = floatToUInt_SSE2(_mm_loadu_ps(src + i + 8), maxValue, maxValueInt);
+        __m128i d = floatToUInt_SSE2(_mm_loadu_ps(src + i + 12), maxValue, maxValueInt);
+        _mm_storeu_si128( (__m128i*)(dst + i), packUInt32ToUInt8_SSE2(a, b, c, d) );
+    }
+    for (; i < count; ++i) {
+        dst[i] = (unsigned char)floatToUInt<256>(src[i]);
+    }
+}
+
+void
+convertFloatToUInt16_SSE2(const void* srcPtr,
+                          void* dstPtr,
+                          std::size_t count)
+{
+    const float* src = (const float*)srcPtr;
+    unsigned short* dst = (unsigned short*)dstPtr;
+    const __m128 maxValue = _mm_set1_ps(65535.f);
+    const __m128i maxValueInt = _mm_set1_epi32(65535);
+    std::size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i a = floatToUInt_SSE2(_mm_loadu_ps(src + i), maxValue, maxValueInt);
+        __m128i b = floatToUInt_SSE2(_mm_loadu_ps(src + i + 4), maxValue, maxValueInt);
+        _mm_storeu_si128( (__m128i*)(dst + i), packUInt32ToUInt16_SSE2(a, b) );
+    }
+    for (; i < count; ++i) {
+        dst[i] = (unsigned short)floatToUInt<65536>(src[i]);
+    }
+}
+
+void
+convertUInt8ToUInt16_SSE2(const void* srcPtr,
+                          void* dstPtr,
+                          std::size_t count)
+{
+    const unsigned char* src = (const unsigned char*)srcPtr;
+    unsigned short* dst = (unsigned short*)dstPtr;
+    std::size_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        __m128i v = _mm_loadu_si128( (const __m128i*)(src + i) );
+        // Interleaving a byte with itself gives (pix << 8) + pix
+        _mm_storeu_si128( (__m128i*)(dst + i), _mm_unpacklo_epi8(v, v) );
+        _mm_storeu_si128( (__m128i*)(dst + i + 8), _mm_unpackhi_epi8(v, v) );
+    }
+    for (; i < count; ++i) {
+        dst[i] = uint8ToUInt16(src[i]);
+    }
+}
+
+void
+convertUInt16ToUInt8_SSE2(const void* srcPtr,
+                          void* dstPtr,
+                          std::size_t count)
+{
+    const unsigned short* src = (const unsigned short*)srcPtr;
+    unsigned char* dst = (unsigned char*)dstPtr;
+    const __m128i zero = _mm_setzero_si128();
+    std::size_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        __m128i v0 = _mm_loadu_si128( (const __m128i*)(src + i) );
+        __m128i v1 = _mm_loadu_si128( (const __m128i*)(src + i + 8) );
+        __m128i a = uint16ToUInt8_SSE2( _mm_unpacklo_epi16(v0, zero) );
+        __m128i b = uint16ToUInt8_SSE2( _mm_unpackhi_epi16(v0, zero) );
+        __m128i c = uint16ToUInt8_SSE2( _mm_unpacklo_epi16(v1, zero) );
+        __m128i d = uint16ToUInt8_SSE2( _mm_unpackhi_epi16(v1, zero) );
+        _mm_storeu_si128( (__m128i*)(dst + i), packUInt32ToUInt8_SSE2(a, b, c, d) );
+    }
+    for (; i < count; ++i) {
+        dst[i] = uint16ToUInt8(src[i]);
+    }
+}
+
+/*
+ * Component conversions only move the 32-bit samples with shuffles: the output is bit-exact, NaNs included.
+ */
+void
+convertRGBAToRGBFloat_SSE2(const void* srcPtr,
+                           void* dstPtr,
+                           std::size_t count,
+                           const void* /*alphaValue*/)
+{
+    const float* src = (const float*)srcPtr;
+    float* dst = (float*)dstPtr;
+    std::size_t i = 0;
+
+    // 4 pixels at a time
+    for (; i + 4 <= count; i += 4, src += 16, dst += 12) {
+        __m128 p0 = _mm_loadu_ps(src);
+        __m128 p1 = _mm_loadu_ps(src + 4);
+        __m128 p2 = _mm_loadu_ps(src + 8);
+        __m128 p3 = _mm_loadu_ps(src + 12);
+
+        // b0 b0 r1 r1 -> r0 g0 b0 r1
+        __m128 t = _mm_shuffle_ps( p0, p1, _MM_SHUFFLE(0, 0, 2, 2) );
+        _mm_storeu_ps( dst, _mm_shuffle_ps( p0, t, _MM_SHUFFLE(2, 0, 1, 0) ) );
+        // g1 b1 r2 g2
+        _mm_storeu_ps( dst + 4, _mm_shuffle_ps( p1, p2, _MM_SHUFFLE(1, 0, 2, 1) ) );
+        // b2 b2 r3 r3 -> b2 r3 g3 b3
+        t = _mm_shuffle_ps( p2, p3, _MM_SHUFFLE(0, 0, 2, 2) );
+        _mm_storeu_ps( dst + 8, _mm_shuffle_ps( t, p3, _MM_SHUFFLE(2, 1, 2, 0) ) );
+    }
+    for (; i < count; ++i, src += 4, dst += 3) {
+        dst[0] = src[0];
+        dst[1] = src[1];
+        dst[2] = src[2];
+    }
+}
+
+void
+convertRGBToRGBAFloat_SSE2(const void* srcPtr,
+                           void* dstPtr,
+                           std::size_t count,
+                           const void* alphaValue)
+{
+    const float* src = (const float*)srcPtr;
+    float* dst = (float*)dstPtr;
+    const float alpha = *(const float*)alphaValue;
+    const __m128 a = _mm_set1_ps(alpha);
+    std::size_t i = 0;
+
+    // 4 pixels at a time
+    for (; i + 4 <= count; i += 4, src += 12, dst += 16) {
+        __m128 i0 = _mm_loadu_ps(src);      // r0 g0 b0 r1
+        __m128 i1 = _mm_loadu_ps(src + 4);  // g1 b1 r2 g2
+        __m128 i2 = _mm_loadu_ps(src + 8);  // b2 r3 g3 b3
+
+        // b0 b0 a a -> r0 g0 b0 a
+        __m128 t = _mm_shuffle_ps( i0, a, _MM_SHUFFLE(0, 0, 2, 2) );
+        _mm_storeu_ps( dst, _mm_shuffle_ps( i0, t, _MM_SHUFFLE(2, 0, 1, 0) ) );
+        // r1 r1 g1 b1 and b1 b1 a a -> r1 g1 b1 a
+        __m128 u = _mm_shuffle_ps( i0, i1, _MM_SHUFFLE(1, 0, 3, 3) );
+        t = _mm_shuffle_ps( i1, a, _MM_SHUFFLE(0, 0, 1, 1) );
+        _mm_storeu_ps( dst + 4, _mm_shuffle_ps( u, t, _MM_SHUFFLE(2, 0, 2, 1) ) );
+        // b2 b2 a a -> r2 g2 b2 a
+        t = _mm_shuffle_ps( i2, a, _MM_SHUFFLE(0, 0, 0, 0) );
+        _mm_storeu_ps( dst + 8, _mm_shuffle_ps( i1, t, _MM_SHUFFLE(2, 0, 3, 2) ) );
+        // b3 b3 a a -> r3 g3 b3 a
+        t = _mm_shuffle_ps( i2, a, _MM_SHUFFLE(0, 0, 3, 3) );
+        _mm_storeu_ps( dst + 12, _mm_shuffle_ps( i2, t, _MM_SHUFFLE(2, 0, 2, 1) ) );
+    }
+    for (; i < count; ++i, src += 3, dst += 4) {
+        dst[0] = src[0];
+        dst[1] = src[1];
+        dst[2] = src[2];
+        dst[3] = alpha;
+    }
+}
+
+#endif // NATRON_IMAGECONVERT_SSE2
+
+#ifdef NATRON_IMAGECONVERT_AVX2
+
+// Same as floatToUInt_SSE2 on 8 floats
+NATRON_TARGET_AVX2
+inline __m256i
+floatToUInt_AVX2(__m256 v,
+                 __m256 maxValue,
+                 __m256i maxValueInt)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.f);
+    const __m256d half = _mm256_set1_pd(0.5);
+
+    __m256 scaled = _mm256_mul_ps(v, maxValue);
+    __m128i lo = _mm256_cvttpd_epi32( _mm256_add_pd(_mm256_cvtps_pd( _mm256_castps256_ps128(scaled) ), half) );
+    __m128i hi = _mm256_cvttpd_epi32( _mm256_add_pd(_mm256_cvtps_pd( _mm256_extractf128_ps(scaled, 1) ), half) );
+    __m256i result = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+
+    __m256 inRange = _mm256_and_ps( _mm256_cmp_ps(v, zero, _CMP_GT_OQ), _mm256_cmp_ps(v, one, _CMP_LT_OQ) );
+    __m256 aboveRange = _mm256_cmp_ps(v, one, _CMP_GE_OQ);
+    result = _mm256_and_si256( result, _mm256_castps_si256(inRange) );
+    result = _mm256_or_si256( result, _mm256_and_si256(_mm256_castps_si256(aboveRange), maxValueInt) );
+
+    return result;
+}
+
+// Same as uint16ToUInt8_SSE2 on 8 integers
+NATRON_TARGET_AVX2
+inline __m256i
+uint16ToUInt8_AVX2(__m256i v)
+{
+    const __m256i offset = _mm256_set1_epi32(128);
+    __m256i x = _mm256_add_epi32(v, offset);
+
+    return _mm256_srli_epi32(_mm256_sub_epi32( x, _mm256_srli_epi32(x, 8) ), 8);
+}
+
+// The AVX2 pack instructions work within 128-bit lanes: pack the 128-bit halves with SSE2 to keep the samples ordered.
+NATRON_TARGET_AVX2
+inline __m128i
+packUInt32ToUInt16_AVX2(__m256i v)
+{
+    const __m128i bias32 = _mm_set1_epi32(0x8000);
+    const __m128i bias16 = _mm_set1_epi16( (short)0x8000 );
+    __m128i packed = _mm_packs_epi32( _mm_sub_epi32(_mm256_castsi256_si128(v), bias32), _mm_sub_epi32(_mm256_extracti128_si256(v, 1), bias32) );
+
+    return _mm_add_epi16(packed, bias16);
+}
+
+NATRON_TARGET_AVX2
+inline __m128i
+packUInt32ToUInt8_AVX2(__m256i a,
+                       __m256i b)
+{
+    return _mm_packus_epi16( _mm_packs_epi32( _mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1) ),
+                             _mm_packs_epi32( _mm256_castsi256_si128(b), _mm256_extracti128_si256(b, 1) ) );
+}
+
+NATRON_TARGET_AVX2
+void
+convertUInt8ToFloat_AVX2(const void* srcPtr,
+                         void* dstPtr,
+                         std::size_t count)
+{
+    const unsigned char* src = (const unsigned char*)srcPtr;
+    float* dst = (float*)dstPtr;
+    const __m256 maxValue = _mm256_set1_ps(255.f);
+    std::size_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        __m128i v = _mm_loadu_si128( (const __m128i*)(src + i) );
+        _mm256_storeu_ps( dst + i, _mm256_div_ps(_mm256_cvtepi32_ps( _mm256_cvtepu8_epi32(v) ), maxValue) );
+        _mm256_storeu_ps( dst + i + 8, _mm256_div_ps(_mm256_cvtepi32_ps( _mm256_cvtepu8_epi32( _mm_srli_si128(v, 8) ) ), maxValue) );
+    }
+    for (; i < count; ++i) {
+        dst[i] = uint8ToFloat(src[i]);
+    }
+}
+
+NATRON_TARGET_AVX2
+void
+convertUInt16ToFloat_AVX2(const void* srcPtr,
+                          void* dstPtr,
+                          std::size_t count)
+{
+    const unsigned short* src = (const unsigned short*)srcPtr;
+    float* dst = (float*)dstPtr;
+    const __m256 maxValue = _mm256_set1_ps(65535.f);
+    std::size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128( (const __m128i*)(src + i) );
+        _mm256_storeu_ps( dst + i, _mm256_div_ps(_mm256_cvtepi32_ps( _mm256_cvtepu16_epi32(v) ), maxValue) );
+    }
+    for (; i < count; ++i) {
+        dst[i] = uint16ToFloat(src[i]);
+    }
+}
+
+NATRON_TARGET_AVX2
+void
+convertFloatToUInt8_AVX2(const void* srcPtr,
+                         void* dstPtr,
+                         std::size_t count)
+{
+    const float* src = (const float*)srcPtr;
+    unsigned char* dst = (unsigned char*)dstPtr;
+    const __m256 maxValue = _mm256_set1_ps(255.f);
+    const __m256i maxValueInt = _mm256_set1_epi32(255);
+    std::size_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        __m256i a = floatToUInt_AVX2(_mm256_loadu_ps(src + i), maxValue, maxValueInt);
+        __m256i b = floatToUInt_AVX2(_mm256_loadu_ps(src + i + 8), maxValue, maxValueInt);
+        _mm_storeu_si128( (__m128i*)(dst + i), packUInt32ToUInt8_AVX2(a, b) );
+    }
+    for (; i < count; ++i) {
+        dst[i] = (unsigned char)floatToUInt<256>(src[i]);
+    }
+}
+
+NATRON_TARGET_AVX2
+void
+convertFloatToUInt16_AVX2(const void* srcPtr,
+                          void* dstPtr,
+                          std::size_t count)
+{
+    const float* src = (const float*)srcPtr;
+    unsigned short* dst = (unsigned short*)dstPtr;
+    const __m256 maxValue = _mm256_set1_ps(65535.f);
+    const __m256i maxValueInt = _mm256_set1_epi32(65535);
+    std::size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256i a = floatToUInt_AVX2(_mm256_loadu_ps(src + i), maxValue, maxValueInt);
+        _mm_storeu_si128( (__m128i*)(dst + i), packUInt32ToUInt16_AVX2(a) );
+    }
+    for (; i < count; ++i) {
+        dst[i] = (unsigned short)floatToUInt<65536>(src[i]);
+    }
+}
+
+NATRON_TARGET_AVX2
+void
+convertUInt8ToUInt16_AVX2(const void* srcPtr,
+                          void* dstPtr,
+                          std::size_t count)
+{
+    const unsigned char* src = (const unsigned char*)srcPtr;
+    unsigned short* dst = (unsigned short*)dstPtr;
+    std::size_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        __m256i v = _mm256_cvtepu8_epi16( _mm_loadu_si128( (const __m128i*)(src + i) ) );
+        _mm256_storeu_si256( (__m256i*)(dst + i), _mm256_or_si256(_mm256_slli_epi16(v, 8), v) );
+    }
+    for (; i < count; ++i) {
+        dst[i] = uint8ToUInt16(src[i]);
+    }
+}
+
+NATRON_TARGET_AVX2
+void
+convertUInt16ToUInt8_AVX2(const void* srcPtr,
+                          void* dstPtr,
+                          std::size_t count)
+{
+    const unsigned short* src = (const unsigned short*)srcPtr;
+    unsigned char* dst = (unsigned char*)dstPtr;
+    std::size_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        __m256i a = uint16ToUInt8_AVX2( _mm256_cvtepu16_epi32( _mm_loadu_si128( (const __m128i*)(src + i) ) ) );
+        __m256i b = uint16ToUInt8_AVX2( _mm256_cvtepu16_epi32( _mm_loadu_si128( (const __m128i*)(src + i + 8) ) ) );
+        _mm_storeu_si128( (__m128i*)(dst + i), packUInt32ToUInt8_AVX2(a, b) );
+    }
+    for (; i < count; ++i) {
+        dst[i] = uint16ToUInt8(src[i]);
+    }
+}
+
+#endif // NATRON_IMAGECONVERT_AVX2
+
+#ifdef NATRON_IMAGECONVERT_F16C
+
+// Scalar conversions give the same results as the F16C instructions, see Half
+NATRON_TARGET_F16C
+void
+convertHalfToFloat_F16C(const void* srcPtr,
+                        void* dstPtr,
+                        std::size_t count)
+{
+    const unsigned short* src = (const unsigned short*)srcPtr;
+    float* dst = (float*)dstPtr;
+    std::size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps( dst + i, _mm256_cvtph_ps( _mm_loadu_si128( (const __m128i*)(src + i) ) ) );
+    }
+    for (; i < count; ++i) {
+        dst[i] = Half::halfBitsToFloat(src[i]);
+    }
+}
+
+NATRON_TARGET_F16C
+void
+convertFloatToHalf_F16C(const void* srcPtr,
+                        void* dstPtr,
+                        std::size_t count)
+{
+    const float* src = (const float*)srcPtr;
+    unsigned short* dst = (unsigned short*)dstPtr;
+    std::size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        _mm_storeu_si128( (__m128i*)(dst + i), _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT) );
+    }
+    for (; i < count; ++i) {
+        dst[i] = Half::floatToHalfBits(src[i]);
+    }
+}
+
+// Returns true if the CPU supports F16C and the OS saves the YMM registers
+bool
+cpuSupportsF16C()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    const int ecx = info[2];
+#else
+    unsigned int eax, ebx, ecx, edx;
+    if ( !__get_cpuid(1, &eax, &ebx, &ecx, &edx) ) {
+        return false;
+    }
+#endif
+    const bool osUsesXSave = (ecx & (1 << 27)) != 0;
+    const bool cpuHasAVX = (ecx & (1 << 28)) != 0;
+    const bool cpuHasF16C = (ecx & (1 << 29)) != 0;
+    if (!osUsesXSave || !cpuHasAVX || !cpuHasF16C) {
+        return false;
+    }
+#if defined(_MSC_VER)
+    const unsigned long long xcr0 = _xgetbv(0);
+#else
+    unsigned int xcr0Low, xcr0High;
+    __asm__ __volatile__ ("xgetbv" : "=a" (xcr0Low), "=d" (xcr0High) : "c" (0));
+    const unsigned int xcr0 = xcr0Low;
+#endif
+
+    return (xcr0 & 0x6) == 0x6;
+}
+
+#endif // NATRON_IMAGECONVERT_F16C
+
+ImageConvertSIMD::InstructionSetEnum
+detectInstructionSet()
+{
+#ifdef NATRON_IMAGECONVERT_F16C
+    if ( cpuSupportsF16C() ) {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] >= 7) {
+            __cpuidex(info, 7, 0);
+            if (info[1] & (1 << 5)) {
+                return ImageConvertSIMD::eInstructionSetAVX2;
+            }
+        }
+#else
+        __builtin_cpu_init();
+        if ( __builtin_cpu_supports("avx2") ) {
+            return ImageConvertSIMD::eInstructionSetAVX2;
+        }
+#endif
+
+        return ImageConvertSIMD::eInstructionSetF16C;
+    }
+#endif // NATRON_IMAGECONVERT_F16C
+
+#ifdef NATRON_IMAGECONVERT_SSE2
+    return ImageConvertSIMD::eInstructionSetSSE2;
+#else
+
+    return ImageConvertSIMD::eInstructionSetNone;
+#endif
+}
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+
+ImageConvertSIMD::InstructionSetEnum
+ImageConvertSIMD::getSupportedInstructionSet()
+{
+    static const InstructionSetEnum instructionSet = detectInstructionSet();
+
+    return instructionSet;
+}
+
+ImageConvertSIMD::ConvertSamplesFunc
+ImageConvertSIMD::getConvertSamplesFunction(ImageBitDepthEnum srcDepth,
+                                            ImageBitDepthEnum dstDepth)
+{
+    return getConvertSamplesFunction( srcDepth, dstDepth, getSupportedInstructionSet() );
+}
+
+ImageConvertSIMD::ConvertSamplesFunc
+ImageConvertSIMD::getConvertSamplesFunction(ImageBitDepthEnum srcDepth,
+                                            ImageBitDepthEnum dstDepth,
+                                            InstructionSetEnum instructionSet)
+{
+    if ( instructionSet > getSupportedInstructionSet() ) {
+        return 0;
+    }
+    switch (instructionSet) {
+    case eInstructionSetNone:
+        break;
+#ifdef NATRON_IMAGECONVERT_SSE2
+    case eInstructionSetSSE2:
+        if ( (srcDepth == eImageBitDepthByte) && (dstDepth == eImageBitDepthFloat) ) {
+            return convertUInt8ToFloat_SSE2;
+        } else if ( (srcDepth == eImageBitDepthShort) && (dstDepth == eImageBitDepthFloat) ) {
+            return convertUInt16ToFloat_SSE2;
+        } else if ( (srcDepth == eImageBitDepthFloat) && (dstDepth == eImageBitDepthByte) ) {
+            return convertFloatToUInt8_SSE2;
+        } else if ( (srcDepth == eImageBitDepthFloat) && (dstDepth == eImageBitDepthShort) ) {
+            return convertFloatToUInt16_SSE2;
+        } else if ( (srcDepth == eImageBitDepthByte) && (dstDepth == eImageBitDepthShort) ) {
+            return convertUInt8ToUInt16_SSE2;
+        } else if ( (srcDepth == eImageBitDepthShort) && (dstDepth == eImageBitDepthByte) ) {
+            return convertUInt16ToUInt8_SSE2;
+        }
+        break;
+#endif
+#ifdef NATRON_IMAGECONVERT_F16C
+    case eInstructionSetF16C:
+        if ( (srcDepth == eImageBitDepthHalf) && (dstDepth == eImageBitDepthFloat) ) {
+            return convertHalfToFloat_F16C;
+        } else if ( (srcDepth == eImageBitDepthFloat) && (dstDepth == eImageBitDepthHalf) ) {
+            return convertFloatToHalf_F16C;
+        }
+
+        // CPUs with F16C but without AVX2 still have the SSE2 kernels for the other bit depths
+        return getConvertSamplesFunction(srcDepth, dstDepth, eInstructionSetSSE2);
+#endif
+#ifdef NATRON_IMAGECONVERT_AVX2
+    case eInstructionSetAVX2:
+        if ( (srcDepth == eImageBitDepthByte) && (dstDepth == eImageBitDepthFloat) ) {
+            return convertUInt8ToFloat_AVX2;
+        } else if ( (srcDepth == eImageBitDepthShort) && (dstDepth == eImageBitDepthFloat) ) {
+            return convertUInt16ToFloat_AVX2;
+        } else if ( (srcDepth == eImageBitDepthFloat) && (dstDepth == eImageBitDepthByte) ) {
+            return convertFloatToUInt8_AVX2;
+        } else if ( (srcDepth == eImageBitDepthFloat) && (dstDepth == eImageBitDepthShort) ) {
+            return convertFloatToUInt16_AVX2;
+        } else if ( (srcDepth == eImageBitDepthByte) && (dstDepth == eImageBitDepthShort) ) {
+            return convertUInt8ToUInt16_AVX2;
+        } else if ( (srcDepth == eImageBitDepthShort) && (dstDepth == eImageBitDepthByte) ) {
+            return convertUInt16ToUInt8_AVX2;
+        } else if ( (srcDepth == eImageBitDepthHalf) && (dstDepth == eImageBitDepthFloat) ) {
+            return convertHalfToFloat_F16C;
+        } else if ( (srcDepth == eImageBitDepthFloat) && (dstDepth == eImageBitDepthHalf) ) {
+            return convertFloatToHalf_F16C;
+        }
+        break;
+#endif
+    default:
+        break;
+    }
+
+    return 0;
+} // getConvertSamplesFunction
+
+ImageConvertSIMD::ConvertComponentsFunc
+ImageConvertSIMD::getConvertComponentsFunction(ImageBitDepthEnum depth,
+                                               int srcNComps,
+                                               int dstNComps)
+{
+    return getConvertComponentsFunction( depth, srcNComps, dstNComps, getSupportedInstructionSet() );
+}
+
+ImageConvertSIMD::ConvertComponentsFunc
+ImageConvertSIMD::getConvertComponentsFunction(ImageBitDepthEnum depth,
+                                               int srcNComps,
+                                               int dstNComps,
+                                               InstructionSetEnum instructionSet)
+{
+    if ( (instructionSet == eInstructionSetNone) || ( instructionSet > getSupportedInstructionSet() ) ) {
+        return 0;
+    }
+#ifdef NATRON_IMAGECONVERT_SSE2
+    // Shuffles are bound by the memory bandwidth: the SSE2 kernels are used with all instruction sets
+    if (depth == eImageBitDepthFloat) {
+        if ( (srcNComps == 4) && (dstNComps == 3) ) {
+            return convertRGBAToRGBFloat_SSE2;
+        } else if ( (srcNComps == 3) && (dstNComps == 4) ) {
+            return convertRGBToRGBAFloat_SSE2;
+        }
+    }
+#else
+    Q_UNUSED(depth);
+    Q_UNUSED(srcNComps);
+    Q_UNUSED(dstNComps);
+#endif
+
+    return 0;
+} // getConvertComponentsFunction
+
+NATRON_NAMESPACE_EXIT;
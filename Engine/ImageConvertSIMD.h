@@ -0,0 +1,105 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2017 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_IMAGECONVERTSIMD_H
+#define NATRON_ENGINE_IMAGECONVERTSIMD_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cstddef>
+
+#include "Global/GlobalDefines.h"
+
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER;
+
+/**
+ * @brief Vectorized kernels used by Image::copyPixels to convert runs of samples between bit depths,
+ * and runs of packed pixels between RGBA and RGB.
+ * The kernel is selected at runtime depending on the instruction sets supported by the CPU.
+ * Each kernel produces exactly the same output as Image::convertPixelDepth, which remains the reference
+ * implementation and is used whenever no kernel is available.
+ **/
+class ImageConvertSIMD
+{
+public:
+
+    // Each instruction set implies the previous ones: AVX2 is only reported if F16C is available too,
+    // which is the case of all the CPUs supporting AVX2.
+    enum InstructionSetEnum
+    {
+        eInstructionSetNone = 0,
+        eInstructionSetSSE2,
+        eInstructionSetF16C, // AVX with the half-float conversion instructions
+        eInstructionSetAVX2
+    };
+
+    /**
+     * @brief Converts count contiguous samples from src to dst.
+     * The buffers may be unaligned and must not overlap.
+     **/
+    typedef void (*ConvertSamplesFunc)(const void* src, void* dst, std::size_t count);
+
+    /**
+     * @brief Returns the widest instruction set supported by both the build and the CPU.
+     * The CPU is only queried once.
+     **/
+    static InstructionSetEnum getSupportedInstructionSet();
+
+    /**
+     * @brief Returns the kernel converting from srcDepth to dstDepth with the best supported instruction set,
+     * or NULL if there is none, in which case the caller should fall back on the scalar code.
+     **/
+    static ConvertSamplesFunc getConvertSamplesFunction(ImageBitDepthEnum srcDepth, ImageBitDepthEnum dstDepth);
+
+    /**
+     * @brief Same as above but for the given instruction set. Returns NULL if the instruction set
+     * is not supported by the CPU. This is used by the unit tests to check each kernel against the scalar code.
+     **/
+    static ConvertSamplesFunc getConvertSamplesFunction(ImageBitDepthEnum srcDepth, ImageBitDepthEnum dstDepth, InstructionSetEnum instructionSet);
+
+    /**
+     * @brief Converts count packed pixels from src to dst, both of the same bit depth, between RGBA and RGB:
+     * RGBA to RGB drops the alpha channel, RGB to RGBA sets it to the sample pointed to by alphaValue.
+     * The buffers may be unaligned and must not overlap.
+     **/
+    typedef void (*ConvertComponentsFunc)(const void* src, void* dst, std::size_t count, const void* alphaValue);
+
+    /**
+     * @brief Returns the kernel converting packed pixels of the given bit depth from srcNComps to dstNComps components
+     * with the best supported instruction set, or NULL if there is none.
+     **/
+    static ConvertComponentsFunc getConvertComponentsFunction(ImageBitDepthEnum depth, int srcNComps, int dstNComps);
+
+    /**
+     * @brief Same as above but for the given instruction set. Returns NULL if the instruction set
+     * is not supported by the CPU.
+     **/
+    static ConvertComponentsFunc getConvertComponentsFunction(ImageBitDepthEnum depth, int srcNComps, int dstNComps, InstructionSetEnum instructionSet);
+};
+
+NATRON_NAMESPACE_EXIT;
+
+#endif // NATRON_ENGINE_IMAGECONVERTSIMD_H
@@ -139,7 +139,7 @@ copyUnProcessedChannels_templated(const void* originalImgPtrs[4],
             // we do not want to change the values behind his back.
             // Rather we display a warning in  the GUI.
 
-#           define DOCHANNEL(c) *dstPixelPtrs[c] = (c >= srcNComps || !srcPixelPtrs[c]) ? 0 : *srcPixelPtrs[c];
+#           define DOCHANNEL(c) *dstPixelPtrs[c] = (c >= srcNComps || !srcPixelPtrs[c]) ? (PIX)0 : *srcPixelPtrs[c];
 
 #         endif // !NATRON_COPY_CHANNELS_UNPREMULT
 
@@ -588,8 +588,10 @@ ImagePrivate::copyUnprocessedChannelsCPU(const void* originalImgPtrs[4],
         case eImageBitDepthShort:
             copyUnProcessedChannelsForDepth<unsigned short, 65535>(originalImgPtrs, originalImgBounds, originalImgNComps, dstImgPtrs, dstImgNComps, dstBounds, processChannels, roi, renderArgs);
             break;
-
         case eImageBitDepthHalf:
+            copyUnProcessedChannelsForDepth<Half, 1>(originalImgPtrs, originalImgBounds, originalImgNComps, dstImgPtrs, dstImgNComps, dstBounds, processChannels, roi, renderArgs);
+            break;
+
         case eImageBitDepthNone:
 
             break;
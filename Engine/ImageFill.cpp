@@ -189,7 +189,7 @@ fillForDepthForComponents(void* ptrs[4],
             for (int c = 0; c < 4; ++c) {
                 if (dstPixelPtrs[c]) {
                     *dstPixelPtrs[c] = fillValue[c];
-                    ++dstPixelPtrs[c];
+                    dstPixelPtrs[c] += dstPixelStride;
                 }
             }
         }
@@ -262,6 +262,8 @@ ImagePrivate::fillCPU(void* ptrs[4],
             fillForDepth<unsigned short, 65535>(ptrs, r, g, b, a, nComps, bounds, roi, renderArgs);
             break;
         case eImageBitDepthHalf:
+            fillForDepth<Half, 1>(ptrs, r, g, b, a, nComps, bounds, roi, renderArgs);
+            break;
         default:
             break;
     }
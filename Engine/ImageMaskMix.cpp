@@ -168,6 +168,9 @@ applyMaskMixForDstComponents(const void* originalImgPtrs[4],
         case eImageBitDepthShort:
             applyMaskMixForDepth<srcNComps, dstNComps, unsigned short, 65535>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, mix, invertMask, bounds, roi, renderArgs);
             break;
+        case eImageBitDepthHalf:
+            applyMaskMixForDepth<srcNComps, dstNComps, Half, 1>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, mix, invertMask, bounds, roi, renderArgs);
+            break;
         case eImageBitDepthFloat:
             applyMaskMixForDepth<srcNComps, dstNComps, float, 1>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, mix, invertMask, bounds, roi, renderArgs);
             break;
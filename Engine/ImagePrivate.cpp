@@ -25,6 +25,10 @@
 
 #include "ImagePrivate.h"
 
+#include <algorithm> // min, max
+#include <cstring> // memcpy, memset
+#include <stdexcept>
+
 NATRON_NAMESPACE_ENTER;
 
 int
@@ -33,10 +37,364 @@ ImagePrivate::getNTilesPerLine() const
     if (tiles.empty()) {
         return 0;
     }
-    int tileSizeX = tiles[0].tileBounds.width();
-    return bounds.width() / tileSizeX;
+    if (tileSizeX == 0) {
+        // Untiled
+        return 1;
+    }
+    // The last tile of a line may be smaller
+    return (bounds.width() + tileSizeX - 1) / tileSizeX;
+}
+
+void
+ImagePrivate::ensureTileAllocated(const Image::Tile& tile)
+{
+    for (std::size_t c = 0; c < tile.perChannelTile.size(); ++c) {
+        if (tile.perChannelTile[c].buffer) {
+            tile.perChannelTile[c].buffer->ensureAllocated();
+        }
+    }
 }
 
+bool
+ImagePrivate::isTileUnallocated(const Image::Tile& tile, float fillValues[4])
+{
+    if (tile.perChannelTile.empty()) {
+        return false;
+    }
+    fillValues[0] = fillValues[1] = fillValues[2] = fillValues[3] = 0.f;
+    for (std::size_t c = 0; c < tile.perChannelTile.size(); ++c) {
+        const Image::MonoChannelTile& channelTile = tile.perChannelTile[c];
+        if (!channelTile.buffer || channelTile.channelIndex < 0 || channelTile.channelIndex >= 4) {
+            return false;
+        }
+        if (!channelTile.buffer->isLazyAllocationPending(&fillValues[channelTile.channelIndex])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+ImageStorageBasePtr
+ImagePrivate::createSparseTileStorage(const CachePtr& cache,
+                                      StorageModeEnum storage,
+                                      ImageBitDepthEnum bitdepth,
+                                      const RectI& tileBounds,
+                                      float fillValue)
+{
+    ImageStorageBasePtr ret;
+    boost::shared_ptr<AllocateMemoryArgs> allocArgs;
+    switch (storage) {
+        case eStorageModeDisk: {
+            ret.reset(new CacheImageTileStorage(cache));
+            allocArgs.reset(new AllocateMemoryArgs());
+        }   break;
+        case eStorageModeRAM: {
+            ret.reset(new RAMImageStorage());
+            boost::shared_ptr<RAMAllocateMemoryArgs> a(new RAMAllocateMemoryArgs());
+            a->bounds = tileBounds;
+            a->numComponents = 1;
+            allocArgs = a;
+        }   break;
+        case eStorageModeGLTex:
+        case eStorageModeNone:
+            // Sparse images are mono-channel tiled, which OpenGL textures do not support
+            assert(false);
+            throw std::bad_alloc();
+            break;
+    }
+    allocArgs->bitDepth = bitdepth;
+    ret->setLazyAllocation(allocArgs, fillValue);
+    return ret;
+} // createSparseTileStorage
+
+bool
+ImagePrivate::extendSparseTiles(const RectI& roi)
+{
+    if (!sparse || tiles.empty() || tileSizeX == 0 || tileSizeY == 0) {
+        return false;
+    }
+
+    // Tiles that are cached must keep their coordinates: only extend images that are not cached
+    if (cachePolicy != eCacheAccessModeNone) {
+        return false;
+    }
+
+    // The tiles shared with another image are flagged by index
+    {
+        QMutexLocker k(&copyOnWriteMutex);
+        if ( !copyOnWriteTiles.empty() ) {
+            return false;
+        }
+    }
+
+    const StorageModeEnum storage = tiles[0].perChannelTile[0].buffer->getStorageMode();
+    const ImageBitDepthEnum bitdepth = tiles[0].perChannelTile[0].buffer->getBitDepth();
+
+    // Extend the bounds by whole tiles on the bottom-left so that existing tiles keep their position
+    // relative to the origin of the image. The top-right edge may end in the middle of a tile.
+    RectI newBounds = bounds;
+    if (roi.x1 < bounds.x1) {
+        newBounds.x1 = bounds.x1 - ( (bounds.x1 - roi.x1 + tileSizeX - 1) / tileSizeX ) * tileSizeX;
+    }
+    if (roi.y1 < bounds.y1) {
+        newBounds.y1 = bounds.y1 - ( (bounds.y1 - roi.y1 + tileSizeY - 1) / tileSizeY ) * tileSizeY;
+    }
+    newBounds.x2 = std::max(bounds.x2, roi.x2);
+    newBounds.y2 = std::max(bounds.y2, roi.y2);
+
+    const int offsetTx = (bounds.x1 - newBounds.x1) / tileSizeX;
+    const int offsetTy = (bounds.y1 - newBounds.y1) / tileSizeY;
+    const int oldNTilesPerLine = getNTilesPerLine();
+    const int oldNTilesPerColumn = (bounds.height() + tileSizeY - 1) / tileSizeY;
+    const int nTilesPerLine = (newBounds.width() + tileSizeX - 1) / tileSizeX;
+    const int nTilesPerColumn = (newBounds.height() + tileSizeY - 1) / tileSizeY;
+
+    CachePtr cache = appPTR->getCache();
+
+    std::vector<Image::Tile> newTiles(nTilesPerLine * nTilesPerColumn);
+    for (int ty = 0; ty < nTilesPerColumn; ++ty) {
+        for (int tx = 0; tx < nTilesPerLine; ++tx) {
+            Image::Tile& tile = newTiles[tx + ty * nTilesPerLine];
+            tile.tileBounds.x1 = newBounds.x1 + tx * tileSizeX;
+            tile.tileBounds.y1 = newBounds.y1 + ty * tileSizeY;
+            tile.tileBounds.x2 = std::min(tile.tileBounds.x1 + tileSizeX, newBounds.x2);
+            tile.tileBounds.y2 = std::min(tile.tileBounds.y1 + tileSizeY, newBounds.y2);
+
+            const int oldTx = tx - offsetTx;
+            const int oldTy = ty - offsetTy;
+            const Image::Tile* oldTile = 0;
+            if (oldTx >= 0 && oldTx < oldNTilesPerLine && oldTy >= 0 && oldTy < oldNTilesPerColumn) {
+                oldTile = &tiles[oldTx + oldTy * oldNTilesPerLine];
+            }
+
+            if (oldTile && oldTile->tileBounds == tile.tileBounds) {
+                // The tile is unchanged
+                tile.perChannelTile = oldTile->perChannelTile;
+                continue;
+            }
+
+            // The template for the channels of the tile
+            const Image::Tile& channelsTile = oldTile ? *oldTile : tiles[0];
+
+            float fillValues[4] = {0.f, 0.f, 0.f, 0.f};
+            if (oldTile && !isTileUnallocated(*oldTile, fillValues)) {
+                // An edge tile that grows would need its pixels to be copied.
+                return false;
+            }
+
+            tile.perChannelTile.resize(channelsTile.perChannelTile.size());
+            for (std::size_t c = 0; c < tile.perChannelTile.size(); ++c) {
+                Image::MonoChannelTile& channelTile = tile.perChannelTile[c];
+                channelTile.channelIndex = channelsTile.perChannelTile[c].channelIndex;
+                channelTile.buffer = createSparseTileStorage(cache, storage, bitdepth, tile.tileBounds, oldTile ? fillValues[channelTile.channelIndex] : 0.f);
+            }
+        } // for each tile horizontally
+    } // for each tile vertically
+
+    tiles.swap(newTiles);
+    bounds = newBounds;
+    return true;
+} // extendSparseTiles
+
+void
+ImagePrivate::reportSparseTilesStats() const
+{
+    CachePtr cache = appPTR->getCache();
+    if (!cache) {
+        return;
+    }
+
+    std::size_t nTiles = 0, nAllocatedTiles = 0, bytesSaved = 0;
+    for (std::size_t tile_i = 0; tile_i < tiles.size(); ++tile_i) {
+        const Image::Tile& tile = tiles[tile_i];
+        for (std::size_t c = 0; c < tile.perChannelTile.size(); ++c) {
+            const ImageStorageBasePtr& buffer = tile.perChannelTile[c].buffer;
+            if (!buffer) {
+                continue;
+            }
+            ++nTiles;
+            if (!buffer->isLazyAllocationPending()) {
+                ++nAllocatedTiles;
+            } else if (buffer->getStorageMode() == eStorageModeDisk) {
+                bytesSaved += cache->getTileSizeBytes();
+            } else {
+                bytesSaved += tile.tileBounds.area() * getSizeOfForBitDepth( buffer->getBitDepth() );
+            }
+        }
+    }
+    cache->reportSparseImageTiles(nTiles, nAllocatedTiles, bytesSaved);
+} // reportSparseTilesStats
+
+void
+ImagePrivate::detachCopyOnWriteTile(int tileIndex)
+{
+    if ( (tileIndex < 0) || ( tileIndex >= (int)copyOnWriteTiles.size() ) || !copyOnWriteTiles[tileIndex] ) {
+        return;
+    }
+    copyOnWriteTiles[tileIndex] = false;
+
+    Image::Tile& tile = tiles[tileIndex];
+    for (std::size_t c = 0; c < tile.perChannelTile.size(); ++c) {
+        Image::MonoChannelTile& channelTile = tile.perChannelTile[c];
+        if (!channelTile.buffer) {
+            continue;
+        }
+        // The tile was found in the cache: the cache still holds the shared buffer
+        channelTile.entryLocker.reset();
+        channelTile.buffer = copyTileStorage(channelTile.buffer, tile.tileBounds);
+    }
+} // detachCopyOnWriteTile
+
+void
+ImagePrivate::detachCopyOnWriteTiles(const RectI& roi)
+{
+    QMutexLocker k(&copyOnWriteMutex);
+    for (std::size_t i = 0; i < copyOnWriteTiles.size(); ++i) {
+        if ( copyOnWriteTiles[i] && tiles[i].tileBounds.intersects(roi) ) {
+            detachCopyOnWriteTile(i);
+        }
+    }
+}
+
+ImageStorageBasePtr
+ImagePrivate::copyTileStorage(const ImageStorageBasePtr& buffer, const RectI& tileBounds)
+{
+    assert(buffer);
+    CachePtr cache = appPTR->getCache();
+    RAMImageStoragePtr isRAMBuffer = toRAMImageStorage(buffer);
+    CacheImageTileStoragePtr isMMAPBuffer = toCacheImageTileStorage(buffer);
+
+    // A buffer that was not allocated yet only holds a constant
+    float fillValue;
+    if ( buffer->isLazyAllocationPending(&fillValue) ) {
+        ImageStorageBasePtr ret = createSparseTileStorage(cache, buffer->getStorageMode(), buffer->getBitDepth(), tileBounds, fillValue);
+        if (isMMAPBuffer) {
+            // The bounds of a cache tile are deduced from its key
+            toCacheImageTileStorage(ret)->setKey( isMMAPBuffer->getKey() );
+        }
+        return ret;
+    }
+
+    if (isRAMBuffer) {
+        RAMImageStoragePtr ret(new RAMImageStorage);
+        RAMAllocateMemoryArgs args;
+        args.bitDepth = isRAMBuffer->getBitDepth();
+        args.bounds = isRAMBuffer->getBounds();
+        args.numComponents = isRAMBuffer->getNumComponents();
+        ret->allocateMemory(args);
+        memcpy( ret->getData(), isRAMBuffer->getData(), std::min( ret->getBufferSize(), isRAMBuffer->getBufferSize() ) );
+        return ret;
+    }
+
+    if (isMMAPBuffer) {
+        CacheImageTileStoragePtr ret(new CacheImageTileStorage(cache));
+        AllocateMemoryArgs args;
+        args.bitDepth = isMMAPBuffer->getBitDepth();
+        ret->allocateMemory(args);
+        ret->setKey( isMMAPBuffer->getKey() );
+        memcpy( ret->getData(), isMMAPBuffer->getData(), std::min( ret->getBufferSize(), isMMAPBuffer->getBufferSize() ) );
+        return ret;
+    }
+
+    // OpenGL textures are never shared
+    assert(false);
+    return buffer;
+} // copyTileStorage
+
+bool
+ImagePrivate::getCopyChannelsMapping(int srcNComps,
+                                     int dstNComps,
+                                     const Image::CopyPixelsArgs& args,
+                                     int srcChannels[4],
+                                     float fillValues[4])
+{
+    if ( (srcNComps <= 0) || (srcNComps > 4) || (dstNComps <= 0) || (dstNComps > 4) ) {
+        return false;
+    }
+
+    // Color-space conversions and unpremultiplication change the values
+    if ( (args.srcColorspace != args.dstColorspace) || args.unPremultIfNeeded ) {
+        return false;
+    }
+
+    for (int i = 0; i < 4; ++i) {
+        srcChannels[i] = -1;
+        fillValues[i] = 0.f;
+    }
+
+    if (srcNComps == dstNComps) {
+        for (int c = 0; c < dstNComps; ++c) {
+            srcChannels[c] = c;
+        }
+        return true;
+    }
+
+    // This follows what convertCPUImage does for each conversion
+    if (srcNComps == 1) {
+        switch (args.monoConversion) {
+            case Image::eMonoToPackedConversionCopyToAll:
+                for (int c = 0; c < dstNComps; ++c) {
+                    srcChannels[c] = 0;
+                }
+                break;
+            case Image::eMonoToPackedConversionCopyToChannelAndFillOthers:
+            case Image::eMonoToPackedConversionCopyToChannelAndLeaveOthers:
+                // Channels that are left untouched by the copy are undefined: make them 0
+                if ( (args.conversionChannel < 0) || (args.conversionChannel >= dstNComps) ) {
+                    return false;
+                }
+                srcChannels[args.conversionChannel] = 0;
+                break;
+        }
+        return true;
+    }
+
+    if (dstNComps == 1) {
+        switch (args.alphaHandling) {
+            case Image::eAlphaChannelHandlingCreateFill0:
+                fillValues[0] = 0.f;
+                break;
+            case Image::eAlphaChannelHandlingCreateFill1:
+                fillValues[0] = 1.f;
+                break;
+            case Image::eAlphaChannelHandlingFillFromChannel:
+                if ( (args.conversionChannel < 0) || (args.conversionChannel >= srcNComps) ) {
+                    return false;
+                }
+                srcChannels[0] = args.conversionChannel;
+                break;
+        }
+        return true;
+    }
+
+    // XY, RGB or RGBA to another of these
+    for (int c = 0; c < 3 && c < dstNComps; ++c) {
+        if (c < srcNComps) {
+            srcChannels[c] = c;
+        }
+    }
+    if ( (dstNComps == 4) && (srcNComps == 4) ) {
+        srcChannels[3] = 3;
+    } else if (dstNComps == 4) {
+        switch (args.alphaHandling) {
+            case Image::eAlphaChannelHandlingCreateFill0:
+                fillValues[3] = 0.f;
+                break;
+            case Image::eAlphaChannelHandlingCreateFill1:
+                fillValues[3] = 1.f;
+                break;
+            case Image::eAlphaChannelHandlingFillFromChannel:
+                if ( (args.conversionChannel >= 0) && (args.conversionChannel < srcNComps) ) {
+                    srcChannels[3] = args.conversionChannel;
+                } else {
+                    fillValues[3] = 1.f;
+                }
+                break;
+        }
+    }
+    return true;
+} // getCopyChannelsMapping
+
 
 void
 ImagePrivate::insertTilesInCache()
@@ -49,6 +407,8 @@ ImagePrivate::insertTilesInCache()
 
     bool renderAborted = renderArgs->isRenderAborted();
 
+    // Insert all tiles at once so that each cache bucket is locked only once
+    std::vector<CacheEntryLockerPtr> lockersToInsert;
     for (std::size_t tile_i = 0; tile_i < tiles.size(); ++tile_i) {
         Image::Tile& tile = tiles[tile_i];
         assert(!tile.perChannelTile.empty());
@@ -63,14 +423,121 @@ ImagePrivate::insertTilesInCache()
             }
             CacheEntryLocker::CacheEntryStatusEnum status = thisChannelTile.entryLocker->getStatus();
             if (status == CacheEntryLocker::eCacheEntryStatusMustCompute && !renderAborted) {
-                thisChannelTile.entryLocker->insertInCache();
+                // A tile of a sparse image that was only filled holds a constant: write it to the cache tile
+                if (sparse) {
+                    thisChannelTile.buffer->ensureAllocated();
+                }
+                lockersToInsert.push_back(thisChannelTile.entryLocker);
             }
             thisChannelTile.entryLocker.reset();
         }
         
     } // for each tile
+
+    cache->insertBatch(lockersToInsert);
 } // insertTilesInCache
 
+void
+ImagePrivate::computeTileMipMaps(const CacheImageTileStorage& tile, CacheImageTileMipMaps* mipmaps)
+{
+    const ImageBitDepthEnum bitdepth = tile.getBitDepth();
+    const RectI tileBounds = tile.getBounds();
+
+    mipmaps->allocateLevels(bitdepth, tileBounds.width(), tileBounds.height());
+
+    // Each level is the previous one halved, in the coordinates of the tile
+    RectI srcBounds(0, 0, tileBounds.width(), tileBounds.height());
+    const void* srcPtrs[4] = {tile.getData(), 0, 0, 0};
+    const unsigned int nLevels = mipmaps->getNumLevels();
+    for (unsigned int level = 1; level <= nLevels; ++level) {
+        int width, height;
+        void* dstPtrs[4] = {mipmaps->getLevelData(level, &width, &height), 0, 0, 0};
+        assert(dstPtrs[0]);
+        RectI dstBounds(0, 0, width, height);
+
+        halveImage(srcPtrs, 1, bitdepth, srcBounds, dstPtrs, dstBounds);
+
+        srcPtrs[0] = dstPtrs[0];
+        srcBounds = dstBounds;
+    }
+} // computeTileMipMaps
+
+CacheImageTileMipMapsPtr
+ImagePrivate::getTileMipMaps(const CacheImageTileStoragePtr& tile)
+{
+    if (!tile || !tile->getData()) {
+        return CacheImageTileMipMapsPtr();
+    }
+    CachePtr cache = tile->getCache();
+    CacheEntryKeyBasePtr tileKey = tile->getKey();
+    assert(tileKey);
+
+    ImageTileMipMapsKeyPtr key(new ImageTileMipMapsKey(tile->getHashKey(), tileKey->getHolderPluginID()));
+    CacheImageTileMipMapsPtr ret = CacheImageTileMipMaps::create(cache, key);
+
+    CacheEntryLockerPtr locker = cache->get(ret);
+    CacheEntryLocker::CacheEntryStatusEnum status = locker->getStatus();
+    while (status == CacheEntryLocker::eCacheEntryStatusComputationPending) {
+        status = locker->waitForPendingEntry();
+    }
+    if (status == CacheEntryLocker::eCacheEntryStatusCached) {
+        return ret;
+    }
+    assert(status == CacheEntryLocker::eCacheEntryStatusMustCompute);
+
+    computeTileMipMaps(*tile, ret.get());
+    locker->insertInCache();
+    return ret;
+} // getTileMipMaps
+
+ImageStorageBasePtr
+ImagePrivate::createBufferFromTileMipMaps(const CacheImageTileMipMaps& mipmaps,
+                                          unsigned int level,
+                                          int tileOriginX,
+                                          int tileOriginY,
+                                          const RectI& bounds)
+{
+    int levelWidth, levelHeight;
+    const char* levelData = mipmaps.getLevelData(level, &levelWidth, &levelHeight);
+    if (!levelData) {
+        return ImageStorageBasePtr();
+    }
+
+    // Tiles are aligned on their size, which is a power of 2: the origin of the level is exact
+    const RectI levelBounds(tileOriginX / (1 << level), tileOriginY / (1 << level), tileOriginX / (1 << level) + levelWidth, tileOriginY / (1 << level) + levelHeight);
+
+    RAMImageStoragePtr buffer(new RAMImageStorage());
+    {
+        RAMAllocateMemoryArgs args;
+        args.bitDepth = mipmaps.getBitDepth();
+        args.bounds = bounds;
+        args.numComponents = 1;
+        buffer->allocateMemory(args);
+    }
+
+    // Pixels outside of the tile are black
+    RectI copyBounds;
+    const bool intersects = bounds.intersect(levelBounds, &copyBounds);
+    if ( !intersects || (copyBounds != bounds) ) {
+        memset( buffer->getData(), 0, buffer->getBufferSize() );
+    }
+    if (!intersects) {
+        return buffer;
+    }
+
+    const std::size_t pixelSize = getSizeOfForBitDepth(mipmaps.getBitDepth());
+    const std::size_t srcRowSize = levelWidth * pixelSize;
+    const std::size_t dstRowSize = bounds.width() * pixelSize;
+    const std::size_t copyRowSize = copyBounds.width() * pixelSize;
+
+    const char* srcPixels = levelData + (copyBounds.y1 - levelBounds.y1) * srcRowSize + (copyBounds.x1 - levelBounds.x1) * pixelSize;
+    char* dstPixels = buffer->getData() + (copyBounds.y1 - bounds.y1) * dstRowSize + (copyBounds.x1 - bounds.x1) * pixelSize;
+    for (int y = copyBounds.y1; y < copyBounds.y2; ++y, srcPixels += srcRowSize, dstPixels += dstRowSize) {
+        memcpy(dstPixels, srcPixels, copyRowSize);
+    }
+    return buffer;
+} // createBufferFromTileMipMaps
+
 const Image::Tile*
 ImagePrivate::getTile(int x, int y) const
 {
@@ -83,16 +550,11 @@ ImagePrivate::getTile(int x, int y) const
         return &tiles[0];
     }
 
-    int tileSizeX = tiles[0].tileBounds.width();
-    int tileSizeY = tiles[0].tileBounds.height();
-
-    // Tiles must be aligned
-    assert(bounds.width() % tileSizeX == 0);
-    assert(bounds.height() % tileSizeY == 0);
+    assert(tileSizeX != 0 && tileSizeY != 0);
 
-    int nTilesPerLine = bounds.width() / tileSizeX;
-    int tileX = std::floor((double)(x - bounds.x1) / tileSizeX);
-    int tileY = std::floor((double)(y - bounds.y1) / tileSizeY);
+    int nTilesPerLine = getNTilesPerLine();
+    int tileX = (x - bounds.x1) / tileSizeX;
+    int tileY = (y - bounds.y1) / tileSizeY;
 
     int tile_i = tileY * nTilesPerLine + tileX;
     assert(tile_i >= 0 && tile_i < (int)tiles.size());
@@ -106,27 +568,22 @@ ImagePrivate::getTilesCoordinates(const RectI& pixelCoordinates) const
     if (tiles.empty()) {
         return RectI();
     }
-    int tileSizeX = tiles[0].tileBounds.width();
-    int tileSizeY = tiles[0].tileBounds.height();
-
-    // Round the pixel coords to the tile size
-    RectI roundedPixelCoords;
-    roundedPixelCoords.x1 = std::max(bounds.x1, (int)std::floor( ( (double)pixelCoordinates.x1 ) / tileSizeX ) * tileSizeX);
-    roundedPixelCoords.y1 = std::max(bounds.y1, (int)std::floor( ( (double)pixelCoordinates.y1 ) / tileSizeY ) * tileSizeY);
-    roundedPixelCoords.x2 = std::min(bounds.x2, (int)std::ceil( ( (double)pixelCoordinates.x2 ) / tileSizeX ) * tileSizeX);
-    roundedPixelCoords.y2 = std::min(bounds.y2, (int)std::ceil( ( (double)pixelCoordinates.y2 ) / tileSizeY ) * tileSizeY);
+    if (tileSizeX == 0 || tileSizeY == 0) {
+        // Untiled: a single tile
+        return RectI(0, 0, 1, 1);
+    }
 
-    // Ensure the tiles are aligned
-    assert(((roundedPixelCoords.x1 - bounds.x1) % tileSizeX) == 0);
-    assert(((roundedPixelCoords.y1 - bounds.y1) / tileSizeY) == 0);
-    assert(((roundedPixelCoords.x2 - bounds.x1) / tileSizeX) == 0);
-    assert(((roundedPixelCoords.y2 - bounds.y1) / tileSizeY) == 0);
+    // Tiles are aligned on the bottom-left corner of the image
+    RectI pixelsInBounds;
+    if (!pixelCoordinates.intersect(bounds, &pixelsInBounds)) {
+        return RectI();
+    }
 
     RectI tilesRect;
-    tilesRect.x1 = (roundedPixelCoords.x1 - bounds.x1) / tileSizeX;
-    tilesRect.y1 = (roundedPixelCoords.y1 - bounds.y1) / tileSizeY;
-    tilesRect.x2 = (roundedPixelCoords.x2 - bounds.x1) / tileSizeX;
-    tilesRect.y2 = (roundedPixelCoords.y2 - bounds.y1) / tileSizeY;
+    tilesRect.x1 = (pixelsInBounds.x1 - bounds.x1) / tileSizeX;
+    tilesRect.y1 = (pixelsInBounds.y1 - bounds.y1) / tileSizeY;
+    tilesRect.x2 = (pixelsInBounds.x2 - bounds.x1 + tileSizeX - 1) / tileSizeX;
+    tilesRect.y2 = (pixelsInBounds.y2 - bounds.y1 + tileSizeY - 1) / tileSizeY;
     return tilesRect;
 } // getTilesCoordinates
 
@@ -275,6 +732,13 @@ ImagePrivate::copyTiledImageToUntiledImage(const Image& fromImage, const Image::
     const StorageModeEnum toStorage = tiles[0].perChannelTile[0].buffer->getStorageMode();
     Image::CopyPixelsArgs argsCpy = args;
 
+    const int nComps = layer.getNumComponents();
+    const bool canFillFromConstantTiles = fromImage._imp->sparse &&
+                                          toStorage != eStorageModeGLTex &&
+                                          fromImage._imp->layer.getNumComponents() == nComps &&
+                                          args.srcColorspace == args.dstColorspace &&
+                                          !args.unPremultIfNeeded;
+
     // Copy each tile individually
     for (int ty = tilesRect.y1; ty < tilesRect.y2; ++ty) {
         for (int tx = tilesRect.x1; tx < tilesRect.x2; ++tx) {
@@ -286,6 +750,16 @@ ImagePrivate::copyTiledImageToUntiledImage(const Image& fromImage, const Image::
 
             fromTile.tileBounds.intersect(args.roi, &argsCpy.roi);
 
+            // A tile of a sparse image that was never written to is a constant: fill instead of copying
+            // when no conversion is involved.
+            float fillValues[4];
+            if (canFillFromConstantTiles && fromTile.perChannelTile.size() == (std::size_t)nComps && isTileUnallocated(fromTile, fillValues)) {
+                Image::CPUTileData dstTileData;
+                Image::getCPUTileData(tiles[0], bufferFormat, &dstTileData);
+                ImagePrivate::fillCPU(dstTileData.ptrs, fillValues[0], fillValues[1], fillValues[2], nComps == 1 ? fillValues[0] : fillValues[3], dstTileData.nComps, dstTileData.bitDepth, dstTileData.tileBounds, argsCpy.roi, renderArgs);
+                continue;
+            }
+
             ImagePrivate::copyRectangle(fromTile, fromStorage, fromImage._imp->bufferFormat, tiles[0], toStorage, bufferFormat, argsCpy, renderArgs);
 
         } // for all tiles horizontally
@@ -364,10 +838,10 @@ halveImageForInternal(const void* srcPtrs[4],
                 // a b
                 // c d
 
-                const PIX a = (pickThisCol && pickThisRow) ? *(srcPixelPtrs[k]) : 0;
-                const PIX b = (pickNextCol && pickThisRow) ? *(srcPixelPtrs[k] + srcPixelStride) : 0;
-                const PIX c = (pickThisCol && pickNextRow) ? *(srcPixelPtrs[k] + srcRowElementsCount) : 0;
-                const PIX d = (pickNextCol && pickNextRow) ? *(srcPixelPtrs[k] + srcRowElementsCount + srcPixelStride)  : 0;
+                const PIX a = (pickThisCol && pickThisRow) ? *(srcPixelPtrs[k]) : (PIX)0;
+                const PIX b = (pickNextCol && pickThisRow) ? *(srcPixelPtrs[k] + srcPixelStride) : (PIX)0;
+                const PIX c = (pickThisCol && pickNextRow) ? *(srcPixelPtrs[k] + srcRowElementsCount) : (PIX)0;
+                const PIX d = (pickNextCol && pickNextRow) ? *(srcPixelPtrs[k] + srcRowElementsCount + srcPixelStride)  : (PIX)0;
 
                 assert( sumW == 2 || ( sumW == 1 && ( (a == 0 && c == 0) || (b == 0 && d == 0) ) ) );
                 assert( sumH == 2 || ( sumH == 1 && ( (a == 0 && b == 0) || (c == 0 && d == 0) ) ) );
@@ -432,7 +906,7 @@ ImagePrivate::halveImage(const void* srcPtrs[4],
             halveImageForDepth<unsigned short, 65535>(srcPtrs, nComps, srcBounds, dstPtrs, dstBounds);
             break;
         case eImageBitDepthHalf:
-            assert(false);
+            halveImageForDepth<Half, 1>(srcPtrs, nComps, srcBounds, dstPtrs, dstBounds);
             break;
         case eImageBitDepthFloat:
             halveImageForDepth<float, 1>(srcPtrs, nComps, srcBounds, dstPtrs, dstBounds);
@@ -462,9 +936,9 @@ checkForNaNsInternal(void* ptrs[4],
                 // (if they do, please explain here which ones)
                 if (*dstPixelPtrs[k] != *dstPixelPtrs[k]) { // check for NaN
                     *dstPixelPtrs[k] = 1.;
-                    ++dstPixelPtrs[k];
                     hasnan = true;
                 }
+                dstPixelPtrs[k] += dstPixelStride;
             }
         }
         // Remove what was done at the previous scan-line and got to the next
@@ -519,7 +993,7 @@ ImagePrivate::checkForNaNs(void* ptrs[4],
             return checkForNaNsForDepth<unsigned short, 65535>(ptrs, nComps, bounds, roi);
             break;
         case eImageBitDepthHalf:
-            assert(false);
+            return checkForNaNsForDepth<Half, 1>(ptrs, nComps, bounds, roi);
             break;
         case eImageBitDepthFloat:
             return checkForNaNsForDepth<float, 1>(ptrs, nComps, bounds, roi);
@@ -27,6 +27,10 @@
 
 #include "Global/Macros.h"
 
+#include <vector>
+
+#include <QtCore/QMutex>
+
 #include "Engine/AppManager.h"
 #include "Engine/Cache.h"
 #include "Engine/CacheEntryBase.h"
@@ -69,11 +73,26 @@ struct ImagePrivate
     // The buffer format
     ImageBufferLayoutEnum bufferFormat;
 
+    // The size in pixels of a tile of a eImageBufferLayoutMonoChannelTiled image, 0 otherwise.
+    // Edge tiles may be smaller.
+    int tileSizeX, tileSizeY;
+
+    // True if the tiles are only allocated when written to, see InitStorageArgs::sparse
+    bool sparse;
+
     // This must be set if the cache policy is not none.
     // This will be used to prevent inserting in the cache part of images that had
     // their render aborted.
     TreeRenderNodeArgsPtr renderArgs;
 
+    // For each tile, true if its buffers are shared with another image, see Image::createCopyOnWriteView().
+    // The buffers of such a tile are copied the first time it is written to.
+    // Empty if no tile was ever shared.
+    std::vector<bool> copyOnWriteTiles;
+
+    // Protects copyOnWriteTiles and the buffers of the tiles while they are detached
+    QMutex copyOnWriteMutex;
+
 
     ImagePrivate()
     : bounds()
@@ -83,7 +102,12 @@ struct ImagePrivate
     , mipMapLevel(0)
     , cachePolicy(eCacheAccessModeNone)
     , bufferFormat(eImageBufferLayoutRGBAPackedFullRect)
+    , tileSizeX(0)
+    , tileSizeY(0)
+    , sparse(false)
     , renderArgs()
+    , copyOnWriteTiles()
+    , copyOnWriteMutex()
     {
 
     }
@@ -95,6 +119,29 @@ struct ImagePrivate
      **/
     void insertTilesInCache();
 
+    /**
+     * @brief Computes all the mipmap levels of the given tile at mipmap level 0, which must be allocated.
+     **/
+    static void computeTileMipMaps(const CacheImageTileStorage& tile, CacheImageTileMipMaps* mipmaps);
+
+    /**
+     * @brief Returns the mipmaps of the given tile at mipmap level 0, which was just read from the cache.
+     * If they are not cached yet, they are computed and inserted in the cache so that the next request does not
+     * downscale the tile again.
+     **/
+    static CacheImageTileMipMapsPtr getTileMipMaps(const CacheImageTileStoragePtr& tile);
+
+    /**
+     * @brief Copies the given level of the mipmaps of the tile at mipmap level 0 whose bottom-left corner is tileOrigin
+     * to a new buffer covering the given bounds (at the scale of the level).
+     * Returns NULL if the mipmaps do not have this level.
+     **/
+    static ImageStorageBasePtr createBufferFromTileMipMaps(const CacheImageTileMipMaps& mipmaps,
+                                                           unsigned int level,
+                                                           int tileOriginX,
+                                                           int tileOriginY,
+                                                           const RectI& bounds);
+
     /**
      * @brief Returns the tile corresponding to the pixel at position x,y or null if out of bounds
      **/
@@ -105,6 +152,67 @@ struct ImagePrivate
      **/
     int getNTilesPerLine() const;
 
+    /**
+     * @brief Allocates the channels of a tile of a sparse image that were not allocated yet
+     **/
+    static void ensureTileAllocated(const Image::Tile& tile);
+
+    /**
+     * @brief Returns true if no channel of the tile is allocated. In this case, fillValues is set to the constant held by each
+     * channel of the tile, indexed by channel index.
+     **/
+    static bool isTileUnallocated(const Image::Tile& tile, float fillValues[4]);
+
+    /**
+     * @brief Creates the storage of a channel of a tile of a sparse image, without allocating it.
+     **/
+    static ImageStorageBasePtr createSparseTileStorage(const CachePtr& cache,
+                                                       StorageModeEnum storage,
+                                                       ImageBitDepthEnum bitdepth,
+                                                       const RectI& tileBounds,
+                                                       float fillValue);
+
+    /**
+     * @brief Gives its own copy of the buffers to the tile at the given index if they are shared with another image,
+     * so that it may be written to. The copyOnWriteMutex must be locked.
+     **/
+    void detachCopyOnWriteTile(int tileIndex);
+
+    /**
+     * @brief Calls detachCopyOnWriteTile() on all the tiles intersecting the roi.
+     **/
+    void detachCopyOnWriteTiles(const RectI& roi);
+
+    /**
+     * @brief Returns a new buffer with the same content as the given buffer of a tile.
+     * A buffer that was not allocated yet is not allocated either in the copy.
+     **/
+    static ImageStorageBasePtr copyTileStorage(const ImageStorageBasePtr& buffer, const RectI& tileBounds);
+
+    /**
+     * @brief For each channel of an image of dstNComps components that would be copied with copyPixels() from an image
+     * of srcNComps components, returns in srcChannels the channel of the source image it would contain.
+     * If it would instead contain a constant, srcChannels is set to -1 and fillValues to the constant.
+     * Returns false if the conversion does more than moving channels around.
+     **/
+    static bool getCopyChannelsMapping(int srcNComps,
+                                       int dstNComps,
+                                       const Image::CopyPixelsArgs& args,
+                                       int srcChannels[4],
+                                       float fillValues[4]);
+
+    /**
+     * @brief For a sparse image, extends the tiles table so that the bounds contain the roi.
+     * The bounds are extended by whole tiles so that the existing tiles keep their position.
+     * Returns false if this is not possible, i.e: the image is not sparse or an allocated edge tile would need to grow.
+     **/
+    bool extendSparseTiles(const RectI& roi);
+
+    /**
+     * @brief For a sparse image, reports to the cache statistics how much memory was saved by not allocating tiles.
+     **/
+    void reportSparseTilesStats() const;
+
     /**
      * @brief Returns a rectangle of tiles coordinates that span the given rectangle of pixel coordinates
      **/
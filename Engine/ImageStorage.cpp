@@ -25,13 +25,20 @@
 
 #include "ImageStorage.h"
 
+#include <algorithm> // std::fill
+#include <cstring> // memset
+#include <vector>
+
 #include <QMutex>
 #include <QThread>
 #include <QCoreApplication>
 
 #include "Engine/AppManager.h"
 #include "Engine/Cache.h"
+#include "Engine/CacheEntryKeyBase.h"
+#include "Engine/Image.h"
 #include "Engine/OSGLContext.h"
+#include "Engine/RAMBufferPool.h"
 #include "Engine/RamBuffer.h"
 #include "Engine/Texture.h"
 
@@ -46,16 +53,38 @@ struct ImageStorageBasePrivate
     RectI bounds;
     ImageBitDepthEnum bitdepth;
 
+    // Set by setLazyAllocation() until the memory is allocated by ensureAllocated()
+    // Protected by lazyAllocationLock, which is held while the memory is allocated and initialized
+    boost::shared_ptr<AllocateMemoryArgs> lazyAllocationArgs;
+    float lazyFillValue;
+    mutable QMutex lazyAllocationLock;
+
     ImageStorageBasePrivate()
     : allocated(false)
     , allocatedLock()
     , bounds()
     , bitdepth()
+    , lazyAllocationArgs()
+    , lazyFillValue(0.f)
+    , lazyAllocationLock()
     {
 
     }
 };
 
+template <typename PIX, int maxValue>
+static void
+fillBufferForDepth(char* data,
+                   std::size_t nBytes,
+                   float value)
+{
+    // Integer samples are rounded to the nearest value and clamped to the range of the bitdepth
+    const float scaled = value * maxValue + (maxValue > 1 ? 0.5f : 0.f);
+    PIX pixValue = Image::clampIfInt<PIX>(scaled);
+    PIX* pix = reinterpret_cast<PIX*>(data);
+    std::fill(pix, pix + nBytes / sizeof(PIX), pixValue);
+}
+
 ImageStorageBase::ImageStorageBase()
 : _imp(new ImageStorageBasePrivate())
 {
@@ -90,6 +119,12 @@ ImageStorageBase::allocateMemory(const AllocateMemoryArgs& args)
 
     allocateMemoryImpl(args);
 
+    {
+        QMutexLocker k(&_imp->allocatedLock);
+        _imp->allocated = true;
+        _imp->bitdepth = args.bitDepth;
+    }
+
     CachePtr cache = appPTR->getCache();
     if (cache) {
         // Notify the cache about memory changes
@@ -108,31 +143,129 @@ ImageStorageBase::deallocateMemory()
         return;
     }
 
+    // Get the size before deallocating: some storages do not know it afterwards
+    std::size_t size = getBufferSize();
+
     deallocateMemoryImpl();
 
+    {
+        QMutexLocker k(&_imp->allocatedLock);
+        _imp->allocated = false;
+    }
+
     CachePtr cache = appPTR->getCache();
     if (cache) {
         // Notify the cache about memory changes
-        std::size_t size = getBufferSize();
         if (size > 0) {
             cache->notifyMemoryDeallocated( size, getStorageMode() );
         }
     }
 }
 
+void
+ImageStorageBase::setLazyAllocation(const boost::shared_ptr<AllocateMemoryArgs>& args,
+                                    float fillValue)
+{
+    assert(args && !isAllocated());
+    QMutexLocker k(&_imp->lazyAllocationLock);
+    _imp->lazyAllocationArgs = args;
+    _imp->lazyFillValue = fillValue;
+    {
+        // The bitdepth must be known before the memory is allocated
+        QMutexLocker k2(&_imp->allocatedLock);
+        _imp->bitdepth = args->bitDepth;
+    }
+}
+
+bool
+ImageStorageBase::isLazyAllocationPending(float* fillValue) const
+{
+    QMutexLocker k(&_imp->lazyAllocationLock);
+    if (!_imp->lazyAllocationArgs) {
+        return false;
+    }
+    if (fillValue) {
+        *fillValue = _imp->lazyFillValue;
+    }
+    return true;
+}
+
+bool
+ImageStorageBase::setLazyFillValue(float fillValue)
+{
+    QMutexLocker k(&_imp->lazyAllocationLock);
+    if (!_imp->lazyAllocationArgs) {
+        return false;
+    }
+    _imp->lazyFillValue = fillValue;
+    return true;
+}
+
+void
+ImageStorageBase::ensureAllocated()
+{
+    QMutexLocker k(&_imp->lazyAllocationLock);
+    if (!_imp->lazyAllocationArgs) {
+        return;
+    }
+    allocateMemory(*_imp->lazyAllocationArgs);
+    fillMemoryImpl(_imp->lazyFillValue);
+
+    // Only reset once initialized so that other threads wait on the lock until then
+    _imp->lazyAllocationArgs.reset();
+}
+
+void
+ImageStorageBase::fillBuffer(char* data,
+                             std::size_t nBytes,
+                             ImageBitDepthEnum bitDepth,
+                             float value)
+{
+    if (!data) {
+        return;
+    }
+    if (value == 0.f) {
+        memset(data, 0, nBytes);
+        return;
+    }
+    switch (bitDepth) {
+        case eImageBitDepthByte:
+            fillBufferForDepth<unsigned char, 255>(data, nBytes, value);
+            break;
+        case eImageBitDepthShort:
+            fillBufferForDepth<unsigned short, 65535>(data, nBytes, value);
+            break;
+        case eImageBitDepthHalf:
+            fillBufferForDepth<Half, 1>(data, nBytes, value);
+            break;
+        case eImageBitDepthFloat:
+            fillBufferForDepth<float, 1>(data, nBytes, value);
+            break;
+        case eImageBitDepthNone:
+            assert(false);
+            break;
+    }
+}
+
 
 
 struct RAMImageStoragePrivate
 {
 
-    // Set if externalBuffer is not set
+    // Set if neither externalBuffer nor poolBuffer are set
     boost::scoped_ptr<RamBuffer<char> > buffer;
 
-    // Set if buffer is not set
+    // Set if neither buffer nor poolBuffer are set
     void* externalBuffer;
     std::size_t externalBufferSize;
     RAMAllocateMemoryArgs::ExternalBufferFreeFunction externalBufferFreeFunc;
 
+    // Set if the memory was allocated from the RAMBufferPool of the cache. poolBufferCapacity is the size of the
+    // buffer given by the pool, which may be greater than the poolBufferSize bytes requested.
+    RAMBufferPoolPtr pool;
+    void* poolBuffer;
+    std::size_t poolBufferSize, poolBufferCapacity;
+
     ImageBitDepthEnum bitDepth;
     std::size_t numComps;
 
@@ -143,12 +276,27 @@ struct RAMImageStoragePrivate
     , externalBuffer(0)
     , externalBufferSize(0)
     , externalBufferFreeFunc(0)
+    , pool()
+    , poolBuffer(0)
+    , poolBufferSize(0)
+    , poolBufferCapacity(0)
     , bitDepth(eImageBitDepthFloat)
     , numComps(1)
     , bounds()
     {
 
     }
+
+    void releasePoolBuffer()
+    {
+        if (poolBuffer) {
+            pool->release(poolBuffer, poolBufferCapacity);
+            poolBuffer = 0;
+            poolBufferSize = 0;
+            poolBufferCapacity = 0;
+        }
+        pool.reset();
+    }
 };
 
 
@@ -161,7 +309,14 @@ RAMImageStorage::RAMImageStorage()
 
 RAMImageStorage::~RAMImageStorage()
 {
+    // Give the memory back to the pool so that the next images may reuse it
+    _imp->releasePoolBuffer();
+}
 
+bool
+RAMImageStorage::isAllocatedFromPool() const
+{
+    return _imp->poolBuffer != 0;
 }
 
 RectI
@@ -193,6 +348,8 @@ RAMImageStorage::getBufferSize() const
 {
     if (_imp->buffer) {
         return _imp->buffer->size();
+    } else if (_imp->poolBuffer) {
+        return _imp->poolBufferSize;
     } else if (_imp->externalBuffer) {
         return _imp->externalBufferSize;
     } else {
@@ -206,6 +363,8 @@ RAMImageStorage::getData() const
 {
     if (_imp->buffer) {
         return _imp->buffer->getData();
+    } else if (_imp->poolBuffer) {
+        return (const char*)_imp->poolBuffer;
     } else if (_imp->externalBuffer) {
         return (const char*)_imp->externalBuffer;
     } else {
@@ -218,6 +377,8 @@ RAMImageStorage::getData()
 {
     if (_imp->buffer) {
         return _imp->buffer->getData();
+    } else if (_imp->poolBuffer) {
+        return (char*)_imp->poolBuffer;
     } else if (_imp->externalBuffer) {
         return (char*)_imp->externalBuffer;
     } else {
@@ -233,9 +394,10 @@ RAMImageStorage::allocateMemoryImpl(const AllocateMemoryArgs& args)
     const RAMAllocateMemoryArgs* ramArgs = dynamic_cast<const RAMAllocateMemoryArgs*>(&args);
     assert(ramArgs);
 
-    assert(!_imp->buffer && !_imp->externalBuffer);
+    assert(!_imp->buffer && !_imp->externalBuffer && !_imp->poolBuffer);
 
     _imp->externalBuffer = ramArgs->externalBuffer;
+    _imp->bounds = ramArgs->bounds;
     _imp->bitDepth = ramArgs->bitDepth;
     _imp->numComps = ramArgs->numComponents;
     _imp->externalBufferSize = ramArgs->externalBufferSize;
@@ -244,13 +406,21 @@ RAMImageStorage::allocateMemoryImpl(const AllocateMemoryArgs& args)
     assert(!_imp->externalBuffer || _imp->externalBufferFreeFunc);
 
     if (!_imp->externalBuffer) {
-        _imp->buffer.reset(new RamBuffer<char>);
         std::size_t nBytes = getSizeOfForBitDepth(_imp->bitDepth) * _imp->numComps;
 
         nBytes *= ramArgs->bounds.width();
         nBytes *= ramArgs->bounds.height();
 
-        _imp->buffer->resize(nBytes);
+        // Recycle the buffers of the previous images if possible
+        CachePtr cache = appPTR->getCache();
+        if (cache && nBytes > 0) {
+            _imp->pool = cache->getRAMBufferPool();
+            _imp->poolBuffer = _imp->pool->allocate(nBytes, &_imp->poolBufferCapacity);
+            _imp->poolBufferSize = nBytes;
+        } else {
+            _imp->buffer.reset(new RamBuffer<char>);
+            _imp->buffer->resize(nBytes);
+        }
     }
 }
 
@@ -259,6 +429,8 @@ RAMImageStorage::deallocateMemoryImpl()
 {
     if (_imp->buffer) {
         _imp->buffer.reset();
+    } else if (_imp->poolBuffer) {
+        _imp->releasePoolBuffer();
     } else if (_imp->externalBuffer) {
         if (_imp->externalBufferFreeFunc) {
             // Call the user provided delete func
@@ -267,6 +439,12 @@ RAMImageStorage::deallocateMemoryImpl()
     }
 }
 
+void
+RAMImageStorage::fillMemoryImpl(float value)
+{
+    fillBuffer( getData(), getBufferSize(), _imp->bitDepth, value );
+}
+
 struct GLImageStoragePrivate
 {
 
@@ -424,9 +602,18 @@ struct CacheImageTileStoragePrivate
     boost::scoped_ptr<RamBuffer<char> > localBuffer;
     ImageBitDepthEnum bitdepth;
 
+    // The size of a tile in the cache this storage was created for
+    std::size_t tileSizeBytes;
+
+    // The tile size in pixels for bitdepth, set when allocating
+    int tileSizeX, tileSizeY;
+
     CacheImageTileStoragePrivate()
     : localBuffer()
     , bitdepth(eImageBitDepthNone)
+    , tileSizeBytes(0)
+    , tileSizeX(0)
+    , tileSizeY(0)
     {
 
     }
@@ -437,7 +624,8 @@ CacheImageTileStorage::CacheImageTileStorage(const CachePtr& cache)
 , CacheEntryBase(cache)
 , _imp(new CacheImageTileStoragePrivate())
 {
-
+    assert(cache);
+    _imp->tileSizeBytes = cache->getTileSizeBytes();
 }
 
 CacheImageTileStorage::~CacheImageTileStorage()
@@ -449,7 +637,7 @@ void
 CacheImageTileStorage::toMemorySegment(ExternalSegmentType* segment, const std::string& objectNamesPrefix, ExternalSegmentTypeHandleList* objectPointers, void* tileDataPtr) const
 {
     assert(tileDataPtr && _imp->localBuffer);
-    memcpy(tileDataPtr, _imp->localBuffer->getData(), NATRON_TILE_SIZE_BYTES);
+    memcpy(tileDataPtr, _imp->localBuffer->getData(), _imp->tileSizeBytes);
     CacheEntryBase::toMemorySegment(segment, objectNamesPrefix, objectPointers, tileDataPtr);
 }
 
@@ -458,7 +646,17 @@ CacheImageTileStorage::fromMemorySegment(ExternalSegmentType* segment, const std
 {
     CacheEntryBase::fromMemorySegment(segment, objectNamesPrefix, tileDataPtr);
     assert(tileDataPtr && _imp->localBuffer);
-    memcpy(_imp->localBuffer->getData(), tileDataPtr, NATRON_TILE_SIZE_BYTES);
+    memcpy(_imp->localBuffer->getData(), tileDataPtr, _imp->tileSizeBytes);
+}
+
+bool
+CacheImageTileStorage::fromTileData(const void* tileDataPtr)
+{
+    if (!_imp->localBuffer) {
+        return false;
+    }
+    memcpy(_imp->localBuffer->getData(), tileDataPtr, _imp->tileSizeBytes);
+    return true;
 }
 
 StorageModeEnum
@@ -470,7 +668,7 @@ CacheImageTileStorage::getStorageMode() const
 std::size_t
 CacheImageTileStorage::getBufferSize() const
 {
-    return NATRON_TILE_SIZE_BYTES;
+    return _imp->tileSizeBytes;
 }
 
 std::size_t
@@ -484,8 +682,8 @@ CacheImageTileStorage::getBounds() const
 {
     RectI ret;
 
-    int tileSizeX, tileSizeY;
-    Cache::getTileSizePx(getBitDepth(), &tileSizeX, &tileSizeY);
+    int tileSizeX = _imp->tileSizeX;
+    int tileSizeY = _imp->tileSizeY;
     // Recover the bottom left corner from the tile coords
     {
         CacheEntryKeyBasePtr key = getKey();
@@ -504,11 +702,7 @@ std::size_t
 CacheImageTileStorage::getRowSize() const
 {
 
-    ImageBitDepthEnum bitDepth = getBitDepth();
-    int tileSizeX, tileSizeY;
-    Cache::getTileSizePx(bitDepth,&tileSizeX, &tileSizeY);
-
-    return tileSizeX * getSizeOfForBitDepth(bitDepth);
+    return _imp->tileSizeX * getSizeOfForBitDepth( getBitDepth() );
 
 }
 
@@ -518,6 +712,13 @@ CacheImageTileStorage::isStorageTiled() const
     return true;
 }
 
+int
+CacheImageTileStorage::getTileElementSize() const
+{
+    int elementSize = getSizeOfForBitDepth(_imp->bitdepth);
+    return elementSize > 0 ? elementSize : 1;
+}
+
 const char*
 CacheImageTileStorage::getData() const
 {
@@ -543,8 +744,11 @@ CacheImageTileStorage::allocateMemoryImpl(const AllocateMemoryArgs& args)
 {
     assert(!_imp->localBuffer);
     _imp->localBuffer.reset(new RamBuffer<char>);
-    _imp->localBuffer->resize(NATRON_TILE_SIZE_BYTES);
+    _imp->localBuffer->resize(_imp->tileSizeBytes);
     _imp->bitdepth = args.bitDepth;
+    CachePtr cache = getCache();
+    assert(cache);
+    cache->getTileSizePx(args.bitDepth, &_imp->tileSizeX, &_imp->tileSizeY);
 }
 
 void
@@ -553,6 +757,204 @@ CacheImageTileStorage::deallocateMemoryImpl()
     _imp->localBuffer.reset();
 }
 
+void
+CacheImageTileStorage::fillMemoryImpl(float value)
+{
+    fillBuffer( getData(), _imp->tileSizeBytes, _imp->bitdepth, value );
+}
+
+
+
+// Written at the start of the tile holding the levels
+struct CacheImageTileMipMapsShmData
+{
+    ImageBitDepthEnum bitdepth;
+    int tileSizeX, tileSizeY;
+    std::size_t dataSize;
+};
+
+struct CacheImageTileMipMapsPrivate
+{
+    CacheImageTileMipMapsShmData data;
+
+    // The pixels of all levels, one after the other
+    std::vector<char> levels;
+
+    CacheImageTileMipMapsPrivate()
+    : data()
+    , levels()
+    {
+        data.bitdepth = eImageBitDepthNone;
+        data.tileSizeX = data.tileSizeY = 0;
+        data.dataSize = 0;
+    }
+
+    /**
+     * @brief Returns the offset in bytes of the given level in the levels buffer and its size in pixels.
+     * Returns false if there is no such level.
+     **/
+    bool getLevelOffset(unsigned int level, std::size_t* offset, int* width, int* height) const
+    {
+        if (level == 0) {
+            return false;
+        }
+        const std::size_t pixelSize = getSizeOfForBitDepth(data.bitdepth);
+        int w = data.tileSizeX;
+        int h = data.tileSizeY;
+        *offset = 0;
+        for (unsigned int i = 1; i <= level; ++i) {
+            if (w <= 1 && h <= 1) {
+                return false;
+            }
+            if (i > 1) {
+                *offset += w * h * pixelSize;
+            }
+            w = (w + 1) / 2;
+            h = (h + 1) / 2;
+        }
+        *width = w;
+        *height = h;
+        return true;
+    }
+
+    /**
+     * @brief Reads the header and the levels from the tile written by CacheImageTileMipMaps::toMemorySegment.
+     **/
+    bool readTileData(const void* tileDataPtr, std::size_t tileSizeBytes)
+    {
+        const char* src = (const char*)tileDataPtr;
+        memcpy( &data, src, sizeof(data) );
+        if (sizeof(data) + data.dataSize > tileSizeBytes) {
+            return false;
+        }
+        levels.resize(data.dataSize);
+        if ( !levels.empty() ) {
+            memcpy( &levels[0], src + sizeof(data), levels.size() );
+        }
+        return true;
+    }
+};
+
+CacheImageTileMipMaps::CacheImageTileMipMaps(const CachePtr& cache)
+: CacheEntryBase(cache)
+, _imp(new CacheImageTileMipMapsPrivate())
+{
+
+}
+
+CacheImageTileMipMaps::~CacheImageTileMipMaps()
+{
+
+}
+
+CacheImageTileMipMapsPtr
+CacheImageTileMipMaps::create(const CachePtr& cache, const ImageTileMipMapsKeyPtr& key)
+{
+    CacheImageTileMipMapsPtr ret(new CacheImageTileMipMaps(cache));
+    ret->setKey(key);
+    return ret;
+}
+
+void
+CacheImageTileMipMaps::allocateLevels(ImageBitDepthEnum bitdepth, int tileSizeX, int tileSizeY)
+{
+    _imp->data.bitdepth = bitdepth;
+    _imp->data.tileSizeX = tileSizeX;
+    _imp->data.tileSizeY = tileSizeY;
+
+    const std::size_t pixelSize = getSizeOfForBitDepth(bitdepth);
+    std::size_t dataSize = 0;
+    int w = tileSizeX;
+    int h = tileSizeY;
+    while (w > 1 || h > 1) {
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+        dataSize += w * h * pixelSize;
+    }
+    _imp->data.dataSize = dataSize;
+    _imp->levels.resize(dataSize);
+}
+
+ImageBitDepthEnum
+CacheImageTileMipMaps::getBitDepth() const
+{
+    return _imp->data.bitdepth;
+}
+
+unsigned int
+CacheImageTileMipMaps::getNumLevels() const
+{
+    unsigned int ret = 0;
+    int w = _imp->data.tileSizeX;
+    int h = _imp->data.tileSizeY;
+    while (w > 1 || h > 1) {
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+        ++ret;
+    }
+    return ret;
+}
+
+const char*
+CacheImageTileMipMaps::getLevelData(unsigned int level, int* width, int* height) const
+{
+    std::size_t offset;
+    if ( _imp->levels.empty() || !_imp->getLevelOffset(level, &offset, width, height) ) {
+        return 0;
+    }
+    return &_imp->levels[offset];
+}
+
+char*
+CacheImageTileMipMaps::getLevelData(unsigned int level, int* width, int* height)
+{
+    std::size_t offset;
+    if ( _imp->levels.empty() || !_imp->getLevelOffset(level, &offset, width, height) ) {
+        return 0;
+    }
+    return &_imp->levels[offset];
+}
+
+bool
+CacheImageTileMipMaps::isStorageTiled() const
+{
+    return true;
+}
+
+void
+CacheImageTileMipMaps::toMemorySegment(ExternalSegmentType* segment, const std::string& objectNamesPrefix, ExternalSegmentTypeHandleList* objectPointers, void* tileDataPtr) const
+{
+    // The header, then the levels
+    assert(tileDataPtr);
+    const std::size_t tileSizeBytes = getCache()->getTileSizeBytes();
+    const std::size_t dataSize = sizeof(_imp->data) + _imp->levels.size();
+    assert(dataSize <= tileSizeBytes);
+    char* dst = (char*)tileDataPtr;
+    memcpy( dst, &_imp->data, sizeof(_imp->data) );
+    if ( !_imp->levels.empty() ) {
+        memcpy( dst + sizeof(_imp->data), &_imp->levels[0], _imp->levels.size() );
+    }
+    // The rest of the tile compresses to nothing if it is evicted to the compressed tier
+    memset(dst + dataSize, 0, tileSizeBytes - dataSize);
+    CacheEntryBase::toMemorySegment(segment, objectNamesPrefix, objectPointers, tileDataPtr);
+}
+
+void
+CacheImageTileMipMaps::fromMemorySegment(ExternalSegmentType* segment, const std::string& objectNamesPrefix, const void* tileDataPtr)
+{
+    assert(tileDataPtr);
+    bool ok = _imp->readTileData( tileDataPtr, getCache()->getTileSizeBytes() );
+    assert(ok);
+    Q_UNUSED(ok);
+    CacheEntryBase::fromMemorySegment(segment, objectNamesPrefix, tileDataPtr);
+}
+
+bool
+CacheImageTileMipMaps::fromTileData(const void* tileDataPtr)
+{
+    return _imp->readTileData( tileDataPtr, getCache()->getTileSizeBytes() );
+}
+
 
 
 NATRON_NAMESPACE_EXIT;
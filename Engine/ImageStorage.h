@@ -97,6 +97,32 @@ public:
      **/
     bool isAllocated() const;
 
+    /**
+     * @brief Defers the allocation of the memory to the first call to ensureAllocated(). Until then, no memory is
+     * taken and the buffer is considered to hold the constant fillValue everywhere: when allocated, the memory is
+     * initialized to it. This is used by the tiles of sparse images, which hold a single channel.
+     **/
+    void setLazyAllocation(const boost::shared_ptr<AllocateMemoryArgs>& args, float fillValue);
+
+    /**
+     * @brief Returns true if the allocation of the memory was deferred by setLazyAllocation() and did not happen yet.
+     * If so and fillValue is not NULL, it is set to the constant the buffer holds.
+     **/
+    bool isLazyAllocationPending(float* fillValue = 0) const;
+
+    /**
+     * @brief Changes the constant held by a buffer whose allocation is pending.
+     * Returns false if the memory was allocated in the meantime, in which case nothing is changed.
+     **/
+    bool setLazyFillValue(float fillValue);
+
+    /**
+     * @brief If the allocation of the memory was deferred by setLazyAllocation(), allocates it and initializes it
+     * to the fill value. This is thread-safe: other threads calling this function wait for the memory to be initialized.
+     * Note that this function may throw an std::bad_alloc exception if it could not allocate the required memory.
+     **/
+    void ensureAllocated();
+
     /**
      * @brief Returns the internal storage that your entry uses
      **/
@@ -122,6 +148,17 @@ protected:
      **/
     virtual void deallocateMemoryImpl() = 0;
 
+    /**
+     * @brief Implement to set all the samples of the allocated memory to the given value in [0, 1], scaled to the bitdepth.
+     * This is used by ensureAllocated() and only needs to be implemented by storages that may be allocated lazily.
+     **/
+    virtual void fillMemoryImpl(float /*value*/) {}
+
+    /**
+     * @brief Helper for fillMemoryImpl() implementations
+     **/
+    static void fillBuffer(char* data, std::size_t nBytes, ImageBitDepthEnum bitDepth, float value);
+
 private:
 
     boost::scoped_ptr<ImageStorageBasePrivate> _imp;
@@ -193,12 +230,20 @@ public:
 
     char* getData();
 
+    /**
+     * @brief Returns true if the memory was allocated from the RAMBufferPool of the cache: it goes back to the pool
+     * when this storage is deallocated or destroyed, which is cheap.
+     **/
+    bool isAllocatedFromPool() const;
+
 private:
 
     virtual void allocateMemoryImpl(const AllocateMemoryArgs& args) OVERRIDE FINAL;
 
     virtual void deallocateMemoryImpl() OVERRIDE FINAL;
 
+    virtual void fillMemoryImpl(float value) OVERRIDE FINAL;
+
     boost::scoped_ptr<RAMImageStoragePrivate> _imp;
 };
 
@@ -280,7 +325,7 @@ toGLImageStorage(const ImageStorageBasePtr& entry)
 /**
  * @brief Image storage based on the cache shared memory.
  * Unlike other storage modes, the size of such an image storage is 
- * exactly the size of a tile in the cache: NATRON_TILE_SIZE_BYTES
+ * exactly the size of a tile in the cache: Cache::getTileSizeBytes()
  * The allocate() args must be of CacheAllocateMemoryArgs type.
  **/
 struct CacheImageTileStoragePrivate;
@@ -309,16 +354,22 @@ public:
 
     virtual bool isStorageTiled() const OVERRIDE FINAL;
 
+    virtual int getTileElementSize() const OVERRIDE FINAL;
+
     virtual void toMemorySegment(ExternalSegmentType* segment, const std::string& objectNamesPrefix, ExternalSegmentTypeHandleList* objectPointers, void* tileDataPtr) const OVERRIDE FINAL;
 
     virtual void fromMemorySegment(ExternalSegmentType* segment, const std::string& objectNamesPrefix, const void* tileDataPtr) OVERRIDE FINAL;
 
+    virtual bool fromTileData(const void* tileDataPtr) OVERRIDE FINAL;
+
 private:
 
     virtual void allocateMemoryImpl(const AllocateMemoryArgs& args) OVERRIDE FINAL;
 
     virtual void deallocateMemoryImpl() OVERRIDE FINAL;
 
+    virtual void fillMemoryImpl(float value) OVERRIDE FINAL;
+
     boost::scoped_ptr<CacheImageTileStoragePrivate> _imp;
 };
 
@@ -336,6 +387,59 @@ toCacheImageTileStorage(const CacheEntryBasePtr& entry)
     return boost::dynamic_pointer_cast<CacheImageTileStorage>(entry);
 }
 
+/**
+ * @brief The mipmaps of a tile at mipmap level 0 held in the cache by a CacheImageTileStorage.
+ * Each level halves the previous one, down to a single pixel, so that the tile can be drawn at a lower scale
+ * without being downscaled again. They are only computed when the tile is first read at a lower scale.
+ * The levels are about a third of the size of the tile: they are stored in a tile of the tile aligned storage,
+ * after a small header, so that they do not grow the table of content of the cache.
+ * The key of this entry is an ImageTileMipMapsKey: the cache removes the mipmaps with the tile they are derived from.
+ **/
+struct CacheImageTileMipMapsPrivate;
+class CacheImageTileMipMaps
+: public CacheEntryBase
+{
+    CacheImageTileMipMaps(const CachePtr& cache);
+
+public:
+
+    static CacheImageTileMipMapsPtr create(const CachePtr& cache, const ImageTileMipMapsKeyPtr& key);
+
+    virtual ~CacheImageTileMipMaps();
+
+    /**
+     * @brief Allocates the levels for a tile of the given size in pixels, down to a single pixel.
+     * The pixels of each level must then be written with getLevelData.
+     **/
+    void allocateLevels(ImageBitDepthEnum bitdepth, int tileSizeX, int tileSizeY);
+
+    ImageBitDepthEnum getBitDepth() const;
+
+    /**
+     * @brief Returns the number of levels, excluding the tile itself.
+     **/
+    unsigned int getNumLevels() const;
+
+    /**
+     * @brief Returns the pixels of the given level, 1 being the tile halved, or NULL if there is no such level.
+     * Rows are contiguous and the size of the level in pixels is returned in width and height.
+     **/
+    const char* getLevelData(unsigned int level, int* width, int* height) const;
+    char* getLevelData(unsigned int level, int* width, int* height);
+
+    virtual bool isStorageTiled() const OVERRIDE FINAL;
+
+    virtual void toMemorySegment(ExternalSegmentType* segment, const std::string& objectNamesPrefix, ExternalSegmentTypeHandleList* objectPointers, void* tileDataPtr) const OVERRIDE FINAL;
+
+    virtual void fromMemorySegment(ExternalSegmentType* segment, const std::string& objectNamesPrefix, const void* tileDataPtr) OVERRIDE FINAL;
+
+    virtual bool fromTileData(const void* tileDataPtr) OVERRIDE FINAL;
+
+private:
+
+    boost::scoped_ptr<CacheImageTileMipMapsPrivate> _imp;
+};
+
 NATRON_NAMESPACE_EXIT;
 
 #endif // NATRON_ENGINE_IMAGESTORAGE_H
@@ -99,6 +99,7 @@ void
 JoinViewsNode::addSupportedBitDepth(std::list<ImageBitDepthEnum>* depths) const
 {
     depths->push_back(eImageBitDepthFloat);
+    depths->push_back(eImageBitDepthHalf);
     depths->push_back(eImageBitDepthShort);
     depths->push_back(eImageBitDepthByte);
 }
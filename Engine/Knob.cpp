@@ -32,6 +32,7 @@
 #include <cassert>
 #include <stdexcept>
 #include <sstream> // stringstream
+#include <vector>
 
 #include <QtCore/QDataStream>
 #include <QtCore/QDateTime>
@@ -112,6 +113,26 @@ KnobHelper::KnobHelper(const KnobHolderPtr& holder,
 
 KnobHelper::~KnobHelper()
 {
+    // The compiled expressions are released by clearExpression(), which is not called for knobs that are destroyed
+    // without being deleted, e.g: with their holder
+    std::vector<PyObject*> codes;
+    for (std::size_t i = 0; i < _imp->expressions.size(); ++i) {
+        for (ExprPerViewMap::iterator it = _imp->expressions[i].begin(); it != _imp->expressions[i].end(); ++it) {
+            if (it->second.code) {
+                codes.push_back(it->second.code);
+                it->second.code = 0;
+            }
+        }
+    }
+
+    // If Python was finalized, the objects are already gone
+    if ( codes.empty() || !Py_IsInitialized() ) {
+        return;
+    }
+    PythonGILLocker pgl;
+    for (std::size_t i = 0; i < codes.size(); ++i) {
+        Py_DECREF(codes[i]);
+    }
 }
 
 void
@@ -343,10 +343,17 @@ public:
         // The other knobs/dimension/view that have expressions referencing us
         KnobDimViewKeySet listeners;
 
-        //PyObject* code;
+        // The Python function compiled from the expression when it was set, called with (frame, view)
+        // to evaluate the expression without parsing it again. This is a strong reference, released
+        // by clearExpressionInternal. May be NULL if the expression is invalid.
+        PyObject* code;
+
+        // The expression compiled to a native expression tree if it only uses the arithmetic subset
+        // supported by KnobNativeExpression, so that it can be evaluated without Python. May be NULL.
+        KnobNativeExpressionPtr native;
 
         Expr()
-        : expression(), originalExpression(), exprInvalid(), hasRet(false) /*, code(0)*/ {}
+        : expression(), originalExpression(), exprInvalid(), hasRet(false), code(0), native() {}
     };
 
     /**
@@ -1806,6 +1813,13 @@ protected:
     ///The return value must be Py_DECRREF
     bool executeExpression(TimeValue time, ViewIdx view, DimIdx dimension, PyObject** ret, std::string* error) const;
 
+    /**
+     * @brief Evaluates the expression without Python if it could be compiled by KnobNativeExpression.
+     * Returns false if there is no such expression or if its evaluation failed, in which case executeExpression
+     * must be called.
+     **/
+    bool evaluateNativeExpression(TimeValue time, ViewIdx view, DimIdx dimension, double* result, bool* resultIsInt) const;
+
 public:
 
     virtual bool getSharingMaster(DimIdx dimension, ViewIdx view, KnobDimViewKey* linkData) const OVERRIDE FINAL;
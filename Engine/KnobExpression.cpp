@@ -26,9 +26,11 @@
 #include "Knob.h"
 #include "KnobPrivate.h"
 
+#include <cmath>
 #include <sstream> // stringstream
 
 #include "Engine/KnobItemsTable.h"
+#include "Engine/KnobNativeExpression.h"
 
 NATRON_NAMESPACE_ENTER
 
@@ -663,6 +665,58 @@ KnobHelper::validateExpression(const std::string& expression,
 } // KnobHelper::validateExpression
 
 NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+/**
+ * @brief Returns a new reference to the expression function defined by validateExpression, given the
+ * script it returned ("ret = <app>.<node>.<knob>.expression<dim>_<view>"), or NULL if it cannot be found.
+ * The GIL must be held.
+ **/
+static PyObject*
+getExpressionFunction(const std::string& funcExecScript)
+{
+    std::size_t foundEqual = funcExecScript.find('=');
+    if (foundEqual == std::string::npos) {
+        return 0;
+    }
+    std::size_t funcNameStart = funcExecScript.find_first_not_of(' ', foundEqual + 1);
+    if (funcNameStart == std::string::npos) {
+        return 0;
+    }
+    std::string funcName = funcExecScript.substr(funcNameStart);
+
+    PyObject* globalDict = PyModule_GetDict( NATRON_PYTHON_NAMESPACE::getMainModule() );
+    PyObject* func = PyRun_String(funcName.c_str(), Py_eval_input, globalDict, 0);
+    if ( !func || !PyCallable_Check(func) ) {
+        Py_XDECREF(func);
+        PyErr_Clear();
+
+        return 0;
+    }
+
+    return func;
+}
+
+/**
+ * @brief Returns the node designated by thisNode in the expressions of the knobs of the given holder.
+ **/
+static NodePtr
+getExpressionNode(const KnobHolderPtr& holder)
+{
+    EffectInstancePtr effect = toEffectInstance(holder);
+    if (effect) {
+        return effect->getNode();
+    }
+    KnobTableItemPtr tableItem = toKnobTableItem(holder);
+    if (tableItem) {
+        KnobItemsTablePtr model = tableItem->getModel();
+        if (model) {
+            return model->getNode();
+        }
+    }
+
+    return NodePtr();
+}
+
 struct ExprToReApply {
     ViewIdx view;
     DimIdx dimension;
@@ -837,8 +891,18 @@ KnobHelper::setExpressionInternal(DimIdx dimension,
     std::string exprResult;
     std::string exprCpy;
     std::string exprInvalid;
+    PyObject* code = 0;
+    KnobNativeExpressionPtr native;
     try {
         exprCpy = validateExpression(expression, dimension, view, hasRetVariable, &exprResult);
+
+        // Keep the compiled function so that evaluating the expression does not need to parse it again
+        code = getExpressionFunction(exprCpy);
+
+        // Simple arithmetic expressions are also compiled natively so they can be evaluated without the GIL
+        if ( !hasRetVariable && !dynamic_cast<KnobStringBase*>(this) ) {
+            native = KnobNativeExpression::compile( expression, shared_from_this(), getExpressionNode( getHolder() ), dimension );
+        }
     } catch (const std::exception &e) {
         exprInvalid = e.what();
         exprCpy = expression;
@@ -856,6 +920,9 @@ KnobHelper::setExpressionInternal(DimIdx dimension,
         expr.expression = exprCpy;
         expr.originalExpression = expression;
         expr.exprInvalid = exprInvalid;
+        Py_XDECREF(expr.code);
+        expr.code = code;
+        expr.native = native;
     }
 
     KnobHolderPtr holder = getHolder();
@@ -1038,6 +1105,9 @@ KnobHelper::clearExpressionInternal(DimIdx dimension, ViewIdx view)
             foundView->second.expression.clear();
             foundView->second.originalExpression.clear();
             foundView->second.exprInvalid.clear();
+            Py_XDECREF(foundView->second.code);
+            foundView->second.code = 0;
+            foundView->second.native.reset();
 
             dependencies = foundView->second.dependencies;
             foundView->second.dependencies.clear();
@@ -1164,7 +1234,9 @@ KnobHelper::executeExpression(TimeValue time,
         throw std::invalid_argument("KnobHelper::executeExpression(): Dimension out of range");
     }
 
+    // The caller holds the GIL
     std::string expr;
+    PyObject* code = 0;
     {
         QMutexLocker k(&_imp->expressionMutex);
         ExprPerViewMap::const_iterator foundView = _imp->expressions[dimension].find(view);
@@ -1172,13 +1244,13 @@ KnobHelper::executeExpression(TimeValue time,
             return false;
         }
         expr = foundView->second.expression;
+        code = foundView->second.code;
+
+        // Hold a reference in case the expression is changed while it is evaluated
+        Py_XINCREF(code);
     }
 
-    //returns a new ref, this function's documentation is not clear onto what it returns...
-    //https://docs.python.org/2/c-api/veryhigh.html
     PyObject* mainModule = NATRON_PYTHON_NAMESPACE::getMainModule();
-    PyObject* globalDict = PyModule_GetDict(mainModule);
-    std::stringstream ss;
 
     std::string viewName;
     if (getHolder() && getHolder()->getApp()) {
@@ -1188,13 +1260,42 @@ KnobHelper::executeExpression(TimeValue time,
         viewName = "Main";
     }
 
+    *ret = 0;
+
+    if (code) {
+        // Call the function compiled when the expression was set, it returns the ret variable.
+        // Pass integral frames as int like the script used to do, so that integer divisions behave the same.
+        PyObject* result;
+        if ( (double)time == std::floor( (double)time ) ) {
+            result = PyObject_CallFunction(code, (char*)"ls", (long)time, viewName.c_str());
+        } else {
+            result = PyObject_CallFunction(code, (char*)"ds", (double)time, viewName.c_str());
+        }
+        Py_DECREF(code);
+        if ( !catchErrors(mainModule, error) ) {
+            Py_XDECREF(result);
+
+            return false;
+        }
+        if (!result) {
+            *error = "Missing ret variable";
+
+            return false;
+        }
+        *ret = result;
+
+        return true;
+    }
+
+    //returns a new ref, this function's documentation is not clear onto what it returns...
+    //https://docs.python.org/2/c-api/veryhigh.html
+    PyObject* globalDict = PyModule_GetDict(mainModule);
+    std::stringstream ss;
     ss << expr << '(' << time << ", \"" << viewName << "\")\n";
     std::string script = ss.str();
     PyObject* v = PyRun_String(script.c_str(), Py_file_input, globalDict, 0);
     Py_XDECREF(v);
 
-    *ret = 0;
-
     if ( !catchErrors(mainModule, error) ) {
         return false;
     }
@@ -1211,6 +1312,33 @@ KnobHelper::executeExpression(TimeValue time,
     return true;
 } // executeExpression
 
+bool
+KnobHelper::evaluateNativeExpression(TimeValue time,
+                                     ViewIdx view,
+                                     DimIdx dimension,
+                                     double* result,
+                                     bool* resultIsInt) const
+{
+    if (dimension < 0 || dimension >= (int)_imp->expressions.size()) {
+        return false;
+    }
+
+    KnobNativeExpressionPtr native;
+    {
+        QMutexLocker k(&_imp->expressionMutex);
+        ExprPerViewMap::const_iterator foundView = _imp->expressions[dimension].find(view);
+        if (foundView == _imp->expressions[dimension].end()) {
+            return false;
+        }
+        native = foundView->second.native;
+    }
+    if (!native) {
+        return false;
+    }
+
+    return native->evaluate(time, result, resultIsInt);
+} // evaluateNativeExpression
+
 std::string
 KnobHelper::getExpression(DimIdx dimension, ViewIdx view) const
 {
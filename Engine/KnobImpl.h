@@ -30,6 +30,7 @@
 #include "Knob.h"
 
 #include <cfloat>
+#include <climits>
 #include <stdexcept>
 #include <string>
 #include <algorithm> // min, max
@@ -438,6 +439,51 @@ hashFunction(unsigned int a)
     return a;
 }
 
+/**
+ * @brief Converts the result of a native expression the same way pyObjectToType converts the Python result.
+ * Returns false if the result should be converted by Python.
+ **/
+inline bool
+nativeExpressionResultToValue(double result,
+                              bool /*resultIsInt*/,
+                              double* value)
+{
+    *value = result;
+
+    return true;
+}
+
+inline bool
+nativeExpressionResultToValue(double result,
+                              bool resultIsInt,
+                              int* value)
+{
+    if ( !resultIsInt || (result < INT_MIN) || (result > INT_MAX) ) {
+        return false;
+    }
+    *value = (int)result;
+
+    return true;
+}
+
+inline bool
+nativeExpressionResultToValue(double result,
+                              bool /*resultIsInt*/,
+                              bool* value)
+{
+    *value = result != 0.;
+
+    return true;
+}
+
+inline bool
+nativeExpressionResultToValue(double /*result*/,
+                              bool /*resultIsInt*/,
+                              std::string* /*value*/)
+{
+    return false;
+}
+
 template <typename T>
 bool
 Knob<T>::evaluateExpression(TimeValue time,
@@ -446,6 +492,16 @@ Knob<T>::evaluateExpression(TimeValue time,
                             T* value,
                             std::string* error)
 {
+    // Try first the native expression which does not need the GIL
+    {
+        double result;
+        bool resultIsInt;
+        if ( evaluateNativeExpression(time, view, dimension, &result, &resultIsInt) &&
+             nativeExpressionResultToValue(result, resultIsInt, value) ) {
+            return true;
+        }
+    }
+
     PythonGILLocker pgl;
     PyObject *ret;
 
@@ -468,6 +524,17 @@ Knob<T>::evaluateExpression_pod(TimeValue time,
                                 double* value,
                                 std::string* error)
 {
+    {
+        double result;
+        bool resultIsInt;
+        if ( evaluateNativeExpression(time, view, dimension, &result, &resultIsInt) &&
+             ( !resultIsInt || ( (result >= INT_MIN) && (result <= INT_MAX) ) ) ) {
+            *value = resultIsInt ? (double)(int)result : result;
+
+            return true;
+        }
+    }
+
     PythonGILLocker pgl;
     PyObject *ret;
 
@@ -0,0 +1,1236 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2017 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "KnobNativeExpression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cctype>
+#include <locale>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/math/special_functions/fpclassify.hpp>
+#endif
+
+#include "Engine/Knob.h"
+#include "Engine/KnobTypes.h"
+#include "Engine/Node.h"
+#include "Engine/NodeGroup.h"
+#include "Engine/ViewIdx.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846264338327950288
+#endif
+
+#ifndef M_E
+#define M_E 2.71828182845904523536028747135266250
+#endif
+
+NATRON_NAMESPACE_ENTER;
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+// Python ints are arbitrary precision: integer results are only computed natively as long as they
+// are exactly representable by a double, otherwise the expression is left to Python.
+const double kMaxExactInteger = 9007199254740992.; // 2^53
+
+/**
+ * @brief A value in the expression tree, which is either a Python int or a Python float.
+ **/
+struct NativeValue
+{
+    double value;
+    bool isInt;
+
+    NativeValue()
+    : value(0.)
+    , isInt(true)
+    {
+    }
+
+    NativeValue(double v,
+                bool i)
+    : value(v)
+    , isInt(i)
+    {
+    }
+};
+
+inline bool
+isValidResult(const NativeValue& v)
+{
+    if ( !(boost::math::isfinite)(v.value) ) {
+        return false;
+    }
+
+    return !v.isInt || std::fabs(v.value) <= kMaxExactInteger;
+}
+
+inline NativeValue
+makeInt(double v)
+{
+    return NativeValue(v, true);
+}
+
+inline NativeValue
+makeFloat(double v)
+{
+    return NativeValue(v, false);
+}
+
+/**
+ * @brief Base class of all nodes of the expression tree. The tree is immutable once compiled
+ * so it can be evaluated concurrently from any thread.
+ **/
+class ExprNode
+{
+public:
+
+    ExprNode()
+    {
+    }
+
+    virtual ~ExprNode()
+    {
+    }
+
+    /**
+     * @brief Returns false whenever Python would raise an exception, or if the result could not
+     * be computed exactly as Python would.
+     **/
+    virtual bool evaluate(TimeValue frame, NativeValue* result) const = 0;
+};
+
+typedef boost::shared_ptr<ExprNode> ExprNodePtr;
+
+class ConstantNode
+    : public ExprNode
+{
+    NativeValue _value;
+
+public:
+
+    ConstantNode(const NativeValue& value)
+    : ExprNode()
+    , _value(value)
+    {
+    }
+
+    virtual bool evaluate(TimeValue /*frame*/,
+                          NativeValue* result) const OVERRIDE FINAL
+    {
+        *result = _value;
+
+        return true;
+    }
+};
+
+class FrameNode
+    : public ExprNode
+{
+public:
+
+    FrameNode()
+    : ExprNode()
+    {
+    }
+
+    virtual bool evaluate(TimeValue frame,
+                          NativeValue* result) const OVERRIDE FINAL
+    {
+        // Integral frames are passed to the expression function as an int, see KnobHelper::executeExpression
+        double f = (double)frame;
+        *result = NativeValue( f, f == std::floor(f) );
+
+        return isValidResult(*result);
+    }
+};
+
+class NegateNode
+    : public ExprNode
+{
+    ExprNodePtr _operand;
+
+public:
+
+    NegateNode(const ExprNodePtr& operand)
+    : ExprNode()
+    , _operand(operand)
+    {
+    }
+
+    virtual bool evaluate(TimeValue frame,
+                          NativeValue* result) const OVERRIDE FINAL
+    {
+        if ( !_operand->evaluate(frame, result) ) {
+            return false;
+        }
+        result->value = -result->value;
+
+        return true;
+    }
+};
+
+enum BinaryOperatorEnum
+{
+    eBinaryOperatorAdd = 0,
+    eBinaryOperatorSubtract,
+    eBinaryOperatorMultiply,
+    eBinaryOperatorDivide,
+    eBinaryOperatorFloorDivide,
+    eBinaryOperatorModulo,
+    eBinaryOperatorPower
+};
+
+// Same algorithm as float_divmod in Python's floatobject.c
+void
+floatDivMod(double a,
+            double b,
+            double* floorDiv,
+            double* mod)
+{
+    double m = std::fmod(a, b);
+    double div = (a - m) / b;
+
+    if (m != 0.) {
+        if ( (b < 0.) != (m < 0.) ) {
+            m += b;
+            div -= 1.;
+        }
+    } else {
+        m = b < 0. ? -0. : 0.;
+    }
+    double floorDivValue;
+    if (div != 0.) {
+        floorDivValue = std::floor(div);
+        if (div - floorDivValue > 0.5) {
+            floorDivValue += 1.;
+        }
+    } else {
+        floorDivValue = a / b < 0. ? -0. : 0.;
+    }
+    *floorDiv = floorDivValue;
+    *mod = m;
+}
+
+// Python semantics for integers: the result of // rounds towards minus infinity and % has the sign of the divisor
+void
+intDivMod(long long a,
+          long long b,
+          long long* floorDiv,
+          long long* mod)
+{
+    long long q = a / b;
+    long long r = a % b;
+
+    if ( (r != 0) && ( (r < 0) != (b < 0) ) ) {
+        q -= 1;
+        r += b;
+    }
+    *floorDiv = q;
+    *mod = r;
+}
+
+bool
+intPower(long long base,
+         long long exponent,
+         double* result)
+{
+    // Exponentiation by squaring, failing as soon as the result is no longer exactly representable
+    double r = 1.;
+    double b = (double)base;
+
+    while (exponent > 0) {
+        if (exponent & 1) {
+            r *= b;
+            if (std::fabs(r) > kMaxExactInteger) {
+                return false;
+            }
+        }
+        exponent >>= 1;
+        if (exponent > 0) {
+            b *= b;
+            if (std::fabs(b) > kMaxExactInteger) {
+                return false;
+            }
+        }
+    }
+    *result = r;
+
+    return true;
+}
+
+class BinaryOperatorNode
+    : public ExprNode
+{
+    BinaryOperatorEnum _op;
+    ExprNodePtr _lhs, _rhs;
+
+public:
+
+    BinaryOperatorNode(BinaryOperatorEnum op,
+                       const ExprNodePtr& lhs,
+                       const ExprNodePtr& rhs)
+    : ExprNode()
+    , _op(op)
+    , _lhs(lhs)
+    , _rhs(rhs)
+    {
+    }
+
+    virtual bool evaluate(TimeValue frame,
+                          NativeValue* result) const OVERRIDE FINAL
+    {
+        NativeValue a, b;
+
+        if ( !_lhs->evaluate(frame, &a) || !_rhs->evaluate(frame, &b) ) {
+            return false;
+        }
+        bool bothInts = a.isInt && b.isInt;
+        switch (_op) {
+        case eBinaryOperatorAdd:
+            *result = NativeValue(a.value + b.value, bothInts);
+            break;
+        case eBinaryOperatorSubtract:
+            *result = NativeValue(a.value - b.value, bothInts);
+            break;
+        case eBinaryOperatorMultiply:
+            *result = NativeValue(a.value * b.value, bothInts);
+            break;
+        case eBinaryOperatorDivide:
+            if (b.value == 0.) {
+                return false;
+            }
+            if (bothInts) {
+#if PY_MAJOR_VERSION >= 3
+                *result = makeFloat(a.value / b.value);
+#else
+                long long q, r;
+                intDivMod( (long long)a.value, (long long)b.value, &q, &r );
+                *result = makeInt( (double)q );
+#endif
+            } else {
+                *result = makeFloat(a.value / b.value);
+            }
+            break;
+        case eBinaryOperatorFloorDivide:
+        case eBinaryOperatorModulo: {
+            if (b.value == 0.) {
+                return false;
+            }
+            if (bothInts) {
+                long long q, r;
+                intDivMod( (long long)a.value, (long long)b.value, &q, &r );
+                *result = makeInt( (double)(_op == eBinaryOperatorFloorDivide ? q : r) );
+            } else {
+                double q, r;
+                floatDivMod(a.value, b.value, &q, &r);
+                *result = makeFloat(_op == eBinaryOperatorFloorDivide ? q : r);
+            }
+            break;
+        }
+        case eBinaryOperatorPower:
+            if ( bothInts && (b.value >= 0.) ) {
+                double r;
+                if ( !intPower( (long long)a.value, (long long)b.value, &r ) ) {
+                    return false;
+                }
+                *result = makeInt(r);
+            } else {
+                if ( (a.value == 0.) && (b.value < 0.) ) {
+                    // ZeroDivisionError
+                    return false;
+                }
+                if ( (a.value < 0.) && ( b.value != std::floor(b.value) ) ) {
+                    // Complex result in Python 3, ValueError in Python 2
+                    return false;
+                }
+                *result = makeFloat( std::pow(a.value, b.value) );
+            }
+            break;
+        }
+
+        return isValidResult(*result);
+    } // evaluate
+};
+
+enum FunctionEnum
+{
+    eFunctionSin = 0,
+    eFunctionCos,
+    eFunctionTan,
+    eFunctionAsin,
+    eFunctionAcos,
+    eFunctionAtan,
+    eFunctionAtan2,
+    eFunctionSinh,
+    eFunctionCosh,
+    eFunctionTanh,
+    eFunctionExp,
+    eFunctionLog,
+    eFunctionLog10,
+    eFunctionSqrt,
+    eFunctionPow,
+    eFunctionFabs,
+    eFunctionFmod,
+    eFunctionHypot,
+    eFunctionDegrees,
+    eFunctionRadians,
+    eFunctionFloor,
+    eFunctionCeil,
+    eFunctionAbs,
+    eFunctionMin,
+    eFunctionMax,
+    eFunctionInt,
+    eFunctionFloat
+};
+
+struct FunctionDescriptor
+{
+    const char* name;
+    FunctionEnum function;
+    int minArgs;
+    int maxArgs; // -1 means unlimited
+};
+
+// The functions from the math module (imported with from math import * in the expression scope) and the builtins supported
+const FunctionDescriptor kFunctions[] = {
+    { "sin", eFunctionSin, 1, 1 },
+    { "cos", eFunctionCos, 1, 1 },
+    { "tan", eFunctionTan, 1, 1 },
+    { "asin", eFunctionAsin, 1, 1 },
+    { "acos", eFunctionAcos, 1, 1 },
+    { "atan", eFunctionAtan, 1, 1 },
+    { "atan2", eFunctionAtan2, 2, 2 },
+    { "sinh", eFunctionSinh, 1, 1 },
+    { "cosh", eFunctionCosh, 1, 1 },
+    { "tanh", eFunctionTanh, 1, 1 },
+    { "exp", eFunctionExp, 1, 1 },
+    { "log", eFunctionLog, 1, 2 },
+    { "log10", eFunctionLog10, 1, 1 },
+    { "sqrt", eFunctionSqrt, 1, 1 },
+    { "pow", eFunctionPow, 2, 2 },
+    { "fabs", eFunctionFabs, 1, 1 },
+    { "fmod", eFunctionFmod, 2, 2 },
+    { "hypot", eFunctionHypot, 2, 2 },
+    { "degrees", eFunctionDegrees, 1, 1 },
+    { "radians", eFunctionRadians, 1, 1 },
+    { "floor", eFunctionFloor, 1, 1 },
+    { "ceil", eFunctionCeil, 1, 1 },
+    { "abs", eFunctionAbs, 1, 1 },
+    { "min", eFunctionMin, 2, -1 },
+    { "max", eFunctionMax, 2, -1 },
+    { "int", eFunctionInt, 1, 1 },
+    { "float", eFunctionFloat, 1, 1 },
+    { 0, eFunctionSin, 0, 0 }
+};
+
+const FunctionDescriptor*
+findFunction(const std::string& name)
+{
+    for (const FunctionDescriptor* f = kFunctions; f->name; ++f) {
+        if (name == f->name) {
+            return f;
+        }
+    }
+
+    return 0;
+}
+
+class FunctionNode
+    : public ExprNode
+{
+    FunctionEnum _function;
+    std::vector<ExprNodePtr> _args;
+
+public:
+
+    FunctionNode(FunctionEnum function,
+                 const std::vector<ExprNodePtr>& args)
+    : ExprNode()
+    , _function(function)
+    , _args(args)
+    {
+    }
+
+    virtual bool evaluate(TimeValue frame,
+                          NativeValue* result) const OVERRIDE FINAL
+    {
+        NativeValue args[2];
+        std::size_t nArgsToEvaluate = std::min(_args.size(), (std::size_t)2);
+
+        for (std::size_t i = 0; i < nArgsToEvaluate; ++i) {
+            if ( !_args[i]->evaluate(frame, &args[i]) ) {
+                return false;
+            }
+        }
+        const double x = args[0].value;
+        const double y = args[1].value;
+        switch (_function) {
+        case eFunctionSin:
+            *result = makeFloat( std::sin(x) );
+            break;
+        case eFunctionCos:
+            *result = makeFloat( std::cos(x) );
+            break;
+        case eFunctionTan:
+            *result = makeFloat( std::tan(x) );
+            break;
+        case eFunctionAsin:
+            *result = makeFloat( std::asin(x) );
+            break;
+        case eFunctionAcos:
+            *result = makeFloat( std::acos(x) );
+            break;
+        case eFunctionAtan:
+            *result = makeFloat( std::atan(x) );
+            break;
+        case eFunctionAtan2:
+            *result = makeFloat( std::atan2(x, y) );
+            break;
+        case eFunctionSinh:
+            *result = makeFloat( std::sinh(x) );
+            break;
+        case eFunctionCosh:
+            *result = makeFloat( std::cosh(x) );
+            break;
+        case eFunctionTanh:
+            *result = makeFloat( std::tanh(x) );
+            break;
+        case eFunctionExp:
+            *result = makeFloat( std::exp(x) );
+            break;
+        case eFunctionLog:
+            if ( x <= 0. || ( (_args.size() == 2) && (y <= 0. || y == 1.) ) ) {
+                return false;
+            }
+            *result = makeFloat( _args.size() == 2 ? std::log(x) / std::log(y) : std::log(x) );
+            break;
+        case eFunctionLog10:
+            if (x <= 0.) {
+                return false;
+            }
+            *result = makeFloat( std::log10(x) );
+            break;
+        case eFunctionSqrt:
+            if (x < 0.) {
+                return false;
+            }
+            *result = makeFloat( std::sqrt(x) );
+            break;
+        case eFunctionPow:
+            // This is math.pow, which shadows the builtin pow in the expression scope: the result is always a float
+            if ( ( (x == 0.) && (y < 0.) ) || ( (x < 0.) && ( y != std::floor(y) ) ) ) {
+                return false;
+            }
+            *result = makeFloat( std::pow(x, y) );
+            break;
+        case eFunctionFabs:
+            *result = makeFloat( std::fabs(x) );
+            break;
+        case eFunctionFmod:
+            if (y == 0.) {
+                return false;
+            }
+            *result = makeFloat( std::fmod(x, y) );
+            break;
+        case eFunctionHypot:
+            *result = makeFloat( std::sqrt(x * x + y * y) );
+            break;
+        case eFunctionDegrees:
+            *result = makeFloat(x * (180. / M_PI));
+            break;
+        case eFunctionRadians:
+            *result = makeFloat(x * (M_PI / 180.));
+            break;
+        case eFunctionFloor:
+#if PY_MAJOR_VERSION >= 3
+            *result = makeInt( std::floor(x) );
+#else
+            *result = makeFloat( std::floor(x) );
+#endif
+            break;
+        case eFunctionCeil:
+#if PY_MAJOR_VERSION >= 3
+            *result = makeInt( std::ceil(x) );
+#else
+            *result = makeFloat( std::ceil(x) );
+#endif
+            break;
+        case eFunctionAbs:
+            *result = NativeValue(std::fabs(x), args[0].isInt);
+            break;
+        case eFunctionMin:
+        case eFunctionMax: {
+            // The first extreme value wins, as in Python
+            *result = args[0];
+            for (std::size_t i = 1; i < _args.size(); ++i) {
+                NativeValue v;
+                if (i < nArgsToEvaluate) {
+                    v = args[i];
+                } else if ( !_args[i]->evaluate(frame, &v) ) {
+                    return false;
+                }
+                if ( (_function == eFunctionMin) ? (v.value < result->value) : (v.value > result->value) ) {
+                    *result = v;
+                }
+            }
+            break;
+        }
+        case eFunctionInt:
+            if ( !(boost::math::isfinite)(x) ) {
+                return false;
+            }
+            *result = makeInt( x < 0. ? std::ceil(x) : std::floor(x) );
+            break;
+        case eFunctionFloat:
+            *result = makeFloat(x);
+            break;
+        } // switch
+
+        return isValidResult(*result);
+    } // evaluate
+};
+
+/**
+ * @brief Reads the value of a parameter. Parameters are held weakly: if the parameter no longer exists,
+ * the evaluation fails and Python reports the error.
+ **/
+class KnobValueNode
+    : public ExprNode
+{
+    boost::weak_ptr<KnobIntBase> _intKnob;
+    boost::weak_ptr<KnobDoubleBase> _doubleKnob;
+    boost::weak_ptr<KnobBoolBase> _boolKnob;
+    ExprNodePtr _dimension;
+
+    // If NULL, the value is read at the current time
+    ExprNodePtr _time;
+
+public:
+
+    KnobValueNode(const KnobIPtr& knob,
+                  const ExprNodePtr& dimension,
+                  const ExprNodePtr& time)
+    : ExprNode()
+    , _intKnob( toKnobIntBase(knob) )
+    , _doubleKnob( toKnobDoubleBase(knob) )
+    , _boolKnob( toKnobBoolBase(knob) )
+    , _dimension(dimension)
+    , _time(time)
+    {
+    }
+
+    virtual bool evaluate(TimeValue frame,
+                          NativeValue* result) const OVERRIDE FINAL
+    {
+        NativeValue dimension;
+
+        if ( !_dimension->evaluate(frame, &dimension) || !dimension.isInt ) {
+            return false;
+        }
+        NativeValue time;
+        if ( _time && !_time->evaluate(frame, &time) ) {
+            return false;
+        }
+
+        KnobIntBasePtr intKnob = _intKnob.lock();
+        KnobDoubleBasePtr doubleKnob = _doubleKnob.lock();
+        KnobBoolBasePtr boolKnob = _boolKnob.lock();
+        KnobIPtr knob;
+        if (intKnob) {
+            knob = intKnob;
+        } else if (doubleKnob) {
+            knob = doubleKnob;
+        } else if (boolKnob) {
+            knob = boolKnob;
+        } else {
+            return false;
+        }
+        if ( (dimension.value < 0.) || ( dimension.value >= knob->getNDimensions() ) ) {
+            return false;
+        }
+        DimIdx dim( (int)dimension.value );
+        if (intKnob) {
+            *result = makeInt( _time ? intKnob->getValueAtTime(TimeValue(time.value), dim, ViewIdx(0)) : intKnob->getValue(dim, ViewIdx(0)) );
+        } else if (doubleKnob) {
+            *result = makeFloat( _time ? doubleKnob->getValueAtTime(TimeValue(time.value), dim, ViewIdx(0)) : doubleKnob->getValue(dim, ViewIdx(0)) );
+        } else {
+            *result = makeInt( ( _time ? boolKnob->getValueAtTime(TimeValue(time.value), dim, ViewIdx(0)) : boolKnob->getValue(dim, ViewIdx(0)) ) ? 1. : 0. );
+        }
+
+        return isValidResult(*result);
+    }
+};
+
+struct Token
+{
+    enum TypeEnum
+    {
+        eTypeNumber = 0,
+        eTypeName,
+        eTypeOperator,
+        eTypeEnd
+    };
+
+    TypeEnum type;
+    std::string text;
+    NativeValue number;
+
+    Token()
+    : type(eTypeEnd)
+    , text()
+    , number()
+    {
+    }
+};
+
+bool
+isNameStart(char c)
+{
+    return std::isalpha( (unsigned char)c ) || c == '_';
+}
+
+bool
+isNameChar(char c)
+{
+    return std::isalnum( (unsigned char)c ) || c == '_';
+}
+
+bool
+isDigit(char c)
+{
+    return std::isdigit( (unsigned char)c ) != 0;
+}
+
+bool
+tokenize(const std::string& expression,
+         std::vector<Token>* tokens)
+{
+    std::size_t i = 0;
+    const std::size_t n = expression.size();
+
+    while (i < n) {
+        char c = expression[i];
+        if ( (c == ' ') || (c == '\t') ) {
+            ++i;
+            continue;
+        }
+        Token t;
+        if ( isDigit(c) || ( (c == '.') && (i + 1 < n) && isDigit(expression[i + 1]) ) ) {
+            std::size_t start = i;
+            bool isInt = true;
+            while ( i < n && isDigit(expression[i]) ) {
+                ++i;
+            }
+            if ( (i < n) && (expression[i] == '.') ) {
+                isInt = false;
+                ++i;
+                while ( i < n && isDigit(expression[i]) ) {
+                    ++i;
+                }
+            }
+            if ( (i < n) && ( (expression[i] == 'e') || (expression[i] == 'E') ) ) {
+                isInt = false;
+                ++i;
+                if ( (i < n) && ( (expression[i] == '+') || (expression[i] == '-') ) ) {
+                    ++i;
+                }
+                if ( (i >= n) || !isDigit(expression[i]) ) {
+                    return false;
+                }
+                while ( i < n && isDigit(expression[i]) ) {
+                    ++i;
+                }
+            }
+            // Hexadecimal, long or complex literals are left to Python
+            if ( (i < n) && isNameStart(expression[i]) ) {
+                return false;
+            }
+            t.type = Token::eTypeNumber;
+            t.text = expression.substr(start, i - start);
+            // Octal literals in Python 2, syntax error in Python 3
+            if ( isInt && (t.text.size() > 1) && (t.text[0] == '0') ) {
+                return false;
+            }
+            // Parse with the C locale so that the decimal separator is always the dot
+            std::istringstream ss(t.text);
+            ss.imbue( std::locale::classic() );
+            double value;
+            ss >> value;
+            if ( ss.fail() ) {
+                return false;
+            }
+            t.number = NativeValue(value, isInt);
+            if ( !isValidResult(t.number) ) {
+                return false;
+            }
+        } else if ( isNameStart(c) ) {
+            std::size_t start = i;
+            while ( i < n && isNameChar(expression[i]) ) {
+                ++i;
+            }
+            t.type = Token::eTypeName;
+            t.text = expression.substr(start, i - start);
+        } else if ( (i + 1 < n) && ( (expression.compare(i, 2, "**") == 0) || (expression.compare(i, 2, "//") == 0) ) ) {
+            t.type = Token::eTypeOperator;
+            t.text = expression.substr(i, 2);
+            i += 2;
+        } else if ( std::string("+-*/%()[],.").find(c) != std::string::npos ) {
+            t.type = Token::eTypeOperator;
+            t.text = std::string(1, c);
+            ++i;
+        } else {
+            // Strings, comparisons, comments, statements...
+            return false;
+        }
+        tokens->push_back(t);
+    }
+    tokens->push_back( Token() );
+
+    return true;
+} // tokenize
+
+/**
+ * @brief Recursive descent parser following the Python operator precedence. Each parse function
+ * returns NULL if the expression is not supported.
+ **/
+class Parser
+{
+    const std::vector<Token>& _tokens;
+    std::size_t _pos;
+    KnobIPtr _thisKnob;
+    NodePtr _thisNode;
+    DimIdx _dimension;
+
+public:
+
+    Parser(const std::vector<Token>& tokens,
+           const KnobIPtr& thisKnob,
+           const NodePtr& thisNode,
+           DimIdx dimension)
+    : _tokens(tokens)
+    , _pos(0)
+    , _thisKnob(thisKnob)
+    , _thisNode(thisNode)
+    , _dimension(dimension)
+    {
+    }
+
+    ExprNodePtr parse()
+    {
+        ExprNodePtr ret = parseSum();
+
+        if ( !ret || (peek().type != Token::eTypeEnd) ) {
+            return ExprNodePtr();
+        }
+
+        return ret;
+    }
+
+private:
+
+    const Token& peek() const
+    {
+        return _tokens[_pos];
+    }
+
+    bool isOperator(const char* op) const
+    {
+        return peek().type == Token::eTypeOperator && peek().text == op;
+    }
+
+    bool acceptOperator(const char* op)
+    {
+        if ( !isOperator(op) ) {
+            return false;
+        }
+        ++_pos;
+
+        return true;
+    }
+
+    bool acceptName(std::string* name)
+    {
+        if (peek().type != Token::eTypeName) {
+            return false;
+        }
+        *name = peek().text;
+        ++_pos;
+
+        return true;
+    }
+
+    ExprNodePtr parseSum()
+    {
+        ExprNodePtr lhs = parseProduct();
+
+        while (lhs) {
+            BinaryOperatorEnum op;
+            if ( acceptOperator("+") ) {
+                op = eBinaryOperatorAdd;
+            } else if ( acceptOperator("-") ) {
+                op = eBinaryOperatorSubtract;
+            } else {
+                break;
+            }
+            ExprNodePtr rhs = parseProduct();
+            if (!rhs) {
+                return ExprNodePtr();
+            }
+            lhs.reset( new BinaryOperatorNode(op, lhs, rhs) );
+        }
+
+        return lhs;
+    }
+
+    ExprNodePtr parseProduct()
+    {
+        ExprNodePtr lhs = parseUnary();
+
+        while (lhs) {
+            BinaryOperatorEnum op;
+            if ( acceptOperator("*") ) {
+                op = eBinaryOperatorMultiply;
+            } else if ( acceptOperator("/") ) {
+                op = eBinaryOperatorDivide;
+            } else if ( acceptOperator("//") ) {
+                op = eBinaryOperatorFloorDivide;
+            } else if ( acceptOperator("%") ) {
+                op = eBinaryOperatorModulo;
+            } else {
+                break;
+            }
+            ExprNodePtr rhs = parseUnary();
+            if (!rhs) {
+                return ExprNodePtr();
+            }
+            lhs.reset( new BinaryOperatorNode(op, lhs, rhs) );
+        }
+
+        return lhs;
+    }
+
+    ExprNodePtr parseUnary()
+    {
+        if ( acceptOperator("+") ) {
+            return parseUnary();
+        }
+        if ( acceptOperator("-") ) {
+            ExprNodePtr operand = parseUnary();
+            if (!operand) {
+                return ExprNodePtr();
+            }
+
+            return ExprNodePtr( new NegateNode(operand) );
+        }
+
+        return parsePower();
+    }
+
+    ExprNodePtr parsePower()
+    {
+        ExprNodePtr base = parsePrimary();
+
+        if ( !base || !acceptOperator("**") ) {
+            return base;
+        }
+        // ** is right associative and binds less tightly than a unary operator on its right: 2**-1
+        ExprNodePtr exponent = parseUnary();
+        if (!exponent) {
+            return ExprNodePtr();
+        }
+
+        return ExprNodePtr( new BinaryOperatorNode(eBinaryOperatorPower, base, exponent) );
+    }
+
+    bool parseArguments(std::vector<ExprNodePtr>* args)
+    {
+        if ( !acceptOperator("(") ) {
+            return false;
+        }
+        if ( acceptOperator(")") ) {
+            return true;
+        }
+        for (;;) {
+            ExprNodePtr arg = parseSum();
+            if (!arg) {
+                return false;
+            }
+            args->push_back(arg);
+            if ( acceptOperator(")") ) {
+                return true;
+            }
+            if ( !acceptOperator(",") ) {
+                return false;
+            }
+        }
+    }
+
+    ExprNodePtr parsePrimary()
+    {
+        const Token& t = peek();
+
+        if (t.type == Token::eTypeNumber) {
+            ++_pos;
+
+            return ExprNodePtr( new ConstantNode(t.number) );
+        }
+        if ( acceptOperator("(") ) {
+            ExprNodePtr ret = parseSum();
+            if ( !ret || !acceptOperator(")") ) {
+                return ExprNodePtr();
+            }
+
+            return ret;
+        }
+        std::string name;
+        if ( !acceptName(&name) ) {
+            return ExprNodePtr();
+        }
+
+        // Variables declared in the expression function shadow its arguments which in turn shadow the globals,
+        // see KnobHelperPrivate::getReachablePythonAttributesForExpression
+        if (name == "dimension") {
+            return ExprNodePtr( new ConstantNode( makeInt(_dimension) ) );
+        }
+        if ( (name == "thisParam") || (name == "thisNode") || (name == "thisGroup") ) {
+            return parseKnobValue(name);
+        }
+        if ( (name == "thisItem") || (name == "random") || (name == "randomInt") || (name == "curve") || (name == "view") ) {
+            return ExprNodePtr();
+        }
+        if ( getSibling(name) ) {
+            return parseKnobValue(name);
+        }
+        if ( (name == "app") || (name == "frame") ) {
+            // app may be redefined to the application instance
+            return name == "frame" ? ExprNodePtr( new FrameNode() ) : ExprNodePtr();
+        }
+        if (name == "pi") {
+            return ExprNodePtr( new ConstantNode( makeFloat(M_PI) ) );
+        }
+        if (name == "e") {
+            return ExprNodePtr( new ConstantNode( makeFloat(M_E) ) );
+        }
+
+        const FunctionDescriptor* func = findFunction(name);
+        if (!func) {
+            return ExprNodePtr();
+        }
+        std::vector<ExprNodePtr> args;
+        if ( !parseArguments(&args) ) {
+            return ExprNodePtr();
+        }
+        if ( ( (int)args.size() < func->minArgs ) || ( (func->maxArgs != -1) && ( (int)args.size() > func->maxArgs ) ) ) {
+            return ExprNodePtr();
+        }
+
+        return ExprNodePtr( new FunctionNode(func->function, args) );
+    } // parsePrimary
+
+    NodePtr getSibling(const std::string& scriptName) const
+    {
+        if (!_thisNode) {
+            return NodePtr();
+        }
+        NodeCollectionPtr group = _thisNode->getGroup();
+        if (!group) {
+            return NodePtr();
+        }
+        NodesList siblings = group->getNodes();
+        for (NodesList::iterator it = siblings.begin(); it != siblings.end(); ++it) {
+            if ( (*it)->isActivated() && ( (*it)->getScriptName_mt_safe() == scriptName ) ) {
+                return *it;
+            }
+        }
+
+        return NodePtr();
+    }
+
+    ExprNodePtr parseKnobValue(const std::string& name)
+    {
+        KnobIPtr knob;
+
+        if (name == "thisParam") {
+            knob = _thisKnob;
+        } else {
+            NodePtr node;
+            if (name == "thisNode") {
+                node = _thisNode;
+            } else if (name == "thisGroup") {
+                // thisGroup is the application at the top-level, which does not have parameters
+                NodeGroupPtr group = _thisNode ? toNodeGroup( _thisNode->getGroup() ) : NodeGroupPtr();
+                if (group) {
+                    node = group->getNode();
+                }
+            } else {
+                node = getSibling(name);
+            }
+            std::string knobName;
+            if ( !node || !acceptOperator(".") || !acceptName(&knobName) ) {
+                return ExprNodePtr();
+            }
+            knob = node->getKnobByName(knobName);
+        }
+        if (!knob) {
+            return ExprNodePtr();
+        }
+
+        // Only the parameter types which Python classes expose the get functions and return a number
+        KnobColorPtr isColor = toKnobColor(knob);
+        int nDims = knob->getNDimensions();
+        bool isSupportedType = toKnobDouble(knob) || isColor || toKnobInt(knob) || toKnobBool(knob) || toKnobChoice(knob);
+        if ( !isSupportedType || ( !isColor && (nDims > 3) ) ) {
+            return ExprNodePtr();
+        }
+
+        std::string method;
+        std::vector<ExprNodePtr> args;
+        if ( !acceptOperator(".") || !acceptName(&method) || !parseArguments(&args) ) {
+            return ExprNodePtr();
+        }
+        ExprNodePtr zero( new ConstantNode( makeInt(0) ) );
+        if (method == "get") {
+            if (args.size() > 1) {
+                return ExprNodePtr();
+            }
+            ExprNodePtr time = args.empty() ? ExprNodePtr() : args[0];
+            if (nDims == 1) {
+                return ExprNodePtr( new KnobValueNode(knob, zero, time) );
+            }
+
+            // Multi-dimensional parameters return a tuple: only one of its elements can be used
+            ExprNodePtr dimension;
+            std::string attr;
+            if ( acceptOperator("[") ) {
+                dimension = parseSum();
+                if ( !dimension || !acceptOperator("]") ) {
+                    return ExprNodePtr();
+                }
+            } else if ( acceptOperator(".") && acceptName(&attr) ) {
+                const char* attrs = isColor ? "rgba" : "xyz";
+                std::size_t index = attr.size() == 1 ? std::string(attrs).find(attr[0]) : std::string::npos;
+                if ( (index == std::string::npos) || ( (int)index >= nDims ) ) {
+                    return ExprNodePtr();
+                }
+                dimension.reset( new ConstantNode( makeInt( (double)index ) ) );
+            } else {
+                return ExprNodePtr();
+            }
+
+            return ExprNodePtr( new KnobValueNode(knob, dimension, time) );
+        } else if (method == "getValue") {
+            if (args.size() > 1) {
+                return ExprNodePtr();
+            }
+
+            return ExprNodePtr( new KnobValueNode(knob, args.empty() ? zero : args[0], ExprNodePtr()) );
+        } else if (method == "getValueAtTime") {
+            if ( args.empty() || (args.size() > 2) ) {
+                return ExprNodePtr();
+            }
+
+            return ExprNodePtr( new KnobValueNode(knob, args.size() == 2 ? args[1] : zero, args[0]) );
+        }
+
+        return ExprNodePtr();
+    } // parseKnobValue
+};
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+struct KnobNativeExpressionPrivate
+{
+    ExprNodePtr root;
+
+    KnobNativeExpressionPrivate()
+    : root()
+    {
+    }
+};
+
+KnobNativeExpression::KnobNativeExpression()
+    : _imp( new KnobNativeExpressionPrivate() )
+{
+}
+
+KnobNativeExpression::~KnobNativeExpression()
+{
+}
+
+KnobNativeExpressionPtr
+KnobNativeExpression::compile(const std::string& expression,
+                              const KnobIPtr& thisKnob,
+                              const NodePtr& thisNode,
+                              DimIdx dimension)
+{
+    // Only single-line expressions may be compiled, the others need to assign the ret variable
+    if ( expression.find_first_of("\n\r;=") != std::string::npos ) {
+        return KnobNativeExpressionPtr();
+    }
+    std::vector<Token> tokens;
+    if ( !tokenize(expression, &tokens) ) {
+        return KnobNativeExpressionPtr();
+    }
+
+    ExprNodePtr root;
+    try {
+        Parser parser(tokens, thisKnob, thisNode, dimension);
+        root = parser.parse();
+    } catch (const std::exception& /*e*/) {
+        return KnobNativeExpressionPtr();
+    }
+    if (!root) {
+        return KnobNativeExpressionPtr();
+    }
+
+    KnobNativeExpressionPtr ret( new KnobNativeExpression() );
+    ret->_imp->root = root;
+
+    return ret;
+}
+
+bool
+KnobNativeExpression::evaluate(TimeValue frame,
+                               double* result,
+                               bool* resultIsInt) const
+{
+    NativeValue value;
+
+    if ( !_imp->root->evaluate(frame, &value) ) {
+        return false;
+    }
+    *result = value.value;
+    *resultIsInt = value.isInt;
+
+    return true;
+}
+
+NATRON_NAMESPACE_EXIT;
@@ -0,0 +1,90 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2017 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_KNOBNATIVEEXPRESSION_H
+#define NATRON_ENGINE_KNOBNATIVEEXPRESSION_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <string>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/scoped_ptr.hpp>
+#endif
+
+#include "Engine/DimensionIdx.h"
+#include "Engine/TimeValue.h"
+
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER;
+
+/**
+ * @brief A single-line knob expression compiled to a native expression tree, so that it can be evaluated
+ * without the Python interpreter (and without the GIL).
+ * Only a small arithmetic subset of Python is supported:
+ * - int and float literals, frame, dimension, pi and e
+ * - the operators + - * / // % ** and parenthesis
+ * - the math functions (sin, cos, sqrt, pow, ...) as well as abs, min, max, int and float
+ * - the value of int, double and boolean parameters of the node, its siblings or its group, through
+ *   get(), get(frame), getValue(dimension) and getValueAtTime(frame, dimension)
+ * Values keep track of whether they are int or float to follow the Python semantics (e.g: integer division).
+ * Anything else is left to Python.
+ **/
+struct KnobNativeExpressionPrivate;
+class KnobNativeExpression
+{
+    KnobNativeExpression();
+
+public:
+
+    /**
+     * @brief Compiles the given expression of the knob thisKnob, belonging to the node thisNode.
+     * thisKnob and thisNode may be NULL, in which case the expression may not reference any parameter.
+     * Returns NULL if the expression does not fit in the supported grammar, in which case
+     * it must be evaluated by Python.
+     **/
+    static KnobNativeExpressionPtr compile(const std::string& expression,
+                                           const KnobIPtr& thisKnob,
+                                           const NodePtr& thisNode,
+                                           DimIdx dimension);
+
+    ~KnobNativeExpression();
+
+    /**
+     * @brief Evaluates the expression at the given frame. This is thread-safe.
+     * Returns false if the evaluation failed, e.g: on a division by zero or if a referenced parameter no longer exists.
+     * In this case the caller should evaluate the expression with Python so that the error gets reported.
+     * @param resultIsInt Set to true if the result would be an int in Python
+     **/
+    bool evaluate(TimeValue frame, double* result, bool* resultIsInt) const;
+
+private:
+
+    boost::scoped_ptr<KnobNativeExpressionPrivate> _imp;
+};
+
+NATRON_NAMESPACE_EXIT;
+
+#endif // NATRON_ENGINE_KNOBNATIVEEXPRESSION_H
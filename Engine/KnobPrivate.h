@@ -530,6 +530,22 @@ public:
         CacheEntryBase::fromMemorySegment(segment, objectNamesPrefix, tileDataPtr);
     }
 
+    virtual bool isProcessLocalCacheable() const OVERRIDE FINAL
+    {
+        return true;
+    }
+
+    virtual bool copyFromProcessLocalEntry(const CacheEntryBase& other) OVERRIDE FINAL
+    {
+        const KnobExpressionResult* otherResult = dynamic_cast<const KnobExpressionResult*>(&other);
+        if (!otherResult) {
+            return false;
+        }
+        _stringResult = otherResult->_stringResult;
+        _valueResult = otherResult->_valueResult;
+        return true;
+    }
+
 private:
     
     std::string _stringResult;
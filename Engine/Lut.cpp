@@ -140,6 +140,7 @@ LutManager::getLut(const std::string & name,
                    fromColorSpaceFunctionV1 fromFunc,
                    toColorSpaceFunctionV1 toFunc)
 {
+    QMutexLocker k(&LutManager::m_instance.lutsMutex);
     LutsMap::iterator found = LutManager::m_instance.luts.find(name);
 
     if ( found != LutManager::m_instance.luts.end() ) {
@@ -227,7 +228,7 @@ getOffsetsForPacking(PixelPackingEnum format,
 float
 Lut::fromColorSpaceUint8ToLinearFloatFast(unsigned char v) const
 {
-    assert(init_);
+    assert( isValid() );
 
     return fromFunc_uint8_to_float[v];
 }
@@ -238,7 +239,7 @@ Lut::fromColorSpaceUint8ToLinearFloatFast(unsigned char v) const
 float
 Lut::toColorSpaceFloatFromLinearFloatFast(float v) const
 {
-    assert(init_);
+    assert( isValid() );
 
     return Color::intToFloat<0xff01>(toFunc_hipart_to_uint8xx[hipart(v)]);
 }
@@ -248,7 +249,7 @@ Lut::toColorSpaceFloatFromLinearFloatFast(float v) const
 unsigned char
 Lut::toColorSpaceUint8FromLinearFloatFast(float v) const
 {
-    assert(init_);
+    assert( isValid() );
 
     return Color::uint8xxToChar(toFunc_hipart_to_uint8xx[hipart(v)]);
 }
@@ -256,7 +257,7 @@ Lut::toColorSpaceUint8FromLinearFloatFast(float v) const
 unsigned short
 Lut::toColorSpaceUint8xxFromLinearFloatFast(float v) const
 {
-    assert(init_);
+    assert( isValid() );
 
     return toFunc_hipart_to_uint8xx[hipart(v)];
 }
@@ -265,7 +266,7 @@ Lut::toColorSpaceUint8xxFromLinearFloatFast(float v) const
 unsigned short
 Lut::toColorSpaceUint16FromLinearFloatFast(float v) const
 {
-    assert(init_);
+    assert( isValid() );
     // algorithm:
     // - convert to 8 bits -> val8u
     // - convert val8u-1, val8u and val8u+1 to float
@@ -306,7 +307,7 @@ Lut::toColorSpaceUint16FromLinearFloatFast(float v) const
 float
 Lut::fromColorSpaceUint16ToLinearFloatFast(unsigned short v) const
 {
-    assert(init_);
+    assert( isValid() );
     // the following is from ImageMagick's quantum.h
     unsigned char v8u_prev = ( v - (v >> 8) ) >> 8;
     unsigned char v8u_next = v8u_prev + 1;
@@ -322,9 +323,6 @@ Lut::fromColorSpaceUint16ToLinearFloatFast(unsigned short v) const
 void
 Lut::fillTables() const
 {
-    if (init_) {
-        return;
-    }
     // fill all
     for (int i = 0; i < 0x10000; ++i) {
         float inp = index_to_float( (unsigned short)i );
@@ -344,7 +342,6 @@ Lut::fillTables() const
     }
 }
 
-#ifdef DEAD_CODE
 void
 Lut::to_byte_planar(unsigned char* to,
                     const float* from,
@@ -354,64 +351,55 @@ Lut::to_byte_planar(unsigned char* to,
                     int outDelta) const
 {
     validate();
-    unsigned char *end = to + W * outDelta;
+    if (W <= 0) {
+        return;
+    }
     // coverity[dont_call]
     int start = rand() % W;
-    const float *q;
-    unsigned char *p;
     unsigned error;
-    if (!alpha) {
-        /* go fowards from starting point to end of line: */
-        error = 0x80;
-        for (p = to + start * outDelta, q = from + start * inDelta; p < end; p += outDelta, q += inDelta) {
-            error = (error & 0xff) + toFunc_hipart_to_uint8xx[hipart(*q)];
-            *p = (unsigned char)(error >> 8);
-        }
-        /* go backwards from starting point to start of line: */
-        error = 0x80;
-        for (p = to + (start - 1) * outDelta, q = from + start * inDelta; p >= to; p -= outDelta) {
-            q -= inDelta;
-            error = (error & 0xff) + toFunc_hipart_to_uint8xx[hipart(*q)];
-            *p = (unsigned char)(error >> 8);
-        }
-    } else {
-        const float *a = alpha;
-        /* go fowards from starting point to end of line: */
-        error = 0x80;
-        for (p = to + start * outDelta, q = from + start * inDelta, a += start * inDelta; p < end; p += outDelta, q += inDelta, a += inDelta) {
-            const float v = *q * *a;
-            error = (error & 0xff) + toFunc_hipart_to_uint8xx[hipart(v)];
-            ++a;
-            *p = (unsigned char)(error >> 8);
+
+    /* go fowards from starting point to end of line: */
+    error = 0x80;
+    for (int x = start; x < W; ++x) {
+        float v = from[x * inDelta];
+        if (alpha) {
+            v *= alpha[x * inDelta];
         }
-        /* go backwards from starting point to start of line: */
-        error = 0x80;
-        for (p = to + (start - 1) * outDelta, q = from + start * inDelta, a = alpha + start * inDelta; p >= to; p -= outDelta) {
-            const float v = *q * *a;
-            q -= inDelta;
-            q -= inDelta;
-            error = (error & 0xff) + toFunc_hipart_to_uint8xx[hipart(v)];
-            *p = (unsigned char)(error >> 8);
+        error = (error & 0xff) + toFunc_hipart_to_uint8xx[hipart(v)];
+        to[x * outDelta] = (unsigned char)(error >> 8);
+    }
+    /* go backwards from starting point to start of line: */
+    error = 0x80;
+    for (int x = start - 1; x >= 0; --x) {
+        float v = from[x * inDelta];
+        if (alpha) {
+            v *= alpha[x * inDelta];
         }
+        error = (error & 0xff) + toFunc_hipart_to_uint8xx[hipart(v)];
+        to[x * outDelta] = (unsigned char)(error >> 8);
     }
 }
 
-#endif // DEAD_CODE
-
-#ifdef DEAD_CODE
 void
-Lut::to_short_planar(unsigned short* /*to*/,
-                     const float* /*from*/,
-                     int /*W*/,
-                     const float* /*alpha*/,
-                     int /*inDelta*/,
-                     int /*outDelta*/) const
+Lut::to_short_planar(unsigned short* to,
+                     const float* from,
+                     int W,
+                     const float* alpha,
+                     int inDelta,
+                     int outDelta) const
 {
-    throw std::runtime_error("Lut::to_short_planar not implemented yet.");
+    validate();
+    if (!alpha) {
+        for (int x = 0; x < W; ++x) {
+            to[x * outDelta] = toColorSpaceUint16FromLinearFloatFast(from[x * inDelta]);
+        }
+    } else {
+        for (int x = 0; x < W; ++x) {
+            to[x * outDelta] = toColorSpaceUint16FromLinearFloatFast(from[x * inDelta] * alpha[x * inDelta]);
+        }
+    }
 }
 
-#endif // DEAD_CODE
-
 void
 Lut::to_float_planar(float* to,
                      const float* from,
@@ -422,12 +410,12 @@ Lut::to_float_planar(float* to,
 {
     validate();
     if (!alpha) {
-        for (int f = 0, t = 0; f < W; f += inDelta, t += outDelta) {
-            to[t] = toColorSpaceFloatFromLinearFloat(from[f]);
+        for (int x = 0; x < W; ++x) {
+            to[x * outDelta] = toColorSpaceFloatFromLinearFloat(from[x * inDelta]);
         }
     } else {
-        for (int f = 0, t = 0; f < W; f += inDelta, t += outDelta) {
-            to[t] = toColorSpaceFloatFromLinearFloat(from[f] * alpha[f]);
+        for (int x = 0; x < W; ++x) {
+            to[x * outDelta] = toColorSpaceFloatFromLinearFloat(from[x * inDelta] * alpha[x * inDelta]);
         }
     }
 }
@@ -599,25 +587,48 @@ Lut::from_byte_planar(float* to,
 {
     validate();
     if (!alpha) {
-        for (int f = 0, t = 0; f < W; f += inDelta, t += outDelta) {
-            to[f] = fromFunc_uint8_to_float[(int)from[f]];
+        for (int x = 0; x < W; ++x) {
+            to[x * outDelta] = fromFunc_uint8_to_float[from[x * inDelta]];
         }
     } else {
-        for (int f = 0, t = 0; f < W; f += inDelta, t += outDelta) {
-            to[t] = alpha[f] <= 0 ? 0 : Color::intToFloat<256>(fromFunc_uint8_to_float[(from[f] * 255 + 128) / alpha[f]] * alpha[f]);
+        for (int x = 0; x < W; ++x) {
+            const unsigned char a = alpha[x * inDelta];
+            if (a == 0) {
+                to[x * outDelta] = 0.f;
+            } else {
+                // unpremultiply in 8 bits, clamping values that were not properly premultiplied
+                const int unpremult = std::min( ( from[x * inDelta] * 255 + a / 2 ) / a, 255 );
+                to[x * outDelta] = fromFunc_uint8_to_float[unpremult] * Color::intToFloat<256>(a);
+            }
         }
     }
 }
 
 void
-Lut::from_short_planar(float* /*to*/,
-                       const unsigned short* /*from*/,
-                       int /*W*/,
-                       const unsigned short*/* alpha*/,
-                       int /*inDelta*/,
-                       int /* outDelta*/) const
+Lut::from_short_planar(float* to,
+                       const unsigned short* from,
+                       int W,
+                       const unsigned short* alpha,
+                       int inDelta,
+                       int outDelta) const
 {
-    throw std::runtime_error("Lut::from_short_planar not implemented yet.");
+    validate();
+    if (!alpha) {
+        for (int x = 0; x < W; ++x) {
+            to[x * outDelta] = fromColorSpaceUint16ToLinearFloatFast(from[x * inDelta]);
+        }
+    } else {
+        for (int x = 0; x < W; ++x) {
+            const unsigned short a = alpha[x * inDelta];
+            if (a == 0) {
+                to[x * outDelta] = 0.f;
+            } else {
+                const float af = Color::intToFloat<65536>(a);
+                const float v = std::min(Color::intToFloat<65536>(from[x * inDelta]) / af, 1.f);
+                to[x * outDelta] = fromColorSpaceUint16ToLinearFloatFast( Color::floatToInt<65536>(v) ) * af;
+            }
+        }
+    }
 }
 
 void
@@ -630,13 +641,13 @@ Lut::from_float_planar(float* to,
 {
     validate();
     if (!alpha) {
-        for (int f = 0, t = 0; f < W; f += inDelta, t += outDelta) {
-            to[t] = fromColorSpaceFloatToLinearFloat(from[f]);
+        for (int x = 0; x < W; ++x) {
+            to[x * outDelta] = fromColorSpaceFloatToLinearFloat(from[x * inDelta]);
         }
     } else {
-        for (int f = 0, t = 0; f < W; f += inDelta, t += outDelta) {
-            float a = alpha[f];
-            to[t] = a <= 0. ? 0. : fromColorSpaceFloatToLinearFloat(from[f] / a) * a;
+        for (int x = 0; x < W; ++x) {
+            float a = alpha[x * inDelta];
+            to[x * outDelta] = a <= 0. ? 0. : fromColorSpaceFloatToLinearFloat(from[x * inDelta] / a) * a;
         }
     }
 }
@@ -1289,7 +1300,9 @@ to_float_packed(float* to,
 const Lut*
 LutManager::sRGBLut()
 {
-    return LutManager::m_instance.getLut("sRGB", from_func_srgb, to_func_srgb);
+    static const Lut* lut = LutManager::m_instance.getLut("sRGB", from_func_srgb, to_func_srgb);
+
+    return lut;
 }
 
 // Rec.709 and Rec.2020 share the same transfer function (and illuminant), except that
@@ -1329,7 +1342,9 @@ to_func_Rec709(float v)
 const Lut*
 LutManager::Rec709Lut()
 {
-    return LutManager::m_instance.getLut("Rec709", from_func_Rec709, to_func_Rec709);
+    static const Lut* lut = LutManager::m_instance.getLut("Rec709", from_func_Rec709, to_func_Rec709);
+
+    return lut;
 }
 
 /*
@@ -1369,7 +1384,9 @@ to_func_Cineon(float v)
 const Lut*
 LutManager::CineonLut()
 {
-    return LutManager::m_instance.getLut("Cineon", from_func_Cineon, to_func_Cineon);
+    static const Lut* lut = LutManager::m_instance.getLut("Cineon", from_func_Cineon, to_func_Cineon);
+
+    return lut;
 }
 
 /// from Gamma 1.8 to Linear Electro-Optical Transfer Function (EOTF)
@@ -1391,7 +1408,9 @@ to_func_Gamma1_8(float v)
 const Lut*
 LutManager::Gamma1_8Lut()
 {
-    return LutManager::m_instance.getLut("Gamma1_8", from_func_Gamma1_8, to_func_Gamma1_8);
+    static const Lut* lut = LutManager::m_instance.getLut("Gamma1_8", from_func_Gamma1_8, to_func_Gamma1_8);
+
+    return lut;
 }
 
 /// from Gamma 2.2 to Linear Electro-Optical Transfer Function (EOTF)
@@ -1413,7 +1432,9 @@ to_func_Gamma2_2(float v)
 const Lut*
 LutManager::Gamma2_2Lut()
 {
-    return LutManager::m_instance.getLut("Gamma2_2", from_func_Gamma2_2, to_func_Gamma2_2);
+    static const Lut* lut = LutManager::m_instance.getLut("Gamma2_2", from_func_Gamma2_2, to_func_Gamma2_2);
+
+    return lut;
 }
 
 /// from Panalog to Linear Electro-Optical Transfer Function (EOTF)
@@ -1435,7 +1456,9 @@ to_func_Panalog(float v)
 const Lut*
 LutManager::PanalogLut()
 {
-    return LutManager::m_instance.getLut("Panalog", from_func_Panalog, to_func_Panalog);
+    static const Lut* lut = LutManager::m_instance.getLut("Panalog", from_func_Panalog, to_func_Panalog);
+
+    return lut;
 }
 
 /// from REDLog to Linear Electro-Optical Transfer Function (EOTF)
@@ -1457,7 +1480,9 @@ to_func_REDLog(float v)
 const Lut*
 LutManager::REDLogLut()
 {
-    return LutManager::m_instance.getLut("REDLog", from_func_REDLog, to_func_REDLog);
+    static const Lut* lut = LutManager::m_instance.getLut("REDLog", from_func_REDLog, to_func_REDLog);
+
+    return lut;
 }
 
 /// from ViperLog to Linear Electro-Optical Transfer Function (EOTF)
@@ -1479,7 +1504,9 @@ to_func_ViperLog(float v)
 const Lut*
 LutManager::ViperLogLut()
 {
-    return LutManager::m_instance.getLut("ViperLog", from_func_ViperLog, to_func_ViperLog);
+    static const Lut* lut = LutManager::m_instance.getLut("ViperLog", from_func_ViperLog, to_func_ViperLog);
+
+    return lut;
 }
 
 /// from AlexaV3LogC to Linear Electro-Optical Transfer Function (EOTF)
@@ -1503,7 +1530,9 @@ to_func_AlexaV3LogC(float v)
 const Lut*
 LutManager::AlexaV3LogCLut()
 {
-    return LutManager::m_instance.getLut("AlexaV3LogC", from_func_AlexaV3LogC, to_func_AlexaV3LogC);
+    static const Lut* lut = LutManager::m_instance.getLut("AlexaV3LogC", from_func_AlexaV3LogC, to_func_AlexaV3LogC);
+
+    return lut;
 }
 
 /// from SLog1 to Linear Electro-Optical Transfer Function (EOTF)
@@ -1529,7 +1558,9 @@ to_func_SLog1(float v)
 const Lut*
 LutManager::SLog1Lut()
 {
-    return LutManager::m_instance.getLut("SLog1", from_func_SLog1, to_func_SLog1);
+    static const Lut* lut = LutManager::m_instance.getLut("SLog1", from_func_SLog1, to_func_SLog1);
+
+    return lut;
 }
 
 /// from SLog2 to Linear Electro-Optical Transfer Function (EOTF)
@@ -1557,7 +1588,9 @@ to_func_SLog2(float v)
 const Lut*
 LutManager::SLog2Lut()
 {
-    return LutManager::m_instance.getLut("SLog2", from_func_SLog2, to_func_SLog2);
+    static const Lut* lut = LutManager::m_instance.getLut("SLog2", from_func_SLog2, to_func_SLog2);
+
+    return lut;
 }
 
 
@@ -37,6 +37,7 @@
 
 CLANG_DIAG_OFF(deprecated)
 #include <QtCore/QMutex>
+#include <QtCore/QAtomicInt>
 CLANG_DIAG_ON(deprecated)
 
 #include "Engine/EngineFwd.h"
@@ -68,8 +69,7 @@ typedef float (*toColorSpaceFunctionV1)(float v);
 
 // a Singleton that holds precomputed LUTs for the whole application.
 // The m_instance member is static and is thus built before the first call to Instance().
-// WARNING : This class is not thread-safe and calling getLut must not be done in a function called
-// by multiple thread at once!
+// getLut is thread-safe. The built-in accessors only take the lock the first time they are called.
 class Lut;
 class LutManager
 {
@@ -82,7 +82,7 @@ public:
     /**
      * @brief Returns a pointer to a lut with the given name and the given from and to functions.
      * If a lut with the same name didn't already exist, then it will create one.
-     * WARNING : NOT THREAD-SAFE
+     * This is thread-safe.
      **/
     static const Lut * getLut(const std::string & name, fromColorSpaceFunctionV1 fromFunc, toColorSpaceFunctionV1 toFunc);
 
@@ -121,6 +121,9 @@ private:
     //each lut with a ref count mapped against their name
     typedef std::map<std::string, const Lut * > LutsMap;
     LutsMap luts;
+
+    // protects luts
+    QMutex lutsMutex;
 };
 
 
@@ -138,8 +141,8 @@ class Lut
     /// and never change afterwards
     mutable unsigned short toFunc_hipart_to_uint8xx[0x10000];         /// contains  2^16 = 65536 values between 0-255
     mutable float fromFunc_uint8_to_float[256];         /// values between 0-1.f
-    mutable bool init_;         ///< false if the tables are not yet initialized
-    mutable QMutex _lock;         ///< protects init_
+    mutable QAtomicInt init_;         ///< 0 if the tables are not yet initialized, set with release semantics once they are filled
+    mutable QMutex _lock;         ///< serializes fillTables()
 
     friend class LutManager;
     ///private constructor, used by LutManager
@@ -149,7 +152,7 @@ class Lut
         : _name(name)
         , _fromFunc(fromFunc)
         , _toFunc(toFunc)
-        , init_(false)
+        , init_(0)
         , _lock()
     {
     }
@@ -179,16 +182,36 @@ public:
         return _toFunc(v);
     }
 
-    //Called by all public members
+    /**
+     * @brief Returns true if the tables were filled. The load has acquire semantics so that
+     * the tables can be read without lock if it returns true.
+     **/
+    bool isValid() const
+    {
+#if QT_VERSION < 0x050000
+        return init_.fetchAndAddAcquire(0) != 0;
+#else
+        return init_.loadAcquire() != 0;
+#endif
+    }
+
+    /**
+     * @brief Fills the tables if needed. Must be called before using the Fast functions, the
+     * batched functions below call it.
+     * Once the tables are filled this does not take any lock.
+     **/
     void validate() const
     {
-        QMutexLocker g(&_lock);
+        if ( isValid() ) {
+            return;
+        }
 
-        if (init_) {
+        QMutexLocker g(&_lock);
+        if ( isValid() ) {
             return;
         }
         fillTables();
-        init_ = true;
+        init_.fetchAndStoreRelease(1);
     }
 
     const std::string & getName() const
@@ -247,10 +270,10 @@ public:
      * \a alpha is a pointer to an extra alpha planar buffer if you want to premultiply by alpha the from channel.
      * The input and output buffers must not overlap in memory.
      **/
-    //void to_byte_planar(unsigned char* to, const float* from,int W,const float* alpha = NULL,
-    //                    int inDelta = 1, int outDelta = 1) const;
-    //void to_short_planar(unsigned short* to, const float* from,int W,const float* alpha = NULL,
-    //                     int inDelta = 1, int outDelta = 1) const;
+    void to_byte_planar(unsigned char* to, const float* from, int W, const float* alpha = NULL,
+                        int inDelta = 1, int outDelta = 1) const;
+    void to_short_planar(unsigned short* to, const float* from, int W, const float* alpha = NULL,
+                         int inDelta = 1, int outDelta = 1) const;
     void to_float_planar(float* to, const float* from, int W, const float* alpha = NULL,
                          int inDelta = 1, int outDelta = 1) const;
 
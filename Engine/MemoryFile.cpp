@@ -37,6 +37,9 @@
 #include <cerrno>
 #include <cstdio>
 #endif
+#include <algorithm> // std::min, std::max
+#include <cstring> // memcpy
+#include <fstream>
 #include <sstream> // stringstream
 #include <iostream>
 #include <cassert>
@@ -57,6 +60,11 @@ struct MemoryFilePrivate
 
     char* data; //< pointer to the begining of the mapped file
     size_t size; //< the effective size of the file
+    size_t mappedSize; //< for anonymous mappings, the size actually mapped, which may be larger than size
+    bool anonymous; //< true if there is no backing file, see openAnonymous()
+    bool useHugePages; //< for anonymous mappings, whether to try to use huge pages
+    bool isHugeTLBMapping; //< true if data was mapped with MAP_HUGETLB
+    bool readOnly; //< true if the file was opened with eFileOpenModeOpenReadOnly
 #if defined(__NATRON_UNIX__)
     int file_handle; //< unix file handle
 #elif defined(__NATRON_WIN32__)
@@ -70,6 +78,11 @@ struct MemoryFilePrivate
         : path(filepath)
         , data(0)
         , size(0)
+        , mappedSize(0)
+        , anonymous(false)
+        , useHugePages(false)
+        , isHugeTLBMapping(false)
+        , readOnly(false)
 #if defined(__NATRON_UNIX__)
         , file_handle(-1)
 #elif defined(__NATRON_WIN32__)
@@ -81,6 +94,8 @@ struct MemoryFilePrivate
 
     void openInternal(MemoryFile::FileOpenModeEnum open_mode);
 
+    void resizeAnonymous(size_t new_size);
+
     void closeMapping();
 };
 
@@ -97,9 +112,31 @@ MemoryFile::open(const std::string & filepath,
         return;
     }
     _imp->path = filepath;
+    _imp->anonymous = false;
     _imp->openInternal(open_mode);
 }
 
+void
+MemoryFile::openAnonymous(bool useHugePages)
+{
+    if (_imp->data) {
+        return;
+    }
+    _imp->path.clear();
+    _imp->anonymous = true;
+    _imp->readOnly = false;
+    _imp->useHugePages = useHugePages;
+    _imp->isHugeTLBMapping = false;
+    _imp->size = 0;
+    _imp->mappedSize = 0;
+}
+
+bool
+MemoryFile::isAnonymous() const
+{
+    return _imp->anonymous;
+}
+
 void
 MemoryFilePrivate::openInternal(MemoryFile::FileOpenModeEnum open_mode)
 {
@@ -110,6 +147,7 @@ MemoryFilePrivate::openInternal(MemoryFile::FileOpenModeEnum open_mode)
        CHOOSING FILE OPEN MODE
      ********************************************************
      *********************************************************/
+    readOnly = open_mode == MemoryFile::eFileOpenModeOpenReadOnly;
     int posix_open_mode = O_RDWR;
     switch (open_mode) {
     case MemoryFile::eFileOpenModeCreate:
@@ -126,6 +164,9 @@ MemoryFilePrivate::openInternal(MemoryFile::FileOpenModeEnum open_mode)
     case MemoryFile::eFileOpenModeOpenTruncateOrCreate:
         posix_open_mode |= O_TRUNC | O_CREAT;
         break;
+    case MemoryFile::eFileOpenModeOpenReadOnly:
+        posix_open_mode = O_RDONLY;
+        break;
     default:
 
         return;
@@ -168,7 +209,7 @@ MemoryFilePrivate::openInternal(MemoryFile::FileOpenModeEnum open_mode)
      *********************************************************/
     if (sbuf.st_size > 0) {
         data = static_cast<char*>( ::mmap(
-                                       0, sbuf.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, file_handle, 0) );
+                                       0, sbuf.st_size, readOnly ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, file_handle, 0) );
         if (data == MAP_FAILED) {
             data = 0;
             std::stringstream ss;
@@ -176,6 +217,10 @@ MemoryFilePrivate::openInternal(MemoryFile::FileOpenModeEnum open_mode)
             throw std::runtime_error( ss.str() );
         } else {
             size = sbuf.st_size;
+            if (readOnly) {
+                // This is only a hint: ignore failures
+                ::madvise(data, size, MADV_SEQUENTIAL);
+            }
         }
     }
 #elif defined(__NATRON_WIN32__)
@@ -186,6 +231,7 @@ MemoryFilePrivate::openInternal(MemoryFile::FileOpenModeEnum open_mode)
        CHOOSING FILE OPEN MODE
      ********************************************************
      *********************************************************/
+    readOnly = open_mode == MemoryFile::eFileOpenModeOpenReadOnly;
     int windows_open_mode;
     switch (open_mode) {
     case MemoryFile::eFileOpenModeCreate:
@@ -203,6 +249,9 @@ MemoryFilePrivate::openInternal(MemoryFile::FileOpenModeEnum open_mode)
     case MemoryFile::eFileOpenModeOpenTruncateOrCreate:
         windows_open_mode = CREATE_ALWAYS;
         break;
+    case MemoryFile::eFileOpenModeOpenReadOnly:
+        windows_open_mode = OPEN_EXISTING;
+        break;
     default:
         std::string str("MemoryFile EXC : Invalid open mode. ");
         str.append(path);
@@ -219,8 +268,9 @@ MemoryFilePrivate::openInternal(MemoryFile::FileOpenModeEnum open_mode)
      ********************************************************
      *********************************************************/
     std::wstring wpath = StrUtils::utf8_to_utf16(path);
-    file_handle = ::CreateFileW(wpath.c_str(), GENERIC_READ | GENERIC_WRITE,
-                                0, 0, windows_open_mode, FILE_ATTRIBUTE_NORMAL, 0);
+    file_handle = ::CreateFileW(wpath.c_str(), readOnly ? GENERIC_READ : GENERIC_READ | GENERIC_WRITE,
+                                readOnly ? FILE_SHARE_READ : 0, 0, windows_open_mode,
+                                readOnly ? FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN : FILE_ATTRIBUTE_NORMAL, 0);
 
 
     if (file_handle == INVALID_HANDLE_VALUE) {
@@ -246,8 +296,8 @@ MemoryFilePrivate::openInternal(MemoryFile::FileOpenModeEnum open_mode)
      ********************************************************
      *********************************************************/
     if (fileSize > 0) {
-        file_mapping_handle = ::CreateFileMapping(file_handle, 0, PAGE_READWRITE, 0, 0, 0);
-        data = static_cast<char*>( ::MapViewOfFile(file_mapping_handle, FILE_MAP_WRITE, 0, 0, 0) );
+        file_mapping_handle = ::CreateFileMapping(file_handle, 0, readOnly ? PAGE_READONLY : PAGE_READWRITE, 0, 0, 0);
+        data = static_cast<char*>( ::MapViewOfFile(file_mapping_handle, readOnly ? FILE_MAP_READ : FILE_MAP_WRITE, 0, 0, 0) );
         if (data) {
             size = fileSize;
         } else {
@@ -279,7 +329,7 @@ MemoryFile::path() const
 void
 MemoryFile::remap()
 {
-    if (!_imp->data) {
+    if (!_imp->data || _imp->anonymous) {
         return;
     }
     // Sync the content to the file
@@ -289,12 +339,176 @@ MemoryFile::remap()
     _imp->closeMapping();
 
     // re-open it
-    _imp->openInternal(eFileOpenModeOpen);
+    _imp->openInternal(_imp->readOnly ? eFileOpenModeOpenReadOnly : eFileOpenModeOpen);
 }
 
+#if defined(__NATRON_LINUX__)
+/**
+ * @brief Returns the size of the huge pages that MAP_HUGETLB uses, or 0 if unknown.
+ **/
+static size_t
+getDefaultHugePageSize()
+{
+    static size_t hugePageSize = 0;
+    static bool hugePageSizeRead = false;
+    if (!hugePageSizeRead) {
+        std::ifstream meminfo("/proc/meminfo");
+        std::string line;
+        while ( std::getline(meminfo, line) ) {
+            // e.g: "Hugepagesize:       2048 kB"
+            if (line.compare(0, 13, "Hugepagesize:") == 0) {
+                std::stringstream ss( line.substr(13) );
+                size_t sizeKb = 0;
+                ss >> sizeKb;
+                hugePageSize = sizeKb * 1024;
+                break;
+            }
+        }
+        hugePageSizeRead = true;
+    }
+    return hugePageSize;
+}
+#endif
+
+#if defined(__NATRON_UNIX__)
+/**
+ * @brief Maps size bytes of anonymous memory private to the process. Returns NULL on failure.
+ **/
+static char*
+mapAnonymousMemory(size_t size,
+                   bool useHugePages,
+                   bool* isHugeTLBMapping)
+{
+    *isHugeTLBMapping = false;
+#if defined(__NATRON_LINUX__) && defined(MAP_HUGETLB)
+    // Explicit huge pages only work if the administrator reserved some (vm.nr_hugepages):
+    // otherwise the mapping fails and we fallback on regular pages.
+    if (useHugePages) {
+        size_t hugePageSize = getDefaultHugePageSize();
+        if ( (hugePageSize > 0) && (size % hugePageSize == 0) ) {
+            void* ret = ::mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (ret != MAP_FAILED) {
+                *isHugeTLBMapping = true;
+                return static_cast<char*>(ret);
+            }
+        }
+    }
+#endif
+    void* ret = ::mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ret == MAP_FAILED) {
+        return 0;
+    }
+#if defined(MADV_HUGEPAGE)
+    // Ask for transparent huge pages. This fails harmlessly if they are disabled.
+    if (useHugePages) {
+        ::madvise(ret, size, MADV_HUGEPAGE);
+    }
+#else
+    Q_UNUSED(useHugePages);
+#endif
+    return static_cast<char*>(ret);
+}
+#endif // __NATRON_UNIX__
+
+void
+MemoryFilePrivate::resizeAnonymous(size_t new_size)
+{
+    if (new_size == size) {
+        return;
+    }
+    if (new_size == 0) {
+        if (data) {
+            closeMapping();
+        }
+        size = 0;
+        return;
+    }
+#if defined(__NATRON_UNIX__)
+#if defined(__NATRON_LINUX__) && defined(MREMAP_MAYMOVE)
+    // The kernel moves the pages without copying them.
+    // Huge TLB mappings are copied below since their size must remain a multiple of the huge page size.
+    if (data && !isHugeTLBMapping) {
+        void* newData = ::mremap(data, mappedSize, new_size, MREMAP_MAYMOVE);
+        if (newData == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        data = static_cast<char*>(newData);
+#if defined(MADV_HUGEPAGE)
+        if (useHugePages && (new_size > size) ) {
+            ::madvise(data, new_size, MADV_HUGEPAGE);
+        }
+#endif
+        size = new_size;
+        mappedSize = new_size;
+        return;
+    }
+#endif
+#endif // __NATRON_UNIX__
+
+    // The mapping cannot grow in place: the content has to be copied to a new mapping.
+    // To avoid copying the whole file each time it grows, the mapping is at least doubled
+    // and the next resizes that fit in it do not remap anything.
+    if (data && (new_size <= mappedSize) ) {
+        size = new_size;
+        return;
+    }
+    size_t newMappedSize = new_size;
+    if (data) {
+        newMappedSize = std::max(new_size, mappedSize * 2);
+    }
+#if defined(__NATRON_UNIX__)
+    bool newIsHugeTLBMapping;
+    char* newData = mapAnonymousMemory(newMappedSize, useHugePages, &newIsHugeTLBMapping);
+    if ( !newData && (newMappedSize > new_size) ) {
+        // Not enough memory for the reserve, try to map only what is needed
+        newMappedSize = new_size;
+        newData = mapAnonymousMemory(newMappedSize, useHugePages, &newIsHugeTLBMapping);
+    }
+    if (!newData) {
+        throw std::bad_alloc();
+    }
+    if (data) {
+        std::memcpy( newData, data, std::min(size, new_size) );
+        ::munmap(data, mappedSize);
+    }
+    data = newData;
+    isHugeTLBMapping = newIsHugeTLBMapping;
+#elif defined(__NATRON_WIN32__)
+    // Memory backed by the system paging file
+    ULARGE_INTEGER mappingSize;
+    mappingSize.QuadPart = newMappedSize;
+    HANDLE newMappingHandle = ::CreateFileMapping(INVALID_HANDLE_VALUE, 0, PAGE_READWRITE, mappingSize.HighPart, mappingSize.LowPart, 0);
+    if (!newMappingHandle) {
+        throw std::bad_alloc();
+    }
+    char* newData = static_cast<char*>( ::MapViewOfFile(newMappingHandle, FILE_MAP_WRITE, 0, 0, 0) );
+    if (!newData) {
+        ::CloseHandle(newMappingHandle);
+        throw std::bad_alloc();
+    }
+    if (data) {
+        std::memcpy( newData, data, std::min(size, new_size) );
+        ::UnmapViewOfFile(data);
+        ::CloseHandle(file_mapping_handle);
+    }
+    data = newData;
+    file_mapping_handle = newMappingHandle;
+#endif
+    size = new_size;
+    mappedSize = newMappedSize;
+} // resizeAnonymous
+
 void
 MemoryFile::resize(size_t new_size, bool preserve)
 {
+    if (_imp->anonymous) {
+        // The memory is not backed by a file: the content is always preserved by copying it if needed
+        _imp->resizeAnonymous(new_size);
+        return;
+    }
+    if (_imp->readOnly) {
+        throw std::runtime_error("MemoryFile EXC : Cannot resize \"" + _imp->path + "\": the file is opened read-only");
+    }
     // Before unmapping, flush to avoid expensive copy if the user does not want to preserve the data
     if (preserve) {
         flush(eFlushTypeSync, _imp->data, _imp->size);
@@ -341,19 +555,29 @@ MemoryFilePrivate::closeMapping()
 {
 #if defined(__NATRON_UNIX__)
 
-    ::munmap(data, size);
-    ::close(file_handle);
+    ::munmap(data, anonymous ? mappedSize : size);
+    if (file_handle != -1) {
+        ::close(file_handle);
+    }
     file_handle = -1;
 #elif defined(__NATRON_WIN32__)
     if (::UnmapViewOfFile(data) == 0) {
         throw std::runtime_error("Failed to unmap the mapped file");
     }
     ::CloseHandle(file_mapping_handle);
-    ::CloseHandle(file_handle);
+    if (file_handle != INVALID_HANDLE_VALUE) {
+        ::CloseHandle(file_handle);
+    }
     file_handle = INVALID_HANDLE_VALUE;
     file_mapping_handle = INVALID_HANDLE_VALUE;
 #endif
     data = 0;
+    if (anonymous) {
+        // The content is gone with the mapping
+        size = 0;
+        mappedSize = 0;
+        isHugeTLBMapping = false;
+    }
 
 } // closeMapping
 
@@ -365,6 +589,10 @@ MemoryFile::flush(FlushTypeEnum type, void* data, std::size_t size)
         return true;
     }
     std::size_t n = data ? size : _imp->size;
+    if ( _imp->anonymous && (type != eFlushTypeInvalidate) ) {
+        // Nothing to write
+        return true;
+    }
 #if defined(__NATRON_UNIX__)
     switch (type) {
         case eFlushTypeAsync:
@@ -441,6 +669,12 @@ MemoryFile::~MemoryFile()
 void
 MemoryFile::remove()
 {
+    if (_imp->anonymous) {
+        if (_imp->data) {
+            _imp->closeMapping();
+        }
+        return;
+    }
     if ( !_imp->path.empty() ) {
         if (_imp->data) {
             // Invalidate the whole memory portion
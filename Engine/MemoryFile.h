@@ -56,7 +56,12 @@ public:
 
         eFileOpenModeOpenTruncate,
 
-        eFileOpenModeOpenTruncateOrCreate
+        eFileOpenModeOpenTruncateOrCreate,
+
+        // Opens an existing file for reading only, e.g: on a read-only network share.
+        // The mapping is read sequentially: the system is told to read ahead.
+        // The file cannot be resized.
+        eFileOpenModeOpenReadOnly
     };
 
     /**
@@ -82,6 +87,24 @@ public:
      **/
     void open(const std::string & filepath, FileOpenModeEnum open_mode);
 
+    /**
+     * @brief Same as open(...) but maps anonymous memory instead of a file: the memory is private
+     * to this process and is lost when the mapping is closed. There is no backing file, hence no disk I/O:
+     * flushing is a no-op and path() returns an empty string.
+     * As with a file, the mapping is empty until resize(...) is called and resize(...) always keeps
+     * the content, regardless of its preserve parameter.
+     * If useHugePages is true, the memory is backed by huge pages when the system allows it: explicit huge pages
+     * (MAP_HUGETLB) if some are reserved and the size is a multiple of the huge page size, transparent huge pages otherwise.
+     *
+     * WARNING: Calling this function whilst the mapping is already opened has no effect
+     **/
+    void openAnonymous(bool useHugePages);
+
+    /**
+     * @brief Returns true if the mapping was opened with openAnonymous(...)
+     **/
+    bool isAnonymous() const;
+
     /**
      * @brief Returns a pointer to the beginning of the file,
      * if the file has been successfully opened, otherwise it returns 0.
@@ -139,6 +162,7 @@ public:
     /**
      * @brief Removes the backing file and closes the mapping to the virtual memory.
      * After that you could re-use the object calling the open(...) function again.
+     * For an anonymous mapping, this only releases the memory.
      **/
     void remove();
 
@@ -25,8 +25,8 @@
 
 #include "MultiThread.h"
 
-#include <map>
-#include <list>
+#include <algorithm>
+#include <vector>
 
 CLANG_DIAG_OFF(deprecated)
 CLANG_DIAG_OFF(uninitialized)
@@ -38,22 +38,22 @@ CLANG_DIAG_OFF(uninitialized)
 #include <QtCore/QDebug>
 #include <QtCore/QThread>
 #include <QtCore/QThreadStorage>
-#include <QtConcurrentMap> // QtCore on Qt4, QtConcurrent on Qt5
+#include <QtCore/QVector>
 CLANG_DIAG_ON(deprecated-register)
 CLANG_DIAG_ON(uninitialized)
 
 GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_OFF
-// /usr/local/include/boost/bind/arg.hpp:37:9: warning: unused typedef 'boost_static_assert_typedef_37' [-Wunused-local-typedef]
-#include <boost/bind.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 
 #include "Engine/AppManager.h"
 #include "Engine/EffectInstance.h"
+#include "Engine/ForkJoinPool.h"
 #include "Engine/Node.h"
 #include "Engine/Settings.h"
 #include "Engine/TLSHolder.h"
 #include "Engine/ThreadPool.h"
+#include "Engine/TreeRenderNodeArgs.h"
 
 // An effect may not use more than this amount of threads
 #define NATRON_MULTI_THREAD_SUITE_MAX_NUM_CPU 4
@@ -63,20 +63,65 @@ NATRON_NAMESPACE_ENTER;
 
 struct MultiThreadThreadData
 {
-    // Index of the thread. This is a list so that the launchThread functino
+    // Index of the thread. This is a stack so that the launchThread function
     // may be used recursively.
-    std::list<unsigned int> indices;
-};
+    std::vector<unsigned int> indices;
 
-typedef std::map<QThread*, MultiThreadThreadData> PerThreadMultiThreadDataMap;
+    MultiThreadThreadData()
+    : indices()
+    {
+        // Avoid growing the stack in the common cases
+        indices.reserve(8);
+    }
+};
 
 struct MultiThreadPrivate
 {
 
-    PerThreadMultiThreadDataMap threadsData;
+    // The index stack of each thread. The data is deleted when the thread exits.
+    QThreadStorage<MultiThreadThreadData*> threadsData;
+
+    // The threads running the tasks of launchThreads. The thread calling launchThreads runs tasks too,
+    // hence one thread less than the number of render threads, see MultiThread::setNumThreads.
+    boost::scoped_ptr<ForkJoinPool> pool;
 
     MultiThreadPrivate()
     : threadsData()
+    , pool( new ForkJoinPool( std::max(0, QThread::idealThreadCount() - 1) ) )
+    {
+
+    }
+
+    MultiThreadThreadData* getThreadData()
+    {
+        if ( !threadsData.hasLocalData() ) {
+            threadsData.setLocalData(new MultiThreadThreadData);
+        }
+        return threadsData.localData();
+    }
+};
+
+/**
+ * @brief The arguments of a call to launchThreads, given to each task of the ForkJoinPool.
+ **/
+struct MultiThreadLaunchArgs
+{
+    MultiThreadPrivate* imp;
+    MultiThread::ThreadFunctor* func;
+    QThread* spawnerThread;
+    void* customArg;
+    const TreeRenderNodeArgsPtr* renderArgs;
+
+    // The status of the first task that failed
+    QAtomicInt status;
+
+    MultiThreadLaunchArgs()
+    : imp(0)
+    , func(0)
+    , spawnerThread(0)
+    , customArg(0)
+    , renderArgs(0)
+    , status(eActionStatusOK)
     {
 
     }
@@ -84,8 +129,8 @@ struct MultiThreadPrivate
 
 NATRON_NAMESPACE_ANONYMOUS_ENTER
 
-// Using QtConcurrent doesn't work with The Foundry Furnace plug-ins because they expect fresh threads
-// to be created. As QtConcurrent's thread-pool recycles thread, it seems to make Furnace crash.
+// Using a thread pool doesn't work with The Foundry Furnace plug-ins because they expect fresh threads
+// to be created. As the pool recycles threads, it seems to make Furnace crash.
 // We think this is because Furnace must keep an internal thread-local state that becomes then dirty
 // if we re-use the same thread.
 
@@ -102,8 +147,8 @@ threadFunctionWrapper(MultiThreadPrivate* imp,
 
     QThread* spawnedThread = QThread::currentThread();
 
-    MultiThreadThreadData& spawnedThreadData = imp->threadsData[spawnedThread];
-    spawnedThreadData.indices.push_back(threadIndex);
+    MultiThreadThreadData* spawnedThreadData = imp->getThreadData();
+    spawnedThreadData->indices.push_back(threadIndex);
 
     // If we launched the functor in a new thread,
     // this thread doesn't have any TLS set.
@@ -125,7 +170,7 @@ threadFunctionWrapper(MultiThreadPrivate* imp,
     }
 
     // Reset back the index otherwise it could mess up the indices if the same thread is re-used
-    spawnedThreadData.indices.pop_back();
+    spawnedThreadData->indices.pop_back();
 
     // If we used TLS on this thread, clean it up.
     if (spawnedThread != spawnerThread) {
@@ -135,6 +180,19 @@ threadFunctionWrapper(MultiThreadPrivate* imp,
     return ret;
 } // threadFunctionWrapper
 
+static void
+forkJoinTaskFunction(unsigned int taskIndex,
+                     unsigned int nTasks,
+                     void* customArg)
+{
+    MultiThreadLaunchArgs* args = (MultiThreadLaunchArgs*)customArg;
+    ActionRetCodeEnum stat = threadFunctionWrapper(args->imp, args->func, taskIndex, nTasks, args->spawnerThread, args->customArg, *args->renderArgs);
+
+    if ( isFailureRetCode(stat) ) {
+        args->status.testAndSetOrdered(eActionStatusOK, stat);
+    }
+}
+
 class NonThreadPoolThread
 : public QThread
 , public AbortableThread
@@ -168,8 +226,8 @@ private:
     {
         assert(_threadIndex < _threadMax);
 
-        MultiThreadThreadData& spawnedThreadData = _imp->threadsData[this];
-        spawnedThreadData.indices.push_back(_threadIndex);
+        MultiThreadThreadData* spawnedThreadData = _imp->getThreadData();
+        spawnedThreadData->indices.push_back(_threadIndex);
 
 
         // This thread doesn't have any TLS set.
@@ -190,7 +248,7 @@ private:
         }
 
         // Reset back the index otherwise it could mess up the indexes if the same thread is re-used
-        spawnedThreadData.indices.pop_back();
+        spawnedThreadData->indices.pop_back();
 
         // If we used TLS on this thread, clean it up.
         appPTR->getAppTLS()->cleanupTLSForThread();
@@ -273,44 +331,20 @@ MultiThread::launchThreads(ThreadFunctor func, unsigned int nThreads, void *cust
 
     if (useThreadPool) {
 
-        std::vector<unsigned int> threadIndexes(nThreads);
-        for (unsigned int i = 0; i < nThreads; ++i) {
-            threadIndexes[i] = i;
-        }
-
-        // If the current thread is a thread-pool thread, make it also do an iteration instead
-        // of waiting for other threads
-        bool isThreadPoolThread = isRunningInThreadPoolThread();
-        if (isThreadPoolThread) {
-            threadIndexes.pop_back();
-        }
-
-        // DON'T set the maximum thread count: this is a global application setting, and see the documentation excerpt above
-        // QThreadPool::globalInstance()->setMaxThreadCount(nThreads);
-
-        QFuture<ActionRetCodeEnum> future = QtConcurrent::mapped( threadIndexes, boost::bind(threadFunctionWrapper, imp, func, _1, nThreads, spawnerThread, customArg, renderArgs) );
-
-        // Do one iteration in this thread
-        if (isThreadPoolThread) {
-            ActionRetCodeEnum stat = threadFunctionWrapper(imp, func, nThreads - 1, nThreads, spawnerThread, customArg, renderArgs);
-            if (isFailureRetCode(stat)) {
-                // This thread failed, wait for other threads and exit
-                future.waitForFinished();
-                return stat;
-            }
-        }
-
-        // Wait for other threads
-        future.waitForFinished();
+        // Everything is on the stack: OpenFX plug-ins may call this thousands of times per frame
+        MultiThreadLaunchArgs args;
+        args.imp = imp;
+        args.func = func;
+        args.spawnerThread = spawnerThread;
+        args.customArg = customArg;
+        args.renderArgs = &renderArgs;
 
-        // DON'T reset back to the original value the maximum thread count
-        // QThreadPool::globalInstance()->setMaxThreadCount(QThread::idealThreadCount());
+        // The calling thread runs tasks too instead of just waiting for the workers
+        imp->pool->run(forkJoinTaskFunction, nThreads, &args);
 
-        for (QFuture<ActionRetCodeEnum>::const_iterator it = future.begin(); it != future.end(); ++it) {
-            ActionRetCodeEnum stat = *it;
-            if (isFailureRetCode(stat)) {
-                return stat;
-            }
+        ActionRetCodeEnum stat = (ActionRetCodeEnum)args.status.fetchAndAddOrdered(0);
+        if ( isFailureRetCode(stat) ) {
+            return stat;
         }
 
     } else { // !useThreadPool
@@ -361,13 +395,26 @@ MultiThread::launchThreads(ThreadFunctor func, unsigned int nThreads, void *cust
 } // multiThread
 
 
+void
+MultiThread::setNumThreads(unsigned int nThreads)
+{
+    MultiThreadPrivate* imp = appPTR->getMultiThreadHandler()->_imp.get();
+    imp->pool->setNumWorkers( std::max(1u, nThreads) - 1 );
+}
+
 unsigned int
 MultiThread::getNCPUsAvailable()
 {
     // activeThreadCount may be negative (for example if releaseThread() is called)
     int activeThreadsCount = QThreadPool::globalInstance()->activeThreadCount();
 
-    // If we are running in the thread pool already, count this thread as available
+    // The workers of the ForkJoinPool running tasks of launchThreads use CPUs too
+    const MultiThread* handler = appPTR ? appPTR->getMultiThreadHandler() : 0;
+    if (handler) {
+        activeThreadsCount += (int)handler->_imp->pool->getNumActiveWorkers();
+    }
+
+    // If we are running in the thread pool or in a ForkJoinPool worker already, count this thread as available
     if (isRunningInThreadPoolThread()) {
         --activeThreadsCount;
     }
@@ -386,22 +433,17 @@ MultiThread::getNCPUsAvailable()
 ActionRetCodeEnum
 MultiThread::getCurrentThreadIndex(unsigned int *threadIndex)
 {
-    QThread* thisThread = QThread::currentThread();
-    if (!thisThread) {
-        return eActionStatusFailed;
-    }
-
     // Get the global multi-thread handler data
     MultiThreadPrivate* imp = appPTR->getMultiThreadHandler()->_imp.get();
 
-    PerThreadMultiThreadDataMap::const_iterator foundThread = imp->threadsData.find(thisThread);
-    if (foundThread == imp->threadsData.end()) {
+    if ( !imp->threadsData.hasLocalData() ) {
         return eActionStatusFailed;
     }
-    if (foundThread->second.indices.empty()) {
+    const MultiThreadThreadData* data = imp->threadsData.localData();
+    if ( data->indices.empty() ) {
         return eActionStatusFailed;
     }
-    *threadIndex = foundThread->second.indices.back();
+    *threadIndex = data->indices.back();
     return eActionStatusOK;
 }
 
@@ -455,6 +497,11 @@ MultiThreadProcessorBase::launchThreads(unsigned int nCPUs)
 
 ImageMultiThreadProcessorBase::ImageMultiThreadProcessorBase(const TreeRenderNodeArgsPtr& renderArgs)
 : MultiThreadProcessorBase(renderArgs)
+, _renderWindow()
+, _chunkRows(0)
+, _curChunkRows(1)
+, _nChunks(0)
+, _nextChunk(0)
 {
 
 }
@@ -470,6 +517,12 @@ ImageMultiThreadProcessorBase::setRenderWindow(const RectI& renderWindow)
     _renderWindow = renderWindow;
 }
 
+void
+ImageMultiThreadProcessorBase::setChunkRows(int nRows)
+{
+    _chunkRows = std::max(0, nRows);
+}
+
 
 void
 ImageMultiThreadProcessorBase::getThreadRange(unsigned int threadID, unsigned int nThreads, int ibegin, int iend, int* ibegin_range, int* iend_range)
@@ -493,19 +546,31 @@ ImageMultiThreadProcessorBase::getThreadRange(unsigned int threadID, unsigned in
 }
 
 ActionRetCodeEnum
-ImageMultiThreadProcessorBase::multiThreadFunction(unsigned int threadID,
-                                                   unsigned int nThreads,
+ImageMultiThreadProcessorBase::multiThreadFunction(unsigned int /*threadID*/,
+                                                   unsigned int /*nThreads*/,
                                                    const TreeRenderNodeArgsPtr& renderArgs)
 {
-    // Each threads get a rectangular portion but full scan-lines
+    // Each thread takes chunks of full scan-lines until the render window is done
     RectI win = _renderWindow;
-    getThreadRange(threadID, nThreads, _renderWindow.y1, _renderWindow.y2, &win.y1, &win.y2);
+    for (;;) {
+        const int chunk_i = _nextChunk.fetchAndAddRelaxed(1);
+        if (chunk_i >= _nChunks) {
+            return eActionStatusOK;
+        }
+        if ( renderArgs && renderArgs->isRenderAborted() ) {
+            return eActionStatusAborted;
+        }
+
+        win.y1 = _renderWindow.y1 + chunk_i * _curChunkRows;
+        win.y2 = std::min(win.y1 + _curChunkRows, _renderWindow.y2);
 
-    if ( (win.y2 - win.y1) > 0 ) {
-        // and render that thread on each
-        return multiThreadProcessImages(win, renderArgs);
+        ActionRetCodeEnum stat = multiThreadProcessImages(win, renderArgs);
+        if ( isFailureRetCode(stat) ) {
+            // Do not let the other threads start new chunks
+            _nextChunk.fetchAndStoreRelaxed(_nChunks);
+            return stat;
+        }
     }
-    return eActionStatusOK;
 }
 
 
@@ -520,6 +585,26 @@ ImageMultiThreadProcessorBase::process()
     // make sure the number of CPUs is valid (and use at least 1 CPU)
     nCPUs = std::max(1u, std::min( nCPUs, MultiThread::getNCPUsAvailable())) ;
 
+    const int width = _renderWindow.x2 - _renderWindow.x1;
+    const int height = _renderWindow.y2 - _renderWindow.y1;
+    if ( (width <= 0) || (height <= 0) ) {
+        return eActionStatusOK;
+    }
+
+    _curChunkRows = _chunkRows;
+    if (_curChunkRows == 0) {
+        // At least 4096 pixels per chunk, and a few chunks per CPU so that the threads can balance the load
+        const int minRows = (4096 + width - 1) / width;
+        const int nChunksWanted = (int)nCPUs * NATRON_IMAGE_PROCESSOR_CHUNKS_PER_THREAD;
+        _curChunkRows = std::max( minRows, (height + nChunksWanted - 1) / nChunksWanted );
+    }
+    _curChunkRows = std::min(_curChunkRows, height);
+    _nChunks = (height + _curChunkRows - 1) / _curChunkRows;
+    _nextChunk.fetchAndStoreOrdered(0);
+
+    // There is no need for more threads than chunks
+    nCPUs = std::min(nCPUs, (unsigned int)_nChunks);
+
     // call the base multi threading code
     return launchThreads(nCPUs);
 
@@ -27,6 +27,8 @@
 
 #include "Global/Macros.h"
 
+#include <QtCore/QAtomicInt>
+
 #if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
 #include <boost/scoped_ptr.hpp>
 #endif
@@ -36,6 +38,9 @@
 
 #include "Engine/EngineFwd.h"
 
+// The number of chunks of scan-lines each thread gets on average by default in ImageMultiThreadProcessorBase
+#define NATRON_IMAGE_PROCESSOR_CHUNKS_PER_THREAD 8
+
 NATRON_NAMESPACE_ENTER;
 
 struct MultiThreadPrivate;
@@ -77,14 +82,22 @@ public:
      *
      * @param customArg The arguments to passed to the function
      *
-     * This function cannot be called recursively.
+     * The functions run on the threads of a ForkJoinPool and on the calling thread, which runs the indexes no other
+     * thread took yet instead of just waiting. A function may thus call launchThreads again.
      * Note that the thread indexes are from 0 to nThreads - 1.
      * http://openfx.sourceforge.net/Documentation/1.3/ofxProgrammingReference.html#OfxMultiThreadSuiteV1_multiThread
      */
     static ActionRetCodeEnum launchThreads(ThreadFunctor func, unsigned int nThreads, void *customArg, const TreeRenderNodeArgsPtr& renderArgs);
 
     /**
-     * @brief Function which indicates the number of CPUs available for SMP processing
+     * @brief Sets the number of threads running the functions of launchThreads, including the calling thread.
+     * This follows the "number of render threads" preference, like the maximum thread count of the global thread pool.
+     **/
+    static void setNumThreads(unsigned int nThreads);
+
+    /**
+     * @brief Function which indicates the number of CPUs available for SMP processing: the threads of the global thread pool and
+     * the workers of launchThreads that are busy are not available.
      * This value may be less than the actual number of CPUs on a machine, as the host may reserve other CPUs for itself.
      *http://openfx.sourceforge.net/Documentation/1.3/ofxProgrammingReference.html#OfxMultiThreadSuiteV1_multiThreadNumCPUs
      **/
@@ -153,10 +166,25 @@ private:
     
 };
 
+/**
+ * @brief Base class to process the pixels of a render window in parallel.
+ * The threads do not get a fixed portion of the render window: they take chunks of scan-lines from a shared
+ * counter until the render window is done, so that a thread that gets rows that are quick to process
+ * (e.g: outside of a mask) takes more of them instead of waiting for the others.
+ **/
 class ImageMultiThreadProcessorBase : public MultiThreadProcessorBase
 {
     RectI _renderWindow;
 
+    // The number of rows of each chunk given by setChunkRows, or 0 to determine it in process()
+    int _chunkRows;
+
+    // The number of rows of each chunk and the number of chunks of the current call to process()
+    int _curChunkRows, _nChunks;
+
+    // The index of the next chunk to process
+    QAtomicInt _nextChunk;
+
 public:
 
     ImageMultiThreadProcessorBase(const TreeRenderNodeArgsPtr& renderArgs);
@@ -169,6 +197,15 @@ public:
      **/
     void setRenderWindow(const RectI& renderWindow);
 
+    /**
+     * @brief Set the number of scan-lines of the chunks handed to multiThreadProcessImages.
+     * Smaller chunks balance the load better between threads when the cost of the rows is uneven,
+     * at the expense of more calls to multiThreadProcessImages.
+     * If 0 (the default), the chunks have at least 4096 pixels and each thread gets about
+     * NATRON_IMAGE_PROCESSOR_CHUNKS_PER_THREAD of them.
+     **/
+    void setChunkRows(int nRows);
+
     /**
      * @brief Launch the threads and render. This is a simple wrapper over launchThreads()
      * which set the appropriate number of threads given the render window
@@ -184,6 +221,7 @@ protected:
 
     /**
      * @brief The function that will be called by each thread concurrently and that should process the image.
+     * It is called once for each chunk of scan-lines a thread takes, so a thread may call it several times.
      * @param renderWindow The rectangle of pixels to process.
      *
      * Note that this function should use the renderData parameter to check periodically if the render
@@ -512,6 +512,32 @@ static PyObject* Sbk_AppFunc_getAppID(PyObject* self)
     return pyResult;
 }
 
+static PyObject* Sbk_AppFunc_getCacheStats(PyObject* self)
+{
+    AppWrapper* cppSelf = 0;
+    SBK_UNUSED(cppSelf)
+    if (!Shiboken::Object::isValid(self))
+        return 0;
+    cppSelf = (AppWrapper*)((::App*)Shiboken::Conversions::cppPointer(SbkNatronEngineTypes[SBK_APP_IDX], (SbkObject*)self));
+    PyObject* pyResult = 0;
+
+    // Call function/method
+    {
+
+        if (!PyErr_Occurred()) {
+            // getCacheStats()const
+            PyObject* cppResult = const_cast<const ::AppWrapper*>(cppSelf)->getCacheStats();
+            pyResult = cppResult;
+        }
+    }
+
+    if (PyErr_Occurred() || !pyResult) {
+        Py_XDECREF(pyResult);
+        return 0;
+    }
+    return pyResult;
+}
+
 static PyObject* Sbk_AppFunc_getProjectParam(PyObject* self, PyObject* pyArg)
 {
     AppWrapper* cppSelf = 0;
@@ -1368,6 +1394,7 @@ static PyMethodDef Sbk_App_methods[] = {
     {"createReader", (PyCFunction)Sbk_AppFunc_createReader, METH_VARARGS|METH_KEYWORDS},
     {"createWriter", (PyCFunction)Sbk_AppFunc_createWriter, METH_VARARGS|METH_KEYWORDS},
     {"getAppID", (PyCFunction)Sbk_AppFunc_getAppID, METH_NOARGS},
+    {"getCacheStats", (PyCFunction)Sbk_AppFunc_getCacheStats, METH_NOARGS},
     {"getProjectParam", (PyCFunction)Sbk_AppFunc_getProjectParam, METH_O},
     {"getViewIndex", (PyCFunction)Sbk_AppFunc_getViewIndex, METH_O},
     {"getViewName", (PyCFunction)Sbk_AppFunc_getViewName, METH_O},
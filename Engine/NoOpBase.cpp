@@ -49,6 +49,7 @@ NoOpBase::addSupportedBitDepth(std::list<ImageBitDepthEnum>* depths) const
 {
     depths->push_back(eImageBitDepthByte);
     depths->push_back(eImageBitDepthShort);
+    depths->push_back(eImageBitDepthHalf);
     depths->push_back(eImageBitDepthFloat);
 }
 
@@ -1850,35 +1850,19 @@ Node::setNodeDisabled(bool disabled)
 ImageBitDepthEnum
 Node::getClosestSupportedBitDepth(ImageBitDepthEnum depth)
 {
-    bool foundShort = false;
-    bool foundByte = false;
-
-    for (std::list<ImageBitDepthEnum>::const_iterator it = _imp->supportedDepths.begin(); it != _imp->supportedDepths.end(); ++it) {
-        if (*it == depth) {
-            return depth;
-        } else if (*it == eImageBitDepthFloat) {
-            return eImageBitDepthFloat;
-        } else if (*it == eImageBitDepthShort) {
-            foundShort = true;
-        } else if (*it == eImageBitDepthByte) {
-            foundByte = true;
-        }
+    if ( isSupportedBitDepth(depth) ) {
+        return depth;
     }
-    if (foundShort) {
-        return eImageBitDepthShort;
-    } else if (foundByte) {
-        return eImageBitDepthByte;
-    } else {
-        ///The plug-in doesn't support any bitdepth, the program shouldn't even have reached here.
-        assert(false);
 
-        return eImageBitDepthNone;
-    }
+    // Otherwise convert to the deepest supported depth: plug-ins that only support float
+    // receive half images converted to float transparently.
+    return getBestSupportedBitDepth();
 }
 
 ImageBitDepthEnum
 Node::getBestSupportedBitDepth() const
 {
+    bool foundHalf = false;
     bool foundShort = false;
     bool foundByte = false;
 
@@ -1892,6 +1876,7 @@ Node::getBestSupportedBitDepth() const
             foundShort = true;
             break;
         case eImageBitDepthHalf:
+            foundHalf = true;
             break;
 
         case eImageBitDepthFloat:
@@ -1903,7 +1888,9 @@ Node::getBestSupportedBitDepth() const
         }
     }
 
-    if (foundShort) {
+    if (foundHalf) {
+        return eImageBitDepthHalf;
+    } else if (foundShort) {
         return eImageBitDepthShort;
     } else if (foundByte) {
         return eImageBitDepthByte;
@@ -1176,6 +1176,7 @@ NodeGroup::addSupportedBitDepth(std::list<ImageBitDepthEnum>* depths) const
 {
     depths->push_back(eImageBitDepthByte);
     depths->push_back(eImageBitDepthShort);
+    depths->push_back(eImageBitDepthHalf);
     depths->push_back(eImageBitDepthFloat);
 }
 
@@ -73,6 +73,12 @@ NodeMetadata::~NodeMetadata()
 {
 }
 
+void
+NodeMetadata::copyFrom(const NodeMetadata& other)
+{
+    _imp.reset( new Implementation(*other._imp) );
+}
+
 void
 NodeMetadata::Implementation::initializeProperties() const
 {
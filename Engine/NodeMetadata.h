@@ -212,6 +212,11 @@ public:
      **/
     int getMetadataDimension(const std::string& name) const;
 
+    /**
+     * @brief Replaces all meta-datas by a copy of the ones in other.
+     **/
+    void copyFrom(const NodeMetadata& other);
+
     /**
      * @brief Serializes the meta-data to a memory segment
      **/
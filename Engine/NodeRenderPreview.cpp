@@ -194,8 +194,10 @@ static void renderPreviewInternal(const void* srcPtrs[4],
             renderPreviewForDepth<unsigned short, 65535>(srcPtrs, srcBounds, srcNComps, width, height, convertToSrgb, buf);
             break;
         }
-        case eImageBitDepthHalf:
+        case eImageBitDepthHalf: {
+            renderPreviewForDepth<Half, 1>(srcPtrs, srcBounds, srcNComps, width, height, convertToSrgb, buf);
             break;
+        }
         case eImageBitDepthFloat: {
             renderPreviewForDepth<float, 1>(srcPtrs, srcBounds, srcNComps , width, height, convertToSrgb, buf);
             break;
@@ -1256,7 +1256,7 @@ OfxImageCommon::OfxImageCommon(const EffectInstancePtr& outputClipEffect,
         assert(internalImage->getNumTiles() == 1);
 
         Image::Tile tile;
-        internalImage->getTileAt(0, &tile);
+        internalImage->getTileAt(0, &tile, inputNb != -1 /*readOnly*/);
         Image::CPUTileData tileData;
         internalImage->getCPUTileData(tile, &tileData);
 
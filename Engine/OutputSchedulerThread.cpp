@@ -1003,6 +1003,7 @@ OutputSchedulerThread::notifyFrameRendered(const BufferedFrameContainerPtr& fram
 
     }
 
+    bool isFirstRenderedFrame = appPTR->recordFirstRenderedFrame();
     bool isBackground = appPTR->isBackground();
     boost::shared_ptr<OutputSchedulerThreadStartArgs> runArgs = _imp->runArgs.lock();
     assert(runArgs);
@@ -1064,6 +1065,11 @@ OutputSchedulerThread::notifyFrameRendered(const BufferedFrameContainerPtr& fram
         ts << effect->getScriptName_mt_safe().c_str() << tr(" ==> Frame: ");
         ts << frameStr << tr(", Progress: ") << percentageStr << "%, " << fpsStr << tr(" Fps, Time Remaining: ") << timeRemainingStr;
 
+        double timeToFirstFrame;
+        if ( isFirstRenderedFrame && appPTR->getTimeToFirstRenderedFrame(&timeToFirstFrame) ) {
+            ts << tr(", Time to first frame: ") << Timer::printAsTime(timeToFirstFrame, false);
+        }
+
         QString shortMessage = QString::fromUtf8(kFrameRenderedStringShort) + frameStr + QString::fromUtf8(kProgressChangedStringShort) + QString::number(percentage);
         {
             QMutexLocker l(&_imp->bufferedOutputMutex);
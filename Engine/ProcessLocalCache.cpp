@@ -0,0 +1,243 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2017 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "ProcessLocalCache.h"
+
+#include <cassert>
+#include <list>
+#include <utility>
+
+#include <QtCore/QMutex>
+
+GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_OFF
+#include <boost/unordered_map.hpp>
+GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
+
+#include "Engine/CacheEntryBase.h"
+
+// Must be a power of 2
+#define NATRON_PROCESS_LOCAL_CACHE_SHARDS_COUNT 16
+
+NATRON_NAMESPACE_ENTER;
+
+struct ProcessLocalCacheShard
+{
+    // Most recently used entries are at the front
+    typedef std::list<CacheEntryBasePtr> EntriesList;
+    typedef boost::unordered_map<U64, EntriesList::iterator> EntriesMap;
+
+    // Protects all fields below
+    mutable QMutex lock;
+
+    EntriesList lruList;
+
+    EntriesMap entries;
+
+    std::size_t maxEntries;
+
+    U64 nHits, nMisses, nEvictions;
+
+    ProcessLocalCacheShard()
+    : lock()
+    , lruList()
+    , entries()
+    , maxEntries(0)
+    , nHits(0)
+    , nMisses(0)
+    , nEvictions(0)
+    {
+
+    }
+
+    /**
+     * @brief Evict the least recently used entries until there are at most maxEntries.
+     * The lock must be held.
+     **/
+    void evictExceedingEntries()
+    {
+        while (entries.size() > maxEntries) {
+            assert( !lruList.empty() );
+            entries.erase( lruList.back()->getHashKey() );
+            lruList.pop_back();
+            ++nEvictions;
+        }
+    }
+};
+
+struct ProcessLocalCachePrivate
+{
+    ProcessLocalCacheShard shards[NATRON_PROCESS_LOCAL_CACHE_SHARDS_COUNT];
+
+    // Protects maxEntries
+    mutable QMutex maxEntriesLock;
+
+    std::size_t maxEntries;
+
+    ProcessLocalCachePrivate()
+    : shards()
+    , maxEntriesLock()
+    , maxEntries(0)
+    {
+
+    }
+
+    ProcessLocalCacheShard& getShard(U64 hash)
+    {
+        // The Cache dispatches its buckets with the first digits of the hash, use the last ones here
+        return shards[hash & (NATRON_PROCESS_LOCAL_CACHE_SHARDS_COUNT - 1)];
+    }
+};
+
+ProcessLocalCache::ProcessLocalCache(std::size_t maxEntries)
+: _imp(new ProcessLocalCachePrivate)
+{
+    setMaximumEntries(maxEntries);
+}
+
+ProcessLocalCache::~ProcessLocalCache()
+{
+
+}
+
+bool
+ProcessLocalCache::get(const CacheEntryBasePtr& entry)
+{
+    assert(entry);
+    U64 hash = entry->getHashKey();
+    ProcessLocalCacheShard& shard = _imp->getShard(hash);
+
+    QMutexLocker k(&shard.lock);
+    ProcessLocalCacheShard::EntriesMap::iterator found = shard.entries.find(hash);
+    if ( found == shard.entries.end() ) {
+        ++shard.nMisses;
+        return false;
+    }
+
+    // The cached entry may not be of the same type if 2 different keys produced the same hash
+    if ( !entry->copyFromProcessLocalEntry(**found->second) ) {
+        ++shard.nMisses;
+        return false;
+    }
+    ++shard.nHits;
+
+    // Move to the front of the LRU list
+    shard.lruList.splice(shard.lruList.begin(), shard.lruList, found->second);
+    return true;
+} // get
+
+void
+ProcessLocalCache::insert(const CacheEntryBasePtr& entry)
+{
+    assert(entry && entry->isProcessLocalCacheable());
+    U64 hash = entry->getHashKey();
+    ProcessLocalCacheShard& shard = _imp->getShard(hash);
+
+    {
+        QMutexLocker k(&shard.lock);
+        if (shard.maxEntries == 0) {
+            return;
+        }
+    }
+
+    // Copy the results that the caller may still modify outside of the lock
+    CacheEntryBasePtr localEntry = entry->createProcessLocalEntry();
+
+    QMutexLocker k(&shard.lock);
+    if (shard.maxEntries == 0) {
+        return;
+    }
+    ProcessLocalCacheShard::EntriesMap::iterator found = shard.entries.find(hash);
+    if ( found != shard.entries.end() ) {
+        *found->second = localEntry;
+        shard.lruList.splice(shard.lruList.begin(), shard.lruList, found->second);
+        return;
+    }
+    shard.lruList.push_front(localEntry);
+    shard.entries.insert( std::make_pair( hash, shard.lruList.begin() ) );
+    shard.evictExceedingEntries();
+} // insert
+
+void
+ProcessLocalCache::remove(U64 hash)
+{
+    ProcessLocalCacheShard& shard = _imp->getShard(hash);
+
+    QMutexLocker k(&shard.lock);
+    ProcessLocalCacheShard::EntriesMap::iterator found = shard.entries.find(hash);
+    if ( found == shard.entries.end() ) {
+        return;
+    }
+    shard.lruList.erase(found->second);
+    shard.entries.erase(found);
+}
+
+void
+ProcessLocalCache::clear()
+{
+    for (int i = 0; i < NATRON_PROCESS_LOCAL_CACHE_SHARDS_COUNT; ++i) {
+        ProcessLocalCacheShard& shard = _imp->shards[i];
+        QMutexLocker k(&shard.lock);
+        shard.entries.clear();
+        shard.lruList.clear();
+    }
+}
+
+void
+ProcessLocalCache::setMaximumEntries(std::size_t maxEntries)
+{
+    QMutexLocker k(&_imp->maxEntriesLock);
+    _imp->maxEntries = maxEntries;
+
+    // Round up so that a non-zero maximum leaves room in every shard
+    std::size_t maxEntriesPerShard = (maxEntries + NATRON_PROCESS_LOCAL_CACHE_SHARDS_COUNT - 1) / NATRON_PROCESS_LOCAL_CACHE_SHARDS_COUNT;
+    for (int i = 0; i < NATRON_PROCESS_LOCAL_CACHE_SHARDS_COUNT; ++i) {
+        ProcessLocalCacheShard& shard = _imp->shards[i];
+        QMutexLocker l(&shard.lock);
+        shard.maxEntries = maxEntriesPerShard;
+        shard.evictExceedingEntries();
+    }
+}
+
+std::size_t
+ProcessLocalCache::getMaximumEntries() const
+{
+    QMutexLocker k(&_imp->maxEntriesLock);
+    return _imp->maxEntries;
+}
+
+void
+ProcessLocalCache::getStats(ProcessLocalCacheStats* stats) const
+{
+    *stats = ProcessLocalCacheStats();
+    for (int i = 0; i < NATRON_PROCESS_LOCAL_CACHE_SHARDS_COUNT; ++i) {
+        const ProcessLocalCacheShard& shard = _imp->shards[i];
+        QMutexLocker k(&shard.lock);
+        stats->nHits += shard.nHits;
+        stats->nMisses += shard.nMisses;
+        stats->nEvictions += shard.nEvictions;
+        stats->nEntries += shard.entries.size();
+    }
+}
+
+NATRON_NAMESPACE_EXIT;
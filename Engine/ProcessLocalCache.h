@@ -0,0 +1,125 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2017 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef Engine_ProcessLocalCache_h
+#define Engine_ProcessLocalCache_h
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cstddef>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/scoped_ptr.hpp>
+#endif
+
+#include "Global/GlobalDefines.h"
+
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER;
+
+struct ProcessLocalCacheStats
+{
+    // Number of look-ups that were answered by the process-local cache
+    U64 nHits;
+
+    // Number of look-ups that had to go through the shared cache
+    U64 nMisses;
+
+    // Number of entries dropped because the cache was full
+    U64 nEvictions;
+
+    // Number of entries currently held
+    std::size_t nEntries;
+
+    ProcessLocalCacheStats()
+    : nHits(0)
+    , nMisses(0)
+    , nEvictions(0)
+    , nEntries(0)
+    {
+
+    }
+};
+
+/**
+ * @brief A process-local cache sitting in front of the interprocess Cache, for small entries that are looked-up
+ * very often (e.g: the results of the getRegionOfDefinition or isIdentity actions).
+ * A hit avoids taking the interprocess locks of the bucket and deserializing the entry from the memory segment.
+ * Entries are indexed by the same hash key as in the Cache. Only entries for which
+ * CacheEntryBase::isProcessLocalCacheable() returns true may be inserted.
+ * The map is split in shards, each protected by its own mutex, and each shard evicts its least recently used
+ * entries so that the total number of entries stays below the maximum.
+ * Inserted entries must not be modified afterwards, unless CacheEntryBase::createProcessLocalEntry() returns a copy.
+ * This class is thread-safe.
+ **/
+struct ProcessLocalCachePrivate;
+class ProcessLocalCache
+{
+public:
+
+    ProcessLocalCache(std::size_t maxEntries);
+
+    ~ProcessLocalCache();
+
+    /**
+     * @brief Look-up the entry's hash key. If found, the cached results are copied to the entry
+     * with CacheEntryBase::copyFromProcessLocalEntry and this function returns true.
+     **/
+    bool get(const CacheEntryBasePtr& entry);
+
+    /**
+     * @brief Insert the given entry, which must be fully computed. The cache keeps the entry returned by
+     * CacheEntryBase::createProcessLocalEntry(), which is a copy for entries whose results the caller may modify.
+     * If an entry with the same hash is already present, it is replaced.
+     **/
+    void insert(const CacheEntryBasePtr& entry);
+
+    /**
+     * @brief Removes the entry with the given hash, if any.
+     **/
+    void remove(U64 hash);
+
+    /**
+     * @brief Removes all entries. This does not reset the statistics.
+     **/
+    void clear();
+
+    /**
+     * @brief Set the maximum number of entries. If shrinking, exceeding entries are evicted.
+     * A value of 0 disables the process-local cache.
+     **/
+    void setMaximumEntries(std::size_t maxEntries);
+    std::size_t getMaximumEntries() const;
+
+    void getStats(ProcessLocalCacheStats* stats) const;
+
+private:
+
+    boost::scoped_ptr<ProcessLocalCachePrivate> _imp;
+};
+
+NATRON_NAMESPACE_EXIT;
+
+#endif // Engine_ProcessLocalCache_h
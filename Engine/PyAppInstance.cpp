@@ -41,6 +41,9 @@ GCC_DIAG_ON(unused-parameter)
 
 
 #include "Engine/AppInstance.h"
+#include "Engine/AppManager.h"
+#include "Engine/Cache.h"
+#include "Engine/CacheStats.h"
 #include "Engine/CreateNodeArgs.h"
 #include "Engine/Project.h"
 #include "Engine/Node.h"
@@ -71,6 +74,92 @@ App::getAppID() const
     return getInternalApp()->getAppID();
 }
 
+// PyDict_SetItemString does not steal the reference to the value
+static void
+setDictItem(PyObject* dict,
+            const char* key,
+            PyObject* value)
+{
+    PyDict_SetItemString(dict, key, value);
+    Py_DECREF(value);
+}
+
+static PyObject*
+cacheLatencyToPython(const CacheLatencyHistogram& histogram)
+{
+    PyObject* ret = PyDict_New();
+
+    setDictItem( ret, "count", PyLong_FromUnsignedLongLong(histogram.nSamples) );
+    setDictItem( ret, "mean", PyFloat_FromDouble( histogram.getMeanSeconds() ) );
+    setDictItem( ret, "p50", PyFloat_FromDouble( histogram.getPercentileSeconds(0.5) ) );
+    setDictItem( ret, "p99", PyFloat_FromDouble( histogram.getPercentileSeconds(0.99) ) );
+    setDictItem( ret, "max", PyFloat_FromDouble(histogram.maxSeconds) );
+    setDictItem( ret, "total", PyFloat_FromDouble(histogram.totalSeconds) );
+
+    PyObject* counts = PyList_New(NATRON_CACHE_LATENCY_HISTOGRAM_BUCKETS_COUNT);
+    for (int i = 0; i < NATRON_CACHE_LATENCY_HISTOGRAM_BUCKETS_COUNT; ++i) {
+        // PyList_SetItem steals the reference
+        PyList_SetItem( counts, i, PyLong_FromUnsignedLongLong(histogram.counts[i]) );
+    }
+    setDictItem(ret, "histogram", counts);
+
+    return ret;
+}
+
+static PyObject*
+cacheStatsToPython(const CacheStats& stats)
+{
+    PyObject* ret = PyDict_New();
+
+    setDictItem( ret, "hits", PyLong_FromUnsignedLongLong(stats.nHits) );
+    setDictItem( ret, "misses", PyLong_FromUnsignedLongLong(stats.nMisses) );
+    setDictItem( ret, "hitRatio", PyFloat_FromDouble( stats.getHitRatio() ) );
+    setDictItem( ret, "pendingWaits", PyLong_FromUnsignedLongLong(stats.nPendingWaits) );
+    setDictItem( ret, "insertions", PyLong_FromUnsignedLongLong(stats.nInsertions) );
+    setDictItem( ret, "evictions", PyLong_FromUnsignedLongLong(stats.nEvictions) );
+    setDictItem( ret, "contendedLocks", PyLong_FromUnsignedLongLong(stats.nContendedLocks) );
+    setDictItem( ret, "fileGrowths", PyLong_FromUnsignedLongLong(stats.nFileGrowths) );
+    setDictItem( ret, "compressedHits", PyLong_FromUnsignedLongLong(stats.nCompressedHits) );
+    setDictItem( ret, "compressedMisses", PyLong_FromUnsignedLongLong(stats.nCompressedMisses) );
+    setDictItem( ret, "compressedWrites", PyLong_FromUnsignedLongLong(stats.nCompressedWrites) );
+    setDictItem( ret, "compressionRatio", PyFloat_FromDouble( stats.getCompressionRatio() ) );
+    setDictItem( ret, "getLatency", cacheLatencyToPython(stats.getLatency) );
+    setDictItem( ret, "insertLatency", cacheLatencyToPython(stats.insertLatency) );
+    setDictItem( ret, "evictLatency", cacheLatencyToPython(stats.evictLatency) );
+    setDictItem( ret, "waitLatency", cacheLatencyToPython(stats.waitLatency) );
+    setDictItem( ret, "lockLatency", cacheLatencyToPython(stats.lockLatency) );
+    setDictItem( ret, "fileGrowthLatency", cacheLatencyToPython(stats.fileGrowthLatency) );
+    setDictItem( ret, "compressLatency", cacheLatencyToPython(stats.compressLatency) );
+    setDictItem( ret, "decompressLatency", cacheLatencyToPython(stats.decompressLatency) );
+
+    return ret;
+}
+
+PyObject*
+App::getCacheStats() const
+{
+    CacheStatsReport report;
+
+    appPTR->getCache()->getStats(&report);
+
+    PyObject* ret = PyDict_New();
+    setDictItem( ret, "total", cacheStatsToPython(report.total) );
+
+    PyObject* perBucket = PyList_New( report.perBucket.size() );
+    for (std::size_t i = 0; i < report.perBucket.size(); ++i) {
+        PyList_SetItem( perBucket, i, cacheStatsToPython(report.perBucket[i]) );
+    }
+    setDictItem(ret, "perBucket", perBucket);
+
+    PyObject* perPlugin = PyDict_New();
+    for (std::map<std::string, CacheStats>::const_iterator it = report.perPlugin.begin(); it != report.perPlugin.end(); ++it) {
+        setDictItem( perPlugin, it->first.c_str(), cacheStatsToPython(it->second) );
+    }
+    setDictItem(ret, "perPlugin", perPlugin);
+
+    return ret;
+}
+
 AppInstancePtr
 App::getInternalApp() const
 {
@@ -277,6 +277,13 @@ public:
 
     int getAppID() const;
 
+    /**
+     * @brief Returns a dictionary with the statistics of the cache operations made by this process, with
+     * the keys "total", "perBucket" (a list) and "perPlugin" (a dictionary indexed by plug-in ID).
+     * Latencies are in seconds.
+     **/
+    PyObject* getCacheStats() const;
+
     AppInstancePtr getInternalApp() const;
 
     /**
@@ -0,0 +1,406 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2017 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "RAMBufferPool.h"
+
+#include <cassert>
+#include <climits>
+#include <cstdlib>
+#include <list>
+#include <map>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QMutex>
+#include <QtCore/QThreadStorage>
+
+// The size held by the pool is counted in pages so that it fits in a QAtomicInt.
+// Size classes are multiples of this.
+#define NATRON_RAM_BUFFER_POOL_PAGE_SIZE 4096
+
+NATRON_NAMESPACE_ENTER;
+
+struct RAMBufferPoolPrivate;
+
+/**
+ * @brief The buffers released by a thread, that it looks in first when allocating.
+ **/
+struct RAMBufferPoolThreadCache
+{
+    RAMBufferPoolPrivate* pool;
+
+    // Protects the fields below. Other threads only take it to trim the pool or read the statistics.
+    QMutex lock;
+
+    // The capacity and data of each buffer. The most recently released buffers are at the back.
+    std::vector<std::pair<std::size_t, void*> > buffers;
+
+    // The counters of the allocations made by this thread
+    RAMBufferPoolStats stats;
+
+    RAMBufferPoolThreadCache(RAMBufferPoolPrivate* pool)
+    : pool(pool)
+    , lock()
+    , buffers()
+    , stats()
+    {
+
+    }
+
+    /**
+     * @brief Called when the thread exits: the buffers are given to the other threads.
+     **/
+    ~RAMBufferPoolThreadCache();
+};
+
+struct RAMBufferPoolPrivate
+{
+    typedef std::map<std::size_t, std::vector<void*> > FreeBuffersMap;
+
+    // Protects freeBuffers, threadCaches and stats.
+    // When both are taken, this lock is taken before the lock of a thread cache.
+    mutable QMutex lock;
+
+    // The buffers shared by all threads, for each size class
+    FreeBuffersMap freeBuffers;
+
+    // The cache of each thread that allocated or released a buffer
+    std::list<RAMBufferPoolThreadCache*> threadCaches;
+
+    // The counters of the allocations served by the shared buffers and of the threads that exited
+    RAMBufferPoolStats stats;
+
+    // The size of the buffers held by the pool, in the shared lists and in the thread caches, and its maximum, in pages
+    QAtomicInt pagesHeld, maxPages;
+
+    QThreadStorage<RAMBufferPoolThreadCache*> threadCache;
+
+    RAMBufferPoolPrivate(std::size_t maxBytes)
+    : lock()
+    , freeBuffers()
+    , threadCaches()
+    , stats()
+    , pagesHeld(0)
+    , maxPages( toPages(maxBytes) )
+    , threadCache()
+    {
+
+    }
+
+    static int toPages(std::size_t nBytes)
+    {
+        std::size_t nPages = nBytes / NATRON_RAM_BUFFER_POOL_PAGE_SIZE;
+        return nPages > (std::size_t)INT_MAX ? INT_MAX : (int)nPages;
+    }
+
+    RAMBufferPoolThreadCache* getThreadCache()
+    {
+        if ( threadCache.hasLocalData() ) {
+            return threadCache.localData();
+        }
+        RAMBufferPoolThreadCache* ret = new RAMBufferPoolThreadCache(this);
+        {
+            QMutexLocker k(&lock);
+            threadCaches.push_back(ret);
+        }
+        threadCache.setLocalData(ret);
+        return ret;
+    }
+
+    /**
+     * @brief Accounts for a buffer of the given capacity kept by the pool.
+     * Returns false if the pool is full, in which case the buffer must be freed.
+     **/
+    bool reserve(std::size_t capacity)
+    {
+        const int pages = toPages(capacity);
+        const int held = pagesHeld.fetchAndAddOrdered(pages) + pages;
+        if ( held > maxPages.fetchAndAddAcquire(0) ) {
+            pagesHeld.fetchAndAddOrdered(-pages);
+            return false;
+        }
+        return true;
+    }
+
+    void unreserve(std::size_t capacity)
+    {
+        pagesHeld.fetchAndAddOrdered( -toPages(capacity) );
+    }
+
+    bool isOverBudget() const
+    {
+        return const_cast<QAtomicInt&>(pagesHeld).fetchAndAddAcquire(0) > const_cast<QAtomicInt&>(maxPages).fetchAndAddAcquire(0);
+    }
+
+    /**
+     * @brief Frees the held buffers until the pool is under its maximum size, or all of them if freeAll is true.
+     * The largest buffers of the shared lists are freed first, then the oldest buffers of the thread caches.
+     **/
+    void freeExceedingBuffers(bool freeAll);
+};
+
+RAMBufferPoolThreadCache::~RAMBufferPoolThreadCache()
+{
+    if (!pool) {
+        // The pool was destroyed first and freed the buffers
+        return;
+    }
+    QMutexLocker k(&pool->lock);
+    pool->threadCaches.remove(this);
+    for (std::size_t i = 0; i < buffers.size(); ++i) {
+        pool->freeBuffers[buffers[i].first].push_back(buffers[i].second);
+    }
+    pool->stats.nReuses += stats.nReuses;
+    pool->stats.nAllocations += stats.nAllocations;
+    pool->stats.bytesReused += stats.bytesReused;
+    pool->stats.nDiscards += stats.nDiscards;
+}
+
+void
+RAMBufferPoolPrivate::freeExceedingBuffers(bool freeAll)
+{
+    std::vector<void*> toFree;
+    {
+        QMutexLocker k(&lock);
+        for (FreeBuffersMap::reverse_iterator it = freeBuffers.rbegin(); it != freeBuffers.rend(); ++it) {
+            while ( !it->second.empty() && ( freeAll || isOverBudget() ) ) {
+                toFree.push_back( it->second.back() );
+                it->second.pop_back();
+                unreserve(it->first);
+            }
+        }
+        for (std::list<RAMBufferPoolThreadCache*>::iterator it = threadCaches.begin(); it != threadCaches.end(); ++it) {
+            QMutexLocker k2(&(*it)->lock);
+            std::vector<std::pair<std::size_t, void*> >& buffers = (*it)->buffers;
+            std::size_t nFreed = 0;
+            while ( nFreed < buffers.size() && ( freeAll || isOverBudget() ) ) {
+                toFree.push_back(buffers[nFreed].second);
+                unreserve(buffers[nFreed].first);
+                ++nFreed;
+            }
+            buffers.erase( buffers.begin(), buffers.begin() + nFreed );
+        }
+        stats.nDiscards += toFree.size();
+    }
+
+    // Free outside of the lock
+    for (std::size_t i = 0; i < toFree.size(); ++i) {
+        free(toFree[i]);
+    }
+} // freeExceedingBuffers
+
+RAMBufferPool::RAMBufferPool(std::size_t maxBytes)
+: _imp( new RAMBufferPoolPrivate(maxBytes) )
+{
+
+}
+
+RAMBufferPool::~RAMBufferPool()
+{
+    _imp->freeExceedingBuffers(true);
+
+    // The data of the QThreadStorage is not deleted with it
+    QMutexLocker k(&_imp->lock);
+    for (std::list<RAMBufferPoolThreadCache*>::iterator it = _imp->threadCaches.begin(); it != _imp->threadCaches.end(); ++it) {
+        (*it)->pool = 0;
+        delete *it;
+    }
+    _imp->threadCaches.clear();
+}
+
+std::size_t
+RAMBufferPool::getSizeClass(std::size_t nBytes)
+{
+    if (nBytes < NATRON_RAM_BUFFER_POOL_MIN_SIZE_CLASS) {
+        return nBytes;
+    }
+
+    // Find the power of 2 p such that p <= nBytes < 2p and round up to a multiple of p / 4
+    std::size_t p = NATRON_RAM_BUFFER_POOL_MIN_SIZE_CLASS;
+    while ( p <= (nBytes / 2) ) {
+        p *= 2;
+    }
+    const std::size_t step = p / 4;
+    return ( (nBytes + step - 1) / step ) * step;
+}
+
+void*
+RAMBufferPool::allocate(std::size_t nBytes,
+                        std::size_t* capacity)
+{
+    *capacity = getSizeClass(nBytes);
+    if (*capacity == 0) {
+        return 0;
+    }
+    if (*capacity < NATRON_RAM_BUFFER_POOL_MIN_SIZE_CLASS) {
+        void* ret = malloc(*capacity);
+        if (!ret) {
+            throw std::bad_alloc();
+        }
+        return ret;
+    }
+
+    void* ret = 0;
+
+    // Look first in the buffers released by this thread, most recent first
+    RAMBufferPoolThreadCache* threadCache = _imp->getThreadCache();
+    {
+        QMutexLocker k(&threadCache->lock);
+        for (std::size_t i = threadCache->buffers.size(); i > 0; --i) {
+            if (threadCache->buffers[i - 1].first == *capacity) {
+                ret = threadCache->buffers[i - 1].second;
+                threadCache->buffers.erase(threadCache->buffers.begin() + (i - 1));
+                ++threadCache->stats.nReuses;
+                threadCache->stats.bytesReused += *capacity;
+                break;
+            }
+        }
+    }
+
+    // Then in the buffers shared by all threads
+    if (!ret) {
+        QMutexLocker k(&_imp->lock);
+        RAMBufferPoolPrivate::FreeBuffersMap::iterator found = _imp->freeBuffers.find(*capacity);
+        if ( ( found != _imp->freeBuffers.end() ) && !found->second.empty() ) {
+            ret = found->second.back();
+            found->second.pop_back();
+            ++_imp->stats.nReuses;
+            _imp->stats.bytesReused += *capacity;
+        }
+    }
+
+    if (ret) {
+        _imp->unreserve(*capacity);
+        return ret;
+    }
+
+    ret = malloc(*capacity);
+    if (!ret) {
+        // The buffers held by the pool may be what is missing
+        clear();
+        ret = malloc(*capacity);
+        if (!ret) {
+            throw std::bad_alloc();
+        }
+    }
+    {
+        QMutexLocker k(&threadCache->lock);
+        ++threadCache->stats.nAllocations;
+    }
+    return ret;
+} // allocate
+
+void
+RAMBufferPool::release(void* data,
+                       std::size_t capacity)
+{
+    if (!data) {
+        return;
+    }
+    if (capacity < NATRON_RAM_BUFFER_POOL_MIN_SIZE_CLASS) {
+        free(data);
+        return;
+    }
+
+    RAMBufferPoolThreadCache* threadCache = _imp->getThreadCache();
+    if ( !_imp->reserve(capacity) ) {
+        free(data);
+        QMutexLocker k(&threadCache->lock);
+        ++threadCache->stats.nDiscards;
+        return;
+    }
+
+    std::pair<std::size_t, void*> oldest(0, (void*)0);
+    {
+        QMutexLocker k(&threadCache->lock);
+        threadCache->buffers.push_back( std::make_pair(capacity, data) );
+        if (threadCache->buffers.size() > NATRON_RAM_BUFFER_POOL_THREAD_CACHE_BUFFERS) {
+            oldest = threadCache->buffers.front();
+            threadCache->buffers.erase( threadCache->buffers.begin() );
+        }
+    }
+
+    // Give the oldest buffer of this thread to the other threads. The thread cache lock must not be held here.
+    if (oldest.second) {
+        QMutexLocker k(&_imp->lock);
+        _imp->freeBuffers[oldest.first].push_back(oldest.second);
+    }
+} // release
+
+void
+RAMBufferPool::setMaximumBytes(std::size_t maxBytes)
+{
+    const int maxPages = RAMBufferPoolPrivate::toPages(maxBytes);
+    const int curMaxPages = _imp->maxPages.fetchAndStoreOrdered(maxPages);
+    if (maxPages < curMaxPages) {
+        _imp->freeExceedingBuffers(false);
+    }
+}
+
+std::size_t
+RAMBufferPool::getMaximumBytes() const
+{
+    return (std::size_t)_imp->maxPages.fetchAndAddAcquire(0) * NATRON_RAM_BUFFER_POOL_PAGE_SIZE;
+}
+
+void
+RAMBufferPool::clear()
+{
+    _imp->freeExceedingBuffers(true);
+}
+
+void
+RAMBufferPool::getStats(RAMBufferPoolStats* stats) const
+{
+    QMutexLocker k(&_imp->lock);
+    *stats = _imp->stats;
+    stats->nBuffersHeld = 0;
+    for (RAMBufferPoolPrivate::FreeBuffersMap::const_iterator it = _imp->freeBuffers.begin(); it != _imp->freeBuffers.end(); ++it) {
+        stats->nBuffersHeld += it->second.size();
+    }
+    for (std::list<RAMBufferPoolThreadCache*>::const_iterator it = _imp->threadCaches.begin(); it != _imp->threadCaches.end(); ++it) {
+        QMutexLocker k2(&(*it)->lock);
+        stats->nReuses += (*it)->stats.nReuses;
+        stats->nAllocations += (*it)->stats.nAllocations;
+        stats->bytesReused += (*it)->stats.bytesReused;
+        stats->nDiscards += (*it)->stats.nDiscards;
+        stats->nBuffersHeld += (*it)->buffers.size();
+    }
+    stats->bytesHeld = (std::size_t)_imp->pagesHeld.fetchAndAddAcquire(0) * NATRON_RAM_BUFFER_POOL_PAGE_SIZE;
+}
+
+void
+RAMBufferPool::resetStats()
+{
+    QMutexLocker k(&_imp->lock);
+    _imp->stats = RAMBufferPoolStats();
+    for (std::list<RAMBufferPoolThreadCache*>::iterator it = _imp->threadCaches.begin(); it != _imp->threadCaches.end(); ++it) {
+        QMutexLocker k2(&(*it)->lock);
+        (*it)->stats = RAMBufferPoolStats();
+    }
+}
+
+NATRON_NAMESPACE_EXIT;
@@ -0,0 +1,138 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2017 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef Engine_RAMBufferPool_h
+#define Engine_RAMBufferPool_h
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cstddef>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/scoped_ptr.hpp>
+#endif
+
+#include "Global/GlobalDefines.h"
+
+#include "Engine/EngineFwd.h"
+
+// Buffers smaller than this are not pooled: malloc handles them well
+#define NATRON_RAM_BUFFER_POOL_MIN_SIZE_CLASS (64 * 1024)
+
+// Number of buffers each thread keeps for itself before giving them to the other threads
+#define NATRON_RAM_BUFFER_POOL_THREAD_CACHE_BUFFERS 4
+
+NATRON_NAMESPACE_ENTER;
+
+struct RAMBufferPoolPrivate;
+
+struct RAMBufferPoolStats
+{
+    // Number of allocations served by a buffer that was released before
+    U64 nReuses;
+
+    // Number of allocations that had to allocate a new buffer
+    U64 nAllocations;
+
+    // Size of the buffers that were reused
+    U64 bytesReused;
+
+    // Number of released buffers that were freed because the pool was full
+    U64 nDiscards;
+
+    // Number of buffers and their size currently held by the pool, waiting to be reused
+    std::size_t nBuffersHeld;
+    std::size_t bytesHeld;
+
+    RAMBufferPoolStats()
+    : nReuses(0)
+    , nAllocations(0)
+    , bytesReused(0)
+    , nDiscards(0)
+    , nBuffersHeld(0)
+    , bytesHeld(0)
+    {
+
+    }
+};
+
+/**
+ * @brief A pool recycling the memory of RAMImageStorage buffers, so that the temporary images of each frame
+ * reuse the buffers of the previous frame instead of going through malloc and free, which for large buffers
+ * maps and unmaps memory and takes the locks of the allocator.
+ * Requested sizes are rounded up to a size class: there are 4 size classes per power of 2, so that at most
+ * 25% of a buffer is wasted. Each thread keeps the last few buffers it released in its own list, which it looks in
+ * first. Other released buffers go to lists shared by all threads.
+ * The pool holds at most getMaximumBytes() of buffers that are not in use: a buffer released when the pool is full
+ * is freed. The Cache sets this maximum according to its memory budget.
+ * This class is thread-safe.
+ **/
+class RAMBufferPool
+{
+public:
+
+    RAMBufferPool(std::size_t maxBytes);
+
+    ~RAMBufferPool();
+
+    /**
+     * @brief Returns a buffer of at least nBytes. Its actual size, which must be passed to release(), is set in capacity.
+     * Throws std::bad_alloc if the memory cannot be allocated.
+     **/
+    void* allocate(std::size_t nBytes, std::size_t* capacity);
+
+    /**
+     * @brief Gives back a buffer returned by allocate(), with the capacity allocate() returned.
+     **/
+    void release(void* data, std::size_t capacity);
+
+    /**
+     * @brief Set the maximum size of the buffers held by the pool. If shrinking, exceeding buffers are freed.
+     * A value of 0 disables the pool.
+     **/
+    void setMaximumBytes(std::size_t maxBytes);
+    std::size_t getMaximumBytes() const;
+
+    /**
+     * @brief Frees all the buffers held by the pool. This does not reset the statistics.
+     **/
+    void clear();
+
+    void getStats(RAMBufferPoolStats* stats) const;
+
+    void resetStats();
+
+    /**
+     * @brief Returns the size of the buffer allocated for a request of nBytes.
+     **/
+    static std::size_t getSizeClass(std::size_t nBytes);
+
+private:
+
+    boost::scoped_ptr<RAMBufferPoolPrivate> _imp;
+};
+
+NATRON_NAMESPACE_EXIT;
+
+#endif // Engine_RAMBufferPool_h
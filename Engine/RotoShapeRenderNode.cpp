@@ -442,7 +442,7 @@ RotoShapeRenderNode::render(const RenderActionArgs& args)
                 Image::CPUTileData imageData;
                 {
                     Image::Tile tile;
-                    outputPlane.second->getTileAt(0, &tile);
+                    outputPlane.second->getTileAt(0, &tile, false /*readOnly*/);
                     outputPlane.second->getCPUTileData(tile, &imageData);
                 }
 
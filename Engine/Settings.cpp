@@ -51,6 +51,7 @@
 #include "Engine/KnobTypes.h"
 #include "Engine/LibraryBinary.h"
 #include "Engine/MemoryInfo.h" // getSystemTotalRAM, isApplication32Bits, printAsRAM
+#include "Engine/MultiThread.h"
 #include "Engine/Node.h"
 #include "Engine/OSGLContext.h"
 #include "Engine/OutputSchedulerThread.h"
@@ -123,6 +124,7 @@ public:
     // General/Threading
     KnobPagePtr _threadingPage;
     KnobIntPtr _numberOfThreads;
+    KnobBoolPtr _parallelTreeRender;
     KnobBoolPtr _renderInSeparateProcess;
     KnobBoolPtr _queueRenders;
 
@@ -182,6 +184,11 @@ public:
     // The total disk space allowed for all Natron's caches
     KnobIntPtr _maxDiskCacheSizeGb;
     KnobIntPtr _maxRAMCacheSizeMb;
+    KnobIntPtr _maxCompressedCacheSizeGb;
+    KnobBoolPtr _adaptiveCacheSize;
+    KnobIntPtr _minAdaptiveCacheSizeGb;
+    KnobChoicePtr _cacheTileSize;
+    KnobChoicePtr _cacheEvictionPolicy;
     KnobPathPtr _diskCachePath;
 
     // Viewer
@@ -915,6 +922,14 @@ SettingsPrivate::initializeKnobsThreading()
     _numberOfThreads->setDefaultValue(0);
     _threadingPage->addKnob(_numberOfThreads);
 
+    _parallelTreeRender = AppManager::createKnob<KnobBool>( thisShared, tr("Render independent branches in parallel") );
+    _parallelTreeRender->setName("parallelTreeRender");
+    _parallelTreeRender->setHintToolTip( tr("When checked, the nodes of a render tree are scheduled as a graph of tasks on the render threads "
+                                            "so that independent branches of the graph (e.g: the A and B inputs of a Merge) render "
+                                            "concurrently. When unchecked, each node renders its inputs recursively before rendering itself.") );
+    _parallelTreeRender->setDefaultValue(true);
+    _threadingPage->addKnob(_parallelTreeRender);
+
 
     _renderInSeparateProcess = AppManager::createKnob<KnobBool>( thisShared, tr("Render in a separate process") );
     _renderInSeparateProcess->setName("renderNewProcess");
@@ -2068,6 +2083,78 @@ SettingsPrivate::initializeKnobsCaching()
 
     _cachingTab->addKnob(_maxRAMCacheSizeMb);
 
+    _maxCompressedCacheSizeGb = AppManager::createKnob<KnobInt>( thisShared, tr("Compressed Disk Cache Size (GiB) (0 = Disabled)") );
+    _maxCompressedCacheSizeGb->setName("maxCompressedCacheGb");
+    _maxCompressedCacheSizeGb->disableSlider();
+    _maxCompressedCacheSizeGb->setRange(0, INT_MAX);
+    _maxCompressedCacheSizeGb->setHintToolTip( tr("When the disk cache is full, the image tiles it evicts are compressed without loss and kept in "
+                                                  "additional files of at most this size (in GiB). A tile found there is decompressed "
+                                                  "instead of being rendered again. This is not counted in the Maximum Disk Cache Size.") );
+    _maxCompressedCacheSizeGb->setDefaultValue(0);
+
+    _cachingTab->addKnob(_maxCompressedCacheSizeGb);
+
+    _adaptiveCacheSize = AppManager::createKnob<KnobBool>( thisShared, tr("Adapt Cache Size to Memory Pressure") );
+    _adaptiveCacheSize->setName("adaptiveCacheSize");
+    _adaptiveCacheSize->setHintToolTip( tr("When checked, the memory the cache keeps in RAM follows the memory available on the system: "
+                                           "the images in RAM and the cache in memory (see the --ram-cache command line option) grow up to "
+                                           "the Maximum RAM Cache Size while other processes leave memory unused, "
+                                           "and shrink down to the Minimum Adaptive Cache Size when they need it. "
+                                           "The cache on disk is only bounded by the Maximum Disk Cache Size. "
+                                           "This is useful on machines shared with other jobs, such as render farm nodes. "
+                                           "Changes of the cache size are written to the error log.") );
+    _adaptiveCacheSize->setDefaultValue(false);
+
+    _cachingTab->addKnob(_adaptiveCacheSize);
+
+    _minAdaptiveCacheSizeGb = AppManager::createKnob<KnobInt>( thisShared, tr("Minimum Adaptive Cache Size (GiB)") );
+    _minAdaptiveCacheSizeGb->setName("minAdaptiveCacheSizeGb");
+    _minAdaptiveCacheSizeGb->disableSlider();
+    _minAdaptiveCacheSizeGb->setRange(0, INT_MAX);
+    _minAdaptiveCacheSizeGb->setHintToolTip( tr("When the cache size adapts to the memory pressure, the cache is never shrunk below this size (in GiB).") );
+    _minAdaptiveCacheSizeGb->setDefaultValue(1);
+
+    _cachingTab->addKnob(_minAdaptiveCacheSizeGb);
+
+    _cacheTileSize = AppManager::createKnob<KnobChoice>( thisShared, tr("Cache Tile Size") );
+    _cacheTileSize->setName("cacheTileSize");
+    {
+        std::vector<ChoiceOption> entries;
+        for (int po2 = NATRON_8BIT_TILE_SIZE_PO2_MIN; po2 <= NATRON_8BIT_TILE_SIZE_PO2_MAX; ++po2) {
+            int tileSizePx = 1 << po2;
+            int tileSizeKb = tileSizePx * tileSizePx / 1024;
+            QString label = tileSizeKb < 1024 ? tr("%1x%1 (%2 KiB)").arg(tileSizePx).arg(tileSizeKb) : tr("%1x%1 (%2 MiB)").arg(tileSizePx).arg(tileSizeKb / 1024);
+            entries.push_back( ChoiceOption(label.toStdString(), "", "") );
+        }
+        _cacheTileSize->populateChoices(entries);
+    }
+    _cacheTileSize->setHintToolTip( tr("The size of the image tiles stored in the cache, in pixels for an 8-bit image. "
+                                       "16-bit tiles have half the height and 32-bit tiles half the width and height so that "
+                                       "all tiles take the same amount of memory.\n"
+                                       "Larger tiles reduce the cache bookkeeping when rendering large images, at the expense of memory "
+                                       "wasted on the image borders.\n"
+                                       "Each tile size has its own cache on disk.") );
+    _cacheTileSize->setDefaultValue(NATRON_8BIT_TILE_SIZE_PO2 - NATRON_8BIT_TILE_SIZE_PO2_MIN);
+    knobsRequiringRestart.insert(_cacheTileSize);
+
+    _cachingTab->addKnob(_cacheTileSize);
+
+    _cacheEvictionPolicy = AppManager::createKnob<KnobChoice>( thisShared, tr("Cache Eviction Policy") );
+    _cacheEvictionPolicy->setName("cacheEvictionPolicy");
+    {
+        std::vector<ChoiceOption> entries;
+        assert(entries.size() == (int)eCacheEvictionPolicyLRU);
+        entries.push_back(ChoiceOption("LRU", tr("Least Recently Used").toStdString(), tr("When the cache is full, the entries that were not used for the longest time are evicted first.").toStdString()));
+        assert(entries.size() == (int)eCacheEvictionPolicyCostAware);
+        entries.push_back(ChoiceOption("CostAware", tr("Cost Aware").toStdString(), tr("When the cache is full, amongst the entries that were not used for a long time, those that are the fastest to recompute for the memory they take are evicted first. "
+                                                                                       "For example a tile produced by an expensive filter is kept longer than a tile read from a file.").toStdString()));
+        _cacheEvictionPolicy->populateChoices(entries);
+    }
+    _cacheEvictionPolicy->setHintToolTip( tr("Controls which entries are removed from the cache when it reaches its maximum size.") );
+    _cacheEvictionPolicy->setDefaultValue( (int)eCacheEvictionPolicyLRU );
+
+    _cachingTab->addKnob(_cacheEvictionPolicy);
+
 
     _diskCachePath = AppManager::createKnob<KnobPath>( thisShared, tr("Disk Cache Path (empty = default)") );
     _diskCachePath->setName("diskCachePath");
@@ -2595,6 +2682,21 @@ Settings::onKnobValueChanged(const KnobIPtr& k,
         if (cache) {
             cache->setMaximumCacheSize(eStorageModeRAM, maxRamBytes);
         }
+        appPTR->refreshCacheMemoryGovernor();
+
+    } else if ( k == _imp->_cacheEvictionPolicy ) {
+
+        CachePtr cache = appPTR->getCache();
+        if (cache) {
+            cache->setEvictionPolicy( getCacheEvictionPolicy() );
+        }
+
+    } else if ( k == _imp->_maxCompressedCacheSizeGb ) {
+
+        CachePtr cache = appPTR->getCache();
+        if (cache) {
+            cache->setCompressedTierMaximumSize( getMaximumCompressedCacheSize() );
+        }
 
     } else if ( k == _imp->_maxDiskCacheSizeGb ) {
 
@@ -2604,6 +2706,10 @@ Settings::onKnobValueChanged(const KnobIPtr& k,
             cache->setMaximumCacheSize(eStorageModeDisk, maxDiskBytes);
         }
 
+    } else if ( ( k == _imp->_adaptiveCacheSize ) || ( k == _imp->_minAdaptiveCacheSizeGb ) ) {
+
+        appPTR->refreshCacheMemoryGovernor();
+
     }  else if ( k == _imp->_numberOfThreads ) {
         int nbThreads = _imp->_numberOfThreads->getValue();
 #ifdef DEBUG
@@ -2615,11 +2721,10 @@ Settings::onKnobValueChanged(const KnobIPtr& k,
         if (nbThreads == 0) {
             int idealCount = appPTR->getHardwareIdealThreadCount();
             assert(idealCount > 0);
-            idealCount = std::max(idealCount, 1);
-            QThreadPool::globalInstance()->setMaxThreadCount(idealCount);
-        } else {
-            QThreadPool::globalInstance()->setMaxThreadCount(nbThreads);
+            nbThreads = std::max(idealCount, 1);
         }
+        QThreadPool::globalInstance()->setMaxThreadCount(nbThreads);
+        MultiThread::setNumThreads(nbThreads);
 
     } else if ( k == _imp->_ocioConfigKnob ) {
         if (_imp->_ocioConfigKnob->getActiveEntry().id == NATRON_CUSTOM_OCIO_CONFIG_NAME) {
@@ -2791,13 +2896,43 @@ Settings::isAggressiveCachingEnabled() const
 std::size_t
 Settings::getMaximumDiskCacheSize() const
 {
-    return _imp->_maxDiskCacheSizeGb->getValue() * 1024 * 1024 * 1024;
+    return (std::size_t)_imp->_maxDiskCacheSizeGb->getValue() * 1024 * 1024 * 1024;
 }
 
 std::size_t
 Settings::getMaximumRAMCacheSize() const
 {
-    return _imp->_maxRAMCacheSizeMb->getValue() * 1024 * 1024;
+    return (std::size_t)_imp->_maxRAMCacheSizeMb->getValue() * 1024 * 1024;
+}
+
+std::size_t
+Settings::getMaximumCompressedCacheSize() const
+{
+    return (std::size_t)_imp->_maxCompressedCacheSizeGb->getValue() * 1024 * 1024 * 1024;
+}
+
+bool
+Settings::isAdaptiveCacheSizeEnabled() const
+{
+    return _imp->_adaptiveCacheSize->getValue();
+}
+
+std::size_t
+Settings::getMinimumAdaptiveCacheSize() const
+{
+    return (std::size_t)_imp->_minAdaptiveCacheSizeGb->getValue() * 1024 * 1024 * 1024;
+}
+
+int
+Settings::getCacheTileSizePo2() const
+{
+    return NATRON_8BIT_TILE_SIZE_PO2_MIN + _imp->_cacheTileSize->getValue();
+}
+
+CacheEvictionPolicyEnum
+Settings::getCacheEvictionPolicy() const
+{
+    return (CacheEvictionPolicyEnum)_imp->_cacheEvictionPolicy->getValue();
 }
 
 bool
@@ -2818,6 +2953,18 @@ Settings::setNumberOfThreads(int threadsNb)
     _imp->_numberOfThreads->setValue(threadsNb);
 }
 
+bool
+Settings::isParallelTreeRenderEnabled() const
+{
+    return _imp->_parallelTreeRender->getValue();
+}
+
+void
+Settings::setParallelTreeRenderEnabled(bool enabled)
+{
+    _imp->_parallelTreeRender->setValue(enabled);
+}
+
 bool
 Settings::isAutoPreviewOnForNewProjects() const
 {
@@ -127,12 +127,29 @@ public:
 
     std::size_t getMaximumRAMCacheSize() const;
 
+    std::size_t getMaximumCompressedCacheSize() const;
+
+    bool isAdaptiveCacheSizeEnabled() const;
+
+    std::size_t getMinimumAdaptiveCacheSize() const;
+
+    /**
+     * @brief The size of a 8 bit cache tile is pow(2, getCacheTileSizePo2()) pixels in each dimension.
+     **/
+    int getCacheTileSizePo2() const;
+
+    CacheEvictionPolicyEnum getCacheEvictionPolicy() const;
+
     bool getColorPickerLinear() const;
 
     int getNumberOfThreads() const;
 
     void setNumberOfThreads(int threadsNb);
 
+    bool isParallelTreeRenderEnabled() const;
+
+    void setParallelTreeRenderEnabled(bool enabled);
+
     void populateSystemFonts(const std::vector<std::string>& fonts);
     
     bool doesKnobChangeRequiresRestart(const KnobIPtr& knob);
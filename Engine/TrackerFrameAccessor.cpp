@@ -187,6 +187,9 @@ natronImageToLibMvFloatImageForNComps(const Image::CPUTileData& source,
         case eImageBitDepthShort:
             natronImageToLibMvFloatImageForDepth<doR, doG, doB, srcNComps, unsigned short, 65535>(source, roi, mvImg);
             break;
+        case eImageBitDepthHalf:
+            natronImageToLibMvFloatImageForDepth<doR, doG, doB, srcNComps, Half, 1>(source, roi, mvImg);
+            break;
         case eImageBitDepthFloat:
             natronImageToLibMvFloatImageForDepth<doR, doG, doB, srcNComps, float, 1>(source, roi, mvImg);
             break;
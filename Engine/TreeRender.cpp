@@ -25,8 +25,13 @@
 
 #include "TreeRender.h"
 
+#include <algorithm>
 #include <set>
+#include <vector>
 #include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+#include <QtCore/QRunnable>
+#include <QtCore/QWaitCondition>
 #include <QMutex>
 #include <QTimer>
 #include <QDebug>
@@ -60,6 +65,388 @@ enum TreeRenderStateEnum
     eTreeRenderStateInitFailed,
 };
 
+/**
+ * @brief A task of the render graph: the render of a node at a given frame/view.
+ * Each task knows which tasks are waiting on its results, so that when it is
+ * done, its results are handed to them and they may be scheduled in turn.
+ **/
+struct TreeRenderTask;
+
+struct TreeRenderTaskDependent
+{
+    // The task that needs the results of this task
+    TreeRenderTask* task;
+
+    // The input number of the dependent task's node on which this task's results are needed
+    int inputNb;
+};
+
+struct TreeRenderTask
+{
+    TreeRenderNodeArgsPtr renderArgs;
+    EffectInstancePtr effect;
+    TimeValue time;
+    ViewIdx view;
+
+    // The region to render, in pixel coordinates
+    RectI roi;
+
+    // The layers requested by all dependents
+    std::list<ImagePlaneDesc> layers;
+
+    // Tasks that need the results of this task
+    std::vector<TreeRenderTaskDependent> dependents;
+
+    // Number of tasks that must be finished before this task can start.
+    // Protected by the TreeRenderTaskQueue lock
+    int nDependenciesLeft;
+
+    TreeRenderTask()
+    : renderArgs()
+    , effect()
+    , time(0)
+    , view(0)
+    , roi()
+    , layers()
+    , dependents()
+    , nDependenciesLeft(0)
+    {
+    }
+};
+
+typedef boost::shared_ptr<TreeRenderTask> TreeRenderTaskPtr;
+
+struct TreeRenderTaskKey
+{
+    TreeRenderNodeArgs* node;
+    TimeValue time;
+    ViewIdx view;
+};
+
+struct TreeRenderTaskKey_Compare
+{
+    bool operator() (const TreeRenderTaskKey& lhs, const TreeRenderTaskKey& rhs) const
+    {
+        if (lhs.node < rhs.node) {
+            return true;
+        } else if (lhs.node > rhs.node) {
+            return false;
+        }
+        if (lhs.time < rhs.time) {
+            return true;
+        } else if (lhs.time > rhs.time) {
+            return false;
+        }
+        return lhs.view < rhs.view;
+    }
+};
+
+typedef std::map<TreeRenderTaskKey, TreeRenderTaskPtr, TreeRenderTaskKey_Compare> TreeRenderTaskMap;
+
+class TreeRenderTaskQueue;
+typedef boost::shared_ptr<TreeRenderTaskQueue> TreeRenderTaskQueuePtr;
+
+/**
+ * @brief Executes the graph of tasks of a render on the global thread-pool.
+ * A task is pushed to the ready list as soon as all the tasks it depends on are finished.
+ * Each thread-pool runnable keeps popping ready tasks until none is left, always taking the most recently
+ * readied task first so that a thread tends to continue on the branch it just rendered.
+ * The thread that launched the render helps executing tasks while it waits.
+ * The root task is never executed by the queue: it is rendered by TreeRender::launchRender once all its dependencies are done.
+ **/
+class TreeRenderTaskQueue
+: public boost::enable_shared_from_this<TreeRenderTaskQueue>
+{
+public:
+
+    TreeRenderTaskQueue(QThread* spawnerThread)
+    : _tasks()
+    , _rootTask(0)
+    , _lock()
+    , _tasksCond()
+    , _readyTasks()
+    , _nTasksLeft(0)
+    , _status(eActionStatusOK)
+    , _spawnerThread(spawnerThread)
+    {
+    }
+
+    /**
+     * @brief Returns the task for the given frame/view of a node, creating it if needed.
+     **/
+    TreeRenderTask* getOrCreateTask(const TreeRenderNodeArgsPtr& renderArgs,
+                                    const EffectInstancePtr& effect,
+                                    TimeValue time,
+                                    ViewIdx view,
+                                    bool* created)
+    {
+        TreeRenderTaskKey key = {renderArgs.get(), time, view};
+        TreeRenderTaskMap::iterator found = _tasks.find(key);
+        if (found != _tasks.end()) {
+            *created = false;
+            return found->second.get();
+        }
+        TreeRenderTaskPtr task(new TreeRenderTask);
+        task->renderArgs = renderArgs;
+        task->effect = effect;
+        task->time = time;
+        task->view = view;
+        _tasks.insert(std::make_pair(key, task));
+        *created = true;
+        return task.get();
+    }
+
+    void setRootTask(TreeRenderTask* task)
+    {
+        _rootTask = task;
+    }
+
+    /**
+     * @brief Returns the number of tasks to execute, excluding the root task
+     **/
+    int getNumTasks() const
+    {
+        return (int)_tasks.size() - 1;
+    }
+
+    /**
+     * @brief Start all tasks that do not have any dependency
+     **/
+    void launchTasks();
+
+    /**
+     * @brief Blocks until all tasks but the root task are finished. The calling thread
+     * executes ready tasks while waiting.
+     **/
+    ActionRetCodeEnum waitForTasks();
+
+    /**
+     * @brief Called by the thread-pool runnables: executes ready tasks until none is left.
+     **/
+    void runTasks();
+
+private:
+
+    bool popReadyTask_locked(TreeRenderTask** task);
+
+    void executeTask(TreeRenderTask* task);
+
+    void onTaskFinished(TreeRenderTask* task, ActionRetCodeEnum stat, const EffectInstance::RenderRoIResults& results);
+
+    void startRunnables(int nRunnables);
+
+    TreeRenderTaskMap _tasks;
+    TreeRenderTask* _rootTask;
+
+    // Protects all members below and the nDependenciesLeft member of each task
+    QMutex _lock;
+
+    // Signaled when a task becomes ready or when all tasks are finished
+    QWaitCondition _tasksCond;
+
+    // Tasks that may start. Used as a stack.
+    std::vector<TreeRenderTask*> _readyTasks;
+
+    // Number of tasks (excluding the root) not finished yet
+    int _nTasksLeft;
+
+    // Set to the first failure code returned by a task
+    ActionRetCodeEnum _status;
+
+    // The thread that launched the render, it holds the TLS of the render
+    QThread* _spawnerThread;
+};
+
+class TreeRenderTaskRunnable
+: public QRunnable
+{
+public:
+
+    TreeRenderTaskRunnable(const TreeRenderTaskQueuePtr& queue)
+    : QRunnable()
+    , _queue(queue)
+    {
+    }
+
+    virtual ~TreeRenderTaskRunnable()
+    {
+    }
+
+private:
+
+    virtual void run() OVERRIDE FINAL
+    {
+        _queue->runTasks();
+    }
+
+    TreeRenderTaskQueuePtr _queue;
+};
+
+void
+TreeRenderTaskQueue::startRunnables(int nRunnables)
+{
+    TreeRenderTaskQueuePtr thisShared = shared_from_this();
+    for (int i = 0; i < nRunnables; ++i) {
+        QThreadPool::globalInstance()->start(new TreeRenderTaskRunnable(thisShared));
+    }
+}
+
+void
+TreeRenderTaskQueue::launchTasks()
+{
+    int nReadyTasks;
+    {
+        QMutexLocker k(&_lock);
+        _nTasksLeft = getNumTasks();
+        for (TreeRenderTaskMap::const_iterator it = _tasks.begin(); it != _tasks.end(); ++it) {
+            if (it->second.get() != _rootTask && it->second->nDependenciesLeft == 0) {
+                _readyTasks.push_back(it->second.get());
+            }
+        }
+        nReadyTasks = (int)_readyTasks.size();
+    }
+
+    // The spawner thread takes one of the tasks in waitForTasks()
+    startRunnables(nReadyTasks - 1);
+}
+
+bool
+TreeRenderTaskQueue::popReadyTask_locked(TreeRenderTask** task)
+{
+    if (_readyTasks.empty()) {
+        return false;
+    }
+    *task = _readyTasks.back();
+    _readyTasks.pop_back();
+    return true;
+}
+
+ActionRetCodeEnum
+TreeRenderTaskQueue::waitForTasks()
+{
+    assert(QThread::currentThread() == _spawnerThread);
+    QMutexLocker k(&_lock);
+    while (_nTasksLeft > 0) {
+        TreeRenderTask* task;
+        if (popReadyTask_locked(&task)) {
+            k.unlock();
+            executeTask(task);
+            k.relock();
+            continue;
+        }
+        _tasksCond.wait(&_lock);
+    }
+    return _status;
+}
+
+void
+TreeRenderTaskQueue::runTasks()
+{
+    QThread* thisThread = QThread::currentThread();
+    const bool isSpawnedThread = thisThread != _spawnerThread;
+
+    // This thread doesn't have any TLS set but the effects need the render set in the TLS
+    // of the spawner thread. It will be copied whenever it will be accessed.
+    if (isSpawnedThread) {
+        appPTR->getAppTLS()->softCopy(_spawnerThread, thisThread);
+    }
+
+    for (;;) {
+        TreeRenderTask* task;
+        {
+            QMutexLocker k(&_lock);
+            if (!popReadyTask_locked(&task)) {
+                break;
+            }
+        }
+        executeTask(task);
+    }
+
+    if (isSpawnedThread) {
+        appPTR->getAppTLS()->cleanupTLSForThread();
+    }
+}
+
+void
+TreeRenderTaskQueue::executeTask(TreeRenderTask* task)
+{
+    EffectInstance::RenderRoIResults results;
+    ActionRetCodeEnum stat;
+    {
+        QMutexLocker k(&_lock);
+        stat = _status;
+    }
+
+    // Once a task failed, remaining tasks are only flagged finished so that the render can return
+    if (!isFailureRetCode(stat)) {
+        if (task->renderArgs->isRenderAborted()) {
+            stat = eActionStatusAborted;
+        } else {
+            TreeRenderPtr render = task->renderArgs->getParentRender();
+            boost::scoped_ptr<EffectInstance::RenderRoIArgs> args(new EffectInstance::RenderRoIArgs(task->time,
+                                                                                                      task->view,
+                                                                                                      task->roi,
+                                                                                                      render->getProxyScale(),
+                                                                                                      render->getMipMapLevel(),
+                                                                                                      task->layers,
+                                                                                                      task->renderArgs));
+            try {
+                stat = task->effect->renderRoI(*args, &results);
+            } catch (const std::bad_alloc&) {
+                stat = eActionStatusOutOfMemory;
+            } catch (...) {
+                stat = eActionStatusFailed;
+            }
+        }
+    }
+    onTaskFinished(task, stat, results);
+}
+
+void
+TreeRenderTaskQueue::onTaskFinished(TreeRenderTask* task,
+                                    ActionRetCodeEnum stat,
+                                    const EffectInstance::RenderRoIResults& results)
+{
+    // Hold a pointer to the results on each dependent until it has rendered, so that it does not render them again
+    // and does not need to fetch them from the cache.
+    if (!isFailureRetCode(stat)) {
+        for (std::vector<TreeRenderTaskDependent>::const_iterator it = task->dependents.begin(); it != task->dependents.end(); ++it) {
+            FrameViewRequestPtr request = it->task->renderArgs->getFrameViewRequest(it->task->time, it->task->view);
+            if (request) {
+                request->appendPreRenderedInputs(it->inputNb, task->time, task->view, results.outputPlanes, results.distortionStack);
+            }
+        }
+    }
+
+    int nNewReadyTasks = 0;
+    bool finished;
+    {
+        QMutexLocker k(&_lock);
+        if (isFailureRetCode(stat) && !isFailureRetCode(_status)) {
+            _status = stat;
+        }
+        for (std::vector<TreeRenderTaskDependent>::const_iterator it = task->dependents.begin(); it != task->dependents.end(); ++it) {
+            assert(it->task->nDependenciesLeft > 0);
+            --it->task->nDependenciesLeft;
+            if (it->task->nDependenciesLeft == 0 && it->task != _rootTask) {
+                _readyTasks.push_back(it->task);
+                ++nNewReadyTasks;
+            }
+        }
+        --_nTasksLeft;
+        finished = _nTasksLeft == 0;
+    }
+
+    if (finished || nNewReadyTasks > 0) {
+        _tasksCond.wakeAll();
+    }
+
+    // The current thread continues with one of the new tasks, other threads of the pool take the rest
+    if (nNewReadyTasks > 1) {
+        startRunnables(nNewReadyTasks - 1);
+    }
+}
+
 struct TreeRenderPrivate
 {
 
@@ -186,7 +573,13 @@ struct TreeRenderPrivate
      **/
     TreeRenderNodeArgsPtr buildRenderTreeRecursive(const NodePtr& node, std::set<NodePtr>* visitedNodes);
 
-   
+    /**
+     * @brief Builds the graph of render tasks from the results of the getFramesNeeded action, starting from the root node.
+     * If the tree does not have any independent branches that could render concurrently, the queue is not created
+     * and the tree should be rendered recursively by renderRoI.
+     **/
+    ActionRetCodeEnum buildTaskGraph(const RectI& rootRoI, TreeRenderTaskQueuePtr* queue);
+
 };
 
 
@@ -590,6 +983,83 @@ TreeRenderPrivate::buildRenderTreeRecursive(const NodePtr& node,
 } // buildRenderTreeRecursive
 
 
+ActionRetCodeEnum
+TreeRenderPrivate::buildTaskGraph(const RectI& rootRoI, TreeRenderTaskQueuePtr* queue)
+{
+    TreeRenderTaskQueuePtr graph(new TreeRenderTaskQueue(ownerThread));
+
+    TreeRenderNodeArgsPtr rootArgs = rootNodeRenderArgs.lock();
+    assert(rootArgs);
+
+    bool created;
+    TreeRenderTask* rootTask = graph->getOrCreateTask(rootArgs, treeRoot->getEffectInstance(), time, view, &created);
+    rootTask->roi = rootRoI;
+    rootTask->layers = layers;
+    graph->setRootTask(rootTask);
+
+    bool hasIndependentBranches = false;
+
+    std::list<TreeRenderTask*> tasksToVisit;
+    tasksToVisit.push_back(rootTask);
+    while (!tasksToVisit.empty()) {
+        TreeRenderTask* task = tasksToVisit.front();
+        tasksToVisit.pop_front();
+
+        std::map<int, std::list<ImagePlaneDesc> > neededInputLayers;
+        {
+            GetComponentsResultsPtr results;
+            ActionRetCodeEnum stat = task->effect->getLayersProducedAndNeeded_public(task->time, task->view, task->renderArgs, &results);
+            if (isFailureRetCode(stat)) {
+                return stat;
+            }
+            std::list<ImagePlaneDesc> producedLayers, passThroughLayers;
+            int passThroughInputNb;
+            TimeValue passThroughTime;
+            ViewIdx passThroughView;
+            std::bitset<4> processChannels;
+            bool processAll;
+            results->getResults(&neededInputLayers, &producedLayers, &passThroughLayers, &passThroughInputNb, &passThroughTime, &passThroughView, &processChannels, &processAll);
+        }
+
+        std::vector<InputFrameRequest> inputFrames;
+        {
+            ActionRetCodeEnum stat = task->renderArgs->getInputFramesToRender(task->time, task->view, neededInputLayers, &inputFrames);
+            if (isFailureRetCode(stat)) {
+                return stat;
+            }
+        }
+
+        std::set<TreeRenderTask*> inputTasks;
+        for (std::vector<InputFrameRequest>::const_iterator it = inputFrames.begin(); it != inputFrames.end(); ++it) {
+            TreeRenderTask* inputTask = graph->getOrCreateTask(it->inputRenderArgs, it->inputEffect, it->time, it->view, &created);
+            if (created) {
+                inputTask->roi = it->roi;
+                tasksToVisit.push_back(inputTask);
+            } else {
+                inputTask->roi.merge(it->roi);
+            }
+            for (std::list<ImagePlaneDesc>::const_iterator it2 = it->layers.begin(); it2 != it->layers.end(); ++it2) {
+                if (std::find(inputTask->layers.begin(), inputTask->layers.end(), *it2) == inputTask->layers.end()) {
+                    inputTask->layers.push_back(*it2);
+                }
+            }
+
+            TreeRenderTaskDependent dependent = {task, it->inputNb};
+            inputTask->dependents.push_back(dependent);
+            ++task->nDependenciesLeft;
+            inputTasks.insert(inputTask);
+        }
+        if (inputTasks.size() > 1) {
+            hasIndependentBranches = true;
+        }
+    }
+
+    if (hasIndependentBranches) {
+        *queue = graph;
+    }
+    return eActionStatusOK;
+} // buildTaskGraph
+
 void
 TreeRenderPrivate::init(const TreeRender::CtorArgsPtr& inArgs, const TreeRenderPtr& publicInterface)
 {
@@ -725,6 +1195,21 @@ TreeRender::launchRender(std::map<ImagePlaneDesc, ImagePtr>* outputPlanes)
                                                                                                      _imp->layers,
                                                                                                      rootNodeRenderArgs));
     
+    // Render all nodes upstream of the root as a graph of tasks, so that independent branches render concurrently.
+    // The root then finds its input images pre-rendered.
+    if (appPTR->getCurrentSettings()->isParallelTreeRenderEnabled()) {
+        TreeRenderTaskQueuePtr queue;
+        ActionRetCodeEnum stat = _imp->buildTaskGraph(pixelRoI, &queue);
+        if (!isFailureRetCode(stat) && queue) {
+            queue->launchTasks();
+            stat = queue->waitForTasks();
+        }
+        if (isFailureRetCode(stat)) {
+            appPTR->getAppTLS()->cleanupTLSForThread();
+            return stat;
+        }
+    }
+
     EffectInstance::RenderRoIResults results;
     ActionRetCodeEnum stat = eActionStatusFailed;
     try {
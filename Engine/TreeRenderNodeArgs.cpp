@@ -1075,12 +1075,11 @@ preRenderFrameFunctor(const PreRenderFrame& args)
 }
 
 ActionRetCodeEnum
-TreeRenderNodeArgs::preRenderInputImages(TimeValue time,
-                                         ViewIdx view,
-                                         const std::map<int, std::list<ImagePlaneDesc> >& neededInputLayers)
+TreeRenderNodeArgs::getInputFramesToRender(TimeValue time,
+                                           ViewIdx view,
+                                           const std::map<int, std::list<ImagePlaneDesc> >& neededInputLayers,
+                                           std::vector<InputFrameRequest>* inputFrames)
 {
-    // For all frames/views needed, recurse on inputs with the appropriate RoI
-
     NodePtr node = getNode();
     EffectInstancePtr effect = node->getEffectInstance();
 
@@ -1100,8 +1099,6 @@ TreeRenderNodeArgs::preRenderInputImages(TimeValue time,
 
     const RenderScale& renderCombinedScale = getParentRender()->getProxyMipMapScale();
 
-    std::vector<PreRenderFrame> preRenderFrames;
-
     for (FramesNeededMap::const_iterator it = framesNeeded.begin(); it != framesNeeded.end(); ++it) {
 
         int inputNb = it->first;
@@ -1116,6 +1113,9 @@ TreeRenderNodeArgs::preRenderInputImages(TimeValue time,
 
 
         TreeRenderNodeArgsPtr inputRenderArgs = getInputRenderArgs(inputNb);
+        if (!inputRenderArgs) {
+            continue;
+        }
 
         ///There cannot be frames needed without components needed.
         std::map<int, std::list<ImagePlaneDesc> >::const_iterator foundCompsNeeded = neededInputLayers.find(inputNb);
@@ -1130,78 +1130,120 @@ TreeRenderNodeArgs::preRenderInputImages(TimeValue time,
         double inputPar = inputEffect->getAspectRatio(inputRenderArgs, -1);
         bool inputIsContinuous = inputEffect->canRenderContinuously(inputRenderArgs);
 
-        {
+        // For all views requested in input
+        for (FrameRangesMap::const_iterator viewIt = it->second.begin(); viewIt != it->second.end(); ++viewIt) {
+
+            // For all ranges in this view
+            for (U32 range = 0; range < viewIt->second.size(); ++range) {
 
+                int nbFramesPreFetched = 0;
 
-            // For all views requested in input
-            for (FrameRangesMap::const_iterator viewIt = it->second.begin(); viewIt != it->second.end(); ++viewIt) {
+                // If the range bounds are no integers and the range covers more than 1 frame (min != max),
+                // we have no clue of the interval we should use between the min and max.
+                if (viewIt->second[range].min != viewIt->second[range].max && viewIt->second[range].min != (int)viewIt->second[range].min) {
+                    qDebug() << "WARNING:" <<  effect->getScriptName_mt_safe().c_str() << "is requesting a non integer frame range [" << viewIt->second[range].min << ","
+                    << viewIt->second[range].max <<"], this is border-line and not specified if this is supported by OpenFX. Natron will render "
+                    "this range assuming an interval of 1 between frame times.";
+                }
 
-                // For all ranges in this view
-                for (U32 range = 0; range < viewIt->second.size(); ++range) {
 
-                    int nbFramesPreFetched = 0;
+                // For all frames in the range
+                for (double f = viewIt->second[range].min; f <= viewIt->second[range].max; f += 1.) {
 
-                    // If the range bounds are no integers and the range covers more than 1 frame (min != max),
-                    // we have no clue of the interval we should use between the min and max.
-                    if (viewIt->second[range].min != viewIt->second[range].max && viewIt->second[range].min != (int)viewIt->second[range].min) {
-                        qDebug() << "WARNING:" <<  effect->getScriptName_mt_safe().c_str() << "is requesting a non integer frame range [" << viewIt->second[range].min << ","
-                        << viewIt->second[range].max <<"], this is border-line and not specified if this is supported by OpenFX. Natron will render "
-                        "this range assuming an interval of 1 between frame times.";
+                    // Sanity check
+                    if (nbFramesPreFetched >= NATRON_MAX_FRAMES_NEEDED_PRE_FETCHING) {
+                        break;
                     }
 
+                    TimeValue inputTime(f);
+                    {
+                        int roundedInputTime = std::floor(f + 0.5);
+                        if (roundedInputTime != inputTime && !inputIsContinuous) {
+                            inputTime = TimeValue(roundedInputTime);
+                        }
+                    }
 
-                    // For all frames in the range
-                    for (double f = viewIt->second[range].min; f <= viewIt->second[range].max; f += 1.) {
+                    // Use the final roi (merged from all branches leading to that node) for that frame/view pair
+                    RectD roi;
+                    inputRenderArgs->getFrameViewCanonicalRoI(inputTime, viewIt->first, &roi);
 
-                        // Sanity check
-                        if (nbFramesPreFetched >= NATRON_MAX_FRAMES_NEEDED_PRE_FETCHING) {
-                            break;
-                        }
+                    if (roi.isNull()) {
+                        continue;
+                    }
 
-                        TimeValue inputTime(f);
-                        {
-                            int roundedInputTime = std::floor(f + 0.5);
-                            if (roundedInputTime != inputTime && !inputIsContinuous) {
-                                inputTime = TimeValue(roundedInputTime);
-                            }
-                        }
+                    InputFrameRequest request;
+                    request.inputNb = inputNb;
+                    request.inputEffect = inputEffect;
+                    request.inputRenderArgs = inputRenderArgs;
+                    request.time = inputTime;
+                    request.view = viewIt->first;
+                    roi.toPixelEnclosing(renderCombinedScale, inputPar, &request.roi);
+                    request.layers = foundCompsNeeded->second;
+                    inputFrames->push_back(request);
 
-                        // Use the final roi (merged from all branches leading to that node) for that frame/view pair
-                        RectD roi;
-                        inputRenderArgs->getFrameViewCanonicalRoI(inputTime, viewIt->first, &roi);
+                    ++nbFramesPreFetched;
 
-                        if (roi.isNull()) {
-                            continue;
-                        }
+                } // for all frames
 
-                        RectI inputRoIPixelCoords;
-                        roi.toPixelEnclosing(renderCombinedScale, inputPar, &inputRoIPixelCoords);
+            } // for all ranges
+        } // for all views
+    } // for all inputs
+
+    return eActionStatusOK;
+} // getInputFramesToRender
 
-                        {
-                            boost::shared_ptr<EffectInstance::RenderRoIArgs> renderArgs;
-                            renderArgs.reset( new EffectInstance::RenderRoIArgs);
+ActionRetCodeEnum
+TreeRenderNodeArgs::preRenderInputImages(TimeValue time,
+                                         ViewIdx view,
+                                         const std::map<int, std::list<ImagePlaneDesc> >& neededInputLayers)
+{
+    // For all frames/views needed, recurse on inputs with the appropriate RoI
 
-                            renderArgs->time = inputTime;
-                            renderArgs->view = viewIt->first;
-                            renderArgs->roi =  inputRoIPixelCoords;
-                            renderArgs->components = foundCompsNeeded->second;
-                            renderArgs->renderArgs = inputRenderArgs;
+    EffectInstancePtr effect = getNode()->getEffectInstance();
 
-                            PreRenderFrame preRender;
-                            preRender.caller = effect;
-                            preRender.inputNb = inputNb;
-                            preRender.renderArgs = renderArgs;
-                            preRenderFrames.push_back(preRender);
-                        }
+    std::vector<InputFrameRequest> inputFrames;
+    {
+        ActionRetCodeEnum stat = getInputFramesToRender(time, view, neededInputLayers, &inputFrames);
+        if (isFailureRetCode(stat)) {
+            return stat;
+        }
+    }
 
-                        ++nbFramesPreFetched;
+    FrameViewRequestPtr thisFrameViewRequest = getFrameViewRequest(time, view);
 
-                    } // for all frames
+    std::vector<PreRenderFrame> preRenderFrames;
+    for (std::vector<InputFrameRequest>::const_iterator it = inputFrames.begin(); it != inputFrames.end(); ++it) {
+
+        // If the input image was already rendered ahead of this node (e.g: by the TreeRender scheduler)
+        // do not render it again.
+        if (thisFrameViewRequest) {
+            std::map<ImagePlaneDesc, ImagePtr> alreadyRenderedPlanes;
+            std::list<ImagePlaneDesc> planesLeftToRender;
+            Distortion2DStackPtr distortionStack;
+            thisFrameViewRequest->getPreRenderedInputs(it->inputNb, it->time, it->view, it->roi, it->layers, &alreadyRenderedPlanes, &planesLeftToRender, &distortionStack);
+            if (planesLeftToRender.empty() && alreadyRenderedPlanes.size() == it->layers.size()) {
+                continue;
+            }
+        }
 
-                } // for all ranges
-            } // for all views
-        } // EffectInstance::NotifyInputNRenderingStarted_RAII
-    } // for all inputs
+        boost::shared_ptr<EffectInstance::RenderRoIArgs> renderArgs;
+        renderArgs.reset( new EffectInstance::RenderRoIArgs);
+
+        renderArgs->time = it->time;
+        renderArgs->view = it->view;
+        renderArgs->roi = it->roi;
+        renderArgs->proxyScale = getParentRender()->getProxyScale();
+        renderArgs->mipMapLevel = getParentRender()->getMipMapLevel();
+        renderArgs->components = it->layers;
+        renderArgs->renderArgs = it->inputRenderArgs;
+
+        PreRenderFrame preRender;
+        preRender.inputNode = it->inputEffect;
+        preRender.caller = effect;
+        preRender.inputNb = it->inputNb;
+        preRender.renderArgs = renderArgs;
+        preRenderFrames.push_back(preRender);
+    }
 
 
     if (preRenderFrames.empty()) {
@@ -1241,9 +1283,6 @@ TreeRenderNodeArgs::preRenderInputImages(TimeValue time,
     }
 
     // Append the pre-rendered input images to the frame view request.
-
-    FrameViewRequestPtr thisFrameViewRequest = getFrameViewRequest(time, view);
-
     for (std::vector<PreRenderResult>::const_iterator it = allResults.begin(); it != allResults.end(); ++it) {
 
         // If a pre-render failed, fail all the render
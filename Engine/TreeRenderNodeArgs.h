@@ -30,6 +30,7 @@
 #include <set>
 #include <map>
 #include <list>
+#include <vector>
 #include <cmath>
 
 #if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
@@ -41,6 +42,7 @@
 
 #include "Engine/EffectInstanceActionResults.h"
 #include "Engine/RectD.h"
+#include "Engine/RectI.h"
 #include "Engine/ViewIdx.h"
 #include "Engine/TimeValue.h"
 
@@ -243,6 +245,30 @@ private:
 
 typedef std::map<FrameViewPair, boost::shared_ptr<FrameViewRequest>, FrameView_compare_less> NodeFrameViewRequestData;
 
+/**
+ * @brief Describes a single input image that must be rendered before a node can render a frame/view.
+ * This is computed from the results of the getFramesNeeded action and the final RoI of the input.
+ **/
+struct InputFrameRequest
+{
+    // The input number on the node requesting the image
+    int inputNb;
+
+    // The input effect and its render args for this render
+    EffectInstancePtr inputEffect;
+    TreeRenderNodeArgsPtr inputRenderArgs;
+
+    // The frame/view to render on the input
+    TimeValue time;
+    ViewIdx view;
+
+    // The region to render in pixel coordinates, at the render combined scale
+    RectI roi;
+
+    // The layers needed on the input
+    std::list<ImagePlaneDesc> layers;
+};
+
 
 /**
  * @brief Render-local arguments given to render a frame by the tree.
@@ -405,9 +431,19 @@ public:
                                       const EffectInstancePtr& caller);
 
 
+    /**
+     * @brief Returns all input images that must be rendered before this node can render the given frame/view.
+     * This uses the results of getFramesNeeded and the final RoI computed by roiVisitFunctor on each input.
+     **/
+    ActionRetCodeEnum getInputFramesToRender(TimeValue time,
+                                             ViewIdx view,
+                                             const std::map<int, std::list<ImagePlaneDesc> >& neededInputLayers,
+                                             std::vector<InputFrameRequest>* inputFrames);
+
     /**
      * @brief Recurse on inputs of the current node using the results of getFramesNeeded
      * and call renderRoI.
+     * Input images that were already pre-rendered (e.g: by the TreeRender scheduler) are not rendered again.
      **/
     ActionRetCodeEnum preRenderInputImages(TimeValue time,
                                            ViewIdx view,
@@ -214,6 +214,7 @@ void
 ViewerInstance::addSupportedBitDepth(std::list<ImageBitDepthEnum>* depths) const
 {
     depths->push_back(eImageBitDepthFloat);
+    depths->push_back(eImageBitDepthHalf);
     depths->push_back(eImageBitDepthShort);
     depths->push_back(eImageBitDepthByte);
 }
@@ -843,6 +844,7 @@ findAutoContrastVminVmax(const Image::CPUTileData& colorImage,
         case eImageBitDepthFloat:
             return findAutoContrastVminVmaxForDepth<float, 1>(colorImage, renderArgs, channels, roi);
         case eImageBitDepthHalf:
+            return findAutoContrastVminVmaxForDepth<Half, 1>(colorImage, renderArgs, channels, roi);
         case eImageBitDepthNone:
             return MinMaxVal(0,0);
         case eImageBitDepthShort:
@@ -1156,7 +1158,7 @@ applyViewerProcess8bit(const RenderViewerArgs& args, const RectI & roi)
             applyViewerProcess8bitForDepth<unsigned short, 65535>(args, roi);
             break;
         case eImageBitDepthHalf:
-            assert(false);
+            applyViewerProcess8bitForDepth<Half, 1>(args, roi);
             break;
         case eImageBitDepthNone:
             break;
@@ -1285,7 +1287,7 @@ applyViewerProcess32bit(const RenderViewerArgs& args, const RectI & roi)
             applyViewerProcess32bitForDepth<unsigned short, 65535>(args, roi);
             break;
         case eImageBitDepthHalf:
-            assert(false);
+            applyViewerProcess32bitForDepth<Half, 1>(args, roi);
             break;
         case eImageBitDepthNone:
             break;
@@ -1421,7 +1423,7 @@ ViewerInstance::render(const RenderActionArgs& args)
 
     {
         Image::Tile dstTile;
-        dstImage->getTileAt(0, &dstTile);
+        dstImage->getTileAt(0, &dstTile, false /*readOnly*/);
         dstImage->getCPUTileData(dstTile, &renderViewerArgs.dstImage);
     }
 
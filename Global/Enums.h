@@ -539,6 +539,27 @@ enum CacheAccessModeEnum
     eCacheAccessModeWriteOnly
 };
 
+enum CacheEvictionPolicyEnum
+{
+    // Evict the least recently used entries first
+    eCacheEvictionPolicyLRU = 0,
+
+    // Evict first the entries that are the cheapest to recompute per byte, amongst
+    // the least recently used ones (GreedyDual-Size)
+    eCacheEvictionPolicyCostAware
+};
+
+enum CacheBackendEnum
+{
+    // Entries are stored in memory-mapped files in the cache directory: the cache is shared
+    // with other Natron processes and persists on disk across sessions
+    eCacheBackendMappedFiles = 0,
+
+    // Entries are stored in anonymous memory private to the process, backed by huge pages when possible:
+    // nothing is written to disk and the cache is lost when the process exits
+    eCacheBackendAnonymousMemory
+};
+
 enum ImageBufferLayoutEnum
 {
     // This will make an image with an internal storage composed
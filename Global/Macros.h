@@ -264,6 +264,9 @@ NATRON_VERSION_STRINGIZE__(major, minor)
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 #define NATRON_PATH_ENV_VAR "NATRON_PLUGIN_PATH"
+
+// When set to 1, hashes are computed with CRC64 like older versions did, to keep the keys of an existing disk cache
+#define NATRON_CRC64_HASH_ENV_VAR "NATRON_CRC64_HASH"
 #define NATRON_IMAGES_PATH ":/Resources/Images/"
 #define NATRON_APPLICATION_ICON_PATH NATRON_IMAGES_PATH "natronIcon256_linux.png"
 
@@ -3159,6 +3159,14 @@ ViewerGL::getColorAt(double x,
                                                                   dstColorSpace,
                                                                   r, g, b, a);
             break;
+        case eImageBitDepthHalf:
+            gotval = getColorAtSinglePixel<Half, 1>(imageData,
+                                                    xPixel, yPixel,
+                                                    forceLinear,
+                                                    srcColorSpace,
+                                                    dstColorSpace,
+                                                    r, g, b, a);
+            break;
         case eImageBitDepthFloat:
             gotval = getColorAtSinglePixel<float, 1>(imageData,
                                                      xPixel, yPixel,
@@ -3336,10 +3344,12 @@ ViewerGL::getColorAtRect(const RectD &roi, // rectangle in canonical coordinates
         case eImageBitDepthShort:
             getColorAtRectForDepth<unsigned short, 65535>(imageData, roiPixels, forceLinear, srcColorSpace, dstColorSpace, pixelSums);
             break;
+        case eImageBitDepthHalf:
+            getColorAtRectForDepth<Half, 1>(imageData, roiPixels, forceLinear, srcColorSpace, dstColorSpace, pixelSums);
+            break;
         case eImageBitDepthFloat:
             getColorAtRectForDepth<float, 1>(imageData, roiPixels, forceLinear, srcColorSpace, dstColorSpace, pixelSums);
             break;
-        case eImageBitDepthHalf:
         case eImageBitDepthNone:
             break;
     }
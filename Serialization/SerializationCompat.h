@@ -709,7 +709,13 @@ template<class Archive>
 void NATRON_NAMESPACE::Curve::serialize(Archive & ar, const unsigned int /*version*/)
 {
     QMutexLocker k(&_imp->_lock);
-    ar & ::boost::serialization::make_nvp("KeyFrameSet", _imp->keyFrames);
+    KeyFrameSet keyFrames = _imp->keyFrames;
+    ar & ::boost::serialization::make_nvp("KeyFrameSet", keyFrames);
+    if (Archive::is_loading::value) {
+        // Go through CurvePrivate so that the snapshot of the curve is updated
+        _imp->setKeyFrames(keyFrames);
+        _imp->publishSnapshot();
+    }
 }
 
 
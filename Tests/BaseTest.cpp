@@ -24,11 +24,20 @@
 
 #include "Global/Macros.h"
 
+#include <algorithm>
 #include <cstdlib>
+#include <cstring> // memset
+#include <fstream>
+#include <map>
+#include <set>
+#include <vector>
 
 #include "BaseTest.h"
 
+#include <QtCore/QAtomicInt>
+#include <QtCore/QDir>
 #include <QtCore/QFile>
+#include <QtCore/QMutex>
 
 // ofxhPropertySuite.h:565:37: warning: 'this' pointer cannot be null in well-defined C++ code; comparison may be assumed to always evaluate to true [-Wtautological-undefined-compare]
 CLANG_DIAG_OFF(unknown-pragmas)
@@ -42,18 +51,27 @@ CLANG_DIAG_OFF(tautological-undefined-compare) // appeared in clang 3.5
 CLANG_DIAG_ON(tautological-undefined-compare)
 CLANG_DIAG_ON(unknown-pragmas)
 
+#include "Engine/Cache.h"
+#include "Engine/CacheEntryKeyBase.h"
+#include "Engine/CacheStats.h"
 #include "Engine/CreateNodeArgs.h"
 #include "Engine/Node.h"
 #include "Engine/Project.h"
 #include "Engine/AppManager.h"
 #include "Engine/AppInstance.h"
 #include "Engine/KnobTypes.h"
+#include "Engine/MultiThread.h"
 #include "Engine/EffectInstance.h"
+#include "Engine/Image.h"
+#include "Engine/ImagePrivate.h"
+#include "Engine/ImageStorage.h"
 #include "Engine/Plugin.h"
 #include "Engine/Curve.h"
 #include "Engine/CLArgs.h"
 #include "Engine/RenderQueue.h"
 #include "Engine/Settings.h"
+#include "Engine/Timer.h"
+#include "Engine/TreeRender.h"
 #include "Engine/ViewIdx.h"
 
 NATRON_NAMESPACE_USING
@@ -318,3 +336,902 @@ TEST_F(BaseTest, SimpleNodeConnections) {
     disconnectNodes(generator, writer, false);
     connectNodes(generator, writer, 0, true);
 }
+
+static double
+renderTreeWallTime(const NodePtr& treeRoot,
+                   bool parallelTreeRender,
+                   ImagePtr* outputImage)
+{
+    appPTR->getCurrentSettings()->setParallelTreeRenderEnabled(parallelTreeRender);
+
+    TreeRender::CtorArgsPtr args(new TreeRender::CtorArgs);
+    args->time = TimeValue(1.);
+    args->view = ViewIdx(0);
+    args->treeRoot = treeRoot;
+    args->canonicalRoI = 0;
+    args->layers = 0;
+    args->proxyScale = RenderScale(1.);
+    args->mipMapLevel = 0;
+    args->draftMode = false;
+    args->playback = false;
+    // Ensure each node renders, otherwise the second render would just hit the cache
+    args->byPassCache = true;
+
+    TimeLapse timer;
+    TreeRenderPtr render = TreeRender::create(args);
+    std::map<ImagePlaneDesc, ImagePtr> outputPlanes;
+    ActionRetCodeEnum stat = render->launchRender(&outputPlanes);
+    double elapsed = timer.getTimeSinceCreation();
+
+    EXPECT_FALSE( isFailureRetCode(stat) );
+    EXPECT_FALSE( outputPlanes.empty() );
+    if ( isFailureRetCode(stat) || outputPlanes.empty() ) {
+        return elapsed;
+    }
+
+    // Copy the first plane to a packed RGBA float buffer so that both renders can be compared
+    // regardless of the layout of the rendered images
+    const ImagePtr& plane = outputPlanes.begin()->second;
+    Image::InitStorageArgs imgArgs;
+    imgArgs.bounds = plane->getBounds();
+    imgArgs.bufferFormat = eImageBufferLayoutRGBAPackedFullRect;
+    *outputImage = Image::create(imgArgs);
+    Image::CopyPixelsArgs cpyArgs;
+    cpyArgs.roi = imgArgs.bounds;
+    cpyArgs.forceCopyEvenIfBuffersHaveSameLayout = true;
+    (*outputImage)->copyPixels(*plane, cpyArgs);
+
+    return elapsed;
+}
+
+///Benchmark: render a graph of 32 independent generators merged together, with and without the task graph scheduler,
+///and check that both produce the same image
+TEST_F(BaseTest, WideTreeRender)
+{
+    PluginPtr mergePlugin;
+    try {
+        mergePlugin = appPTR->getPluginBinary(QString::fromUtf8(PLUGINID_OFX_MERGE), -1, -1, false);
+    } catch (const std::exception & e) {
+        std::cout << e.what() << std::endl;
+    }
+    ASSERT_TRUE(mergePlugin != NULL);
+
+    Format f(0, 0, 1920, 1080, "HD", 1.);
+    getApp()->getProject()->setOrAddProjectFormat(f);
+
+    const int nBranches = 32;
+    std::vector<NodePtr> branches;
+    for (int i = 0; i < nBranches; ++i) {
+        NodePtr generator = createNode(_generatorPluginID);
+        ASSERT_TRUE(generator);
+        branches.push_back(generator);
+    }
+
+    // Merge the branches 2 by 2 until there is a single node left
+    while (branches.size() > 1) {
+        std::vector<NodePtr> merged;
+        for (std::size_t i = 0; i + 1 < branches.size(); i += 2) {
+            NodePtr merge = createNode( QString::fromUtf8(PLUGINID_OFX_MERGE) );
+            ASSERT_TRUE(merge);
+            connectNodes(branches[i], merge, 0, true);
+            connectNodes(branches[i + 1], merge, 1, true);
+            merged.push_back(merge);
+        }
+        branches = merged;
+    }
+
+    const NodePtr& treeRoot = branches.front();
+
+    const bool wasParallelTreeRenderEnabled = appPTR->getCurrentSettings()->isParallelTreeRenderEnabled();
+    ImagePtr recursiveImage, parallelImage;
+    double recursiveTime = renderTreeWallTime(treeRoot, false, &recursiveImage);
+    double parallelTime = renderTreeWallTime(treeRoot, true, &parallelImage);
+    appPTR->getCurrentSettings()->setParallelTreeRenderEnabled(wasParallelTreeRenderEnabled);
+
+    std::cout << "WideTreeRender (" << nBranches << " branches): recursive " << recursiveTime << " s, task graph " << parallelTime << " s" << std::endl;
+
+    // Both schedulers must produce the same image
+    ASSERT_TRUE(recursiveImage && parallelImage);
+    const RectI& bounds = recursiveImage->getBounds();
+    ASSERT_EQ(bounds, parallelImage->getBounds());
+
+    // Compare every tile of both images
+    const int nTiles = recursiveImage->getNumTiles();
+    ASSERT_EQ( nTiles, parallelImage->getNumTiles() );
+    std::size_t nValues = 0;
+    std::size_t nDifferences = 0;
+    for (int t = 0; t < nTiles; ++t) {
+        Image::Tile recursiveTile, parallelTile;
+        ASSERT_TRUE( recursiveImage->getTileAt(t, &recursiveTile) );
+        ASSERT_TRUE( parallelImage->getTileAt(t, &parallelTile) );
+        Image::CPUTileData recursiveData, parallelData;
+        recursiveImage->getCPUTileData(recursiveTile, &recursiveData);
+        parallelImage->getCPUTileData(parallelTile, &parallelData);
+        ASSERT_EQ(recursiveData.tileBounds, parallelData.tileBounds);
+        ASSERT_EQ(eImageBitDepthFloat, recursiveData.bitDepth);
+        ASSERT_EQ(recursiveData.bitDepth, parallelData.bitDepth);
+        ASSERT_EQ(recursiveData.nComps, parallelData.nComps);
+
+        // A packed buffer holds all the channels, otherwise there is one buffer per channel
+        const bool packed = !recursiveData.ptrs[1];
+        const int nBuffers = packed ? 1 : recursiveData.nComps;
+        const std::size_t nValuesPerBuffer = recursiveData.tileBounds.area() * (packed ? recursiveData.nComps : 1);
+        for (int c = 0; c < nBuffers; ++c) {
+            const float* recursivePixels = (const float*)recursiveData.ptrs[c];
+            const float* parallelPixels = (const float*)parallelData.ptrs[c];
+            ASSERT_TRUE(recursivePixels && parallelPixels);
+            for (std::size_t i = 0; i < nValuesPerBuffer; ++i) {
+                if (recursivePixels[i] != parallelPixels[i]) {
+                    ++nDifferences;
+                }
+            }
+            nValues += nValuesPerBuffer;
+        }
+    }
+    EXPECT_EQ( (std::size_t)bounds.area() * 4, nValues );
+    EXPECT_EQ( (std::size_t)0, nDifferences );
+}
+
+static void
+makeFrameTiles(const CachePtr& cache,
+               U64 nodeHash,
+               const RectI& bounds,
+               std::vector<CacheEntryBasePtr>* entries)
+{
+    const char* channels[4] = { "R", "G", "B", "A" };
+    int tileSizeX, tileSizeY;
+
+    cache->getTileSizePx(eImageBitDepthFloat, &tileSizeX, &tileSizeY);
+    for (int c = 0; c < 4; ++c) {
+        for (int y = bounds.y1; y < bounds.y2; y += tileSizeY) {
+            for (int x = bounds.x1; x < bounds.x2; x += tileSizeX) {
+                CacheImageTileStoragePtr tile( new CacheImageTileStorage(cache) );
+                AllocateMemoryArgs args;
+                args.bitDepth = eImageBitDepthFloat;
+                tile->allocateMemory(args);
+                ImageTileKeyPtr key( new ImageTileKey(nodeHash, TimeValue(1.), ViewIdx(0), channels[c], RenderScale(1.), 0, false, eImageBitDepthFloat, x / tileSizeX, y / tileSizeY) );
+                tile->setKey(key);
+                entries->push_back(tile);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Inserts then looks-up the tiles of nFrames 32-bit RGBA frames of the given bounds.
+ * Returns the number of tiles and the time spent in each operation.
+ **/
+static void
+measureCacheThroughput(const CachePtr& cache,
+                       const RectI& bounds,
+                       int nFrames,
+                       std::size_t* nTiles,
+                       double* insertTime,
+                       double* lookupTime)
+{
+    *nTiles = 0;
+    *insertTime = 0.;
+    *lookupTime = 0.;
+    for (int f = 0; f < nFrames; ++f) {
+        std::vector<CacheEntryBasePtr> computed;
+        makeFrameTiles(cache, f + 1, bounds, &computed);
+        *nTiles += computed.size();
+
+        TimeLapse timer;
+        std::vector<CacheEntryLockerPtr> lockers;
+        cache->getBatch(computed, &lockers);
+        for (std::size_t i = 0; i < lockers.size(); ++i) {
+            EXPECT_EQ(CacheEntryLocker::eCacheEntryStatusMustCompute, lockers[i]->getStatus());
+        }
+        cache->insertBatch(lockers);
+        *insertTime += timer.getTimeElapsedReset();
+        lockers.clear();
+
+        std::vector<CacheEntryBasePtr> lookups;
+        makeFrameTiles(cache, f + 1, bounds, &lookups);
+        timer.getTimeElapsedReset();
+        cache->getBatch(lookups, &lockers);
+        *lookupTime += timer.getTimeElapsedReset();
+        for (std::size_t i = 0; i < lockers.size(); ++i) {
+            EXPECT_EQ(CacheEntryLocker::eCacheEntryStatusCached, lockers[i]->getStatus());
+        }
+    }
+}
+
+static void
+fillTile(const CacheEntryBasePtr& entry,
+         float value)
+{
+    CacheImageTileStoragePtr tile = toCacheImageTileStorage(entry);
+    ASSERT_TRUE(tile);
+    float* data = (float*)tile->getData();
+    std::size_t nPixels = tile->getBufferSize() / sizeof(float);
+    for (std::size_t i = 0; i < nPixels; ++i) {
+        data[i] = value;
+    }
+}
+
+static float
+getTileValue(const CacheEntryBasePtr& entry)
+{
+    CacheImageTileStoragePtr tile = toCacheImageTileStorage(entry);
+    if (!tile) {
+        return -1.f;
+    }
+    return ( (const float*)tile->getData() )[0];
+}
+
+///The batch look-up and insertion give the same results as the look-up and insertion of each entry
+TEST_F(BaseTest, CacheBatchMatchesPerEntry)
+{
+    CachePtr cache = appPTR->getCache();
+    cache->clear();
+
+    int tileSizeX, tileSizeY;
+    cache->getTileSizePx(eImageBitDepthFloat, &tileSizeX, &tileSizeY);
+    const RectI bounds(0, 0, tileSizeX * 4, tileSizeY * 4);
+
+    // Insert half of the tiles one by one and the other half by batch
+    std::vector<CacheEntryBasePtr> computed;
+    makeFrameTiles(cache, 1, bounds, &computed);
+    std::vector<CacheEntryBasePtr> batchComputed;
+    for (std::size_t i = 0; i < computed.size(); ++i) {
+        fillTile(computed[i], (float)i);
+        if (i % 2 == 0) {
+            CacheEntryLockerPtr locker = cache->get(computed[i]);
+            ASSERT_EQ(CacheEntryLocker::eCacheEntryStatusMustCompute, locker->getStatus());
+            locker->insertInCache();
+        } else {
+            batchComputed.push_back(computed[i]);
+        }
+    }
+    {
+        std::vector<CacheEntryLockerPtr> lockers;
+        cache->getBatch(batchComputed, &lockers);
+        ASSERT_EQ(batchComputed.size(), lockers.size());
+        for (std::size_t i = 0; i < lockers.size(); ++i) {
+            ASSERT_EQ(CacheEntryLocker::eCacheEntryStatusMustCompute, lockers[i]->getStatus());
+        }
+        cache->insertBatch(lockers);
+    }
+
+    // Look-up the tiles of the inserted frame and of a frame that is not cached, one by one and by batch
+    for (U64 nodeHash = 1; nodeHash <= 2; ++nodeHash) {
+        std::vector<CacheEntryBasePtr> singleLookups, batchLookups;
+        makeFrameTiles(cache, nodeHash, bounds, &singleLookups);
+        makeFrameTiles(cache, nodeHash, bounds, &batchLookups);
+
+        // The lockers of the tiles that are not cached mark them pending: release them before the other look-up
+        std::vector<CacheEntryLocker::CacheEntryStatusEnum> batchStatus;
+        {
+            std::vector<CacheEntryLockerPtr> batchLockers;
+            cache->getBatch(batchLookups, &batchLockers);
+            ASSERT_EQ(batchLookups.size(), batchLockers.size());
+            for (std::size_t i = 0; i < batchLockers.size(); ++i) {
+                batchStatus.push_back( batchLockers[i]->getStatus() );
+            }
+        }
+
+        for (std::size_t i = 0; i < singleLookups.size(); ++i) {
+            CacheEntryLockerPtr singleLocker = cache->get(singleLookups[i]);
+            EXPECT_EQ(singleLocker->getStatus(), batchStatus[i]);
+            if (nodeHash == 1) {
+                EXPECT_EQ(CacheEntryLocker::eCacheEntryStatusCached, batchStatus[i]);
+                EXPECT_EQ( (float)i, getTileValue(singleLookups[i]) );
+                EXPECT_EQ( (float)i, getTileValue(batchLookups[i]) );
+            }
+        }
+    }
+
+    cache->clear();
+}
+
+///Benchmark: insert then look-up the tiles of a 32-bit RGBA HD frame in caches with different tile sizes
+TEST_F(BaseTest, CacheTileSizeThroughput)
+{
+    const RectI bounds(0, 0, 1920, 1080);
+    const int nFrames = 4;
+
+    for (int tileSizePo2 = NATRON_8BIT_TILE_SIZE_PO2_MIN; tileSizePo2 <= NATRON_8BIT_TILE_SIZE_PO2_MAX; tileSizePo2 += 2) {
+        // Two caches with the same tile size would share the same files and memory segments
+        CachePtr cache = appPTR->getCache();
+        std::size_t tileSizePx = (std::size_t)1 << tileSizePo2;
+        if (cache->getTileSizeBytes() != tileSizePx * tileSizePx) {
+            cache = Cache::create(tileSizePo2);
+        }
+        cache->clear();
+
+        std::size_t nTiles;
+        double insertTime, lookupTime;
+        measureCacheThroughput(cache, bounds, nFrames, &nTiles, &insertTime, &lookupTime);
+
+        double nMegaBytes = nTiles * cache->getTileSizeBytes() / (1024. * 1024.);
+        std::cout << "Cache tile size " << cache->getTileSizeBytes() / 1024 << " KiB: " << nTiles << " tiles, insert " << nMegaBytes / insertTime << " MiB/s, look-up " << nMegaBytes / lookupTime << " MiB/s" << std::endl;
+
+        cache->clear();
+    }
+}
+
+///Benchmark: same workload as a frame-range render on the memory-mapped files cache and on the RAM-only cache.
+///The flush is what the memory-mapped cache does when the process exits.
+TEST_F(BaseTest, CacheBackendThroughput)
+{
+    const RectI bounds(0, 0, 1920, 1080);
+    const int nFrames = 16;
+
+    CachePtr mappedFilesCache = appPTR->getCache();
+    ASSERT_EQ(eCacheBackendMappedFiles, mappedFilesCache->getBackend());
+    CachePtr ramCache = Cache::create(appPTR->getCurrentSettings()->getCacheTileSizePo2(), eCacheBackendAnonymousMemory);
+    ASSERT_EQ(eCacheBackendAnonymousMemory, ramCache->getBackend());
+
+    CachePtr caches[2] = { mappedFilesCache, ramCache };
+    const char* names[2] = { "memory-mapped files", "RAM" };
+    for (int i = 0; i < 2; ++i) {
+        caches[i]->clear();
+
+        std::size_t nTiles;
+        double insertTime, lookupTime;
+        measureCacheThroughput(caches[i], bounds, nFrames, &nTiles, &insertTime, &lookupTime);
+
+        TimeLapse timer;
+        caches[i]->flushCacheOnDisk(false /*async*/);
+        double flushTime = timer.getTimeElapsedReset();
+
+        double nMegaBytes = nTiles * caches[i]->getTileSizeBytes() / (1024. * 1024.);
+        std::cout << "Cache backend " << names[i] << ": " << nTiles << " tiles, insert " << nMegaBytes / insertTime << " MiB/s, look-up " << nMegaBytes / lookupTime << " MiB/s, flush " << flushTime << " s" << std::endl;
+
+        caches[i]->clear();
+    }
+}
+
+///Export the tiles of one node to a pack from the memory-mapped files cache and import them in the RAM-only cache
+TEST_F(BaseTest, CachePackExportImport)
+{
+    const RectI bounds(0, 0, 256, 256);
+
+    CachePtr mappedFilesCache = appPTR->getCache();
+    CachePtr ramCache = Cache::create(appPTR->getCurrentSettings()->getCacheTileSizePo2(), eCacheBackendAnonymousMemory);
+    mappedFilesCache->clear();
+    ramCache->clear();
+
+    // Cache the tiles of 2 nodes, each tile filled with its index
+    std::vector<CacheEntryBasePtr> computed[2];
+    for (int n = 0; n < 2; ++n) {
+        makeFrameTiles(mappedFilesCache, n + 1, bounds, &computed[n]);
+        for (std::size_t i = 0; i < computed[n].size(); ++i) {
+            CacheImageTileStoragePtr tile = boost::dynamic_pointer_cast<CacheImageTileStorage>(computed[n][i]);
+            memset(tile->getData(), (int)i, tile->getBufferSize());
+        }
+        std::vector<CacheEntryLockerPtr> lockers;
+        mappedFilesCache->getBatch(computed[n], &lockers);
+        mappedFilesCache->insertBatch(lockers);
+    }
+
+    // Only export the tiles of the first node
+    std::string packFilePath = QDir::tempPath().toStdString() + "/BaseTest_CachePackExportImport.pack";
+    std::set<U64> nodeHashes;
+    nodeHashes.insert(1);
+    EXPECT_EQ( computed[0].size(), mappedFilesCache->exportPack(packFilePath, nodeHashes, std::vector<RangeD>()) );
+
+    // An empty frame range intersection exports nothing
+    std::string emptyPackFilePath = QDir::tempPath().toStdString() + "/BaseTest_CachePackExportImport_empty.pack";
+    std::vector<RangeD> frameRanges(1);
+    frameRanges[0].min = frameRanges[0].max = 2.;
+    EXPECT_EQ( (std::size_t)0, mappedFilesCache->exportPack(emptyPackFilePath, std::set<U64>(), frameRanges) );
+    EXPECT_EQ( (std::size_t)0, ramCache->importPack(emptyPackFilePath) );
+
+    EXPECT_EQ( computed[0].size(), ramCache->importPack(packFilePath) );
+
+    // Importing again does not insert anything
+    EXPECT_EQ( (std::size_t)0, ramCache->importPack(packFilePath) );
+
+    for (int n = 0; n < 2; ++n) {
+        std::vector<CacheEntryBasePtr> lookups;
+        makeFrameTiles(ramCache, n + 1, bounds, &lookups);
+        std::vector<CacheEntryLockerPtr> lockers;
+        ramCache->getBatch(lookups, &lockers);
+        for (std::size_t i = 0; i < lockers.size(); ++i) {
+            if (n == 0) {
+                ASSERT_EQ(CacheEntryLocker::eCacheEntryStatusCached, lockers[i]->getStatus());
+                CacheImageTileStoragePtr tile = boost::dynamic_pointer_cast<CacheImageTileStorage>(lookups[i]);
+                EXPECT_EQ( (char)i, tile->getData()[0] );
+                EXPECT_EQ( (char)i, tile->getData()[tile->getBufferSize() - 1] );
+            } else {
+                EXPECT_EQ(CacheEntryLocker::eCacheEntryStatusMustCompute, lockers[i]->getStatus());
+            }
+        }
+    }
+
+    // A file that is not a pack is rejected
+    {
+        QFile notAPackFile( QString::fromUtf8( emptyPackFilePath.c_str() ) );
+        ASSERT_TRUE( notAPackFile.open(QIODevice::WriteOnly | QIODevice::Truncate) );
+        notAPackFile.write( QByteArray(1024, 'x') );
+    }
+    EXPECT_THROW( ramCache->importPack(emptyPackFilePath), std::runtime_error );
+
+    QFile::remove( QString::fromUtf8( packFilePath.c_str() ) );
+    QFile::remove( QString::fromUtf8( emptyPackFilePath.c_str() ) );
+    mappedFilesCache->clear();
+    ramCache->clear();
+}
+
+// One access of a recorded cache trace
+struct CacheTraceAccess
+{
+    U64 hash;
+
+    // Time in seconds to compute the entry on a miss
+    double computeCost;
+};
+
+struct CacheTraceReplayStats
+{
+    int nHits, nMisses;
+
+    // Time spent computing the missed entries
+    double recomputeTime;
+
+    // Time that would have been spent computing the entries that were found in the cache
+    double savedTime;
+
+    CacheTraceReplayStats()
+    : nHits(0)
+    , nMisses(0)
+    , recomputeTime(0)
+    , savedTime(0)
+    {
+    }
+};
+
+/**
+ * @brief A playback loop over a comp where each frame needs tiles of a Read node (cheap to recompute)
+ * and of a Defocus node (expensive), with the user scrubbing back to random frames between loops.
+ **/
+static void
+makePlaybackCacheTrace(int nFrames,
+                       int nTilesPerFrame,
+                       std::vector<CacheTraceAccess>* trace)
+{
+    const double readCost = 0.000005, defocusCost = 0.0005;
+
+    srand(2000);
+    for (int loop = 0; loop < 8; ++loop) {
+        for (int f = 0; f < nFrames; ++f) {
+            // coverity[dont_call]
+            int frame = (loop % 2) ? rand() % nFrames : f;
+            for (int t = 0; t < nTilesPerFrame; ++t) {
+                CacheTraceAccess read = { (U64)(frame * nTilesPerFrame + t) << 1, readCost };
+                trace->push_back(read);
+                CacheTraceAccess defocus = { ( (U64)(frame * nTilesPerFrame + t) << 1 ) | 1, defocusCost };
+                trace->push_back(defocus);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Reads a trace recorded as one "hash nBytes computeCost" line per access. Each entry is replayed as a
+ * single tile, so nBytes is ignored. The compute costs are scaled so that the most expensive entry takes 1 ms.
+ **/
+static bool
+readCacheTraceFile(const char* filePath,
+                   std::vector<CacheTraceAccess>* trace)
+{
+    std::ifstream ifile(filePath);
+    if (!ifile) {
+        return false;
+    }
+    CacheTraceAccess access;
+    std::size_t nBytes;
+    double maxCost = 0.;
+    while (ifile >> access.hash >> nBytes >> access.computeCost) {
+        trace->push_back(access);
+        maxCost = std::max(maxCost, access.computeCost);
+    }
+    if (maxCost > 0.001) {
+        for (std::size_t i = 0; i < trace->size(); ++i) {
+            (*trace)[i].computeCost *= 0.001 / maxCost;
+        }
+    }
+
+    return !trace->empty();
+}
+
+static void
+waitComputeCost(double seconds)
+{
+    TimeLapse timer;
+    while (timer.getTimeSinceCreation() < seconds) {
+    }
+}
+
+/**
+ * @brief Replays a trace through a RAM-only cache that can hold maxTiles tiles, with the given eviction policy.
+ * Each access is a look-up. On a miss the entry is computed for its cost, so that the cache records it, then it is inserted.
+ **/
+static void
+replayCacheTrace(CacheEvictionPolicyEnum policy,
+                 const std::vector<CacheTraceAccess>& trace,
+                 std::size_t maxTiles,
+                 CacheTraceReplayStats* stats)
+{
+    CachePtr cache = Cache::create(appPTR->getCurrentSettings()->getCacheTileSizePo2(), eCacheBackendAnonymousMemory);
+    cache->clear();
+    cache->setEvictionPolicy(policy);
+    cache->setMaximumCacheSize( eStorageModeRAM, maxTiles * cache->getTileSizeBytes() );
+
+    for (std::size_t i = 0; i < trace.size(); ++i) {
+        CacheImageTileStoragePtr tile( new CacheImageTileStorage(cache) );
+        AllocateMemoryArgs args;
+        args.bitDepth = eImageBitDepthByte;
+        tile->allocateMemory(args);
+        ImageTileKeyPtr key( new ImageTileKey(trace[i].hash, TimeValue(0.), ViewIdx(0), "R", RenderScale(1.), 0, false, eImageBitDepthByte, 0, 0) );
+        tile->setKey(key);
+
+        CacheEntryLockerPtr locker = cache->get(tile);
+        if (locker->getStatus() == CacheEntryLocker::eCacheEntryStatusCached) {
+            ++stats->nHits;
+            stats->savedTime += trace[i].computeCost;
+            continue;
+        }
+        ASSERT_EQ(CacheEntryLocker::eCacheEntryStatusMustCompute, locker->getStatus());
+        ++stats->nMisses;
+        stats->recomputeTime += trace[i].computeCost;
+        waitComputeCost(trace[i].computeCost);
+        locker->insertInCache();
+        cache->evictLRUEntries(0);
+    }
+    cache->clear();
+}
+
+static void
+replayCacheTraceWithBothPolicies(const std::string& traceName,
+                                 const std::vector<CacheTraceAccess>& trace,
+                                 std::size_t maxTiles,
+                                 CacheTraceReplayStats* lruStats,
+                                 CacheTraceReplayStats* costAwareStats)
+{
+    replayCacheTrace(eCacheEvictionPolicyLRU, trace, maxTiles, lruStats);
+    replayCacheTrace(eCacheEvictionPolicyCostAware, trace, maxTiles, costAwareStats);
+
+    std::cout << traceName << ": " << trace.size() << " accesses" << std::endl;
+    std::cout << "  LRU: hit ratio " << lruStats->nHits / (double)trace.size() << ", recompute time " << lruStats->recomputeTime << " s, saved " << lruStats->savedTime << " s" << std::endl;
+    std::cout << "  Cost aware: hit ratio " << costAwareStats->nHits / (double)trace.size() << ", recompute time " << costAwareStats->recomputeTime << " s, saved " << costAwareStats->savedTime << " s" << std::endl;
+}
+
+///Benchmark: replay access traces through the cache with both eviction policies and report the hit ratio and the recompute time saved
+TEST_F(BaseTest, CacheEvictionPolicyTraceReplay)
+{
+    const int nFrames = 48;
+    const int nTilesPerFrame = 16;
+    std::vector<CacheTraceAccess> trace;
+    makePlaybackCacheTrace(nFrames, nTilesPerFrame, &trace);
+
+    // Only half of the tiles fit in the cache
+    const std::size_t maxTiles = nFrames * nTilesPerFrame;
+    CacheTraceReplayStats lruStats, costAwareStats;
+    replayCacheTraceWithBothPolicies("Playback trace", trace, maxTiles, &lruStats, &costAwareStats);
+
+    EXPECT_EQ( (int)trace.size(), lruStats.nHits + lruStats.nMisses );
+    EXPECT_EQ( (int)trace.size(), costAwareStats.nHits + costAwareStats.nMisses );
+    EXPECT_GT(costAwareStats.savedTime, lruStats.savedTime);
+    EXPECT_LT(costAwareStats.recomputeTime, lruStats.recomputeTime);
+
+    // A trace recorded from a real session may be given with the NATRON_CACHE_TRACE_FILE environment variable
+    const char* traceFile = std::getenv("NATRON_CACHE_TRACE_FILE");
+    if (traceFile) {
+        std::vector<CacheTraceAccess> recordedTrace;
+        ASSERT_TRUE( readCacheTraceFile(traceFile, &recordedTrace) ) << traceFile;
+        CacheTraceReplayStats recordedLruStats, recordedCostAwareStats;
+        replayCacheTraceWithBothPolicies(traceFile, recordedTrace, maxTiles, &recordedLruStats, &recordedCostAwareStats);
+    }
+}
+
+///The mipmaps of a cached tile are computed once, kept in the cache and removed with the tile
+TEST_F(BaseTest, CacheTileMipMaps)
+{
+    CachePtr cache = Cache::create(appPTR->getCurrentSettings()->getCacheTileSizePo2(), eCacheBackendAnonymousMemory);
+    int tileSizeX, tileSizeY;
+    cache->getTileSizePx(eImageBitDepthFloat, &tileSizeX, &tileSizeY);
+
+    std::vector<CacheEntryBasePtr> tiles;
+    makeFrameTiles(cache, 1, RectI(0, 0, tileSizeX, tileSizeY), &tiles);
+    CacheImageTileStoragePtr tile = toCacheImageTileStorage(tiles[0]);
+    ASSERT_TRUE(tile);
+
+    // Columns alternate between 0 and 1: every level averages to 0.5
+    float* pixels = (float*)tile->getData();
+    for (int y = 0; y < tileSizeY; ++y) {
+        for (int x = 0; x < tileSizeX; ++x) {
+            pixels[y * tileSizeX + x] = (x % 2) ? 1.f : 0.f;
+        }
+    }
+    {
+        CacheEntryLockerPtr locker = cache->get(tile);
+        ASSERT_EQ(CacheEntryLocker::eCacheEntryStatusMustCompute, locker->getStatus());
+        locker->insertInCache();
+    }
+
+    const U64 mipmapsHash = ImageTileMipMapsKey::getTileMipMapsHash( tile->getHashKey() );
+    EXPECT_FALSE( cache->hasCacheEntryForHash(mipmapsHash) );
+
+    CacheImageTileMipMapsPtr mipmaps = ImagePrivate::getTileMipMaps(tile);
+    ASSERT_TRUE(mipmaps);
+    EXPECT_TRUE( cache->hasCacheEntryForHash(mipmapsHash) );
+    // The levels are in the tile aligned storage, not in the table of content
+    EXPECT_TRUE( mipmaps->isStorageTiled() );
+
+    // The next request reads them from the cache
+    {
+        ImageTileMipMapsKeyPtr key( new ImageTileMipMapsKey( tile->getHashKey(), std::string() ) );
+        CacheImageTileMipMapsPtr cachedMipMaps = CacheImageTileMipMaps::create(cache, key);
+        CacheEntryLockerPtr locker = cache->get(cachedMipMaps);
+        ASSERT_EQ(CacheEntryLocker::eCacheEntryStatusCached, locker->getStatus());
+        ASSERT_EQ( mipmaps->getNumLevels(), cachedMipMaps->getNumLevels() );
+
+        int width, height;
+        const float* level = (const float*)cachedMipMaps->getLevelData(1, &width, &height);
+        ASSERT_TRUE(level);
+        EXPECT_EQ(tileSizeX / 2, width);
+        EXPECT_EQ(tileSizeY / 2, height);
+        EXPECT_EQ(0.5f, level[0]);
+        EXPECT_EQ(0.5f, level[width * height - 1]);
+
+        level = (const float*)cachedMipMaps->getLevelData(cachedMipMaps->getNumLevels(), &width, &height);
+        ASSERT_TRUE(level);
+        EXPECT_EQ(1, width);
+        EXPECT_EQ(1, height);
+        EXPECT_EQ(0.5f, level[0]);
+
+        EXPECT_FALSE( cachedMipMaps->getLevelData(cachedMipMaps->getNumLevels() + 1, &width, &height) );
+    }
+
+    // The mipmaps do not outlive the tile
+    cache->removeEntry(tile);
+    EXPECT_FALSE( cache->hasCacheEntryForHash( tile->getHashKey() ) );
+    EXPECT_FALSE( cache->hasCacheEntryForHash(mipmapsHash) );
+}
+
+///Only the tiles of a sparse image that are written to are allocated
+TEST_F(BaseTest, SparseImageTiles)
+{
+    CachePtr cache = appPTR->getCache();
+    int tileSizeX, tileSizeY;
+    cache->getTileSizePx(eImageBitDepthFloat, &tileSizeX, &tileSizeY);
+
+    ImagePtr image;
+    {
+        Image::InitStorageArgs args;
+        args.bounds = RectI(0, 0, tileSizeX * 8, tileSizeY * 8);
+        args.bufferFormat = eImageBufferLayoutMonoChannelTiled;
+        args.sparse = true;
+        image = Image::create(args);
+    }
+    ASSERT_EQ(64, image->getNumTiles());
+    cache->resetStats();
+
+    // Filling entire tiles does not allocate them
+    image->fill(image->getBounds(), 0.5f, 0.5f, 0.5f, 1.f);
+
+    // Writing to a part of the first tile allocates its 4 channels
+    image->fill(RectI(1, 1, tileSizeX / 2, tileSizeY / 2), 1.f, 1.f, 1.f, 1.f);
+
+    // Read back the first 2 tiles
+    const RectI readBounds(0, 0, tileSizeX * 2, tileSizeY);
+    ImagePtr packedImage;
+    {
+        Image::InitStorageArgs args;
+        args.bounds = readBounds;
+        packedImage = Image::create(args);
+    }
+    Image::CopyPixelsArgs cpyArgs;
+    cpyArgs.roi = readBounds;
+    packedImage->copyPixels(*image, cpyArgs);
+
+    Image::Tile packedTile;
+    ASSERT_TRUE( packedImage->getTileAt(0, &packedTile) );
+    Image::CPUTileData packedData;
+    packedImage->getCPUTileData(packedTile, &packedData);
+    const float* pixels = (const float*)packedData.ptrs[0];
+    ASSERT_TRUE(pixels);
+    const float* written = pixels + (2 * readBounds.width() + 2) * 4;
+    const float* filled = pixels + (2 * readBounds.width() + tileSizeX + 2) * 4;
+    EXPECT_EQ(1.f, written[0]);
+    EXPECT_EQ(1.f, written[3]);
+    EXPECT_EQ(0.5f, filled[0]);
+    EXPECT_EQ(0.5f, filled[2]);
+    EXPECT_EQ(1.f, filled[3]);
+
+    // Extending the image on the left adds a column of tiles without allocating them
+    image->ensureBounds( RectI(-10, 0, tileSizeX * 8, tileSizeY * 8) );
+    EXPECT_EQ(72, image->getNumTiles());
+    EXPECT_EQ(-tileSizeX, image->getBounds().x1);
+
+    // The statistics are reported when the image is destroyed
+    image.reset();
+    CacheStatsReport report;
+    cache->getStats(&report);
+    EXPECT_EQ( (U64)72 * 4, report.total.nSparseTiles );
+    EXPECT_EQ( (U64)4, report.total.nSparseTilesAllocated );
+    EXPECT_EQ( (U64)68 * 4 * tileSizeX * tileSizeY * sizeof(float), report.total.sparseBytesSaved );
+}
+
+TEST_F(BaseTest, ImageCopyOnWriteView)
+{
+    CachePtr cache = appPTR->getCache();
+    int tileSizeX, tileSizeY;
+    cache->getTileSizePx(eImageBitDepthFloat, &tileSizeX, &tileSizeY);
+
+    ImagePtr image;
+    {
+        Image::InitStorageArgs args;
+        args.bounds = RectI(0, 0, tileSizeX * 2, tileSizeY * 2);
+        args.bufferFormat = eImageBufferLayoutMonoChannelTiled;
+        args.layer = ImagePlaneDesc::getRGBComponents();
+        image = Image::create(args);
+    }
+    image->fill(image->getBounds(), 0.25f, 0.5f, 0.75f, 1.f);
+
+    // RGB to RGBA: the color channels are shared and the alpha is a constant 1
+    Image::CopyPixelsArgs cpyArgs;
+    cpyArgs.roi = image->getBounds();
+    ImagePtr view = Image::createCopyOnWriteView(image, ImagePlaneDesc::getRGBAComponents(), cpyArgs, TreeRenderNodeArgsPtr());
+    ASSERT_TRUE(view);
+    EXPECT_EQ(4, (int)view->getComponentsCount());
+    ASSERT_EQ(image->getNumTiles(), view->getNumTiles());
+
+    Image::Tile srcTile, viewTile;
+    ASSERT_TRUE( image->getTileAt(0, &srcTile) );
+    ASSERT_TRUE( view->getTileAt(0, &viewTile) );
+    ASSERT_EQ(4, (int)viewTile.perChannelTile.size());
+    for (int c = 0; c < 3; ++c) {
+        EXPECT_EQ(srcTile.perChannelTile[c].buffer, viewTile.perChannelTile[c].buffer);
+    }
+    float alpha = 0.f;
+    EXPECT_TRUE( viewTile.perChannelTile[3].buffer->isLazyAllocationPending(&alpha) );
+    EXPECT_EQ(1.f, alpha);
+
+    // Writing to the first tile of the view copies it, the source is left untouched
+    view->fill(RectI(0, 0, 1, 1), 1.f, 1.f, 1.f, 1.f);
+    ASSERT_TRUE( view->getTileAt(0, &viewTile) );
+    EXPECT_NE(srcTile.perChannelTile[0].buffer, viewTile.perChannelTile[0].buffer);
+
+    Image::CPUTileData srcData, viewData;
+    image->getCPUTileData(srcTile, &srcData);
+    view->getCPUTileData(viewTile, &viewData);
+    EXPECT_EQ(0.25f, ( (const float*)srcData.ptrs[0] )[0]);
+    EXPECT_EQ(1.f, ( (const float*)viewData.ptrs[0] )[0]);
+    EXPECT_EQ(0.5f, ( (const float*)viewData.ptrs[1] )[1]);
+
+    // Other tiles are still shared
+    Image::Tile srcTile1, viewTile1;
+    ASSERT_TRUE( image->getTileAt(1, &srcTile1) );
+    ASSERT_TRUE( view->getTileAt(1, &viewTile1) );
+    EXPECT_EQ(srcTile1.perChannelTile[2].buffer, viewTile1.perChannelTile[2].buffer);
+
+    // A color-space conversion cannot be done without copying
+    cpyArgs.srcColorspace = eViewerColorSpaceLinear;
+    cpyArgs.dstColorspace = eViewerColorSpaceSRGB;
+    EXPECT_FALSE( Image::createCopyOnWriteView(image, ImagePlaneDesc::getRGBAComponents(), cpyArgs, TreeRenderNodeArgsPtr()) );
+}
+
+class RowCountProcessor : public ImageMultiThreadProcessorBase
+{
+public:
+
+    RowCountProcessor(const RectI& renderWindow)
+    : ImageMultiThreadProcessorBase( TreeRenderNodeArgsPtr() )
+    , mutex()
+    , rowCounts(renderWindow.height(), 0)
+    , maxChunkRows(0)
+    , y1(renderWindow.y1)
+    {
+        setRenderWindow(renderWindow);
+    }
+
+    virtual ~RowCountProcessor()
+    {
+    }
+
+    QMutex mutex;
+    std::vector<int> rowCounts;
+    int maxChunkRows;
+
+private:
+
+    virtual ActionRetCodeEnum multiThreadProcessImages(const RectI& renderWindow, const TreeRenderNodeArgsPtr& /*renderArgs*/) OVERRIDE FINAL
+    {
+        QMutexLocker k(&mutex);
+        maxChunkRows = std::max( maxChunkRows, renderWindow.height() );
+        for (int y = renderWindow.y1; y < renderWindow.y2; ++y) {
+            ++rowCounts[y - y1];
+        }
+        return eActionStatusOK;
+    }
+
+    int y1;
+};
+
+TEST_F(BaseTest, ImageProcessorChunks)
+{
+    const RectI renderWindow(-10, -37, 500, 1003);
+
+    // Every row is processed exactly once, whatever the chunk size
+    for (int chunkRows = 0; chunkRows < 5; ++chunkRows) {
+        RowCountProcessor processor(renderWindow);
+        processor.setChunkRows(chunkRows);
+        ASSERT_EQ(eActionStatusOK, processor.process());
+        for (std::size_t i = 0; i < processor.rowCounts.size(); ++i) {
+            EXPECT_EQ(1, processor.rowCounts[i]);
+        }
+        if (chunkRows > 0) {
+            EXPECT_LE(processor.maxChunkRows, chunkRows);
+        }
+    }
+}
+
+static ActionRetCodeEnum
+emptyThreadFunction(unsigned int /*threadIndex*/,
+                    unsigned int /*threadMax*/,
+                    void* /*customArg*/,
+                    const TreeRenderNodeArgsPtr& /*renderArgs*/)
+{
+    return eActionStatusOK;
+}
+
+static ActionRetCodeEnum
+countThreadFunction(unsigned int threadIndex,
+                    unsigned int threadMax,
+                    void* customArg,
+                    const TreeRenderNodeArgsPtr& /*renderArgs*/)
+{
+    if (threadIndex >= threadMax) {
+        return eActionStatusFailed;
+    }
+    ( (QAtomicInt*)customArg )->fetchAndAddOrdered(1);
+    return eActionStatusOK;
+}
+
+static ActionRetCodeEnum
+nestedThreadFunction(unsigned int threadIndex,
+                     unsigned int /*threadMax*/,
+                     void* customArg,
+                     const TreeRenderNodeArgsPtr& renderArgs)
+{
+    ActionRetCodeEnum stat = MultiThread::launchThreads(countThreadFunction, 4, customArg, renderArgs);
+    if ( isFailureRetCode(stat) ) {
+        return stat;
+    }
+
+    // The index of the outer call is restored. There is no index if the calls were made sequentially on a single CPU.
+    unsigned int currentIndex;
+    if ( (MultiThread::getCurrentThreadIndex(&currentIndex) == eActionStatusOK) && (currentIndex != threadIndex) ) {
+        return eActionStatusFailed;
+    }
+    return eActionStatusOK;
+}
+
+///Benchmark: latency of MultiThread::launchThreads with a functor that does nothing, as OpenFX plug-ins
+///call it many times per frame.
+TEST_F(BaseTest, MultiThreadDispatchLatency)
+{
+    // Every index is called once, also when launches are nested
+    QAtomicInt nCalls(0);
+    ASSERT_EQ( eActionStatusOK, MultiThread::launchThreads(countThreadFunction, 16, &nCalls, TreeRenderNodeArgsPtr()) );
+    EXPECT_EQ( 16, nCalls.fetchAndAddOrdered(0) );
+    nCalls.fetchAndStoreOrdered(0);
+    ASSERT_EQ( eActionStatusOK, MultiThread::launchThreads(nestedThreadFunction, 8, &nCalls, TreeRenderNodeArgsPtr()) );
+    EXPECT_EQ( 8 * 4, nCalls.fetchAndAddOrdered(0) );
+    EXPECT_FALSE( MultiThread::isCurrentThreadSpawnedThread() );
+
+    const int nIterations = 10000;
+    for (unsigned int nThreads = 1; nThreads <= 64; nThreads *= 2) {
+        TimeLapse timer;
+        for (int i = 0; i < nIterations; ++i) {
+            MultiThread::launchThreads(emptyThreadFunction, nThreads, 0, TreeRenderNodeArgsPtr());
+        }
+        double elapsed = timer.getTimeSinceCreation();
+        std::cout << "launchThreads with " << nThreads << " threads: " << elapsed * 1e6 / nIterations << " us per call" << std::endl;
+    }
+}
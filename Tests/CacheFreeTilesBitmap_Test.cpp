@@ -0,0 +1,128 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2017 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cstdlib>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "Engine/CacheFreeTilesBitmap.h"
+
+NATRON_NAMESPACE_USING
+
+typedef CacheFreeTilesBitmap<std::allocator<U64> > TestBitmap;
+
+TEST(CacheFreeTilesBitmap,
+     AllocateAndFree)
+{
+    TestBitmap bitmap( (std::allocator<U64>()) );
+    std::size_t tileIndex;
+
+    EXPECT_FALSE( bitmap.allocateTile(&tileIndex) );
+
+    bitmap.grow(100);
+    EXPECT_EQ( (std::size_t)100, bitmap.getTilesCount() );
+    EXPECT_EQ( (std::size_t)100, bitmap.getFreeTilesCount() );
+    EXPECT_EQ( (std::size_t)2 * sizeof(U64), bitmap.getMemorySizeAfterGrowth(0) );
+
+    // Tiles are allocated in order
+    for (std::size_t i = 0; i < 100; ++i) {
+        ASSERT_TRUE( bitmap.allocateTile(&tileIndex) );
+        EXPECT_EQ(i, tileIndex);
+    }
+    EXPECT_FALSE( bitmap.allocateTile(&tileIndex) );
+    EXPECT_EQ( (std::size_t)0, bitmap.getFreeTilesCount() );
+
+    // The lowest free tile is allocated first
+    EXPECT_TRUE( bitmap.freeTile(70) );
+    EXPECT_TRUE( bitmap.freeTile(3) );
+    EXPECT_FALSE( bitmap.freeTile(3) );
+    EXPECT_TRUE( bitmap.isTileFree(3) );
+    EXPECT_FALSE( bitmap.isTileFree(4) );
+    ASSERT_TRUE( bitmap.allocateTile(&tileIndex) );
+    EXPECT_EQ( (std::size_t)3, tileIndex );
+    ASSERT_TRUE( bitmap.allocateTile(&tileIndex) );
+    EXPECT_EQ( (std::size_t)70, tileIndex );
+
+    // Runs of tiles in the same state
+    bitmap.grow(200);
+    bool isFree;
+    EXPECT_EQ( (std::size_t)100, bitmap.getRunLength(0, &isFree) );
+    EXPECT_FALSE(isFree);
+    EXPECT_EQ( (std::size_t)200, bitmap.getRunLength(100, &isFree) );
+    EXPECT_TRUE(isFree);
+    EXPECT_EQ( (std::size_t)50, bitmap.getRunLength(250, &isFree) );
+    EXPECT_TRUE(isFree);
+}
+
+TEST(CacheFreeTilesBitmap,
+     RandomOperations)
+{
+    TestBitmap bitmap( (std::allocator<U64>()) );
+    // The former implementation, used as reference
+    std::set<std::size_t> reference;
+    std::vector<std::size_t> allocated;
+
+    std::srand(2017);
+    for (int i = 0; i < 100000; ++i) {
+        int op = std::rand() % 8;
+        if (op == 0) {
+            std::size_t nTilesToAdd = std::rand() % 130;
+            for (std::size_t t = 0; t < nTilesToAdd; ++t) {
+                reference.insert(bitmap.getTilesCount() + t);
+            }
+            bitmap.grow(nTilesToAdd);
+        } else if ( (op < 5) && !reference.empty() ) {
+            std::size_t tileIndex;
+            ASSERT_TRUE( bitmap.allocateTile(&tileIndex) );
+            ASSERT_EQ(*reference.begin(), tileIndex);
+            reference.erase( reference.begin() );
+            allocated.push_back(tileIndex);
+        } else if ( !allocated.empty() ) {
+            std::size_t index = std::rand() % allocated.size();
+            ASSERT_TRUE( bitmap.freeTile(allocated[index]) );
+            reference.insert(allocated[index]);
+            allocated[index] = allocated.back();
+            allocated.pop_back();
+        }
+        ASSERT_EQ( reference.size(), bitmap.getFreeTilesCount() );
+    }
+
+    // The runs cover all tiles and match the reference
+    std::size_t i = 0;
+    while ( i < bitmap.getTilesCount() ) {
+        bool isFree;
+        std::size_t runLength = bitmap.getRunLength(i, &isFree);
+        ASSERT_GT(runLength, (std::size_t)0);
+        for (std::size_t t = i; t < i + runLength; ++t) {
+            ASSERT_EQ( reference.count(t) == 1, isFree );
+        }
+        i += runLength;
+    }
+    EXPECT_EQ(bitmap.getTilesCount(), i);
+}
@@ -0,0 +1,209 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2017 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "Engine/CacheMemoryGovernor.h"
+
+NATRON_NAMESPACE_USING
+
+#define MiB ((std::size_t)1024 * 1024)
+#define GiB ((std::size_t)1024 * 1024 * 1024)
+
+namespace {
+
+// A memory source whose state is set by the test
+class FakeMemoryPressureSource
+    : public MemoryPressureSourceI
+{
+public:
+
+    MemoryPressureInfo info;
+    bool valid;
+
+    FakeMemoryPressureSource()
+    : MemoryPressureSourceI()
+    , info()
+    , valid(true)
+    {
+    }
+
+    virtual ~FakeMemoryPressureSource() {}
+
+    virtual bool getMemoryPressure(MemoryPressureInfo* ret) OVERRIDE FINAL
+    {
+        *ret = info;
+        return valid;
+    }
+
+    void set(std::size_t totalRAM, std::size_t availableRAM, double someStallPercent = -1)
+    {
+        info.totalRAM = totalRAM;
+        info.availableRAM = availableRAM;
+        info.someStallPercent = someStallPercent;
+    }
+};
+
+} // anon namespace
+
+TEST(CacheMemoryGovernor,
+     ParseMemInfo)
+{
+    const std::string memInfo("MemTotal:       16318712 kB\n"
+                              "MemFree:          923456 kB\n"
+                              "MemAvailable:    8388608 kB\n"
+                              "Buffers:          123456 kB\n"
+                              "Cached:          6543210 kB\n"
+                              "SwapCached:            0 kB\n");
+    U64 total = 0, available = 0;
+    ASSERT_TRUE( SystemMemoryPressureSource::parseMemInfo(memInfo, &total, &available) );
+    EXPECT_EQ( (U64)16318712 * 1024, total );
+    EXPECT_EQ( (U64)8388608 * 1024, available );
+
+    // Kernels older than 3.14 have no MemAvailable
+    const std::string oldMemInfo("MemTotal:       16318712 kB\n"
+                                 "MemFree:          923456 kB\n"
+                                 "Buffers:          123456 kB\n"
+                                 "Cached:          6543210 kB\n");
+    ASSERT_TRUE( SystemMemoryPressureSource::parseMemInfo(oldMemInfo, &total, &available) );
+    EXPECT_EQ( (U64)(923456 + 123456 + 6543210) * 1024, available );
+
+    EXPECT_FALSE( SystemMemoryPressureSource::parseMemInfo("MemFree:          923456 kB\n", &total, &available) );
+    EXPECT_FALSE( SystemMemoryPressureSource::parseMemInfo("", &total, &available) );
+}
+
+TEST(CacheMemoryGovernor,
+     ParsePressure)
+{
+    const std::string pressure("some avg10=12.50 avg60=3.20 avg300=0.80 total=123456\n"
+                               "full avg10=4.25 avg60=1.00 avg300=0.10 total=23456\n");
+    double some = 0, full = 0;
+    ASSERT_TRUE( SystemMemoryPressureSource::parsePressure(pressure, &some, &full) );
+    EXPECT_DOUBLE_EQ(12.5, some);
+    EXPECT_DOUBLE_EQ(4.25, full);
+
+    // Some kernels do not report the full line
+    ASSERT_TRUE( SystemMemoryPressureSource::parsePressure("some avg10=0.00 avg60=0.00 avg300=0.00 total=0\n", &some, &full) );
+    EXPECT_DOUBLE_EQ(0., some);
+    EXPECT_DOUBLE_EQ(-1., full);
+
+    EXPECT_FALSE( SystemMemoryPressureSource::parsePressure("", &some, &full) );
+}
+
+TEST(CacheMemoryGovernor,
+     ComputeBudget)
+{
+    MemoryPressureInfo info;
+    info.totalRAM = 16 * GiB;
+
+    // 8GiB available with a reserve of 1.6GiB: a 2GiB cache may grow by 6.4GiB
+    info.availableRAM = 8 * GiB;
+    std::size_t budget = CacheMemoryGovernor::computeBudget(info, 0, 2 * GiB, 1 * GiB, 12 * GiB);
+    EXPECT_EQ( 2 * GiB + 8 * GiB - (std::size_t)(16 * GiB * 0.1), budget );
+
+    // Clamped to the maximum
+    info.availableRAM = 15 * GiB;
+    EXPECT_EQ( 12 * GiB, CacheMemoryGovernor::computeBudget(info, 0, 2 * GiB, 1 * GiB, 12 * GiB) );
+
+    // Small changes are ignored
+    info.availableRAM = (std::size_t)(16 * GiB * 0.1) + 2 * GiB + 16 * MiB;
+    EXPECT_EQ( 10 * GiB, CacheMemoryGovernor::computeBudget(info, 10 * GiB, 8 * GiB, 1 * GiB, 12 * GiB) );
+
+    // Below the reserve, the cache must shrink by what is missing and at least a quarter
+    info.availableRAM = 1 * GiB;
+    budget = CacheMemoryGovernor::computeBudget(info, 8 * GiB, 8 * GiB, 1 * GiB, 12 * GiB);
+    EXPECT_EQ( 6 * GiB, budget );
+
+    // Stalls are pressure even if memory seems available
+    info.availableRAM = 8 * GiB;
+    info.someStallPercent = 20.;
+    budget = CacheMemoryGovernor::computeBudget(info, 8 * GiB, 8 * GiB, 1 * GiB, 12 * GiB);
+    EXPECT_EQ( 6 * GiB, budget );
+
+    // But never below the minimum
+    info.availableRAM = 0;
+    EXPECT_EQ( 1 * GiB, CacheMemoryGovernor::computeBudget(info, 1 * GiB, 8 * GiB, 1 * GiB, 12 * GiB) );
+
+    // A maximum of 0 is the physical memory and the budget is never 0, which would mean no budget
+    info.someStallPercent = -1;
+    info.availableRAM = 16 * GiB;
+    EXPECT_EQ( 16 * GiB, CacheMemoryGovernor::computeBudget(info, 0, 4 * GiB, 0, 0) );
+    info.availableRAM = 0;
+    EXPECT_EQ( (std::size_t)1, CacheMemoryGovernor::computeBudget(info, 0, 0, 0, 0) );
+}
+
+TEST(CacheMemoryGovernor,
+     FollowsFakeMemorySource)
+{
+    boost::shared_ptr<FakeMemoryPressureSource> source(new FakeMemoryPressureSource);
+    CacheMemoryGovernor governor(CachePtr(), source);
+    governor.setBudgetRange(1 * GiB, 12 * GiB);
+
+    // Idle machine: the cache may take everything up to the maximum
+    source->set(16 * GiB, 14 * GiB);
+    std::size_t cacheSize = 0;
+    std::size_t budget = governor.computeNextBudget(cacheSize);
+    EXPECT_EQ( 12 * GiB, budget );
+    EXPECT_EQ( budget, governor.getBudget() );
+
+    // The cache fills up: the available memory decreases by as much, the budget is stable
+    cacheSize = 8 * GiB;
+    source->set(16 * GiB, 6 * GiB);
+    EXPECT_EQ( 12 * GiB, governor.computeNextBudget(cacheSize) );
+
+    // Another job spikes and takes 5GiB: the system is below its reserve, the budget shrinks
+    source->set(16 * GiB, 1 * GiB);
+    budget = governor.computeNextBudget(cacheSize);
+    EXPECT_LE( budget, 8 * GiB - ( (std::size_t)(16 * GiB * 0.1) - 1 * GiB ) );
+    EXPECT_LE( budget, (std::size_t)(12 * GiB * 0.75) );
+
+    // The pressure keeps on: the budget keeps shrinking down to the minimum
+    cacheSize = budget;
+    for (int i = 0; i < 20; ++i) {
+        source->set(16 * GiB, 0, 50.);
+        std::size_t newBudget = governor.computeNextBudget(cacheSize);
+        EXPECT_LE(newBudget, budget);
+        budget = newBudget;
+        cacheSize = budget;
+    }
+    EXPECT_EQ( 1 * GiB, budget );
+
+    // A failure to read the memory state keeps the current budget
+    source->valid = false;
+    EXPECT_EQ( 1 * GiB, governor.computeNextBudget(cacheSize) );
+
+    // The job ends: the cache may grow again
+    source->valid = true;
+    source->set(16 * GiB, 12 * GiB);
+    budget = governor.computeNextBudget(cacheSize);
+    EXPECT_EQ( 1 * GiB + 12 * GiB - (std::size_t)(16 * GiB * 0.1), budget );
+
+    // Changing the range applies right away
+    governor.setBudgetRange(1 * GiB, 4 * GiB);
+    EXPECT_EQ( 4 * GiB, governor.computeNextBudget(cacheSize) );
+}
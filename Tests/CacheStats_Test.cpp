@@ -0,0 +1,171 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2017 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <sstream>
+
+#include <gtest/gtest.h>
+
+#include "Engine/CacheStats.h"
+
+NATRON_NAMESPACE_USING
+
+TEST(CacheStats,
+     LatencyHistogram)
+{
+    CacheLatencyHistogram histogram;
+
+    EXPECT_EQ(0., histogram.getMeanSeconds());
+    EXPECT_EQ(0., histogram.getPercentileSeconds(0.5));
+
+    // 0.5us, 1.5us, 3us then 97 samples of 100us
+    histogram.addSample(0.5e-6);
+    histogram.addSample(1.5e-6);
+    histogram.addSample(3e-6);
+    for (int i = 0; i < 97; ++i) {
+        histogram.addSample(100e-6);
+    }
+    EXPECT_EQ( (U64)100, histogram.nSamples );
+    EXPECT_EQ( (U64)1, histogram.counts[0] );
+    EXPECT_EQ( (U64)1, histogram.counts[1] );
+    EXPECT_EQ( (U64)1, histogram.counts[2] );
+
+    // 100us is in [64us, 128us[
+    EXPECT_EQ( (U64)97, histogram.counts[7] );
+    EXPECT_DOUBLE_EQ(100e-6, histogram.maxSeconds);
+    EXPECT_NEAR( (0.5 + 1.5 + 3 + 97 * 100) * 1e-8, histogram.getMeanSeconds(), 1e-12 );
+
+    // Percentiles are bounded by the bucket upper bound and the maximum
+    EXPECT_DOUBLE_EQ( 1e-6, histogram.getPercentileSeconds(0.01) );
+    EXPECT_DOUBLE_EQ( 100e-6, histogram.getPercentileSeconds(0.5) );
+    EXPECT_DOUBLE_EQ( 100e-6, histogram.getPercentileSeconds(1.) );
+
+    // Very long samples go in the last bucket
+    histogram.addSample(3600.);
+    EXPECT_EQ( (U64)1, histogram.counts[NATRON_CACHE_LATENCY_HISTOGRAM_BUCKETS_COUNT - 1] );
+    EXPECT_DOUBLE_EQ( 3600., histogram.getPercentileSeconds(1.) );
+
+    CacheLatencyHistogram merged;
+    merged.merge(histogram);
+    merged.merge(histogram);
+    EXPECT_EQ(2 * histogram.nSamples, merged.nSamples);
+    EXPECT_EQ(2 * histogram.counts[7], merged.counts[7]);
+    EXPECT_DOUBLE_EQ(histogram.maxSeconds, merged.maxSeconds);
+}
+
+TEST(CacheStats,
+     Recorder)
+{
+    CacheStatsRecorder recorder;
+
+    int blur = CacheStatsRecorder::getPluginIndex("net.sf.openfx.BlurPlugin");
+    int merge = CacheStatsRecorder::getPluginIndex("fr.inria.built-in.Merge");
+    EXPECT_NE(blur, merge);
+    EXPECT_EQ( blur, CacheStatsRecorder::getPluginIndex("net.sf.openfx.BlurPlugin") );
+    EXPECT_EQ( std::string("fr.inria.built-in.Merge"), CacheStatsRecorder::getPluginID(merge) );
+    EXPECT_EQ( 0, CacheStatsRecorder::getPluginIndex( std::string() ) );
+
+    recorder.addLookup(blur, true, 1e-6);
+    recorder.addLookup(blur, false, 2e-6);
+    recorder.addLookup(merge, false, 2e-6);
+    recorder.addPendingWait(merge, 1e-3);
+    recorder.addInsertion(blur, 5e-6);
+    recorder.addEviction(blur, 5e-6);
+    recorder.addContendedLock(1e-4);
+    recorder.addFileGrowth(1e-2);
+    recorder.addCompressedLookup(blur, true, 1e-4);
+    recorder.addCompressedLookup(merge, false, 1e-6);
+    recorder.addCompressedWrite(blur, 65536, 16384, 1e-4);
+
+    CacheStats total;
+    std::map<std::string, CacheStats> perPlugin;
+    recorder.appendStats(&total, &perPlugin);
+
+    EXPECT_EQ( (U64)1, total.nHits );
+    EXPECT_EQ( (U64)2, total.nMisses );
+    EXPECT_EQ( (U64)1, total.nPendingWaits );
+    EXPECT_EQ( (U64)1, total.nInsertions );
+    EXPECT_EQ( (U64)1, total.nEvictions );
+    EXPECT_EQ( (U64)1, total.nContendedLocks );
+    EXPECT_EQ( (U64)1, total.nFileGrowths );
+    EXPECT_EQ( (U64)3, total.getLatency.nSamples );
+    EXPECT_DOUBLE_EQ(1. / 3, total.getHitRatio());
+    EXPECT_EQ( (U64)1, total.nCompressedHits );
+    EXPECT_EQ( (U64)1, total.nCompressedMisses );
+    EXPECT_EQ( (U64)1, total.decompressLatency.nSamples );
+    EXPECT_DOUBLE_EQ( 4., total.getCompressionRatio() );
+
+    ASSERT_EQ( (std::size_t)2, perPlugin.size() );
+    EXPECT_EQ( (U64)1, perPlugin["net.sf.openfx.BlurPlugin"].nHits );
+    EXPECT_EQ( (U64)1, perPlugin["net.sf.openfx.BlurPlugin"].nEvictions );
+    EXPECT_EQ( (U64)1, perPlugin["fr.inria.built-in.Merge"].nPendingWaits );
+
+    // Locks and file growths are not associated to a plug-in
+    EXPECT_EQ( (U64)0, perPlugin["net.sf.openfx.BlurPlugin"].nContendedLocks );
+
+    CacheStatsReport report;
+    report.total = total;
+    report.perPlugin = perPlugin;
+    std::stringstream ss;
+    report.print(ss);
+    EXPECT_NE( std::string::npos, ss.str().find("net.sf.openfx.BlurPlugin") );
+    EXPECT_NE( std::string::npos, ss.str().find("compressionRatio") );
+
+    recorder.reset();
+    total = CacheStats();
+    recorder.appendStats(&total, 0);
+    EXPECT_EQ( (U64)0, total.nHits );
+    EXPECT_EQ( (U64)0, total.lockLatency.nSamples );
+}
+
+TEST(CacheStats,
+     PluginStatsRecorder)
+{
+    // Buckets record the statistics of each plug-in in a shared recorder
+    CacheStatsRecorder global, bucket1, bucket2;
+    bucket1.setPluginStatsRecorder(&global);
+    bucket2.setPluginStatsRecorder(&global);
+
+    int blur = CacheStatsRecorder::getPluginIndex("net.sf.openfx.BlurPlugin");
+    bucket1.addLookup(blur, true, 1e-6);
+    bucket2.addLookup(blur, false, 1e-6);
+    bucket2.addInsertion(blur, 1e-6);
+
+    CacheStats total;
+    std::map<std::string, CacheStats> perPlugin;
+    bucket1.appendStats(&total, &perPlugin);
+    bucket2.appendStats(&total, &perPlugin);
+    EXPECT_TRUE( perPlugin.empty() );
+    EXPECT_EQ( (U64)1, total.nHits );
+    EXPECT_EQ( (U64)1, total.nMisses );
+
+    CacheStats globalTotal;
+    global.appendStats(&globalTotal, &perPlugin);
+    EXPECT_EQ( (U64)0, globalTotal.nHits );
+    ASSERT_EQ( (std::size_t)1, perPlugin.size() );
+    EXPECT_EQ( (U64)1, perPlugin["net.sf.openfx.BlurPlugin"].nHits );
+    EXPECT_EQ( (U64)1, perPlugin["net.sf.openfx.BlurPlugin"].nMisses );
+    EXPECT_EQ( (U64)1, perPlugin["net.sf.openfx.BlurPlugin"].nInsertions );
+}
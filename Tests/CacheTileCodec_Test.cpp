@@ -0,0 +1,128 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2017 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "Engine/CacheTileCodec.h"
+
+NATRON_NAMESPACE_USING
+
+// A 64KiB tile, the default tile size
+#define TEST_TILE_SIZE_BYTES 65536
+
+static void
+expectRoundTrip(const std::vector<char>& tile,
+                int elementSize,
+                bool expectCompressed)
+{
+    std::vector<char> compressed;
+    bool isCompressed = CacheTileCodec::compress(&tile[0], tile.size(), elementSize, &compressed);
+    ASSERT_EQ(expectCompressed, isCompressed);
+    if (!isCompressed) {
+        return;
+    }
+    ASSERT_LT( compressed.size(), tile.size() );
+
+    std::vector<char> decompressed( tile.size() );
+    ASSERT_TRUE( CacheTileCodec::decompress(&compressed[0], compressed.size(), elementSize, &decompressed[0], decompressed.size()) );
+    EXPECT_EQ( 0, memcmp(&tile[0], &decompressed[0], tile.size()) );
+}
+
+TEST(CacheTileCodec,
+     RoundTrip)
+{
+    // A constant tile
+    std::vector<char> tile(TEST_TILE_SIZE_BYTES, 0);
+    expectRoundTrip(tile, 4, true);
+
+    // A float gradient: the exponent bytes compress well once shuffled
+    float* pixels = reinterpret_cast<float*>(&tile[0]);
+    for (int i = 0; i < TEST_TILE_SIZE_BYTES / 4; ++i) {
+        pixels[i] = (i % 128) / 127.f + (i / 128) * 0.001f;
+    }
+    expectRoundTrip(tile, 4, true);
+
+    // A 16-bit ramp with an odd size
+    std::vector<char> oddTile(TEST_TILE_SIZE_BYTES - 3);
+    for (std::size_t i = 0; i < oddTile.size(); ++i) {
+        oddTile[i] = (char)( (i / 2) % 251 );
+    }
+    expectRoundTrip(oddTile, 2, true);
+
+    // A 16-bit gradient: grouping the high bytes makes it compress better than with the float element size
+    std::vector<char> shortTile(TEST_TILE_SIZE_BYTES);
+    unsigned short* shortPixels = reinterpret_cast<unsigned short*>(&shortTile[0]);
+    for (int i = 0; i < TEST_TILE_SIZE_BYTES / 2; ++i) {
+        shortPixels[i] = (unsigned short)(i * 7);
+    }
+    expectRoundTrip(shortTile, 2, true);
+    std::vector<char> compressedAs2, compressedAs4;
+    ASSERT_TRUE( CacheTileCodec::compress(&shortTile[0], shortTile.size(), 2, &compressedAs2) );
+    ASSERT_TRUE( CacheTileCodec::compress(&shortTile[0], shortTile.size(), 4, &compressedAs4) );
+    EXPECT_LT( compressedAs2.size(), compressedAs4.size() );
+
+    // 8-bit samples are not shuffled
+    expectRoundTrip(oddTile, 1, true);
+
+    // Noise does not compress
+    std::srand(2017);
+    for (std::size_t i = 0; i < tile.size(); ++i) {
+        tile[i] = (char)(std::rand() & 0xff);
+    }
+    expectRoundTrip(tile, 4, false);
+}
+
+TEST(CacheTileCodec,
+     CorruptedData)
+{
+    std::vector<char> tile(TEST_TILE_SIZE_BYTES);
+    for (std::size_t i = 0; i < tile.size(); ++i) {
+        tile[i] = (char)(i % 7);
+    }
+    std::vector<char> compressed;
+    ASSERT_TRUE( CacheTileCodec::compress(&tile[0], tile.size(), 4, &compressed) );
+
+    std::vector<char> decompressed( tile.size() );
+
+    // Truncated data or a wrong size must be detected
+    EXPECT_FALSE( CacheTileCodec::decompress(&compressed[0], compressed.size() / 2, 4, &decompressed[0], decompressed.size()) );
+    EXPECT_FALSE( CacheTileCodec::decompress(&compressed[0], compressed.size(), 4, &decompressed[0], decompressed.size() - 1) );
+
+    // Random garbage must never write past the output buffer: it either fails or produces exactly the size asked
+    std::srand(2017);
+    for (int i = 0; i < 1000; ++i) {
+        std::vector<char> garbage = compressed;
+        for (int j = 0; j < 8; ++j) {
+            garbage[std::rand() % garbage.size()] = (char)(std::rand() & 0xff);
+        }
+        CacheTileCodec::decompress(&garbage[0], garbage.size(), 4, &decompressed[0], decompressed.size());
+    }
+}
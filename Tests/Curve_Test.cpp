@@ -24,12 +24,16 @@
 
 #include "Global/Macros.h"
 
+#include <cstdlib>
+#include <iostream>
+#include <vector>
 #include <gtest/gtest.h>
 
 #include <QtCore/QString>
 #include <QtCore/QDir>
 
 #include "Engine/Curve.h"
+#include "Engine/Timer.h"
 
 NATRON_NAMESPACE_USING
 
@@ -122,4 +126,168 @@ TEST(Curve, Basic)
 
 }
 
+// Builds a dense curve, such as one produced by a tracker or by mocap data
+static void
+makeDenseCurve(Curve* c,
+               int nKeys)
+{
+    srand(2000);
+    KeyFrameSet keys;
+    for (int i = 0; i < nKeys; ++i) {
+        // coverity[dont_call]
+        keys.insert( KeyFrame( i, (double)(rand() % 1000) / 10., 0., 0., i % 3 == 0 ? eKeyframeTypeLinear : eKeyframeTypeSmooth ) );
+    }
+    c->setKeyframes(keys, true);
+}
+
+TEST(Curve, KeyFrameQueries)
+{
+    Curve c;
+
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_TRUE( c.addKeyFrame( KeyFrame(i * 10., i) ) );
+    }
+    EXPECT_EQ( 10, c.getKeyFramesCount() );
+    EXPECT_EQ( 0., c.getMinimumTimeCovered() );
+    EXPECT_EQ( 90., c.getMaximumTimeCovered() );
+    EXPECT_EQ( 3, c.keyFrameIndex(TimeValue(30.)) );
+    EXPECT_EQ( -1, c.keyFrameIndex(TimeValue(35.)) );
+    EXPECT_EQ( 3, c.getNKeyFramesInRange(10., 40.) );
+
+    KeyFrame k;
+    EXPECT_TRUE( c.getKeyFrameWithIndex(4, &k) );
+    EXPECT_EQ( 40., k.getTime() );
+    EXPECT_FALSE( c.getKeyFrameWithIndex(10, &k) );
+    EXPECT_TRUE( c.getKeyFrameWithTime(TimeValue(50.), &k) );
+    EXPECT_EQ( 5., k.getValue() );
+    EXPECT_FALSE( c.getKeyFrameWithTime(TimeValue(55.), &k) );
+    EXPECT_TRUE( c.getPreviousKeyframeTime(TimeValue(50.), &k) );
+    EXPECT_EQ( 40., k.getTime() );
+    EXPECT_FALSE( c.getPreviousKeyframeTime(TimeValue(0.), &k) );
+    EXPECT_TRUE( c.getNextKeyframeTime(TimeValue(50.), &k) );
+    EXPECT_EQ( 60., k.getTime() );
+    EXPECT_FALSE( c.getNextKeyframeTime(TimeValue(90.), &k) );
+
+    // Modifications must be visible to the next read
+    c.removeKeyFrameWithTime( TimeValue(30.) );
+    EXPECT_EQ( 9, c.getKeyFramesCount() );
+    EXPECT_EQ( -1, c.keyFrameIndex(TimeValue(30.)) );
+    EXPECT_EQ( 3, c.keyFrameIndex(TimeValue(40.)) );
+    EXPECT_EQ( 4., c.getValueAt(TimeValue(40.)) );
+    c.setYRange(0., 2.);
+    EXPECT_EQ( 2., c.getValueAt(TimeValue(80.)) );
+    c.clearKeyFrames();
+    EXPECT_FALSE( c.isAnimated() );
+    EXPECT_EQ( 0., c.getValueAt(TimeValue(10.)) );
+}
+
+// Reading the curve after each edit must see the keyframes being edited
+TEST(Curve, EditThenEvaluate)
+{
+    Curve c;
+    for (int i = 0; i < 200; ++i) {
+        // Append, then insert between existing keyframes
+        double time = (i < 100) ? i * 2. : (i - 100) * 2. + 1.;
+        EXPECT_TRUE( c.addKeyFrame( KeyFrame(time, (i * 7) % 13, 0., 0., eKeyframeTypeSmooth) ) );
+        EXPECT_EQ( i + 1, c.getKeyFramesCount() );
+        EXPECT_EQ( (double)( (i * 7) % 13 ), c.getValueAt( TimeValue(time) ) );
+    }
+    for (int i = 0; i < 50; ++i) {
+        // Replace existing keyframes
+        EXPECT_FALSE( c.addKeyFrame( KeyFrame(i * 3., -i, 0., 0., eKeyframeTypeSmooth) ) );
+        EXPECT_EQ( 200, c.getKeyFramesCount() );
+        EXPECT_EQ( (double)-i, c.getValueAt( TimeValue(i * 3.) ) );
+    }
+    // Move a keyframe
+    (void)c.setKeyFrameValueAndTime( TimeValue(500.), 42., c.keyFrameIndex( TimeValue(10.) ) );
+    EXPECT_EQ( 42., c.getValueAt( TimeValue(500.) ) );
+    EXPECT_EQ( -1, c.keyFrameIndex( TimeValue(10.) ) );
+    c.removeKeyFrameWithTime( TimeValue(20.) );
+    EXPECT_EQ( 199, c.getKeyFramesCount() );
 
+    // A curve built at once from the same keyframes must evaluate identically
+    KeyFrameSet keys = c.getKeyFrames_mt_safe();
+    Curve reference;
+    reference.setKeyframes(keys, false);
+    ASSERT_EQ( (int)keys.size(), c.getKeyFramesCount() );
+    int index = 0;
+    for (KeyFrameSet::const_iterator it = keys.begin(); it != keys.end(); ++it, ++index) {
+        KeyFrame k;
+        EXPECT_TRUE( c.getKeyFrameWithIndex(index, &k) );
+        EXPECT_TRUE( k == *it );
+    }
+    for (int i = 0; i < 2200; ++i) {
+        TimeValue t(i * 0.25);
+        EXPECT_EQ( reference.getValueAt(t), c.getValueAt(t) ) << "t = " << t;
+    }
+}
+
+TEST(Curve, GetValuesAt)
+{
+    Curve c;
+    makeDenseCurve(&c, 1000);
+
+    // Increasing times, then arbitrary times: both must give the same results as getValueAt
+    std::vector<TimeValue> times;
+    for (int i = 0; i < 5000; ++i) {
+        times.push_back( TimeValue(-10. + i * 0.25) );
+    }
+    for (int i = 0; i < 1000; ++i) {
+        // coverity[dont_call]
+        times.push_back( TimeValue( (rand() % 20000) / 10. - 500. ) );
+    }
+    std::vector<double> values( times.size() );
+    c.getValuesAt( &times[0], &values[0], (int)times.size() );
+    for (std::size_t i = 0; i < times.size(); ++i) {
+        EXPECT_EQ( c.getValueAt(times[i]), values[i] ) << "t = " << times[i];
+    }
+
+    // Periodic curve
+    Curve periodic;
+    periodic.setPeriodic(true);
+    periodic.setXRange(0., 1.);
+    periodic.addKeyFrame( KeyFrame(0., 0.) );
+    periodic.addKeyFrame( KeyFrame(0.5, 1.) );
+    std::vector<TimeValue> periodicTimes;
+    for (int i = 0; i < 100; ++i) {
+        periodicTimes.push_back( TimeValue(-2. + i * 0.05) );
+    }
+    std::vector<double> periodicValues( periodicTimes.size() );
+    periodic.getValuesAt( &periodicTimes[0], &periodicValues[0], (int)periodicTimes.size() );
+    for (std::size_t i = 0; i < periodicTimes.size(); ++i) {
+        EXPECT_EQ( periodic.getValueAt(periodicTimes[i]), periodicValues[i] ) << "t = " << periodicTimes[i];
+    }
+}
+
+// Not a correctness test: prints the throughput of the evaluation of a dense curve,
+// one time at a time and batched, as done by the curve editor and when baking.
+TEST(Curve, EvaluationThroughput)
+{
+    Curve c;
+    makeDenseCurve(&c, 10000);
+
+    const int nSamples = 1000000;
+    std::vector<TimeValue> times(nSamples);
+    for (int i = 0; i < nSamples; ++i) {
+        times[i] = TimeValue(i * 0.01);
+    }
+    std::vector<double> values(nSamples);
+
+    TimeLapse timer;
+    double sum = 0.;
+    for (int i = 0; i < nSamples; ++i) {
+        sum += c.getValueAt(times[i]);
+    }
+    double elapsed = timer.getTimeElapsedReset();
+    std::cout << "Curve::getValueAt: " << nSamples << " samples of a curve with " << c.getKeyFramesCount() << " keyframes in " << elapsed << " s" << std::endl;
+
+    c.getValuesAt( &times[0], &values[0], nSamples );
+    elapsed = timer.getTimeElapsedReset();
+    std::cout << "Curve::getValuesAt: " << nSamples << " samples of a curve with " << c.getKeyFramesCount() << " keyframes in " << elapsed << " s" << std::endl;
+
+    double batchSum = 0.;
+    for (int i = 0; i < nSamples; ++i) {
+        batchSum += values[i];
+    }
+    EXPECT_EQ(sum, batchSum);
+}
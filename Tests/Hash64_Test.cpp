@@ -24,9 +24,16 @@
 
 #include "Global/Macros.h"
 
+#include <algorithm>
 #include <cstdlib>
+#include <set>
+#include <vector>
 #include <gtest/gtest.h>
 
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/crc.hpp>
+#endif
+
 #include "Engine/Hash64.h"
 
 NATRON_NAMESPACE_USING
@@ -90,3 +97,130 @@ TEST(Hash64,
     EXPECT_NE(hash1, hash2);
 } // TEST
 
+
+static U64
+hashWords(const std::vector<U64>& words)
+{
+    Hash64 hash;
+
+    for (std::size_t i = 0; i < words.size(); ++i) {
+        hash.append(words[i]);
+    }
+    hash.computeHash();
+
+    return hash.value();
+}
+
+static int
+popCount(U64 x)
+{
+    int count = 0;
+
+    for (; x; x &= x - 1) {
+        ++count;
+    }
+
+    return count;
+}
+
+TEST(Hash64,
+     Collisions)
+{
+    std::set<U64> values;
+    int nHashes = 0;
+
+    // Small sequential integers, the typical content of a key
+    for (U64 i = 0; i < 20000; ++i) {
+        std::vector<U64> words(1, i);
+        EXPECT_TRUE( values.insert( hashWords(words) ).second ) << "Collision for the single word " << i;
+        ++nHashes;
+    }
+
+    // Same words in a different order or with zero words appended must give different hashes
+    for (U64 i = 0; i < 100; ++i) {
+        for (U64 j = 0; j < 100; ++j) {
+            std::vector<U64> words;
+            words.push_back(i);
+            words.push_back(j);
+            words.push_back(0);
+            EXPECT_TRUE( values.insert( hashWords(words) ).second ) << "Collision for " << i << ", " << j << ", 0";
+            ++nHashes;
+        }
+    }
+    EXPECT_EQ( nHashes, (int)values.size() );
+
+    std::vector<U64> words;
+    words.push_back(1);
+    words.push_back(2);
+    U64 h12 = hashWords(words);
+    std::swap(words[0], words[1]);
+    EXPECT_NE( h12, hashWords(words) );
+}
+
+TEST(Hash64,
+     Avalanche)
+{
+    // Flipping a single input bit should flip about half of the output bits
+    srand(2000);
+    const int nSamples = 200;
+    double totalFlipped = 0;
+    int nTrials = 0;
+    for (int s = 0; s < nSamples; ++s) {
+        std::vector<U64> words;
+        for (int i = 0; i < 3; ++i) {
+            // coverity[dont_call]
+            words.push_back( ( (U64)rand() << 33 ) ^ ( (U64)rand() << 11 ) ^ (U64)rand() );
+        }
+        U64 ref = hashWords(words);
+        for (std::size_t w = 0; w < words.size(); ++w) {
+            for (int bit = 0; bit < 64; ++bit) {
+                words[w] ^= (U64)1 << bit;
+                int flipped = popCount( ref ^ hashWords(words) );
+                words[w] ^= (U64)1 << bit;
+                ASSERT_GT(flipped, 0);
+                totalFlipped += flipped;
+                ++nTrials;
+            }
+        }
+    }
+    double meanFlipped = totalFlipped / nTrials;
+    EXPECT_NEAR(32., meanFlipped, 0.5);
+}
+
+TEST(Hash64,
+     Crc64CompatibilityMode)
+{
+    ASSERT_FALSE( Hash64::isCrc64CompatibilityModeEnabled() );
+
+    Hash64::setCrc64CompatibilityModeEnabled(true);
+    Hash64 compatHash;
+    Hash64::setCrc64CompatibilityModeEnabled(false);
+    Hash64 streamHash;
+
+    std::vector<U64> words;
+    for (int i = 0; i < 100; ++i) {
+        compatHash.append<int>(i);
+        streamHash.append<int>(i);
+        words.push_back( Hash64::toU64<int>(i) );
+    }
+    compatHash.computeHash();
+    streamHash.computeHash();
+    ASSERT_TRUE( compatHash.valid() );
+    ASSERT_TRUE( streamHash.valid() );
+    EXPECT_NE( compatHash.value(), streamHash.value() );
+
+    // Must match the CRC64 of the words, as computed by older versions
+    const unsigned char* data = reinterpret_cast<const unsigned char*>( &words.front() );
+    boost::crc_optimal<64, 0x42F0E1EBA9EA3693ULL, 0, 0, false, false> crc_64;
+    crc_64 = std::for_each( data, data + words.size() * sizeof(U64), crc_64 );
+    EXPECT_EQ( crc_64(), compatHash.value() );
+
+    // The mode is captured when the hash is created and survives reset()
+    compatHash.reset();
+    EXPECT_TRUE( compatHash.isEmpty() );
+    for (int i = 0; i < 100; ++i) {
+        compatHash.append<int>(i);
+    }
+    compatHash.computeHash();
+    EXPECT_NE( compatHash.value(), streamHash.value() );
+}
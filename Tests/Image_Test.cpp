@@ -25,9 +25,14 @@
 #include "Global/Macros.h"
 
 #include <cstring>
+#include <cstdlib>
+#include <limits>
+#include <vector>
 #include <gtest/gtest.h>
 
+#include "Engine/Half.h"
 #include "Engine/Image.h"
+#include "Engine/ImageConvertSIMD.h"
 #include "Engine/CacheEntryKeyBase.h"
 #include "Engine/ViewIdx.h"
 
@@ -73,3 +78,191 @@ TEST(ImageKeyTest, Difference) {
     ASSERT_TRUE(keyHash1 != keyHash2);
 }
 
+
+// Each vectorized kernel must give exactly the same results as Image::convertPixelDepth.
+// Buffer sizes are not a multiple of the vector width so that the scalar tail is exercised too.
+
+template <typename SRCPIX, typename DSTPIX>
+static void
+checkConvertSamplesFunction(ImageBitDepthEnum srcDepth,
+                            ImageBitDepthEnum dstDepth,
+                            const std::vector<SRCPIX>& src)
+{
+    for (int i = ImageConvertSIMD::eInstructionSetSSE2; i <= ImageConvertSIMD::eInstructionSetAVX2; ++i) {
+        ImageConvertSIMD::InstructionSetEnum instructionSet = (ImageConvertSIMD::InstructionSetEnum)i;
+        ImageConvertSIMD::ConvertSamplesFunc func = ImageConvertSIMD::getConvertSamplesFunction(srcDepth, dstDepth, instructionSet);
+        if (!func) {
+            // Not supported by this CPU or build
+            continue;
+        }
+        std::vector<DSTPIX> dst( src.size() );
+        func( &src[0], &dst[0], src.size() );
+        for (std::size_t k = 0; k < src.size(); ++k) {
+            ASSERT_EQ( (Image::convertPixelDepth<SRCPIX, DSTPIX>(src[k])), dst[k] ) << "instruction set " << i << " sample " << k;
+        }
+    }
+}
+
+TEST(ImageConvertSIMDTest, IntegerToFloat) {
+    std::vector<unsigned char> src8;
+    for (int i = 0; i < 256 * 3 + 5; ++i) {
+        src8.push_back( (unsigned char)i );
+    }
+    std::vector<unsigned short> src16;
+    for (int i = 0; i < 65536 + 7; ++i) {
+        src16.push_back( (unsigned short)i );
+    }
+    checkConvertSamplesFunction<unsigned char, float>(eImageBitDepthByte, eImageBitDepthFloat, src8);
+    checkConvertSamplesFunction<unsigned short, float>(eImageBitDepthShort, eImageBitDepthFloat, src16);
+    checkConvertSamplesFunction<unsigned char, unsigned short>(eImageBitDepthByte, eImageBitDepthShort, src8);
+    checkConvertSamplesFunction<unsigned short, unsigned char>(eImageBitDepthShort, eImageBitDepthByte, src16);
+}
+
+// A CPU supporting an instruction set also supports the lower ones: it must never lose the kernels of a lower one
+TEST(ImageConvertSIMDTest, HigherInstructionSetsKeepLowerKernels) {
+    const ImageBitDepthEnum depths[] = { eImageBitDepthByte, eImageBitDepthShort, eImageBitDepthHalf, eImageBitDepthFloat };
+    const int nDepths = sizeof(depths) / sizeof(depths[0]);
+    for (int i = ImageConvertSIMD::eInstructionSetF16C; i <= ImageConvertSIMD::getSupportedInstructionSet(); ++i) {
+        for (int s = 0; s < nDepths; ++s) {
+            for (int d = 0; d < nDepths; ++d) {
+                if ( ImageConvertSIMD::getConvertSamplesFunction(depths[s], depths[d], (ImageConvertSIMD::InstructionSetEnum)(i - 1)) ) {
+                    EXPECT_TRUE( ImageConvertSIMD::getConvertSamplesFunction(depths[s], depths[d], (ImageConvertSIMD::InstructionSetEnum)i) )
+                        << "instruction set " << i << " depths " << depths[s] << " -> " << depths[d];
+                }
+            }
+        }
+    }
+}
+
+TEST(ImageConvertSIMDTest, FloatToInteger) {
+    std::vector<float> src;
+
+    // Out of range values are clamped
+    src.push_back(0.f);
+    src.push_back(-0.f);
+    src.push_back(1.f);
+    src.push_back(-1.f);
+    src.push_back(2.5f);
+    src.push_back( std::numeric_limits<float>::min() );
+    src.push_back( std::numeric_limits<float>::infinity() );
+    src.push_back( -std::numeric_limits<float>::infinity() );
+    src.push_back( std::numeric_limits<float>::max() );
+
+    // Values around the rounding thresholds of both integer formats
+    for (int i = 0; i < 65536; ++i) {
+        const float threshold16 = (i + 0.5f) / 65535.f;
+        src.push_back(threshold16);
+        src.push_back( threshold16 * (1.f - std::numeric_limits<float>::epsilon() ) );
+        src.push_back( threshold16 * (1.f + std::numeric_limits<float>::epsilon() ) );
+        if (i < 256) {
+            src.push_back( (i + 0.5f) / 255.f );
+            src.push_back(i / 255.f);
+        }
+    }
+
+    // Random values, some outside of [0, 1]
+    srand(2000);
+    for (int i = 0; i < 100003; ++i) {
+        // coverity[dont_call]
+        src.push_back( (float)rand() / RAND_MAX * 1.2f - 0.1f );
+    }
+
+    checkConvertSamplesFunction<float, unsigned char>(eImageBitDepthFloat, eImageBitDepthByte, src);
+    checkConvertSamplesFunction<float, unsigned short>(eImageBitDepthFloat, eImageBitDepthShort, src);
+}
+
+TEST(ImageConvertSIMDTest, HalfFloat) {
+    // Every half value, including denormals, infinities and NaNs
+    std::vector<Half> srcHalf;
+    for (int i = 0; i < 65536 + 3; ++i) {
+        srcHalf.push_back( Half::fromBits( (unsigned short)(i & 0xffff) ) );
+    }
+
+    std::vector<float> srcFloat;
+    srcFloat.push_back(0.f);
+    srcFloat.push_back(-0.f);
+    srcFloat.push_back(1.f);
+    srcFloat.push_back(65504.f); // largest half
+    srcFloat.push_back(65520.f); // rounds to infinity
+    srcFloat.push_back( std::numeric_limits<float>::min() );
+    srcFloat.push_back( std::numeric_limits<float>::max() );
+    srcFloat.push_back( std::numeric_limits<float>::infinity() );
+    srcFloat.push_back( -std::numeric_limits<float>::infinity() );
+    srcFloat.push_back( std::numeric_limits<float>::quiet_NaN() );
+    // Every half value and the values halfway between consecutive halves, to check the rounding to nearest even
+    for (int i = 0; i < 0x7c00; ++i) {
+        const float v = Half::halfBitsToFloat( (unsigned short)i );
+        const float next = Half::halfBitsToFloat( (unsigned short)(i + 1) );
+        srcFloat.push_back(v);
+        srcFloat.push_back(-v);
+        srcFloat.push_back( (v + next) / 2.f );
+    }
+    srand(2000);
+    for (int i = 0; i < 100003; ++i) {
+        // coverity[dont_call]
+        srcFloat.push_back( (float)rand() / RAND_MAX * 4.f - 2.f );
+    }
+
+    // Compare the bits rather than the values so that NaNs are checked too
+    for (int i = ImageConvertSIMD::eInstructionSetSSE2; i <= ImageConvertSIMD::eInstructionSetAVX2; ++i) {
+        ImageConvertSIMD::InstructionSetEnum instructionSet = (ImageConvertSIMD::InstructionSetEnum)i;
+
+        ImageConvertSIMD::ConvertSamplesFunc toFloat = ImageConvertSIMD::getConvertSamplesFunction(eImageBitDepthHalf, eImageBitDepthFloat, instructionSet);
+        if (toFloat) {
+            std::vector<float> dst( srcHalf.size() );
+            toFloat( &srcHalf[0], &dst[0], srcHalf.size() );
+            for (std::size_t k = 0; k < srcHalf.size(); ++k) {
+                const float expected = Image::convertPixelDepth<Half, float>(srcHalf[k]);
+                ASSERT_EQ( 0, std::memcmp( &expected, &dst[k], sizeof(float) ) ) << "instruction set " << i << " sample " << k;
+            }
+        }
+
+        ImageConvertSIMD::ConvertSamplesFunc toHalf = ImageConvertSIMD::getConvertSamplesFunction(eImageBitDepthFloat, eImageBitDepthHalf, instructionSet);
+        if (toHalf) {
+            std::vector<Half> dst( srcFloat.size() );
+            toHalf( &srcFloat[0], &dst[0], srcFloat.size() );
+            for (std::size_t k = 0; k < srcFloat.size(); ++k) {
+                ASSERT_EQ( (Image::convertPixelDepth<float, Half>(srcFloat[k]).getBits()), dst[k].getBits() ) << "instruction set " << i << " sample " << k;
+            }
+        }
+    }
+}
+
+TEST(ImageConvertSIMDTest, Components) {
+    // Pixel counts that are not a multiple of the vector width exercise the scalar tail
+    for (int i = ImageConvertSIMD::eInstructionSetSSE2; i <= ImageConvertSIMD::eInstructionSetAVX2; ++i) {
+        ImageConvertSIMD::InstructionSetEnum instructionSet = (ImageConvertSIMD::InstructionSetEnum)i;
+        ImageConvertSIMD::ConvertComponentsFunc rgbaToRgb = ImageConvertSIMD::getConvertComponentsFunction(eImageBitDepthFloat, 4, 3, instructionSet);
+        ImageConvertSIMD::ConvertComponentsFunc rgbToRgba = ImageConvertSIMD::getConvertComponentsFunction(eImageBitDepthFloat, 3, 4, instructionSet);
+        for (std::size_t count = 0; count < 23; ++count) {
+            // Samples are moved, never converted: compare the bits so that NaNs are checked too
+            std::vector<float> rgba(count * 4 + 1), rgb(count * 3 + 1);
+            for (std::size_t k = 0; k < rgba.size(); ++k) {
+                rgba[k] = (k % 7 == 0) ? std::numeric_limits<float>::quiet_NaN() : k * 0.25f - 3.f;
+            }
+            for (std::size_t k = 0; k < rgb.size(); ++k) {
+                rgb[k] = (k % 5 == 0) ? -std::numeric_limits<float>::infinity() : k * 0.5f;
+            }
+            const float alpha = 0.75f;
+            const float guard = -7.f;
+
+            if (rgbaToRgb) {
+                std::vector<float> dst(count * 3 + 1, guard);
+                rgbaToRgb(&rgba[0], &dst[0], count, 0);
+                for (std::size_t p = 0; p < count; ++p) {
+                    ASSERT_EQ( 0, std::memcmp( &rgba[p * 4], &dst[p * 3], sizeof(float) * 3 ) ) << "instruction set " << i << " pixel " << p;
+                }
+                EXPECT_EQ(guard, dst[count * 3]);
+            }
+            if (rgbToRgba) {
+                std::vector<float> dst(count * 4 + 1, guard);
+                rgbToRgba(&rgb[0], &dst[0], count, &alpha);
+                for (std::size_t p = 0; p < count; ++p) {
+                    ASSERT_EQ( 0, std::memcmp( &rgb[p * 3], &dst[p * 4], sizeof(float) * 3 ) ) << "instruction set " << i << " pixel " << p;
+                    ASSERT_EQ(alpha, dst[p * 4 + 3]);
+                }
+                EXPECT_EQ(guard, dst[count * 4]);
+            }
+        }
+    }
+}
@@ -0,0 +1,124 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2017 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cmath>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "Engine/KnobNativeExpression.h"
+
+NATRON_NAMESPACE_USING
+
+static KnobNativeExpressionPtr
+compileExpression(const std::string& expression)
+{
+    return KnobNativeExpression::compile( expression, KnobIPtr(), NodePtr(), DimIdx(1) );
+}
+
+static void
+checkExpression(const std::string& expression,
+                double frame,
+                double expected,
+                bool expectedIsInt)
+{
+    KnobNativeExpressionPtr expr = compileExpression(expression);
+
+    ASSERT_TRUE(expr) << expression;
+    double result;
+    bool resultIsInt;
+    ASSERT_TRUE( expr->evaluate(TimeValue(frame), &result, &resultIsInt) ) << expression;
+    EXPECT_DOUBLE_EQ(expected, result) << expression;
+    EXPECT_EQ(expectedIsInt, resultIsInt) << expression;
+}
+
+TEST(KnobNativeExpression,
+     Arithmetic)
+{
+    checkExpression("frame*2+10", 5, 20, true);
+    checkExpression("frame*2+10", 2.5, 15, false);
+    checkExpression("dimension", 0, 1, true);
+    checkExpression("(1 + 2) * 3 - 4", 0, 5, true);
+    checkExpression("-2**2", 0, -4, true);
+    checkExpression("2**3**2", 0, 512, true);
+    checkExpression("2**-1", 0, 0.5, false);
+    checkExpression(".5e1 + 1", 0, 6, false);
+
+    // Python division semantics
+#if PY_MAJOR_VERSION >= 3
+    checkExpression("7/2", 0, 3.5, false);
+#else
+    checkExpression("7/2", 0, 3, true);
+#endif
+    checkExpression("7.0/2", 0, 3.5, false);
+    checkExpression("-7//2", 0, -4, true);
+    checkExpression("-7%3", 0, 2, true);
+    checkExpression("7%-3", 0, -2, true);
+    checkExpression("-7.5//2", 0, -4, false);
+    checkExpression("-7.5%2", 0, 0.5, false);
+}
+
+TEST(KnobNativeExpression,
+     Functions)
+{
+    checkExpression("sin(pi/2)", 0, 1, false);
+    checkExpression("sqrt(16)", 0, 4, false);
+    checkExpression("pow(2, 3)", 0, 8, false);
+    checkExpression("abs(-3)", 0, 3, true);
+    checkExpression("max(1, frame, 3.5)", 10, 10, true);
+    checkExpression("min(1, frame, 3.5)", 10, 1, true);
+    checkExpression("int(-2.7)", 0, -2, true);
+    checkExpression("float(frame)", 3, 3, false);
+    checkExpression("log(8, 2)", 0, 3, false);
+    checkExpression("degrees(pi)", 0, 180, false);
+}
+
+TEST(KnobNativeExpression,
+     Unsupported)
+{
+    // Left to Python
+    EXPECT_FALSE( compileExpression("random()") );
+    EXPECT_FALSE( compileExpression("thisParam.get()") );
+    EXPECT_FALSE( compileExpression("Blur1.size.get()") );
+    EXPECT_FALSE( compileExpression("\"a\" + \"b\"") );
+    EXPECT_FALSE( compileExpression("frame if frame > 1 else 0") );
+    EXPECT_FALSE( compileExpression("ret = frame") );
+    EXPECT_FALSE( compileExpression("010") );
+    EXPECT_FALSE( compileExpression("0x10") );
+    EXPECT_FALSE( compileExpression("min(1)") );
+    EXPECT_FALSE( compileExpression("(1, 2)") );
+    EXPECT_FALSE( compileExpression("1 +") );
+
+    // Errors are reported by Python
+    const char* failingExpressions[] = { "1/0", "1%0", "0**-1", "(-8)**(1./3)", "sqrt(-1)", "log(0)", "2**1000", "10.**400", 0 };
+    for (const char** it = failingExpressions; *it; ++it) {
+        KnobNativeExpressionPtr expr = compileExpression(*it);
+        ASSERT_TRUE(expr) << *it;
+        double result;
+        bool resultIsInt;
+        EXPECT_FALSE( expr->evaluate(TimeValue(0), &result, &resultIsInt) ) << *it;
+    }
+}
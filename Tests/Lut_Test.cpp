@@ -25,8 +25,16 @@
 #include "Global/Macros.h"
 
 #include <cstdlib>
+#include <iostream>
+#include <vector>
 #include <gtest/gtest.h>
+
+CLANG_DIAG_OFF(deprecated)
+#include <QtCore/QThread>
+CLANG_DIAG_ON(deprecated)
+
 #include "Engine/Lut.h"
+#include "Engine/Timer.h"
 
 NATRON_NAMESPACE_USING
 using namespace NATRON_NAMESPACE::Color;
@@ -51,3 +59,154 @@ TEST(Lut, IntConversions) {
         EXPECT_EQ( i, uint8xxToChar( charToUint8xx(i) ) );
     }
 }
+
+static std::vector<const Lut*>
+getBuiltinLuts()
+{
+    std::vector<const Lut*> luts;
+
+    luts.push_back( LutManager::sRGBLut() );
+    luts.push_back( LutManager::Rec709Lut() );
+    luts.push_back( LutManager::CineonLut() );
+    luts.push_back( LutManager::Gamma1_8Lut() );
+    luts.push_back( LutManager::Gamma2_2Lut() );
+    luts.push_back( LutManager::PanalogLut() );
+    luts.push_back( LutManager::ViperLogLut() );
+    luts.push_back( LutManager::REDLogLut() );
+    luts.push_back( LutManager::AlexaV3LogCLut() );
+    luts.push_back( LutManager::SLog1Lut() );
+    luts.push_back( LutManager::SLog2Lut() );
+
+    return luts;
+}
+
+// The batched functions must give the same results as the per-sample functions, for every color-space
+TEST(Lut, PlanarConversions) {
+    std::vector<const Lut*> luts = getBuiltinLuts();
+
+    std::vector<unsigned char> bytes(256);
+    for (int i = 0; i < 256; ++i) {
+        bytes[i] = (unsigned char)i;
+    }
+    std::vector<unsigned short> shorts(0x10000);
+    for (int i = 0; i < 0x10000; ++i) {
+        shorts[i] = (unsigned short)i;
+    }
+    std::vector<float> floats(1001);
+    for (std::size_t i = 0; i < floats.size(); ++i) {
+        floats[i] = i / 1000.f;
+    }
+
+    for (std::size_t l = 0; l < luts.size(); ++l) {
+        const Lut* lut = luts[l];
+        lut->validate();
+        ASSERT_TRUE( lut->isValid() );
+
+        std::vector<float> out( shorts.size() );
+        lut->from_byte_planar( &out[0], &bytes[0], bytes.size() );
+        for (std::size_t i = 0; i < bytes.size(); ++i) {
+            EXPECT_EQ(lut->fromColorSpaceUint8ToLinearFloatFast(bytes[i]), out[i]) << lut->getName();
+        }
+
+        lut->from_short_planar( &out[0], &shorts[0], shorts.size() );
+        for (std::size_t i = 0; i < shorts.size(); ++i) {
+            EXPECT_EQ(lut->fromColorSpaceUint16ToLinearFloatFast(shorts[i]), out[i]) << lut->getName();
+        }
+
+        lut->from_float_planar( &out[0], &floats[0], floats.size() );
+        for (std::size_t i = 0; i < floats.size(); ++i) {
+            EXPECT_EQ(lut->fromColorSpaceFloatToLinearFloat(floats[i]), out[i]) << lut->getName();
+        }
+
+        std::vector<unsigned short> outShorts( floats.size() );
+        lut->to_short_planar( &outShorts[0], &floats[0], floats.size() );
+        for (std::size_t i = 0; i < floats.size(); ++i) {
+            EXPECT_EQ(lut->toColorSpaceUint16FromLinearFloatFast(floats[i]), outShorts[i]) << lut->getName();
+        }
+
+        // to_byte_planar uses error diffusion: each value may differ by at most 1 from the rounded value
+        std::vector<unsigned char> outBytes( floats.size() );
+        lut->to_byte_planar( &outBytes[0], &floats[0], floats.size() );
+        for (std::size_t i = 0; i < floats.size(); ++i) {
+            EXPECT_LE(std::abs( (int)lut->toColorSpaceUint8FromLinearFloatFast(floats[i]) - (int)outBytes[i] ), 1) << lut->getName();
+        }
+
+        // Strided input and output, e.g. deinterlacing a packed RGB buffer
+        std::vector<float> packed(3 * 256, -1.f);
+        lut->from_byte_planar(&packed[1], &bytes[0], 85, NULL, 3, 3);
+        for (int x = 0; x < 85; ++x) {
+            EXPECT_EQ(lut->fromColorSpaceUint8ToLinearFloatFast(bytes[x * 3]), packed[x * 3 + 1]);
+            EXPECT_EQ(-1.f, packed[x * 3]);
+            EXPECT_EQ(-1.f, packed[x * 3 + 2]);
+        }
+    }
+}
+
+class LutLookupThread
+    : public QThread
+{
+public:
+
+    LutLookupThread(const std::vector<const Lut*>& luts,
+                    int nIterations)
+        : QThread()
+        , _luts(luts)
+        , _nIterations(nIterations)
+        , _bytes(256)
+        , _out(256)
+    {
+        for (int i = 0; i < 256; ++i) {
+            _bytes[i] = (unsigned char)i;
+        }
+    }
+
+    virtual ~LutLookupThread()
+    {
+    }
+
+private:
+
+    virtual void run() OVERRIDE FINAL
+    {
+        // Short scan-lines so that the per-call cost of validate() is not hidden by the conversion itself
+        for (int i = 0; i < _nIterations; ++i) {
+            const Lut* lut = _luts[i % _luts.size()];
+            lut->from_byte_planar( &_out[0], &_bytes[0], 16 );
+        }
+    }
+
+    std::vector<const Lut*> _luts;
+    int _nIterations;
+    std::vector<unsigned char> _bytes;
+    std::vector<float> _out;
+};
+
+// Not a correctness test: prints the throughput of batched lookups with an increasing number of threads.
+// Since lookups do not take any lock once the tables are filled, the time should stay roughly constant
+// as long as there are enough cores.
+TEST(Lut, ConcurrentLookupScaling) {
+    std::vector<const Lut*> luts = getBuiltinLuts();
+    const int nIterationsPerThread = 200000;
+    const int maxThreads = std::max(QThread::idealThreadCount(), 1);
+
+    for (int nThreads = 1; nThreads <= maxThreads; nThreads *= 2) {
+        std::vector<LutLookupThread*> threads;
+        for (int i = 0; i < nThreads; ++i) {
+            threads.push_back( new LutLookupThread(luts, nIterationsPerThread) );
+        }
+        TimeLapse timer;
+        for (int i = 0; i < nThreads; ++i) {
+            threads[i]->start();
+        }
+        for (int i = 0; i < nThreads; ++i) {
+            threads[i]->wait();
+            delete threads[i];
+        }
+        double elapsed = timer.getTimeSinceCreation();
+        std::cout << "Lut lookups: " << nThreads << " thread(s), " << nIterationsPerThread << " scan-lines per thread in " << elapsed << " s" << std::endl;
+    }
+
+    for (std::size_t l = 0; l < luts.size(); ++l) {
+        EXPECT_TRUE( luts[l]->isValid() );
+    }
+}
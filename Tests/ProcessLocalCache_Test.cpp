@@ -0,0 +1,222 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2017 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <gtest/gtest.h>
+
+#include "Engine/CacheEntryBase.h"
+#include "Engine/Hash64.h"
+#include "Engine/ProcessLocalCache.h"
+
+NATRON_NAMESPACE_USING
+
+class TestKey : public CacheEntryKeyBase
+{
+public:
+
+    TestKey(int value)
+    : CacheEntryKeyBase()
+    , _value(value)
+    {
+    }
+
+    virtual int getUniqueID() const OVERRIDE FINAL
+    {
+        return 1000;
+    }
+
+private:
+
+    virtual void appendToHash(Hash64* hash) const OVERRIDE FINAL
+    {
+        hash->append(_value);
+    }
+
+    int _value;
+};
+
+class TestResults : public CacheEntryBase
+{
+public:
+
+    TestResults(int keyValue)
+    : CacheEntryBase( CachePtr() )
+    , result(-1)
+    {
+        setKey( CacheEntryKeyBasePtr( new TestKey(keyValue) ) );
+    }
+
+    virtual bool isProcessLocalCacheable() const OVERRIDE FINAL
+    {
+        return true;
+    }
+
+    virtual bool copyFromProcessLocalEntry(const CacheEntryBase& other) OVERRIDE FINAL
+    {
+        const TestResults* otherResults = dynamic_cast<const TestResults*>(&other);
+        if (!otherResults) {
+            return false;
+        }
+        result = otherResults->result;
+        return true;
+    }
+
+    int result;
+};
+
+typedef boost::shared_ptr<TestResults> TestResultsPtr;
+
+// Results held by a pointer shared with the caller, like the meta-datas of GetTimeInvariantMetaDatasResults
+class TestSharedResults : public CacheEntryBase
+{
+public:
+
+    TestSharedResults(int keyValue)
+    : CacheEntryBase( CachePtr() )
+    , result( new int(-1) )
+    {
+        setKey( CacheEntryKeyBasePtr( new TestKey(keyValue) ) );
+    }
+
+    virtual bool isProcessLocalCacheable() const OVERRIDE FINAL
+    {
+        return true;
+    }
+
+    virtual bool copyFromProcessLocalEntry(const CacheEntryBase& other) OVERRIDE FINAL
+    {
+        const TestSharedResults* otherResults = dynamic_cast<const TestSharedResults*>(&other);
+        if (!otherResults) {
+            return false;
+        }
+        *result = *otherResults->result;
+        return true;
+    }
+
+    virtual CacheEntryBasePtr createProcessLocalEntry() OVERRIDE FINAL
+    {
+        boost::shared_ptr<TestSharedResults> ret( new TestSharedResults(0) );
+        ret->setKey( getKey() );
+        *ret->result = *result;
+        return ret;
+    }
+
+    boost::shared_ptr<int> result;
+};
+
+typedef boost::shared_ptr<TestSharedResults> TestSharedResultsPtr;
+
+TEST(ProcessLocalCache,
+     HitsAndMisses)
+{
+    ProcessLocalCache cache(64);
+    TestResultsPtr computed( new TestResults(1) );
+
+    EXPECT_FALSE( cache.get(computed) );
+    computed->result = 42;
+    cache.insert(computed);
+
+    TestResultsPtr lookup( new TestResults(1) );
+    ASSERT_TRUE( cache.get(lookup) );
+    EXPECT_EQ(42, lookup->result);
+
+    TestResultsPtr other( new TestResults(2) );
+    EXPECT_FALSE( cache.get(other) );
+    EXPECT_EQ(-1, other->result);
+
+    ProcessLocalCacheStats stats;
+    cache.getStats(&stats);
+    EXPECT_EQ( (U64)1, stats.nHits );
+    EXPECT_EQ( (U64)2, stats.nMisses );
+    EXPECT_EQ( (std::size_t)1, stats.nEntries );
+
+    cache.remove( computed->getHashKey() );
+    EXPECT_FALSE( cache.get(lookup) );
+
+    cache.insert(computed);
+    cache.clear();
+    EXPECT_FALSE( cache.get(lookup) );
+    cache.getStats(&stats);
+    EXPECT_EQ( (std::size_t)0, stats.nEntries );
+}
+
+TEST(ProcessLocalCache,
+     Eviction)
+{
+    const std::size_t maxEntries = 64;
+    ProcessLocalCache cache(maxEntries);
+    const int nInserted = 1000;
+
+    for (int i = 0; i < nInserted; ++i) {
+        TestResultsPtr computed( new TestResults(i) );
+        computed->result = i;
+        cache.insert(computed);
+    }
+
+    ProcessLocalCacheStats stats;
+    cache.getStats(&stats);
+    EXPECT_LE(stats.nEntries, maxEntries);
+    EXPECT_EQ( (U64)(nInserted - stats.nEntries), stats.nEvictions );
+
+    // The most recent entries are still cached
+    int nFound = 0;
+    for (int i = nInserted - 16; i < nInserted; ++i) {
+        TestResultsPtr lookup( new TestResults(i) );
+        if ( cache.get(lookup) ) {
+            EXPECT_EQ(i, lookup->result);
+            ++nFound;
+        }
+    }
+    EXPECT_GT(nFound, 0);
+
+    // Shrinking evicts, 0 disables the cache
+    cache.setMaximumEntries(0);
+    cache.getStats(&stats);
+    EXPECT_EQ( (std::size_t)0, stats.nEntries );
+    TestResultsPtr computed( new TestResults(0) );
+    cache.insert(computed);
+    EXPECT_FALSE( cache.get(computed) );
+}
+
+TEST(ProcessLocalCache,
+     InsertedResultsAreCopied)
+{
+    ProcessLocalCache cache(64);
+    TestSharedResultsPtr computed( new TestSharedResults(1) );
+    *computed->result = 42;
+    cache.insert(computed);
+
+    // The caller modifying its results after the insertion does not change the cached results
+    *computed->result = 0;
+    TestSharedResultsPtr lookup( new TestSharedResults(1) );
+    ASSERT_TRUE( cache.get(lookup) );
+    EXPECT_EQ(42, *lookup->result);
+
+    // Neither does modifying the results of a look-up
+    *lookup->result = 1;
+    TestSharedResultsPtr lookup2( new TestSharedResults(1) );
+    ASSERT_TRUE( cache.get(lookup2) );
+    EXPECT_EQ(42, *lookup2->result);
+}
@@ -0,0 +1,135 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2017 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "Engine/RAMBufferPool.h"
+
+NATRON_NAMESPACE_USING
+
+TEST(RAMBufferPool,
+     SizeClasses)
+{
+    // Small buffers are not pooled and keep their size
+    EXPECT_EQ( (std::size_t)100, RAMBufferPool::getSizeClass(100) );
+
+    const std::size_t minClass = NATRON_RAM_BUFFER_POOL_MIN_SIZE_CLASS;
+    EXPECT_EQ( minClass, RAMBufferPool::getSizeClass(minClass) );
+    EXPECT_EQ( minClass + minClass / 4, RAMBufferPool::getSizeClass(minClass + 1) );
+    EXPECT_EQ( minClass * 2, RAMBufferPool::getSizeClass(minClass * 2 - 1) );
+
+    // At most 25% of a buffer is wasted
+    for (std::size_t n = minClass; n < 64 * minClass; n += 12345) {
+        std::size_t sizeClass = RAMBufferPool::getSizeClass(n);
+        EXPECT_GE(sizeClass, n);
+        EXPECT_LE( sizeClass - n, n / 4 );
+    }
+}
+
+TEST(RAMBufferPool,
+     Reuse)
+{
+    RAMBufferPool pool(64 * 1024 * 1024);
+    const std::size_t nBytes = 1024 * 1024 + 100;
+
+    std::size_t capacity;
+    void* data = pool.allocate(nBytes, &capacity);
+    ASSERT_TRUE(data != 0);
+    EXPECT_EQ(RAMBufferPool::getSizeClass(nBytes), capacity);
+    pool.release(data, capacity);
+
+    // A buffer of the same size class is recycled
+    std::size_t capacity2;
+    void* data2 = pool.allocate(nBytes + 1000, &capacity2);
+    EXPECT_EQ(data, data2);
+    EXPECT_EQ(capacity, capacity2);
+
+    // Another size class is not
+    std::size_t capacity3;
+    void* data3 = pool.allocate(nBytes * 2, &capacity3);
+    EXPECT_NE(capacity, capacity3);
+
+    RAMBufferPoolStats stats;
+    pool.getStats(&stats);
+    EXPECT_EQ( (U64)1, stats.nReuses );
+    EXPECT_EQ( (U64)2, stats.nAllocations );
+    EXPECT_EQ( (U64)capacity, stats.bytesReused );
+    EXPECT_EQ( (std::size_t)0, stats.nBuffersHeld );
+
+    pool.release(data2, capacity2);
+    pool.release(data3, capacity3);
+    pool.getStats(&stats);
+    EXPECT_EQ( (std::size_t)2, stats.nBuffersHeld );
+    EXPECT_EQ(capacity2 + capacity3, stats.bytesHeld);
+
+    pool.clear();
+    pool.getStats(&stats);
+    EXPECT_EQ( (std::size_t)0, stats.nBuffersHeld );
+    EXPECT_EQ( (std::size_t)0, stats.bytesHeld );
+
+    pool.resetStats();
+    pool.getStats(&stats);
+    EXPECT_EQ( (U64)0, stats.nReuses );
+    EXPECT_EQ( (U64)0, stats.nAllocations );
+}
+
+TEST(RAMBufferPool,
+     MaximumBytes)
+{
+    const std::size_t nBytes = 1024 * 1024;
+    RAMBufferPool pool(nBytes * 2);
+
+    // Release more than the pool may hold: the exceeding buffers are freed
+    std::vector<void*> buffers;
+    std::size_t capacity;
+    for (int i = 0; i < 4; ++i) {
+        buffers.push_back( pool.allocate(nBytes, &capacity) );
+    }
+    for (std::size_t i = 0; i < buffers.size(); ++i) {
+        pool.release(buffers[i], capacity);
+    }
+
+    RAMBufferPoolStats stats;
+    pool.getStats(&stats);
+    EXPECT_EQ( (std::size_t)2, stats.nBuffersHeld );
+    EXPECT_LE( stats.bytesHeld, pool.getMaximumBytes() );
+    EXPECT_EQ( (U64)2, stats.nDiscards );
+
+    // Shrinking frees the exceeding buffers, 0 disables the pool
+    pool.setMaximumBytes(nBytes);
+    pool.getStats(&stats);
+    EXPECT_EQ( (std::size_t)1, stats.nBuffersHeld );
+
+    pool.setMaximumBytes(0);
+    pool.getStats(&stats);
+    EXPECT_EQ( (std::size_t)0, stats.nBuffersHeld );
+    void* data = pool.allocate(nBytes, &capacity);
+    pool.release(data, capacity);
+    pool.getStats(&stats);
+    EXPECT_EQ( (std::size_t)0, stats.nBuffersHeld );
+}
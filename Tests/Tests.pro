@@ -53,6 +53,14 @@ SOURCES += \
     Image_Test.cpp \
     Lut_Test.cpp \
     KnobFile_Test.cpp \
+    KnobNativeExpression_Test.cpp \
+    ProcessLocalCache_Test.cpp \
+    RAMBufferPool_Test.cpp \
+    CacheEvictionPolicy_Test.cpp \
+    CacheStats_Test.cpp \
+    CacheFreeTilesBitmap_Test.cpp \
+    CacheTileCodec_Test.cpp \
+    CacheMemoryGovernor_Test.cpp \
     Curve_Test.cpp \
     Tracker_Test.cpp \
     wmain.cpp